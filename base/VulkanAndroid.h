@@ -146,6 +146,8 @@ extern PFN_vkDestroyRenderPass vkDestroyRenderPass;
 extern PFN_vkDestroyFramebuffer vkDestroyFramebuffer;
 extern PFN_vkDestroyShaderModule vkDestroyShaderModule;
 extern PFN_vkDestroyPipelineCache vkDestroyPipelineCache;
+extern PFN_vkGetPipelineCacheData vkGetPipelineCacheData;
+extern PFN_vkMergePipelineCaches vkMergePipelineCaches;
 extern PFN_vkCreateQueryPool vkCreateQueryPool;
 extern PFN_vkDestroyQueryPool vkDestroyQueryPool;
 extern PFN_vkGetQueryPoolResults vkGetQueryPoolResults;
@@ -153,6 +155,7 @@ extern PFN_vkCmdBeginQuery vkCmdBeginQuery;
 extern PFN_vkCmdEndQuery vkCmdEndQuery;
 extern PFN_vkCmdResetQueryPool vkCmdResetQueryPool;
 extern PFN_vkCmdCopyQueryPoolResults vkCmdCopyQueryPoolResults;
+extern PFN_vkCmdWriteTimestamp vkCmdWriteTimestamp;
 
 extern PFN_vkCreateAndroidSurfaceKHR vkCreateAndroidSurfaceKHR;
 extern PFN_vkDestroySurfaceKHR vkDestroySurfaceKHR;
@@ -22,6 +22,16 @@ namespace vks
 	*/
 	VkResult Buffer::map(VkDeviceSize size, VkDeviceSize offset)
 	{
+		if (allocation)
+		{
+			// Sub-allocated memory is persistently mapped by the allocator
+			if (!allocation->mapped)
+			{
+				return VK_ERROR_MEMORY_MAP_FAILED;
+			}
+			mapped = static_cast<uint8_t*>(allocation->mapped) + offset;
+			return VK_SUCCESS;
+		}
 		return vkMapMemory(device, memory, offset, size, 0, &mapped);
 	}
 
@@ -34,7 +44,10 @@ namespace vks
 	{
 		if (mapped)
 		{
-			vkUnmapMemory(device, memory);
+			if (!allocation)
+			{
+				vkUnmapMemory(device, memory);
+			}
 			mapped = nullptr;
 		}
 	}
@@ -48,6 +61,10 @@ namespace vks
 	*/
 	VkResult Buffer::bind(VkDeviceSize offset)
 	{
+		if (allocation)
+		{
+			offset += allocation->offset;
+		}
 		return vkBindBufferMemory(device, buffer, memory, offset);
 	}
 
@@ -90,6 +107,10 @@ namespace vks
 	*/
 	VkResult Buffer::flush(VkDeviceSize size, VkDeviceSize offset)
 	{
+		if (allocation)
+		{
+			return allocation->allocator->flush(allocation, size, offset);
+		}
 		VkMappedMemoryRange mappedRange = {};
 		mappedRange.sType = VK_STRUCTURE_TYPE_MAPPED_MEMORY_RANGE;
 		mappedRange.memory = memory;
@@ -110,6 +131,10 @@ namespace vks
 	*/
 	VkResult Buffer::invalidate(VkDeviceSize size, VkDeviceSize offset)
 	{
+		if (allocation)
+		{
+			return allocation->allocator->invalidate(allocation, size, offset);
+		}
 		VkMappedMemoryRange mappedRange = {};
 		mappedRange.sType = VK_STRUCTURE_TYPE_MAPPED_MEMORY_RANGE;
 		mappedRange.memory = memory;
@@ -127,7 +152,12 @@ namespace vks
 		{
 			vkDestroyBuffer(device, buffer, nullptr);
 		}
-		if (memory)
+		if (allocation)
+		{
+			allocation->allocator->free(allocation);
+			allocation = nullptr;
+		}
+		else if (memory)
 		{
 			vkFreeMemory(device, memory, nullptr);
 		}
@@ -14,6 +14,7 @@
 
 #include "vulkan/vulkan.h"
 #include "VulkanTools.h"
+#include "memoryallocator.hpp"
 
 namespace vks
 {	
@@ -30,6 +31,8 @@ namespace vks
 		VkDeviceSize size = 0;
 		VkDeviceSize alignment = 0;
 		void* mapped = nullptr;
+		/** @brief Memory allocator range the buffer is bound to, nullptr if the buffer has its own device memory */
+		vks::Allocation* allocation = nullptr;
 		/** @brief Usage flags to be filled by external source at buffer creation (to query at some later point) */
 		VkBufferUsageFlags usageFlags;
 		/** @brief Memory property flags to be filled by external source at buffer creation (to query at some later point) */
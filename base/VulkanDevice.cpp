@@ -64,6 +64,7 @@ namespace vks
 	*/
 	VulkanDevice::~VulkanDevice()
 	{
+		memoryAllocator.destroy();
 		if (commandPool)
 		{
 			vkDestroyCommandPool(logicalDevice, commandPool, nullptr);
@@ -308,6 +309,8 @@ namespace vks
 		// Create a default command pool for graphics command buffers
 		commandPool = createCommandPool(queueFamilyIndices.graphics);
 
+		memoryAllocator.prepare(physicalDevice, logicalDevice);
+
 		return result;
 	}
 
@@ -322,6 +325,8 @@ namespace vks
 	* @param data Pointer to the data that should be copied to the buffer after creation (optional, if not set, no data is copied over)
 	*
 	* @return VK_SUCCESS if buffer handle and memory have been created and (optionally passed) data has been copied
+	*
+	* @note The buffer gets its own device memory that has to be freed by the caller, use one of the other overloads to sub-allocate from the device's memory allocator
 	*/
 	VkResult VulkanDevice::createBuffer(VkBufferUsageFlags usageFlags, VkMemoryPropertyFlags memoryPropertyFlags, VkDeviceSize size, VkBuffer *buffer, VkDeviceMemory *memory, void *data)
 	{
@@ -370,6 +375,38 @@ namespace vks
 		return VK_SUCCESS;
 	}
 
+	/**
+	* Create a buffer on the device with memory sub-allocated from the device's memory allocator
+	*
+	* @param usageFlags Usage flag bit mask for the buffer (i.e. index, vertex, uniform buffer)
+	* @param memoryPropertyFlags Memory properties for this buffer (i.e. device local, host visible, coherent)
+	* @param size Size of the buffer in byes
+	* @param buffer Pointer to the buffer handle acquired by the function
+	* @param allocation Pointer to the allocation acquired by the function, has to be freed with memoryAllocator.free
+	* @param data Pointer to the data that should be copied to the buffer after creation (optional, if not set, no data is copied over)
+	* @param strategy Sub-allocation strategy (optional, use vks::AllocationStrategy::Linear for short lived buffers like staging buffers)
+	*
+	* @return VK_SUCCESS if buffer handle and memory have been created and (optionally passed) data has been copied
+	*/
+	VkResult VulkanDevice::createBuffer(VkBufferUsageFlags usageFlags, VkMemoryPropertyFlags memoryPropertyFlags, VkDeviceSize size, VkBuffer *buffer, vks::Allocation **allocation, void *data, vks::AllocationStrategy strategy)
+	{
+		VkBufferCreateInfo bufferCreateInfo = vks::initializers::bufferCreateInfo(usageFlags, size);
+		bufferCreateInfo.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
+		VK_CHECK_RESULT(vkCreateBuffer(logicalDevice, &bufferCreateInfo, nullptr, buffer));
+
+		*allocation = memoryAllocator.allocateBufferMemory(*buffer, memoryPropertyFlags, usageFlags, strategy);
+
+		// Host visible memory is persistently mapped by the allocator
+		if (data != nullptr)
+		{
+			assert((*allocation)->mapped);
+			memcpy((*allocation)->mapped, data, size);
+			VK_CHECK_RESULT(memoryAllocator.flush(*allocation, size));
+		}
+
+		return VK_SUCCESS;
+	}
+
 	/**
 	* Create a buffer on the device
 	*
@@ -389,21 +426,13 @@ namespace vks
 		VkBufferCreateInfo bufferCreateInfo = vks::initializers::bufferCreateInfo(usageFlags, size);
 		VK_CHECK_RESULT(vkCreateBuffer(logicalDevice, &bufferCreateInfo, nullptr, &buffer->buffer));
 
-		// Create the memory backing up the buffer handle
+		// Sub-allocate the memory backing up the buffer handle from one of the device's memory blocks
 		VkMemoryRequirements memReqs;
-		VkMemoryAllocateInfo memAlloc = vks::initializers::memoryAllocateInfo();
 		vkGetBufferMemoryRequirements(logicalDevice, buffer->buffer, &memReqs);
-		memAlloc.allocationSize = memReqs.size;
-		// Find a memory type index that fits the properties of the buffer
-		memAlloc.memoryTypeIndex = getMemoryType(memReqs.memoryTypeBits, memoryPropertyFlags);
 		// If the buffer has VK_BUFFER_USAGE_SHADER_DEVICE_ADDRESS_BIT set we also need to enable the appropriate flag during allocation
-		VkMemoryAllocateFlagsInfoKHR allocFlagsInfo{};
-		if (usageFlags & VK_BUFFER_USAGE_SHADER_DEVICE_ADDRESS_BIT) {
-			allocFlagsInfo.sType = VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_FLAGS_INFO_KHR;
-			allocFlagsInfo.flags = VK_MEMORY_ALLOCATE_DEVICE_ADDRESS_BIT_KHR;
-			memAlloc.pNext = &allocFlagsInfo;
-		}
-		VK_CHECK_RESULT(vkAllocateMemory(logicalDevice, &memAlloc, nullptr, &buffer->memory));
+		const VkMemoryAllocateFlags allocateFlags = (usageFlags & VK_BUFFER_USAGE_SHADER_DEVICE_ADDRESS_BIT) ? VK_MEMORY_ALLOCATE_DEVICE_ADDRESS_BIT : 0;
+		buffer->allocation = memoryAllocator.allocate(memReqs, memoryPropertyFlags, vks::ResourceType::Linear, vks::AllocationStrategy::Tlsf, allocateFlags);
+		buffer->memory = buffer->allocation->memory;
 
 		buffer->alignment = memReqs.alignment;
 		buffer->size = size;
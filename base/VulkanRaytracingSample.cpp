@@ -172,6 +172,7 @@ void VulkanRaytracingSample::createAccelerationStructure(AccelerationStructure&
 	accelerationStructureCreate_info.buffer = accelerationStructure.buffer;
 	accelerationStructureCreate_info.size = buildSizeInfo.accelerationStructureSize;
 	accelerationStructureCreate_info.type = type;
+	accelerationStructure.size = buildSizeInfo.accelerationStructureSize;
 	vkCreateAccelerationStructureKHR(vulkanDevice->logicalDevice, &accelerationStructureCreate_info, nullptr, &accelerationStructure.handle);
 	// AS device address
 	VkAccelerationStructureDeviceAddressInfoKHR accelerationDeviceAddressInfo{};
@@ -187,6 +188,213 @@ void VulkanRaytracingSample::deleteAccelerationStructure(AccelerationStructure&
 	vkDestroyAccelerationStructureKHR(device, accelerationStructure.handle, nullptr);
 }
 
+void VulkanRaytracingSample::reserveScratchPool(VkDeviceSize size)
+{
+	if (size <= scratchPoolSize) {
+		return;
+	}
+	// Only builds grow the pool, command buffers with updates recorded earlier would still point at the old one
+	// The current pool may still be in use by previously submitted builds
+	if (scratchPool.handle != VK_NULL_HANDLE) {
+		VK_CHECK_RESULT(vkQueueWaitIdle(queue));
+		deleteScratchBuffer(scratchPool);
+	}
+	// Allocate some extra space so the start of the pool can be aligned to the scratch offset alignment
+	scratchPool = createScratchBuffer(size + accelerationStructureProperties.minAccelerationStructureScratchOffsetAlignment);
+	scratchPoolSize = size;
+	accelerationStructureStatistics.scratchSize = size;
+}
+
+void VulkanRaytracingSample::recordAccelerationStructureBuilds(VkCommandBuffer commandBuffer, std::vector<AccelerationStructureBuild>& builds, bool update)
+{
+	const VkDeviceSize alignment = accelerationStructureProperties.minAccelerationStructureScratchOffsetAlignment;
+
+	// Split the builds into groups that share the scratch pool without overlapping, each group is built with a single command
+	// Groups are limited by the scratch budget, so very large batches reuse the same scratch memory
+	// Updates never grow the pool (see buildAccelerationStructures), so their groups are limited by its current size instead
+	const VkDeviceSize groupLimit = update ? std::min(accelerationStructureScratchBudget, scratchPoolSize) : accelerationStructureScratchBudget;
+	std::vector<size_t> groupStarts = { 0 };
+	VkDeviceSize groupScratchSize = 0;
+	VkDeviceSize poolSize = 0;
+	for (size_t i = 0; i < builds.size(); i++) {
+		const VkDeviceSize scratchSize = vks::tools::alignedVkSize(update ? builds[i].buildSizes.updateScratchSize : builds[i].buildSizes.buildScratchSize, alignment);
+		if ((i > groupStarts.back()) && (groupScratchSize + scratchSize > groupLimit)) {
+			groupStarts.push_back(i);
+			groupScratchSize = 0;
+		}
+		groupScratchSize += scratchSize;
+		poolSize = std::max(poolSize, groupScratchSize);
+	}
+	groupStarts.push_back(builds.size());
+	if (update) {
+		assert(poolSize <= scratchPoolSize);
+	} else {
+		reserveScratchPool(poolSize);
+	}
+	const VkDeviceAddress scratchAddress = vks::tools::alignedVkSize(scratchPool.deviceAddress, alignment);
+
+	VkMemoryBarrier memoryBarrier = vks::initializers::memoryBarrier();
+	memoryBarrier.srcAccessMask = VK_ACCESS_ACCELERATION_STRUCTURE_WRITE_BIT_KHR;
+	memoryBarrier.dstAccessMask = VK_ACCESS_ACCELERATION_STRUCTURE_READ_BIT_KHR | VK_ACCESS_ACCELERATION_STRUCTURE_WRITE_BIT_KHR;
+
+	for (size_t group = 0; group < groupStarts.size() - 1; group++) {
+		if (update && (group == 0)) {
+			// Updates overwrite structures and scratch memory that earlier commands (e.g. the previous frame) may still be using
+			vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_ALL_COMMANDS_BIT, VK_PIPELINE_STAGE_ACCELERATION_STRUCTURE_BUILD_BIT_KHR, 0, 1, &memoryBarrier, 0, nullptr, 0, nullptr);
+		}
+		if (group > 0) {
+			// The previous group has to finish with the scratch memory before it's reused
+			vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_ACCELERATION_STRUCTURE_BUILD_BIT_KHR, VK_PIPELINE_STAGE_ACCELERATION_STRUCTURE_BUILD_BIT_KHR, 0, 1, &memoryBarrier, 0, nullptr, 0, nullptr);
+		}
+		std::vector<VkAccelerationStructureBuildGeometryInfoKHR> buildGeometryInfos;
+		std::vector<const VkAccelerationStructureBuildRangeInfoKHR*> buildRangeInfos;
+		VkDeviceSize scratchOffset = 0;
+		for (size_t i = groupStarts[group]; i < groupStarts[group + 1]; i++) {
+			AccelerationStructureBuild& build = builds[i];
+			assert(!update || (build.flags & VK_BUILD_ACCELERATION_STRUCTURE_ALLOW_UPDATE_BIT_KHR));
+			VkAccelerationStructureBuildGeometryInfoKHR buildGeometryInfo = vks::initializers::accelerationStructureBuildGeometryInfoKHR();
+			buildGeometryInfo.type = build.type;
+			buildGeometryInfo.flags = build.flags;
+			// Updates refit the existing structure in place
+			buildGeometryInfo.mode = update ? VK_BUILD_ACCELERATION_STRUCTURE_MODE_UPDATE_KHR : VK_BUILD_ACCELERATION_STRUCTURE_MODE_BUILD_KHR;
+			buildGeometryInfo.srcAccelerationStructure = update ? build.accelerationStructure->handle : VK_NULL_HANDLE;
+			buildGeometryInfo.dstAccelerationStructure = build.accelerationStructure->handle;
+			buildGeometryInfo.geometryCount = static_cast<uint32_t>(build.geometries.size());
+			buildGeometryInfo.pGeometries = build.geometries.data();
+			buildGeometryInfo.scratchData.deviceAddress = scratchAddress + scratchOffset;
+			scratchOffset += vks::tools::alignedVkSize(update ? build.buildSizes.updateScratchSize : build.buildSizes.buildScratchSize, alignment);
+			buildGeometryInfos.push_back(buildGeometryInfo);
+			buildRangeInfos.push_back(build.buildRanges.data());
+		}
+		vkCmdBuildAccelerationStructuresKHR(commandBuffer, static_cast<uint32_t>(buildGeometryInfos.size()), buildGeometryInfos.data(), buildRangeInfos.data());
+	}
+}
+
+/*
+	Builds all acceleration structures in a single submission that shares one pooled scratch buffer
+	If compact is true, the structures are copied into allocations of their compacted size afterwards
+	Bottom level structures have to be built (and compacted) before the top level structures that reference their device addresses
+*/
+void VulkanRaytracingSample::buildAccelerationStructures(std::vector<AccelerationStructureBuild>& builds, bool compact)
+{
+	if (builds.empty()) {
+		return;
+	}
+	const uint32_t buildCount = static_cast<uint32_t>(builds.size());
+
+	// Get the size requirements and create the acceleration structures
+	VkDeviceSize buildSize = 0;
+	for (auto& build : builds) {
+		assert(build.accelerationStructure && (build.geometries.size() == build.buildRanges.size()));
+		if (compact) {
+			build.flags |= VK_BUILD_ACCELERATION_STRUCTURE_ALLOW_COMPACTION_BIT_KHR;
+		}
+		VkAccelerationStructureBuildGeometryInfoKHR buildGeometryInfo = vks::initializers::accelerationStructureBuildGeometryInfoKHR();
+		buildGeometryInfo.type = build.type;
+		buildGeometryInfo.flags = build.flags;
+		buildGeometryInfo.geometryCount = static_cast<uint32_t>(build.geometries.size());
+		buildGeometryInfo.pGeometries = build.geometries.data();
+		std::vector<uint32_t> maxPrimitiveCounts;
+		for (auto& buildRange : build.buildRanges) {
+			maxPrimitiveCounts.push_back(buildRange.primitiveCount);
+		}
+		build.buildSizes = vks::initializers::accelerationStructureBuildSizesInfoKHR();
+		vkGetAccelerationStructureBuildSizesKHR(device, VK_ACCELERATION_STRUCTURE_BUILD_TYPE_DEVICE_KHR, &buildGeometryInfo, maxPrimitiveCounts.data(), &build.buildSizes);
+		createAccelerationStructure(*build.accelerationStructure, build.type, build.buildSizes);
+		buildSize += build.accelerationStructure->size;
+		// Updates are recorded into command buffers that are reused, so the scratch memory they need has to exist before they are recorded
+		if (build.flags & VK_BUILD_ACCELERATION_STRUCTURE_ALLOW_UPDATE_BIT_KHR) {
+			reserveScratchPool(vks::tools::alignedVkSize(build.buildSizes.updateScratchSize, accelerationStructureProperties.minAccelerationStructureScratchOffsetAlignment));
+		}
+	}
+
+	// The compacted sizes are only known after the build, and are read back with a query
+	VkQueryPool queryPool = VK_NULL_HANDLE;
+	if (compact) {
+		VkQueryPoolCreateInfo queryPoolInfo = {};
+		queryPoolInfo.sType = VK_STRUCTURE_TYPE_QUERY_POOL_CREATE_INFO;
+		queryPoolInfo.queryType = VK_QUERY_TYPE_ACCELERATION_STRUCTURE_COMPACTED_SIZE_KHR;
+		queryPoolInfo.queryCount = buildCount;
+		VK_CHECK_RESULT(vkCreateQueryPool(device, &queryPoolInfo, nullptr, &queryPool));
+	}
+
+	// Build everything via a single one-time command buffer submission
+	VkCommandBuffer commandBuffer = vulkanDevice->createCommandBuffer(VK_COMMAND_BUFFER_LEVEL_PRIMARY, true);
+	recordAccelerationStructureBuilds(commandBuffer, builds, false);
+	if (compact) {
+		VkMemoryBarrier memoryBarrier = vks::initializers::memoryBarrier();
+		memoryBarrier.srcAccessMask = VK_ACCESS_ACCELERATION_STRUCTURE_WRITE_BIT_KHR;
+		memoryBarrier.dstAccessMask = VK_ACCESS_ACCELERATION_STRUCTURE_READ_BIT_KHR;
+		vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_ACCELERATION_STRUCTURE_BUILD_BIT_KHR, VK_PIPELINE_STAGE_ACCELERATION_STRUCTURE_BUILD_BIT_KHR, 0, 1, &memoryBarrier, 0, nullptr, 0, nullptr);
+		std::vector<VkAccelerationStructureKHR> handles;
+		for (auto& build : builds) {
+			handles.push_back(build.accelerationStructure->handle);
+		}
+		vkCmdResetQueryPool(commandBuffer, queryPool, 0, buildCount);
+		vkCmdWriteAccelerationStructuresPropertiesKHR(commandBuffer, buildCount, handles.data(), VK_QUERY_TYPE_ACCELERATION_STRUCTURE_COMPACTED_SIZE_KHR, queryPool, 0);
+	}
+	vulkanDevice->flushCommandBuffer(commandBuffer, queue);
+	accelerationStructureStatistics.submissions++;
+
+	VkDeviceSize compactedSize = buildSize;
+	if (compact) {
+		std::vector<VkDeviceSize> compactedSizes(buildCount);
+		VK_CHECK_RESULT(vkGetQueryPoolResults(device, queryPool, 0, buildCount, buildCount * sizeof(VkDeviceSize), compactedSizes.data(), sizeof(VkDeviceSize), VK_QUERY_RESULT_64_BIT | VK_QUERY_RESULT_WAIT_BIT));
+		vkDestroyQueryPool(device, queryPool, nullptr);
+
+		// Copy all structures into new ones of their compacted size, again with a single submission
+		std::vector<AccelerationStructure> uncompacted(buildCount);
+		commandBuffer = vulkanDevice->createCommandBuffer(VK_COMMAND_BUFFER_LEVEL_PRIMARY, true);
+		compactedSize = 0;
+		for (uint32_t i = 0; i < buildCount; i++) {
+			AccelerationStructure& accelerationStructure = *builds[i].accelerationStructure;
+			uncompacted[i] = accelerationStructure;
+			VkAccelerationStructureBuildSizesInfoKHR compactedSizeInfo = builds[i].buildSizes;
+			compactedSizeInfo.accelerationStructureSize = compactedSizes[i];
+			createAccelerationStructure(accelerationStructure, builds[i].type, compactedSizeInfo);
+			compactedSize += accelerationStructure.size;
+			VkCopyAccelerationStructureInfoKHR copyInfo{};
+			copyInfo.sType = VK_STRUCTURE_TYPE_COPY_ACCELERATION_STRUCTURE_INFO_KHR;
+			copyInfo.src = uncompacted[i].handle;
+			copyInfo.dst = accelerationStructure.handle;
+			copyInfo.mode = VK_COPY_ACCELERATION_STRUCTURE_MODE_COMPACT_KHR;
+			vkCmdCopyAccelerationStructureKHR(commandBuffer, &copyInfo);
+		}
+		vulkanDevice->flushCommandBuffer(commandBuffer, queue);
+		accelerationStructureStatistics.submissions++;
+		for (auto& accelerationStructure : uncompacted) {
+			deleteAccelerationStructure(accelerationStructure);
+		}
+	}
+
+	accelerationStructureStatistics.count += buildCount;
+	accelerationStructureStatistics.buildSize += buildSize;
+	accelerationStructureStatistics.compactedSize += compactedSize;
+	std::cout << "Built " << buildCount << " acceleration structure(s) with " << scratchPoolSize / 1024 << " KB of pooled scratch memory, " << buildSize / 1024 << " KB";
+	if (compact) {
+		std::cout << " compacted to " << compactedSize / 1024 << " KB (" << (buildSize - compactedSize) * 100 / buildSize << "% saved)";
+	}
+	std::cout << "\n";
+}
+
+/*
+	Refits acceleration structures built with VK_BUILD_ACCELERATION_STRUCTURE_ALLOW_UPDATE_BIT_KHR to changed geometry (e.g. animated vertices or instance transforms)
+	The update is recorded into the given command buffer, so it can be done once per frame ahead of ray traversal
+	The scratch memory for updates is reserved when the structures are built, so update commands have to be recorded after all builds
+*/
+void VulkanRaytracingSample::updateAccelerationStructures(VkCommandBuffer commandBuffer, std::vector<AccelerationStructureBuild>& builds)
+{
+	if (builds.empty()) {
+		return;
+	}
+	recordAccelerationStructureBuilds(commandBuffer, builds, true);
+	// Make the refitted structures visible to later builds and to ray traversal
+	VkMemoryBarrier memoryBarrier = vks::initializers::memoryBarrier();
+	memoryBarrier.srcAccessMask = VK_ACCESS_ACCELERATION_STRUCTURE_WRITE_BIT_KHR;
+	memoryBarrier.dstAccessMask = VK_ACCESS_ACCELERATION_STRUCTURE_READ_BIT_KHR;
+	vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_ACCELERATION_STRUCTURE_BUILD_BIT_KHR, VK_PIPELINE_STAGE_ALL_COMMANDS_BIT, 0, 1, &memoryBarrier, 0, nullptr, 0, nullptr);
+}
+
 uint64_t VulkanRaytracingSample::getBufferDeviceAddress(VkBuffer buffer)
 {
 	VkBufferDeviceAddressInfoKHR bufferDeviceAI{};
@@ -252,11 +460,18 @@ void VulkanRaytracingSample::deleteStorageImage()
 	vkFreeMemory(vulkanDevice->logicalDevice, storageImage.memory, nullptr);
 }
 
+VulkanRaytracingSample::~VulkanRaytracingSample()
+{
+	deleteScratchBuffer(scratchPool);
+}
+
 void VulkanRaytracingSample::prepare()
 {
 	VulkanExampleBase::prepare();
 	// Get properties and features
 	rayTracingPipelineProperties.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_RAY_TRACING_PIPELINE_PROPERTIES_KHR;
+	rayTracingPipelineProperties.pNext = &accelerationStructureProperties;
+	accelerationStructureProperties.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_ACCELERATION_STRUCTURE_PROPERTIES_KHR;
 	VkPhysicalDeviceProperties2 deviceProperties2{};
 	deviceProperties2.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_PROPERTIES_2;
 	deviceProperties2.pNext = &rayTracingPipelineProperties;
@@ -269,6 +484,8 @@ void VulkanRaytracingSample::prepare()
 	// Get the function pointers required for ray tracing
 	vkGetBufferDeviceAddressKHR = reinterpret_cast<PFN_vkGetBufferDeviceAddressKHR>(vkGetDeviceProcAddr(device, "vkGetBufferDeviceAddressKHR"));
 	vkCmdBuildAccelerationStructuresKHR = reinterpret_cast<PFN_vkCmdBuildAccelerationStructuresKHR>(vkGetDeviceProcAddr(device, "vkCmdBuildAccelerationStructuresKHR"));
+	vkCmdWriteAccelerationStructuresPropertiesKHR = reinterpret_cast<PFN_vkCmdWriteAccelerationStructuresPropertiesKHR>(vkGetDeviceProcAddr(device, "vkCmdWriteAccelerationStructuresPropertiesKHR"));
+	vkCmdCopyAccelerationStructureKHR = reinterpret_cast<PFN_vkCmdCopyAccelerationStructureKHR>(vkGetDeviceProcAddr(device, "vkCmdCopyAccelerationStructureKHR"));
 	vkBuildAccelerationStructuresKHR = reinterpret_cast<PFN_vkBuildAccelerationStructuresKHR>(vkGetDeviceProcAddr(device, "vkBuildAccelerationStructuresKHR"));
 	vkCreateAccelerationStructureKHR = reinterpret_cast<PFN_vkCreateAccelerationStructureKHR>(vkGetDeviceProcAddr(device, "vkCreateAccelerationStructureKHR"));
 	vkDestroyAccelerationStructureKHR = reinterpret_cast<PFN_vkDestroyAccelerationStructureKHR>(vkGetDeviceProcAddr(device, "vkDestroyAccelerationStructureKHR"));
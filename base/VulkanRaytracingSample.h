@@ -27,12 +27,15 @@ public:
 	PFN_vkGetAccelerationStructureDeviceAddressKHR vkGetAccelerationStructureDeviceAddressKHR;
 	PFN_vkBuildAccelerationStructuresKHR vkBuildAccelerationStructuresKHR;
 	PFN_vkCmdBuildAccelerationStructuresKHR vkCmdBuildAccelerationStructuresKHR;
+	PFN_vkCmdWriteAccelerationStructuresPropertiesKHR vkCmdWriteAccelerationStructuresPropertiesKHR;
+	PFN_vkCmdCopyAccelerationStructureKHR vkCmdCopyAccelerationStructureKHR;
 	PFN_vkCmdTraceRaysKHR vkCmdTraceRaysKHR;
 	PFN_vkGetRayTracingShaderGroupHandlesKHR vkGetRayTracingShaderGroupHandlesKHR;
 	PFN_vkCreateRayTracingPipelinesKHR vkCreateRayTracingPipelinesKHR;
 
 	// Available features and properties
 	VkPhysicalDeviceRayTracingPipelinePropertiesKHR  rayTracingPipelineProperties{};
+	VkPhysicalDeviceAccelerationStructurePropertiesKHR accelerationStructureProperties{};
 	VkPhysicalDeviceAccelerationStructureFeaturesKHR accelerationStructureFeatures{};
 
 	// Enabled features and properties
@@ -50,12 +53,42 @@ public:
 
 	// Holds information for a ray tracing acceleration structure
 	struct AccelerationStructure {
-		VkAccelerationStructureKHR handle;
+		VkAccelerationStructureKHR handle = VK_NULL_HANDLE;
 		uint64_t deviceAddress = 0;
-		VkDeviceMemory memory;
-		VkBuffer buffer;
+		VkDeviceMemory memory = VK_NULL_HANDLE;
+		VkBuffer buffer = VK_NULL_HANDLE;
+		VkDeviceSize size = 0;
+	};
+
+	// Describes the input for one acceleration structure built by buildAccelerationStructures
+	// The geometries and build ranges have to stay valid for later calls to updateAccelerationStructures
+	struct AccelerationStructureBuild {
+		// Receives the built (and possibly compacted) acceleration structure
+		AccelerationStructure* accelerationStructure = nullptr;
+		VkAccelerationStructureTypeKHR type = VK_ACCELERATION_STRUCTURE_TYPE_BOTTOM_LEVEL_KHR;
+		// Add VK_BUILD_ACCELERATION_STRUCTURE_ALLOW_UPDATE_BIT_KHR for geometry that is refitted with updateAccelerationStructures
+		VkBuildAccelerationStructureFlagsKHR flags = VK_BUILD_ACCELERATION_STRUCTURE_PREFER_FAST_TRACE_BIT_KHR;
+		std::vector<VkAccelerationStructureGeometryKHR> geometries;
+		std::vector<VkAccelerationStructureBuildRangeInfoKHR> buildRanges;
+		// Filled in by the builder
+		VkAccelerationStructureBuildSizesInfoKHR buildSizes{};
 	};
 
+	// Accumulated statistics of all acceleration structures built by buildAccelerationStructures
+	struct AccelerationStructureStatistics {
+		uint32_t count = 0;
+		uint32_t submissions = 0;
+		// Size of all acceleration structures before and after compaction
+		VkDeviceSize buildSize = 0;
+		VkDeviceSize compactedSize = 0;
+		// Size of the shared scratch pool
+		VkDeviceSize scratchSize = 0;
+	} accelerationStructureStatistics;
+
+	// Upper limit for the scratch memory shared by the builds of one batch
+	// Builds that don't fit are split into several groups separated by barriers, a single larger build grows the pool
+	VkDeviceSize accelerationStructureScratchBudget = 64 * 1024 * 1024;
+
 	// Holds information for a storage image that the ray tracing shaders output to
 	struct StorageImage {
 		VkDeviceMemory memory = VK_NULL_HANDLE;
@@ -78,6 +111,8 @@ public:
 	void deleteScratchBuffer(ScratchBuffer& scratchBuffer);
 	void createAccelerationStructure(AccelerationStructure& accelerationStructure, VkAccelerationStructureTypeKHR type, VkAccelerationStructureBuildSizesInfoKHR buildSizeInfo);
 	void deleteAccelerationStructure(AccelerationStructure& accelerationStructure);
+	void buildAccelerationStructures(std::vector<AccelerationStructureBuild>& builds, bool compact);
+	void updateAccelerationStructures(VkCommandBuffer commandBuffer, std::vector<AccelerationStructureBuild>& builds);
 	uint64_t getBufferDeviceAddress(VkBuffer buffer);
 	void createStorageImage(VkFormat format, VkExtent3D extent);
 	void deleteStorageImage();
@@ -86,5 +121,12 @@ public:
 	// Draw the ImGUI UI overlay using a render pass
 	void drawUI(VkCommandBuffer commandBuffer, VkFramebuffer framebuffer);
 
+	virtual ~VulkanRaytracingSample();
 	virtual void prepare();
+private:
+	// Scratch memory shared by all acceleration structure builds and updates
+	ScratchBuffer scratchPool{};
+	VkDeviceSize scratchPoolSize = 0;
+	void reserveScratchPool(VkDeviceSize size);
+	void recordAccelerationStructureBuilds(VkCommandBuffer commandBuffer, std::vector<AccelerationStructureBuild>& builds, bool update);
 };
@@ -364,6 +364,7 @@ void VulkanSwapChain::create(uint32_t *width, uint32_t *height, bool vsync, bool
 	}
 
 	VK_CHECK_RESULT(fpCreateSwapchainKHR(device, &swapchainCI, nullptr, &swapChain));
+	imageUsage = swapchainCI.imageUsage;
 
 	// If an existing swap chain is re-created, destroy the old swap chain
 	// This also cleans up all the presentable images
@@ -411,6 +412,93 @@ void VulkanSwapChain::create(uint32_t *width, uint32_t *height, bool vsync, bool
 	}
 }
 
+/**
+* Create a ring of device local images that are rendered to instead of presentable swap chain images
+* This allows running without a window, surface or presentation support. The images can be copied from, e.g. to save rendered frames
+*
+* @param width Width of the images
+* @param height Height of the images
+* @param queue Queue that the semaphores passed to acquireNextImage are signaled on
+* @param queueFamilyIndex Queue family of the queue, is stored as queueNodeIndex
+* @param imageCount (Optional) Number of images in the ring
+*/
+void VulkanSwapChain::createOffscreen(uint32_t width, uint32_t height, VkQueue queue, uint32_t queueFamilyIndex, uint32_t imageCount)
+{
+	offscreen = true;
+	offscreenQueue = queue;
+	offscreenImageIndex = 0;
+	queueNodeIndex = queueFamilyIndex;
+	this->imageCount = imageCount;
+
+	// Prefer the format most surfaces offer, so render passes and pipelines behave the same as with a window
+	colorFormat = VK_FORMAT_B8G8R8A8_UNORM;
+	colorSpace = VK_COLOR_SPACE_SRGB_NONLINEAR_KHR;
+	const VkFormatFeatureFlags requiredFeatures = VK_FORMAT_FEATURE_COLOR_ATTACHMENT_BIT | VK_FORMAT_FEATURE_TRANSFER_SRC_BIT;
+	VkFormatProperties formatProperties;
+	vkGetPhysicalDeviceFormatProperties(physicalDevice, colorFormat, &formatProperties);
+	if ((formatProperties.optimalTilingFeatures & requiredFeatures) != requiredFeatures)
+	{
+		colorFormat = VK_FORMAT_R8G8B8A8_UNORM;
+	}
+
+	VkPhysicalDeviceMemoryProperties memoryProperties;
+	vkGetPhysicalDeviceMemoryProperties(physicalDevice, &memoryProperties);
+
+	imageUsage = VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT | VK_IMAGE_USAGE_TRANSFER_SRC_BIT | VK_IMAGE_USAGE_TRANSFER_DST_BIT;
+	images.resize(imageCount);
+	buffers.resize(imageCount);
+	offscreenMemory.resize(imageCount);
+	for (uint32_t i = 0; i < imageCount; i++)
+	{
+		VkImageCreateInfo imageCI = {};
+		imageCI.sType = VK_STRUCTURE_TYPE_IMAGE_CREATE_INFO;
+		imageCI.imageType = VK_IMAGE_TYPE_2D;
+		imageCI.format = colorFormat;
+		imageCI.extent = { width, height, 1 };
+		imageCI.mipLevels = 1;
+		imageCI.arrayLayers = 1;
+		imageCI.samples = VK_SAMPLE_COUNT_1_BIT;
+		imageCI.tiling = VK_IMAGE_TILING_OPTIMAL;
+		// Same usage as swap chain images with transfer support
+		imageCI.usage = imageUsage;
+		imageCI.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
+		imageCI.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+		VK_CHECK_RESULT(vkCreateImage(device, &imageCI, nullptr, &images[i]));
+
+		VkMemoryRequirements memReqs;
+		vkGetImageMemoryRequirements(device, images[i], &memReqs);
+		VkMemoryAllocateInfo memAlloc = {};
+		memAlloc.sType = VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO;
+		memAlloc.allocationSize = memReqs.size;
+		memAlloc.memoryTypeIndex = UINT32_MAX;
+		for (uint32_t j = 0; j < memoryProperties.memoryTypeCount; j++)
+		{
+			if ((memReqs.memoryTypeBits & (1 << j)) && (memoryProperties.memoryTypes[j].propertyFlags & VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT))
+			{
+				memAlloc.memoryTypeIndex = j;
+				break;
+			}
+		}
+		if (memAlloc.memoryTypeIndex == UINT32_MAX)
+		{
+			vks::tools::exitFatal("Could not find a suitable memory type for the offscreen images!", -1);
+		}
+		VK_CHECK_RESULT(vkAllocateMemory(device, &memAlloc, nullptr, &offscreenMemory[i]));
+		VK_CHECK_RESULT(vkBindImageMemory(device, images[i], offscreenMemory[i], 0));
+
+		VkImageViewCreateInfo colorAttachmentView = {};
+		colorAttachmentView.sType = VK_STRUCTURE_TYPE_IMAGE_VIEW_CREATE_INFO;
+		colorAttachmentView.viewType = VK_IMAGE_VIEW_TYPE_2D;
+		colorAttachmentView.format = colorFormat;
+		colorAttachmentView.subresourceRange.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+		colorAttachmentView.subresourceRange.levelCount = 1;
+		colorAttachmentView.subresourceRange.layerCount = 1;
+		colorAttachmentView.image = images[i];
+		VK_CHECK_RESULT(vkCreateImageView(device, &colorAttachmentView, nullptr, &buffers[i].view));
+		buffers[i].image = images[i];
+	}
+}
+
 /** 
 * Acquires the next image in the swap chain
 *
@@ -423,6 +511,21 @@ void VulkanSwapChain::create(uint32_t *width, uint32_t *height, bool vsync, bool
 */
 VkResult VulkanSwapChain::acquireNextImage(VkSemaphore presentCompleteSemaphore, uint32_t *imageIndex)
 {
+	if (offscreen)
+	{
+		// Offscreen images are used in order and are available right away, the semaphore still needs to be signaled for the submissions waiting on it
+		*imageIndex = offscreenImageIndex;
+		offscreenImageIndex = (offscreenImageIndex + 1) % imageCount;
+		if (presentCompleteSemaphore == VK_NULL_HANDLE)
+		{
+			return VK_SUCCESS;
+		}
+		VkSubmitInfo submitInfo = {};
+		submitInfo.sType = VK_STRUCTURE_TYPE_SUBMIT_INFO;
+		submitInfo.signalSemaphoreCount = 1;
+		submitInfo.pSignalSemaphores = &presentCompleteSemaphore;
+		return vkQueueSubmit(offscreenQueue, 1, &submitInfo, VK_NULL_HANDLE);
+	}
 	// By setting timeout to UINT64_MAX we will always wait until the next image has been acquired or an actual error is thrown
 	// With that we don't have to handle VK_NOT_READY
 	return fpAcquireNextImageKHR(device, swapChain, UINT64_MAX, presentCompleteSemaphore, (VkFence)nullptr, imageIndex);
@@ -439,6 +542,21 @@ VkResult VulkanSwapChain::acquireNextImage(VkSemaphore presentCompleteSemaphore,
 */
 VkResult VulkanSwapChain::queuePresent(VkQueue queue, uint32_t imageIndex, VkSemaphore waitSemaphore)
 {
+	if (offscreen)
+	{
+		// Nothing is presented, but the semaphore has to be waited on so it can be signaled again
+		if (waitSemaphore == VK_NULL_HANDLE)
+		{
+			return VK_SUCCESS;
+		}
+		VkPipelineStageFlags waitStageMask = VK_PIPELINE_STAGE_ALL_COMMANDS_BIT;
+		VkSubmitInfo submitInfo = {};
+		submitInfo.sType = VK_STRUCTURE_TYPE_SUBMIT_INFO;
+		submitInfo.waitSemaphoreCount = 1;
+		submitInfo.pWaitSemaphores = &waitSemaphore;
+		submitInfo.pWaitDstStageMask = &waitStageMask;
+		return vkQueueSubmit(queue, 1, &submitInfo, VK_NULL_HANDLE);
+	}
 	VkPresentInfoKHR presentInfo = {};
 	presentInfo.sType = VK_STRUCTURE_TYPE_PRESENT_INFO_KHR;
 	presentInfo.pNext = NULL;
@@ -460,6 +578,17 @@ VkResult VulkanSwapChain::queuePresent(VkQueue queue, uint32_t imageIndex, VkSem
 */
 void VulkanSwapChain::cleanup()
 {
+	if (offscreen)
+	{
+		for (uint32_t i = 0; i < imageCount; i++)
+		{
+			vkDestroyImageView(device, buffers[i].view, nullptr);
+			vkDestroyImage(device, images[i], nullptr);
+			vkFreeMemory(device, offscreenMemory[i], nullptr);
+		}
+		offscreenMemory.clear();
+		offscreen = false;
+	}
 	if (swapChain != VK_NULL_HANDLE)
 	{
 		for (uint32_t i = 0; i < imageCount; i++)
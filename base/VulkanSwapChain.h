@@ -38,7 +38,12 @@ private:
 	VkInstance instance;
 	VkDevice device;
 	VkPhysicalDevice physicalDevice;
-	VkSurfaceKHR surface;
+	VkSurfaceKHR surface = VK_NULL_HANDLE;
+	// Memory backing the images of an offscreen swap chain
+	std::vector<VkDeviceMemory> offscreenMemory;
+	// Queue used to signal and wait on the semaphores of an offscreen swap chain
+	VkQueue offscreenQueue = VK_NULL_HANDLE;
+	uint32_t offscreenImageIndex = 0;
 	// Function pointers
 	PFN_vkGetPhysicalDeviceSurfaceSupportKHR fpGetPhysicalDeviceSurfaceSupportKHR;
 	PFN_vkGetPhysicalDeviceSurfaceCapabilitiesKHR fpGetPhysicalDeviceSurfaceCapabilitiesKHR; 
@@ -57,6 +62,10 @@ public:
 	std::vector<VkImage> images;
 	std::vector<SwapChainBuffer> buffers;
 	uint32_t queueNodeIndex = UINT32_MAX;
+	/** @brief Usage flags the images have been created with (e.g. to check if they can be copied from) */
+	VkImageUsageFlags imageUsage = 0;
+	/** @brief Set if the images are an internal ring created by createOffscreen instead of being owned by a presentation engine */
+	bool offscreen = false;
 
 #if defined(VK_USE_PLATFORM_WIN32_KHR)
 	void initSurface(void* platformHandle, void* platformWindow);
@@ -78,6 +87,7 @@ public:
 #endif
 	void connect(VkInstance instance, VkPhysicalDevice physicalDevice, VkDevice device);
 	void create(uint32_t* width, uint32_t* height, bool vsync = false, bool fullscreen = false);
+	void createOffscreen(uint32_t width, uint32_t height, VkQueue queue, uint32_t queueFamilyIndex, uint32_t imageCount = 3);
 	VkResult acquireNextImage(VkSemaphore presentCompleteSemaphore, uint32_t* imageIndex);
 	VkResult queuePresent(VkQueue queue, uint32_t imageIndex, VkSemaphore waitSemaphore = VK_NULL_HANDLE);
 	void cleanup();
@@ -35,6 +35,8 @@ class Texture
 	VkImage               image;
 	VkImageLayout         imageLayout;
 	VkDeviceMemory        deviceMemory;
+	/** @brief Memory allocator range the image is bound to, nullptr if the image has its own device memory */
+	vks::Allocation *     allocation = nullptr;
 	VkImageView           view;
 	uint32_t              width, height;
 	uint32_t              mipLevels;
@@ -399,5 +399,10 @@ namespace vks
 	        return (value + alignment - 1) & ~(alignment - 1);
         }
 
+		VkDeviceSize alignedVkSize(VkDeviceSize value, VkDeviceSize alignment)
+		{
+			return (value + alignment - 1) & ~(alignment - 1);
+		}
+
 	}
 }
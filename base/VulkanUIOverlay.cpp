@@ -310,59 +310,102 @@ namespace vks
 		VK_CHECK_RESULT(vkCreateGraphicsPipelines(device->logicalDevice, pipelineCache, 1, &pipelineCreateInfo, nullptr, &pipeline));
 	}
 
-	/** Update vertex and index buffer containing the imGui elements when required */
+	// Scissor rectangle of an ImGui draw command in framebuffer coordinates
+	static VkRect2D getScissor(const ImDrawCmd* drawCmd)
+	{
+		VkRect2D scissorRect;
+		scissorRect.offset.x = std::max((int32_t)(drawCmd->ClipRect.x), 0);
+		scissorRect.offset.y = std::max((int32_t)(drawCmd->ClipRect.y), 0);
+		scissorRect.extent.width = (uint32_t)(drawCmd->ClipRect.z - drawCmd->ClipRect.x);
+		scissorRect.extent.height = (uint32_t)(drawCmd->ClipRect.w - drawCmd->ClipRect.y);
+		return scissorRect;
+	}
+
+	static VkDeviceSize alignOffset(VkDeviceSize offset)
+	{
+		return (offset + 15) & ~VkDeviceSize(15);
+	}
+
+	/**
+	* Update vertex and index buffer containing the imGui elements when required
+	* The current ImGui draw data is written to the geometry buffer of the current frame
+	*
+	* @return True if the command buffers need to be recorded again, which is only the case if the buffer had to grow or
+	* the number of draws or their scissor rectangles changed
+	*/
 	bool UIOverlay::update()
 	{
 		ImDrawData* imDrawData = ImGui::GetDrawData();
-		bool updateCmdBuffers = false;
-
 		if (!imDrawData) { return false; };
 
-		// Note: Alignment is done inside buffer creation
-		VkDeviceSize vertexBufferSize = imDrawData->TotalVtxCount * sizeof(ImDrawVert);
-		VkDeviceSize indexBufferSize = imDrawData->TotalIdxCount * sizeof(ImDrawIdx);
+		Geometry& frameGeometry = geometry[currentGeometry];
+		bool updateCmdBuffers = false;
 
-		// Update buffers only if vertex or index count has been changed compared to current buffer size
-		if ((vertexBufferSize == 0) || (indexBufferSize == 0)) {
-			return false;
+		uint32_t commandCount = 0;
+		for (int32_t i = 0; i < imDrawData->CmdListsCount; i++) {
+			commandCount += imDrawData->CmdLists[i]->CmdBuffer.Size;
 		}
-
-		// Vertex buffer
-		if ((vertexBuffer.buffer == VK_NULL_HANDLE) || (vertexCount != imDrawData->TotalVtxCount)) {
-			vertexBuffer.unmap();
-			vertexBuffer.destroy();
-			VK_CHECK_RESULT(device->createBuffer(VK_BUFFER_USAGE_VERTEX_BUFFER_BIT, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT, &vertexBuffer, vertexBufferSize));
-			vertexCount = imDrawData->TotalVtxCount;
-			vertexBuffer.unmap();
-			vertexBuffer.map();
-			updateCmdBuffers = true;
+		const uint32_t vertexCount = (uint32_t)imDrawData->TotalVtxCount;
+		const uint32_t indexCount = (uint32_t)imDrawData->TotalIdxCount;
+		if ((vertexCount == 0) || (indexCount == 0)) {
+			commandCount = 0;
 		}
 
-		// Index buffer
-		if ((indexBuffer.buffer == VK_NULL_HANDLE) || (indexCount < imDrawData->TotalIdxCount)) {
-			indexBuffer.unmap();
-			indexBuffer.destroy();
-			VK_CHECK_RESULT(device->createBuffer(VK_BUFFER_USAGE_INDEX_BUFFER_BIT, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT, &indexBuffer, indexBufferSize));
-			indexCount = imDrawData->TotalIdxCount;
-			indexBuffer.map();
+		// Grow geometrically with some headroom, so the buffer is only reallocated a few times at startup
+		if ((frameGeometry.buffer.buffer == VK_NULL_HANDLE) || (commandCount > frameGeometry.commandCapacity) || (vertexCount > frameGeometry.vertexCapacity) || (indexCount > frameGeometry.indexCapacity)) {
+			frameGeometry.commandCapacity = std::max({ commandCount + commandCount / 2, frameGeometry.commandCapacity * 2, 64u });
+			frameGeometry.vertexCapacity = std::max({ vertexCount + vertexCount / 2, frameGeometry.vertexCapacity * 2, 4096u });
+			frameGeometry.indexCapacity = std::max({ indexCount + indexCount / 2, frameGeometry.indexCapacity * 2, 8192u });
+			frameGeometry.vertexOffset = alignOffset(frameGeometry.commandCapacity * sizeof(VkDrawIndexedIndirectCommand));
+			frameGeometry.indexOffset = alignOffset(frameGeometry.vertexOffset + frameGeometry.vertexCapacity * sizeof(ImDrawVert));
+			const VkDeviceSize bufferSize = frameGeometry.indexOffset + frameGeometry.indexCapacity * sizeof(ImDrawIdx);
+			// The buffer isn't in use anymore, as the frame it belongs to has finished
+			frameGeometry.buffer.destroy();
+			VK_CHECK_RESULT(device->createBuffer(VK_BUFFER_USAGE_VERTEX_BUFFER_BIT | VK_BUFFER_USAGE_INDEX_BUFFER_BIT | VK_BUFFER_USAGE_INDIRECT_BUFFER_BIT, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT, &frameGeometry.buffer, bufferSize));
+			VK_CHECK_RESULT(frameGeometry.buffer.map());
 			updateCmdBuffers = true;
 		}
 
 		// Upload data
-		ImDrawVert* vtxDst = (ImDrawVert*)vertexBuffer.mapped;
-		ImDrawIdx* idxDst = (ImDrawIdx*)indexBuffer.mapped;
+		uint8_t* mapped = static_cast<uint8_t*>(frameGeometry.buffer.mapped);
+		VkDrawIndexedIndirectCommand* cmdDst = reinterpret_cast<VkDrawIndexedIndirectCommand*>(mapped);
+		ImDrawVert* vtxDst = reinterpret_cast<ImDrawVert*>(mapped + frameGeometry.vertexOffset);
+		ImDrawIdx* idxDst = reinterpret_cast<ImDrawIdx*>(mapped + frameGeometry.indexOffset);
 
-		for (int n = 0; n < imDrawData->CmdListsCount; n++) {
-			const ImDrawList* cmd_list = imDrawData->CmdLists[n];
+		uint32_t commandIndex = 0;
+		int32_t vertexOffset = 0;
+		uint32_t indexOffset = 0;
+		if (frameGeometry.scissors.size() != commandCount) {
+			frameGeometry.scissors.resize(commandCount);
+			updateCmdBuffers = true;
+		}
+		for (int32_t i = 0; (i < imDrawData->CmdListsCount) && (commandCount > 0); i++) {
+			const ImDrawList* cmd_list = imDrawData->CmdLists[i];
 			memcpy(vtxDst, cmd_list->VtxBuffer.Data, cmd_list->VtxBuffer.Size * sizeof(ImDrawVert));
 			memcpy(idxDst, cmd_list->IdxBuffer.Data, cmd_list->IdxBuffer.Size * sizeof(ImDrawIdx));
 			vtxDst += cmd_list->VtxBuffer.Size;
 			idxDst += cmd_list->IdxBuffer.Size;
+			for (int32_t j = 0; j < cmd_list->CmdBuffer.Size; j++) {
+				const ImDrawCmd* pcmd = &cmd_list->CmdBuffer[j];
+				cmdDst[commandIndex].indexCount = pcmd->ElemCount;
+				cmdDst[commandIndex].instanceCount = 1;
+				cmdDst[commandIndex].firstIndex = indexOffset;
+				cmdDst[commandIndex].vertexOffset = vertexOffset;
+				cmdDst[commandIndex].firstInstance = 0;
+				const VkRect2D scissorRect = getScissor(pcmd);
+				VkRect2D& recordedScissor = frameGeometry.scissors[commandIndex];
+				if (memcmp(&scissorRect, &recordedScissor, sizeof(VkRect2D)) != 0) {
+					recordedScissor = scissorRect;
+					updateCmdBuffers = true;
+				}
+				indexOffset += pcmd->ElemCount;
+				commandIndex++;
+			}
+			vertexOffset += cmd_list->VtxBuffer.Size;
 		}
 
 		// Flush to make writes visible to GPU
-		vertexBuffer.flush();
-		indexBuffer.flush();
+		frameGeometry.buffer.flush();
 
 		return updateCmdBuffers;
 	}
@@ -370,10 +413,9 @@ namespace vks
 	void UIOverlay::draw(const VkCommandBuffer commandBuffer)
 	{
 		ImDrawData* imDrawData = ImGui::GetDrawData();
-		int32_t vertexOffset = 0;
-		int32_t indexOffset = 0;
+		const Geometry& frameGeometry = geometry[currentGeometry];
 
-		if ((!imDrawData) || (imDrawData->CmdListsCount == 0)) {
+		if ((!imDrawData) || (imDrawData->CmdListsCount == 0) || (frameGeometry.buffer.buffer == VK_NULL_HANDLE)) {
 			return;
 		}
 
@@ -386,26 +428,14 @@ namespace vks
 		pushConstBlock.translate = glm::vec2(-1.0f);
 		vkCmdPushConstants(commandBuffer, pipelineLayout, VK_SHADER_STAGE_VERTEX_BIT, 0, sizeof(PushConstBlock), &pushConstBlock);
 
-		VkDeviceSize offsets[1] = { 0 };
-		vkCmdBindVertexBuffers(commandBuffer, 0, 1, &vertexBuffer.buffer, offsets);
-		vkCmdBindIndexBuffer(commandBuffer, indexBuffer.buffer, 0, VK_INDEX_TYPE_UINT16);
+		vkCmdBindVertexBuffers(commandBuffer, 0, 1, &frameGeometry.buffer.buffer, &frameGeometry.vertexOffset);
+		vkCmdBindIndexBuffer(commandBuffer, frameGeometry.buffer.buffer, frameGeometry.indexOffset, VK_INDEX_TYPE_UINT16);
 
-		for (int32_t i = 0; i < imDrawData->CmdListsCount; i++)
+		// Index counts and offsets are read from the buffer at execution time, only the scissors are part of the command buffer
+		for (uint32_t i = 0; i < (uint32_t)frameGeometry.scissors.size(); i++)
 		{
-			const ImDrawList* cmd_list = imDrawData->CmdLists[i];
-			for (int32_t j = 0; j < cmd_list->CmdBuffer.Size; j++)
-			{
-				const ImDrawCmd* pcmd = &cmd_list->CmdBuffer[j];
-				VkRect2D scissorRect;
-				scissorRect.offset.x = std::max((int32_t)(pcmd->ClipRect.x), 0);
-				scissorRect.offset.y = std::max((int32_t)(pcmd->ClipRect.y), 0);
-				scissorRect.extent.width = (uint32_t)(pcmd->ClipRect.z - pcmd->ClipRect.x);
-				scissorRect.extent.height = (uint32_t)(pcmd->ClipRect.w - pcmd->ClipRect.y);
-				vkCmdSetScissor(commandBuffer, 0, 1, &scissorRect);
-				vkCmdDrawIndexed(commandBuffer, pcmd->ElemCount, 1, indexOffset, vertexOffset, 0);
-				indexOffset += pcmd->ElemCount;
-			}
-			vertexOffset += cmd_list->VtxBuffer.Size;
+			vkCmdSetScissor(commandBuffer, 0, 1, &frameGeometry.scissors[i]);
+			vkCmdDrawIndexedIndirect(commandBuffer, frameGeometry.buffer.buffer, i * sizeof(VkDrawIndexedIndirectCommand), 1, sizeof(VkDrawIndexedIndirectCommand));
 		}
 	}
 
@@ -417,8 +447,9 @@ namespace vks
 
 	void UIOverlay::freeResources()
 	{
-		vertexBuffer.destroy();
-		indexBuffer.destroy();
+		for (auto& frameGeometry : geometry) {
+			frameGeometry.buffer.destroy();
+		}
 		vkDestroyImageView(device->logicalDevice, fontView, nullptr);
 		vkDestroyImage(device->logicalDevice, fontImage, nullptr);
 		vkFreeMemory(device->logicalDevice, fontMemory, nullptr);
@@ -39,10 +39,25 @@ namespace vks
 		VkSampleCountFlagBits rasterizationSamples = VK_SAMPLE_COUNT_1_BIT;
 		uint32_t subpass = 0;
 
-		vks::Buffer vertexBuffer;
-		vks::Buffer indexBuffer;
-		int32_t vertexCount = 0;
-		int32_t indexCount = 0;
+		/**
+		* @brief Persistently mapped buffer with the overlay's geometry
+		* Contains the indirect draw commands, followed by the vertices and indices. Draws are recorded as indirect draws
+		* so changes to the geometry (e.g. a changing text) don't require recording the command buffers again
+		*/
+		struct Geometry {
+			vks::Buffer buffer;
+			VkDeviceSize vertexOffset = 0;
+			VkDeviceSize indexOffset = 0;
+			uint32_t commandCapacity = 0;
+			uint32_t vertexCapacity = 0;
+			uint32_t indexCapacity = 0;
+			/** @brief Scissor rectangles of the draws the command buffers were recorded with */
+			std::vector<VkRect2D> scissors;
+		};
+		/** @brief One buffer per frame in flight, so updating the geometry doesn't touch a buffer the GPU may still read from */
+		std::vector<Geometry> geometry = std::vector<Geometry>(1);
+		/** @brief Index of the geometry buffers that are written by update() and bound by draw() */
+		uint32_t currentGeometry = 0;
 
 		std::vector<VkPipelineShaderStageCreateInfo> shaders;
 
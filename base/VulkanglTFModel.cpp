@@ -12,12 +12,175 @@
 #define TINYGLTF_NO_STB_IMAGE_WRITE
 
 #include "VulkanglTFModel.h"
+#include "mappedfile.hpp"
+#include "jobsystem.hpp"
+
+#include <memory>
+#include <deque>
+#include <chrono>
+
+#include <glm/gtc/packing.hpp>
 
 VkDescriptorSetLayout vkglTF::descriptorSetLayoutImage = VK_NULL_HANDLE;
 VkDescriptorSetLayout vkglTF::descriptorSetLayoutUbo = VK_NULL_HANDLE;
 VkMemoryPropertyFlags vkglTF::memoryPropertyFlags = 0;
+vks::JobSystem* vkglTF::loadingJobSystem = nullptr;
 uint32_t vkglTF::descriptorBindingFlags = vkglTF::DescriptorBindingFlags::ImageBaseColor;
 
+/*
+	Memory mapped glTF loading
+	tinygltf copies the contents of all buffers into heap allocated vectors. To avoid this, buffers stored in the binary chunk of a .glb file
+	or in external .bin files are memory mapped instead, and their json entries are replaced with one byte placeholders before the json is passed to tinygltf.
+	Vertex, index and animation data are then read directly from the mappings.
+*/
+
+// Placeholder data uris for buffers and images whose data is read from a mapping instead
+static const char* mappedBufferPlaceholderUri = "data:application/octet-stream;base64,AA==";
+static const char* mappedImagePlaceholderUri = "data:image/png;base64,AA==";
+
+// Encoded (png, jpg) image data, images are decoded after parsing the file so that this can be done in parallel
+struct EncodedImageData {
+	// Points into a mapped file for images stored in a mapped buffer
+	const unsigned char* data = nullptr;
+	size_t size = 0;
+	// Copy of the encoded data for all other images
+	std::vector<unsigned char> storage;
+	std::string mimeType;
+};
+
+struct MappedGltf {
+	std::vector<std::unique_ptr<vks::MappedFile>> files;
+	// Start of the data for each glTF buffer, null if the buffer is not mapped and has been loaded by tinygltf
+	std::vector<const unsigned char*> buffers;
+	// Encoded data for all images, filled by the image loading function via its user data
+	std::vector<EncodedImageData> images;
+};
+
+static uint32_t readUint32(const uint8_t* data)
+{
+	uint32_t value;
+	memcpy(&value, data, sizeof(uint32_t));
+	return value;
+}
+
+static bool loadMappedGltf(tinygltf::TinyGLTF& gltfContext, tinygltf::Model& gltfModel, const std::string& filename, const std::string& basePath, MappedGltf& mapped, std::string& error, std::string& warning)
+{
+	std::unique_ptr<vks::MappedFile> file(new vks::MappedFile());
+	if (!file->open(filename)) {
+		error = "Could not open file";
+		return false;
+	}
+
+	const uint8_t* jsonData = file->data();
+	size_t jsonSize = file->size();
+	const uint8_t* binaryChunk = nullptr;
+	size_t binaryChunkSize = 0;
+
+	// Binary glTF (.glb) files start with a 12 byte header followed by a json chunk and an optional binary chunk
+	const uint32_t glbMagic = 0x46546C67;
+	const uint32_t glbChunkTypeJson = 0x4E4F534A;
+	const uint32_t glbChunkTypeBinary = 0x004E4942;
+	if ((file->size() >= 12) && (readUint32(file->data()) == glbMagic)) {
+		const uint8_t* glb = file->data();
+		const uint32_t version = readUint32(glb + 4);
+		const size_t length = readUint32(glb + 8);
+		if ((version != 2) || (length < 20) || (length > file->size())) {
+			error = "Invalid binary glTF header";
+			return false;
+		}
+		const size_t jsonChunkSize = readUint32(glb + 12);
+		if ((readUint32(glb + 16) != glbChunkTypeJson) || (20 + jsonChunkSize > length)) {
+			error = "Binary glTF file does not start with a json chunk";
+			return false;
+		}
+		jsonData = glb + 20;
+		jsonSize = jsonChunkSize;
+		// Chunks are aligned to four bytes
+		const size_t binaryChunkOffset = 20 + ((jsonChunkSize + 3) & ~size_t(3));
+		if ((binaryChunkOffset + 8 <= length) && (readUint32(glb + binaryChunkOffset + 4) == glbChunkTypeBinary)) {
+			binaryChunkSize = readUint32(glb + binaryChunkOffset);
+			binaryChunk = glb + binaryChunkOffset + 8;
+			if (binaryChunkOffset + 8 + binaryChunkSize > length) {
+				error = "Binary glTF chunk exceeds file size";
+				return false;
+			}
+		}
+	}
+
+	nlohmann::json json = nlohmann::json::parse(jsonData, jsonData + jsonSize, nullptr, false);
+	if (json.is_discarded() || !json.is_object()) {
+		error = "Invalid glTF json";
+		return false;
+	}
+	mapped.files.push_back(std::move(file));
+
+	bool jsonModified = false;
+
+	auto buffers = json.find("buffers");
+	if ((buffers != json.end()) && buffers->is_array()) {
+		mapped.buffers.assign(buffers->size(), nullptr);
+		for (size_t i = 0; i < buffers->size(); i++) {
+			nlohmann::json& buffer = (*buffers)[i];
+			auto byteLength = buffer.find("byteLength");
+			if ((byteLength == buffer.end()) || !byteLength->is_number_unsigned()) {
+				continue;
+			}
+			const size_t size = byteLength->get<size_t>();
+			auto uri = buffer.find("uri");
+			if (uri == buffer.end()) {
+				// Buffer is stored in the binary chunk of the glb file
+				if (binaryChunk && (size <= binaryChunkSize)) {
+					mapped.buffers[i] = binaryChunk;
+				}
+			} else if (uri->is_string() && !tinygltf::IsDataURI(uri->get<std::string>())) {
+				// External buffer file
+				std::unique_ptr<vks::MappedFile> bufferFile(new vks::MappedFile());
+				if (bufferFile->open(basePath + "/" + tinygltf::dlib::urldecode(uri->get<std::string>())) && (bufferFile->size() >= size)) {
+					mapped.buffers[i] = bufferFile->data();
+					mapped.files.push_back(std::move(bufferFile));
+				}
+			}
+			if (mapped.buffers[i]) {
+				buffer["uri"] = mappedBufferPlaceholderUri;
+				buffer["byteLength"] = 1;
+				jsonModified = true;
+			}
+		}
+	}
+
+	// Images stored in a buffer view reference the (now placeholder) buffer, so they are redirected to the mapped data too
+	auto images = json.find("images");
+	auto bufferViews = json.find("bufferViews");
+	if ((images != json.end()) && images->is_array() && (bufferViews != json.end()) && bufferViews->is_array()) {
+		mapped.images.resize(images->size());
+		for (size_t i = 0; i < images->size(); i++) {
+			nlohmann::json& image = (*images)[i];
+			auto bufferViewIndex = image.find("bufferView");
+			if ((bufferViewIndex == image.end()) || !bufferViewIndex->is_number_unsigned() || (bufferViewIndex->get<size_t>() >= bufferViews->size())) {
+				continue;
+			}
+			const nlohmann::json& bufferView = (*bufferViews)[bufferViewIndex->get<size_t>()];
+			const size_t bufferIndex = bufferView.value("buffer", size_t(0));
+			if ((bufferIndex >= mapped.buffers.size()) || !mapped.buffers[bufferIndex]) {
+				continue;
+			}
+			EncodedImageData& imageData = mapped.images[i];
+			imageData.data = mapped.buffers[bufferIndex] + bufferView.value("byteOffset", size_t(0));
+			imageData.size = bufferView.value("byteLength", size_t(0));
+			imageData.mimeType = image.value("mimeType", std::string());
+			image.erase("bufferView");
+			image.erase("mimeType");
+			image["uri"] = mappedImagePlaceholderUri;
+		}
+	}
+
+	if (!jsonModified) {
+		return gltfContext.LoadASCIIFromString(&gltfModel, &error, &warning, reinterpret_cast<const char*>(jsonData), static_cast<unsigned int>(jsonSize), basePath);
+	}
+	const std::string jsonString = json.dump();
+	return gltfContext.LoadASCIIFromString(&gltfModel, &error, &warning, jsonString.c_str(), static_cast<unsigned int>(jsonString.size()), basePath);
+}
+
 /*
 	We use a custom image loading function with tinyglTF, so we can do custom stuff loading ktx textures
 */
@@ -30,7 +193,24 @@ bool loadImageDataFunc(tinygltf::Image* image, const int imageIndex, std::string
 		}
 	}
 
-	return tinygltf::LoadImageData(image, imageIndex, error, warning, req_width, req_height, bytes, size, userData);
+	// Decoding is deferred until all images are known, so they can be decoded in parallel (see Model::loadImages)
+	if (userData) {
+		std::vector<EncodedImageData>& encodedImages = *static_cast<std::vector<EncodedImageData>*>(userData);
+		if (imageIndex >= static_cast<int>(encodedImages.size())) {
+			encodedImages.resize(imageIndex + 1);
+		}
+		EncodedImageData& encodedImage = encodedImages[imageIndex];
+		if (encodedImage.data) {
+			// Images stored in memory mapped buffers are passed in as placeholders, the actual data stays in the mapping
+			image->mimeType = encodedImage.mimeType;
+		} else {
+			encodedImage.storage.assign(bytes, bytes + size);
+			encodedImage.size = encodedImage.storage.size();
+		}
+		return true;
+	}
+
+	return tinygltf::LoadImageData(image, imageIndex, error, warning, req_width, req_height, bytes, size, nullptr);
 }
 
 bool loadImageDataFuncEmpty(tinygltf::Image* image, const int imageIndex, std::string* error, std::string* warning, int req_width, int req_height, const unsigned char* bytes, int size, void* userData) 
@@ -57,296 +237,305 @@ void vkglTF::Texture::destroy()
 	{
 		vkDestroyImageView(device->logicalDevice, view, nullptr);
 		vkDestroyImage(device->logicalDevice, image, nullptr);
-		vkFreeMemory(device->logicalDevice, deviceMemory, nullptr);
+		device->memoryAllocator.free(allocation);
 		vkDestroySampler(device->logicalDevice, sampler, nullptr);
 	}
 }
 
-void vkglTF::Texture::fromglTfImage(tinygltf::Image &gltfimage, std::string path, vks::VulkanDevice *device, VkQueue copyQueue)
+/*
+	Batched texture uploads
+	Image data is written to a persistently mapped staging ring buffer, and the buffer to image copies and mip map blits for many images are recorded into
+	the same command buffer. Command buffers are only submitted once they're full or the ring buffer runs out of space, and their completion is tracked with
+	fences, so the host only has to wait when it needs to reuse staging memory or a command buffer.
+*/
+class TextureUploader
 {
-	this->device = device;
+public:
+	struct StagingAllocation {
+		VkBuffer buffer;
+		VkDeviceSize offset;
+		uint8_t* data;
+	};
+private:
+	struct StagingBuffer {
+		VkBuffer buffer = VK_NULL_HANDLE;
+		vks::Allocation* allocation = nullptr;
+		uint8_t* mapped = nullptr;
+	};
+	struct Batch {
+		VkCommandBuffer commandBuffer = VK_NULL_HANDLE;
+		VkFence fence = VK_NULL_HANDLE;
+		bool recording = false;
+		bool submitted = false;
+		uint32_t imageCount = 0;
+		// Ring buffer write position at submission, all staging memory before this position can be reused once the fence has been signaled
+		uint64_t ringEnd = 0;
+		// Dedicated staging buffers for images that don't fit into the ring buffer
+		std::vector<StagingBuffer> dedicatedBuffers;
+	};
+
+	vks::VulkanDevice* device;
+	VkQueue queue;
+	StagingBuffer ring;
+	VkDeviceSize ringSize;
+	// Monotonically increasing write and release positions in the ring buffer
+	uint64_t ringHead = 0;
+	uint64_t ringTail = 0;
+	std::vector<Batch> batches;
+	uint32_t currentBatch = 0;
+	// Batches in submission order
+	std::deque<uint32_t> submittedBatches;
+	const uint32_t maxImagesPerBatch = 32;
+
+	StagingBuffer createStagingBuffer(VkDeviceSize size)
+	{
+		StagingBuffer stagingBuffer;
+		VK_CHECK_RESULT(device->createBuffer(VK_BUFFER_USAGE_TRANSFER_SRC_BIT, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT, size, &stagingBuffer.buffer, &stagingBuffer.allocation, nullptr, vks::AllocationStrategy::Linear));
+		stagingBuffer.mapped = static_cast<uint8_t*>(stagingBuffer.allocation->mapped);
+		return stagingBuffer;
+	}
 
-	bool isKtx = false;
-	// Image points to an external ktx file
-	if (gltfimage.uri.find_last_of(".") != std::string::npos) {
-		if (gltfimage.uri.substr(gltfimage.uri.find_last_of(".") + 1) == "ktx") {
-			isKtx = true;
+	void destroyStagingBuffer(StagingBuffer& stagingBuffer)
+	{
+		if (stagingBuffer.buffer != VK_NULL_HANDLE) {
+			vkDestroyBuffer(device->logicalDevice, stagingBuffer.buffer, nullptr);
+			device->memoryAllocator.free(stagingBuffer.allocation);
+			stagingBuffer = StagingBuffer();
 		}
 	}
 
-	VkFormat format;
+	// Waits for the oldest submitted batch and releases its staging memory
+	void waitForOldestBatch()
+	{
+		if (submittedBatches.empty()) {
+			submit();
+		}
+		if (submittedBatches.empty()) {
+			// Nothing in flight, so the whole ring buffer is free
+			ringTail = ringHead;
+			return;
+		}
+		Batch& batch = batches[submittedBatches.front()];
+		submittedBatches.pop_front();
+		VK_CHECK_RESULT(vkWaitForFences(device->logicalDevice, 1, &batch.fence, VK_TRUE, UINT64_MAX));
+		VK_CHECK_RESULT(vkResetFences(device->logicalDevice, 1, &batch.fence));
+		for (auto& stagingBuffer : batch.dedicatedBuffers) {
+			destroyStagingBuffer(stagingBuffer);
+		}
+		batch.dedicatedBuffers.clear();
+		batch.submitted = false;
+		ringTail = batch.ringEnd;
+	}
 
-	if (!isKtx) {
-		// Texture was loaded using STB_Image
+public:
+	/**
+	* @param ringSize Size of the staging ring buffer, images larger than this get a dedicated staging buffer
+	*/
+	TextureUploader(vks::VulkanDevice* device, VkQueue queue, VkDeviceSize ringSize = 64 * 1024 * 1024, uint32_t batchCount = 3) : device(device), queue(queue), ringSize(ringSize)
+	{
+		batches.resize(batchCount);
+		for (auto& batch : batches) {
+			batch.commandBuffer = device->createCommandBuffer(VK_COMMAND_BUFFER_LEVEL_PRIMARY, false);
+			VkFenceCreateInfo fenceCreateInfo = vks::initializers::fenceCreateInfo();
+			VK_CHECK_RESULT(vkCreateFence(device->logicalDevice, &fenceCreateInfo, nullptr, &batch.fence));
+		}
+	}
 
-		unsigned char* buffer = nullptr;
-		VkDeviceSize bufferSize = 0;
-		bool deleteBuffer = false;
-		if (gltfimage.component == 3) {
-			// Most devices don't support RGB only on Vulkan so convert if necessary
-			// TODO: Check actual format support and transform only if required
-			bufferSize = gltfimage.width * gltfimage.height * 4;
-			buffer = new unsigned char[bufferSize];
-			unsigned char* rgba = buffer;
-			unsigned char* rgb = &gltfimage.image[0];
-			for (size_t i = 0; i < gltfimage.width * gltfimage.height; ++i) {
-				for (int32_t j = 0; j < 3; ++j) {
-					rgba[j] = rgb[j];
-				}
-				rgba += 4;
-				rgb += 3;
-			}
-			deleteBuffer = true;
+	~TextureUploader()
+	{
+		finish();
+		for (auto& batch : batches) {
+			vkFreeCommandBuffers(device->logicalDevice, device->commandPool, 1, &batch.commandBuffer);
+			vkDestroyFence(device->logicalDevice, batch.fence, nullptr);
+		}
+		destroyStagingBuffer(ring);
+	}
+
+	/** @brief Allocates staging memory, must be called before recording the commands that read from it */
+	StagingAllocation allocate(VkDeviceSize size)
+	{
+		// Offsets need to be a multiple of the texel (or compressed block) size
+		const VkDeviceSize alignment = 16;
+		size = (size + alignment - 1) & ~(alignment - 1);
+		// Dedicated buffers are owned by the current batch, which may not be in flight anymore
+		while (batches[currentBatch].submitted) {
+			waitForOldestBatch();
+		}
+		if (size > ringSize) {
+			StagingBuffer stagingBuffer = createStagingBuffer(size);
+			batches[currentBatch].dedicatedBuffers.push_back(stagingBuffer);
+			return { stagingBuffer.buffer, 0, stagingBuffer.mapped };
 		}
-		else {
-			buffer = &gltfimage.image[0];
-			bufferSize = gltfimage.image.size();
+		if (ring.buffer == VK_NULL_HANDLE) {
+			ring = createStagingBuffer(ringSize);
 		}
+		uint64_t position = (ringHead + alignment - 1) & ~uint64_t(alignment - 1);
+		// Allocations never wrap around the end of the ring buffer
+		if ((position % ringSize) + size > ringSize) {
+			position += ringSize - (position % ringSize);
+		}
+		while (position + size - ringTail > ringSize) {
+			waitForOldestBatch();
+		}
+		ringHead = position + size;
+		const VkDeviceSize offset = position % ringSize;
+		return { ring.buffer, offset, ring.mapped + offset };
+	}
 
-		format = VK_FORMAT_R8G8B8A8_UNORM;
+	/** @brief Returns the command buffer for recording the upload commands of the current image */
+	VkCommandBuffer commandBuffer()
+	{
+		Batch& batch = batches[currentBatch];
+		while (batch.submitted) {
+			waitForOldestBatch();
+		}
+		if (!batch.recording) {
+			VkCommandBufferBeginInfo beginInfo = vks::initializers::commandBufferBeginInfo();
+			beginInfo.flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT;
+			VK_CHECK_RESULT(vkBeginCommandBuffer(batch.commandBuffer, &beginInfo));
+			batch.recording = true;
+		}
+		return batch.commandBuffer;
+	}
 
-		VkFormatProperties formatProperties;
+	/** @brief Marks the commands for an image as complete, submits the current batch once it's full */
+	void imageRecorded()
+	{
+		if (++batches[currentBatch].imageCount >= maxImagesPerBatch) {
+			submit();
+		}
+	}
 
-		width = gltfimage.width;
-		height = gltfimage.height;
-		mipLevels = static_cast<uint32_t>(floor(log2(std::max(width, height))) + 1.0);
+	void submit()
+	{
+		Batch& batch = batches[currentBatch];
+		if (!batch.recording) {
+			return;
+		}
+		VK_CHECK_RESULT(vkEndCommandBuffer(batch.commandBuffer));
+		VkSubmitInfo submitInfo = vks::initializers::submitInfo();
+		submitInfo.commandBufferCount = 1;
+		submitInfo.pCommandBuffers = &batch.commandBuffer;
+		VK_CHECK_RESULT(vkQueueSubmit(queue, 1, &submitInfo, batch.fence));
+		batch.recording = false;
+		batch.submitted = true;
+		batch.imageCount = 0;
+		batch.ringEnd = ringHead;
+		submittedBatches.push_back(currentBatch);
+		currentBatch = (currentBatch + 1) % static_cast<uint32_t>(batches.size());
+	}
 
+	/** @brief Submits all pending work and waits until all uploads have finished */
+	void finish()
+	{
+		submit();
+		while (!submittedBatches.empty()) {
+			waitForOldestBatch();
+		}
+	}
+
+	/** @brief Uploads 8 bit RGB(A) pixel data to a new image and generates the full mip chain with blits */
+	void uploadImage(vkglTF::Texture& texture, const unsigned char* pixels, uint32_t width, uint32_t height, uint32_t components)
+	{
+		const VkFormat format = VK_FORMAT_R8G8B8A8_UNORM;
+		texture.width = width;
+		texture.height = height;
+		texture.mipLevels = static_cast<uint32_t>(floor(log2(std::max(width, height))) + 1.0);
+
+		VkFormatProperties formatProperties;
 		vkGetPhysicalDeviceFormatProperties(device->physicalDevice, format, &formatProperties);
 		assert(formatProperties.optimalTilingFeatures & VK_FORMAT_FEATURE_BLIT_SRC_BIT);
 		assert(formatProperties.optimalTilingFeatures & VK_FORMAT_FEATURE_BLIT_DST_BIT);
 
-		VkMemoryAllocateInfo memAllocInfo{};
-		memAllocInfo.sType = VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO;
-		VkMemoryRequirements memReqs{};
-
-		VkBuffer stagingBuffer;
-		VkDeviceMemory stagingMemory;
-
-		VkBufferCreateInfo bufferCreateInfo{};
-		bufferCreateInfo.sType = VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO;
-		bufferCreateInfo.size = bufferSize;
-		bufferCreateInfo.usage = VK_BUFFER_USAGE_TRANSFER_SRC_BIT;
-		bufferCreateInfo.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
-		VK_CHECK_RESULT(vkCreateBuffer(device->logicalDevice, &bufferCreateInfo, nullptr, &stagingBuffer));
-		vkGetBufferMemoryRequirements(device->logicalDevice, stagingBuffer, &memReqs);
-		memAllocInfo.allocationSize = memReqs.size;
-		memAllocInfo.memoryTypeIndex = device->getMemoryType(memReqs.memoryTypeBits, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT);
-		VK_CHECK_RESULT(vkAllocateMemory(device->logicalDevice, &memAllocInfo, nullptr, &stagingMemory));
-		VK_CHECK_RESULT(vkBindBufferMemory(device->logicalDevice, stagingBuffer, stagingMemory, 0));
-
-		uint8_t* data;
-		VK_CHECK_RESULT(vkMapMemory(device->logicalDevice, stagingMemory, 0, memReqs.size, 0, (void**)&data));
-		memcpy(data, buffer, bufferSize);
-		vkUnmapMemory(device->logicalDevice, stagingMemory);
+		createImage(texture, format, VK_IMAGE_USAGE_TRANSFER_DST_BIT | VK_IMAGE_USAGE_TRANSFER_SRC_BIT | VK_IMAGE_USAGE_SAMPLED_BIT);
 
-		VkImageCreateInfo imageCreateInfo{};
-		imageCreateInfo.sType = VK_STRUCTURE_TYPE_IMAGE_CREATE_INFO;
-		imageCreateInfo.imageType = VK_IMAGE_TYPE_2D;
-		imageCreateInfo.format = format;
-		imageCreateInfo.mipLevels = mipLevels;
-		imageCreateInfo.arrayLayers = 1;
-		imageCreateInfo.samples = VK_SAMPLE_COUNT_1_BIT;
-		imageCreateInfo.tiling = VK_IMAGE_TILING_OPTIMAL;
-		imageCreateInfo.usage = VK_IMAGE_USAGE_SAMPLED_BIT;
-		imageCreateInfo.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
-		imageCreateInfo.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
-		imageCreateInfo.extent = { width, height, 1 };
-		imageCreateInfo.usage = VK_IMAGE_USAGE_TRANSFER_DST_BIT | VK_IMAGE_USAGE_TRANSFER_SRC_BIT | VK_IMAGE_USAGE_SAMPLED_BIT;
-		VK_CHECK_RESULT(vkCreateImage(device->logicalDevice, &imageCreateInfo, nullptr, &image));
-		vkGetImageMemoryRequirements(device->logicalDevice, image, &memReqs);
-		memAllocInfo.allocationSize = memReqs.size;
-		memAllocInfo.memoryTypeIndex = device->getMemoryType(memReqs.memoryTypeBits, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT);
-		VK_CHECK_RESULT(vkAllocateMemory(device->logicalDevice, &memAllocInfo, nullptr, &deviceMemory));
-		VK_CHECK_RESULT(vkBindImageMemory(device->logicalDevice, image, deviceMemory, 0));
+		const size_t pixelCount = static_cast<size_t>(width) * height;
+		StagingAllocation staging = allocate(pixelCount * 4);
+		if (components == 3) {
+			// Most devices don't support RGB only on Vulkan so convert while writing to the staging buffer
+			// TODO: Check actual format support and transform only if required
+			for (size_t i = 0; i < pixelCount; ++i) {
+				staging.data[i * 4 + 0] = pixels[i * 3 + 0];
+				staging.data[i * 4 + 1] = pixels[i * 3 + 1];
+				staging.data[i * 4 + 2] = pixels[i * 3 + 2];
+				staging.data[i * 4 + 3] = 255;
+			}
+		} else {
+			memcpy(staging.data, pixels, pixelCount * 4);
+		}
 
-		VkCommandBuffer copyCmd = device->createCommandBuffer(VK_COMMAND_BUFFER_LEVEL_PRIMARY, true);
+		VkCommandBuffer cmd = commandBuffer();
 
 		VkImageSubresourceRange subresourceRange = {};
 		subresourceRange.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
-		subresourceRange.levelCount = 1;
+		subresourceRange.levelCount = texture.mipLevels;
 		subresourceRange.layerCount = 1;
-
-		{
-			VkImageMemoryBarrier imageMemoryBarrier{};
-			imageMemoryBarrier.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER;
-			imageMemoryBarrier.oldLayout = VK_IMAGE_LAYOUT_UNDEFINED;
-			imageMemoryBarrier.newLayout = VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL;
-			imageMemoryBarrier.srcAccessMask = 0;
-			imageMemoryBarrier.dstAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
-			imageMemoryBarrier.image = image;
-			imageMemoryBarrier.subresourceRange = subresourceRange;
-			vkCmdPipelineBarrier(copyCmd, VK_PIPELINE_STAGE_ALL_COMMANDS_BIT, VK_PIPELINE_STAGE_ALL_COMMANDS_BIT, 0, 0, nullptr, 0, nullptr, 1, &imageMemoryBarrier);
-		}
+		vks::tools::setImageLayout(cmd, texture.image, VK_IMAGE_LAYOUT_UNDEFINED, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, subresourceRange, VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT, VK_PIPELINE_STAGE_TRANSFER_BIT);
 
 		VkBufferImageCopy bufferCopyRegion = {};
+		bufferCopyRegion.bufferOffset = staging.offset;
 		bufferCopyRegion.imageSubresource.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
 		bufferCopyRegion.imageSubresource.mipLevel = 0;
-		bufferCopyRegion.imageSubresource.baseArrayLayer = 0;
 		bufferCopyRegion.imageSubresource.layerCount = 1;
-		bufferCopyRegion.imageExtent.width = width;
-		bufferCopyRegion.imageExtent.height = height;
-		bufferCopyRegion.imageExtent.depth = 1;
-
-		vkCmdCopyBufferToImage(copyCmd, stagingBuffer, image, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, 1, &bufferCopyRegion);
-
-		{
-			VkImageMemoryBarrier imageMemoryBarrier{};
-			imageMemoryBarrier.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER;
-			imageMemoryBarrier.oldLayout = VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL;
-			imageMemoryBarrier.newLayout = VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL;
-			imageMemoryBarrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
-			imageMemoryBarrier.dstAccessMask = VK_ACCESS_TRANSFER_READ_BIT;
-			imageMemoryBarrier.image = image;
-			imageMemoryBarrier.subresourceRange = subresourceRange;
-			vkCmdPipelineBarrier(copyCmd, VK_PIPELINE_STAGE_ALL_COMMANDS_BIT, VK_PIPELINE_STAGE_ALL_COMMANDS_BIT, 0, 0, nullptr, 0, nullptr, 1, &imageMemoryBarrier);
-		}
-
-		device->flushCommandBuffer(copyCmd, copyQueue, true);
-
-		vkFreeMemory(device->logicalDevice, stagingMemory, nullptr);
-		vkDestroyBuffer(device->logicalDevice, stagingBuffer, nullptr);
+		bufferCopyRegion.imageExtent = { width, height, 1 };
+		vkCmdCopyBufferToImage(cmd, staging.buffer, texture.image, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, 1, &bufferCopyRegion);
 
 		// Generate the mip chain (glTF uses jpg and png, so we need to create this manually)
-		VkCommandBuffer blitCmd = device->createCommandBuffer(VK_COMMAND_BUFFER_LEVEL_PRIMARY, true);
-		for (uint32_t i = 1; i < mipLevels; i++) {
-			VkImageBlit imageBlit{};
+		VkImageSubresourceRange mipSubRange = {};
+		mipSubRange.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+		mipSubRange.levelCount = 1;
+		mipSubRange.layerCount = 1;
+		for (uint32_t i = 1; i < texture.mipLevels; i++) {
+			// Previous level becomes the blit source
+			mipSubRange.baseMipLevel = i - 1;
+			vks::tools::setImageLayout(cmd, texture.image, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL, mipSubRange, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_TRANSFER_BIT);
 
+			VkImageBlit imageBlit{};
 			imageBlit.srcSubresource.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
 			imageBlit.srcSubresource.layerCount = 1;
 			imageBlit.srcSubresource.mipLevel = i - 1;
-			imageBlit.srcOffsets[1].x = int32_t(width >> (i - 1));
-			imageBlit.srcOffsets[1].y = int32_t(height >> (i - 1));
+			imageBlit.srcOffsets[1].x = std::max(int32_t(width >> (i - 1)), 1);
+			imageBlit.srcOffsets[1].y = std::max(int32_t(height >> (i - 1)), 1);
 			imageBlit.srcOffsets[1].z = 1;
-
 			imageBlit.dstSubresource.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
 			imageBlit.dstSubresource.layerCount = 1;
 			imageBlit.dstSubresource.mipLevel = i;
-			imageBlit.dstOffsets[1].x = int32_t(width >> i);
-			imageBlit.dstOffsets[1].y = int32_t(height >> i);
+			imageBlit.dstOffsets[1].x = std::max(int32_t(width >> i), 1);
+			imageBlit.dstOffsets[1].y = std::max(int32_t(height >> i), 1);
 			imageBlit.dstOffsets[1].z = 1;
-
-			VkImageSubresourceRange mipSubRange = {};
-			mipSubRange.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
-			mipSubRange.baseMipLevel = i;
-			mipSubRange.levelCount = 1;
-			mipSubRange.layerCount = 1;
-
-			{
-				VkImageMemoryBarrier imageMemoryBarrier{};
-				imageMemoryBarrier.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER;
-				imageMemoryBarrier.oldLayout = VK_IMAGE_LAYOUT_UNDEFINED;
-				imageMemoryBarrier.newLayout = VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL;
-				imageMemoryBarrier.srcAccessMask = 0;
-				imageMemoryBarrier.dstAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
-				imageMemoryBarrier.image = image;
-				imageMemoryBarrier.subresourceRange = mipSubRange;
-				vkCmdPipelineBarrier(blitCmd, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_TRANSFER_BIT, 0, 0, nullptr, 0, nullptr, 1, &imageMemoryBarrier);
-			}
-
-			vkCmdBlitImage(blitCmd, image, VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL, image, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, 1, &imageBlit, VK_FILTER_LINEAR);
-
-			{
-				VkImageMemoryBarrier imageMemoryBarrier{};
-				imageMemoryBarrier.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER;
-				imageMemoryBarrier.oldLayout = VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL;
-				imageMemoryBarrier.newLayout = VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL;
-				imageMemoryBarrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
-				imageMemoryBarrier.dstAccessMask = VK_ACCESS_TRANSFER_READ_BIT;
-				imageMemoryBarrier.image = image;
-				imageMemoryBarrier.subresourceRange = mipSubRange;
-				vkCmdPipelineBarrier(blitCmd, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_TRANSFER_BIT, 0, 0, nullptr, 0, nullptr, 1, &imageMemoryBarrier);
-			}
+			vkCmdBlitImage(cmd, texture.image, VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL, texture.image, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, 1, &imageBlit, VK_FILTER_LINEAR);
 		}
-
-		subresourceRange.levelCount = mipLevels;
-		imageLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
-
-		{
-			VkImageMemoryBarrier imageMemoryBarrier{};
-			imageMemoryBarrier.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER;
-			imageMemoryBarrier.oldLayout = VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL;
-			imageMemoryBarrier.newLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
-			imageMemoryBarrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
-			imageMemoryBarrier.dstAccessMask = VK_ACCESS_SHADER_READ_BIT;
-			imageMemoryBarrier.image = image;
-			imageMemoryBarrier.subresourceRange = subresourceRange;
-			vkCmdPipelineBarrier(blitCmd, VK_PIPELINE_STAGE_ALL_COMMANDS_BIT, VK_PIPELINE_STAGE_ALL_COMMANDS_BIT, 0, 0, nullptr, 0, nullptr, 1, &imageMemoryBarrier);
+		// All levels but the last one are in transfer source layout now
+		if (texture.mipLevels > 1) {
+			mipSubRange.baseMipLevel = 0;
+			mipSubRange.levelCount = texture.mipLevels - 1;
+			vks::tools::setImageLayout(cmd, texture.image, VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL, mipSubRange, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT);
 		}
+		mipSubRange.baseMipLevel = texture.mipLevels - 1;
+		mipSubRange.levelCount = 1;
+		vks::tools::setImageLayout(cmd, texture.image, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL, mipSubRange, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT);
+		texture.imageLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
 
-        if (deleteBuffer) {
-            delete[] buffer;
-        }
-
-		device->flushCommandBuffer(blitCmd, copyQueue, true);
+		imageRecorded();
 	}
-	else {
-		// Texture is stored in an external ktx file
-		std::string filename = path + "/" + gltfimage.uri;
-
-		ktxTexture* ktxTexture;
 
-		ktxResult result = KTX_SUCCESS;
-#if defined(__ANDROID__)
-		AAsset* asset = AAssetManager_open(androidApp->activity->assetManager, filename.c_str(), AASSET_MODE_STREAMING);
-		if (!asset) {
-			vks::tools::exitFatal("Could not load texture from " + filename + "\n\nThe file may be part of the additional asset pack.\n\nRun \"download_assets.py\" in the repository root to download the latest version.", -1);
-		}
-		size_t size = AAsset_getLength(asset);
-		assert(size > 0);
-		ktx_uint8_t* textureData = new ktx_uint8_t[size];
-		AAsset_read(asset, textureData, size);
-		AAsset_close(asset);
-		result = ktxTexture_CreateFromMemory(textureData, size, KTX_TEXTURE_CREATE_LOAD_IMAGE_DATA_BIT, &ktxTexture);
-		delete[] textureData;
-#else
-		if (!vks::tools::fileExists(filename)) {
-			vks::tools::exitFatal("Could not load texture from " + filename + "\n\nThe file may be part of the additional asset pack.\n\nRun \"download_assets.py\" in the repository root to download the latest version.", -1);
-		}
-		result = ktxTexture_CreateFromNamedFile(filename.c_str(), KTX_TEXTURE_CREATE_LOAD_IMAGE_DATA_BIT, &ktxTexture);
-#endif		
-		assert(result == KTX_SUCCESS);
-
-		this->device = device;
-		width = ktxTexture->baseWidth;
-		height = ktxTexture->baseHeight;
-		mipLevels = ktxTexture->numLevels;
-
-		ktx_uint8_t* ktxTextureData = ktxTexture_GetData(ktxTexture);
-		ktx_size_t ktxTextureSize = ktxTexture_GetSize(ktxTexture);
+	/** @brief Uploads all mip levels stored in a ktx texture to a new image */
+	void uploadKtx(vkglTF::Texture& texture, ktxTexture* ktxTexture)
+	{
 		// @todo: Use ktxTexture_GetVkFormat(ktxTexture)
-		format = VK_FORMAT_R8G8B8A8_UNORM;
-
-		// Get device properties for the requested texture format
-		VkFormatProperties formatProperties;
-		vkGetPhysicalDeviceFormatProperties(device->physicalDevice, format, &formatProperties);
+		const VkFormat format = VK_FORMAT_R8G8B8A8_UNORM;
+		texture.width = ktxTexture->baseWidth;
+		texture.height = ktxTexture->baseHeight;
+		texture.mipLevels = ktxTexture->numLevels;
 
-		VkCommandBuffer copyCmd = device->createCommandBuffer(VK_COMMAND_BUFFER_LEVEL_PRIMARY, true);
-		VkBuffer stagingBuffer;
-		VkDeviceMemory stagingMemory;
-
-		VkBufferCreateInfo bufferCreateInfo = vks::initializers::bufferCreateInfo();
-		bufferCreateInfo.size = ktxTextureSize;
-		// This buffer is used as a transfer source for the buffer copy
-		bufferCreateInfo.usage = VK_BUFFER_USAGE_TRANSFER_SRC_BIT;
-		bufferCreateInfo.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
-		VK_CHECK_RESULT(vkCreateBuffer(device->logicalDevice, &bufferCreateInfo, nullptr, &stagingBuffer));
-
-		VkMemoryAllocateInfo memAllocInfo = vks::initializers::memoryAllocateInfo();
-		VkMemoryRequirements memReqs;
-		vkGetBufferMemoryRequirements(device->logicalDevice, stagingBuffer, &memReqs);
-		memAllocInfo.allocationSize = memReqs.size;
-		memAllocInfo.memoryTypeIndex = device->getMemoryType(memReqs.memoryTypeBits, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT);
-		VK_CHECK_RESULT(vkAllocateMemory(device->logicalDevice, &memAllocInfo, nullptr, &stagingMemory));
-		VK_CHECK_RESULT(vkBindBufferMemory(device->logicalDevice, stagingBuffer, stagingMemory, 0));
+		createImage(texture, format, VK_IMAGE_USAGE_SAMPLED_BIT | VK_IMAGE_USAGE_TRANSFER_DST_BIT);
 
-		uint8_t* data;
-		VK_CHECK_RESULT(vkMapMemory(device->logicalDevice, stagingMemory, 0, memReqs.size, 0, (void**)&data));
-		memcpy(data, ktxTextureData, ktxTextureSize);
-		vkUnmapMemory(device->logicalDevice, stagingMemory);
+		const ktx_size_t ktxTextureSize = ktxTexture_GetSize(ktxTexture);
+		StagingAllocation staging = allocate(ktxTextureSize);
+		memcpy(staging.data, ktxTexture_GetData(ktxTexture), ktxTextureSize);
 
 		std::vector<VkBufferImageCopy> bufferCopyRegions;
-		for (uint32_t i = 0; i < mipLevels; i++)
-		{
+		for (uint32_t i = 0; i < texture.mipLevels; i++) {
 			ktx_size_t offset;
 			KTX_error_code result = ktxTexture_GetImageOffset(ktxTexture, i, 0, 0, &offset);
 			assert(result == KTX_SUCCESS);
@@ -358,48 +547,110 @@ void vkglTF::Texture::fromglTfImage(tinygltf::Image &gltfimage, std::string path
 			bufferCopyRegion.imageExtent.width = std::max(1u, ktxTexture->baseWidth >> i);
 			bufferCopyRegion.imageExtent.height = std::max(1u, ktxTexture->baseHeight >> i);
 			bufferCopyRegion.imageExtent.depth = 1;
-			bufferCopyRegion.bufferOffset = offset;
+			bufferCopyRegion.bufferOffset = staging.offset + offset;
 			bufferCopyRegions.push_back(bufferCopyRegion);
 		}
 
-		// Create optimal tiled target image
+		VkCommandBuffer cmd = commandBuffer();
+		VkImageSubresourceRange subresourceRange = {};
+		subresourceRange.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+		subresourceRange.baseMipLevel = 0;
+		subresourceRange.levelCount = texture.mipLevels;
+		subresourceRange.layerCount = 1;
+		vks::tools::setImageLayout(cmd, texture.image, VK_IMAGE_LAYOUT_UNDEFINED, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, subresourceRange);
+		vkCmdCopyBufferToImage(cmd, staging.buffer, texture.image, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, static_cast<uint32_t>(bufferCopyRegions.size()), bufferCopyRegions.data());
+		vks::tools::setImageLayout(cmd, texture.image, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL, subresourceRange);
+		texture.imageLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
+
+		imageRecorded();
+	}
+
+private:
+	void createImage(vkglTF::Texture& texture, VkFormat format, VkImageUsageFlags usage)
+	{
 		VkImageCreateInfo imageCreateInfo = vks::initializers::imageCreateInfo();
 		imageCreateInfo.imageType = VK_IMAGE_TYPE_2D;
 		imageCreateInfo.format = format;
-		imageCreateInfo.mipLevels = mipLevels;
+		imageCreateInfo.mipLevels = texture.mipLevels;
 		imageCreateInfo.arrayLayers = 1;
 		imageCreateInfo.samples = VK_SAMPLE_COUNT_1_BIT;
 		imageCreateInfo.tiling = VK_IMAGE_TILING_OPTIMAL;
 		imageCreateInfo.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
 		imageCreateInfo.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
-		imageCreateInfo.extent = { width, height, 1 };
-		imageCreateInfo.usage = VK_IMAGE_USAGE_SAMPLED_BIT | VK_IMAGE_USAGE_TRANSFER_DST_BIT;
-		VK_CHECK_RESULT(vkCreateImage(device->logicalDevice, &imageCreateInfo, nullptr, &image));
-
-		vkGetImageMemoryRequirements(device->logicalDevice, image, &memReqs);
-		memAllocInfo.allocationSize = memReqs.size;
-		memAllocInfo.memoryTypeIndex = device->getMemoryType(memReqs.memoryTypeBits, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT);
-		VK_CHECK_RESULT(vkAllocateMemory(device->logicalDevice, &memAllocInfo, nullptr, &deviceMemory));
-		VK_CHECK_RESULT(vkBindImageMemory(device->logicalDevice, image, deviceMemory, 0));
+		imageCreateInfo.extent = { texture.width, texture.height, 1 };
+		imageCreateInfo.usage = usage;
+		VK_CHECK_RESULT(vkCreateImage(device->logicalDevice, &imageCreateInfo, nullptr, &texture.image));
+		texture.allocation = device->memoryAllocator.allocateImageMemory(texture.image, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT);
+		texture.deviceMemory = texture.allocation->memory;
+	}
+};
 
-		VkImageSubresourceRange subresourceRange = {};
-		subresourceRange.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
-		subresourceRange.baseMipLevel = 0;
-		subresourceRange.levelCount = mipLevels;
-		subresourceRange.layerCount = 1;
+// Loads an external ktx texture file, safe to call from worker threads
+// Failures are not fatal here, they are returned through the error message (and a null texture) so the loading thread can report them
+static ktxTexture* loadKtxTexture(const std::string& filename, std::string& error)
+{
+	const std::string missingFileError = "Could not load texture from " + filename + "\n\nThe file may be part of the additional asset pack.\n\nRun \"download_assets.py\" in the repository root to download the latest version.";
+	ktxTexture* ktxTexture = nullptr;
+	ktxResult result = KTX_SUCCESS;
+#if defined(__ANDROID__)
+	AAsset* asset = AAssetManager_open(androidApp->activity->assetManager, filename.c_str(), AASSET_MODE_STREAMING);
+	if (!asset) {
+		error = missingFileError;
+		return nullptr;
+	}
+	size_t size = AAsset_getLength(asset);
+	assert(size > 0);
+	ktx_uint8_t* textureData = new ktx_uint8_t[size];
+	AAsset_read(asset, textureData, size);
+	AAsset_close(asset);
+	result = ktxTexture_CreateFromMemory(textureData, size, KTX_TEXTURE_CREATE_LOAD_IMAGE_DATA_BIT, &ktxTexture);
+	delete[] textureData;
+#else
+	if (!vks::tools::fileExists(filename)) {
+		error = missingFileError;
+		return nullptr;
+	}
+	result = ktxTexture_CreateFromNamedFile(filename.c_str(), KTX_TEXTURE_CREATE_LOAD_IMAGE_DATA_BIT, &ktxTexture);
+#endif
+	if (result != KTX_SUCCESS) {
+		error = "Could not read ktx texture " + filename;
+		return nullptr;
+	}
+	return ktxTexture;
+}
 
-		vks::tools::setImageLayout(copyCmd, image, VK_IMAGE_LAYOUT_UNDEFINED, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, subresourceRange);
-		vkCmdCopyBufferToImage(copyCmd, stagingBuffer, image, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, static_cast<uint32_t>(bufferCopyRegions.size()), bufferCopyRegions.data());
-		vks::tools::setImageLayout(copyCmd, image, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL, subresourceRange);
-		device->flushCommandBuffer(copyCmd, copyQueue);
-		this->imageLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
+static bool isKtxImage(const tinygltf::Image& gltfimage)
+{
+	const size_t extensionPos = gltfimage.uri.find_last_of(".");
+	return (extensionPos != std::string::npos) && (gltfimage.uri.substr(extensionPos + 1) == "ktx");
+}
 
-		vkFreeMemory(device->logicalDevice, stagingMemory, nullptr);
-		vkDestroyBuffer(device->logicalDevice, stagingBuffer, nullptr);
+void vkglTF::Texture::fromglTfImage(tinygltf::Image &gltfimage, std::string path, vks::VulkanDevice *device, VkQueue copyQueue)
+{
+	this->device = device;
 
+	// A single image is uploaded, so no staging ring buffer is created (a ring size of 0 gives every image a dedicated staging buffer)
+	TextureUploader uploader(device, copyQueue, 0, 1);
+	if (isKtxImage(gltfimage)) {
+		// Texture is stored in an external ktx file
+		std::string error;
+		ktxTexture* ktxTexture = loadKtxTexture(path + "/" + gltfimage.uri, error);
+		if (!ktxTexture) {
+			vks::tools::exitFatal(error, -1);
+		}
+		uploader.uploadKtx(*this, ktxTexture);
 		ktxTexture_Destroy(ktxTexture);
+	} else {
+		// Texture was loaded using STB_Image
+		uploader.uploadImage(*this, gltfimage.image.data(), gltfimage.width, gltfimage.height, gltfimage.component);
 	}
+	uploader.finish();
+
+	createSamplerAndView();
+}
 
+void vkglTF::Texture::createSamplerAndView()
+{
 	VkSamplerCreateInfo samplerInfo{};
 	samplerInfo.sType = VK_STRUCTURE_TYPE_SAMPLER_CREATE_INFO;
 	samplerInfo.magFilter = VK_FILTER_LINEAR;
@@ -421,7 +672,7 @@ void vkglTF::Texture::fromglTfImage(tinygltf::Image &gltfimage, std::string path
 	viewInfo.sType = VK_STRUCTURE_TYPE_IMAGE_VIEW_CREATE_INFO;
 	viewInfo.image = image;
 	viewInfo.viewType = VK_IMAGE_VIEW_TYPE_2D;
-	viewInfo.format = format;
+	viewInfo.format = VK_FORMAT_R8G8B8A8_UNORM;
 	viewInfo.subresourceRange.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
 	viewInfo.subresourceRange.layerCount = 1;
 	viewInfo.subresourceRange.levelCount = mipLevels;
@@ -493,29 +744,190 @@ vkglTF::Mesh::Mesh(vks::VulkanDevice *device, glm::mat4 matrix) {
 		VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
 		sizeof(uniformBlock),
 		&uniformBuffer.buffer,
-		&uniformBuffer.memory,
+		&uniformBuffer.allocation,
 		&uniformBlock));
-	VK_CHECK_RESULT(vkMapMemory(device->logicalDevice, uniformBuffer.memory, 0, sizeof(uniformBlock), 0, &uniformBuffer.mapped));
+	// Uniform buffers of all meshes share memory blocks, which are persistently mapped
+	uniformBuffer.memory = uniformBuffer.allocation->memory;
+	uniformBuffer.mapped = uniformBuffer.allocation->mapped;
 	uniformBuffer.descriptor = { uniformBuffer.buffer, 0, sizeof(uniformBlock) };
 };
 
 vkglTF::Mesh::~Mesh() {
 	vkDestroyBuffer(device->logicalDevice, uniformBuffer.buffer, nullptr);
-	vkFreeMemory(device->logicalDevice, uniformBuffer.memory, nullptr);
+	device->memoryAllocator.free(uniformBuffer.allocation);
     for(auto primitive : primitives)
     {
         delete primitive;
     }
 }
 
+/*
+	glTF node transform hierarchy
+*/
+void vkglTF::TransformHierarchy::build(const std::vector<Node*>& rootNodes)
+{
+	// Nodes may already be part of a hierarchy (including this one), so their current transforms are read before any of them is moved
+	std::vector<Node*> orderedNodes;
+	std::vector<glm::vec3> orderedTranslations;
+	std::vector<glm::quat> orderedRotations;
+	std::vector<glm::vec3> orderedScales;
+	std::vector<glm::mat4> orderedMatrices;
+	// Depth first traversal, so every parent is added before its children
+	std::vector<Node*> stack(rootNodes.rbegin(), rootNodes.rend());
+	while (!stack.empty()) {
+		Node* node = stack.back();
+		stack.pop_back();
+		orderedNodes.push_back(node);
+		orderedTranslations.push_back(node->getTranslation());
+		orderedRotations.push_back(node->getRotation());
+		orderedScales.push_back(node->getScale());
+		orderedMatrices.push_back(node->getTransformMatrix());
+		stack.insert(stack.end(), node->children.rbegin(), node->children.rend());
+	}
+
+	nodes = orderedNodes;
+	translations = orderedTranslations;
+	rotations = orderedRotations;
+	scales = orderedScales;
+	matrices = orderedMatrices;
+	const size_t count = nodes.size();
+	for (size_t i = 0; i < count; i++) {
+		nodes[i]->hierarchy = this;
+		nodes[i]->transformIndex = static_cast<uint32_t>(i);
+	}
+	parents.resize(count);
+	for (size_t i = 0; i < count; i++) {
+		parents[i] = nodes[i]->parent ? static_cast<int32_t>(nodes[i]->parent->transformIndex) : -1;
+	}
+	localMatrices.resize(count);
+	worldMatrices.resize(count);
+	dirty.assign(count, 1);
+	changed.assign(count, 0);
+	// The generation keeps counting, so uniform buffers written for a previous build are considered outdated by the first update
+	changedGenerations.assign(count, 0);
+}
+
+void vkglTF::TransformHierarchy::setTranslation(uint32_t index, const glm::vec3& translation)
+{
+	if (translations[index] != translation) {
+		translations[index] = translation;
+		dirty[index] = 1;
+	}
+}
+
+void vkglTF::TransformHierarchy::setRotation(uint32_t index, const glm::quat& rotation)
+{
+	if (rotations[index] != rotation) {
+		rotations[index] = rotation;
+		dirty[index] = 1;
+	}
+}
+
+void vkglTF::TransformHierarchy::setScale(uint32_t index, const glm::vec3& scale)
+{
+	if (scales[index] != scale) {
+		scales[index] = scale;
+		dirty[index] = 1;
+	}
+}
+
+void vkglTF::TransformHierarchy::setMatrix(uint32_t index, const glm::mat4& matrix)
+{
+	if (matrices[index] != matrix) {
+		matrices[index] = matrix;
+		dirty[index] = 1;
+	}
+}
+
+// Recalculates the world matrices of all nodes whose local transform or one of whose ancestors changed
+// Returns true if any world matrix has been changed
+bool vkglTF::TransformHierarchy::update()
+{
+	bool anyChanged = false;
+	const uint32_t nextGeneration = generation + 1;
+	for (size_t i = 0; i < nodes.size(); i++) {
+		const int32_t parent = parents[i];
+		const bool parentChanged = (parent > -1) && changed[parent];
+		changed[i] = 0;
+		if (dirty[i]) {
+			localMatrices[i] = glm::translate(glm::mat4(1.0f), translations[i]) * glm::mat4(rotations[i]) * glm::scale(glm::mat4(1.0f), scales[i]) * matrices[i];
+		}
+		if (dirty[i] || parentChanged) {
+			worldMatrices[i] = (parent > -1) ? worldMatrices[parent] * localMatrices[i] : localMatrices[i];
+			changed[i] = 1;
+			changedGenerations[i] = nextGeneration;
+			anyChanged = true;
+		}
+		dirty[i] = 0;
+	}
+	if (anyChanged) {
+		generation = nextGeneration;
+	}
+	return anyChanged;
+}
+
 /*
 	glTF node
 */
+glm::vec3 vkglTF::Node::getTranslation() const {
+	return hierarchy ? hierarchy->translations[transformIndex] : translation;
+}
+
+glm::quat vkglTF::Node::getRotation() const {
+	return hierarchy ? hierarchy->rotations[transformIndex] : rotation;
+}
+
+glm::vec3 vkglTF::Node::getScale() const {
+	return hierarchy ? hierarchy->scales[transformIndex] : scale;
+}
+
+glm::mat4 vkglTF::Node::getTransformMatrix() const {
+	return hierarchy ? hierarchy->matrices[transformIndex] : matrix;
+}
+
+void vkglTF::Node::setTranslation(const glm::vec3& translation) {
+	if (hierarchy) {
+		hierarchy->setTranslation(transformIndex, translation);
+	} else {
+		this->translation = translation;
+	}
+}
+
+void vkglTF::Node::setRotation(const glm::quat& rotation) {
+	if (hierarchy) {
+		hierarchy->setRotation(transformIndex, rotation);
+	} else {
+		this->rotation = rotation;
+	}
+}
+
+void vkglTF::Node::setScale(const glm::vec3& scale) {
+	if (hierarchy) {
+		hierarchy->setScale(transformIndex, scale);
+	} else {
+		this->scale = scale;
+	}
+}
+
+void vkglTF::Node::setTransformMatrix(const glm::mat4& matrix) {
+	if (hierarchy) {
+		hierarchy->setMatrix(transformIndex, matrix);
+	} else {
+		this->matrix = matrix;
+	}
+}
+
 glm::mat4 vkglTF::Node::localMatrix() {
+	if (hierarchy) {
+		return hierarchy->localMatrices[transformIndex];
+	}
 	return glm::translate(glm::mat4(1.0f), translation) * glm::mat4(rotation) * glm::scale(glm::mat4(1.0f), scale) * matrix;
 }
 
 glm::mat4 vkglTF::Node::getMatrix() {
+	if (hierarchy) {
+		return hierarchy->worldMatrices[transformIndex];
+	}
 	glm::mat4 m = localMatrix();
 	vkglTF::Node *p = parent;
 	while (p) {
@@ -525,28 +937,56 @@ glm::mat4 vkglTF::Node::getMatrix() {
 	return m;
 }
 
-void vkglTF::Node::update() {
-	if (mesh) {
-		glm::mat4 m = getMatrix();
-		if (skin) {
-			mesh->uniformBlock.matrix = m;
-			// Update join matrices
-			glm::mat4 inverseTransform = glm::inverse(m);
-			for (size_t i = 0; i < skin->joints.size(); i++) {
-				vkglTF::Node *jointNode = skin->joints[i];
-				glm::mat4 jointMat = jointNode->getMatrix() * skin->inverseBindMatrices[i];
-				jointMat = inverseTransform * jointMat;
-				mesh->uniformBlock.jointMatrix[i] = jointMat;
-			}
-			mesh->uniformBlock.jointcount = (float)skin->joints.size();
-			memcpy(mesh->uniformBuffer.mapped, &mesh->uniformBlock, sizeof(mesh->uniformBlock));
-		} else {
-			memcpy(mesh->uniformBuffer.mapped, &m, sizeof(glm::mat4));
+void vkglTF::Node::updateUniformBuffer() {
+	if (!mesh) {
+		return;
+	}
+	glm::mat4 m = getMatrix();
+	if (hierarchy) {
+		uniformGeneration = hierarchy->generation;
+	}
+	if (skin) {
+		mesh->uniformBlock.matrix = m;
+		// Update join matrices
+		glm::mat4 inverseTransform = glm::inverse(m);
+		for (size_t i = 0; i < skin->joints.size(); i++) {
+			vkglTF::Node *jointNode = skin->joints[i];
+			glm::mat4 jointMat = jointNode->getMatrix() * skin->inverseBindMatrices[i];
+			jointMat = inverseTransform * jointMat;
+			mesh->uniformBlock.jointMatrix[i] = jointMat;
 		}
+		mesh->uniformBlock.jointcount = (float)skin->joints.size();
+		memcpy(mesh->uniformBuffer.mapped, &mesh->uniformBlock, sizeof(mesh->uniformBlock));
+	} else {
+		memcpy(mesh->uniformBuffer.mapped, &m, sizeof(glm::mat4));
 	}
+}
 
-	for (auto& child : children) {
-		child->update();
+void vkglTF::Node::update() {
+	if (hierarchy) {
+		hierarchy->update();
+	}
+	// Uniform buffers of the whole sub tree, without a hierarchy there's no change tracking
+	std::vector<Node*> stack = { this };
+	while (!stack.empty()) {
+		Node* node = stack.back();
+		stack.pop_back();
+		stack.insert(stack.end(), node->children.begin(), node->children.end());
+		if (!node->mesh) {
+			continue;
+		}
+		if (hierarchy) {
+			uint32_t lastChange = hierarchy->changedGenerations[node->transformIndex];
+			if (node->skin) {
+				for (Node* joint : node->skin->joints) {
+					lastChange = std::max(lastChange, hierarchy->changedGenerations[joint->transformIndex]);
+				}
+			}
+			if (lastChange <= node->uniformGeneration) {
+				continue;
+			}
+		}
+		node->updateUniformBuffer();
 	}
 }
 
@@ -602,10 +1042,59 @@ std::vector<VkVertexInputAttributeDescription> vkglTF::Vertex::inputAttributeDes
 	return result;
 }
 
+uint32_t vkglTF::Vertex::packedComponentSize(VertexComponent component) {
+	return (component == VertexComponent::Position) ? 8 : 4;
+}
+
+uint32_t vkglTF::Vertex::packedStride(const std::vector<VertexComponent>& components) {
+	uint32_t stride = 0;
+	for (VertexComponent component : components) {
+		stride += packedComponentSize(component);
+	}
+	return stride;
+}
+
+std::vector<VkVertexInputAttributeDescription> vkglTF::Vertex::packedInputAttributeDescriptions(uint32_t binding, const std::vector<VertexComponent> components) {
+	std::vector<VkVertexInputAttributeDescription> result;
+	uint32_t location = 0;
+	uint32_t offset = 0;
+	for (VertexComponent component : components) {
+		VkFormat format = VK_FORMAT_UNDEFINED;
+		switch (component) {
+			case VertexComponent::Position:
+				format = VK_FORMAT_R16G16B16A16_SNORM;
+				break;
+			case VertexComponent::Normal:
+			case VertexComponent::Tangent:
+				format = VK_FORMAT_R16G16_SNORM;
+				break;
+			case VertexComponent::UV:
+				format = VK_FORMAT_R16G16_SFLOAT;
+				break;
+			case VertexComponent::Color:
+			case VertexComponent::Weight0:
+				format = VK_FORMAT_R8G8B8A8_UNORM;
+				break;
+			case VertexComponent::Joint0:
+				format = VK_FORMAT_R8G8B8A8_UINT;
+				break;
+		}
+		result.push_back({ location, binding, format, offset });
+		offset += packedComponentSize(component);
+		location++;
+	}
+	return result;
+}
+
 /** @brief Returns the default pipeline vertex input state create info structure for the requested vertex components */
-VkPipelineVertexInputStateCreateInfo* vkglTF::Vertex::getPipelineVertexInputState(const std::vector<VertexComponent> components) {
-	vertexInputBindingDescription = Vertex::inputBindingDescription(0);
-	Vertex::vertexInputAttributeDescriptions = Vertex::inputAttributeDescriptions(0, components);
+VkPipelineVertexInputStateCreateInfo* vkglTF::Vertex::getPipelineVertexInputState(const std::vector<VertexComponent> components, VertexFormat format) {
+	if (format == VertexFormat::Packed) {
+		vertexInputBindingDescription = { 0, packedStride(components), VK_VERTEX_INPUT_RATE_VERTEX };
+		Vertex::vertexInputAttributeDescriptions = Vertex::packedInputAttributeDescriptions(0, components);
+	} else {
+		vertexInputBindingDescription = Vertex::inputBindingDescription(0);
+		Vertex::vertexInputAttributeDescriptions = Vertex::inputAttributeDescriptions(0, components);
+	}
 	pipelineVertexInputStateCreateInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_VERTEX_INPUT_STATE_CREATE_INFO;
 	pipelineVertexInputStateCreateInfo.vertexBindingDescriptionCount = 1;
 	pipelineVertexInputStateCreateInfo.pVertexBindingDescriptions = &Vertex::vertexInputBindingDescription;
@@ -635,28 +1124,10 @@ void vkglTF::Model::createEmptyTexture(VkQueue transferQueue)
 	unsigned char* buffer = new unsigned char[bufferSize];
 	memset(buffer, 0, bufferSize);
 
-	VkBuffer stagingBuffer;
-	VkDeviceMemory stagingMemory;
-	VkBufferCreateInfo bufferCreateInfo = vks::initializers::bufferCreateInfo();
-	bufferCreateInfo.size = bufferSize;
-	// This buffer is used as a transfer source for the buffer copy
-	bufferCreateInfo.usage = VK_BUFFER_USAGE_TRANSFER_SRC_BIT;
-	bufferCreateInfo.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
-	VK_CHECK_RESULT(vkCreateBuffer(device->logicalDevice, &bufferCreateInfo, nullptr, &stagingBuffer));
-
-	VkMemoryAllocateInfo memAllocInfo = vks::initializers::memoryAllocateInfo();
-	VkMemoryRequirements memReqs;
-	vkGetBufferMemoryRequirements(device->logicalDevice, stagingBuffer, &memReqs);
-	memAllocInfo.allocationSize = memReqs.size;
-	memAllocInfo.memoryTypeIndex = device->getMemoryType(memReqs.memoryTypeBits, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT);
-	VK_CHECK_RESULT(vkAllocateMemory(device->logicalDevice, &memAllocInfo, nullptr, &stagingMemory));
-	VK_CHECK_RESULT(vkBindBufferMemory(device->logicalDevice, stagingBuffer, stagingMemory, 0));
-
 	// Copy texture data into staging buffer
-	uint8_t* data;
-	VK_CHECK_RESULT(vkMapMemory(device->logicalDevice, stagingMemory, 0, memReqs.size, 0, (void**)&data));
-	memcpy(data, buffer, bufferSize);
-	vkUnmapMemory(device->logicalDevice, stagingMemory);
+	VkBuffer stagingBuffer;
+	vks::Allocation* stagingAllocation;
+	VK_CHECK_RESULT(device->createBuffer(VK_BUFFER_USAGE_TRANSFER_SRC_BIT, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT, bufferSize, &stagingBuffer, &stagingAllocation, buffer, vks::AllocationStrategy::Linear));
 
 	VkBufferImageCopy bufferCopyRegion = {};
 	bufferCopyRegion.imageSubresource.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
@@ -679,11 +1150,8 @@ void vkglTF::Model::createEmptyTexture(VkQueue transferQueue)
 	imageCreateInfo.usage = VK_IMAGE_USAGE_SAMPLED_BIT | VK_IMAGE_USAGE_TRANSFER_DST_BIT;
 	VK_CHECK_RESULT(vkCreateImage(device->logicalDevice, &imageCreateInfo, nullptr, &emptyTexture.image));
 
-	vkGetImageMemoryRequirements(device->logicalDevice, emptyTexture.image, &memReqs);
-	memAllocInfo.allocationSize = memReqs.size;
-	memAllocInfo.memoryTypeIndex = device->getMemoryType(memReqs.memoryTypeBits, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT);
-	VK_CHECK_RESULT(vkAllocateMemory(device->logicalDevice, &memAllocInfo, nullptr, &emptyTexture.deviceMemory));
-	VK_CHECK_RESULT(vkBindImageMemory(device->logicalDevice, emptyTexture.image, emptyTexture.deviceMemory, 0));
+	emptyTexture.allocation = device->memoryAllocator.allocateImageMemory(emptyTexture.image, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT);
+	emptyTexture.deviceMemory = emptyTexture.allocation->memory;
 
 	VkImageSubresourceRange subresourceRange{};
 	subresourceRange.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
@@ -699,8 +1167,8 @@ void vkglTF::Model::createEmptyTexture(VkQueue transferQueue)
 	emptyTexture.imageLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
 
 	// Clean up staging resources
-	vkFreeMemory(device->logicalDevice, stagingMemory, nullptr);
 	vkDestroyBuffer(device->logicalDevice, stagingBuffer, nullptr);
+	device->memoryAllocator.free(stagingAllocation);
 
 	VkSamplerCreateInfo samplerCreateInfo = vks::initializers::samplerCreateInfo();
 	samplerCreateInfo.magFilter = VK_FILTER_LINEAR;
@@ -732,9 +1200,9 @@ void vkglTF::Model::createEmptyTexture(VkQueue transferQueue)
 vkglTF::Model::~Model()
 {
 	vkDestroyBuffer(device->logicalDevice, vertices.buffer, nullptr);
-	vkFreeMemory(device->logicalDevice, vertices.memory, nullptr);
+	device->memoryAllocator.free(vertices.allocation);
 	vkDestroyBuffer(device->logicalDevice, indices.buffer, nullptr);
-	vkFreeMemory(device->logicalDevice, indices.memory, nullptr);
+	device->memoryAllocator.free(indices.allocation);
 	for (auto texture : textures) {
 		texture.destroy();
 	}
@@ -756,6 +1224,70 @@ vkglTF::Model::~Model()
 	emptyTexture.destroy();
 }
 
+const unsigned char* vkglTF::Model::getAccessorData(const tinygltf::Model& model, const tinygltf::Accessor& accessor)
+{
+	const tinygltf::BufferView& bufferView = model.bufferViews[accessor.bufferView];
+	return bufferData[bufferView.buffer] + bufferView.byteOffset + accessor.byteOffset;
+}
+
+void vkglTF::readAccessor(const tinygltf::Model& model, const tinygltf::Accessor& accessor, std::vector<float>& values, const unsigned char* data)
+{
+	const tinygltf::BufferView& bufferView = model.bufferViews[accessor.bufferView];
+	if (!data) {
+		data = model.buffers[bufferView.buffer].data.data() + bufferView.byteOffset + accessor.byteOffset;
+	}
+	const int32_t components = tinygltf::GetNumComponentsInType(static_cast<uint32_t>(accessor.type));
+	const int32_t componentSize = tinygltf::GetComponentSizeInBytes(static_cast<uint32_t>(accessor.componentType));
+	// A stride of 0 means tightly packed elements
+	const int32_t stride = accessor.ByteStride(bufferView);
+	assert((components > 0) && (componentSize > 0) && (stride > 0));
+	values.resize(accessor.count * components);
+	for (size_t i = 0; i < accessor.count; i++) {
+		const unsigned char* element = data + i * stride;
+		for (int32_t c = 0; c < components; c++) {
+			// Read through memcpy as the data in the buffer is not necessarily aligned
+			const unsigned char* component = element + c * componentSize;
+			float value = 0.0f;
+			switch (accessor.componentType) {
+			case TINYGLTF_COMPONENT_TYPE_FLOAT:
+				memcpy(&value, component, sizeof(float));
+				break;
+			case TINYGLTF_COMPONENT_TYPE_BYTE: {
+				int8_t v;
+				memcpy(&v, component, sizeof(v));
+				value = accessor.normalized ? std::max(v / 127.0f, -1.0f) : static_cast<float>(v);
+				break;
+			}
+			case TINYGLTF_COMPONENT_TYPE_UNSIGNED_BYTE: {
+				uint8_t v;
+				memcpy(&v, component, sizeof(v));
+				value = accessor.normalized ? v / 255.0f : static_cast<float>(v);
+				break;
+			}
+			case TINYGLTF_COMPONENT_TYPE_SHORT: {
+				int16_t v;
+				memcpy(&v, component, sizeof(v));
+				value = accessor.normalized ? std::max(v / 32767.0f, -1.0f) : static_cast<float>(v);
+				break;
+			}
+			case TINYGLTF_COMPONENT_TYPE_UNSIGNED_SHORT: {
+				uint16_t v;
+				memcpy(&v, component, sizeof(v));
+				value = accessor.normalized ? v / 65535.0f : static_cast<float>(v);
+				break;
+			}
+			case TINYGLTF_COMPONENT_TYPE_UNSIGNED_INT: {
+				uint32_t v;
+				memcpy(&v, component, sizeof(v));
+				value = static_cast<float>(v);
+				break;
+			}
+			}
+			values[i * components + c] = value;
+		}
+	}
+}
+
 void vkglTF::Model::loadNode(vkglTF::Node *parent, const tinygltf::Node &node, uint32_t nodeIndex, const tinygltf::Model &model, std::vector<uint32_t>& indexBuffer, std::vector<Vertex>& vertexBuffer, float globalscale)
 {
 	vkglTF::Node *newNode = new Node{};
@@ -763,26 +1295,24 @@ void vkglTF::Model::loadNode(vkglTF::Node *parent, const tinygltf::Node &node, u
 	newNode->parent = parent;
 	newNode->name = node.name;
 	newNode->skinIndex = node.skin;
-	newNode->matrix = glm::mat4(1.0f);
 
 	// Generate local node matrix
 	glm::vec3 translation = glm::vec3(0.0f);
 	if (node.translation.size() == 3) {
 		translation = glm::make_vec3(node.translation.data());
-		newNode->translation = translation;
+		newNode->setTranslation(translation);
 	}
-	glm::mat4 rotation = glm::mat4(1.0f);
 	if (node.rotation.size() == 4) {
 		glm::quat q = glm::make_quat(node.rotation.data());
-		newNode->rotation = glm::mat4(q);
+		newNode->setRotation(q);
 	}
 	glm::vec3 scale = glm::vec3(1.0f);
 	if (node.scale.size() == 3) {
 		scale = glm::make_vec3(node.scale.data());
-		newNode->scale = scale;
+		newNode->setScale(scale);
 	}
 	if (node.matrix.size() == 16) {
-		newNode->matrix = glm::make_mat4x4(node.matrix.data());
+		newNode->setTransformMatrix(glm::make_mat4x4(node.matrix.data()));
 		if (globalscale != 1.0f) {
 			//newNode->matrix = glm::scale(newNode->matrix, glm::vec3(globalscale));
 		}
@@ -798,7 +1328,7 @@ void vkglTF::Model::loadNode(vkglTF::Node *parent, const tinygltf::Node &node, u
 	// Node contains mesh data
 	if (node.mesh > -1) {
 		const tinygltf::Mesh mesh = model.meshes[node.mesh];
-		Mesh *newMesh = new Mesh(device, newNode->matrix);
+		Mesh *newMesh = new Mesh(device, newNode->getTransformMatrix());
 		newMesh->name = mesh.name;
 		for (size_t j = 0; j < mesh.primitives.size(); j++) {
 			const tinygltf::Primitive &primitive = mesh.primitives[j];
@@ -827,51 +1357,44 @@ void vkglTF::Model::loadNode(vkglTF::Node *parent, const tinygltf::Node &node, u
 				assert(primitive.attributes.find("POSITION") != primitive.attributes.end());
 
 				const tinygltf::Accessor &posAccessor = model.accessors[primitive.attributes.find("POSITION")->second];
-				const tinygltf::BufferView &posView = model.bufferViews[posAccessor.bufferView];
-				bufferPos = reinterpret_cast<const float *>(&(model.buffers[posView.buffer].data[posAccessor.byteOffset + posView.byteOffset]));
+				bufferPos = reinterpret_cast<const float*>(getAccessorData(model, posAccessor));
 				posMin = glm::vec3(posAccessor.minValues[0], posAccessor.minValues[1], posAccessor.minValues[2]);
 				posMax = glm::vec3(posAccessor.maxValues[0], posAccessor.maxValues[1], posAccessor.maxValues[2]);
 
 				if (primitive.attributes.find("NORMAL") != primitive.attributes.end()) {
 					const tinygltf::Accessor &normAccessor = model.accessors[primitive.attributes.find("NORMAL")->second];
-					const tinygltf::BufferView &normView = model.bufferViews[normAccessor.bufferView];
-					bufferNormals = reinterpret_cast<const float *>(&(model.buffers[normView.buffer].data[normAccessor.byteOffset + normView.byteOffset]));
+					bufferNormals = reinterpret_cast<const float*>(getAccessorData(model, normAccessor));
 				}
 
 				if (primitive.attributes.find("TEXCOORD_0") != primitive.attributes.end()) {
 					const tinygltf::Accessor &uvAccessor = model.accessors[primitive.attributes.find("TEXCOORD_0")->second];
-					const tinygltf::BufferView &uvView = model.bufferViews[uvAccessor.bufferView];
-					bufferTexCoords = reinterpret_cast<const float *>(&(model.buffers[uvView.buffer].data[uvAccessor.byteOffset + uvView.byteOffset]));
+					bufferTexCoords = reinterpret_cast<const float*>(getAccessorData(model, uvAccessor));
 				}
 
 				if (primitive.attributes.find("COLOR_0") != primitive.attributes.end())
 				{
 					const tinygltf::Accessor& colorAccessor = model.accessors[primitive.attributes.find("COLOR_0")->second];
-					const tinygltf::BufferView& colorView = model.bufferViews[colorAccessor.bufferView];
 					// Color buffer are either of type vec3 or vec4
 					numColorComponents = colorAccessor.type == TINYGLTF_PARAMETER_TYPE_FLOAT_VEC3 ? 3 : 4;
-					bufferColors = reinterpret_cast<const float*>(&(model.buffers[colorView.buffer].data[colorAccessor.byteOffset + colorView.byteOffset]));
+					bufferColors = reinterpret_cast<const float*>(getAccessorData(model, colorAccessor));
 				}
 
 				if (primitive.attributes.find("TANGENT") != primitive.attributes.end())
 				{
 					const tinygltf::Accessor &tangentAccessor = model.accessors[primitive.attributes.find("TANGENT")->second];
-					const tinygltf::BufferView &tangentView = model.bufferViews[tangentAccessor.bufferView];
-					bufferTangents = reinterpret_cast<const float *>(&(model.buffers[tangentView.buffer].data[tangentAccessor.byteOffset + tangentView.byteOffset]));
+					bufferTangents = reinterpret_cast<const float*>(getAccessorData(model, tangentAccessor));
 				}
 
 				// Skinning
 				// Joints
 				if (primitive.attributes.find("JOINTS_0") != primitive.attributes.end()) {
 					const tinygltf::Accessor &jointAccessor = model.accessors[primitive.attributes.find("JOINTS_0")->second];
-					const tinygltf::BufferView &jointView = model.bufferViews[jointAccessor.bufferView];
-					bufferJoints = reinterpret_cast<const uint16_t *>(&(model.buffers[jointView.buffer].data[jointAccessor.byteOffset + jointView.byteOffset]));
+					bufferJoints = reinterpret_cast<const uint16_t *>(getAccessorData(model, jointAccessor));
 				}
 
 				if (primitive.attributes.find("WEIGHTS_0") != primitive.attributes.end()) {
 					const tinygltf::Accessor &uvAccessor = model.accessors[primitive.attributes.find("WEIGHTS_0")->second];
-					const tinygltf::BufferView &uvView = model.bufferViews[uvAccessor.bufferView];
-					bufferWeights = reinterpret_cast<const float *>(&(model.buffers[uvView.buffer].data[uvAccessor.byteOffset + uvView.byteOffset]));
+					bufferWeights = reinterpret_cast<const float*>(getAccessorData(model, uvAccessor));
 				}
 
 				hasSkin = (bufferJoints && bufferWeights);
@@ -903,58 +1426,268 @@ void vkglTF::Model::loadNode(vkglTF::Node *parent, const tinygltf::Node &node, u
 			// Indices
 			{
 				const tinygltf::Accessor &accessor = model.accessors[primitive.indices];
-				const tinygltf::BufferView &bufferView = model.bufferViews[accessor.bufferView];
-				const tinygltf::Buffer &buffer = model.buffers[bufferView.buffer];
+				const unsigned char* indexData = getAccessorData(model, accessor);
 
 				indexCount = static_cast<uint32_t>(accessor.count);
 
 				switch (accessor.componentType) {
 				case TINYGLTF_PARAMETER_TYPE_UNSIGNED_INT: {
-					uint32_t *buf = new uint32_t[accessor.count];
-					memcpy(buf, &buffer.data[accessor.byteOffset + bufferView.byteOffset], accessor.count * sizeof(uint32_t));
+					const uint32_t *buf = reinterpret_cast<const uint32_t*>(indexData);
 					for (size_t index = 0; index < accessor.count; index++) {
 						indexBuffer.push_back(buf[index] + vertexStart);
 					}
-                    delete[] buf;
 					break;
 				}
 				case TINYGLTF_PARAMETER_TYPE_UNSIGNED_SHORT: {
-					uint16_t *buf = new uint16_t[accessor.count];
-					memcpy(buf, &buffer.data[accessor.byteOffset + bufferView.byteOffset], accessor.count * sizeof(uint16_t));
+					const uint16_t *buf = reinterpret_cast<const uint16_t*>(indexData);
 					for (size_t index = 0; index < accessor.count; index++) {
 						indexBuffer.push_back(buf[index] + vertexStart);
 					}
-                    delete[] buf;
-                    break;
+					break;
 				}
 				case TINYGLTF_PARAMETER_TYPE_UNSIGNED_BYTE: {
-					uint8_t *buf = new uint8_t[accessor.count];
-					memcpy(buf, &buffer.data[accessor.byteOffset + bufferView.byteOffset], accessor.count * sizeof(uint8_t));
+					const uint8_t *buf = indexData;
 					for (size_t index = 0; index < accessor.count; index++) {
 						indexBuffer.push_back(buf[index] + vertexStart);
 					}
-                    delete[] buf;
-                    break;
+					break;
 				}
 				default:
 					std::cerr << "Index component type " << accessor.componentType << " not supported!" << std::endl;
 					return;
 				}
 			}
-			Primitive *newPrimitive = new Primitive(indexStart, indexCount, primitive.material > -1 ? materials[primitive.material] : materials.back());
-			newPrimitive->firstVertex = vertexStart;
-			newPrimitive->vertexCount = vertexCount;
-			newPrimitive->setDimensions(posMin, posMax);
-			newMesh->primitives.push_back(newPrimitive);
+			// Reordering only applies to triangle lists
+			if (optimizeMeshes && (primitive.mode == TINYGLTF_MODE_TRIANGLES)) {
+				vertexCount = optimizePrimitive(indexBuffer, vertexBuffer, indexStart, vertexStart);
+			}
+			Primitive *newPrimitive = new Primitive(indexStart, indexCount, primitive.material > -1 ? materials[primitive.material] : materials.back());
+			newPrimitive->firstVertex = vertexStart;
+			newPrimitive->vertexCount = vertexCount;
+			newPrimitive->setDimensions(posMin, posMax);
+			if (generateLods && (primitive.mode == TINYGLTF_MODE_TRIANGLES)) {
+				generatePrimitiveLods(indexBuffer, vertexBuffer, newPrimitive);
+			}
+			newMesh->primitives.push_back(newPrimitive);
+		}
+		newNode->mesh = newMesh;
+	}
+	if (parent) {
+		parent->children.push_back(newNode);
+	} else {
+		nodes.push_back(newNode);
+	}
+	linearNodes.push_back(newNode);
+}
+
+/*
+	Welds identical vertices of a primitive and reorders its triangles and vertices for the vertex cache, overdraw and vertex fetch
+	The primitive's vertices and indices have to be at the end of the buffers, the vertex buffer is shrunk to the remaining vertices
+	Returns the new vertex count of the primitive
+*/
+uint32_t vkglTF::Model::optimizePrimitive(std::vector<uint32_t>& indexBuffer, std::vector<Vertex>& vertexBuffer, uint32_t indexStart, uint32_t vertexStart)
+{
+	uint32_t* indices = indexBuffer.data() + indexStart;
+	const size_t indexCount = indexBuffer.size() - indexStart;
+	Vertex* vertices = vertexBuffer.data() + vertexStart;
+	const size_t vertexCount = vertexBuffer.size() - vertexStart;
+	if ((indexCount % 3 != 0) || (vertexCount == 0)) {
+		return static_cast<uint32_t>(vertexCount);
+	}
+	for (size_t i = 0; i < indexCount; i++) {
+		if ((indices[i] < vertexStart) || (indices[i] - vertexStart >= vertexCount)) {
+			return static_cast<uint32_t>(vertexCount);
+		}
+	}
+	// The optimizer works on indices relative to the primitive's first vertex
+	for (size_t i = 0; i < indexCount; i++) {
+		indices[i] -= vertexStart;
+	}
+	meshOptimizationStatistics.before.add(vks::meshoptimizer::analyzeVertexCache(indices, indexCount, vertexCount));
+
+	std::vector<uint32_t> remap(vertexCount);
+	std::vector<Vertex> weldedVertices(vertexCount);
+	size_t uniqueCount = vks::meshoptimizer::generateVertexRemap(remap.data(), indices, indexCount, vertices, vertexCount);
+	vks::meshoptimizer::remapIndexBuffer(indices, indexCount, remap.data());
+	vks::meshoptimizer::remapVertexBuffer(weldedVertices.data(), vertices, vertexCount, remap.data());
+	vks::meshoptimizer::optimizeVertexCache(indices, indices, indexCount, uniqueCount);
+	vks::meshoptimizer::optimizeOverdraw(indices, indices, indexCount, &weldedVertices[0].pos.x, sizeof(Vertex), uniqueCount);
+	uniqueCount = vks::meshoptimizer::optimizeVertexFetch(vertices, indices, indexCount, weldedVertices.data(), uniqueCount);
+
+	meshOptimizationStatistics.after.add(vks::meshoptimizer::analyzeVertexCache(indices, indexCount, uniqueCount));
+	for (size_t i = 0; i < indexCount; i++) {
+		indices[i] += vertexStart;
+	}
+	vertexBuffer.resize(vertexStart + uniqueCount);
+	return static_cast<uint32_t>(uniqueCount);
+}
+
+/*
+	Generates levels of detail for a primitive, each level is simplified from the previous one
+	The indices of the levels are appended to the index buffer and reference the primitive's vertices, so no vertices are added
+*/
+void vkglTF::Model::generatePrimitiveLods(std::vector<uint32_t>& indexBuffer, const std::vector<Vertex>& vertexBuffer, Primitive* primitive)
+{
+	const uint32_t vertexStart = primitive->firstVertex;
+	const size_t vertexCount = primitive->vertexCount;
+	if ((primitive->indexCount == 0) || (primitive->indexCount % 3 != 0) || (vertexCount == 0)) {
+		return;
+	}
+	std::vector<uint32_t> indices(indexBuffer.begin() + primitive->firstIndex, indexBuffer.begin() + primitive->firstIndex + primitive->indexCount);
+	for (uint32_t& index : indices) {
+		if ((index < vertexStart) || (index - vertexStart >= vertexCount)) {
+			return;
+		}
+		index -= vertexStart;
+	}
+	if (lodTriangleCounts.size() < lodLevelCount) {
+		lodTriangleCounts.resize(lodLevelCount, 0);
+	}
+	lodTriangleCounts[0] += primitive->indexCount / 3;
+
+	// Identical vertices are welded for the simplifier, which would otherwise treat every shared position as a seam
+	const Vertex* vertices = vertexBuffer.data() + vertexStart;
+	std::vector<uint32_t> remap(vertexCount);
+	const size_t uniqueCount = vks::meshoptimizer::generateVertexRemap(remap.data(), indices.data(), indices.size(), vertices, vertexCount);
+	std::vector<uint32_t> sourceVertices(uniqueCount, vks::meshoptimizer::unusedVertex);
+	std::vector<glm::vec3> positions(uniqueCount);
+	for (uint32_t v = 0; v < vertexCount; v++) {
+		if ((remap[v] != vks::meshoptimizer::unusedVertex) && (sourceVertices[remap[v]] == vks::meshoptimizer::unusedVertex)) {
+			sourceVertices[remap[v]] = v;
+			positions[remap[v]] = vertices[v].pos;
+		}
+	}
+	vks::meshoptimizer::remapIndexBuffer(indices.data(), indices.size(), remap.data());
+
+	std::vector<uint32_t> lodIndices(indices.size());
+	float error = 0.0f;
+	for (uint32_t level = 1; level < lodLevelCount; level++) {
+		const size_t targetIndexCount = static_cast<size_t>(static_cast<float>(indices.size()) * lodReduction) / 3 * 3;
+		float levelError = 0.0f;
+		const size_t lodIndexCount = vks::meshoptimizer::simplify(lodIndices.data(), indices.data(), indices.size(), &positions[0].x, sizeof(glm::vec3), uniqueCount, targetIndexCount, FLT_MAX, &levelError);
+		// Further levels wouldn't save enough to be worth a draw with a lower detail
+		if ((lodIndexCount == 0) || (lodIndexCount * 10 > indices.size() * 9)) {
+			break;
+		}
+		// Each level's error is measured against the previous level, the sum bounds the error against the full detail
+		error += levelError;
+		indices.assign(lodIndices.begin(), lodIndices.begin() + lodIndexCount);
+		vks::meshoptimizer::optimizeVertexCache(lodIndices.data(), indices.data(), lodIndexCount, uniqueCount);
+		primitive->lods.push_back({ static_cast<uint32_t>(indexBuffer.size()), static_cast<uint32_t>(lodIndexCount), error });
+		for (size_t i = 0; i < lodIndexCount; i++) {
+			indexBuffer.push_back(sourceVertices[lodIndices[i]] + vertexStart);
+		}
+		lodTriangleCounts[level] += static_cast<uint32_t>(lodIndexCount / 3);
+	}
+}
+
+/*
+	Vertex packing
+*/
+
+// Octahedral encoding of a unit vector (Cigolle et al., "A Survey of Efficient Representations for Independent Unit Vectors", 2014)
+static glm::vec2 octEncode(glm::vec3 v)
+{
+	const float length = fabsf(v.x) + fabsf(v.y) + fabsf(v.z);
+	if (length == 0.0f) {
+		return glm::vec2(0.0f);
+	}
+	v /= length;
+	glm::vec2 encoded(v.x, v.y);
+	if (v.z < 0.0f) {
+		encoded.x = (1.0f - fabsf(v.y)) * (v.x >= 0.0f ? 1.0f : -1.0f);
+		encoded.y = (1.0f - fabsf(v.x)) * (v.y >= 0.0f ? 1.0f : -1.0f);
+	}
+	return encoded;
+}
+
+/*
+	Converts the vertices to the packed format with only the components in packedVertexComponents
+	Positions are normalized to the bounds of all vertices, vertexDequantization maps them back
+*/
+void vkglTF::Model::packVertices(const std::vector<Vertex>& vertexBuffer, std::vector<uint8_t>& packedVertexBuffer)
+{
+	glm::vec3 min(FLT_MAX), max(-FLT_MAX);
+	for (const Vertex& vertex : vertexBuffer) {
+		min = glm::min(min, vertex.pos);
+		max = glm::max(max, vertex.pos);
+	}
+	const glm::vec3 center = (min + max) * 0.5f;
+	glm::vec3 halfExtent = (max - min) * 0.5f;
+	for (uint32_t i = 0; i < 3; i++) {
+		if (halfExtent[i] <= 0.0f) {
+			halfExtent[i] = 1.0f;
+		}
+	}
+	vertexDequantization = glm::scale(glm::translate(glm::mat4(1.0f), center), halfExtent);
+
+	const uint32_t stride = Vertex::packedStride(packedVertexComponents);
+	packedVertexBuffer.resize(vertexBuffer.size() * stride);
+	bool jointsClamped = false;
+	uint8_t* destination = packedVertexBuffer.data();
+	for (const Vertex& vertex : vertexBuffer) {
+		for (VertexComponent component : packedVertexComponents) {
+			switch (component) {
+				case VertexComponent::Position: {
+					const uint64_t packed = glm::packSnorm4x16(glm::vec4((vertex.pos - center) / halfExtent, 1.0f));
+					memcpy(destination, &packed, sizeof(packed));
+					break;
+				}
+				case VertexComponent::Normal: {
+					const uint32_t packed = glm::packSnorm2x16(octEncode(vertex.normal));
+					memcpy(destination, &packed, sizeof(packed));
+					break;
+				}
+				case VertexComponent::UV: {
+					const uint32_t packed = glm::packHalf2x16(vertex.uv);
+					memcpy(destination, &packed, sizeof(packed));
+					break;
+				}
+				case VertexComponent::Color: {
+					const uint32_t packed = glm::packUnorm4x8(vertex.color);
+					memcpy(destination, &packed, sizeof(packed));
+					break;
+				}
+				case VertexComponent::Tangent: {
+					// y is remapped to [0, 1] so its sign can store the handedness, it's kept away from zero so the sign survives quantization
+					glm::vec2 encoded = octEncode(glm::vec3(vertex.tangent));
+					encoded.y = std::max(encoded.y * 0.5f + 0.5f, 1.0f / 32767.0f) * (vertex.tangent.w < 0.0f ? -1.0f : 1.0f);
+					const uint32_t packed = glm::packSnorm2x16(encoded);
+					memcpy(destination, &packed, sizeof(packed));
+					break;
+				}
+				case VertexComponent::Joint0: {
+					for (uint32_t i = 0; i < 4; i++) {
+						jointsClamped |= (vertex.joint0[i] > 255.0f);
+						destination[i] = static_cast<uint8_t>(std::min(std::max(vertex.joint0[i], 0.0f), 255.0f));
+					}
+					break;
+				}
+				case VertexComponent::Weight0: {
+					// Rounding errors are added to the largest weight, so the weights still sum up to one
+					int32_t weights[4];
+					int32_t sum = 0;
+					uint32_t largest = 0;
+					for (uint32_t i = 0; i < 4; i++) {
+						weights[i] = static_cast<int32_t>(roundf(std::min(std::max(vertex.weight0[i], 0.0f), 1.0f) * 255.0f));
+						sum += weights[i];
+						largest = (vertex.weight0[i] > vertex.weight0[largest]) ? i : largest;
+					}
+					if (sum > 0) {
+						weights[largest] = std::min(std::max(weights[largest] + 255 - sum, 0), 255);
+					}
+					for (uint32_t i = 0; i < 4; i++) {
+						destination[i] = static_cast<uint8_t>(weights[i]);
+					}
+					break;
+				}
+			}
+			destination += Vertex::packedComponentSize(component);
 		}
-		newNode->mesh = newMesh;
 	}
-	if (parent) {
-		parent->children.push_back(newNode);
-	} else {
-		nodes.push_back(newNode);
+	if (jointsClamped) {
+		std::cerr << "Joint indices above 255 can't be packed and have been clamped" << std::endl;
 	}
-	linearNodes.push_back(newNode);
 }
 
 void vkglTF::Model::loadSkins(tinygltf::Model &gltfModel)
@@ -979,10 +1712,8 @@ void vkglTF::Model::loadSkins(tinygltf::Model &gltfModel)
 		// Get inverse bind matrices from buffer
 		if (source.inverseBindMatrices > -1) {
 			const tinygltf::Accessor &accessor = gltfModel.accessors[source.inverseBindMatrices];
-			const tinygltf::BufferView &bufferView = gltfModel.bufferViews[accessor.bufferView];
-			const tinygltf::Buffer &buffer = gltfModel.buffers[bufferView.buffer];
 			newSkin->inverseBindMatrices.resize(accessor.count);
-			memcpy(newSkin->inverseBindMatrices.data(), &buffer.data[accessor.byteOffset + bufferView.byteOffset], accessor.count * sizeof(glm::mat4));
+			memcpy(newSkin->inverseBindMatrices.data(), getAccessorData(gltfModel, accessor), accessor.count * sizeof(glm::mat4));
 		}
 
 		skins.push_back(newSkin);
@@ -991,11 +1722,62 @@ void vkglTF::Model::loadSkins(tinygltf::Model &gltfModel)
 
 void vkglTF::Model::loadImages(tinygltf::Model &gltfModel, vks::VulkanDevice *device, VkQueue transferQueue)
 {
-	for (tinygltf::Image &image : gltfModel.images) {
-		vkglTF::Texture texture;
-		texture.fromglTfImage(image, path, device, transferQueue);
-		textures.push_back(texture);
+	const uint32_t imageCount = static_cast<uint32_t>(gltfModel.images.size());
+	textures.resize(imageCount);
+
+	std::vector<ktxTexture*> ktxTextures(imageCount, nullptr);
+	std::vector<std::string> decodeErrors(imageCount);
+	auto decode = [this, &gltfModel, &ktxTextures, &decodeErrors](uint32_t i) {
+		tinygltf::Image& image = gltfModel.images[i];
+		if (isKtxImage(image)) {
+			ktxTextures[i] = loadKtxTexture(path + "/" + image.uri, decodeErrors[i]);
+		} else if ((i < encodedImageData.size()) && encodedImageData[i].first) {
+			std::string warning;
+			tinygltf::LoadImageData(&image, static_cast<int>(i), &decodeErrors[i], &warning, 0, 0, encodedImageData[i].first, static_cast<int>(encodedImageData[i].second), nullptr);
+		}
+	};
+
+	// Images are decoded (or read from ktx files) on worker threads, while the calling thread uploads them in order as soon as they are ready
+	// Without a job system that the calling thread may use, each image is decoded right before its upload instead
+	const bool parallel = jobSystem && jobSystem->canSchedule();
+	std::unique_ptr<vks::JobCounter[]> decoded(new vks::JobCounter[imageCount]);
+	if (parallel) {
+		for (uint32_t i = 0; i < imageCount; i++) {
+			jobSystem->run([&decode, i] { decode(i); }, &decoded[i]);
+		}
+	}
+
+	TextureUploader uploader(device, transferQueue);
+	for (uint32_t i = 0; i < imageCount; i++) {
+		if (parallel) {
+			jobSystem->wait(decoded[i]);
+		} else {
+			decode(i);
+		}
+		tinygltf::Image& image = gltfModel.images[i];
+		vkglTF::Texture& texture = textures[i];
+		texture.device = device;
+		if (isKtxImage(image)) {
+			if (!ktxTextures[i]) {
+				vks::tools::exitFatal(decodeErrors[i], -1);
+			}
+			uploader.uploadKtx(texture, ktxTextures[i]);
+			ktxTexture_Destroy(ktxTextures[i]);
+		} else {
+			if (image.image.empty()) {
+				vks::tools::exitFatal("Could not load image \"" + image.uri + "\" of glTF file: " + decodeErrors[i], -1);
+			}
+			uploader.uploadImage(texture, image.image.data(), image.width, image.height, image.component);
+			// Decoded pixels are no longer needed once they have been copied to the staging buffer
+			std::vector<unsigned char>().swap(image.image);
+		}
+	}
+	uploader.finish();
+
+	for (auto& texture : textures) {
+		texture.createSamplerAndView();
 	}
+
 	// Create an empty texture to be used for empty material images
 	createEmptyTexture(transferQueue);
 }
@@ -1076,17 +1858,7 @@ void vkglTF::Model::loadAnimations(tinygltf::Model &gltfModel)
 			// Read sampler input time values
 			{
 				const tinygltf::Accessor &accessor = gltfModel.accessors[samp.input];
-				const tinygltf::BufferView &bufferView = gltfModel.bufferViews[accessor.bufferView];
-				const tinygltf::Buffer &buffer = gltfModel.buffers[bufferView.buffer];
-
-				assert(accessor.componentType == TINYGLTF_COMPONENT_TYPE_FLOAT);
-
-				float *buf = new float[accessor.count];
-				memcpy(buf, &buffer.data[accessor.byteOffset + bufferView.byteOffset], accessor.count * sizeof(float));
-				for (size_t index = 0; index < accessor.count; index++) {
-					sampler.inputs.push_back(buf[index]);
-				}
-                delete[] buf;
+				readAccessor(gltfModel, accessor, sampler.inputs, getAccessorData(gltfModel, accessor));
 				for (auto input : sampler.inputs) {
 					if (input < animation.start) {
 						animation.start = input;
@@ -1100,29 +1872,21 @@ void vkglTF::Model::loadAnimations(tinygltf::Model &gltfModel)
 			// Read sampler output T/R/S values 
 			{
 				const tinygltf::Accessor &accessor = gltfModel.accessors[samp.output];
-				const tinygltf::BufferView &bufferView = gltfModel.bufferViews[accessor.bufferView];
-				const tinygltf::Buffer &buffer = gltfModel.buffers[bufferView.buffer];
-
-				assert(accessor.componentType == TINYGLTF_COMPONENT_TYPE_FLOAT);
+				std::vector<float> outputs;
+				readAccessor(gltfModel, accessor, outputs, getAccessorData(gltfModel, accessor));
 
 				switch (accessor.type) {
 				case TINYGLTF_TYPE_VEC3: {
-					glm::vec3 *buf = new glm::vec3[accessor.count];
-					memcpy(buf, &buffer.data[accessor.byteOffset + bufferView.byteOffset], accessor.count * sizeof(glm::vec3));
 					for (size_t index = 0; index < accessor.count; index++) {
-						sampler.outputsVec4.push_back(glm::vec4(buf[index], 0.0f));
+						sampler.outputsVec4.push_back(glm::vec4(outputs[index * 3], outputs[index * 3 + 1], outputs[index * 3 + 2], 0.0f));
 					}
-                    delete[] buf;
-                    break;
+					break;
 				}
 				case TINYGLTF_TYPE_VEC4: {
-					glm::vec4 *buf = new glm::vec4[accessor.count];
-					memcpy(buf, &buffer.data[accessor.byteOffset + bufferView.byteOffset], accessor.count * sizeof(glm::vec4));
 					for (size_t index = 0; index < accessor.count; index++) {
-						sampler.outputsVec4.push_back(buf[index]);
+						sampler.outputsVec4.push_back(glm::make_vec4(&outputs[index * 4]));
 					}
-                    delete[] buf;
-                    break;
+					break;
 				}
 				default: {
 					std::cout << "unknown type" << std::endl;
@@ -1168,10 +1932,12 @@ void vkglTF::Model::loadFromFile(std::string filename, vks::VulkanDevice *device
 {
 	tinygltf::Model gltfModel;
 	tinygltf::TinyGLTF gltfContext;
+	// Keeps the memory mapped files alive until all data has been read from them
+	MappedGltf mappedGltf;
 	if (fileLoadingFlags & FileLoadingFlags::DontLoadImages) {
 		gltfContext.SetImageLoader(loadImageDataFuncEmpty, nullptr);
 	} else {
-		gltfContext.SetImageLoader(loadImageDataFunc, nullptr);
+		gltfContext.SetImageLoader(loadImageDataFunc, &mappedGltf.images);
 	}
 #if defined(__ANDROID__)
 	// On Android all assets are packed with the apk in a compressed form, so we need to open them using the asset manager
@@ -1184,13 +1950,29 @@ void vkglTF::Model::loadFromFile(std::string filename, vks::VulkanDevice *device
 	std::string error, warning;
 
 	this->device = device;
+	optimizeMeshes = (fileLoadingFlags & FileLoadingFlags::OptimizeMeshes) != 0;
+	meshOptimizationStatistics = MeshOptimizationStatistics();
+	generateLods = ((fileLoadingFlags & FileLoadingFlags::GenerateLods) != 0) && (lodLevelCount > 1);
+	lodTriangleCounts.clear();
 
 #if defined(__ANDROID__)
 	// On Android all assets are packed with the apk in a compressed form, so we need to open them using the asset manager
 	// We let tinygltf handle this, by passing the asset manager of our app
 	tinygltf::asset_manager = androidApp->activity->assetManager;
 #endif
-	bool fileLoaded = gltfContext.LoadASCIIFromFile(&gltfModel, &error, &warning, filename);
+	// Both .gltf and .glb files are supported, buffers are read from memory mapped files where possible
+	bool fileLoaded = loadMappedGltf(gltfContext, gltfModel, filename, path, mappedGltf, error, warning);
+	if (fileLoaded) {
+		bufferData.resize(gltfModel.buffers.size());
+		for (size_t i = 0; i < gltfModel.buffers.size(); i++) {
+			bufferData[i] = ((i < mappedGltf.buffers.size()) && mappedGltf.buffers[i]) ? mappedGltf.buffers[i] : gltfModel.buffers[i].data.data();
+		}
+		encodedImageData.resize(mappedGltf.images.size());
+		for (size_t i = 0; i < mappedGltf.images.size(); i++) {
+			const EncodedImageData& encodedImage = mappedGltf.images[i];
+			encodedImageData[i] = std::make_pair(encodedImage.data ? encodedImage.data : encodedImage.storage.data(), encodedImage.size);
+		}
+	}
 
 	std::vector<uint32_t> indexBuffer;
 	std::vector<Vertex> vertexBuffer;
@@ -1210,16 +1992,15 @@ void vkglTF::Model::loadFromFile(std::string filename, vks::VulkanDevice *device
 		}
 		loadSkins(gltfModel);
 
+		// Assign skins
 		for (auto node : linearNodes) {
-			// Assign skins
 			if (node->skinIndex > -1) {
 				node->skin = skins[node->skinIndex];
 			}
-			// Initial pose
-			if (node->mesh) {
-				node->update();
-			}
 		}
+		// Initial pose
+		transformHierarchy.build(nodes);
+		updateTransforms();
 	}
 	else {
 		// TODO: throw
@@ -1227,6 +2008,22 @@ void vkglTF::Model::loadFromFile(std::string filename, vks::VulkanDevice *device
 		return;
 	}
 
+	if (optimizeMeshes) {
+		const vks::meshoptimizer::VertexCacheStatistics& before = meshOptimizationStatistics.before;
+		const vks::meshoptimizer::VertexCacheStatistics& after = meshOptimizationStatistics.after;
+		std::cout << "Optimized meshes of " << filename << ": " << before.vertexCount << " -> " << after.vertexCount << " vertices, ACMR " << before.acmr() << " -> " << after.acmr() << ", ATVR " << before.atvr() << " -> " << after.atvr() << std::endl;
+	}
+	if (!lodTriangleCounts.empty()) {
+		std::cout << "Generated levels of detail for " << filename << ":";
+		for (uint32_t triangleCount : lodTriangleCounts) {
+			std::cout << " " << triangleCount;
+		}
+		std::cout << " triangles" << std::endl;
+	}
+
+	preTransformed = (fileLoadingFlags & FileLoadingFlags::PreTransformVertices) != 0;
+	flippedY = (fileLoadingFlags & FileLoadingFlags::FlipY) != 0;
+
 	// Pre-Calculations for requested features
 	if ((fileLoadingFlags & FileLoadingFlags::PreTransformVertices) || (fileLoadingFlags & FileLoadingFlags::PreMultiplyVertexColors) || (fileLoadingFlags & FileLoadingFlags::FlipY)) {
 		const bool preTransform = fileLoadingFlags & FileLoadingFlags::PreTransformVertices;
@@ -1235,7 +2032,14 @@ void vkglTF::Model::loadFromFile(std::string filename, vks::VulkanDevice *device
 		for (Node* node : linearNodes) {
 			if (node->mesh) {
 				const glm::mat4 localMatrix = node->getMatrix();
+				// Errors of the detail levels grow with the largest scale of the transform
+				const float maxScale = std::max(glm::length(glm::vec3(localMatrix[0])), std::max(glm::length(glm::vec3(localMatrix[1])), glm::length(glm::vec3(localMatrix[2]))));
 				for (Primitive* primitive : node->mesh->primitives) {
+					if (preTransform) {
+						for (Primitive::Lod& lod : primitive->lods) {
+							lod.error *= maxScale;
+						}
+					}
 					for (uint32_t i = 0; i < primitive->vertexCount; i++) {
 						Vertex& vertex = vertexBuffer[primitive->firstVertex + i];
 						// Pre-transform vertex positions by node-hierarchy
@@ -1265,7 +2069,20 @@ void vkglTF::Model::loadFromFile(std::string filename, vks::VulkanDevice *device
 		}
 	}
 
-	size_t vertexBufferSize = vertexBuffer.size() * sizeof(Vertex);
+	// All data has been read from the glTF buffers, the mappings are released when leaving this function
+	bufferData.clear();
+	encodedImageData.clear();
+
+	std::vector<uint8_t> packedVertexBuffer;
+	vertexDequantization = glm::mat4(1.0f);
+	vertices.stride = sizeof(Vertex);
+	if (fileLoadingFlags & FileLoadingFlags::PackVertices) {
+		packVertices(vertexBuffer, packedVertexBuffer);
+		vertices.stride = Vertex::packedStride(packedVertexComponents);
+	}
+	void* vertexData = packedVertexBuffer.empty() ? static_cast<void*>(vertexBuffer.data()) : static_cast<void*>(packedVertexBuffer.data());
+
+	size_t vertexBufferSize = vertexBuffer.size() * vertices.stride;
 	size_t indexBufferSize = indexBuffer.size() * sizeof(uint32_t);
 	indices.count = static_cast<uint32_t>(indexBuffer.size());
 	vertices.count = static_cast<uint32_t>(vertexBuffer.size());
@@ -1274,7 +2091,7 @@ void vkglTF::Model::loadFromFile(std::string filename, vks::VulkanDevice *device
 
 	struct StagingBuffer {
 		VkBuffer buffer;
-		VkDeviceMemory memory;
+		vks::Allocation* allocation;
 	} vertexStaging, indexStaging;
 
 	// Create staging buffers
@@ -1284,16 +2101,18 @@ void vkglTF::Model::loadFromFile(std::string filename, vks::VulkanDevice *device
 		VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
 		vertexBufferSize,
 		&vertexStaging.buffer,
-		&vertexStaging.memory,
-		vertexBuffer.data()));
+		&vertexStaging.allocation,
+		vertexData,
+		vks::AllocationStrategy::Linear));
 	// Index data
 	VK_CHECK_RESULT(device->createBuffer(
 		VK_BUFFER_USAGE_TRANSFER_SRC_BIT,
 		VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
 		indexBufferSize,
 		&indexStaging.buffer,
-		&indexStaging.memory,
-		indexBuffer.data()));
+		&indexStaging.allocation,
+		indexBuffer.data(),
+		vks::AllocationStrategy::Linear));
 
 	// Create device local buffers
 	// Vertex buffer
@@ -1302,14 +2121,16 @@ void vkglTF::Model::loadFromFile(std::string filename, vks::VulkanDevice *device
 		VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT,
 		vertexBufferSize,
 		&vertices.buffer,
-		&vertices.memory));
+		&vertices.allocation));
+	vertices.memory = vertices.allocation->memory;
 	// Index buffer
 	VK_CHECK_RESULT(device->createBuffer(
 	    VK_BUFFER_USAGE_INDEX_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT | memoryPropertyFlags,
 		VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT,
 		indexBufferSize,
 		&indices.buffer,
-		&indices.memory));
+		&indices.allocation));
+	indices.memory = indices.allocation->memory;
 
 	// Copy from staging buffers
 	VkCommandBuffer copyCmd = device->createCommandBuffer(VK_COMMAND_BUFFER_LEVEL_PRIMARY, true);
@@ -1325,11 +2146,12 @@ void vkglTF::Model::loadFromFile(std::string filename, vks::VulkanDevice *device
 	device->flushCommandBuffer(copyCmd, transferQueue, true);
 
 	vkDestroyBuffer(device->logicalDevice, vertexStaging.buffer, nullptr);
-	vkFreeMemory(device->logicalDevice, vertexStaging.memory, nullptr);
+	device->memoryAllocator.free(vertexStaging.allocation);
 	vkDestroyBuffer(device->logicalDevice, indexStaging.buffer, nullptr);
-	vkFreeMemory(device->logicalDevice, indexStaging.memory, nullptr);
+	device->memoryAllocator.free(indexStaging.allocation);
 
 	getSceneDimensions();
+	buildBvh();
 
 	// Setup descriptors
 	uint32_t uboCount{ 0 };
@@ -1484,6 +2306,80 @@ void vkglTF::Model::getSceneDimensions()
 	dimensions.radius = glm::distance(dimensions.min, dimensions.max) / 2.0f;
 }
 
+/*
+	Frustum culling
+*/
+
+// Adds the primitives of a node and its children in the same order as Model::drawNode visits them
+static void addCullItems(vkglTF::Node* node, std::vector<vkglTF::Model::CullItem>& cullItems)
+{
+	if (node->mesh) {
+		for (vkglTF::Primitive* primitive : node->mesh->primitives) {
+			cullItems.push_back({ node, primitive });
+		}
+	}
+	for (vkglTF::Node* child : node->children) {
+		addCullItems(child, cullItems);
+	}
+}
+
+// Bounds of a primitive in the space it's drawn in, vertices may have been moved by the node hierarchy and flipped at load time
+void vkglTF::Model::getPrimitiveBounds(Node* node, const Primitive* primitive, glm::vec3& min, glm::vec3& max) const
+{
+	glm::vec3 center = (primitive->dimensions.min + primitive->dimensions.max) * 0.5f;
+	glm::vec3 extent = (primitive->dimensions.max - primitive->dimensions.min) * 0.5f;
+	if (flippedY && !preTransformed) {
+		center.y = -center.y;
+	}
+	// Transforming the center and projecting the extent onto the matrix axes gives the tightest box around the transformed box
+	const glm::mat4 matrix = node->getMatrix();
+	center = glm::vec3(matrix * glm::vec4(center, 1.0f));
+	extent = glm::vec3(
+		fabsf(matrix[0][0]) * extent.x + fabsf(matrix[1][0]) * extent.y + fabsf(matrix[2][0]) * extent.z,
+		fabsf(matrix[0][1]) * extent.x + fabsf(matrix[1][1]) * extent.y + fabsf(matrix[2][1]) * extent.z,
+		fabsf(matrix[0][2]) * extent.x + fabsf(matrix[1][2]) * extent.y + fabsf(matrix[2][2]) * extent.z);
+	if (flippedY && preTransformed) {
+		center.y = -center.y;
+	}
+	min = center - extent;
+	max = center + extent;
+}
+
+void vkglTF::Model::buildBvh()
+{
+	cullItems.clear();
+	bvhItems.clear();
+	unculledItems.clear();
+	for (Node* node : nodes) {
+		addCullItems(node, cullItems);
+	}
+	std::vector<glm::vec3> min, max;
+	for (uint32_t i = 0; i < static_cast<uint32_t>(cullItems.size()); i++) {
+		const CullItem& item = cullItems[i];
+		if (item.node->skin && !preTransformed) {
+			unculledItems.push_back(i);
+			continue;
+		}
+		glm::vec3 itemMin, itemMax;
+		getPrimitiveBounds(item.node, item.primitive, itemMin, itemMax);
+		min.push_back(itemMin);
+		max.push_back(itemMax);
+		bvhItems.push_back(i);
+	}
+	bvh.build(min, max);
+}
+
+void vkglTF::Model::cull(const vks::Frustum& frustum, std::vector<uint32_t>& visibleItems) const
+{
+	bvh.cull(frustum, visibleItems);
+	for (uint32_t& item : visibleItems) {
+		item = bvhItems[item];
+	}
+	visibleItems.insert(visibleItems.end(), unculledItems.begin(), unculledItems.end());
+	// The traversal order depends on the hierarchy, blended primitives need to be drawn in the model's order
+	std::sort(visibleItems.begin(), visibleItems.end());
+}
+
 void vkglTF::Model::updateAnimation(uint32_t index, float time)
 {
 	if (index > static_cast<uint32_t>(animations.size()) - 1) {
@@ -1492,53 +2388,151 @@ void vkglTF::Model::updateAnimation(uint32_t index, float time)
 	}
 	Animation &animation = animations[index];
 
-	bool updated = false;
 	for (auto& channel : animation.channels) {
 		vkglTF::AnimationSampler &sampler = animation.samplers[channel.samplerIndex];
-		if (sampler.inputs.size() > sampler.outputsVec4.size()) {
+		const size_t outputsPerKeyFrame = (sampler.interpolation == AnimationSampler::InterpolationType::CUBICSPLINE) ? 3 : 1;
+		if (sampler.inputs.empty() || (sampler.inputs.size() * outputsPerKeyFrame > sampler.outputsVec4.size())) {
 			continue;
 		}
 
-		for (auto i = 0; i < sampler.inputs.size() - 1; i++) {
-			if ((time >= sampler.inputs[i]) && (time <= sampler.inputs[i + 1])) {
-				float u = std::max(0.0f, time - sampler.inputs[i]) / (sampler.inputs[i + 1] - sampler.inputs[i]);
-				if (u <= 1.0f) {
-					switch (channel.path) {
-					case vkglTF::AnimationChannel::PathType::TRANSLATION: {
-						glm::vec4 trans = glm::mix(sampler.outputsVec4[i], sampler.outputsVec4[i + 1], u);
-						channel.node->translation = glm::vec3(trans);
-						break;
-					}
-					case vkglTF::AnimationChannel::PathType::SCALE: {
-						glm::vec4 trans = glm::mix(sampler.outputsVec4[i], sampler.outputsVec4[i + 1], u);
-						channel.node->scale = glm::vec3(trans);
-						break;
-					}
-					case vkglTF::AnimationChannel::PathType::ROTATION: {
-						glm::quat q1;
-						q1.x = sampler.outputsVec4[i].x;
-						q1.y = sampler.outputsVec4[i].y;
-						q1.z = sampler.outputsVec4[i].z;
-						q1.w = sampler.outputsVec4[i].w;
-						glm::quat q2;
-						q2.x = sampler.outputsVec4[i + 1].x;
-						q2.y = sampler.outputsVec4[i + 1].y;
-						q2.z = sampler.outputsVec4[i + 1].z;
-						q2.w = sampler.outputsVec4[i + 1].w;
-						channel.node->rotation = glm::normalize(glm::slerp(q1, q2, u));
-						break;
-					}
-					}
-					updated = true;
-				}
+		const vks::animation::KeyFrame keyFrame = vks::animation::findKeyFrame(sampler.inputs, time, sampler.cursor);
+		const uint32_t transformIndex = channel.node->transformIndex;
+		if (channel.path == vkglTF::AnimationChannel::PathType::ROTATION) {
+			glm::quat rotation;
+			switch (sampler.interpolation) {
+			case AnimationSampler::InterpolationType::LINEAR:
+				rotation = vks::animation::slerp(sampler.outputsVec4, keyFrame);
+				break;
+			case AnimationSampler::InterpolationType::STEP:
+				rotation = vks::animation::toQuat(vks::animation::step(sampler.outputsVec4, keyFrame));
+				break;
+			case AnimationSampler::InterpolationType::CUBICSPLINE:
+				rotation = glm::normalize(vks::animation::toQuat(vks::animation::cubicSpline(sampler.outputsVec4, keyFrame)));
+				break;
+			}
+			transformHierarchy.setRotation(transformIndex, rotation);
+			continue;
+		}
+
+		glm::vec4 value;
+		switch (sampler.interpolation) {
+		case AnimationSampler::InterpolationType::LINEAR:
+			value = vks::animation::linear(sampler.outputsVec4, keyFrame);
+			break;
+		case AnimationSampler::InterpolationType::STEP:
+			value = vks::animation::step(sampler.outputsVec4, keyFrame);
+			break;
+		case AnimationSampler::InterpolationType::CUBICSPLINE:
+			value = vks::animation::cubicSpline(sampler.outputsVec4, keyFrame);
+			break;
+		}
+		if (channel.path == vkglTF::AnimationChannel::PathType::TRANSLATION) {
+			transformHierarchy.setTranslation(transformIndex, glm::vec3(value));
+		} else {
+			transformHierarchy.setScale(transformIndex, glm::vec3(value));
+		}
+	}
+	updateTransforms();
+}
+
+/*
+	Updates the world matrices of all animated sub trees and the uniform buffers of meshes affected by them
+*/
+void vkglTF::Model::updateTransforms()
+{
+	if (!transformHierarchy.update()) {
+		return;
+	}
+	for (Node* node : transformHierarchy.nodes) {
+		if (!node->mesh) {
+			continue;
+		}
+		bool changed = transformHierarchy.changed[node->transformIndex] != 0;
+		if (node->skin) {
+			for (size_t i = 0; (i < node->skin->joints.size()) && !changed; i++) {
+				changed = transformHierarchy.changed[node->skin->joints[i]->transformIndex] != 0;
 			}
 		}
+		if (changed) {
+			node->updateUniformBuffer();
+		}
+	}
+	// Pre-transformed vertices don't follow their nodes, so only the bounds of models drawn with node matrices change
+	if (preTransformed) {
+		return;
+	}
+	bool refit = false;
+	for (uint32_t i = 0; i < static_cast<uint32_t>(bvhItems.size()); i++) {
+		const CullItem& item = cullItems[bvhItems[i]];
+		if (transformHierarchy.changed[item.node->transformIndex]) {
+			glm::vec3 min, max;
+			getPrimitiveBounds(item.node, item.primitive, min, max);
+			bvh.setItemBounds(i, min, max);
+			refit = true;
+		}
+	}
+	if (refit) {
+		bvh.refit();
+	}
+}
+
+/*
+	Creates a clip from an animation that can be shared by many instances of this model
+	Clip node indices match the node's index into the model's transform hierarchy
+*/
+vks::animation::Clip vkglTF::Model::createAnimationClip(uint32_t index)
+{
+	vks::animation::Clip clip;
+	if (index >= static_cast<uint32_t>(animations.size())) {
+		std::cout << "No animation with index " << index << std::endl;
+		return clip;
+	}
+	const Animation &animation = animations[index];
+
+	clip.parents = transformHierarchy.parents;
+	for (Node* node : transformHierarchy.nodes) {
+		clip.translations.push_back(node->getTranslation());
+		clip.rotations.push_back(node->getRotation());
+		clip.scales.push_back(node->getScale());
+		clip.matrices.push_back(node->getTransformMatrix());
+	}
+	for (const AnimationSampler& source : animation.samplers) {
+		vks::animation::Clip::Sampler sampler;
+		switch (source.interpolation) {
+		case AnimationSampler::InterpolationType::LINEAR:
+			sampler.interpolation = vks::animation::Interpolation::Linear;
+			break;
+		case AnimationSampler::InterpolationType::STEP:
+			sampler.interpolation = vks::animation::Interpolation::Step;
+			break;
+		case AnimationSampler::InterpolationType::CUBICSPLINE:
+			sampler.interpolation = vks::animation::Interpolation::CubicSpline;
+			break;
+		}
+		sampler.inputs = source.inputs;
+		sampler.outputs = source.outputsVec4;
+		clip.samplers.push_back(sampler);
 	}
-	if (updated) {
-		for (auto &node : nodes) {
-			node->update();
+	for (const AnimationChannel& source : animation.channels) {
+		vks::animation::Clip::Channel channel;
+		channel.node = source.node->transformIndex;
+		channel.sampler = source.samplerIndex;
+		switch (source.path) {
+		case AnimationChannel::PathType::TRANSLATION:
+			channel.path = vks::animation::Path::Translation;
+			break;
+		case AnimationChannel::PathType::ROTATION:
+			channel.path = vks::animation::Path::Rotation;
+			break;
+		case AnimationChannel::PathType::SCALE:
+			channel.path = vks::animation::Path::Scale;
+			break;
 		}
+		clip.channels.push_back(channel);
 	}
+	clip.start = animation.start;
+	clip.end = animation.end;
+	return clip;
 }
 
 /*
@@ -1592,3 +2586,499 @@ void vkglTF::Model::prepareNodeDescriptor(vkglTF::Node* node, VkDescriptorSetLay
 		prepareNodeDescriptor(child, descriptorSetLayout);
 	}
 }
+
+/*
+	Parallel draw recording
+*/
+
+// Checks the primitive's material against the alpha mode render flags, if none of these flags is set all primitives are drawn
+static bool alphaModeSelected(const vkglTF::Material& material, uint32_t renderFlags)
+{
+	const uint32_t alphaModeFlags = renderFlags & (vkglTF::RenderFlags::RenderOpaqueNodes | vkglTF::RenderFlags::RenderAlphaMaskedNodes | vkglTF::RenderFlags::RenderAlphaBlendedNodes);
+	if (alphaModeFlags == 0) {
+		return true;
+	}
+	switch (material.alphaMode) {
+	case vkglTF::Material::ALPHAMODE_OPAQUE:
+		return (alphaModeFlags & vkglTF::RenderFlags::RenderOpaqueNodes) != 0;
+	case vkglTF::Material::ALPHAMODE_MASK:
+		return (alphaModeFlags & vkglTF::RenderFlags::RenderAlphaMaskedNodes) != 0;
+	default:
+		return (alphaModeFlags & vkglTF::RenderFlags::RenderAlphaBlendedNodes) != 0;
+	}
+}
+
+// Flattens the primitives of a node and its children in the same order as Model::drawNode
+template<typename F>
+static void gatherPrimitives(const vkglTF::Node* node, const F& function)
+{
+	if (node->mesh) {
+		for (const vkglTF::Primitive* primitive : node->mesh->primitives) {
+			function(primitive);
+		}
+	}
+	for (const vkglTF::Node* child : node->children) {
+		gatherPrimitives(child, function);
+	}
+}
+
+vkglTF::ParallelDrawRecorder::~ParallelDrawRecorder()
+{
+	destroy();
+}
+
+void vkglTF::ParallelDrawRecorder::prepare(vks::VulkanDevice* device, vks::JobSystem* jobSystem, uint32_t slotCount)
+{
+	destroy();
+	this->device = device;
+	this->jobSystem = jobSystem;
+	ranges.resize(jobSystem->threadCount());
+	for (Range& range : ranges) {
+		range.commandPools.resize(slotCount);
+		range.commandBuffers.resize(slotCount);
+		for (uint32_t i = 0; i < slotCount; i++) {
+			// Pools are reset as a whole before recording, which is cheaper than resetting individual command buffers
+			VkCommandPoolCreateInfo commandPoolCI = vks::initializers::commandPoolCreateInfo();
+			commandPoolCI.queueFamilyIndex = device->queueFamilyIndices.graphics;
+			commandPoolCI.flags = VK_COMMAND_POOL_CREATE_TRANSIENT_BIT;
+			VK_CHECK_RESULT(vkCreateCommandPool(device->logicalDevice, &commandPoolCI, nullptr, &range.commandPools[i]));
+			VkCommandBufferAllocateInfo commandBufferAI = vks::initializers::commandBufferAllocateInfo(range.commandPools[i], VK_COMMAND_BUFFER_LEVEL_SECONDARY, 1);
+			VK_CHECK_RESULT(vkAllocateCommandBuffers(device->logicalDevice, &commandBufferAI, &range.commandBuffers[i]));
+		}
+	}
+}
+
+void vkglTF::ParallelDrawRecorder::destroy()
+{
+	if (!device) {
+		return;
+	}
+	for (Range& range : ranges) {
+		for (VkCommandPool commandPool : range.commandPools) {
+			vkDestroyCommandPool(device->logicalDevice, commandPool, nullptr);
+		}
+	}
+	ranges.clear();
+	device = nullptr;
+}
+
+void vkglTF::ParallelDrawRecorder::recordRange(Range& range, const Model& model, const DrawInfo& drawInfo, uint32_t slot, uint32_t firstItem, uint32_t itemCount)
+{
+	auto tStart = std::chrono::high_resolution_clock::now();
+	ThreadStatistics& rangeStatistics = range.statistics;
+	rangeStatistics = ThreadStatistics();
+	rangeStatistics.threadIndex = jobSystem->threadIndex();
+
+	VkCommandBuffer commandBuffer = range.commandBuffers[slot];
+	VK_CHECK_RESULT(vkResetCommandPool(device->logicalDevice, range.commandPools[slot], 0));
+	VkCommandBufferBeginInfo commandBufferBI = vks::initializers::commandBufferBeginInfo();
+	commandBufferBI.flags = VK_COMMAND_BUFFER_USAGE_RENDER_PASS_CONTINUE_BIT;
+	commandBufferBI.pInheritanceInfo = &drawInfo.inheritanceInfo;
+	VK_CHECK_RESULT(vkBeginCommandBuffer(commandBuffer, &commandBufferBI));
+	if (drawInfo.beginCommandBuffer) {
+		drawInfo.beginCommandBuffer(commandBuffer);
+	}
+	const VkDeviceSize offsets[1] = { 0 };
+	vkCmdBindVertexBuffers(commandBuffer, 0, 1, &model.vertices.buffer, offsets);
+	vkCmdBindIndexBuffer(commandBuffer, model.indices.buffer, 0, VK_INDEX_TYPE_UINT32);
+
+	VkPipeline boundPipeline = VK_NULL_HANDLE;
+	uint32_t boundMaterial = UINT32_MAX;
+	for (uint32_t i = firstItem; i < firstItem + itemCount; i++) {
+		const DrawItem& item = drawItems[i];
+		if ((item.pipeline != VK_NULL_HANDLE) && (item.pipeline != boundPipeline)) {
+			vkCmdBindPipeline(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, item.pipeline);
+			boundPipeline = item.pipeline;
+			rangeStatistics.pipelineBinds++;
+		}
+		if ((drawInfo.renderFlags & RenderFlags::BindImages) && (item.materialIndex != boundMaterial)) {
+			vkCmdBindDescriptorSets(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, drawInfo.pipelineLayout, drawInfo.bindImageSet, 1, &item.primitive->material.descriptorSet, 0, nullptr);
+			boundMaterial = item.materialIndex;
+			rangeStatistics.descriptorSetBinds++;
+		}
+		vkCmdDrawIndexed(commandBuffer, item.primitive->indexCount, 1, item.primitive->firstIndex, 0, 0);
+		rangeStatistics.drawCount++;
+	}
+	VK_CHECK_RESULT(vkEndCommandBuffer(commandBuffer));
+	rangeStatistics.recordTime = std::chrono::duration<double, std::milli>(std::chrono::high_resolution_clock::now() - tStart).count();
+}
+
+const std::vector<VkCommandBuffer>& vkglTF::ParallelDrawRecorder::record(const Model& model, const DrawInfo& drawInfo, uint32_t slot)
+{
+	auto tStart = std::chrono::high_resolution_clock::now();
+
+	// Flatten the primitives to draw, the list's storage is reused across calls
+	drawItems.clear();
+	const Material* firstMaterial = model.materials.empty() ? nullptr : &model.materials[0];
+	auto addDrawItem = [&](const Primitive* primitive) {
+		const Material& material = primitive->material;
+		if ((primitive->indexCount == 0) || !alphaModeSelected(material, drawInfo.renderFlags)) {
+			return;
+		}
+		DrawItem item;
+		item.pipeline = drawInfo.getPipeline ? drawInfo.getPipeline(material) : VK_NULL_HANDLE;
+		item.materialIndex = static_cast<uint32_t>(&material - firstMaterial);
+		item.blended = (material.alphaMode == Material::ALPHAMODE_BLEND);
+		item.primitive = primitive;
+		drawItems.push_back(item);
+	};
+	culledCount = 0;
+	if (drawInfo.frustum) {
+		model.cull(*drawInfo.frustum, visibleItems);
+		for (uint32_t item : visibleItems) {
+			addDrawItem(model.cullItems[item].primitive);
+		}
+		culledCount = static_cast<uint32_t>(model.cullItems.size() - visibleItems.size());
+	} else {
+		for (const Node* node : model.nodes) {
+			gatherPrimitives(node, addDrawItem);
+		}
+	}
+
+	// Sort by pipeline and material to minimize binds, blended primitives are drawn last and keep their order
+	std::stable_sort(drawItems.begin(), drawItems.end(), [](const DrawItem& a, const DrawItem& b) {
+		if (a.blended || b.blended) {
+			return !a.blended && b.blended;
+		}
+		if (a.pipeline != b.pipeline) {
+			return a.pipeline < b.pipeline;
+		}
+		return a.materialIndex < b.materialIndex;
+	});
+
+	// Split into contiguous ranges, so every range only binds the state that changes within it
+	const uint32_t itemCount = static_cast<uint32_t>(drawItems.size());
+	const uint32_t rangeCount = std::max(std::min(static_cast<uint32_t>(ranges.size()), itemCount), 1u);
+	const uint32_t itemsPerRange = (itemCount + rangeCount - 1) / rangeCount;
+	jobSystem->parallelFor(rangeCount, 1, [&](uint32_t begin, uint32_t end) {
+		for (uint32_t r = begin; r < end; r++) {
+			const uint32_t firstItem = std::min(r * itemsPerRange, itemCount);
+			recordRange(ranges[r], model, drawInfo, slot, firstItem, std::min(itemsPerRange, itemCount - firstItem));
+		}
+	});
+
+	recordedCommandBuffers.clear();
+	statistics.clear();
+	for (uint32_t r = 0; r < rangeCount; r++) {
+		recordedCommandBuffers.push_back(ranges[r].commandBuffers[slot]);
+		statistics.push_back(ranges[r].statistics);
+	}
+	recordTime = std::chrono::duration<double, std::milli>(std::chrono::high_resolution_clock::now() - tStart).count();
+	return recordedCommandBuffers;
+}
+
+const std::vector<vkglTF::ParallelDrawRecorder::ThreadStatistics>& vkglTF::ParallelDrawRecorder::getStatistics() const
+{
+	return statistics;
+}
+
+/*
+	GPU driven rendering
+*/
+
+vkglTF::IndirectRenderer::~IndirectRenderer()
+{
+	destroy();
+}
+
+void vkglTF::IndirectRenderer::getObjectData(const Model::CullItem& object, ObjectData& objectData) const
+{
+	const Primitive* primitive = object.primitive;
+	objectData = ObjectData();
+	// Pre-transformed vertices already are in model space, otherwise the bounds need the same flip as the vertices
+	if (model->preTransformed) {
+		objectData.matrix = glm::mat4(1.0f);
+		glm::vec3 min, max;
+		model->getPrimitiveBounds(object.node, primitive, min, max);
+		objectData.boundsMin = glm::vec4(min, 0.0f);
+		objectData.boundsMax = glm::vec4(max, 0.0f);
+	} else {
+		objectData.matrix = object.node->getMatrix();
+		objectData.boundsMin = glm::vec4(primitive->dimensions.min, 0.0f);
+		objectData.boundsMax = glm::vec4(primitive->dimensions.max, 0.0f);
+		if (model->flippedY) {
+			objectData.boundsMin.y = -primitive->dimensions.max.y;
+			objectData.boundsMax.y = -primitive->dimensions.min.y;
+		}
+	}
+	objectData.materialIndex = static_cast<uint32_t>(&primitive->material - model->materials.data());
+	// A level is used up to the distance at which the error of the next one becomes acceptable, lodDistanceScale converts
+	// errors into these distances, node transforms scale the errors unless they have already been applied to the vertices
+	const glm::mat4& matrix = objectData.matrix;
+	const float errorScale = std::max(glm::length(glm::vec3(matrix[0])), std::max(glm::length(glm::vec3(matrix[1])), glm::length(glm::vec3(matrix[2]))));
+	const uint32_t lodCount = static_cast<uint32_t>(primitive->lods.size());
+	objectData.lodCount = (lodCount < maxLodCount) ? lodCount : maxLodCount;
+	for (uint32_t i = 0; i < objectData.lodCount; i++) {
+		objectData.lods[i].firstIndex = primitive->lods[i].firstIndex;
+		objectData.lods[i].indexCount = primitive->lods[i].indexCount;
+		objectData.lods[i].distance = (i + 1 < objectData.lodCount) ? primitive->lods[i + 1].error * errorScale : FLT_MAX;
+	}
+}
+
+float vkglTF::IndirectRenderer::getLodDistanceScale(const glm::mat4& projection, float viewportHeight, float pixelError)
+{
+	// An error e at distance d covers e * projection[1][1] / d in normalized device coordinates, which span two viewport heights
+	return fabsf(projection[1][1]) * viewportHeight * 0.5f / pixelError;
+}
+
+void vkglTF::IndirectRenderer::prepare(Model* model, vks::VulkanDevice* device, VkQueue transferQueue, const VkPipelineShaderStageCreateInfo& cullShader, uint32_t slotCount)
+{
+	destroy();
+	this->model = model;
+	this->device = device;
+
+	objects.clear();
+	auto addObjects = [&](Material::AlphaMode alphaMode) {
+		const size_t first = objects.size();
+		for (const Model::CullItem& item : model->cullItems) {
+			if ((item.primitive->indexCount == 0) || (item.primitive->material.alphaMode != alphaMode) || (item.node->skin && !model->preTransformed)) {
+				continue;
+			}
+			objects.push_back(item);
+		}
+		return static_cast<uint32_t>(objects.size() - first);
+	};
+	opaqueCount = addObjects(Material::ALPHAMODE_OPAQUE);
+	maskedCount = addObjects(Material::ALPHAMODE_MASK);
+	// Buffers can't be empty
+	const uint32_t objectCapacity = std::max(static_cast<uint32_t>(objects.size()), 1u);
+
+	// Objects are host visible, so animated transforms can be written directly
+	std::vector<ObjectData> objectData(objectCapacity);
+	for (size_t i = 0; i < objects.size(); i++) {
+		getObjectData(objects[i], objectData[i]);
+	}
+	VK_CHECK_RESULT(device->createBuffer(VK_BUFFER_USAGE_STORAGE_BUFFER_BIT, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT, &objectBuffer, objectCapacity * sizeof(ObjectData), objectData.data()));
+	VK_CHECK_RESULT(objectBuffer.map());
+
+	// Materials reference textures by their index into the texture array, the model's empty texture is appended for materials without textures
+	std::vector<VkDescriptorImageInfo> imageDescriptors;
+	for (const Texture& texture : model->textures) {
+		imageDescriptors.push_back(texture.descriptor);
+	}
+	const int32_t emptyTextureIndex = static_cast<int32_t>(imageDescriptors.size());
+	imageDescriptors.push_back(model->emptyTexture.descriptor);
+	auto getTextureIndex = [&](const Texture* texture) {
+		if (!texture || (texture < model->textures.data()) || (texture >= model->textures.data() + model->textures.size())) {
+			return emptyTextureIndex;
+		}
+		return static_cast<int32_t>(texture - model->textures.data());
+	};
+	std::vector<MaterialData> materialData(std::max(model->materials.size(), size_t(1)));
+	for (size_t i = 0; i < model->materials.size(); i++) {
+		const Material& material = model->materials[i];
+		materialData[i].baseColorFactor = material.baseColorFactor;
+		materialData[i].baseColorTexture = getTextureIndex(material.baseColorTexture);
+		materialData[i].normalTexture = getTextureIndex(material.normalTexture);
+		materialData[i].alphaCutoff = material.alphaCutoff;
+	}
+	vks::Buffer stagingBuffer;
+	const VkDeviceSize materialBufferSize = materialData.size() * sizeof(MaterialData);
+	VK_CHECK_RESULT(device->createBuffer(VK_BUFFER_USAGE_TRANSFER_SRC_BIT, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT, &stagingBuffer, materialBufferSize, materialData.data()));
+	VK_CHECK_RESULT(device->createBuffer(VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, &materialBuffer, materialBufferSize));
+	device->copyBuffer(&stagingBuffer, &materialBuffer, transferQueue);
+	stagingBuffer.destroy();
+
+	// Draw commands are written by the culling pass, the counts are copied to a host visible buffer per slot for statistics
+	VK_CHECK_RESULT(device->createBuffer(VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_INDIRECT_BUFFER_BIT, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, &drawCommandBuffer, objectCapacity * sizeof(VkDrawIndexedIndirectCommand)));
+	VK_CHECK_RESULT(device->createBuffer(VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_INDIRECT_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_SRC_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, &countBuffer, sizeof(Statistics)));
+	statisticsBuffers.resize(std::max(slotCount, 1u));
+	for (vks::Buffer& statisticsBuffer : statisticsBuffers) {
+		VK_CHECK_RESULT(device->createBuffer(VK_BUFFER_USAGE_TRANSFER_DST_BIT, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT, &statisticsBuffer, sizeof(Statistics)));
+		VK_CHECK_RESULT(statisticsBuffer.map());
+		memset(statisticsBuffer.mapped, 0, sizeof(Statistics));
+		VK_CHECK_RESULT(statisticsBuffer.flush());
+	}
+	VK_CHECK_RESULT(device->createBuffer(VK_BUFFER_USAGE_UNIFORM_BUFFER_BIT, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT, &parameterBuffer, sizeof(CullParameters)));
+	VK_CHECK_RESULT(parameterBuffer.map());
+	memset(parameterBuffer.mapped, 0, sizeof(CullParameters));
+
+	// Descriptors
+	const uint32_t imageCount = static_cast<uint32_t>(imageDescriptors.size());
+	std::vector<VkDescriptorPoolSize> poolSizes = {
+		vks::initializers::descriptorPoolSize(VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, 5),
+		vks::initializers::descriptorPoolSize(VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER, 1),
+		vks::initializers::descriptorPoolSize(VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, imageCount),
+	};
+	VkDescriptorPoolCreateInfo descriptorPoolCI = vks::initializers::descriptorPoolCreateInfo(poolSizes, 2);
+	VK_CHECK_RESULT(vkCreateDescriptorPool(device->logicalDevice, &descriptorPoolCI, nullptr, &descriptorPool));
+
+	std::vector<VkDescriptorSetLayoutBinding> setLayoutBindings = {
+		vks::initializers::descriptorSetLayoutBinding(VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, VK_SHADER_STAGE_COMPUTE_BIT, 0),
+		vks::initializers::descriptorSetLayoutBinding(VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, VK_SHADER_STAGE_COMPUTE_BIT, 1),
+		vks::initializers::descriptorSetLayoutBinding(VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, VK_SHADER_STAGE_COMPUTE_BIT, 2),
+		vks::initializers::descriptorSetLayoutBinding(VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER, VK_SHADER_STAGE_COMPUTE_BIT, 3),
+	};
+	VkDescriptorSetLayoutCreateInfo descriptorSetLayoutCI = vks::initializers::descriptorSetLayoutCreateInfo(setLayoutBindings);
+	VK_CHECK_RESULT(vkCreateDescriptorSetLayout(device->logicalDevice, &descriptorSetLayoutCI, nullptr, &cullDescriptorSetLayout));
+	// The texture array is indexed with non-uniform indices from the material buffer
+	setLayoutBindings = {
+		vks::initializers::descriptorSetLayoutBinding(VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, VK_SHADER_STAGE_VERTEX_BIT, 0),
+		vks::initializers::descriptorSetLayoutBinding(VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, VK_SHADER_STAGE_FRAGMENT_BIT, 1),
+		vks::initializers::descriptorSetLayoutBinding(VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, VK_SHADER_STAGE_FRAGMENT_BIT, 2, imageCount),
+	};
+	descriptorSetLayoutCI = vks::initializers::descriptorSetLayoutCreateInfo(setLayoutBindings);
+	VK_CHECK_RESULT(vkCreateDescriptorSetLayout(device->logicalDevice, &descriptorSetLayoutCI, nullptr, &descriptorSetLayout));
+
+	VkDescriptorSetAllocateInfo descriptorSetAI = vks::initializers::descriptorSetAllocateInfo(descriptorPool, &cullDescriptorSetLayout, 1);
+	VK_CHECK_RESULT(vkAllocateDescriptorSets(device->logicalDevice, &descriptorSetAI, &cullDescriptorSet));
+	descriptorSetAI = vks::initializers::descriptorSetAllocateInfo(descriptorPool, &descriptorSetLayout, 1);
+	VK_CHECK_RESULT(vkAllocateDescriptorSets(device->logicalDevice, &descriptorSetAI, &descriptorSet));
+	std::vector<VkWriteDescriptorSet> writeDescriptorSets = {
+		vks::initializers::writeDescriptorSet(cullDescriptorSet, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, 0, &objectBuffer.descriptor),
+		vks::initializers::writeDescriptorSet(cullDescriptorSet, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, 1, &drawCommandBuffer.descriptor),
+		vks::initializers::writeDescriptorSet(cullDescriptorSet, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, 2, &countBuffer.descriptor),
+		vks::initializers::writeDescriptorSet(cullDescriptorSet, VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER, 3, &parameterBuffer.descriptor),
+		vks::initializers::writeDescriptorSet(descriptorSet, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, 0, &objectBuffer.descriptor),
+		vks::initializers::writeDescriptorSet(descriptorSet, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, 1, &materialBuffer.descriptor),
+		vks::initializers::writeDescriptorSet(descriptorSet, VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, 2, imageDescriptors.data(), imageCount),
+	};
+	vkUpdateDescriptorSets(device->logicalDevice, static_cast<uint32_t>(writeDescriptorSets.size()), writeDescriptorSets.data(), 0, nullptr);
+
+	// Culling pipeline
+	VkPipelineLayoutCreateInfo pipelineLayoutCI = vks::initializers::pipelineLayoutCreateInfo(&cullDescriptorSetLayout, 1);
+	VK_CHECK_RESULT(vkCreatePipelineLayout(device->logicalDevice, &pipelineLayoutCI, nullptr, &cullPipelineLayout));
+	VkComputePipelineCreateInfo computePipelineCI = vks::initializers::computePipelineCreateInfo(cullPipelineLayout, 0);
+	computePipelineCI.stage = cullShader;
+	VK_CHECK_RESULT(vkCreateComputePipelines(device->logicalDevice, VK_NULL_HANDLE, 1, &computePipelineCI, nullptr, &cullPipeline));
+
+	// Core in Vulkan 1.2, also exposed by VK_KHR_draw_indirect_count
+	cmdDrawIndexedIndirectCount = reinterpret_cast<PFN_vkCmdDrawIndexedIndirectCount>(vkGetDeviceProcAddr(device->logicalDevice, "vkCmdDrawIndexedIndirectCount"));
+	if (!cmdDrawIndexedIndirectCount) {
+		cmdDrawIndexedIndirectCount = reinterpret_cast<PFN_vkCmdDrawIndexedIndirectCount>(vkGetDeviceProcAddr(device->logicalDevice, "vkCmdDrawIndexedIndirectCountKHR"));
+	}
+	if (!cmdDrawIndexedIndirectCount) {
+		vks::tools::exitFatal("vkCmdDrawIndexedIndirectCount is not available, GPU driven rendering requires Vulkan 1.2 or VK_KHR_draw_indirect_count", -1);
+	}
+}
+
+void vkglTF::IndirectRenderer::destroy()
+{
+	if (!device) {
+		return;
+	}
+	objectBuffer.destroy();
+	materialBuffer.destroy();
+	drawCommandBuffer.destroy();
+	countBuffer.destroy();
+	for (vks::Buffer& statisticsBuffer : statisticsBuffers) {
+		statisticsBuffer.destroy();
+	}
+	statisticsBuffers.clear();
+	parameterBuffer.destroy();
+	vkDestroyPipeline(device->logicalDevice, cullPipeline, nullptr);
+	vkDestroyPipelineLayout(device->logicalDevice, cullPipelineLayout, nullptr);
+	vkDestroyDescriptorSetLayout(device->logicalDevice, cullDescriptorSetLayout, nullptr);
+	vkDestroyDescriptorSetLayout(device->logicalDevice, descriptorSetLayout, nullptr);
+	vkDestroyDescriptorPool(device->logicalDevice, descriptorPool, nullptr);
+	objectBuffer = vks::Buffer();
+	materialBuffer = vks::Buffer();
+	drawCommandBuffer = vks::Buffer();
+	countBuffer = vks::Buffer();
+	parameterBuffer = vks::Buffer();
+	cullPipeline = VK_NULL_HANDLE;
+	cullPipelineLayout = VK_NULL_HANDLE;
+	cullDescriptorSetLayout = VK_NULL_HANDLE;
+	descriptorSetLayout = VK_NULL_HANDLE;
+	descriptorPool = VK_NULL_HANDLE;
+	objects.clear();
+	opaqueCount = maskedCount = 0;
+	device = nullptr;
+}
+
+void vkglTF::IndirectRenderer::updateTransforms()
+{
+	if (model->preTransformed) {
+		return;
+	}
+	ObjectData* objectData = static_cast<ObjectData*>(objectBuffer.mapped);
+	for (size_t i = 0; i < objects.size(); i++) {
+		objectData[i].matrix = objects[i].node->getMatrix();
+	}
+}
+
+void vkglTF::IndirectRenderer::updateCullParameters(const vks::Frustum& frustum, const glm::vec3& cameraPosition)
+{
+	CullParameters parameters{};
+	for (size_t i = 0; i < frustum.planes.size(); i++) {
+		parameters.frustumPlanes[i] = frustum.planes[i];
+	}
+	parameters.cameraPosition = glm::vec4(cameraPosition, 0.0f);
+	parameters.objectCount = static_cast<uint32_t>(objects.size());
+	parameters.opaqueCount = opaqueCount;
+	parameters.lodDistanceScale = lodDistanceScale;
+	memcpy(parameterBuffer.mapped, &parameters, sizeof(CullParameters));
+}
+
+void vkglTF::IndirectRenderer::cull(VkCommandBuffer commandBuffer, uint32_t slot)
+{
+	assert(slot < statisticsBuffers.size());
+	// The previous frame's draws need to have read their commands before they are overwritten
+	vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_DRAW_INDIRECT_BIT, VK_PIPELINE_STAGE_TRANSFER_BIT | VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, 0, 0, nullptr, 0, nullptr, 0, nullptr);
+	vkCmdFillBuffer(commandBuffer, countBuffer.buffer, 0, VK_WHOLE_SIZE, 0);
+	VkBufferMemoryBarrier bufferBarrier = vks::initializers::bufferMemoryBarrier();
+	bufferBarrier.buffer = countBuffer.buffer;
+	bufferBarrier.size = VK_WHOLE_SIZE;
+	bufferBarrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+	bufferBarrier.dstAccessMask = VK_ACCESS_SHADER_READ_BIT | VK_ACCESS_SHADER_WRITE_BIT;
+	vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, 0, 0, nullptr, 1, &bufferBarrier, 0, nullptr);
+
+	if (!objects.empty()) {
+		vkCmdBindPipeline(commandBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, cullPipeline);
+		vkCmdBindDescriptorSets(commandBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, cullPipelineLayout, 0, 1, &cullDescriptorSet, 0, nullptr);
+		// Needs to match the local size of the culling shader
+		const uint32_t localSize = 64;
+		vkCmdDispatch(commandBuffer, (static_cast<uint32_t>(objects.size()) + localSize - 1) / localSize, 1, 1);
+	}
+
+	// Draw commands and counts are consumed by the indirect draws, the counts are also copied to the slot's statistics buffer
+	VkBufferMemoryBarrier bufferBarriers[2] = { vks::initializers::bufferMemoryBarrier(), vks::initializers::bufferMemoryBarrier() };
+	bufferBarriers[0].buffer = drawCommandBuffer.buffer;
+	bufferBarriers[1].buffer = countBuffer.buffer;
+	for (VkBufferMemoryBarrier& barrier : bufferBarriers) {
+		barrier.size = VK_WHOLE_SIZE;
+		barrier.srcAccessMask = VK_ACCESS_SHADER_WRITE_BIT;
+		barrier.dstAccessMask = VK_ACCESS_INDIRECT_COMMAND_READ_BIT | VK_ACCESS_TRANSFER_READ_BIT;
+	}
+	vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_PIPELINE_STAGE_DRAW_INDIRECT_BIT | VK_PIPELINE_STAGE_TRANSFER_BIT, 0, 0, nullptr, 2, bufferBarriers, 0, nullptr);
+
+	VkBufferCopy copyRegion{ 0, 0, sizeof(Statistics) };
+	vkCmdCopyBuffer(commandBuffer, countBuffer.buffer, statisticsBuffers[slot].buffer, 1, &copyRegion);
+	bufferBarrier.buffer = statisticsBuffers[slot].buffer;
+	bufferBarrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+	bufferBarrier.dstAccessMask = VK_ACCESS_HOST_READ_BIT;
+	vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_HOST_BIT, 0, 0, nullptr, 1, &bufferBarrier, 0, nullptr);
+}
+
+void vkglTF::IndirectRenderer::draw(VkCommandBuffer commandBuffer, uint32_t renderFlags, VkPipelineLayout pipelineLayout, uint32_t bindSet)
+{
+	const bool masked = (renderFlags & RenderFlags::RenderAlphaMaskedNodes) != 0;
+	const uint32_t maxDrawCount = masked ? maskedCount : opaqueCount;
+	if (maxDrawCount == 0) {
+		return;
+	}
+	const VkDeviceSize offsets[1] = { 0 };
+	vkCmdBindVertexBuffers(commandBuffer, 0, 1, &model->vertices.buffer, offsets);
+	vkCmdBindIndexBuffer(commandBuffer, model->indices.buffer, 0, VK_INDEX_TYPE_UINT32);
+	vkCmdBindDescriptorSets(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, pipelineLayout, bindSet, 1, &descriptorSet, 0, nullptr);
+	// Commands of masked objects start after the opaque ones, each alpha mode has its own count
+	const VkDeviceSize commandOffset = masked ? opaqueCount * sizeof(VkDrawIndexedIndirectCommand) : 0;
+	const VkDeviceSize countOffset = masked ? offsetof(Statistics, maskedDraws) : offsetof(Statistics, opaqueDraws);
+	cmdDrawIndexedIndirectCount(commandBuffer, drawCommandBuffer.buffer, commandOffset, countBuffer.buffer, countOffset, maxDrawCount, sizeof(VkDrawIndexedIndirectCommand));
+}
+
+vkglTF::IndirectRenderer::Statistics vkglTF::IndirectRenderer::getStatistics(uint32_t slot)
+{
+	Statistics statistics{};
+	if (slot < statisticsBuffers.size()) {
+		// The memory may not be host coherent
+		VK_CHECK_RESULT(statisticsBuffers[slot].invalidate());
+		memcpy(&statistics, statisticsBuffers[slot].mapped, sizeof(Statistics));
+	}
+	return statistics;
+}
+
+uint32_t vkglTF::IndirectRenderer::getObjectCount() const
+{
+	return static_cast<uint32_t>(objects.size());
+}
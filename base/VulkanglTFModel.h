@@ -12,6 +12,7 @@
 #include <string>
 #include <fstream>
 #include <vector>
+#include <functional>
 
 #include "vulkan/vulkan.h"
 #include "VulkanDevice.h"
@@ -31,10 +32,19 @@
 #endif
 #include "tiny_gltf.h"
 
+#include "animationclip.hpp"
+#include "meshoptimizer.hpp"
+#include "bvh.hpp"
+
 #if defined(__ANDROID__)
 #include <android/asset_manager.h>
 #endif
 
+namespace vks
+{
+	class JobSystem;
+}
+
 namespace vkglTF
 {
 	enum DescriptorBindingFlags {
@@ -45,8 +55,20 @@ namespace vkglTF
 	extern VkDescriptorSetLayout descriptorSetLayoutImage;
 	extern VkDescriptorSetLayout descriptorSetLayoutUbo;
 	extern VkMemoryPropertyFlags memoryPropertyFlags;
+	/** @brief Job system new models decode their images with (see Model::jobSystem), set by the example base class to its own */
+	extern vks::JobSystem* loadingJobSystem;
 	extern uint32_t descriptorBindingFlags;
 
+	/**
+	* Reads all elements of an accessor as floats, following the buffer view's byte stride and converting integer components (normalized ones to [0,1] or [-1,1])
+	*
+	* @param model glTF model the accessor belongs to
+	* @param accessor Accessor to read
+	* @param values Receives the components of all elements, one float per component
+	* @param data (Optional) Start of the accessor's data, if not set it is taken from tinygltf's buffer storage
+	*/
+	void readAccessor(const tinygltf::Model& model, const tinygltf::Accessor& accessor, std::vector<float>& values, const unsigned char* data = nullptr);
+
 	struct Node;
 
 	/*
@@ -57,6 +79,7 @@ namespace vkglTF
 		VkImage image;
 		VkImageLayout imageLayout;
 		VkDeviceMemory deviceMemory;
+		vks::Allocation* allocation = nullptr;
 		VkImageView view;
 		uint32_t width, height;
 		uint32_t mipLevels;
@@ -66,6 +89,7 @@ namespace vkglTF
 		void updateDescriptor();
 		void destroy();
 		void fromglTfImage(tinygltf::Image& gltfimage, std::string path, vks::VulkanDevice* device, VkQueue copyQueue);
+		void createSamplerAndView();
 	};
 
 	/*
@@ -112,8 +136,17 @@ namespace vkglTF
 			float radius;
 		} dimensions;
 
+		/** @brief Index range of a level of detail and its geometric error, an estimate of how far its surface deviates from the full detail one */
+		struct Lod {
+			uint32_t firstIndex;
+			uint32_t indexCount;
+			float error;
+		};
+		/** @brief Levels of detail with decreasing detail, the first one is the primitive's own index range, FileLoadingFlags::GenerateLods adds more */
+		std::vector<Lod> lods;
+
 		void setDimensions(glm::vec3 min, glm::vec3 max);
-		Primitive(uint32_t firstIndex, uint32_t indexCount, Material& material) : firstIndex(firstIndex), indexCount(indexCount), material(material) {};
+		Primitive(uint32_t firstIndex, uint32_t indexCount, Material& material) : firstIndex(firstIndex), indexCount(indexCount), material(material), lods(1, { firstIndex, indexCount, 0.0f }) {};
 	};
 
 	/*
@@ -128,6 +161,7 @@ namespace vkglTF
 		struct UniformBuffer {
 			VkBuffer buffer;
 			VkDeviceMemory memory;
+			vks::Allocation* allocation = nullptr;
 			VkDescriptorBufferInfo descriptor;
 			VkDescriptorSet descriptorSet = VK_NULL_HANDLE;
 			void* mapped;
@@ -153,23 +187,75 @@ namespace vkglTF
 		std::vector<Node*> joints;
 	};
 
+	/*
+		Flattened node transform hierarchy
+		Transforms of all nodes are stored in contiguous arrays, sorted so that a parent always comes before its children
+		This allows updating all world matrices in a single linear pass instead of walking up the parent chain for every node
+	*/
+	struct TransformHierarchy {
+		// Nodes in hierarchy order, a node's transformIndex is its position in this list
+		std::vector<Node*> nodes;
+		// Index of the parent's transform, -1 for root nodes
+		std::vector<int32_t> parents;
+		std::vector<glm::vec3> translations;
+		std::vector<glm::quat> rotations;
+		std::vector<glm::vec3> scales;
+		std::vector<glm::mat4> matrices;
+		std::vector<glm::mat4> localMatrices;
+		std::vector<glm::mat4> worldMatrices;
+		// Local transform has been changed since the last update
+		std::vector<uint8_t> dirty;
+		// World matrix has been changed by the last update
+		std::vector<uint8_t> changed;
+		// Number of updates that changed any world matrix, and the value it had when each world matrix last changed
+		// Lets callers that don't see every update (e.g. Node::update on one of several sub trees) find what changed since they last looked
+		uint32_t generation = 0;
+		std::vector<uint32_t> changedGenerations;
+		void build(const std::vector<Node*>& rootNodes);
+		void setTranslation(uint32_t index, const glm::vec3& translation);
+		void setRotation(uint32_t index, const glm::quat& rotation);
+		void setScale(uint32_t index, const glm::vec3& scale);
+		void setMatrix(uint32_t index, const glm::mat4& matrix);
+		bool update();
+	};
+
 	/*
 		glTF node
+		The local transform can only be changed through the setters: once the node is part of a transform hierarchy the transform is
+		stored there, and the setters flag it as changed so the next update of the hierarchy recalculates the affected world matrices
 	*/
 	struct Node {
+	private:
+		// Transform as loaded from the file, only used until the node is added to a hierarchy
+		glm::vec3 translation{};
+		glm::vec3 scale{ 1.0f };
+		glm::quat rotation{};
+		glm::mat4 matrix{ 1.0f };
+	public:
 		Node* parent;
 		uint32_t index;
 		std::vector<Node*> children;
-		glm::mat4 matrix;
 		std::string name;
 		Mesh* mesh;
 		Skin* skin;
 		int32_t skinIndex = -1;
-		glm::vec3 translation{};
-		glm::vec3 scale{ 1.0f };
-		glm::quat rotation{};
+		TransformHierarchy* hierarchy = nullptr;
+		uint32_t transformIndex = 0;
+		// Hierarchy generation the uniform buffer has last been written at
+		uint32_t uniformGeneration = 0;
+		glm::vec3 getTranslation() const;
+		glm::quat getRotation() const;
+		glm::vec3 getScale() const;
+		/** @brief glTF node matrix, applied after translation, rotation and scale */
+		glm::mat4 getTransformMatrix() const;
+		void setTranslation(const glm::vec3& translation);
+		void setRotation(const glm::quat& rotation);
+		void setScale(const glm::vec3& scale);
+		void setTransformMatrix(const glm::mat4& matrix);
 		glm::mat4 localMatrix();
 		glm::mat4 getMatrix();
+		void updateUniformBuffer();
+		/** @brief Updates the hierarchy and the uniform buffers in this sub tree whose world matrix (or one of whose joints) changed since they were last written */
 		void update();
 		~Node();
 	};
@@ -192,6 +278,8 @@ namespace vkglTF
 		InterpolationType interpolation;
 		std::vector<float> inputs;
 		std::vector<glm::vec4> outputsVec4;
+		// Key frame interval of the last lookup, used as the starting point for the next one
+		size_t cursor = 0;
 	};
 
 	/*
@@ -210,6 +298,19 @@ namespace vkglTF
 	*/
 	enum class VertexComponent { Position, Normal, UV, Color, Tangent, Joint0, Weight0 };
 
+	/*
+		Float stores all components as 32 bit floats in the Vertex structure
+		Packed only stores the requested components, quantized to 32 bytes at most (see FileLoadingFlags::PackVertices):
+		- Position: snorm16 x4, normalized to the model's bounds (see Model::vertexDequantization)
+		- Normal: snorm16 x2, octahedral encoding
+		- UV: float16 x2
+		- Color: unorm8 x4
+		- Tangent: snorm16 x2, octahedral encoding with the handedness in the sign of y (y = (oct.y * 0.5 + 0.5) * w)
+		- Joint0: uint8 x4
+		- Weight0: unorm8 x4
+	*/
+	enum class VertexFormat { Float, Packed };
+
 	struct Vertex {
 		glm::vec3 pos;
 		glm::vec3 normal;
@@ -224,8 +325,17 @@ namespace vkglTF
 		static VkVertexInputBindingDescription inputBindingDescription(uint32_t binding);
 		static VkVertexInputAttributeDescription inputAttributeDescription(uint32_t binding, uint32_t location, VertexComponent component);
 		static std::vector<VkVertexInputAttributeDescription> inputAttributeDescriptions(uint32_t binding, const std::vector<VertexComponent> components);
-		/** @brief Returns the default pipeline vertex input state create info structure for the requested vertex components */
-		static VkPipelineVertexInputStateCreateInfo* getPipelineVertexInputState(const std::vector<VertexComponent> components);
+		/** @brief Size of a component in the packed format */
+		static uint32_t packedComponentSize(VertexComponent component);
+		/** @brief Size of a packed vertex that stores the given components */
+		static uint32_t packedStride(const std::vector<VertexComponent>& components);
+		static std::vector<VkVertexInputAttributeDescription> packedInputAttributeDescriptions(uint32_t binding, const std::vector<VertexComponent> components);
+		/**
+		* Returns the pipeline vertex input state create info structure for the requested vertex components
+		*
+		* @param format Packed requires the model to be loaded with FileLoadingFlags::PackVertices and the same components
+		*/
+		static VkPipelineVertexInputStateCreateInfo* getPipelineVertexInputState(const std::vector<VertexComponent> components, VertexFormat format = VertexFormat::Float);
 	};
 
 	enum FileLoadingFlags {
@@ -233,7 +343,10 @@ namespace vkglTF
 		PreTransformVertices = 0x00000001,
 		PreMultiplyVertexColors = 0x00000002,
 		FlipY = 0x00000004,
-		DontLoadImages = 0x00000008
+		DontLoadImages = 0x00000008,
+		OptimizeMeshes = 0x00000010,
+		PackVertices = 0x00000020,
+		GenerateLods = 0x00000040
 	};
 
 	enum RenderFlags {
@@ -247,27 +360,54 @@ namespace vkglTF
 		glTF model loading and rendering class
 	*/
 	class Model {
+		friend class IndirectRenderer;
 	private:
 		vkglTF::Texture* getTexture(uint32_t index);
 		vkglTF::Texture emptyTexture;
 		void createEmptyTexture(VkQueue transferQueue);
+		// Start of each glTF buffer's data while loading, either inside a memory mapped file or inside tinygltf's buffer storage
+		std::vector<const unsigned char*> bufferData;
+		const unsigned char* getAccessorData(const tinygltf::Model& model, const tinygltf::Accessor& accessor);
+		// Encoded data and size for each glTF image while loading, images are decoded in parallel by loadImages
+		std::vector<std::pair<const unsigned char*, size_t>> encodedImageData;
+		// Hierarchy over the bounds of all cull items except skinned ones, these are deformed by their joints and always drawn
+		vks::Bvh bvh;
+		std::vector<uint32_t> bvhItems;
+		std::vector<uint32_t> unculledItems;
+		// Vertex positions may have been transformed at load time, which changes the space the bounds are in
+		bool preTransformed = false;
+		bool flippedY = false;
+		void getPrimitiveBounds(Node* node, const Primitive* primitive, glm::vec3& min, glm::vec3& max) const;
+		void buildBvh();
+		// Set from FileLoadingFlags::OptimizeMeshes while loading
+		bool optimizeMeshes = false;
+		uint32_t optimizePrimitive(std::vector<uint32_t>& indexBuffer, std::vector<Vertex>& vertexBuffer, uint32_t indexStart, uint32_t vertexStart);
+		void packVertices(const std::vector<Vertex>& vertexBuffer, std::vector<uint8_t>& packedVertexBuffer);
+		// Set from FileLoadingFlags::GenerateLods while loading
+		bool generateLods = false;
+		void generatePrimitiveLods(std::vector<uint32_t>& indexBuffer, const std::vector<Vertex>& vertexBuffer, Primitive* primitive);
 	public:
 		vks::VulkanDevice* device;
 		VkDescriptorPool descriptorPool;
 
 		struct Vertices {
 			int count;
+			/** @brief Size of one vertex, sizeof(Vertex) unless the vertices are packed */
+			uint32_t stride = sizeof(Vertex);
 			VkBuffer buffer;
 			VkDeviceMemory memory;
+			vks::Allocation* allocation = nullptr;
 		} vertices;
 		struct Indices {
 			int count;
 			VkBuffer buffer;
 			VkDeviceMemory memory;
+			vks::Allocation* allocation = nullptr;
 		} indices;
 
 		std::vector<Node*> nodes;
 		std::vector<Node*> linearNodes;
+		TransformHierarchy transformHierarchy;
 
 		std::vector<Skin*> skins;
 
@@ -283,6 +423,35 @@ namespace vkglTF
 			float radius;
 		} dimensions;
 
+		/** @brief Primitive and the node it's drawn with */
+		struct CullItem {
+			Node* node;
+			Primitive* primitive;
+		};
+		/** @brief All primitives of the model in the order drawNode visits them */
+		std::vector<CullItem> cullItems;
+
+		/** @brief Vertex cache efficiency of all primitives before and after FileLoadingFlags::OptimizeMeshes */
+		struct MeshOptimizationStatistics {
+			vks::meshoptimizer::VertexCacheStatistics before;
+			vks::meshoptimizer::VertexCacheStatistics after;
+		} meshOptimizationStatistics;
+
+		/** @brief Number of detail levels per primitive generated with FileLoadingFlags::GenerateLods, including the full detail one */
+		uint32_t lodLevelCount = 4;
+		/** @brief Fraction of the triangles of the previous level each generated level aims to keep */
+		float lodReduction = 0.5f;
+		/** @brief Triangle counts of all primitives per detail level after FileLoadingFlags::GenerateLods */
+		std::vector<uint32_t> lodTriangleCounts;
+
+		/** @brief Components stored per vertex with FileLoadingFlags::PackVertices, in the order of their attribute locations */
+		std::vector<VertexComponent> packedVertexComponents = { VertexComponent::Position, VertexComponent::Normal, VertexComponent::UV, VertexComponent::Color, VertexComponent::Tangent, VertexComponent::Joint0, VertexComponent::Weight0 };
+		/** @brief Transforms packed positions back into model space, needs to be applied before the node and model matrices (identity if not packed) */
+		glm::mat4 vertexDequantization = glm::mat4(1.0f);
+
+		/** @brief Started job system the images are decoded with, images are decoded on the loading thread if not set or if that thread can't schedule jobs on it */
+		vks::JobSystem* jobSystem = loadingJobSystem;
+
 		bool metallicRoughnessWorkflow = true;
 		bool buffersBound = false;
 		std::string path;
@@ -301,8 +470,222 @@ namespace vkglTF
 		void getNodeDimensions(Node* node, glm::vec3& min, glm::vec3& max);
 		void getSceneDimensions();
 		void updateAnimation(uint32_t index, float time);
+		void updateTransforms();
+		/**
+		* Collects the primitives that are at least partially inside of a frustum
+		*
+		* @param frustum Frustum in the space of the model (e.g. updated with projection * view * model)
+		* @param visibleItems Receives the indices into cullItems of the visible primitives in drawing order
+		*/
+		void cull(const vks::Frustum& frustum, std::vector<uint32_t>& visibleItems) const;
+		vks::animation::Clip createAnimationClip(uint32_t index);
 		Node* findNode(Node* parent, uint32_t index);
 		Node* nodeFromIndex(uint32_t index);
 		void prepareNodeDescriptor(vkglTF::Node* node, VkDescriptorSetLayout descriptorSetLayout);
 	};
-}
\ No newline at end of file
+
+	/*
+		Records the draws of a model into secondary command buffers on multiple threads
+		All primitives to be drawn are gathered into a flat list that's sorted by pipeline and material to avoid redundant
+		binds, then split into one contiguous range per job system thread. Every range has its own command pools, so
+		ranges can be recorded in parallel without any synchronization
+	*/
+	class ParallelDrawRecorder {
+	public:
+		struct DrawInfo {
+			/** @brief Render pass, subpass and framebuffer the secondary command buffers are executed in */
+			VkCommandBufferInheritanceInfo inheritanceInfo{ VK_STRUCTURE_TYPE_COMMAND_BUFFER_INHERITANCE_INFO };
+			/** @brief Alpha modes to draw (RenderOpaqueNodes, RenderAlphaMaskedNodes and RenderAlphaBlendedNodes can be combined, none set draws all) and BindImages */
+			uint32_t renderFlags = 0;
+			VkPipelineLayout pipelineLayout = VK_NULL_HANDLE;
+			uint32_t bindImageSet = 1;
+			/** @brief Optional, returns the pipeline for a material. If not set, beginCommandBuffer needs to bind a pipeline */
+			std::function<VkPipeline(const vkglTF::Material&)> getPipeline;
+			/** @brief Optional, records the state the draws depend on (viewport, scissor, other descriptor sets) at the start of each command buffer, called from multiple threads */
+			std::function<void(VkCommandBuffer)> beginCommandBuffer;
+			/** @brief Optional, only primitives at least partially inside of this frustum (in model space) are drawn */
+			const vks::Frustum* frustum = nullptr;
+		};
+
+		/** @brief Recording statistics of one range of draws */
+		struct ThreadStatistics {
+			/** @brief Job system thread that recorded the range */
+			uint32_t threadIndex = 0;
+			/** @brief Time spent recording in ms */
+			double recordTime = 0.0;
+			uint32_t drawCount = 0;
+			uint32_t pipelineBinds = 0;
+			uint32_t descriptorSetBinds = 0;
+		};
+
+	private:
+		struct DrawItem {
+			VkPipeline pipeline;
+			uint32_t materialIndex;
+			bool blended;
+			const Primitive* primitive;
+		};
+		struct Range {
+			// One pool and command buffer per slot
+			std::vector<VkCommandPool> commandPools;
+			std::vector<VkCommandBuffer> commandBuffers;
+			ThreadStatistics statistics;
+		};
+		vks::VulkanDevice* device = nullptr;
+		vks::JobSystem* jobSystem = nullptr;
+		std::vector<Range> ranges;
+		std::vector<DrawItem> drawItems;
+		std::vector<uint32_t> visibleItems;
+		std::vector<VkCommandBuffer> recordedCommandBuffers;
+		std::vector<ThreadStatistics> statistics;
+		void recordRange(Range& range, const Model& model, const DrawInfo& drawInfo, uint32_t slot, uint32_t firstItem, uint32_t itemCount);
+	public:
+		/** @brief Wall clock time of the last call to record in ms */
+		double recordTime = 0.0;
+		/** @brief Number of primitives rejected by the frustum in the last call to record */
+		uint32_t culledCount = 0;
+
+		~ParallelDrawRecorder();
+		/**
+		* Creates the command pools for all ranges
+		*
+		* @param device Device the command buffers are recorded for
+		* @param jobSystem Started job system, the draws are split into one range per thread
+		* @param slotCount Number of recordings that can be in use at the same time (e.g. the number of frames in flight or command buffers recorded once per swap chain image)
+		*/
+		void prepare(vks::VulkanDevice* device, vks::JobSystem* jobSystem, uint32_t slotCount);
+		void destroy();
+		/**
+		* Records the model's draws into the command buffers of the given slot, overwriting the slot's previous recording
+		*
+		* @return Secondary command buffers to be executed in order with vkCmdExecuteCommands
+		*/
+		const std::vector<VkCommandBuffer>& record(const Model& model, const DrawInfo& drawInfo, uint32_t slot);
+		/** @brief Statistics of the last recording, one entry per recorded command buffer */
+		const std::vector<ThreadStatistics>& getStatistics() const;
+	};
+
+	/*
+		GPU driven rendering of a model's opaque and alpha masked primitives
+		Transforms, bounds and detail levels of all primitives are stored in a storage buffer, a compute pass culls them against
+		the view frustum, selects a detail level by its projected error and writes the indirect draw commands along with their count
+		Each alpha mode is then drawn with a single vkCmdDrawIndexedIndirectCount, materials are looked up from a storage buffer
+		and a descriptor indexed texture array instead of being bound per primitive, so the CPU cost doesn't grow with the scene
+		Requires the multiDrawIndirect and drawIndirectFirstInstance features and the Vulkan 1.2 drawIndirectCount,
+		runtimeDescriptorArray and shaderSampledImageArrayNonUniformIndexing features
+		Blended primitives need to be sorted and skinned primitives need their joint matrices, both are not drawn by this path
+	*/
+	class IndirectRenderer {
+	public:
+		/** @brief Maximum number of detail levels per primitive */
+		static const uint32_t maxLodCount = 4;
+
+		/** @brief Results of a culling pass, copied from the count buffer to a host visible buffer per slot */
+		struct Statistics {
+			uint32_t opaqueDraws;
+			uint32_t maskedDraws;
+			uint32_t lodDraws[maxLodCount];
+		};
+
+	private:
+		// Storage and uniform buffer layouts shared with the shaders (std430 and std140)
+		struct LodData {
+			uint32_t firstIndex;
+			uint32_t indexCount;
+			float distance;
+			float pad;
+		};
+		struct ObjectData {
+			glm::mat4 matrix;
+			glm::vec4 boundsMin;
+			glm::vec4 boundsMax;
+			uint32_t materialIndex;
+			uint32_t lodCount;
+			uint32_t pad[2];
+			LodData lods[maxLodCount];
+		};
+		struct MaterialData {
+			glm::vec4 baseColorFactor;
+			int32_t baseColorTexture;
+			int32_t normalTexture;
+			float alphaCutoff;
+			float pad;
+		};
+		struct CullParameters {
+			glm::vec4 frustumPlanes[6];
+			glm::vec4 cameraPosition;
+			uint32_t objectCount;
+			uint32_t opaqueCount;
+			float lodDistanceScale;
+			float pad;
+		};
+
+		Model* model = nullptr;
+		vks::VulkanDevice* device = nullptr;
+		// Opaque objects are stored before masked ones, so the draw commands of each alpha mode are contiguous
+		std::vector<Model::CullItem> objects;
+		uint32_t opaqueCount = 0;
+		uint32_t maskedCount = 0;
+		vks::Buffer objectBuffer;
+		vks::Buffer materialBuffer;
+		vks::Buffer drawCommandBuffer;
+		vks::Buffer countBuffer;
+		// One per slot, so the counts of a command buffer can be read while other ones are still executing
+		std::vector<vks::Buffer> statisticsBuffers;
+		vks::Buffer parameterBuffer;
+		VkDescriptorPool descriptorPool = VK_NULL_HANDLE;
+		VkDescriptorSetLayout cullDescriptorSetLayout = VK_NULL_HANDLE;
+		VkDescriptorSet cullDescriptorSet = VK_NULL_HANDLE;
+		VkPipelineLayout cullPipelineLayout = VK_NULL_HANDLE;
+		VkPipeline cullPipeline = VK_NULL_HANDLE;
+		VkDescriptorSet descriptorSet = VK_NULL_HANDLE;
+		PFN_vkCmdDrawIndexedIndirectCount cmdDrawIndexedIndirectCount = nullptr;
+		void getObjectData(const Model::CullItem& object, ObjectData& objectData) const;
+	public:
+		/** @brief Layout of the object, material and texture bindings used by the vertex and fragment shaders */
+		VkDescriptorSetLayout descriptorSetLayout = VK_NULL_HANDLE;
+		/** @brief Converts the geometric errors of the detail levels into the distances up to which the more detailed level is used */
+		float lodDistanceScale = 1.0f;
+		/**
+		* Returns the lodDistanceScale that switches detail levels once their error covers less than the given number of pixels
+		*
+		* @param projection Projection matrix of the view
+		* @param viewportHeight Height of the viewport in pixels
+		* @param pixelError Largest acceptable error in pixels
+		*/
+		static float getLodDistanceScale(const glm::mat4& projection, float viewportHeight, float pixelError);
+
+		~IndirectRenderer();
+		/**
+		* Uploads the model's objects and materials and creates the culling pipeline
+		*
+		* @param model Loaded model, needs to outlive the renderer
+		* @param device Device with the features listed above enabled
+		* @param transferQueue Queue for the upload of the material buffer
+		* @param cullShader Compute shader stage of base/gltfcull.comp
+		* @param slotCount Number of command buffers the culling pass is recorded to that may be pending at the same time, each gets its own statistics
+		*/
+		void prepare(Model* model, vks::VulkanDevice* device, VkQueue transferQueue, const VkPipelineShaderStageCreateInfo& cullShader, uint32_t slotCount = 1);
+		void destroy();
+		/** @brief Writes the current node matrices of all objects (e.g. after Model::updateTransforms) */
+		void updateTransforms();
+		/** @brief Sets the frustum (in model space) and camera position the next culling pass uses */
+		void updateCullParameters(const vks::Frustum& frustum, const glm::vec3& cameraPosition);
+		/** @brief Records the culling pass, needs to be recorded outside of a render pass before draw. The statistics are copied to the given slot */
+		void cull(VkCommandBuffer commandBuffer, uint32_t slot = 0);
+		/**
+		* Draws the visible objects of the selected alpha mode with a single indirect draw
+		*
+		* @param renderFlags Either RenderOpaqueNodes or RenderAlphaMaskedNodes
+		* @param pipelineLayout Layout of the bound pipeline
+		* @param bindSet Set index of descriptorSetLayout in the pipeline layout
+		*/
+		void draw(VkCommandBuffer commandBuffer, uint32_t renderFlags, VkPipelineLayout pipelineLayout, uint32_t bindSet = 1);
+		/**
+		* Returns the statistics of the last execution of the slot's culling pass
+		* The command buffer of that slot must have finished executing (e.g. after prepareFrame for the command buffer that is submitted next)
+		*/
+		Statistics getStatistics(uint32_t slot = 0);
+		uint32_t getObjectCount() const;
+	};
+}
@@ -0,0 +1,117 @@
+/*
+* glTF style key frame animation sampling
+*
+* Locates the key frame interval for a given time and interpolates sampler outputs (step, linear and cubic spline)
+* Each sampler keeps a cursor to the last key frame interval, as playback mostly stays in or advances to the next interval
+* the lookup is constant time in the common case and falls back to a binary search when jumping around in time
+*
+* This code is licensed under the MIT license (MIT) (http://opensource.org/licenses/MIT)
+*/
+
+#pragma once
+
+#include <vector>
+#include <algorithm>
+#include <glm/glm.hpp>
+#include <glm/gtc/quaternion.hpp>
+
+namespace vks
+{
+	namespace animation
+	{
+		/** @brief Key frame interval containing a point in time */
+		struct KeyFrame
+		{
+			/** @brief Index of the key frame at the start of the interval */
+			size_t index = 0;
+			/** @brief Index of the key frame at the end of the interval (same as index if time is outside of the key frame range) */
+			size_t next = 0;
+			/** @brief Normalized position within the interval */
+			float t = 0.0f;
+			/** @brief Duration of the interval in seconds */
+			float duration = 0.0f;
+		};
+
+		/**
+		* Find the key frame interval for the given time
+		* Times outside of the key frame range are clamped to the first or last key frame
+		*
+		* @param inputs Sorted key frame times
+		* @param time Time to look up
+		* @param cursor Index of the interval found by the last lookup, updated with the new interval
+		*/
+		inline KeyFrame findKeyFrame(const std::vector<float>& inputs, float time, size_t& cursor)
+		{
+			KeyFrame keyFrame;
+			const size_t count = inputs.size();
+			if ((count < 2) || (time <= inputs.front())) {
+				cursor = 0;
+				return keyFrame;
+			}
+			if (time >= inputs.back()) {
+				cursor = count - 2;
+				keyFrame.index = keyFrame.next = count - 1;
+				return keyFrame;
+			}
+			size_t index = std::min(cursor, count - 2);
+			if ((time < inputs[index]) || (time >= inputs[index + 1])) {
+				if ((index + 2 < count) && (time >= inputs[index + 1]) && (time < inputs[index + 2])) {
+					index++;
+				} else {
+					index = static_cast<size_t>(std::upper_bound(inputs.begin(), inputs.end(), time) - inputs.begin()) - 1;
+				}
+			}
+			cursor = index;
+			keyFrame.index = index;
+			keyFrame.next = index + 1;
+			keyFrame.duration = inputs[index + 1] - inputs[index];
+			keyFrame.t = (time - inputs[index]) / keyFrame.duration;
+			return keyFrame;
+		}
+
+		/** @brief Returns the output of the key frame at the start of the interval */
+		inline glm::vec4 step(const std::vector<glm::vec4>& outputs, const KeyFrame& keyFrame)
+		{
+			return outputs[keyFrame.index];
+		}
+
+		/** @brief Linear interpolation between the outputs of the interval's key frames */
+		inline glm::vec4 linear(const std::vector<glm::vec4>& outputs, const KeyFrame& keyFrame)
+		{
+			return glm::mix(outputs[keyFrame.index], outputs[keyFrame.next], keyFrame.t);
+		}
+
+		/**
+		* Cubic Hermite spline interpolation as defined by the glTF specification
+		* Outputs are stored as triplets of in-tangent, value and out-tangent per key frame
+		*/
+		inline glm::vec4 cubicSpline(const std::vector<glm::vec4>& outputs, const KeyFrame& keyFrame)
+		{
+			const float t = keyFrame.t;
+			const float t2 = t * t;
+			const float t3 = t2 * t;
+			const glm::vec4& v0 = outputs[keyFrame.index * 3 + 1];
+			const glm::vec4& b0 = outputs[keyFrame.index * 3 + 2];
+			const glm::vec4& a1 = outputs[keyFrame.next * 3];
+			const glm::vec4& v1 = outputs[keyFrame.next * 3 + 1];
+			return (2.0f * t3 - 3.0f * t2 + 1.0f) * v0 + keyFrame.duration * (t3 - 2.0f * t2 + t) * b0 + (-2.0f * t3 + 3.0f * t2) * v1 + keyFrame.duration * (t3 - t2) * a1;
+		}
+
+		/** @brief Converts a rotation output stored as x, y, z, w to a quaternion */
+		inline glm::quat toQuat(const glm::vec4& value)
+		{
+			glm::quat q;
+			q.x = value.x;
+			q.y = value.y;
+			q.z = value.z;
+			q.w = value.w;
+			return q;
+		}
+
+		/** @brief Spherical linear interpolation between rotation outputs of the interval's key frames */
+		inline glm::quat slerp(const std::vector<glm::vec4>& outputs, const KeyFrame& keyFrame)
+		{
+			return glm::normalize(glm::slerp(toQuat(outputs[keyFrame.index]), toQuat(outputs[keyFrame.next]), keyFrame.t));
+		}
+	}
+}
@@ -0,0 +1,355 @@
+/*
+* Shared animation clips and batched multi-instance pose evaluation
+*
+* A clip holds the immutable data of one animation (node hierarchy, rest pose, samplers and channels) and can be shared
+* by any number of animated instances. The per-instance state (local transforms, world matrices and key frame cursors)
+* lives in an InstancePoses object, which stores the instances in blocks of four lanes (array of structures of arrays)
+* so interpolation and matrix composition are done for four instances at once with SSE2 or NEON (with a scalar fallback)
+*
+* This code is licensed under the MIT license (MIT) (http://opensource.org/licenses/MIT)
+*/
+
+#pragma once
+
+#include <vector>
+#include <algorithm>
+#include <math.h>
+#include <string.h>
+#include <glm/glm.hpp>
+#include <glm/gtc/quaternion.hpp>
+
+#include "animation.hpp"
+
+#include "simd.hpp"
+
+namespace vks
+{
+	namespace animation
+	{
+		enum class Path { Translation, Rotation, Scale };
+		enum class Interpolation { Linear, Step, CubicSpline };
+
+		/** @brief Immutable animation data that can be shared by all instances playing the animation */
+		struct Clip
+		{
+			struct Sampler
+			{
+				Interpolation interpolation = Interpolation::Linear;
+				std::vector<float> inputs;
+				std::vector<glm::vec4> outputs;
+			};
+			struct Channel
+			{
+				/** @brief Index of the animated node in the clip's hierarchy */
+				uint32_t node;
+				Path path;
+				uint32_t sampler;
+			};
+			/** @brief Parent index of each node, -1 for root nodes. Parents are always stored before their children */
+			std::vector<int32_t> parents;
+			/** @brief Rest pose, used for nodes that are not animated by the clip */
+			std::vector<glm::vec3> translations;
+			std::vector<glm::quat> rotations;
+			std::vector<glm::vec3> scales;
+			std::vector<glm::mat4> matrices;
+			std::vector<Sampler> samplers;
+			std::vector<Channel> channels;
+			float start = 0.0f;
+			float end = 0.0f;
+
+			uint32_t nodeCount() const
+			{
+				return static_cast<uint32_t>(parents.size());
+			}
+		};
+
+		/** @brief Poses of many instances of the same clip, evaluated four instances at a time */
+		class InstancePoses
+		{
+		public:
+			static const uint32_t laneCount = 4;
+		private:
+			// Number of float4 components stored per node and block
+			static const uint32_t localComponents = 10;
+			static const uint32_t worldComponents = 12;
+			// Offsets of the local transform components
+			static const uint32_t translationOffset = 0;
+			static const uint32_t rotationOffset = 3;
+			static const uint32_t scaleOffset = 7;
+
+			const Clip* clip = nullptr;
+			uint32_t instanceCount = 0;
+			uint32_t blockCount = 0;
+			uint32_t nodeCount = 0;
+			std::vector<float> locals;
+			std::vector<float> worlds;
+			// Non-identity node matrices stored as affine 3x4 matrices
+			std::vector<float> nodeMatrices;
+			std::vector<uint8_t> hasNodeMatrix;
+			// Key frame cursor per instance and sampler
+			std::vector<size_t> cursors;
+
+			float* local(uint32_t block, uint32_t node)
+			{
+				return &locals[(static_cast<size_t>(block) * nodeCount + node) * localComponents * laneCount];
+			}
+
+			float* world(uint32_t block, uint32_t node)
+			{
+				return &worlds[(static_cast<size_t>(block) * nodeCount + node) * worldComponents * laneCount];
+			}
+
+			const float* world(uint32_t block, uint32_t node) const
+			{
+				return &worlds[(static_cast<size_t>(block) * nodeCount + node) * worldComponents * laneCount];
+			}
+
+			// Samples all channels of the clip for the four instances of a block
+			void sampleChannels(uint32_t block, const float* times)
+			{
+				const size_t samplerCount = clip->samplers.size();
+				for (const Clip::Channel& channel : clip->channels) {
+					const Clip::Sampler& sampler = clip->samplers[channel.sampler];
+					const size_t outputsPerKeyFrame = (sampler.interpolation == Interpolation::CubicSpline) ? 3 : 1;
+					if (sampler.inputs.empty() || (sampler.inputs.size() * outputsPerKeyFrame > sampler.outputs.size())) {
+						continue;
+					}
+					// Gather the key frame values of each lane into structure of arrays layout
+					float a[4][laneCount], b[4][laneCount], t[laneCount];
+					for (uint32_t lane = 0; lane < laneCount; lane++) {
+						// Lanes past the last instance duplicate it, so the whole block can always be processed
+						const uint32_t instance = std::min(block * laneCount + lane, instanceCount - 1);
+						const KeyFrame keyFrame = findKeyFrame(sampler.inputs, times[instance], cursors[instance * samplerCount + channel.sampler]);
+						glm::vec4 valueA, valueB;
+						float u = 0.0f;
+						switch (sampler.interpolation) {
+						case Interpolation::Linear:
+							valueA = sampler.outputs[keyFrame.index];
+							valueB = sampler.outputs[keyFrame.next];
+							u = keyFrame.t;
+							break;
+						case Interpolation::Step:
+							valueA = valueB = step(sampler.outputs, keyFrame);
+							break;
+						case Interpolation::CubicSpline:
+							valueA = valueB = cubicSpline(sampler.outputs, keyFrame);
+							break;
+						}
+						for (uint32_t c = 0; c < 4; c++) {
+							a[c][lane] = valueA[c];
+							b[c][lane] = valueB[c];
+						}
+						t[lane] = u;
+					}
+
+					float* dst = local(block, channel.node);
+					const simd::float4 vt = simd::load(t);
+					if (channel.path == Path::Rotation) {
+						// Approximated slerp (nlerp with a correction of the interpolation parameter), see
+						// https://zeux.io/2015/07/23/approximating-slerp/
+						const simd::float4 ax = simd::load(a[0]), ay = simd::load(a[1]), az = simd::load(a[2]), aw = simd::load(a[3]);
+						simd::float4 bx = simd::load(b[0]), by = simd::load(b[1]), bz = simd::load(b[2]), bw = simd::load(b[3]);
+						const simd::float4 cosAngle = simd::madd(ax, bx, simd::madd(ay, by, simd::madd(az, bz, simd::mul(aw, bw))));
+						const simd::float4 d = simd::abs(cosAngle);
+						const simd::float4 A = simd::madd(d, simd::madd(d, simd::sub(simd::set(3.55645f), simd::mul(d, simd::set(1.43519f))), simd::set(-3.2452f)), simd::set(1.0904f));
+						const simd::float4 B = simd::madd(d, simd::madd(d, simd::set(0.215638f), simd::set(-1.06021f)), simd::set(0.848013f));
+						const simd::float4 tc = simd::sub(vt, simd::set(0.5f));
+						const simd::float4 k = simd::madd(A, simd::mul(tc, tc), B);
+						const simd::float4 ot = simd::madd(simd::mul(vt, simd::mul(tc, simd::sub(vt, simd::set(1.0f)))), k, vt);
+						const simd::float4 lt = simd::sub(simd::set(1.0f), ot);
+						// Interpolate along the shortest path
+						const simd::float4 rt = simd::mulSign(cosAngle, ot);
+						const simd::float4 x = simd::madd(ax, lt, simd::mul(bx, rt));
+						const simd::float4 y = simd::madd(ay, lt, simd::mul(by, rt));
+						const simd::float4 z = simd::madd(az, lt, simd::mul(bz, rt));
+						const simd::float4 w = simd::madd(aw, lt, simd::mul(bw, rt));
+						const simd::float4 invLength = simd::rsqrt(simd::madd(x, x, simd::madd(y, y, simd::madd(z, z, simd::mul(w, w)))));
+						simd::store(dst + (rotationOffset + 0) * laneCount, simd::mul(x, invLength));
+						simd::store(dst + (rotationOffset + 1) * laneCount, simd::mul(y, invLength));
+						simd::store(dst + (rotationOffset + 2) * laneCount, simd::mul(z, invLength));
+						simd::store(dst + (rotationOffset + 3) * laneCount, simd::mul(w, invLength));
+					} else {
+						const uint32_t offset = (channel.path == Path::Translation) ? translationOffset : scaleOffset;
+						for (uint32_t c = 0; c < 3; c++) {
+							const simd::float4 va = simd::load(a[c]);
+							simd::store(dst + (offset + c) * laneCount, simd::madd(simd::sub(simd::load(b[c]), va), vt, va));
+						}
+					}
+				}
+			}
+
+			// Builds the local matrices from the sampled transforms and concatenates them with the parent's world matrix
+			void composeMatrices(uint32_t block)
+			{
+				using namespace simd;
+				for (uint32_t node = 0; node < nodeCount; node++) {
+					const float* src = local(block, node);
+					const float4 qx = load(src + (rotationOffset + 0) * laneCount);
+					const float4 qy = load(src + (rotationOffset + 1) * laneCount);
+					const float4 qz = load(src + (rotationOffset + 2) * laneCount);
+					const float4 qw = load(src + (rotationOffset + 3) * laneCount);
+					const float4 sx = load(src + (scaleOffset + 0) * laneCount);
+					const float4 sy = load(src + (scaleOffset + 1) * laneCount);
+					const float4 sz = load(src + (scaleOffset + 2) * laneCount);
+					const float4 two = set(2.0f), one = set(1.0f);
+					const float4 xx = mul(qx, qx), yy = mul(qy, qy), zz = mul(qz, qz);
+					const float4 xy = mul(qx, qy), xz = mul(qx, qz), yz = mul(qy, qz);
+					const float4 wx = mul(qw, qx), wy = mul(qw, qy), wz = mul(qw, qz);
+					// Affine 3x4 matrix in column major order: T * R * S
+					float4 m[worldComponents];
+					m[0] = mul(sub(one, mul(two, add(yy, zz))), sx);
+					m[1] = mul(mul(two, add(xy, wz)), sx);
+					m[2] = mul(mul(two, sub(xz, wy)), sx);
+					m[3] = mul(mul(two, sub(xy, wz)), sy);
+					m[4] = mul(sub(one, mul(two, add(xx, zz))), sy);
+					m[5] = mul(mul(two, add(yz, wx)), sy);
+					m[6] = mul(mul(two, add(xz, wy)), sz);
+					m[7] = mul(mul(two, sub(yz, wx)), sz);
+					m[8] = mul(sub(one, mul(two, add(xx, yy))), sz);
+					m[9] = load(src + (translationOffset + 0) * laneCount);
+					m[10] = load(src + (translationOffset + 1) * laneCount);
+					m[11] = load(src + (translationOffset + 2) * laneCount);
+					if (hasNodeMatrix[node]) {
+						const float* n = &nodeMatrices[node * worldComponents];
+						float4 r[worldComponents];
+						multiply(m, n, r);
+						memcpy(m, r, sizeof(m));
+					}
+					const int32_t parent = clip->parents[node];
+					float* dst = world(block, node);
+					if (parent > -1) {
+						const float* p = world(block, parent);
+						float4 pm[worldComponents];
+						for (uint32_t c = 0; c < worldComponents; c++) {
+							pm[c] = load(p + c * laneCount);
+						}
+						float4 r[worldComponents];
+						multiply(pm, m, r);
+						for (uint32_t c = 0; c < worldComponents; c++) {
+							store(dst + c * laneCount, r[c]);
+						}
+					} else {
+						for (uint32_t c = 0; c < worldComponents; c++) {
+							store(dst + c * laneCount, m[c]);
+						}
+					}
+				}
+			}
+
+			// Affine matrix product r = a * b
+			static void multiply(const simd::float4* a, const simd::float4* b, simd::float4* r)
+			{
+				using namespace simd;
+				for (uint32_t col = 0; col < 4; col++) {
+					for (uint32_t row = 0; row < 3; row++) {
+						float4 v = madd(a[row], b[col * 3], madd(a[3 + row], b[col * 3 + 1], mul(a[6 + row], b[col * 3 + 2])));
+						if (col == 3) {
+							v = add(v, a[9 + row]);
+						}
+						r[col * 3 + row] = v;
+					}
+				}
+			}
+
+			// Same as above with a matrix that's shared by all lanes
+			static void multiply(const simd::float4* a, const float* b, simd::float4* r)
+			{
+				simd::float4 lanes[worldComponents];
+				for (uint32_t c = 0; c < worldComponents; c++) {
+					lanes[c] = simd::set(b[c]);
+				}
+				multiply(a, lanes, r);
+			}
+
+		public:
+			/** @brief Allocates the pose buffers for the given number of instances, all instances start in the clip's rest pose */
+			void create(const Clip& clip, uint32_t instanceCount)
+			{
+				this->clip = &clip;
+				this->instanceCount = instanceCount;
+				blockCount = (instanceCount + laneCount - 1) / laneCount;
+				nodeCount = clip.nodeCount();
+				locals.resize(static_cast<size_t>(blockCount) * nodeCount * localComponents * laneCount);
+				worlds.resize(static_cast<size_t>(blockCount) * nodeCount * worldComponents * laneCount);
+				cursors.assign(static_cast<size_t>(instanceCount) * clip.samplers.size(), 0);
+				nodeMatrices.resize(static_cast<size_t>(nodeCount) * worldComponents);
+				hasNodeMatrix.resize(nodeCount);
+				for (uint32_t node = 0; node < nodeCount; node++) {
+					const glm::mat4& matrix = clip.matrices[node];
+					hasNodeMatrix[node] = (matrix != glm::mat4(1.0f));
+					for (uint32_t col = 0; col < 4; col++) {
+						for (uint32_t row = 0; row < 3; row++) {
+							nodeMatrices[node * worldComponents + col * 3 + row] = matrix[col][row];
+						}
+					}
+				}
+				for (uint32_t block = 0; block < blockCount; block++) {
+					for (uint32_t node = 0; node < nodeCount; node++) {
+						const float rest[localComponents] = {
+							clip.translations[node].x, clip.translations[node].y, clip.translations[node].z,
+							clip.rotations[node].x, clip.rotations[node].y, clip.rotations[node].z, clip.rotations[node].w,
+							clip.scales[node].x, clip.scales[node].y, clip.scales[node].z
+						};
+						float* dst = local(block, node);
+						for (uint32_t c = 0; c < localComponents; c++) {
+							std::fill(dst + c * laneCount, dst + (c + 1) * laneCount, rest[c]);
+						}
+					}
+					composeMatrices(block);
+				}
+			}
+
+			/**
+			* Evaluates the poses of a range of instance blocks, different ranges can be evaluated on different threads
+			*
+			* @param times Animation time of every instance
+			* @param firstBlock First block of laneCount instances to evaluate
+			* @param endBlock One past the last block to evaluate
+			*/
+			void evaluate(const float* times, uint32_t firstBlock, uint32_t endBlock)
+			{
+				for (uint32_t block = firstBlock; block < endBlock; block++) {
+					sampleChannels(block, times);
+					composeMatrices(block);
+				}
+			}
+
+			/** @brief Evaluates the poses of all instances */
+			void evaluate(const float* times)
+			{
+				evaluate(times, 0, blockCount);
+			}
+
+			uint32_t getBlockCount() const
+			{
+				return blockCount;
+			}
+
+			uint32_t getInstanceCount() const
+			{
+				return instanceCount;
+			}
+
+			/** @brief Returns the world matrix of a node of the given instance */
+			glm::mat4 getWorldMatrix(uint32_t instance, uint32_t node) const
+			{
+				const float* src = world(instance / laneCount, node) + (instance % laneCount);
+				glm::mat4 matrix(1.0f);
+				for (uint32_t col = 0; col < 4; col++) {
+					for (uint32_t row = 0; row < 3; row++) {
+						matrix[col][row] = src[(col * 3 + row) * laneCount];
+					}
+				}
+				return matrix;
+			}
+
+			/** @brief Copies the world matrices of all nodes of the given instance, e.g. to a per-instance uniform or storage buffer */
+			void getWorldMatrices(uint32_t instance, glm::mat4* matrices) const
+			{
+				for (uint32_t node = 0; node < nodeCount; node++) {
+					matrices[node] = getWorldMatrix(instance, node);
+				}
+			}
+		};
+	}
+}
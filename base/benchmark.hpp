@@ -13,25 +13,320 @@
 #include <functional>
 #include <chrono>
 #include <iomanip>
+#include <numeric>
+#include <cmath>
 
 namespace vks
 {
 	class Benchmark {
+	public:
+		/** @brief Summary statistics for a series of frame times (all values in ms) */
+		struct Statistics {
+			size_t count = 0;
+			double min = 0.0;
+			double max = 0.0;
+			double avg = 0.0;
+			double stdDev = 0.0;
+			double p50 = 0.0;
+			double p95 = 0.0;
+			double p99 = 0.0;
+			double p999 = 0.0;
+		};
+
+		/** @brief Frame time histogram with equally sized bins starting at the fastest frame */
+		struct Histogram {
+			double start = 0.0;
+			double binWidth = 0.0;
+			std::vector<uint32_t> bins;
+		};
+
 	private:
 		FILE *stream;
 		VkPhysicalDeviceProperties deviceProps;
+		std::chrono::time_point<std::chrono::high_resolution_clock> tFrameStart, tFrameSubmitted;
+		bool frameSubmitted = false;
+
+		// GPU execution time is measured with timestamps written by small command buffers submitted to the
+		// same queue right before and right after the render function, so no sample needs to be changed for it
+		// This covers all work the render function submits to that queue (including waits on the swap chain)
+		// Each frame slot has its own queries and fence, so results are read back a few frames later without stalling
+		struct GpuTimer {
+			bool supported = false;
+			VkDevice device = VK_NULL_HANDLE;
+			VkQueue queue = VK_NULL_HANDLE;
+			VkCommandPool commandPool = VK_NULL_HANDLE;
+			VkQueryPool queryPool = VK_NULL_HANDLE;
+			std::vector<VkCommandBuffer> beginCmdBuffers;
+			std::vector<VkCommandBuffer> endCmdBuffers;
+			std::vector<VkFence> fences;
+			// Index of the benchmark frame that is using a slot, -1 if the slot is free
+			std::vector<int64_t> slotFrames;
+			uint64_t timestampMask = ~0ULL;
+			float timestampPeriod = 1.0f;
+			uint32_t currentSlot = 0;
+		} gpuTimer;
+
+		// Reads back the timestamps of a slot once its fence has been signaled
+		void resolveGpuTimerSlot(uint32_t slot)
+		{
+			if (gpuTimer.slotFrames[slot] < 0) {
+				return;
+			}
+			VK_CHECK_RESULT(vkWaitForFences(gpuTimer.device, 1, &gpuTimer.fences[slot], VK_TRUE, UINT64_MAX));
+			uint64_t timestamps[2] = { 0, 0 };
+			VkResult result = vkGetQueryPoolResults(gpuTimer.device, gpuTimer.queryPool, slot * 2, 2, sizeof(timestamps), timestamps, sizeof(uint64_t), VK_QUERY_RESULT_64_BIT);
+			if (result == VK_SUCCESS) {
+				uint64_t ticks = (timestamps[1] - timestamps[0]) & gpuTimer.timestampMask;
+				gpuTimes[gpuTimer.slotFrames[slot]] = (double)ticks * (double)gpuTimer.timestampPeriod / 1000000.0;
+			}
+			gpuTimer.slotFrames[slot] = -1;
+		}
+
+		static double percentile(const std::vector<double>& sorted, double p)
+		{
+			if (sorted.empty()) {
+				return 0.0;
+			}
+			// Linear interpolation between the closest ranks
+			double rank = p / 100.0 * (double)(sorted.size() - 1);
+			size_t lower = (size_t)std::floor(rank);
+			size_t upper = std::min(lower + 1, sorted.size() - 1);
+			double fraction = rank - (double)lower;
+			return sorted[lower] + (sorted[upper] - sorted[lower]) * fraction;
+		}
+
+		static std::string jsonEscape(const std::string& value)
+		{
+			std::string escaped;
+			for (char c : value) {
+				switch (c) {
+				case '"': escaped += "\\\""; break;
+				case '\\': escaped += "\\\\"; break;
+				case '\n': escaped += "\\n"; break;
+				case '\t': escaped += "\\t"; break;
+				default:
+					if ((unsigned char)c >= 0x20) {
+						escaped += c;
+					}
+				}
+			}
+			return escaped;
+		}
+
+		static void writeJsonStatistics(std::ofstream& out, const std::string& name, const Statistics& stats)
+		{
+			out << "\t\"" << name << "\": { ";
+			out << "\"count\": " << stats.count << ", ";
+			out << "\"min\": " << stats.min << ", ";
+			out << "\"max\": " << stats.max << ", ";
+			out << "\"avg\": " << stats.avg << ", ";
+			out << "\"stddev\": " << stats.stdDev << ", ";
+			out << "\"p50\": " << stats.p50 << ", ";
+			out << "\"p95\": " << stats.p95 << ", ";
+			out << "\"p99\": " << stats.p99 << ", ";
+			out << "\"p99.9\": " << stats.p999 << " }";
+		}
+
+		static void writeJsonArray(std::ofstream& out, const std::vector<double>& values)
+		{
+			out << "[";
+			for (size_t i = 0; i < values.size(); i++) {
+				out << values[i] << ((i < values.size() - 1) ? ", " : "");
+			}
+			out << "]";
+		}
+
+		void printStatistics(const std::string& name, const Statistics& stats)
+		{
+			std::cout << name << " (ms): p50 " << stats.p50 << ", p95 " << stats.p95 << ", p99 " << stats.p99 << ", p99.9 " << stats.p999 << ", stddev " << stats.stdDev << "\n";
+		}
+
 	public:
 		bool active = false;
 		bool outputFrameTimes = false;
 		int outputFrames = -1; // -1 means no frames limit
 		uint32_t warmup = 1;
 		uint32_t duration = 10;
+		// Wall clock time for each call to the render function
 		std::vector<double> frameTimes;
+		// CPU time spent in the render function until the frame was handed to the presentation engine (recording and submission)
+		std::vector<double> cpuTimes;
+		// GPU execution time for each frame, negative if no timestamp was available
+		std::vector<double> gpuTimes;
 		std::string filename = "";
+		// Number of histogram bins between the fastest and the slowest frame
+		uint32_t histogramBins = 32;
+		// Frames slower than the third quartile plus this many inter-quartile ranges are reported as outliers
+		double outlierFactor = 3.0;
 
 		double runtime = 0.0;
 		uint32_t frameCount = 0;
 
+		/** @brief GPU time of a named pass (e.g. a GPU profiler scope), written to the results files */
+		struct PassTiming {
+			std::string name;
+			double avg = 0.0;
+			double min = 0.0;
+			double max = 0.0;
+			uint64_t count = 0;
+		};
+		std::vector<PassTiming> passTimings;
+
+		/** @brief Called once the warm up phase has finished, e.g. to reset statistics collected during warm up */
+		std::function<void()> warmupFinished;
+
+		/** @brief Adds the accumulated GPU time of a pass to the results */
+		void addPassTiming(const std::string& name, double total, double min, double max, uint64_t count)
+		{
+			if (count == 0) {
+				return;
+			}
+			PassTiming passTiming;
+			passTiming.name = name;
+			passTiming.avg = total / (double)count;
+			passTiming.min = min;
+			passTiming.max = max;
+			passTiming.count = count;
+			passTimings.push_back(passTiming);
+		}
+
+		/** @brief Prepares the timestamp queries used to measure GPU execution time, needs to be called before run() */
+		void prepareGpuTimer(VkDevice device, VkQueue queue, uint32_t queueFamilyIndex, uint32_t timestampValidBits, float timestampPeriod, uint32_t frameSlots = 4)
+		{
+			if (timestampValidBits == 0) {
+				std::cout << "Queue does not support timestamps, GPU times will not be reported" << "\n";
+				return;
+			}
+			gpuTimer.device = device;
+			gpuTimer.queue = queue;
+			gpuTimer.timestampPeriod = timestampPeriod;
+			gpuTimer.timestampMask = (timestampValidBits >= 64) ? ~0ULL : ((1ULL << timestampValidBits) - 1);
+
+			VkCommandPoolCreateInfo cmdPoolInfo = vks::initializers::commandPoolCreateInfo();
+			cmdPoolInfo.queueFamilyIndex = queueFamilyIndex;
+			VK_CHECK_RESULT(vkCreateCommandPool(device, &cmdPoolInfo, nullptr, &gpuTimer.commandPool));
+
+			VkQueryPoolCreateInfo queryPoolInfo{};
+			queryPoolInfo.sType = VK_STRUCTURE_TYPE_QUERY_POOL_CREATE_INFO;
+			queryPoolInfo.queryType = VK_QUERY_TYPE_TIMESTAMP;
+			queryPoolInfo.queryCount = frameSlots * 2;
+			VK_CHECK_RESULT(vkCreateQueryPool(device, &queryPoolInfo, nullptr, &gpuTimer.queryPool));
+
+			gpuTimer.beginCmdBuffers.resize(frameSlots);
+			gpuTimer.endCmdBuffers.resize(frameSlots);
+			gpuTimer.fences.resize(frameSlots);
+			gpuTimer.slotFrames.assign(frameSlots, -1);
+			VkCommandBufferAllocateInfo cmdBufAllocateInfo = vks::initializers::commandBufferAllocateInfo(gpuTimer.commandPool, VK_COMMAND_BUFFER_LEVEL_PRIMARY, frameSlots);
+			VK_CHECK_RESULT(vkAllocateCommandBuffers(device, &cmdBufAllocateInfo, gpuTimer.beginCmdBuffers.data()));
+			VK_CHECK_RESULT(vkAllocateCommandBuffers(device, &cmdBufAllocateInfo, gpuTimer.endCmdBuffers.data()));
+
+			// The command buffers never change, so they are recorded once up front
+			VkCommandBufferBeginInfo cmdBufInfo = vks::initializers::commandBufferBeginInfo();
+			VkFenceCreateInfo fenceCreateInfo = vks::initializers::fenceCreateInfo();
+			for (uint32_t i = 0; i < frameSlots; i++) {
+				VK_CHECK_RESULT(vkBeginCommandBuffer(gpuTimer.beginCmdBuffers[i], &cmdBufInfo));
+				vkCmdResetQueryPool(gpuTimer.beginCmdBuffers[i], gpuTimer.queryPool, i * 2, 2);
+				vkCmdWriteTimestamp(gpuTimer.beginCmdBuffers[i], VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT, gpuTimer.queryPool, i * 2);
+				VK_CHECK_RESULT(vkEndCommandBuffer(gpuTimer.beginCmdBuffers[i]));
+				VK_CHECK_RESULT(vkBeginCommandBuffer(gpuTimer.endCmdBuffers[i], &cmdBufInfo));
+				vkCmdWriteTimestamp(gpuTimer.endCmdBuffers[i], VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT, gpuTimer.queryPool, i * 2 + 1);
+				VK_CHECK_RESULT(vkEndCommandBuffer(gpuTimer.endCmdBuffers[i]));
+				VK_CHECK_RESULT(vkCreateFence(device, &fenceCreateInfo, nullptr, &gpuTimer.fences[i]));
+			}
+			gpuTimer.supported = true;
+		}
+
+		/** @brief Releases the timestamp query resources, device must be idle */
+		void destroyGpuTimer()
+		{
+			if (!gpuTimer.supported) {
+				return;
+			}
+			for (auto& fence : gpuTimer.fences) {
+				vkDestroyFence(gpuTimer.device, fence, nullptr);
+			}
+			vkDestroyQueryPool(gpuTimer.device, gpuTimer.queryPool, nullptr);
+			vkDestroyCommandPool(gpuTimer.device, gpuTimer.commandPool, nullptr);
+			gpuTimer.fences.clear();
+			gpuTimer.beginCmdBuffers.clear();
+			gpuTimer.endCmdBuffers.clear();
+			gpuTimer.supported = false;
+		}
+
+		/** @brief Marks the point at which the current frame has been recorded and handed to the queue (called from the example base) */
+		void markFrameSubmitted()
+		{
+			if (!frameSubmitted) {
+				tFrameSubmitted = std::chrono::high_resolution_clock::now();
+				frameSubmitted = true;
+			}
+		}
+
+		static Statistics calculateStatistics(const std::vector<double>& values)
+		{
+			Statistics stats;
+			std::vector<double> sorted;
+			sorted.reserve(values.size());
+			for (auto value : values) {
+				if (value >= 0.0) {
+					sorted.push_back(value);
+				}
+			}
+			if (sorted.empty()) {
+				return stats;
+			}
+			std::sort(sorted.begin(), sorted.end());
+			stats.count = sorted.size();
+			stats.min = sorted.front();
+			stats.max = sorted.back();
+			stats.avg = std::accumulate(sorted.begin(), sorted.end(), 0.0) / (double)sorted.size();
+			double variance = 0.0;
+			for (auto value : sorted) {
+				variance += (value - stats.avg) * (value - stats.avg);
+			}
+			stats.stdDev = std::sqrt(variance / (double)sorted.size());
+			stats.p50 = percentile(sorted, 50.0);
+			stats.p95 = percentile(sorted, 95.0);
+			stats.p99 = percentile(sorted, 99.0);
+			stats.p999 = percentile(sorted, 99.9);
+			return stats;
+		}
+
+		Histogram calculateHistogram(const std::vector<double>& values) const
+		{
+			Histogram histogram;
+			if (values.empty() || histogramBins == 0) {
+				return histogram;
+			}
+			double tMin = *std::min_element(values.begin(), values.end());
+			double tMax = *std::max_element(values.begin(), values.end());
+			histogram.start = tMin;
+			histogram.binWidth = std::max((tMax - tMin) / (double)histogramBins, std::numeric_limits<double>::epsilon());
+			histogram.bins.resize(histogramBins, 0);
+			for (auto value : values) {
+				uint32_t bin = std::min((uint32_t)((value - tMin) / histogram.binWidth), histogramBins - 1);
+				histogram.bins[bin]++;
+			}
+			return histogram;
+		}
+
+		/** @brief Returns the indices of all frames above the upper outlier fence (Q3 + outlierFactor * IQR) */
+		std::vector<size_t> findOutliers(const std::vector<double>& values) const
+		{
+			std::vector<size_t> outliers;
+			std::vector<double> sorted(values);
+			std::sort(sorted.begin(), sorted.end());
+			double q1 = percentile(sorted, 25.0);
+			double q3 = percentile(sorted, 75.0);
+			double fence = q3 + outlierFactor * (q3 - q1);
+			for (size_t i = 0; i < values.size(); i++) {
+				if (values[i] > fence) {
+					outliers.push_back(i);
+				}
+			}
+			return outliers;
+		}
+
 		void run(std::function<void()> renderFunc, VkPhysicalDeviceProperties deviceProps) {
 			active = true;
 			this->deviceProps = deviceProps;
@@ -51,54 +346,163 @@ namespace vks
 					auto tDiff = std::chrono::duration<double, std::milli>(std::chrono::high_resolution_clock::now() - tStart).count();
 					tMeasured += tDiff;
 				};
+				if (warmupFinished) {
+					warmupFinished();
+				}
 			}
 
 			// Benchmark phase
 			{
 				while (runtime < (duration * 1000.0)) {
-					auto tStart = std::chrono::high_resolution_clock::now();
+					uint32_t slot = gpuTimer.currentSlot;
+					if (gpuTimer.supported) {
+						// Results of the frame that last used this slot should be available by now
+						resolveGpuTimerSlot(slot);
+						VK_CHECK_RESULT(vkResetFences(gpuTimer.device, 1, &gpuTimer.fences[slot]));
+					}
+					frameSubmitted = false;
+					tFrameStart = std::chrono::high_resolution_clock::now();
+					if (gpuTimer.supported) {
+						VkSubmitInfo submitInfo = vks::initializers::submitInfo();
+						submitInfo.commandBufferCount = 1;
+						submitInfo.pCommandBuffers = &gpuTimer.beginCmdBuffers[slot];
+						VK_CHECK_RESULT(vkQueueSubmit(gpuTimer.queue, 1, &submitInfo, VK_NULL_HANDLE));
+					}
 					renderFunc();
-					auto tDiff = std::chrono::duration<double, std::milli>(std::chrono::high_resolution_clock::now() - tStart).count();
+					if (gpuTimer.supported) {
+						VkSubmitInfo submitInfo = vks::initializers::submitInfo();
+						submitInfo.commandBufferCount = 1;
+						submitInfo.pCommandBuffers = &gpuTimer.endCmdBuffers[slot];
+						VK_CHECK_RESULT(vkQueueSubmit(gpuTimer.queue, 1, &submitInfo, gpuTimer.fences[slot]));
+						gpuTimer.slotFrames[slot] = frameCount;
+						gpuTimer.currentSlot = (slot + 1) % (uint32_t)gpuTimer.fences.size();
+					}
+					auto tEnd = std::chrono::high_resolution_clock::now();
+					auto tDiff = std::chrono::duration<double, std::milli>(tEnd - tFrameStart).count();
+					// Samples that don't present through the example base have no separate submission point
+					auto tCpu = frameSubmitted ? std::chrono::duration<double, std::milli>(tFrameSubmitted - tFrameStart).count() : tDiff;
 					runtime += tDiff;
 					frameTimes.push_back(tDiff);
+					cpuTimes.push_back(tCpu);
+					gpuTimes.push_back(-1.0);
 					frameCount++;
 					if (outputFrames != -1 && outputFrames == frameCount) break;
 				};
+				// Collect the remaining GPU timings
+				for (uint32_t i = 0; i < gpuTimer.slotFrames.size(); i++) {
+					resolveGpuTimerSlot(i);
+				}
 				std::cout << "Benchmark finished" << "\n";
 				std::cout << "device : " << deviceProps.deviceName << " (driver version: " << deviceProps.driverVersion << ")" << "\n";
 				std::cout << "runtime: " << (runtime / 1000.0) << "\n";
 				std::cout << "frames : " << frameCount << "\n";
 				std::cout << "fps    : " << frameCount / (runtime / 1000.0) << "\n";
+				printStatistics("frame  ", calculateStatistics(frameTimes));
+				printStatistics("cpu    ", calculateStatistics(cpuTimes));
+				if (gpuTimer.supported) {
+					printStatistics("gpu    ", calculateStatistics(gpuTimes));
+				}
+				std::cout << "outliers: " << findOutliers(frameTimes).size() << "\n";
+			}
+		}
+
+		/** @brief Name of the machine-readable results file that is written next to the csv file */
+		std::string getJsonFilename() const
+		{
+			std::string jsonFilename = filename;
+			size_t extPos = jsonFilename.find_last_of('.');
+			size_t dirPos = jsonFilename.find_last_of("/\\");
+			if ((extPos != std::string::npos) && ((dirPos == std::string::npos) || (extPos > dirPos))) {
+				jsonFilename = jsonFilename.substr(0, extPos);
 			}
+			return jsonFilename + ".json";
 		}
 
 		void saveResults() {
+			if (frameTimes.empty()) {
+				return;
+			}
+			Statistics frameStats = calculateStatistics(frameTimes);
+			Statistics cpuStats = calculateStatistics(cpuTimes);
+			Statistics gpuStats = calculateStatistics(gpuTimes);
+			Histogram histogram = calculateHistogram(frameTimes);
+			std::vector<size_t> outliers = findOutliers(frameTimes);
+
 			std::ofstream result(filename, std::ios::out);
 			if (result.is_open()) {
 				result << std::fixed << std::setprecision(4);
 
-				result << "device,driverversion,duration (ms),frames,fps" << "\n";
-				result << deviceProps.deviceName << "," << deviceProps.driverVersion << "," << runtime << "," << frameCount << "," << frameCount / (runtime / 1000.0) << "\n";
+				result << "device,driverversion,duration (ms),frames,fps,min (ms),max (ms),avg (ms),stddev (ms),p50 (ms),p95 (ms),p99 (ms),p99.9 (ms),outliers,cpu p50 (ms),cpu p99 (ms),gpu p50 (ms),gpu p99 (ms)" << "\n";
+				result << deviceProps.deviceName << "," << deviceProps.driverVersion << "," << runtime << "," << frameCount << "," << frameCount / (runtime / 1000.0) << ",";
+				result << frameStats.min << "," << frameStats.max << "," << frameStats.avg << "," << frameStats.stdDev << ",";
+				result << frameStats.p50 << "," << frameStats.p95 << "," << frameStats.p99 << "," << frameStats.p999 << "," << outliers.size() << ",";
+				result << cpuStats.p50 << "," << cpuStats.p99 << "," << gpuStats.p50 << "," << gpuStats.p99 << "\n";
+
+				if (!passTimings.empty()) {
+					result << "\n" << "pass,avg (ms),min (ms),max (ms),samples" << "\n";
+					for (auto& passTiming : passTimings) {
+						result << passTiming.name << "," << passTiming.avg << "," << passTiming.min << "," << passTiming.max << "," << passTiming.count << "\n";
+					}
+				}
 
 				if (outputFrameTimes) {
-					result << "\n" << "frame,ms" << "\n";
+					result << "\n" << "frame,ms,cpu ms,gpu ms" << "\n";
 					for (size_t i = 0; i < frameTimes.size(); i++) {
-						result << i << "," << frameTimes[i] << "\n";
+						result << i << "," << frameTimes[i] << "," << cpuTimes[i] << "," << gpuTimes[i] << "\n";
 					}
-					double tMin = *std::min_element(frameTimes.begin(), frameTimes.end());
-					double tMax = *std::max_element(frameTimes.begin(), frameTimes.end());
-					double tAvg = std::accumulate(frameTimes.begin(), frameTimes.end(), 0.0) / (double)frameTimes.size();
-					std::cout << "best   : " << (1000.0 / tMin) << " fps (" << tMin << " ms)" << "\n";
-					std::cout << "worst  : " << (1000.0 / tMax) << " fps (" << tMax << " ms)" << "\n";
-					std::cout << "avg    : " << (1000.0 / tAvg) << " fps (" << tAvg << " ms)" << "\n";
+					std::cout << "best   : " << (1000.0 / frameStats.min) << " fps (" << frameStats.min << " ms)" << "\n";
+					std::cout << "worst  : " << (1000.0 / frameStats.max) << " fps (" << frameStats.max << " ms)" << "\n";
+					std::cout << "avg    : " << (1000.0 / frameStats.avg) << " fps (" << frameStats.avg << " ms)" << "\n";
 					std::cout << "\n";
 				}
 
 				result.flush();
+			}
+
+			std::ofstream json(getJsonFilename(), std::ios::out);
+			if (json.is_open()) {
+				json << std::fixed << std::setprecision(4);
+				json << "{\n";
+				json << "\t\"device\": \"" << jsonEscape(deviceProps.deviceName) << "\",\n";
+				json << "\t\"driverVersion\": " << deviceProps.driverVersion << ",\n";
+				json << "\t\"runtime\": " << runtime << ",\n";
+				json << "\t\"frames\": " << frameCount << ",\n";
+				json << "\t\"fps\": " << frameCount / (runtime / 1000.0) << ",\n";
+				writeJsonStatistics(json, "frameTime", frameStats);
+				json << ",\n";
+				writeJsonStatistics(json, "cpuTime", cpuStats);
+				json << ",\n";
+				writeJsonStatistics(json, "gpuTime", gpuStats);
+				json << ",\n";
+				json << "\t\"histogram\": { \"start\": " << histogram.start << ", \"binWidth\": " << histogram.binWidth << ", \"bins\": [";
+				for (size_t i = 0; i < histogram.bins.size(); i++) {
+					json << histogram.bins[i] << ((i < histogram.bins.size() - 1) ? ", " : "");
+				}
+				json << "] },\n";
+				json << "\t\"passes\": [";
+				for (size_t i = 0; i < passTimings.size(); i++) {
+					json << "{ \"name\": \"" << jsonEscape(passTimings[i].name) << "\", \"avg\": " << passTimings[i].avg << ", \"min\": " << passTimings[i].min << ", \"max\": " << passTimings[i].max << ", \"count\": " << passTimings[i].count << " }" << ((i < passTimings.size() - 1) ? ", " : "");
+				}
+				json << "],\n";
+				json << "\t\"outliers\": [";
+				for (size_t i = 0; i < outliers.size(); i++) {
+					json << "{ \"frame\": " << outliers[i] << ", \"ms\": " << frameTimes[outliers[i]] << " }" << ((i < outliers.size() - 1) ? ", " : "");
+				}
+				json << "]";
+				if (outputFrameTimes) {
+					json << ",\n\t\"frameTimes\": ";
+					writeJsonArray(json, frameTimes);
+					json << ",\n\t\"cpuTimes\": ";
+					writeJsonArray(json, cpuTimes);
+					json << ",\n\t\"gpuTimes\": ";
+					writeJsonArray(json, gpuTimes);
+				}
+				json << "\n}\n";
+				json.flush();
+			}
 #if defined(_WIN32)
-				FreeConsole();
+			FreeConsole();
 #endif
-			}
 		}
 	};
-}
\ No newline at end of file
+}
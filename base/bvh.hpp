@@ -0,0 +1,250 @@
+/*
+* Bounding volume hierarchy for frustum culling
+*
+* Four-wide tree over axis aligned boxes, every node stores the bounds of its four children in structure of arrays
+* layout, so one Frustum::checkBoxes4 call tests all children of a node at once
+* Items are reordered at build time so that every subtree covers a contiguous range of item indices, children that are
+* completely inside of the frustum emit their whole range without further tests
+* The topology is built once, moving items only update their bounds and refit the node boxes
+*
+* This code is licensed under the MIT license (MIT) (http://opensource.org/licenses/MIT)
+*/
+
+#pragma once
+
+#include <vector>
+#include <algorithm>
+#include <assert.h>
+#include <float.h>
+#include <stdint.h>
+#include <glm/glm.hpp>
+
+#include "frustum.hpp"
+
+namespace vks
+{
+	class Bvh
+	{
+	public:
+		/** @brief Maximum number of items in a leaf, matches the width of the box tests */
+		static const uint32_t leafSize = 4;
+
+		struct Node
+		{
+			/** @brief Bounds of the four children, empty child slots have inverted bounds that never pass a test */
+			float minX[4], minY[4], minZ[4];
+			float maxX[4], maxY[4], maxZ[4];
+			/** @brief Index of the child node, -1 if the child is a leaf */
+			int32_t child[4];
+			/** @brief Range in the reordered item list covered by the child */
+			uint32_t first[4];
+			uint32_t count[4];
+		};
+
+	private:
+		std::vector<Node> nodes;
+		// Item indices and bounds in tree order, so leaves access their items sequentially
+		std::vector<uint32_t> items;
+		std::vector<glm::vec3> itemMin;
+		std::vector<glm::vec3> itemMax;
+		// Position of each item in tree order
+		std::vector<uint32_t> itemSlots;
+
+		struct BuildItem
+		{
+			glm::vec3 center;
+			uint32_t index;
+		};
+
+		struct Split
+		{
+			uint32_t first;
+			uint32_t count;
+		};
+
+		// Splits a range at the median of the item centers along the longest axis of their bounds
+		static void split(std::vector<BuildItem>& buildItems, Split range, Split& left, Split& right)
+		{
+			glm::vec3 cMin(FLT_MAX), cMax(-FLT_MAX);
+			for (uint32_t i = range.first; i < range.first + range.count; i++) {
+				cMin = glm::min(cMin, buildItems[i].center);
+				cMax = glm::max(cMax, buildItems[i].center);
+			}
+			const glm::vec3 extent = cMax - cMin;
+			const int axis = (extent.x >= extent.y && extent.x >= extent.z) ? 0 : ((extent.y >= extent.z) ? 1 : 2);
+			const uint32_t half = range.count / 2;
+			std::nth_element(buildItems.begin() + range.first, buildItems.begin() + range.first + half, buildItems.begin() + range.first + range.count, [axis](const BuildItem& a, const BuildItem& b) {
+				return a.center[axis] < b.center[axis];
+			});
+			left = { range.first, half };
+			right = { range.first + half, range.count - half };
+		}
+
+		// Nodes are allocated in pre-order, so children always have a higher index than their parent
+		int32_t buildNode(std::vector<BuildItem>& buildItems, Split range)
+		{
+			Split parts[4] = { range };
+			uint32_t partCount = 1;
+			while (partCount < 4) {
+				// Split the largest part that doesn't fit into a leaf
+				uint32_t largest = 0;
+				for (uint32_t i = 1; i < partCount; i++) {
+					if (parts[i].count > parts[largest].count) {
+						largest = i;
+					}
+				}
+				if (parts[largest].count <= leafSize) {
+					break;
+				}
+				split(buildItems, parts[largest], parts[largest], parts[partCount]);
+				partCount++;
+			}
+			const int32_t index = static_cast<int32_t>(nodes.size());
+			nodes.emplace_back();
+			for (uint32_t i = 0; i < 4; i++) {
+				nodes[index].child[i] = -1;
+				nodes[index].first[i] = (i < partCount) ? parts[i].first : 0;
+				nodes[index].count[i] = (i < partCount) ? parts[i].count : 0;
+			}
+			for (uint32_t i = 0; i < partCount; i++) {
+				if (parts[i].count > leafSize) {
+					const int32_t child = buildNode(buildItems, parts[i]);
+					nodes[index].child[i] = child;
+				}
+			}
+			return index;
+		}
+
+	public:
+		/**
+		* Builds the tree over a set of boxes
+		*
+		* @param min, max Bounds of the items, the index of an item is its position in these lists
+		*/
+		void build(const std::vector<glm::vec3>& min, const std::vector<glm::vec3>& max)
+		{
+			assert(min.size() == max.size());
+			const uint32_t itemCount = static_cast<uint32_t>(min.size());
+			nodes.clear();
+			items.resize(itemCount);
+			itemMin.resize(itemCount);
+			itemMax.resize(itemCount);
+			itemSlots.resize(itemCount);
+			if (itemCount == 0) {
+				return;
+			}
+			// Centers are sorted along with the indices, which keeps the accesses during the build sequential
+			std::vector<BuildItem> buildItems(itemCount);
+			for (uint32_t i = 0; i < itemCount; i++) {
+				buildItems[i] = { (min[i] + max[i]) * 0.5f, i };
+			}
+			nodes.reserve(itemCount / 2 + 1);
+			buildNode(buildItems, { 0, itemCount });
+			for (uint32_t i = 0; i < itemCount; i++) {
+				const uint32_t item = buildItems[i].index;
+				items[i] = item;
+				itemSlots[item] = i;
+				itemMin[i] = min[item];
+				itemMax[i] = max[item];
+			}
+			refit();
+		}
+
+		/** @brief Updates the bounds of an item, the tree needs to be refitted before it's culled again */
+		void setItemBounds(uint32_t item, const glm::vec3& min, const glm::vec3& max)
+		{
+			itemMin[itemSlots[item]] = min;
+			itemMax[itemSlots[item]] = max;
+		}
+
+		/** @brief Recalculates all node bounds bottom up, the topology is kept so the tree may lose quality if items move a lot */
+		void refit()
+		{
+			for (size_t n = nodes.size(); n-- > 0;) {
+				Node& node = nodes[n];
+				for (uint32_t i = 0; i < 4; i++) {
+					glm::vec3 bMin(FLT_MAX), bMax(-FLT_MAX);
+					if (node.child[i] >= 0) {
+						// Children have a higher index and have already been refitted
+						const Node& child = nodes[node.child[i]];
+						for (uint32_t c = 0; c < 4; c++) {
+							if (child.count[c] > 0) {
+								bMin = glm::min(bMin, glm::vec3(child.minX[c], child.minY[c], child.minZ[c]));
+								bMax = glm::max(bMax, glm::vec3(child.maxX[c], child.maxY[c], child.maxZ[c]));
+							}
+						}
+					} else {
+						for (uint32_t j = node.first[i]; j < node.first[i] + node.count[i]; j++) {
+							bMin = glm::min(bMin, itemMin[j]);
+							bMax = glm::max(bMax, itemMax[j]);
+						}
+					}
+					node.minX[i] = bMin.x; node.minY[i] = bMin.y; node.minZ[i] = bMin.z;
+					node.maxX[i] = bMax.x; node.maxY[i] = bMax.y; node.maxZ[i] = bMax.z;
+				}
+			}
+		}
+
+		/**
+		* Collects all items that are at least partially inside of the frustum
+		*
+		* @param frustum Frustum to test against
+		* @param visibleItems Receives the indices of the visible items, in no particular order
+		*/
+		void cull(const Frustum& frustum, std::vector<uint32_t>& visibleItems) const
+		{
+			visibleItems.clear();
+			if (nodes.empty()) {
+				return;
+			}
+			// Median splits keep the tree balanced, so the depth is logarithmic and a small fixed stack is enough
+			int32_t stack[256];
+			uint32_t stackSize = 0;
+			stack[stackSize++] = 0;
+			while (stackSize > 0) {
+				const Node& node = nodes[stack[--stackSize]];
+				uint32_t inside = 0;
+				const uint32_t visible = frustum.checkBoxes4(node.minX, node.minY, node.minZ, node.maxX, node.maxY, node.maxZ, &inside);
+				for (uint32_t i = 0; i < 4; i++) {
+					const uint32_t bit = 1u << i;
+					if (!(visible & bit) || (node.count[i] == 0)) {
+						continue;
+					}
+					if (inside & bit) {
+						visibleItems.insert(visibleItems.end(), items.begin() + node.first[i], items.begin() + node.first[i] + node.count[i]);
+					} else if (node.child[i] >= 0) {
+						assert(stackSize < 256);
+						stack[stackSize++] = node.child[i];
+					} else {
+						// Intersecting leaf, test its items individually
+						float bMin[3][4], bMax[3][4];
+						for (uint32_t j = 0; j < 4; j++) {
+							// Unused lanes repeat the first item and are masked out below
+							const uint32_t slot = node.first[i] + ((j < node.count[i]) ? j : 0);
+							for (uint32_t c = 0; c < 3; c++) {
+								bMin[c][j] = itemMin[slot][c];
+								bMax[c][j] = itemMax[slot][c];
+							}
+						}
+						const uint32_t visibleInLeaf = frustum.checkBoxes4(bMin[0], bMin[1], bMin[2], bMax[0], bMax[1], bMax[2]);
+						for (uint32_t j = 0; j < node.count[i]; j++) {
+							if (visibleInLeaf & (1u << j)) {
+								visibleItems.push_back(items[node.first[i] + j]);
+							}
+						}
+					}
+				}
+			}
+		}
+
+		uint32_t getItemCount() const
+		{
+			return static_cast<uint32_t>(items.size());
+		}
+
+		uint32_t getNodeCount() const
+		{
+			return static_cast<uint32_t>(nodes.size());
+		}
+	};
+}
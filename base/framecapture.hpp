@@ -0,0 +1,697 @@
+/*
+* Asynchronous frame capture
+*
+* Rendered images are copied into a ring of host visible readback buffers as part of the frame's submission, the
+* render loop never waits for the copy. A slot is picked up once its fence has signaled (usually a few frames later),
+* then a worker thread converts the pixels to RGBA and streams them to disk as PNG or QOI files or as one raw RGBA file
+* Only if all slots are still in use (the workers can't keep up with the frame rate) does capturing a frame block,
+* these stalls are counted so it's visible when a capture influenced the measured frame times
+*
+* This code is licensed under the MIT license (MIT) (http://opensource.org/licenses/MIT)
+*/
+
+#pragma once
+
+#include <stdio.h>
+#include <string.h>
+#include <vector>
+#include <string>
+#include <algorithm>
+#include <deque>
+#include <thread>
+#include <mutex>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <fstream>
+#include <iostream>
+
+#include "simd.hpp"
+
+#include "vulkan/vulkan.h"
+#include "VulkanDevice.h"
+#include "VulkanBuffer.h"
+#include "VulkanTools.h"
+#include "VulkanInitializers.hpp"
+
+namespace vks
+{
+	namespace capture
+	{
+		/**
+		* Converts a row of 8 bit BGRA or RGBA pixels to RGBA with an opaque alpha channel
+		* Swap chain images usually don't contain meaningful alpha values, which would make the saved images transparent
+		*
+		* @param src Source pixels, 4 bytes per pixel
+		* @param dst Destination pixels, may be the same as src
+		* @param pixelCount Number of pixels to convert
+		* @param swapRedBlue True if the source is BGRA
+		*/
+		inline void convertRow(const uint8_t* src, uint8_t* dst, uint32_t pixelCount, bool swapRedBlue)
+		{
+			uint32_t i = 0;
+#if defined(VKS_SIMD_SSE2)
+			const __m128i redBlueMask = _mm_set1_epi32(0x00FF00FF);
+			const __m128i greenAlphaMask = _mm_set1_epi32((int)0xFF00FF00);
+			const __m128i opaque = _mm_set1_epi32((int)0xFF000000);
+			for (; i + 4 <= pixelCount; i += 4) {
+				__m128i pixels = _mm_loadu_si128(reinterpret_cast<const __m128i*>(src + i * 4));
+				if (swapRedBlue) {
+					const __m128i redBlue = _mm_and_si128(pixels, redBlueMask);
+					const __m128i swapped = _mm_or_si128(_mm_slli_epi32(redBlue, 16), _mm_srli_epi32(redBlue, 16));
+					pixels = _mm_or_si128(swapped, _mm_and_si128(pixels, greenAlphaMask));
+				}
+				_mm_storeu_si128(reinterpret_cast<__m128i*>(dst + i * 4), _mm_or_si128(pixels, opaque));
+			}
+#elif defined(VKS_SIMD_NEON)
+			const uint8x16_t opaque = vdupq_n_u8(0xFF);
+			for (; i + 16 <= pixelCount; i += 16) {
+				uint8x16x4_t pixels = vld4q_u8(src + i * 4);
+				if (swapRedBlue) {
+					const uint8x16_t blue = pixels.val[0];
+					pixels.val[0] = pixels.val[2];
+					pixels.val[2] = blue;
+				}
+				pixels.val[3] = opaque;
+				vst4q_u8(dst + i * 4, pixels);
+			}
+#endif
+			for (; i < pixelCount; i++) {
+				uint32_t pixel;
+				memcpy(&pixel, src + i * 4, sizeof(pixel));
+				if (swapRedBlue) {
+					const uint32_t redBlue = pixel & 0x00FF00FFu;
+					pixel = (pixel & 0xFF00FF00u) | (redBlue << 16) | (redBlue >> 16);
+				}
+				pixel |= 0xFF000000u;
+				memcpy(dst + i * 4, &pixel, sizeof(pixel));
+			}
+		}
+
+		/** @brief Streaming CRC-32 as used by PNG chunks (slicing by 4) */
+		class Crc32
+		{
+		private:
+			uint32_t table[4][256];
+		public:
+			Crc32()
+			{
+				for (uint32_t i = 0; i < 256; i++) {
+					uint32_t c = i;
+					for (uint32_t k = 0; k < 8; k++) {
+						c = (c & 1) ? (0xEDB88320u ^ (c >> 1)) : (c >> 1);
+					}
+					table[0][i] = c;
+				}
+				for (uint32_t i = 0; i < 256; i++) {
+					for (uint32_t t = 1; t < 4; t++) {
+						table[t][i] = (table[t - 1][i] >> 8) ^ table[0][table[t - 1][i] & 0xFF];
+					}
+				}
+			}
+
+			uint32_t update(uint32_t crc, const uint8_t* data, size_t size) const
+			{
+				crc = ~crc;
+				for (; size >= 4; size -= 4, data += 4) {
+					crc ^= (uint32_t)data[0] | ((uint32_t)data[1] << 8) | ((uint32_t)data[2] << 16) | ((uint32_t)data[3] << 24);
+					crc = table[3][crc & 0xFF] ^ table[2][(crc >> 8) & 0xFF] ^ table[1][(crc >> 16) & 0xFF] ^ table[0][crc >> 24];
+				}
+				for (; size > 0; size--, data++) {
+					crc = table[0][(crc ^ *data) & 0xFF] ^ (crc >> 8);
+				}
+				return ~crc;
+			}
+		};
+
+		/** @brief Streaming Adler-32 checksum as used by zlib streams */
+		inline uint32_t adler32(uint32_t adler, const uint8_t* data, size_t size)
+		{
+			// Largest block size for which the sums can't overflow before the modulo
+			const size_t blockSize = 5552;
+			uint32_t a = adler & 0xFFFF;
+			uint32_t b = adler >> 16;
+			while (size > 0) {
+				const size_t count = (size < blockSize) ? size : blockSize;
+				for (size_t i = 0; i < count; i++) {
+					a += data[i];
+					b += a;
+				}
+				a %= 65521;
+				b %= 65521;
+				data += count;
+				size -= count;
+			}
+			return (b << 16) | a;
+		}
+
+		inline void writeBigEndian(std::vector<uint8_t>& out, uint32_t value)
+		{
+			out.push_back((uint8_t)(value >> 24));
+			out.push_back((uint8_t)(value >> 16));
+			out.push_back((uint8_t)(value >> 8));
+			out.push_back((uint8_t)value);
+		}
+
+		/**
+		* Encodes RGBA pixels as a PNG file
+		* The image data is stored in uncompressed deflate blocks, so encoding costs about as much as a copy and stays
+		* well below a frame's time, at the expense of file size. Use QOI for smaller files at a similar speed
+		*
+		* @param pixels Tightly packed RGBA pixels
+		* @param out Receives the encoded file, previous contents are replaced
+		*/
+		inline void encodePng(const uint8_t* pixels, uint32_t width, uint32_t height, std::vector<uint8_t>& out)
+		{
+			static const Crc32 crc32;
+			const uint32_t maxBlockSize = 65535;
+			const size_t rowSize = (size_t)width * 4;
+			const size_t filteredSize = (rowSize + 1) * height;
+			const size_t blockCount = (filteredSize + maxBlockSize - 1) / maxBlockSize;
+			const size_t zlibSize = 2 + filteredSize + blockCount * 5 + 4;
+
+			out.clear();
+			out.reserve(8 + 25 + 12 + zlibSize + 12);
+			const uint8_t signature[] = { 0x89, 'P', 'N', 'G', '\r', '\n', 0x1A, '\n' };
+			out.insert(out.end(), signature, signature + sizeof(signature));
+
+			// Header: 8 bits per channel, color type 6 (RGBA)
+			writeBigEndian(out, 13);
+			size_t chunkStart = out.size();
+			const uint8_t headerType[] = { 'I', 'H', 'D', 'R' };
+			out.insert(out.end(), headerType, headerType + 4);
+			writeBigEndian(out, width);
+			writeBigEndian(out, height);
+			const uint8_t headerInfo[] = { 8, 6, 0, 0, 0 };
+			out.insert(out.end(), headerInfo, headerInfo + sizeof(headerInfo));
+			writeBigEndian(out, crc32.update(0, out.data() + chunkStart, out.size() - chunkStart));
+
+			// Image data as a single zlib stream of stored blocks, each row is prefixed with filter type 0 (none)
+			writeBigEndian(out, (uint32_t)zlibSize);
+			chunkStart = out.size();
+			const uint8_t dataType[] = { 'I', 'D', 'A', 'T', 0x78, 0x01 };
+			out.insert(out.end(), dataType, dataType + sizeof(dataType));
+			uint32_t adler = 1;
+			size_t blockRemaining = 0;
+			size_t totalRemaining = filteredSize;
+			auto append = [&](const uint8_t* data, size_t size) {
+				while (size > 0) {
+					if (blockRemaining == 0) {
+						blockRemaining = (totalRemaining < maxBlockSize) ? totalRemaining : maxBlockSize;
+						totalRemaining -= blockRemaining;
+						const uint16_t length = (uint16_t)blockRemaining;
+						out.push_back(totalRemaining == 0 ? 1 : 0);
+						out.push_back((uint8_t)length);
+						out.push_back((uint8_t)(length >> 8));
+						out.push_back((uint8_t)~length);
+						out.push_back((uint8_t)(~length >> 8));
+					}
+					const size_t count = (size < blockRemaining) ? size : blockRemaining;
+					out.insert(out.end(), data, data + count);
+					adler = adler32(adler, data, count);
+					data += count;
+					size -= count;
+					blockRemaining -= count;
+				}
+			};
+			const uint8_t filterType = 0;
+			for (uint32_t y = 0; y < height; y++) {
+				append(&filterType, 1);
+				append(pixels + y * rowSize, rowSize);
+			}
+			writeBigEndian(out, adler);
+			writeBigEndian(out, crc32.update(0, out.data() + chunkStart, out.size() - chunkStart));
+
+			writeBigEndian(out, 0);
+			chunkStart = out.size();
+			const uint8_t endType[] = { 'I', 'E', 'N', 'D' };
+			out.insert(out.end(), endType, endType + 4);
+			writeBigEndian(out, crc32.update(0, out.data() + chunkStart, out.size() - chunkStart));
+		}
+
+		/**
+		* Encodes RGBA pixels as a QOI file (https://qoiformat.org)
+		*
+		* @param pixels Tightly packed RGBA pixels
+		* @param out Receives the encoded file, previous contents are replaced
+		*/
+		inline void encodeQoi(const uint8_t* pixels, uint32_t width, uint32_t height, std::vector<uint8_t>& out)
+		{
+			const size_t pixelCount = (size_t)width * height;
+			out.clear();
+			out.reserve(14 + pixelCount * 5 + 8);
+			const uint8_t magic[] = { 'q', 'o', 'i', 'f' };
+			out.insert(out.end(), magic, magic + 4);
+			writeBigEndian(out, width);
+			writeBigEndian(out, height);
+			// 4 channels, sRGB with linear alpha
+			out.push_back(4);
+			out.push_back(0);
+
+			uint32_t index[64] = {};
+			uint32_t previous = 0xFF000000u;
+			uint32_t run = 0;
+			for (size_t i = 0; i < pixelCount; i++) {
+				uint32_t pixel;
+				memcpy(&pixel, pixels + i * 4, sizeof(pixel));
+				if (pixel == previous) {
+					run++;
+					if ((run == 62) || (i == pixelCount - 1)) {
+						out.push_back((uint8_t)(0xC0 | (run - 1)));
+						run = 0;
+					}
+					continue;
+				}
+				if (run > 0) {
+					out.push_back((uint8_t)(0xC0 | (run - 1)));
+					run = 0;
+				}
+				const uint8_t r = (uint8_t)pixel, g = (uint8_t)(pixel >> 8), b = (uint8_t)(pixel >> 16), a = (uint8_t)(pixel >> 24);
+				const uint32_t hash = (r * 3 + g * 5 + b * 7 + a * 11) % 64;
+				if (index[hash] == pixel) {
+					out.push_back((uint8_t)hash);
+				} else {
+					index[hash] = pixel;
+					if (a == (uint8_t)(previous >> 24)) {
+						const int8_t dr = (int8_t)(r - (uint8_t)previous);
+						const int8_t dg = (int8_t)(g - (uint8_t)(previous >> 8));
+						const int8_t db = (int8_t)(b - (uint8_t)(previous >> 16));
+						const int8_t drg = (int8_t)(dr - dg);
+						const int8_t dbg = (int8_t)(db - dg);
+						if ((dr >= -2) && (dr <= 1) && (dg >= -2) && (dg <= 1) && (db >= -2) && (db <= 1)) {
+							out.push_back((uint8_t)(0x40 | ((dr + 2) << 4) | ((dg + 2) << 2) | (db + 2)));
+						} else if ((dg >= -32) && (dg <= 31) && (drg >= -8) && (drg <= 7) && (dbg >= -8) && (dbg <= 7)) {
+							out.push_back((uint8_t)(0x80 | (dg + 32)));
+							out.push_back((uint8_t)(((drg + 8) << 4) | (dbg + 8)));
+						} else {
+							const uint8_t rgb[] = { 0xFE, r, g, b };
+							out.insert(out.end(), rgb, rgb + 4);
+						}
+					} else {
+						const uint8_t rgba[] = { 0xFF, r, g, b, a };
+						out.insert(out.end(), rgba, rgba + 5);
+					}
+				}
+				previous = pixel;
+			}
+			const uint8_t padding[] = { 0, 0, 0, 0, 0, 0, 0, 1 };
+			out.insert(out.end(), padding, padding + sizeof(padding));
+		}
+	}
+
+	class FrameCapture
+	{
+	public:
+		enum class Format { Png, Qoi, Raw };
+
+		struct Statistics {
+			uint32_t capturedFrames = 0;
+			uint32_t savedFrames = 0;
+			/** @brief Number of captures that had to wait for a free slot */
+			uint32_t stalls = 0;
+			/** @brief Total time spent waiting for free slots in ms */
+			double stallTime = 0.0;
+			/** @brief Total time the workers spent converting and writing frames in ms */
+			double workerTime = 0.0;
+		};
+
+	private:
+		enum SlotState : uint32_t { SlotFree, SlotCopying, SlotEncoding };
+
+		struct Slot {
+			vks::Buffer buffer;
+			VkCommandBuffer commandBuffer = VK_NULL_HANDLE;
+			VkFence fence = VK_NULL_HANDLE;
+			VkSemaphore semaphore = VK_NULL_HANDLE;
+			uint32_t width = 0;
+			uint32_t height = 0;
+			bool swapRedBlue = false;
+			uint32_t frameIndex = 0;
+			std::atomic<uint32_t> state{ SlotFree };
+		};
+
+		vks::VulkanDevice* vulkanDevice = nullptr;
+		VkCommandPool commandPool = VK_NULL_HANDLE;
+		VkMemoryPropertyFlags memoryPropertyFlags = 0;
+		std::string prefix;
+		Format format = Format::Png;
+		std::vector<Slot> slots;
+		uint32_t nextSlot = 0;
+		// Slots waiting for their copy to finish, in submission order
+		std::deque<uint32_t> pendingSlots;
+		Statistics statistics;
+
+		std::vector<std::thread> workers;
+		std::deque<uint32_t> workQueue;
+		std::mutex workMutex;
+		std::condition_variable workCondition;
+		std::condition_variable slotFreedCondition;
+		bool stopWorkers = false;
+		// Raw frames are appended to a single file in capture order (only written by one worker)
+		std::ofstream rawStream;
+		uint32_t rawWidth = 0;
+		uint32_t rawHeight = 0;
+
+		void workerLoop()
+		{
+			std::vector<uint8_t> pixels;
+			std::vector<uint8_t> encoded;
+			while (true) {
+				uint32_t slotIndex;
+				{
+					std::unique_lock<std::mutex> lock(workMutex);
+					workCondition.wait(lock, [this] { return !workQueue.empty() || stopWorkers; });
+					if (workQueue.empty()) {
+						return;
+					}
+					slotIndex = workQueue.front();
+					workQueue.pop_front();
+				}
+				auto tStart = std::chrono::high_resolution_clock::now();
+				bool saved = save(slots[slotIndex], pixels, encoded);
+				double workerTime = std::chrono::duration<double, std::milli>(std::chrono::high_resolution_clock::now() - tStart).count();
+				{
+					std::lock_guard<std::mutex> lock(workMutex);
+					statistics.workerTime += workerTime;
+					statistics.savedFrames += saved ? 1 : 0;
+					slots[slotIndex].state = SlotFree;
+				}
+				slotFreedCondition.notify_all();
+			}
+		}
+
+		bool save(Slot& slot, std::vector<uint8_t>& pixels, std::vector<uint8_t>& encoded)
+		{
+			const uint8_t* src = static_cast<const uint8_t*>(slot.buffer.mapped);
+			const size_t pixelCount = (size_t)slot.width * slot.height;
+			pixels.resize(pixelCount * 4);
+			// Convert in row sized chunks that stay in cache while the source is streamed from (possibly uncached) memory
+			for (uint32_t y = 0; y < slot.height; y++) {
+				const size_t offset = (size_t)y * slot.width * 4;
+				capture::convertRow(src + offset, pixels.data() + offset, slot.width, slot.swapRedBlue);
+			}
+			if (format == Format::Raw) {
+				rawStream.write(reinterpret_cast<const char*>(pixels.data()), pixels.size());
+				return rawStream.good();
+			}
+			if (format == Format::Png) {
+				capture::encodePng(pixels.data(), slot.width, slot.height, encoded);
+			} else {
+				capture::encodeQoi(pixels.data(), slot.width, slot.height, encoded);
+			}
+			const std::string fileName = getFileName(slot.frameIndex);
+			FILE* file = fopen(fileName.c_str(), "wb");
+			if (!file) {
+				std::cerr << "Could not write captured frame to \"" << fileName << "\"\n";
+				return false;
+			}
+			const bool written = fwrite(encoded.data(), 1, encoded.size(), file) == encoded.size();
+			fclose(file);
+			return written;
+		}
+
+		std::string getFileName(uint32_t frameIndex) const
+		{
+			char frameNumber[16];
+			snprintf(frameNumber, sizeof(frameNumber), "%05u", frameIndex);
+			return prefix + frameNumber + ((format == Format::Png) ? ".png" : ".qoi");
+		}
+
+		// Hands slots whose copy has finished over to the workers, if wait is true the oldest pending slot is waited for
+		void collect(bool wait)
+		{
+			VkDevice device = vulkanDevice->logicalDevice;
+			while (!pendingSlots.empty()) {
+				Slot& slot = slots[pendingSlots.front()];
+				if (wait) {
+					VK_CHECK_RESULT(vkWaitForFences(device, 1, &slot.fence, VK_TRUE, UINT64_MAX));
+					wait = false;
+				} else if (vkGetFenceStatus(device, slot.fence) != VK_SUCCESS) {
+					break;
+				}
+				if ((memoryPropertyFlags & VK_MEMORY_PROPERTY_HOST_COHERENT_BIT) == 0) {
+					VK_CHECK_RESULT(slot.buffer.invalidate());
+				}
+				{
+					std::lock_guard<std::mutex> lock(workMutex);
+					slot.state = SlotEncoding;
+					workQueue.push_back(pendingSlots.front());
+				}
+				workCondition.notify_one();
+				pendingSlots.pop_front();
+			}
+		}
+
+	public:
+		/** @brief Returns true if images of the given format can be captured */
+		static bool formatSupported(VkFormat format)
+		{
+			return (format == VK_FORMAT_B8G8R8A8_UNORM) || (format == VK_FORMAT_B8G8R8A8_SRGB) || (format == VK_FORMAT_R8G8B8A8_UNORM) || (format == VK_FORMAT_R8G8B8A8_SRGB);
+		}
+
+		/** @brief Parses a format name (png, qoi or raw), returns false for unknown names */
+		static bool parseFormat(const std::string& name, Format& format)
+		{
+			if (name == "png") {
+				format = Format::Png;
+			} else if (name == "qoi") {
+				format = Format::Qoi;
+			} else if (name == "raw") {
+				format = Format::Raw;
+			} else {
+				return false;
+			}
+			return true;
+		}
+
+		~FrameCapture()
+		{
+			destroy();
+		}
+
+		/**
+		* Creates the readback slots and starts the worker threads, readback buffers are allocated on first use
+		*
+		* @param vulkanDevice Device the captured images belong to
+		* @param queueFamilyIndex Queue family the copies are submitted to
+		* @param prefix File name prefix, frames are saved as <prefix><frame>.png/.qoi or appended to <prefix>.rgba
+		* @param format File format of the captured frames
+		* @param slotCount Number of frames that can be in flight between the GPU copy and the file being written
+		* @param workerCount Number of threads converting and saving frames (raw frames always use a single thread to keep them in order)
+		*/
+		void prepare(vks::VulkanDevice* vulkanDevice, uint32_t queueFamilyIndex, const std::string& prefix, Format format, uint32_t slotCount = 4, uint32_t workerCount = 2)
+		{
+			this->vulkanDevice = vulkanDevice;
+			this->prefix = prefix;
+			this->format = format;
+			VkDevice device = vulkanDevice->logicalDevice;
+
+			// Reading from uncached memory is very slow on the CPU, so prefer cached memory if available
+			memoryPropertyFlags = VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT;
+			for (uint32_t i = 0; i < vulkanDevice->memoryProperties.memoryTypeCount; i++) {
+				const VkMemoryPropertyFlags flags = vulkanDevice->memoryProperties.memoryTypes[i].propertyFlags;
+				if ((flags & (VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_CACHED_BIT)) == (VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_CACHED_BIT)) {
+					memoryPropertyFlags = VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_CACHED_BIT;
+					break;
+				}
+			}
+
+			VkCommandPoolCreateInfo commandPoolCI = vks::initializers::commandPoolCreateInfo();
+			commandPoolCI.queueFamilyIndex = queueFamilyIndex;
+			commandPoolCI.flags = VK_COMMAND_POOL_CREATE_RESET_COMMAND_BUFFER_BIT;
+			VK_CHECK_RESULT(vkCreateCommandPool(device, &commandPoolCI, nullptr, &commandPool));
+
+			slots = std::vector<Slot>(slotCount);
+			for (auto& slot : slots) {
+				VkCommandBufferAllocateInfo commandBufferAI = vks::initializers::commandBufferAllocateInfo(commandPool, VK_COMMAND_BUFFER_LEVEL_PRIMARY, 1);
+				VK_CHECK_RESULT(vkAllocateCommandBuffers(device, &commandBufferAI, &slot.commandBuffer));
+				VkFenceCreateInfo fenceCI = vks::initializers::fenceCreateInfo(VK_FENCE_CREATE_SIGNALED_BIT);
+				VK_CHECK_RESULT(vkCreateFence(device, &fenceCI, nullptr, &slot.fence));
+				VkSemaphoreCreateInfo semaphoreCI = vks::initializers::semaphoreCreateInfo();
+				VK_CHECK_RESULT(vkCreateSemaphore(device, &semaphoreCI, nullptr, &slot.semaphore));
+			}
+
+			if (format == Format::Raw) {
+				rawStream.open(prefix + ".rgba", std::ios::out | std::ios::binary);
+				if (!rawStream.is_open()) {
+					std::cerr << "Could not open \"" << prefix << ".rgba\" for writing captured frames\n";
+				}
+				workerCount = 1;
+			}
+			stopWorkers = false;
+			for (uint32_t i = 0; i < std::max(workerCount, 1u); i++) {
+				workers.push_back(std::thread(&FrameCapture::workerLoop, this));
+			}
+		}
+
+		/**
+		* Records and submits a copy of the image to the next readback slot, the results are saved in the background
+		* The image has to be in VK_IMAGE_LAYOUT_PRESENT_SRC_KHR (and is returned to it) and needs to support transfer source usage
+		*
+		* @param queue Queue to submit the copy to
+		* @param image Image to capture
+		* @param colorFormat Format of the image, see formatSupported
+		* @param waitSemaphore Semaphore signaled once rendering to the image has finished
+		*
+		* @return Semaphore signaled once the copy has finished, presentation needs to wait on this instead of waitSemaphore
+		*/
+		VkSemaphore capture(VkQueue queue, VkImage image, VkFormat colorFormat, uint32_t width, uint32_t height, VkSemaphore waitSemaphore)
+		{
+			collect(false);
+			Slot& slot = slots[nextSlot];
+			if (slot.state != SlotFree) {
+				// The workers are falling behind (or the ring is too small for the number of frames in flight)
+				auto tStart = std::chrono::high_resolution_clock::now();
+				while (slot.state == SlotCopying) {
+					collect(true);
+				}
+				std::unique_lock<std::mutex> lock(workMutex);
+				slotFreedCondition.wait(lock, [&slot] { return slot.state == SlotFree; });
+				statistics.stalls++;
+				statistics.stallTime += std::chrono::duration<double, std::milli>(std::chrono::high_resolution_clock::now() - tStart).count();
+			}
+
+			VkDevice device = vulkanDevice->logicalDevice;
+			const VkDeviceSize imageSize = (VkDeviceSize)width * height * 4;
+			if (slot.buffer.size < imageSize) {
+				slot.buffer.destroy();
+				VK_CHECK_RESULT(vulkanDevice->createBuffer(VK_BUFFER_USAGE_TRANSFER_DST_BIT, memoryPropertyFlags, &slot.buffer, imageSize));
+				VK_CHECK_RESULT(slot.buffer.map());
+			}
+			if ((format == Format::Raw) && ((width != rawWidth) || (height != rawHeight))) {
+				if (rawWidth != 0) {
+					std::cerr << "Frame size changed to " << width << "x" << height << " while capturing raw frames, the stream can't be played back in one go\n";
+				}
+				rawWidth = width;
+				rawHeight = height;
+			}
+			slot.width = width;
+			slot.height = height;
+			slot.swapRedBlue = (colorFormat == VK_FORMAT_B8G8R8A8_UNORM) || (colorFormat == VK_FORMAT_B8G8R8A8_SRGB);
+			slot.frameIndex = statistics.capturedFrames++;
+
+			const VkImageSubresourceRange subresourceRange = { VK_IMAGE_ASPECT_COLOR_BIT, 0, 1, 0, 1 };
+			VkCommandBufferBeginInfo commandBufferBI = vks::initializers::commandBufferBeginInfo();
+			commandBufferBI.flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT;
+			VK_CHECK_RESULT(vkBeginCommandBuffer(slot.commandBuffer, &commandBufferBI));
+			vks::tools::insertImageMemoryBarrier(slot.commandBuffer, image,
+				VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT, VK_ACCESS_TRANSFER_READ_BIT,
+				VK_IMAGE_LAYOUT_PRESENT_SRC_KHR, VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL,
+				VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT, VK_PIPELINE_STAGE_TRANSFER_BIT,
+				subresourceRange);
+			VkBufferImageCopy copyRegion{};
+			copyRegion.imageSubresource.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+			copyRegion.imageSubresource.layerCount = 1;
+			copyRegion.imageExtent = { width, height, 1 };
+			vkCmdCopyImageToBuffer(slot.commandBuffer, image, VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL, slot.buffer.buffer, 1, &copyRegion);
+			vks::tools::insertImageMemoryBarrier(slot.commandBuffer, image,
+				VK_ACCESS_TRANSFER_READ_BIT, 0,
+				VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL, VK_IMAGE_LAYOUT_PRESENT_SRC_KHR,
+				VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT,
+				subresourceRange);
+			// Make the copied data available to the host once the fence has signaled
+			VkBufferMemoryBarrier bufferBarrier = vks::initializers::bufferMemoryBarrier();
+			bufferBarrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+			bufferBarrier.dstAccessMask = VK_ACCESS_HOST_READ_BIT;
+			bufferBarrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+			bufferBarrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+			bufferBarrier.buffer = slot.buffer.buffer;
+			bufferBarrier.size = VK_WHOLE_SIZE;
+			vkCmdPipelineBarrier(slot.commandBuffer, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_HOST_BIT, 0, 0, nullptr, 1, &bufferBarrier, 0, nullptr);
+			VK_CHECK_RESULT(vkEndCommandBuffer(slot.commandBuffer));
+
+			VK_CHECK_RESULT(vkResetFences(device, 1, &slot.fence));
+			const VkPipelineStageFlags waitStageMask = VK_PIPELINE_STAGE_TRANSFER_BIT;
+			VkSubmitInfo submitInfo = vks::initializers::submitInfo();
+			submitInfo.waitSemaphoreCount = (waitSemaphore != VK_NULL_HANDLE) ? 1 : 0;
+			submitInfo.pWaitSemaphores = &waitSemaphore;
+			submitInfo.pWaitDstStageMask = &waitStageMask;
+			submitInfo.commandBufferCount = 1;
+			submitInfo.pCommandBuffers = &slot.commandBuffer;
+			submitInfo.signalSemaphoreCount = 1;
+			submitInfo.pSignalSemaphores = &slot.semaphore;
+			VK_CHECK_RESULT(vkQueueSubmit(queue, 1, &submitInfo, slot.fence));
+
+			slot.state = SlotCopying;
+			pendingSlots.push_back(nextSlot);
+			nextSlot = (nextSlot + 1) % static_cast<uint32_t>(slots.size());
+			return slot.semaphore;
+		}
+
+		/** @brief Waits until all captured frames have been saved */
+		void flush()
+		{
+			while (!pendingSlots.empty()) {
+				collect(true);
+			}
+			std::unique_lock<std::mutex> lock(workMutex);
+			slotFreedCondition.wait(lock, [this] {
+				for (auto& slot : slots) {
+					if (slot.state != SlotFree) {
+						return false;
+					}
+				}
+				return true;
+			});
+		}
+
+		/** @brief Saves all outstanding frames, stops the workers and releases the Vulkan resources */
+		void destroy()
+		{
+			if (!vulkanDevice) {
+				return;
+			}
+			flush();
+			{
+				std::lock_guard<std::mutex> lock(workMutex);
+				stopWorkers = true;
+			}
+			workCondition.notify_all();
+			for (auto& worker : workers) {
+				worker.join();
+			}
+			workers.clear();
+			if (rawStream.is_open()) {
+				rawStream.close();
+			}
+			VkDevice device = vulkanDevice->logicalDevice;
+			for (auto& slot : slots) {
+				slot.buffer.destroy();
+				vkDestroyFence(device, slot.fence, nullptr);
+				vkDestroySemaphore(device, slot.semaphore, nullptr);
+			}
+			slots.clear();
+			vkDestroyCommandPool(device, commandPool, nullptr);
+			commandPool = VK_NULL_HANDLE;
+			vulkanDevice = nullptr;
+		}
+
+		bool active() const
+		{
+			return vulkanDevice != nullptr;
+		}
+
+		Statistics getStatistics()
+		{
+			std::lock_guard<std::mutex> lock(workMutex);
+			return statistics;
+		}
+
+		/** @brief Prints where the frames went and whether capturing stalled the render loop */
+		void printSummary()
+		{
+			const Statistics stats = getStatistics();
+			if (format == Format::Raw) {
+				std::cout << "Saved " << stats.savedFrames << " frames to " << prefix << ".rgba (" << rawWidth << "x" << rawHeight << " RGBA, e.g. ffmpeg -f rawvideo -pixel_format rgba -video_size " << rawWidth << "x" << rawHeight << " -i " << prefix << ".rgba)\n";
+			} else {
+				std::cout << "Saved " << stats.savedFrames << " frames to " << prefix << "*" << ((format == Format::Png) ? ".png" : ".qoi") << "\n";
+			}
+			if (stats.savedFrames > 0) {
+				std::cout << "Average conversion and write time: " << stats.workerTime / stats.savedFrames << " ms/frame\n";
+			}
+			if (stats.stalls > 0) {
+				std::cout << "Capturing stalled " << stats.stalls << " frames for " << stats.stallTime << " ms in total, frame times were affected\n";
+			}
+		}
+	};
+}
@@ -4,12 +4,19 @@
 * Copyright (C) 2016 by Sascha Willems - www.saschawillems.de
 *
 * This code is licensed under the MIT license (MIT) (http://opensource.org/licenses/MIT)
+*
+* Boxes can be tested one at a time or four at once in structure of arrays layout using SSE2 or NEON
 */
 
+#pragma once
+
 #include <array>
+#include <stdint.h>
 #include <math.h>
 #include <glm/glm.hpp>
 
+#include "simd.hpp"
+
 namespace vks
 {
 	class Frustum
@@ -57,7 +64,7 @@ namespace vks
 			}
 		}
 		
-		bool checkSphere(glm::vec3 pos, float radius)
+		bool checkSphere(glm::vec3 pos, float radius) const
 		{
 			for (auto i = 0; i < planes.size(); i++)
 			{
@@ -68,5 +75,89 @@ namespace vks
 			}
 			return true;
 		}
+
+		/** @brief Returns true if the axis aligned box is at least partially inside of the frustum */
+		bool checkBox(const glm::vec3& min, const glm::vec3& max) const
+		{
+			for (size_t i = 0; i < planes.size(); i++)
+			{
+				// The box is outside if the corner furthest along the plane's normal is behind the plane
+				const float x = (planes[i].x >= 0.0f) ? max.x : min.x;
+				const float y = (planes[i].y >= 0.0f) ? max.y : min.y;
+				const float z = (planes[i].z >= 0.0f) ? max.z : min.z;
+				if ((planes[i].x * x) + (planes[i].y * y) + (planes[i].z * z) + planes[i].w < 0.0f)
+				{
+					return false;
+				}
+			}
+			return true;
+		}
+
+		/**
+		* Tests four axis aligned boxes stored in structure of arrays layout against all planes at once
+		*
+		* @param minX, minY, minZ, maxX, maxY, maxZ Four bounds per component
+		* @param insideMask (Optional) Receives a bit for every box that is completely inside of the frustum
+		*
+		* @return Bit mask with a bit set for every box that is at least partially inside of the frustum
+		*/
+		uint32_t checkBoxes4(const float* minX, const float* minY, const float* minZ, const float* maxX, const float* maxY, const float* maxZ, uint32_t* insideMask = nullptr) const
+		{
+#if defined(VKS_SIMD_SSE2) || defined(VKS_SIMD_NEON)
+			using namespace simd;
+			const float4 bMinX = load(minX), bMinY = load(minY), bMinZ = load(minZ);
+			const float4 bMaxX = load(maxX), bMaxY = load(maxY), bMaxZ = load(maxZ);
+			const float4 zero = set(0.0f);
+			uint32_t outside = 0;
+			uint32_t intersecting = 0;
+			for (size_t i = 0; i < planes.size(); i++)
+			{
+				const glm::vec4& plane = planes[i];
+				const float4 nx = set(plane.x), ny = set(plane.y), nz = set(plane.z), d = set(plane.w);
+				// The sign of the normal selects the same corners for all four boxes, p is furthest along the normal and q is opposite of it
+				const float4 px = (plane.x >= 0.0f) ? bMaxX : bMinX, qx = (plane.x >= 0.0f) ? bMinX : bMaxX;
+				const float4 py = (plane.y >= 0.0f) ? bMaxY : bMinY, qy = (plane.y >= 0.0f) ? bMinY : bMaxY;
+				const float4 pz = (plane.z >= 0.0f) ? bMaxZ : bMinZ, qz = (plane.z >= 0.0f) ? bMinZ : bMaxZ;
+				// Same order of operations as checkBox, so both give the same results
+				const float4 farDistance = add(add(add(mul(nx, px), mul(ny, py)), mul(nz, pz)), d);
+				const float4 nearDistance = add(add(add(mul(nx, qx), mul(ny, qy)), mul(nz, qz)), d);
+				outside |= less(farDistance, zero);
+				intersecting |= less(nearDistance, zero);
+			}
+			const uint32_t visible = ~outside & 0xF;
+			if (insideMask) {
+				*insideMask = visible & ~intersecting;
+			}
+			return visible;
+#else
+			uint32_t visible = 0;
+			uint32_t inside = 0;
+			for (uint32_t b = 0; b < 4; b++)
+			{
+				if (checkBox(glm::vec3(minX[b], minY[b], minZ[b]), glm::vec3(maxX[b], maxY[b], maxZ[b])))
+				{
+					visible |= 1u << b;
+					if (!insideMask) {
+						continue;
+					}
+					bool completelyInside = true;
+					for (size_t i = 0; i < planes.size(); i++)
+					{
+						const float x = (planes[i].x >= 0.0f) ? minX[b] : maxX[b];
+						const float y = (planes[i].y >= 0.0f) ? minY[b] : maxY[b];
+						const float z = (planes[i].z >= 0.0f) ? minZ[b] : maxZ[b];
+						completelyInside = completelyInside && ((planes[i].x * x) + (planes[i].y * y) + (planes[i].z * z) + planes[i].w >= 0.0f);
+					}
+					if (completelyInside) {
+						inside |= 1u << b;
+					}
+				}
+			}
+			if (insideMask) {
+				*insideMask = inside;
+			}
+			return visible;
+#endif
+		}
 	};
 }
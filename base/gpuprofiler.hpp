@@ -0,0 +1,350 @@
+/*
+* GPU profiler for named scopes in command buffers
+*
+* Scopes are tagged with beginScope/endScope while recording a command buffer and measured with timestamp queries
+* (and optionally pipeline statistics queries for top level scopes)
+* Every command buffer that contains scopes uses its own slot with separate queries. A slot's results are read back
+* right before the command buffer is submitted again, at which point its previous execution has finished, so reading
+* the queries never stalls. Submissions need to be reported with markSubmitted, so a re-recorded command buffer is only
+* read back once it has actually been executed. As most samples record their command buffers once per swap chain image, the results lag
+* behind by the number of swap chain images
+*
+* This code is licensed under the MIT license (MIT) (http://opensource.org/licenses/MIT)
+*/
+
+#pragma once
+
+#include <string.h>
+#include <vector>
+#include <string>
+#include <algorithm>
+#include <limits>
+#include <unordered_map>
+
+#include "vulkan/vulkan.h"
+#include "VulkanDevice.h"
+#include "VulkanTools.h"
+#include "VulkanUIOverlay.h"
+
+namespace vks
+{
+	class GpuProfiler
+	{
+	public:
+		static const uint32_t statisticsCount = 4;
+		static const uint32_t historySize = 64;
+
+		/** @brief Timings of a named scope, combined for all command buffers the scope has been recorded to */
+		struct Scope {
+			std::string name;
+			uint32_t depth = 0;
+			/** @brief Average over the last historySize samples in ms */
+			double average = 0.0;
+			double min = std::numeric_limits<double>::max();
+			double max = 0.0;
+			double total = 0.0;
+			uint64_t count = 0;
+			/** @brief Pipeline statistics of the last sample (only for top level scopes if supported by the device) */
+			bool hasStatistics = false;
+			uint64_t statistics[statisticsCount] = { 0, 0, 0, 0 };
+			std::vector<double> history;
+			uint32_t historyIndex = 0;
+		};
+
+	private:
+		// A scope instance recorded to the command buffer of a slot
+		struct RecordedScope {
+			uint32_t scope;
+			uint32_t timestampQuery;
+			int32_t statisticsQuery = -1;
+		};
+
+		struct Slot {
+			VkQueryPool timestampPool = VK_NULL_HANDLE;
+			VkQueryPool statisticsPool = VK_NULL_HANDLE;
+			std::vector<RecordedScope> recordedScopes;
+			// Indices of the recorded scopes that have not been ended yet
+			std::vector<uint32_t> openScopes;
+			uint32_t statisticsQueryCount = 0;
+			// Scopes that exceeded maxScopes and are not measured
+			uint32_t droppedScopes = 0;
+			// Set when the command buffer has been (re-)recorded but not submitted since, its queries still hold the results of the previous recording
+			bool recordedNotExecuted = false;
+		};
+
+		VkDevice device = VK_NULL_HANDLE;
+		bool timestampsSupported = false;
+		bool statisticsSupported = false;
+		uint64_t timestampMask = ~0ULL;
+		float timestampPeriod = 1.0f;
+		uint32_t maxScopes = 0;
+		std::vector<Slot> slots;
+		std::vector<Scope> scopes;
+		std::unordered_map<std::string, uint32_t> scopeIndices;
+		// Slot a command buffer is currently being recorded for
+		std::unordered_map<VkCommandBuffer, uint32_t> recordingSlots;
+		std::vector<uint64_t> queryResults;
+
+		Slot* getRecordingSlot(VkCommandBuffer commandBuffer)
+		{
+			auto it = recordingSlots.find(commandBuffer);
+			return (it != recordingSlots.end()) ? &slots[it->second] : nullptr;
+		}
+
+		uint32_t getScopeIndex(const std::string& name, uint32_t depth)
+		{
+			auto it = scopeIndices.find(name);
+			if (it != scopeIndices.end()) {
+				return it->second;
+			}
+			Scope scope;
+			scope.name = name;
+			scope.depth = depth;
+			scope.history.reserve(historySize);
+			scopes.push_back(scope);
+			scopeIndices[name] = static_cast<uint32_t>(scopes.size() - 1);
+			return static_cast<uint32_t>(scopes.size() - 1);
+		}
+
+		void addSample(Scope& scope, double time)
+		{
+			if (scope.history.size() < historySize) {
+				scope.history.push_back(time);
+			} else {
+				scope.history[scope.historyIndex] = time;
+			}
+			scope.historyIndex = (scope.historyIndex + 1) % historySize;
+			double sum = 0.0;
+			for (auto value : scope.history) {
+				sum += value;
+			}
+			scope.average = sum / (double)scope.history.size();
+			scope.min = std::min(scope.min, time);
+			scope.max = std::max(scope.max, time);
+			scope.total += time;
+			scope.count++;
+		}
+
+	public:
+		/**
+		* Checks for timestamp and pipeline statistics support, query pools for the slots are created on first use
+		*
+		* @param vulkanDevice Device the command buffers are recorded for
+		* @param queueFamilyIndex Queue family the command buffers are submitted to
+		* @param maxScopes Maximum number of scopes per command buffer
+		*/
+		void prepare(vks::VulkanDevice* vulkanDevice, uint32_t queueFamilyIndex, uint32_t maxScopes = 32)
+		{
+			device = vulkanDevice->logicalDevice;
+			this->maxScopes = maxScopes;
+			const uint32_t timestampValidBits = vulkanDevice->queueFamilyProperties[queueFamilyIndex].timestampValidBits;
+			timestampsSupported = (timestampValidBits > 0) && (vulkanDevice->properties.limits.timestampPeriod > 0.0f);
+			timestampMask = (timestampValidBits >= 64) ? ~0ULL : ((1ULL << timestampValidBits) - 1);
+			timestampPeriod = vulkanDevice->properties.limits.timestampPeriod;
+			// Pipeline statistics need to be enabled by the sample (enabledFeatures.pipelineStatisticsQuery)
+			statisticsSupported = timestampsSupported && vulkanDevice->enabledFeatures.pipelineStatisticsQuery;
+			queryResults.resize(maxScopes * 2 * statisticsCount);
+		}
+
+		/** @brief Destroys the query pools of all slots, device must be idle */
+		void destroy()
+		{
+			for (auto& slot : slots) {
+				if (slot.timestampPool != VK_NULL_HANDLE) {
+					vkDestroyQueryPool(device, slot.timestampPool, nullptr);
+				}
+				if (slot.statisticsPool != VK_NULL_HANDLE) {
+					vkDestroyQueryPool(device, slot.statisticsPool, nullptr);
+				}
+			}
+			slots.clear();
+			recordingSlots.clear();
+		}
+
+		bool supported() const
+		{
+			return timestampsSupported;
+		}
+
+		/**
+		* Starts recording scopes to a command buffer, needs to be called outside of a render pass
+		*
+		* @param commandBuffer Command buffer that the scopes will be recorded to
+		* @param slot Slot for the command buffer, e.g. the index into drawCmdBuffers. Command buffers that may be pending execution at the same time must use different slots
+		*/
+		void beginFrame(VkCommandBuffer commandBuffer, uint32_t slot)
+		{
+			if (!timestampsSupported) {
+				return;
+			}
+			if (slot >= slots.size()) {
+				slots.resize(slot + 1);
+			}
+			Slot& frameSlot = slots[slot];
+			if (frameSlot.timestampPool == VK_NULL_HANDLE) {
+				VkQueryPoolCreateInfo queryPoolInfo{};
+				queryPoolInfo.sType = VK_STRUCTURE_TYPE_QUERY_POOL_CREATE_INFO;
+				queryPoolInfo.queryType = VK_QUERY_TYPE_TIMESTAMP;
+				queryPoolInfo.queryCount = maxScopes * 2;
+				VK_CHECK_RESULT(vkCreateQueryPool(device, &queryPoolInfo, nullptr, &frameSlot.timestampPool));
+				if (statisticsSupported) {
+					queryPoolInfo.queryType = VK_QUERY_TYPE_PIPELINE_STATISTICS;
+					queryPoolInfo.queryCount = maxScopes;
+					queryPoolInfo.pipelineStatistics =
+						VK_QUERY_PIPELINE_STATISTIC_VERTEX_SHADER_INVOCATIONS_BIT |
+						VK_QUERY_PIPELINE_STATISTIC_CLIPPING_PRIMITIVES_BIT |
+						VK_QUERY_PIPELINE_STATISTIC_FRAGMENT_SHADER_INVOCATIONS_BIT |
+						VK_QUERY_PIPELINE_STATISTIC_COMPUTE_SHADER_INVOCATIONS_BIT;
+					VK_CHECK_RESULT(vkCreateQueryPool(device, &queryPoolInfo, nullptr, &frameSlot.statisticsPool));
+				}
+			}
+			vkCmdResetQueryPool(commandBuffer, frameSlot.timestampPool, 0, maxScopes * 2);
+			if (frameSlot.statisticsPool != VK_NULL_HANDLE) {
+				vkCmdResetQueryPool(commandBuffer, frameSlot.statisticsPool, 0, maxScopes);
+			}
+			frameSlot.recordedScopes.clear();
+			frameSlot.openScopes.clear();
+			frameSlot.statisticsQueryCount = 0;
+			frameSlot.droppedScopes = 0;
+			frameSlot.recordedNotExecuted = true;
+			recordingSlots[commandBuffer] = slot;
+		}
+
+		/**
+		* Begins a named scope, scopes can be nested
+		* Pipeline statistics are only collected for top level scopes, which must either contain whole render passes or stay within a single subpass
+		*/
+		void beginScope(VkCommandBuffer commandBuffer, const std::string& name)
+		{
+			Slot* slot = getRecordingSlot(commandBuffer);
+			if (!slot) {
+				return;
+			}
+			if (slot->recordedScopes.size() >= maxScopes) {
+				slot->droppedScopes++;
+				return;
+			}
+			RecordedScope recordedScope;
+			recordedScope.scope = getScopeIndex(name, static_cast<uint32_t>(slot->openScopes.size()));
+			recordedScope.timestampQuery = static_cast<uint32_t>(slot->recordedScopes.size()) * 2;
+			vkCmdWriteTimestamp(commandBuffer, VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT, slot->timestampPool, recordedScope.timestampQuery);
+			if ((slot->statisticsPool != VK_NULL_HANDLE) && slot->openScopes.empty()) {
+				recordedScope.statisticsQuery = static_cast<int32_t>(slot->statisticsQueryCount++);
+				vkCmdBeginQuery(commandBuffer, slot->statisticsPool, recordedScope.statisticsQuery, 0);
+			}
+			slot->openScopes.push_back(static_cast<uint32_t>(slot->recordedScopes.size()));
+			slot->recordedScopes.push_back(recordedScope);
+		}
+
+		/** @brief Ends the last scope started in this command buffer */
+		void endScope(VkCommandBuffer commandBuffer)
+		{
+			Slot* slot = getRecordingSlot(commandBuffer);
+			if (!slot) {
+				return;
+			}
+			if (slot->droppedScopes > 0) {
+				slot->droppedScopes--;
+				return;
+			}
+			if (slot->openScopes.empty()) {
+				return;
+			}
+			const RecordedScope& recordedScope = slot->recordedScopes[slot->openScopes.back()];
+			slot->openScopes.pop_back();
+			if (recordedScope.statisticsQuery > -1) {
+				vkCmdEndQuery(commandBuffer, slot->statisticsPool, recordedScope.statisticsQuery);
+			}
+			vkCmdWriteTimestamp(commandBuffer, VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT, slot->timestampPool, recordedScope.timestampQuery + 1);
+		}
+
+		/**
+		* Reads back the results of the last execution of a slot's command buffer without waiting for them
+		* Call once before every submission of the slot's command buffer (once its previous submission has completed)
+		* Nothing is read while the slot's command buffer has been re-recorded but not submitted (see markSubmitted), as the queries
+		* would still contain the results of the previous recording, which don't match the new scope layout
+		*/
+		void resolve(uint32_t slot)
+		{
+			if ((slot >= slots.size()) || slots[slot].recordedScopes.empty() || slots[slot].recordedNotExecuted) {
+				return;
+			}
+			Slot& frameSlot = slots[slot];
+			const uint32_t queryCount = static_cast<uint32_t>(frameSlot.recordedScopes.size()) * 2;
+			// Results are not available if the command buffer has not been executed since it was recorded
+			if (vkGetQueryPoolResults(device, frameSlot.timestampPool, 0, queryCount, queryCount * sizeof(uint64_t), queryResults.data(), sizeof(uint64_t), VK_QUERY_RESULT_64_BIT) != VK_SUCCESS) {
+				return;
+			}
+			for (auto& recordedScope : frameSlot.recordedScopes) {
+				const uint64_t ticks = (queryResults[recordedScope.timestampQuery + 1] - queryResults[recordedScope.timestampQuery]) & timestampMask;
+				addSample(scopes[recordedScope.scope], (double)ticks * (double)timestampPeriod / 1000000.0);
+			}
+			if (frameSlot.statisticsQueryCount > 0) {
+				const uint32_t statisticsStride = statisticsCount * sizeof(uint64_t);
+				if (vkGetQueryPoolResults(device, frameSlot.statisticsPool, 0, frameSlot.statisticsQueryCount, frameSlot.statisticsQueryCount * statisticsStride, queryResults.data(), statisticsStride, VK_QUERY_RESULT_64_BIT) == VK_SUCCESS) {
+					for (auto& recordedScope : frameSlot.recordedScopes) {
+						if (recordedScope.statisticsQuery > -1) {
+							Scope& scope = scopes[recordedScope.scope];
+							scope.hasStatistics = true;
+							memcpy(scope.statistics, &queryResults[recordedScope.statisticsQuery * statisticsCount], statisticsStride);
+						}
+					}
+				}
+			}
+		}
+
+		/** @brief Marks the slot's command buffer as submitted, so the next resolve reads the results of this recording */
+		void markSubmitted(uint32_t slot)
+		{
+			if (slot < slots.size()) {
+				slots[slot].recordedNotExecuted = false;
+			}
+		}
+
+		/** @brief Name of a pipeline statistic, in the order the statistics are stored in a scope */
+		static const char* getStatisticName(uint32_t index)
+		{
+			static const char* names[statisticsCount] = { "VS invocations", "Clipping primitives", "FS invocations", "CS invocations" };
+			return names[index];
+		}
+
+		const std::vector<Scope>& getScopes() const
+		{
+			return scopes;
+		}
+
+		/** @brief Clears the accumulated timings of all scopes (e.g. after a warm up phase) */
+		void resetStatistics()
+		{
+			for (auto& scope : scopes) {
+				scope.average = 0.0;
+				scope.min = std::numeric_limits<double>::max();
+				scope.max = 0.0;
+				scope.total = 0.0;
+				scope.count = 0;
+				scope.history.clear();
+				scope.historyIndex = 0;
+			}
+		}
+
+		/** @brief Adds the per scope breakdown to the UI overlay */
+		void drawUI(vks::UIOverlay* overlay)
+		{
+			if (scopes.empty()) {
+				return;
+			}
+			if (overlay->header("GPU timings")) {
+				for (auto& scope : scopes) {
+					overlay->text("%*s%s: %.3f ms", scope.depth * 2, "", scope.name.c_str(), scope.average);
+					if (scope.hasStatistics) {
+						for (uint32_t i = 0; i < statisticsCount; i++) {
+							if (scope.statistics[i] > 0) {
+								overlay->text("%*s%s: %llu", scope.depth * 2 + 2, "", getStatisticName(i), (unsigned long long)scope.statistics[i]);
+							}
+						}
+					}
+				}
+			}
+		}
+	};
+}
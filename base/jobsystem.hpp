@@ -0,0 +1,489 @@
+/*
+* Work stealing job system
+*
+* Each worker thread owns a lock-free Chase-Lev deque: the owner pushes and pops jobs at the bottom,
+* idle workers steal from the top of other workers' deques. Jobs store their callable in place, so
+* scheduling a job does not allocate. Completion is tracked with counters that can also be used to
+* start jobs once other jobs have finished.
+*
+* This code is licensed under the MIT license (MIT) (http://opensource.org/licenses/MIT)
+*/
+
+#pragma once
+
+#include <atomic>
+#include <vector>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <memory>
+#include <new>
+#include <type_traits>
+#include <algorithm>
+#include <stdexcept>
+#include <assert.h>
+#include <stdint.h>
+
+namespace vks
+{
+	class JobSystem;
+	struct JobCounter;
+
+	// Jobs are sized to fill a cache line, the callable (including its captures) has to fit into the remaining storage
+	// The function is reset once the job has finished, which marks its slot in the job pool as free again
+	struct Job
+	{
+		static const size_t dataSize = 48;
+		std::atomic<void (*)(Job*)> function{ nullptr };
+		JobCounter* counter = nullptr;
+		std::aligned_storage<dataSize, 16>::type data;
+	};
+
+	// Counts the jobs that have not yet finished
+	// Jobs added with JobSystem::runAfter are started once the counter drops to zero
+	struct JobCounter
+	{
+		std::atomic<uint32_t> pending{ 0 };
+		// Protected by the job system's continuation mutex
+		std::vector<Job*> continuations;
+
+		bool done() const
+		{
+			return pending.load(std::memory_order_acquire) == 0;
+		}
+	};
+
+	// Fixed size Chase-Lev work stealing deque ("Correct and Efficient Work-Stealing for Weak Memory Models", Lê et al.)
+	// push and pop may only be called by the owning thread, steal may be called from any thread
+	class WorkStealingDeque
+	{
+	private:
+		std::atomic<int64_t> top{ 0 };
+		// Keep the owner's index on a separate cache line from the index thieves write to
+		char padding[64 - sizeof(std::atomic<int64_t>)];
+		std::atomic<int64_t> bottom{ 0 };
+		std::vector<std::atomic<Job*>> buffer;
+		int64_t mask;
+	public:
+		explicit WorkStealingDeque(uint32_t capacity) : buffer(capacity), mask((int64_t)capacity - 1)
+		{
+			// Capacity needs to be a power of two
+			assert((capacity & (capacity - 1)) == 0);
+		}
+
+		// Returns false if the deque is full
+		bool push(Job* job)
+		{
+			int64_t b = bottom.load(std::memory_order_relaxed);
+			int64_t t = top.load(std::memory_order_acquire);
+			if (b - t > mask) {
+				return false;
+			}
+			buffer[b & mask].store(job, std::memory_order_release);
+			std::atomic_thread_fence(std::memory_order_release);
+			bottom.store(b + 1, std::memory_order_relaxed);
+			return true;
+		}
+
+		Job* pop()
+		{
+			int64_t b = bottom.load(std::memory_order_relaxed) - 1;
+			bottom.store(b, std::memory_order_relaxed);
+			std::atomic_thread_fence(std::memory_order_seq_cst);
+			int64_t t = top.load(std::memory_order_relaxed);
+			if (t > b) {
+				// Deque was already empty
+				bottom.store(b + 1, std::memory_order_relaxed);
+				return nullptr;
+			}
+			Job* job = buffer[b & mask].load(std::memory_order_relaxed);
+			if (t == b) {
+				// Last job, race against thieves for it
+				if (!top.compare_exchange_strong(t, t + 1, std::memory_order_seq_cst, std::memory_order_relaxed)) {
+					job = nullptr;
+				}
+				bottom.store(b + 1, std::memory_order_relaxed);
+			}
+			return job;
+		}
+
+		Job* steal()
+		{
+			int64_t t = top.load(std::memory_order_acquire);
+			std::atomic_thread_fence(std::memory_order_seq_cst);
+			int64_t b = bottom.load(std::memory_order_acquire);
+			if (t >= b) {
+				return nullptr;
+			}
+			Job* job = buffer[t & mask].load(std::memory_order_acquire);
+			if (!top.compare_exchange_strong(t, t + 1, std::memory_order_seq_cst, std::memory_order_relaxed)) {
+				// Lost the race against another thief or the owner
+				return nullptr;
+			}
+			return job;
+		}
+	};
+
+	class JobSystem
+	{
+	private:
+		struct Worker
+		{
+			WorkStealingDeque deque;
+			// Jobs are taken from a ring buffer, a slot may only be reused once its job has finished (busy slots are skipped in favor of a heap allocated job)
+			std::vector<Job> jobPool;
+			uint32_t allocatedJobs = 0;
+			uint32_t stealSeed;
+			std::thread thread;
+			Worker(uint32_t maxJobs, uint32_t seed) : deque(maxJobs), jobPool(maxJobs), stealSeed(seed) {}
+		};
+
+		std::vector<std::unique_ptr<Worker>> workers;
+		std::atomic<bool> stopping{ false };
+		// Number of jobs that have been pushed but not yet taken, used to put idle workers to sleep
+		std::atomic<int32_t> queuedJobs{ 0 };
+		std::atomic<int32_t> sleepingWorkers{ 0 };
+		std::mutex sleepMutex;
+		std::condition_variable sleepCondition;
+		// Guards the continuation lists of all counters, only taken for the last job of a counter and by runAfter
+		std::mutex continuationMutex;
+		uint32_t maxJobsPerWorker = 4096;
+		// Identifies this job system (and each restart of it) in the per-thread worker slot lists
+		uint32_t instanceId = 0;
+
+		struct WorkerSlot
+		{
+			uint32_t instanceId;
+			int index;
+		};
+
+		// A thread can be a worker of several job systems (e.g. a worker of one system that schedules jobs on another), so the slot is stored per job system
+		static std::vector<WorkerSlot>& workerSlots()
+		{
+			static thread_local std::vector<WorkerSlot> slots;
+			return slots;
+		}
+
+		int currentWorkerIndex() const
+		{
+			for (const WorkerSlot& slot : workerSlots()) {
+				if (slot.instanceId == instanceId) {
+					return slot.index;
+				}
+			}
+			return -1;
+		}
+
+		void setCurrentWorkerIndex(int index)
+		{
+			workerSlots().push_back({ instanceId, index });
+		}
+
+		Worker& currentWorker()
+		{
+			int index = currentWorkerIndex();
+			if (index < 0) {
+				// Slot 0 is the owner end of a single deque that belongs to the thread that started the job system, any other outside thread would race with it
+				throw std::runtime_error("Only the thread that started the job system and its workers may schedule jobs");
+			}
+			assert(index < (int)workers.size());
+			return *workers[index];
+		}
+
+		template<typename F>
+		static void invoke(Job* job)
+		{
+			F* function = reinterpret_cast<F*>(&job->data);
+			(*function)();
+			function->~F();
+		}
+
+		template<typename F>
+		Job* allocateJob(F&& function, JobCounter* counter)
+		{
+			typedef typename std::decay<F>::type Function;
+			static_assert(sizeof(Function) <= Job::dataSize, "Job captures too much data, capture by reference or pointer instead");
+			static_assert(alignof(Function) <= 16, "Job callable is over-aligned");
+			Worker& worker = currentWorker();
+			Job* job = &worker.jobPool[worker.allocatedJobs++ & (maxJobsPerWorker - 1)];
+			// With more jobs in flight than the pool holds, the slot may still be queued or running. Waiting for it could deadlock
+			// if that job is further up the calling thread's stack (e.g. a parent of the job that schedules), so take one from the heap instead
+			if (job->function.load(std::memory_order_acquire) != nullptr) {
+				job = new Job();
+			}
+			new (&job->data) Function(std::forward<F>(function));
+			job->function.store(&invoke<Function>, std::memory_order_relaxed);
+			job->counter = counter;
+			return job;
+		}
+
+		// Jobs that did not fit into the ring of the scheduling thread are allocated on the heap
+		bool isPooled(const Job* job) const
+		{
+			for (const auto& worker : workers) {
+				const Job* pool = worker->jobPool.data();
+				if ((job >= pool) && (job < pool + worker->jobPool.size())) {
+					return true;
+				}
+			}
+			return false;
+		}
+
+		void push(Job* job)
+		{
+			Worker& worker = currentWorker();
+			if (!worker.deque.push(job)) {
+				// Deque is full, so run the job right away instead of queueing it
+				execute(job);
+				return;
+			}
+			queuedJobs.fetch_add(1, std::memory_order_seq_cst);
+			if (sleepingWorkers.load(std::memory_order_seq_cst) > 0) {
+				std::lock_guard<std::mutex> lock(sleepMutex);
+				sleepCondition.notify_one();
+			}
+		}
+
+		void finish(JobCounter* counter)
+		{
+			if (!counter) {
+				return;
+			}
+			uint32_t pending = counter->pending.load(std::memory_order_relaxed);
+			while (pending > 1) {
+				if (counter->pending.compare_exchange_weak(pending, pending - 1, std::memory_order_acq_rel, std::memory_order_relaxed)) {
+					return;
+				}
+			}
+			// Possibly the last job for this counter: take the continuations before the counter reaches zero,
+			// as a waiting thread may destroy the counter right after that
+			std::vector<Job*> continuations;
+			{
+				std::lock_guard<std::mutex> lock(continuationMutex);
+				continuations.swap(counter->continuations);
+				if (counter->pending.fetch_sub(1, std::memory_order_acq_rel) != 1) {
+					// New jobs were added to the counter in the meantime
+					counter->continuations.swap(continuations);
+					return;
+				}
+			}
+			for (auto continuation : continuations) {
+				push(continuation);
+			}
+		}
+
+		void execute(Job* job)
+		{
+			JobCounter* counter = job->counter;
+			job->function.load(std::memory_order_relaxed)(job);
+			// The slot may be reused as soon as it has been released, so the counter is taken before
+			if (isPooled(job)) {
+				job->function.store(nullptr, std::memory_order_release);
+			} else {
+				delete job;
+			}
+			finish(counter);
+		}
+
+		Job* findJob(Worker& worker)
+		{
+			Job* job = worker.deque.pop();
+			if (job) {
+				return job;
+			}
+			// Own deque is empty, try to steal from the others starting at a random victim
+			uint32_t workerCount = (uint32_t)workers.size();
+			worker.stealSeed = worker.stealSeed * 1664525u + 1013904223u;
+			uint32_t start = (worker.stealSeed >> 8) % workerCount;
+			for (uint32_t i = 0; i < workerCount; i++) {
+				Worker& victim = *workers[(start + i) % workerCount];
+				if (&victim == &worker) {
+					continue;
+				}
+				job = victim.deque.steal();
+				if (job) {
+					return job;
+				}
+			}
+			return nullptr;
+		}
+
+		// Takes a job from any deque and runs it, returns false if there was no work
+		bool runPendingJob()
+		{
+			Job* job = findJob(currentWorker());
+			if (!job) {
+				return false;
+			}
+			queuedJobs.fetch_sub(1, std::memory_order_relaxed);
+			execute(job);
+			return true;
+		}
+
+		void workerLoop(int index)
+		{
+			setCurrentWorkerIndex(index);
+			uint32_t idleSpins = 0;
+			while (!stopping.load(std::memory_order_acquire)) {
+				if (runPendingJob()) {
+					idleSpins = 0;
+					continue;
+				}
+				// Spin a little before going to sleep, new jobs usually arrive in bursts
+				if (++idleSpins < 64) {
+					std::this_thread::yield();
+					continue;
+				}
+				std::unique_lock<std::mutex> lock(sleepMutex);
+				sleepingWorkers.fetch_add(1, std::memory_order_seq_cst);
+				sleepCondition.wait(lock, [this] { return (queuedJobs.load(std::memory_order_seq_cst) > 0) || stopping.load(std::memory_order_acquire); });
+				sleepingWorkers.fetch_sub(1, std::memory_order_seq_cst);
+				idleSpins = 0;
+			}
+		}
+
+	public:
+		JobSystem() = default;
+		JobSystem(const JobSystem&) = delete;
+		JobSystem& operator=(const JobSystem&) = delete;
+
+		~JobSystem()
+		{
+			shutdown();
+		}
+
+		/**
+		* Starts the worker threads
+		* Worker slot 0 is not backed by a thread of its own: it belongs to the calling thread (usually the render thread), which executes jobs while
+		* waiting. Scheduling from any other outside thread throws, as it would race on the owner end of that slot's deque (see canSchedule)
+		*
+		* @param threadCount Total number of threads including the calling thread, 0 uses all hardware threads
+		* @param maxJobs Number of jobs a single thread can have in flight (must be a power of two), beyond that jobs are allocated on the heap
+		*/
+		void start(uint32_t threadCount = 0, uint32_t maxJobs = 4096)
+		{
+			assert(workers.empty());
+			assert((maxJobs & (maxJobs - 1)) == 0);
+			if (threadCount == 0) {
+				threadCount = std::max(std::thread::hardware_concurrency(), 1u);
+			}
+			static std::atomic<uint32_t> nextInstanceId{ 1 };
+			instanceId = nextInstanceId.fetch_add(1);
+			maxJobsPerWorker = maxJobs;
+			stopping = false;
+			for (uint32_t i = 0; i < threadCount; i++) {
+				workers.push_back(std::unique_ptr<Worker>(new Worker(maxJobsPerWorker, 2654435761u * (i + 1))));
+			}
+			setCurrentWorkerIndex(0);
+			for (uint32_t i = 1; i < threadCount; i++) {
+				workers[i]->thread = std::thread(&JobSystem::workerLoop, this, (int)i);
+			}
+		}
+
+		/** @brief Stops and joins all worker threads, all jobs must have finished */
+		void shutdown()
+		{
+			if (workers.empty()) {
+				return;
+			}
+			{
+				std::lock_guard<std::mutex> lock(sleepMutex);
+				stopping = true;
+			}
+			sleepCondition.notify_all();
+			for (auto& worker : workers) {
+				if (worker->thread.joinable()) {
+					worker->thread.join();
+				}
+			}
+			workers.clear();
+			// Usually called by the owning thread, so drop its slot right away instead of keeping a stale entry around
+			std::vector<WorkerSlot>& slots = workerSlots();
+			slots.erase(std::remove_if(slots.begin(), slots.end(), [this](const WorkerSlot& slot) { return slot.instanceId == instanceId; }), slots.end());
+		}
+
+		/** @brief Number of threads executing jobs (including the thread that started the job system) */
+		uint32_t threadCount() const
+		{
+			return (uint32_t)workers.size();
+		}
+
+		/** @brief True if the calling thread may schedule jobs, which is the thread that started the job system and the worker threads */
+		bool canSchedule() const
+		{
+			return currentWorkerIndex() >= 0;
+		}
+
+		/** @brief Index of the calling worker of this job system in [0, threadCount()), can be used to address per-thread data from inside of jobs */
+		uint32_t threadIndex() const
+		{
+			int index = currentWorkerIndex();
+			assert(index >= 0 && "Calling thread is not a worker of this job system");
+			return (uint32_t)index;
+		}
+
+		/** @brief Schedules a job, the counter (optional) is decremented once it has finished */
+		template<typename F>
+		void run(F&& function, JobCounter* counter = nullptr)
+		{
+			if (counter) {
+				counter->pending.fetch_add(1, std::memory_order_relaxed);
+			}
+			push(allocateJob(std::forward<F>(function), counter));
+		}
+
+		/** @brief Schedules a job that is started once all jobs tracked by the dependency counter have finished */
+		template<typename F>
+		void runAfter(JobCounter& dependency, F&& function, JobCounter* counter = nullptr)
+		{
+			if (counter) {
+				counter->pending.fetch_add(1, std::memory_order_relaxed);
+			}
+			Job* job = allocateJob(std::forward<F>(function), counter);
+			{
+				std::lock_guard<std::mutex> lock(continuationMutex);
+				if (!dependency.done()) {
+					dependency.continuations.push_back(job);
+					return;
+				}
+			}
+			push(job);
+		}
+
+		/** @brief Waits for all jobs tracked by the counter, the calling thread executes other jobs in the meantime */
+		void wait(const JobCounter& counter)
+		{
+			while (!counter.done()) {
+				if (!runPendingJob()) {
+					std::this_thread::yield();
+				}
+			}
+		}
+
+		/**
+		* Splits [0, count) into ranges of at most grainSize elements and calls function(begin, end) for each of them in parallel
+		* Returns once all ranges have been processed
+		*/
+		template<typename F>
+		void parallelFor(uint32_t count, uint32_t grainSize, const F& function)
+		{
+			if (count == 0) {
+				return;
+			}
+			grainSize = std::max(grainSize, 1u);
+			if (count <= grainSize || workers.size() < 2) {
+				function(0u, count);
+				return;
+			}
+			JobCounter counter;
+			const F* f = &function;
+			// The first range is run on the calling thread after all others have been queued
+			for (uint32_t begin = grainSize; begin < count; begin += grainSize) {
+				uint32_t end = std::min(begin + grainSize, count);
+				run([f, begin, end] { (*f)(begin, end); }, &counter);
+			}
+			function(0u, grainSize);
+			wait(counter);
+		}
+	};
+}
@@ -0,0 +1,151 @@
+/*
+* Read-only memory mapped file
+*
+* Gives direct access to a file's contents without copying it into a heap allocation first
+* Pages are loaded on demand by the operating system and can be dropped again under memory pressure
+*
+* This code is licensed under the MIT license (MIT) (http://opensource.org/licenses/MIT)
+*/
+
+#pragma once
+
+#include <string>
+#include <stdint.h>
+
+#if defined(_WIN32)
+#ifndef NOMINMAX
+#define NOMINMAX
+#endif
+#include <windows.h>
+#elif defined(__ANDROID__)
+#include <android/asset_manager.h>
+#include "VulkanAndroid.h"
+#else
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <unistd.h>
+#endif
+
+namespace vks
+{
+	class MappedFile
+	{
+	private:
+		const uint8_t* mappedData = nullptr;
+		size_t mappedSize = 0;
+#if defined(_WIN32)
+		HANDLE fileHandle = INVALID_HANDLE_VALUE;
+		HANDLE mappingHandle = nullptr;
+#elif defined(__ANDROID__)
+		AAsset* asset = nullptr;
+#endif
+	public:
+		MappedFile() = default;
+		MappedFile(const MappedFile&) = delete;
+		MappedFile& operator=(const MappedFile&) = delete;
+
+		~MappedFile()
+		{
+			close();
+		}
+
+		/**
+		* Maps the whole file into the address space of the process
+		* On Android the file is read from the apk's assets, uncompressed assets are mapped directly
+		*
+		* @return True if the file could be opened and mapped, false otherwise (e.g. the file doesn't exist or is empty)
+		*/
+		bool open(const std::string& filename)
+		{
+			close();
+#if defined(_WIN32)
+			fileHandle = CreateFileA(filename.c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL | FILE_FLAG_SEQUENTIAL_SCAN, nullptr);
+			if (fileHandle == INVALID_HANDLE_VALUE) {
+				return false;
+			}
+			LARGE_INTEGER fileSize;
+			if (!GetFileSizeEx(fileHandle, &fileSize) || (fileSize.QuadPart == 0)) {
+				close();
+				return false;
+			}
+			mappingHandle = CreateFileMappingA(fileHandle, nullptr, PAGE_READONLY, 0, 0, nullptr);
+			if (!mappingHandle) {
+				close();
+				return false;
+			}
+			mappedData = static_cast<const uint8_t*>(MapViewOfFile(mappingHandle, FILE_MAP_READ, 0, 0, 0));
+			mappedSize = static_cast<size_t>(fileSize.QuadPart);
+#elif defined(__ANDROID__)
+			asset = AAssetManager_open(androidApp->activity->assetManager, filename.c_str(), AASSET_MODE_BUFFER);
+			if (!asset) {
+				return false;
+			}
+			mappedData = static_cast<const uint8_t*>(AAsset_getBuffer(asset));
+			mappedSize = static_cast<size_t>(AAsset_getLength(asset));
+#else
+			int fd = ::open(filename.c_str(), O_RDONLY);
+			if (fd < 0) {
+				return false;
+			}
+			struct stat fileStat;
+			if ((fstat(fd, &fileStat) != 0) || (fileStat.st_size == 0)) {
+				::close(fd);
+				return false;
+			}
+			void* data = mmap(nullptr, static_cast<size_t>(fileStat.st_size), PROT_READ, MAP_PRIVATE, fd, 0);
+			// The mapping stays valid after closing the descriptor
+			::close(fd);
+			if (data == MAP_FAILED) {
+				return false;
+			}
+			mappedData = static_cast<const uint8_t*>(data);
+			mappedSize = static_cast<size_t>(fileStat.st_size);
+#endif
+			if (!mappedData || (mappedSize == 0)) {
+				close();
+				return false;
+			}
+			return true;
+		}
+
+		/** @brief Unmaps the file, all pointers into the mapping become invalid */
+		void close()
+		{
+#if defined(_WIN32)
+			if (mappedData) {
+				UnmapViewOfFile(mappedData);
+			}
+			if (mappingHandle) {
+				CloseHandle(mappingHandle);
+				mappingHandle = nullptr;
+			}
+			if (fileHandle != INVALID_HANDLE_VALUE) {
+				CloseHandle(fileHandle);
+				fileHandle = INVALID_HANDLE_VALUE;
+			}
+#elif defined(__ANDROID__)
+			if (asset) {
+				AAsset_close(asset);
+				asset = nullptr;
+			}
+#else
+			if (mappedData) {
+				munmap(const_cast<uint8_t*>(mappedData), mappedSize);
+			}
+#endif
+			mappedData = nullptr;
+			mappedSize = 0;
+		}
+
+		const uint8_t* data() const
+		{
+			return mappedData;
+		}
+
+		size_t size() const
+		{
+			return mappedSize;
+		}
+	};
+}
@@ -0,0 +1,824 @@
+/*
+* Vulkan device memory allocator
+*
+* Sub-allocates buffers and images from large device memory blocks instead of calling vkAllocateMemory for every resource
+* Blocks are kept per memory type, and per resource kind if the device's bufferImageGranularity requires buffers (and linear images)
+* to be kept apart from optimal tiled images
+* General purpose blocks use a two-level segregated fit (TLSF) allocator with constant time allocation and freeing
+* Linear blocks are bump allocators for short lived allocations like staging buffers that are released in reverse order or all at once
+* Host visible blocks are persistently mapped
+*
+* This code is licensed under the MIT license (MIT) (http://opensource.org/licenses/MIT)
+*/
+
+#pragma once
+
+#include <vector>
+#include <mutex>
+#include <functional>
+#include <algorithm>
+#include <cstring>
+#include <stdexcept>
+#include <stdint.h>
+#include <assert.h>
+#include "vulkan/vulkan.h"
+#include "VulkanTools.h"
+
+namespace vks
+{
+	class MemoryAllocator;
+	struct MemoryBlock;
+	struct MemoryChunk;
+
+	/** @brief Sub-allocation strategy of a memory block */
+	enum class AllocationStrategy
+	{
+		/** @brief Two-level segregated fit, for allocations that are freed in any order */
+		Tlsf,
+		/** @brief Bump allocation, for short lived allocations that are freed in reverse order or all at once */
+		Linear
+	};
+
+	/** @brief Kind of resource bound to an allocation, linear and optimal resources must not share a bufferImageGranularity page */
+	enum class ResourceType
+	{
+		/** @brief Buffers and linear tiled images */
+		Linear,
+		/** @brief Optimal tiled images */
+		Optimal
+	};
+
+	/** @brief A range of device memory handed out by the allocator */
+	struct Allocation
+	{
+		/** @brief Memory object the allocation lives in, shared with other allocations unless the allocation is dedicated */
+		VkDeviceMemory memory = VK_NULL_HANDLE;
+		/** @brief Offset of the allocation in the memory object, resources have to be bound at this offset */
+		VkDeviceSize offset = 0;
+		VkDeviceSize size = 0;
+		VkDeviceSize alignment = 1;
+		uint32_t memoryTypeIndex = 0;
+		/** @brief Host pointer to the start of the allocation if the memory is host visible, nullptr otherwise */
+		void* mapped = nullptr;
+		/** @brief Application defined pointer, e.g. to find the resource using an allocation that is moved during defragmentation */
+		void* userData = nullptr;
+		/** @brief Allocator the allocation has to be freed with */
+		MemoryAllocator* allocator = nullptr;
+	private:
+		friend class MemoryAllocator;
+		MemoryBlock* block = nullptr;
+		MemoryChunk* chunk = nullptr;
+	};
+
+	/** @brief Physically contiguous range of a TLSF block, either free or used by an allocation */
+	struct MemoryChunk
+	{
+		VkDeviceSize offset = 0;
+		VkDeviceSize size = 0;
+		MemoryChunk* prevPhysical = nullptr;
+		MemoryChunk* nextPhysical = nullptr;
+		MemoryChunk* prevFree = nullptr;
+		MemoryChunk* nextFree = nullptr;
+		/** @brief Allocation using this chunk, nullptr if the chunk is free */
+		Allocation* allocation = nullptr;
+	};
+
+	/** @brief A single vkAllocateMemory allocation that resources are sub-allocated from */
+	struct MemoryBlock
+	{
+		static const uint32_t firstLevelCount = 64;
+		static const uint32_t secondLevelBits = 4;
+		static const uint32_t secondLevelCount = 1 << secondLevelBits;
+		// Remainders smaller than this stay part of the allocated chunk instead of being split off
+		static const VkDeviceSize minimumChunkSize = 64;
+
+		VkDeviceMemory memory = VK_NULL_HANDLE;
+		VkDeviceSize size = 0;
+		void* mapped = nullptr;
+		uint32_t pool = 0;
+		AllocationStrategy strategy = AllocationStrategy::Tlsf;
+		uint32_t allocationCount = 0;
+		VkDeviceSize usedBytes = 0;
+
+		// Linear strategy
+		VkDeviceSize linearTop = 0;
+		// Allocations of a linear block, there are no chunks to find them when the allocator is destroyed
+		std::vector<Allocation*> linearAllocations;
+
+		// TLSF strategy, free chunks are kept in lists segregated by a logarithmic first level and a linear second level size class
+		MemoryChunk* firstChunk = nullptr;
+		MemoryChunk* freeLists[firstLevelCount][secondLevelCount];
+		uint64_t firstLevelBitmap = 0;
+		uint32_t secondLevelBitmaps[firstLevelCount];
+
+		static uint32_t bitScanReverse(uint64_t value)
+		{
+#if defined(__GNUC__) || defined(__clang__)
+			return 63 - static_cast<uint32_t>(__builtin_clzll(value));
+#else
+			uint32_t index = 0;
+			while (value >>= 1) {
+				index++;
+			}
+			return index;
+#endif
+		}
+
+		static uint32_t bitScanForward(uint64_t value)
+		{
+#if defined(__GNUC__) || defined(__clang__)
+			return static_cast<uint32_t>(__builtin_ctzll(value));
+#else
+			uint32_t index = 0;
+			while ((value & 1) == 0) {
+				value >>= 1;
+				index++;
+			}
+			return index;
+#endif
+		}
+
+		static void mapping(VkDeviceSize size, uint32_t& firstLevel, uint32_t& secondLevel)
+		{
+			if (size < secondLevelCount) {
+				firstLevel = 0;
+				secondLevel = static_cast<uint32_t>(size);
+			} else {
+				firstLevel = bitScanReverse(size);
+				secondLevel = static_cast<uint32_t>(size >> (firstLevel - secondLevelBits)) ^ secondLevelCount;
+			}
+		}
+
+		void create(AllocationStrategy strategy)
+		{
+			this->strategy = strategy;
+			if (strategy == AllocationStrategy::Tlsf) {
+				memset(freeLists, 0, sizeof(freeLists));
+				memset(secondLevelBitmaps, 0, sizeof(secondLevelBitmaps));
+				firstChunk = new MemoryChunk();
+				firstChunk->size = size;
+				insertFreeChunk(firstChunk);
+			}
+		}
+
+		void destroyChunks()
+		{
+			MemoryChunk* chunk = firstChunk;
+			while (chunk) {
+				MemoryChunk* next = chunk->nextPhysical;
+				delete chunk;
+				chunk = next;
+			}
+			firstChunk = nullptr;
+		}
+
+		void insertFreeChunk(MemoryChunk* chunk)
+		{
+			uint32_t firstLevel, secondLevel;
+			mapping(chunk->size, firstLevel, secondLevel);
+			MemoryChunk*& head = freeLists[firstLevel][secondLevel];
+			chunk->prevFree = nullptr;
+			chunk->nextFree = head;
+			if (head) {
+				head->prevFree = chunk;
+			}
+			head = chunk;
+			firstLevelBitmap |= (uint64_t(1) << firstLevel);
+			secondLevelBitmaps[firstLevel] |= (1u << secondLevel);
+		}
+
+		void removeFreeChunk(MemoryChunk* chunk)
+		{
+			uint32_t firstLevel, secondLevel;
+			mapping(chunk->size, firstLevel, secondLevel);
+			if (chunk->prevFree) {
+				chunk->prevFree->nextFree = chunk->nextFree;
+			} else {
+				freeLists[firstLevel][secondLevel] = chunk->nextFree;
+			}
+			if (chunk->nextFree) {
+				chunk->nextFree->prevFree = chunk->prevFree;
+			}
+			chunk->prevFree = chunk->nextFree = nullptr;
+			if (!freeLists[firstLevel][secondLevel]) {
+				secondLevelBitmaps[firstLevel] &= ~(1u << secondLevel);
+				if (secondLevelBitmaps[firstLevel] == 0) {
+					firstLevelBitmap &= ~(uint64_t(1) << firstLevel);
+				}
+			}
+		}
+
+		// Returns a free chunk that is at least size bytes large
+		MemoryChunk* findFreeChunk(VkDeviceSize size)
+		{
+			// Round up to the next size class so every chunk in the found list is large enough
+			if (size >= secondLevelCount) {
+				size += (VkDeviceSize(1) << (bitScanReverse(size) - secondLevelBits)) - 1;
+			}
+			uint32_t firstLevel, secondLevel;
+			mapping(size, firstLevel, secondLevel);
+			uint32_t secondLevelMap = secondLevelBitmaps[firstLevel] & (~0u << secondLevel);
+			if (secondLevelMap == 0) {
+				if (firstLevel + 1 >= firstLevelCount) {
+					return nullptr;
+				}
+				const uint64_t firstLevelMap = firstLevelBitmap & (~uint64_t(0) << (firstLevel + 1));
+				if (firstLevelMap == 0) {
+					return nullptr;
+				}
+				firstLevel = bitScanForward(firstLevelMap);
+				secondLevelMap = secondLevelBitmaps[firstLevel];
+			}
+			secondLevel = bitScanForward(secondLevelMap);
+			return freeLists[firstLevel][secondLevel];
+		}
+
+		MemoryChunk* tlsfAllocate(VkDeviceSize size, VkDeviceSize alignment, Allocation* allocation)
+		{
+			MemoryChunk* chunk = findFreeChunk(size + alignment - 1);
+			if (!chunk) {
+				return nullptr;
+			}
+			removeFreeChunk(chunk);
+			const VkDeviceSize alignedOffset = (chunk->offset + alignment - 1) / alignment * alignment;
+			if (alignedOffset > chunk->offset) {
+				// Keep the alignment padding as a separate free chunk, the previous chunk can't be free as free neighbours are always merged
+				MemoryChunk* padding = new MemoryChunk();
+				padding->offset = chunk->offset;
+				padding->size = alignedOffset - chunk->offset;
+				padding->prevPhysical = chunk->prevPhysical;
+				padding->nextPhysical = chunk;
+				if (chunk->prevPhysical) {
+					chunk->prevPhysical->nextPhysical = padding;
+				} else {
+					firstChunk = padding;
+				}
+				chunk->prevPhysical = padding;
+				chunk->offset = alignedOffset;
+				chunk->size -= padding->size;
+				insertFreeChunk(padding);
+			}
+			if (chunk->size - size >= minimumChunkSize) {
+				MemoryChunk* remainder = new MemoryChunk();
+				remainder->offset = chunk->offset + size;
+				remainder->size = chunk->size - size;
+				remainder->prevPhysical = chunk;
+				remainder->nextPhysical = chunk->nextPhysical;
+				if (chunk->nextPhysical) {
+					chunk->nextPhysical->prevPhysical = remainder;
+				}
+				chunk->nextPhysical = remainder;
+				chunk->size = size;
+				insertFreeChunk(remainder);
+			}
+			chunk->allocation = allocation;
+			allocationCount++;
+			usedBytes += chunk->size;
+			return chunk;
+		}
+
+		void tlsfFree(MemoryChunk* chunk)
+		{
+			allocationCount--;
+			usedBytes -= chunk->size;
+			chunk->allocation = nullptr;
+			// Merge with free physical neighbours
+			MemoryChunk* prev = chunk->prevPhysical;
+			if (prev && !prev->allocation) {
+				removeFreeChunk(prev);
+				prev->size += chunk->size;
+				prev->nextPhysical = chunk->nextPhysical;
+				if (chunk->nextPhysical) {
+					chunk->nextPhysical->prevPhysical = prev;
+				}
+				delete chunk;
+				chunk = prev;
+			}
+			MemoryChunk* next = chunk->nextPhysical;
+			if (next && !next->allocation) {
+				removeFreeChunk(next);
+				chunk->size += next->size;
+				chunk->nextPhysical = next->nextPhysical;
+				if (next->nextPhysical) {
+					next->nextPhysical->prevPhysical = chunk;
+				}
+				delete next;
+			}
+			insertFreeChunk(chunk);
+		}
+
+		bool linearAllocate(VkDeviceSize size, VkDeviceSize alignment, VkDeviceSize& offset)
+		{
+			const VkDeviceSize alignedOffset = (linearTop + alignment - 1) / alignment * alignment;
+			if (alignedOffset + size > this->size) {
+				return false;
+			}
+			offset = alignedOffset;
+			linearTop = alignedOffset + size;
+			allocationCount++;
+			usedBytes += size;
+			return true;
+		}
+
+		void linearFree(VkDeviceSize offset, VkDeviceSize size)
+		{
+			allocationCount--;
+			usedBytes -= size;
+			if (allocationCount == 0) {
+				linearTop = 0;
+			} else if (offset + size == linearTop) {
+				linearTop = offset;
+			}
+		}
+	};
+
+	class MemoryAllocator
+	{
+	public:
+		/** @brief Allocation statistics of a single memory type or the whole device */
+		struct Statistics
+		{
+			/** @brief Number of memory blocks that resources are sub-allocated from */
+			uint32_t blockCount = 0;
+			/** @brief Number of allocations with their own memory object (too large for a block) */
+			uint32_t dedicatedAllocationCount = 0;
+			/** @brief Number of live allocations, including dedicated ones */
+			uint32_t allocationCount = 0;
+			/** @brief Device memory allocated from the driver (blocks and dedicated allocations) */
+			VkDeviceSize reservedBytes = 0;
+			/** @brief Device memory used by live allocations */
+			VkDeviceSize usedBytes = 0;
+
+			/** @brief Number of vkAllocateMemory allocations currently alive */
+			uint32_t deviceMemoryCount() const
+			{
+				return blockCount + dedicatedAllocationCount;
+			}
+
+			void add(const Statistics& other)
+			{
+				blockCount += other.blockCount;
+				dedicatedAllocationCount += other.dedicatedAllocationCount;
+				allocationCount += other.allocationCount;
+				reservedBytes += other.reservedBytes;
+				usedBytes += other.usedBytes;
+			}
+		};
+
+		/**
+		* Called for every allocation that defragmentation wants to move
+		* The callback has to copy the allocation's contents to the new location and re-create resources bound to the allocation,
+		* as memory bindings can't be changed. The allocation still points to the old location while the callback is running
+		*
+		* @return True if the allocation has been moved, false to keep it at its current location
+		*/
+		typedef std::function<bool(Allocation* allocation, VkDeviceMemory memory, VkDeviceSize offset)> DefragmentationCallback;
+
+		/** @brief Size of new memory blocks, heaps of 1 GiB or less use an eighth of the heap size instead. Allocations larger than half a block get dedicated memory */
+		VkDeviceSize preferredBlockSize = 64 * 1024 * 1024;
+
+	private:
+		VkDevice device = VK_NULL_HANDLE;
+		VkPhysicalDeviceMemoryProperties memoryProperties{};
+		VkDeviceSize bufferImageGranularity = 1;
+		VkDeviceSize nonCoherentAtomSize = 1;
+		// Blocks for each combination of memory type, resource type, strategy and allocate flags
+		std::vector<std::vector<MemoryBlock*>> pools;
+		std::vector<Allocation*> dedicatedAllocations;
+		Statistics statistics[VK_MAX_MEMORY_TYPES];
+		std::mutex mutex;
+
+		static const VkDeviceSize smallHeapSize = 1024 * 1024 * 1024;
+
+		uint32_t getPoolIndex(uint32_t memoryTypeIndex, ResourceType resourceType, AllocationStrategy strategy, VkMemoryAllocateFlags allocateFlags) const
+		{
+			// Only keep resource types apart if the device requires it
+			const uint32_t optimal = ((bufferImageGranularity > 1) && (resourceType == ResourceType::Optimal)) ? 1 : 0;
+			const uint32_t linear = (strategy == AllocationStrategy::Linear) ? 1 : 0;
+			const uint32_t deviceAddress = (allocateFlags & VK_MEMORY_ALLOCATE_DEVICE_ADDRESS_BIT) ? 1 : 0;
+			return ((memoryTypeIndex * 2 + optimal) * 2 + linear) * 2 + deviceAddress;
+		}
+
+		VkDeviceSize getBlockSize(uint32_t memoryTypeIndex) const
+		{
+			const VkDeviceSize heapSize = memoryProperties.memoryHeaps[memoryProperties.memoryTypes[memoryTypeIndex].heapIndex].size;
+			return (heapSize <= smallHeapSize) ? std::max<VkDeviceSize>(heapSize / 8, 1) : preferredBlockSize;
+		}
+
+		bool isHostVisible(uint32_t memoryTypeIndex) const
+		{
+			return (memoryProperties.memoryTypes[memoryTypeIndex].propertyFlags & VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT) != 0;
+		}
+
+		bool isNonCoherent(uint32_t memoryTypeIndex) const
+		{
+			return isHostVisible(memoryTypeIndex) && ((memoryProperties.memoryTypes[memoryTypeIndex].propertyFlags & VK_MEMORY_PROPERTY_HOST_COHERENT_BIT) == 0);
+		}
+
+		VkResult allocateDeviceMemory(VkDeviceSize size, uint32_t memoryTypeIndex, VkMemoryAllocateFlags allocateFlags, VkDeviceMemory* memory, void** mapped)
+		{
+			VkMemoryAllocateInfo memAlloc{};
+			memAlloc.sType = VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO;
+			memAlloc.allocationSize = size;
+			memAlloc.memoryTypeIndex = memoryTypeIndex;
+			VkMemoryAllocateFlagsInfo allocFlagsInfo{};
+			if (allocateFlags != 0) {
+				allocFlagsInfo.sType = VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_FLAGS_INFO;
+				allocFlagsInfo.flags = allocateFlags;
+				memAlloc.pNext = &allocFlagsInfo;
+			}
+			VkResult result = vkAllocateMemory(device, &memAlloc, nullptr, memory);
+			if (result != VK_SUCCESS) {
+				return result;
+			}
+			*mapped = nullptr;
+			if (isHostVisible(memoryTypeIndex)) {
+				result = vkMapMemory(device, *memory, 0, VK_WHOLE_SIZE, 0, mapped);
+				if (result != VK_SUCCESS) {
+					vkFreeMemory(device, *memory, nullptr);
+					*memory = VK_NULL_HANDLE;
+				}
+			}
+			return result;
+		}
+
+		MemoryBlock* createBlock(uint32_t pool, uint32_t memoryTypeIndex, AllocationStrategy strategy, VkMemoryAllocateFlags allocateFlags)
+		{
+			MemoryBlock* block = new MemoryBlock();
+			block->size = getBlockSize(memoryTypeIndex);
+			block->pool = pool;
+			if (allocateDeviceMemory(block->size, memoryTypeIndex, allocateFlags, &block->memory, &block->mapped) != VK_SUCCESS) {
+				delete block;
+				return nullptr;
+			}
+			block->create(strategy);
+			pools[pool].push_back(block);
+			statistics[memoryTypeIndex].blockCount++;
+			statistics[memoryTypeIndex].reservedBytes += block->size;
+			return block;
+		}
+
+		uint32_t getBlockMemoryType(const MemoryBlock* block) const
+		{
+			// Pools are indexed by memory type first, see getPoolIndex
+			return block->pool / 8;
+		}
+
+		void destroyBlock(MemoryBlock* block)
+		{
+			const uint32_t memoryTypeIndex = getBlockMemoryType(block);
+			std::vector<MemoryBlock*>& pool = pools[block->pool];
+			pool.erase(std::find(pool.begin(), pool.end(), block));
+			statistics[memoryTypeIndex].blockCount--;
+			statistics[memoryTypeIndex].reservedBytes -= block->size;
+			vkFreeMemory(device, block->memory, nullptr);
+			block->destroyChunks();
+			delete block;
+		}
+
+		bool allocateFromBlock(MemoryBlock* block, Allocation* allocation)
+		{
+			VkDeviceSize offset = 0;
+			if (block->strategy == AllocationStrategy::Linear) {
+				if (!block->linearAllocate(allocation->size, allocation->alignment, offset)) {
+					return false;
+				}
+				block->linearAllocations.push_back(allocation);
+			} else {
+				MemoryChunk* chunk = block->tlsfAllocate(allocation->size, allocation->alignment, allocation);
+				if (!chunk) {
+					return false;
+				}
+				allocation->chunk = chunk;
+				offset = chunk->offset;
+			}
+			allocation->block = block;
+			allocation->memory = block->memory;
+			allocation->offset = offset;
+			allocation->mapped = block->mapped ? static_cast<uint8_t*>(block->mapped) + offset : nullptr;
+			return true;
+		}
+
+		void freeFromBlock(Allocation* allocation)
+		{
+			MemoryBlock* block = allocation->block;
+			if (block->strategy == AllocationStrategy::Linear) {
+				block->linearFree(allocation->offset, allocation->size);
+				std::vector<Allocation*>& allocations = block->linearAllocations;
+				allocations.erase(std::find(allocations.begin(), allocations.end(), allocation));
+			} else {
+				block->tlsfFree(allocation->chunk);
+			}
+			if (block->allocationCount == 0) {
+				// Keep one empty block per pool around to avoid allocating device memory again right away
+				const std::vector<MemoryBlock*>& pool = pools[block->pool];
+				for (MemoryBlock* other : pool) {
+					if ((other != block) && (other->allocationCount == 0)) {
+						destroyBlock(block);
+						break;
+					}
+				}
+			}
+		}
+
+		VkMappedMemoryRange getMappedRange(const Allocation* allocation, VkDeviceSize size, VkDeviceSize offset) const
+		{
+			VkMappedMemoryRange range{};
+			range.sType = VK_STRUCTURE_TYPE_MAPPED_MEMORY_RANGE;
+			range.memory = allocation->memory;
+			// Non-coherent allocations are aligned to and padded to a multiple of the atom size, so the range can be expanded without touching other allocations
+			const VkDeviceSize start = allocation->offset + offset;
+			const VkDeviceSize end = (size == VK_WHOLE_SIZE) ? (allocation->offset + allocation->size) : std::min(start + size, allocation->offset + allocation->size);
+			range.offset = start / nonCoherentAtomSize * nonCoherentAtomSize;
+			range.size = (end + nonCoherentAtomSize - 1) / nonCoherentAtomSize * nonCoherentAtomSize - range.offset;
+			return range;
+		}
+
+	public:
+		MemoryAllocator() = default;
+		MemoryAllocator(const MemoryAllocator&) = delete;
+		MemoryAllocator& operator=(const MemoryAllocator&) = delete;
+
+		~MemoryAllocator()
+		{
+			destroy();
+		}
+
+		/** @brief Prepares the allocator for a logical device, no memory is allocated until the first allocation */
+		void prepare(VkPhysicalDevice physicalDevice, VkDevice device)
+		{
+			this->device = device;
+			vkGetPhysicalDeviceMemoryProperties(physicalDevice, &memoryProperties);
+			VkPhysicalDeviceProperties properties;
+			vkGetPhysicalDeviceProperties(physicalDevice, &properties);
+			bufferImageGranularity = std::max<VkDeviceSize>(properties.limits.bufferImageGranularity, 1);
+			nonCoherentAtomSize = std::max<VkDeviceSize>(properties.limits.nonCoherentAtomSize, 1);
+			pools.resize(VK_MAX_MEMORY_TYPES * 8);
+		}
+
+		/** @brief Frees all device memory, including allocations that haven't been freed yet */
+		void destroy()
+		{
+			std::lock_guard<std::mutex> lock(mutex);
+			for (auto& pool : pools) {
+				for (MemoryBlock* block : pool) {
+					for (MemoryChunk* chunk = block->firstChunk; chunk; chunk = chunk->nextPhysical) {
+						delete chunk->allocation;
+					}
+					for (Allocation* allocation : block->linearAllocations) {
+						delete allocation;
+					}
+					vkFreeMemory(device, block->memory, nullptr);
+					block->destroyChunks();
+					delete block;
+				}
+				pool.clear();
+			}
+			for (Allocation* allocation : dedicatedAllocations) {
+				vkFreeMemory(device, allocation->memory, nullptr);
+				delete allocation;
+			}
+			dedicatedAllocations.clear();
+			for (auto& typeStatistics : statistics) {
+				typeStatistics = Statistics();
+			}
+		}
+
+		/**
+		* Get the index of a memory type that has all the requested property bits set
+		*
+		* @throws Throws an exception if no memory type could be found that supports the requested properties
+		*/
+		uint32_t getMemoryType(uint32_t typeBits, VkMemoryPropertyFlags properties) const
+		{
+			for (uint32_t i = 0; i < memoryProperties.memoryTypeCount; i++) {
+				if (((typeBits & (1 << i)) != 0) && ((memoryProperties.memoryTypes[i].propertyFlags & properties) == properties)) {
+					return i;
+				}
+			}
+			throw std::runtime_error("Could not find a matching memory type");
+		}
+
+		/**
+		* Allocate memory for a resource
+		*
+		* @param requirements Memory requirements of the resource
+		* @param properties Memory properties the memory type has to support (i.e. device local, host visible, coherent)
+		* @param resourceType Kind of resource that will be bound to the allocation
+		* @param strategy Sub-allocation strategy of the memory block used for the allocation
+		* @param allocateFlags Memory allocate flags (e.g. VK_MEMORY_ALLOCATE_DEVICE_ADDRESS_BIT), allocations with different flags come from different blocks
+		*
+		* @return The allocation, has to be freed with free()
+		*/
+		Allocation* allocate(const VkMemoryRequirements& requirements, VkMemoryPropertyFlags properties, ResourceType resourceType = ResourceType::Linear, AllocationStrategy strategy = AllocationStrategy::Tlsf, VkMemoryAllocateFlags allocateFlags = 0)
+		{
+			std::lock_guard<std::mutex> lock(mutex);
+			Allocation* allocation = new Allocation();
+			allocation->allocator = this;
+			allocation->memoryTypeIndex = getMemoryType(requirements.memoryTypeBits, properties);
+			allocation->size = requirements.size;
+			allocation->alignment = std::max<VkDeviceSize>(requirements.alignment, 1);
+			if (isNonCoherent(allocation->memoryTypeIndex)) {
+				// Flushes and invalidates work on whole atoms, so non-coherent allocations must not share an atom with others
+				allocation->alignment = std::max(allocation->alignment, nonCoherentAtomSize);
+				allocation->size = (allocation->size + nonCoherentAtomSize - 1) / nonCoherentAtomSize * nonCoherentAtomSize;
+			}
+			Statistics& typeStatistics = statistics[allocation->memoryTypeIndex];
+
+			if (allocation->size <= getBlockSize(allocation->memoryTypeIndex) / 2) {
+				const uint32_t poolIndex = getPoolIndex(allocation->memoryTypeIndex, resourceType, strategy, allocateFlags);
+				bool allocated = false;
+				for (MemoryBlock* block : pools[poolIndex]) {
+					if (allocateFromBlock(block, allocation)) {
+						allocated = true;
+						break;
+					}
+				}
+				if (!allocated) {
+					MemoryBlock* block = createBlock(poolIndex, allocation->memoryTypeIndex, strategy, allocateFlags);
+					allocated = block && allocateFromBlock(block, allocation);
+				}
+				if (allocated) {
+					typeStatistics.allocationCount++;
+					typeStatistics.usedBytes += allocation->size;
+					return allocation;
+				}
+				// The heap may be too full for a new block, so try to allocate just what's needed
+			}
+
+			VK_CHECK_RESULT(allocateDeviceMemory(allocation->size, allocation->memoryTypeIndex, allocateFlags, &allocation->memory, &allocation->mapped));
+			dedicatedAllocations.push_back(allocation);
+			typeStatistics.dedicatedAllocationCount++;
+			typeStatistics.reservedBytes += allocation->size;
+			typeStatistics.allocationCount++;
+			typeStatistics.usedBytes += allocation->size;
+			return allocation;
+		}
+
+		/**
+		* Allocate memory for a buffer and bind it
+		*
+		* @param buffer Buffer to allocate memory for
+		* @param properties Memory properties the memory type has to support (i.e. device local, host visible, coherent)
+		* @param usageFlags Usage flags the buffer has been created with
+		* @param strategy (Optional) Sub-allocation strategy, use AllocationStrategy::Linear for short lived buffers like staging buffers
+		*/
+		Allocation* allocateBufferMemory(VkBuffer buffer, VkMemoryPropertyFlags properties, VkBufferUsageFlags usageFlags, AllocationStrategy strategy = AllocationStrategy::Tlsf)
+		{
+			VkMemoryRequirements memReqs;
+			vkGetBufferMemoryRequirements(device, buffer, &memReqs);
+			// Buffers with VK_BUFFER_USAGE_SHADER_DEVICE_ADDRESS_BIT need memory allocated with the matching flag
+			const VkMemoryAllocateFlags allocateFlags = (usageFlags & VK_BUFFER_USAGE_SHADER_DEVICE_ADDRESS_BIT) ? VK_MEMORY_ALLOCATE_DEVICE_ADDRESS_BIT : 0;
+			Allocation* allocation = allocate(memReqs, properties, ResourceType::Linear, strategy, allocateFlags);
+			VK_CHECK_RESULT(vkBindBufferMemory(device, buffer, allocation->memory, allocation->offset));
+			return allocation;
+		}
+
+		/**
+		* Allocate memory for an image and bind it
+		*
+		* @param image Image to allocate memory for
+		* @param properties Memory properties the memory type has to support (i.e. device local, host visible, coherent)
+		* @param tiling (Optional) Tiling the image has been created with
+		*/
+		Allocation* allocateImageMemory(VkImage image, VkMemoryPropertyFlags properties, VkImageTiling tiling = VK_IMAGE_TILING_OPTIMAL)
+		{
+			VkMemoryRequirements memReqs;
+			vkGetImageMemoryRequirements(device, image, &memReqs);
+			Allocation* allocation = allocate(memReqs, properties, (tiling == VK_IMAGE_TILING_LINEAR) ? ResourceType::Linear : ResourceType::Optimal);
+			VK_CHECK_RESULT(vkBindImageMemory(device, image, allocation->memory, allocation->offset));
+			return allocation;
+		}
+
+		/** @brief Releases an allocation, resources bound to it must have been destroyed (or must no longer be used) */
+		void free(Allocation* allocation)
+		{
+			if (!allocation) {
+				return;
+			}
+			std::lock_guard<std::mutex> lock(mutex);
+			Statistics& typeStatistics = statistics[allocation->memoryTypeIndex];
+			typeStatistics.allocationCount--;
+			typeStatistics.usedBytes -= allocation->size;
+			if (allocation->block) {
+				freeFromBlock(allocation);
+			} else {
+				vkFreeMemory(device, allocation->memory, nullptr);
+				dedicatedAllocations.erase(std::find(dedicatedAllocations.begin(), dedicatedAllocations.end(), allocation));
+				typeStatistics.dedicatedAllocationCount--;
+				typeStatistics.reservedBytes -= allocation->size;
+			}
+			delete allocation;
+		}
+
+		/**
+		* Flush a range of a host visible allocation to make host writes visible to the device
+		*
+		* @note Does nothing for host coherent memory
+		*
+		* @param size (Optional) Size of the range to flush. Pass VK_WHOLE_SIZE to flush the complete allocation.
+		* @param offset (Optional) Byte offset from the start of the allocation
+		*/
+		VkResult flush(Allocation* allocation, VkDeviceSize size = VK_WHOLE_SIZE, VkDeviceSize offset = 0) const
+		{
+			if (!isNonCoherent(allocation->memoryTypeIndex)) {
+				return VK_SUCCESS;
+			}
+			const VkMappedMemoryRange range = getMappedRange(allocation, size, offset);
+			return vkFlushMappedMemoryRanges(device, 1, &range);
+		}
+
+		/**
+		* Invalidate a range of a host visible allocation to make device writes visible to the host
+		*
+		* @note Does nothing for host coherent memory
+		*
+		* @param size (Optional) Size of the range to invalidate. Pass VK_WHOLE_SIZE to invalidate the complete allocation.
+		* @param offset (Optional) Byte offset from the start of the allocation
+		*/
+		VkResult invalidate(Allocation* allocation, VkDeviceSize size = VK_WHOLE_SIZE, VkDeviceSize offset = 0) const
+		{
+			if (!isNonCoherent(allocation->memoryTypeIndex)) {
+				return VK_SUCCESS;
+			}
+			const VkMappedMemoryRange range = getMappedRange(allocation, size, offset);
+			return vkInvalidateMappedMemoryRanges(device, 1, &range);
+		}
+
+		/**
+		* Moves allocations out of sparsely used TLSF blocks into fuller blocks of the same pool and frees blocks that become empty
+		* The device must not use any of the resources that are moved while defragmenting
+		*
+		* @param callback Called for every allocation to move, see DefragmentationCallback. Must not allocate or free memory from this allocator
+		* @param maxMoves (Optional) Maximum number of allocations to move
+		*
+		* @return Number of allocations that have been moved
+		*/
+		uint32_t defragment(const DefragmentationCallback& callback, uint32_t maxMoves = UINT32_MAX)
+		{
+			std::lock_guard<std::mutex> lock(mutex);
+			uint32_t moves = 0;
+			for (auto& pool : pools) {
+				if ((pool.size() < 2) || (pool.front()->strategy != AllocationStrategy::Tlsf)) {
+					continue;
+				}
+				// Move from the least used blocks into the most used ones
+				std::vector<MemoryBlock*> blocks = pool;
+				std::sort(blocks.begin(), blocks.end(), [](const MemoryBlock* a, const MemoryBlock* b) { return a->usedBytes > b->usedBytes; });
+				for (size_t src = blocks.size() - 1; (src > 0) && (moves < maxMoves); src--) {
+					std::vector<Allocation*> allocations;
+					for (MemoryChunk* chunk = blocks[src]->firstChunk; chunk; chunk = chunk->nextPhysical) {
+						if (chunk->allocation) {
+							allocations.push_back(chunk->allocation);
+						}
+					}
+					for (Allocation* allocation : allocations) {
+						if (moves >= maxMoves) {
+							break;
+						}
+						for (size_t dst = 0; dst < src; dst++) {
+							MemoryChunk* chunk = blocks[dst]->tlsfAllocate(allocation->size, allocation->alignment, allocation);
+							if (!chunk) {
+								continue;
+							}
+							if (!callback(allocation, blocks[dst]->memory, chunk->offset)) {
+								blocks[dst]->tlsfFree(chunk);
+								break;
+							}
+							allocation->block->tlsfFree(allocation->chunk);
+							allocation->block = blocks[dst];
+							allocation->chunk = chunk;
+							allocation->memory = blocks[dst]->memory;
+							allocation->offset = chunk->offset;
+							allocation->mapped = blocks[dst]->mapped ? static_cast<uint8_t*>(blocks[dst]->mapped) + chunk->offset : nullptr;
+							moves++;
+							break;
+						}
+					}
+				}
+				for (MemoryBlock* block : blocks) {
+					if (block->allocationCount == 0) {
+						destroyBlock(block);
+					}
+				}
+			}
+			return moves;
+		}
+
+		/** @brief Returns the statistics for a single memory type */
+		Statistics getStatistics(uint32_t memoryTypeIndex) const
+		{
+			return statistics[memoryTypeIndex];
+		}
+
+		/** @brief Returns the statistics summed up over all memory types */
+		Statistics getStatistics() const
+		{
+			Statistics total;
+			for (uint32_t i = 0; i < memoryProperties.memoryTypeCount; i++) {
+				total.add(statistics[i]);
+			}
+			return total;
+		}
+	};
+}
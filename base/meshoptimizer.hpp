@@ -0,0 +1,873 @@
+/*
+* Mesh optimization for indexed triangle lists
+*
+* Welds identical vertices, reorders triangles for the post transform vertex cache with Tipsify (Sander, Nehab and Barczak,
+* "Fast Triangle Reordering for Vertex Locality and Reduced Overdraw", 2007), sorts clusters of the reordered triangles
+* front to back relative to the mesh center to reduce overdraw and finally reorders the vertices in the order they are
+* first used for better vertex fetch locality
+* Levels of detail are generated by collapsing edges in the order of a quadric error metric, collapses only move vertices
+* onto existing neighbours so all levels share the vertex data of the source mesh
+* All functions work on indices relative to the start of the vertex data they are given
+*
+* This code is licensed under the MIT license (MIT) (http://opensource.org/licenses/MIT)
+*/
+
+#pragma once
+
+#include <vector>
+#include <algorithm>
+#include <assert.h>
+#include <string.h>
+#include <stdint.h>
+#include <float.h>
+#include <math.h>
+#include <glm/glm.hpp>
+
+namespace vks
+{
+	namespace meshoptimizer
+	{
+		/** @brief Size of the simulated FIFO vertex cache, small enough to not overestimate the cache of current GPUs */
+		static const uint32_t defaultCacheSize = 16;
+
+		/** @brief Marks vertices in a remap table that aren't referenced by any index */
+		static const uint32_t unusedVertex = ~0u;
+
+		struct VertexCacheStatistics {
+			/** @brief Number of cache misses, i.e. vertex shader invocations */
+			uint32_t vertexTransforms = 0;
+			uint32_t triangleCount = 0;
+			/** @brief Number of distinct vertices referenced by the indices */
+			uint32_t vertexCount = 0;
+
+			/** @brief Average cache miss ratio, transformed vertices per triangle (3.0 at worst, around 0.5 at best for regular meshes) */
+			float acmr() const
+			{
+				return triangleCount > 0 ? static_cast<float>(vertexTransforms) / static_cast<float>(triangleCount) : 0.0f;
+			}
+
+			/** @brief Average transform to vertex ratio, 1.0 means every vertex is transformed exactly once */
+			float atvr() const
+			{
+				return vertexCount > 0 ? static_cast<float>(vertexTransforms) / static_cast<float>(vertexCount) : 0.0f;
+			}
+
+			void add(const VertexCacheStatistics& other)
+			{
+				vertexTransforms += other.vertexTransforms;
+				triangleCount += other.triangleCount;
+				vertexCount += other.vertexCount;
+			}
+		};
+
+		/** @brief Simulates a FIFO vertex cache to measure how often vertices of a triangle list are transformed */
+		inline VertexCacheStatistics analyzeVertexCache(const uint32_t* indices, size_t indexCount, size_t vertexCount, uint32_t cacheSize = defaultCacheSize)
+		{
+			VertexCacheStatistics statistics;
+			statistics.triangleCount = static_cast<uint32_t>(indexCount / 3);
+			// A vertex is still cached if less than cacheSize other vertices have been inserted since it was inserted
+			std::vector<uint32_t> timestamps(vertexCount, 0);
+			uint32_t time = cacheSize + 1;
+			for (size_t i = 0; i < indexCount; i++) {
+				const uint32_t vertex = indices[i];
+				assert(vertex < vertexCount);
+				if (timestamps[vertex] == 0) {
+					statistics.vertexCount++;
+				}
+				if (time - timestamps[vertex] > cacheSize) {
+					timestamps[vertex] = time++;
+					statistics.vertexTransforms++;
+				}
+			}
+			return statistics;
+		}
+
+		inline uint32_t hashVertex(const void* vertex, size_t size)
+		{
+			// MurmurHash2 over the 32 bit words of the vertex
+			const uint32_t m = 0x5bd1e995;
+			uint32_t hash = 0;
+			const unsigned char* data = static_cast<const unsigned char*>(vertex);
+			for (size_t i = 0; i < size; i += 4) {
+				uint32_t k;
+				memcpy(&k, data + i, sizeof(k));
+				k *= m;
+				k ^= k >> 24;
+				k *= m;
+				hash = (hash * m) ^ k;
+			}
+			hash ^= hash >> 13;
+			hash *= m;
+			hash ^= hash >> 15;
+			return hash;
+		}
+
+		/**
+		* Builds a table that maps all bitwise identical vertices to the same new index
+		*
+		* @param remap Receives the new index for each vertex, unusedVertex for vertices that aren't referenced
+		* @return Number of unique vertices, new indices are assigned in the order vertices are first referenced
+		*/
+		template<typename T>
+		size_t generateVertexRemap(uint32_t* remap, const uint32_t* indices, size_t indexCount, const T* vertices, size_t vertexCount)
+		{
+			static_assert(sizeof(T) % 4 == 0, "Vertices are hashed as 32 bit words");
+			std::fill(remap, remap + vertexCount, unusedVertex);
+			// Open addressing with linear probing, the table is kept at most half full
+			size_t tableSize = 1;
+			while (tableSize < vertexCount * 2) {
+				tableSize *= 2;
+			}
+			const size_t tableMask = tableSize - 1;
+			std::vector<uint32_t> table(tableSize, unusedVertex);
+			uint32_t uniqueCount = 0;
+			for (size_t i = 0; i < indexCount; i++) {
+				const uint32_t vertex = indices[i];
+				assert(vertex < vertexCount);
+				if (remap[vertex] != unusedVertex) {
+					continue;
+				}
+				size_t bucket = hashVertex(&vertices[vertex], sizeof(T)) & tableMask;
+				while ((table[bucket] != unusedVertex) && (memcmp(&vertices[table[bucket]], &vertices[vertex], sizeof(T)) != 0)) {
+					bucket = (bucket + 1) & tableMask;
+				}
+				if (table[bucket] == unusedVertex) {
+					table[bucket] = vertex;
+					remap[vertex] = uniqueCount++;
+				} else {
+					remap[vertex] = remap[table[bucket]];
+				}
+			}
+			return uniqueCount;
+		}
+
+		/** @brief Writes the vertices to their new positions in the destination, which must not overlap the source */
+		template<typename T>
+		void remapVertexBuffer(T* destination, const T* vertices, size_t vertexCount, const uint32_t* remap)
+		{
+			for (size_t i = 0; i < vertexCount; i++) {
+				if (remap[i] != unusedVertex) {
+					destination[remap[i]] = vertices[i];
+				}
+			}
+		}
+
+		inline void remapIndexBuffer(uint32_t* indices, size_t indexCount, const uint32_t* remap)
+		{
+			for (size_t i = 0; i < indexCount; i++) {
+				indices[i] = remap[indices[i]];
+			}
+		}
+
+		/**
+		* Reorders triangles to reduce the number of vertex transforms with Tipsify
+		* Triangles are emitted in fans around vertices, the next fan is centered on a vertex of the current one that will still
+		* be in the cache after its remaining triangles have been emitted
+		*
+		* @param destination Receives the reordered indices, may be the same as indices
+		*/
+		inline void optimizeVertexCache(uint32_t* destination, const uint32_t* indices, size_t indexCount, size_t vertexCount, uint32_t cacheSize = defaultCacheSize)
+		{
+			assert(indexCount % 3 == 0);
+			if (indexCount == 0) {
+				return;
+			}
+			std::vector<uint32_t> source;
+			if (destination == indices) {
+				source.assign(indices, indices + indexCount);
+				indices = source.data();
+			}
+			const size_t triangleCount = indexCount / 3;
+
+			// Triangles adjacent to each vertex, liveCount tracks the ones that haven't been emitted yet
+			std::vector<uint32_t> liveCount(vertexCount, 0);
+			for (size_t i = 0; i < indexCount; i++) {
+				liveCount[indices[i]]++;
+			}
+			std::vector<uint32_t> adjacencyOffsets(vertexCount + 1, 0);
+			for (size_t v = 0; v < vertexCount; v++) {
+				adjacencyOffsets[v + 1] = adjacencyOffsets[v] + liveCount[v];
+			}
+			std::vector<uint32_t> adjacency(indexCount);
+			std::vector<uint32_t> adjacencyCursor(adjacencyOffsets.begin(), adjacencyOffsets.end() - 1);
+			for (size_t i = 0; i < indexCount; i++) {
+				adjacency[adjacencyCursor[indices[i]]++] = static_cast<uint32_t>(i / 3);
+			}
+
+			std::vector<uint32_t> timestamps(vertexCount, 0);
+			uint32_t time = cacheSize + 1;
+			std::vector<uint8_t> emitted(triangleCount, 0);
+			// Recently used vertices, used to continue close to the last fan when it has no live neighbours left
+			std::vector<uint32_t> deadEndStack;
+			deadEndStack.reserve(indexCount);
+			std::vector<uint32_t> candidates;
+			uint32_t scanCursor = 0;
+			size_t outputIndex = 0;
+
+			uint32_t fanningVertex = indices[0];
+			while (fanningVertex != unusedVertex) {
+				candidates.clear();
+				for (uint32_t a = adjacencyOffsets[fanningVertex]; a < adjacencyOffsets[fanningVertex + 1]; a++) {
+					const uint32_t triangle = adjacency[a];
+					if (emitted[triangle]) {
+						continue;
+					}
+					emitted[triangle] = 1;
+					for (uint32_t c = 0; c < 3; c++) {
+						const uint32_t vertex = indices[triangle * 3 + c];
+						destination[outputIndex++] = vertex;
+						deadEndStack.push_back(vertex);
+						candidates.push_back(vertex);
+						liveCount[vertex]--;
+						if (time - timestamps[vertex] > cacheSize) {
+							timestamps[vertex] = time++;
+						}
+					}
+				}
+
+				// Prefer the oldest candidate that stays cached while its remaining triangles are emitted
+				uint32_t nextVertex = unusedVertex;
+				int64_t bestPriority = -1;
+				for (uint32_t vertex : candidates) {
+					if (liveCount[vertex] == 0) {
+						continue;
+					}
+					int64_t priority = 0;
+					const uint32_t age = time - timestamps[vertex];
+					if (age + 2 * liveCount[vertex] <= cacheSize) {
+						priority = age;
+					}
+					if (priority > bestPriority) {
+						bestPriority = priority;
+						nextVertex = vertex;
+					}
+				}
+				// Dead end, continue with a recently used vertex or the next one in input order that still has triangles
+				while ((nextVertex == unusedVertex) && !deadEndStack.empty()) {
+					const uint32_t vertex = deadEndStack.back();
+					deadEndStack.pop_back();
+					if (liveCount[vertex] > 0) {
+						nextVertex = vertex;
+					}
+				}
+				while ((nextVertex == unusedVertex) && (scanCursor < vertexCount)) {
+					if (liveCount[scanCursor] > 0) {
+						nextVertex = scanCursor;
+					}
+					scanCursor++;
+				}
+				fanningVertex = nextVertex;
+			}
+			assert(outputIndex == indexCount);
+		}
+
+		/**
+		* Reorders clusters of triangles so that triangles facing away from the mesh center are drawn first
+		* Outer surfaces are more likely to occlude inner ones, drawing them first lets early depth testing reject more fragments
+		* The input should already be optimized for the vertex cache, clusters are split where this costs little cache efficiency
+		*
+		* @param destination Receives the reordered indices, may be the same as indices
+		* @param positions Vertex positions (three floats), positionStride bytes apart
+		* @param threshold Allowed increase of the cache miss ratio within a cluster, e.g. 1.05 allows 5% more vertex transforms
+		*/
+		inline void optimizeOverdraw(uint32_t* destination, const uint32_t* indices, size_t indexCount, const float* positions, size_t positionStride, size_t vertexCount, float threshold = 1.05f, uint32_t cacheSize = defaultCacheSize)
+		{
+			assert(indexCount % 3 == 0);
+			if (indexCount == 0) {
+				return;
+			}
+			std::vector<uint32_t> source;
+			if (destination == indices) {
+				source.assign(indices, indices + indexCount);
+				indices = source.data();
+			}
+			const uint32_t triangleCount = static_cast<uint32_t>(indexCount / 3);
+			auto position = [positions, positionStride](uint32_t vertex) {
+				glm::vec3 p;
+				memcpy(&p, reinterpret_cast<const unsigned char*>(positions) + vertex * positionStride, sizeof(p));
+				return p;
+			};
+
+			std::vector<uint32_t> timestamps(vertexCount, 0);
+			uint32_t time = cacheSize + 1;
+			auto triangleMisses = [&](uint32_t triangle) {
+				uint32_t misses = 0;
+				for (uint32_t c = 0; c < 3; c++) {
+					const uint32_t vertex = indices[triangle * 3 + c];
+					if (time - timestamps[vertex] > cacheSize) {
+						timestamps[vertex] = time++;
+						misses++;
+					}
+				}
+				return misses;
+			};
+
+			// Hard boundaries are triangles that miss all their vertices, the cache has been flushed before them anyway
+			std::vector<uint32_t> hardClusters;
+			for (uint32_t t = 0; t < triangleCount; t++) {
+				if ((triangleMisses(t) == 3) || (t == 0)) {
+					hardClusters.push_back(t);
+				}
+			}
+			hardClusters.push_back(triangleCount);
+
+			// Soft boundaries split hard clusters wherever restarting with an empty cache stays within the threshold
+			std::vector<uint32_t> clusters;
+			for (size_t h = 0; h + 1 < hardClusters.size(); h++) {
+				const uint32_t start = hardClusters[h];
+				const uint32_t end = hardClusters[h + 1];
+				time += cacheSize + 1;
+				uint32_t clusterMisses = 0;
+				for (uint32_t t = start; t < end; t++) {
+					clusterMisses += triangleMisses(t);
+				}
+				const float clusterThreshold = threshold * static_cast<float>(clusterMisses) / static_cast<float>(end - start);
+				time += cacheSize + 1;
+				uint32_t clusterStart = start;
+				uint32_t misses = 0;
+				clusters.push_back(start);
+				for (uint32_t t = start; t < end; t++) {
+					misses += triangleMisses(t);
+					if ((t + 1 < end) && (static_cast<float>(misses) <= clusterThreshold * static_cast<float>(t + 1 - clusterStart))) {
+						clusterStart = t + 1;
+						clusters.push_back(clusterStart);
+						misses = 0;
+						time += cacheSize + 1;
+					}
+				}
+				// A short last cluster that exceeds the threshold is appended to the previous one, where it starts with a warm cache
+				if ((clusterStart > start) && (static_cast<float>(misses) > clusterThreshold * static_cast<float>(end - clusterStart))) {
+					clusters.pop_back();
+				}
+			}
+			const size_t clusterCount = clusters.size();
+			clusters.push_back(triangleCount);
+
+			// Area weighted centers and normals of the clusters and the whole mesh
+			std::vector<glm::vec3> clusterCenters(clusterCount, glm::vec3(0.0f));
+			std::vector<glm::vec3> clusterNormals(clusterCount, glm::vec3(0.0f));
+			glm::vec3 meshCenter(0.0f);
+			float meshArea = 0.0f;
+			for (size_t c = 0; c < clusterCount; c++) {
+				float clusterArea = 0.0f;
+				for (uint32_t t = clusters[c]; t < clusters[c + 1]; t++) {
+					const glm::vec3 p0 = position(indices[t * 3]);
+					const glm::vec3 p1 = position(indices[t * 3 + 1]);
+					const glm::vec3 p2 = position(indices[t * 3 + 2]);
+					const glm::vec3 normal = glm::cross(p1 - p0, p2 - p0);
+					const float area = glm::length(normal);
+					clusterCenters[c] += (p0 + p1 + p2) * (area / 3.0f);
+					clusterNormals[c] += normal;
+					clusterArea += area;
+				}
+				meshCenter += clusterCenters[c];
+				meshArea += clusterArea;
+				clusterCenters[c] = (clusterArea > 0.0f) ? clusterCenters[c] / clusterArea : position(indices[clusters[c] * 3]);
+			}
+			meshCenter = (meshArea > 0.0f) ? meshCenter / meshArea : glm::vec3(0.0f);
+
+			struct SortKey {
+				float key;
+				uint32_t cluster;
+			};
+			std::vector<SortKey> sortKeys(clusterCount);
+			for (size_t c = 0; c < clusterCount; c++) {
+				const float normalLength = glm::length(clusterNormals[c]);
+				const float key = (normalLength > 0.0f) ? glm::dot(clusterCenters[c] - meshCenter, clusterNormals[c] / normalLength) : 0.0f;
+				sortKeys[c] = { key, static_cast<uint32_t>(c) };
+			}
+			std::stable_sort(sortKeys.begin(), sortKeys.end(), [](const SortKey& a, const SortKey& b) { return a.key > b.key; });
+
+			size_t outputIndex = 0;
+			for (const SortKey& sortKey : sortKeys) {
+				const uint32_t first = clusters[sortKey.cluster] * 3;
+				const uint32_t last = clusters[sortKey.cluster + 1] * 3;
+				memcpy(destination + outputIndex, indices + first, (last - first) * sizeof(uint32_t));
+				outputIndex += last - first;
+			}
+			assert(outputIndex == indexCount);
+		}
+
+		/**
+		* Reorders vertices in the order the indices first reference them, so vertex fetches access memory mostly sequentially
+		*
+		* @param destination Receives the reordered vertices, must not overlap the source
+		* @param indices Indices that are updated to the new vertex order
+		* @return Number of vertices written to the destination, vertices that aren't referenced are removed
+		*/
+		template<typename T>
+		size_t optimizeVertexFetch(T* destination, uint32_t* indices, size_t indexCount, const T* vertices, size_t vertexCount)
+		{
+			std::vector<uint32_t> remap(vertexCount, unusedVertex);
+			uint32_t usedCount = 0;
+			for (size_t i = 0; i < indexCount; i++) {
+				uint32_t& newIndex = remap[indices[i]];
+				if (newIndex == unusedVertex) {
+					newIndex = usedCount++;
+					destination[newIndex] = vertices[indices[i]];
+				}
+				indices[i] = newIndex;
+			}
+			return usedCount;
+		}
+
+		/** @brief Sum of weighted squared distances to a set of planes, stored as the symmetric matrix A, the vector b and c of p^T A p + 2 b.p + c */
+		struct Quadric {
+			float a00 = 0.0f, a11 = 0.0f, a22 = 0.0f;
+			float a10 = 0.0f, a20 = 0.0f, a21 = 0.0f;
+			float b0 = 0.0f, b1 = 0.0f, b2 = 0.0f;
+			float c = 0.0f;
+			float weight = 0.0f;
+
+			/** @brief Quadric of the plane dot(normal, p) + distance = 0, the normal has to be normalized */
+			static Quadric plane(const glm::vec3& normal, float distance, float weight)
+			{
+				Quadric q;
+				q.a00 = normal.x * normal.x * weight;
+				q.a11 = normal.y * normal.y * weight;
+				q.a22 = normal.z * normal.z * weight;
+				q.a10 = normal.y * normal.x * weight;
+				q.a20 = normal.z * normal.x * weight;
+				q.a21 = normal.z * normal.y * weight;
+				q.b0 = normal.x * distance * weight;
+				q.b1 = normal.y * distance * weight;
+				q.b2 = normal.z * distance * weight;
+				q.c = distance * distance * weight;
+				q.weight = weight;
+				return q;
+			}
+
+			void add(const Quadric& other)
+			{
+				a00 += other.a00; a11 += other.a11; a22 += other.a22;
+				a10 += other.a10; a20 += other.a20; a21 += other.a21;
+				b0 += other.b0; b1 += other.b1; b2 += other.b2;
+				c += other.c;
+				weight += other.weight;
+			}
+
+			/** @brief Weighted mean of the squared distances of p to the planes */
+			float error(const glm::vec3& p) const
+			{
+				const float rx = a00 * p.x + a10 * p.y + a20 * p.z + b0 * 2.0f;
+				const float ry = a10 * p.x + a11 * p.y + a21 * p.z + b1 * 2.0f;
+				const float rz = a20 * p.x + a21 * p.y + a22 * p.z + b2 * 2.0f;
+				const float r = rx * p.x + ry * p.y + rz * p.z + c;
+				return (weight > 0.0f) ? fabsf(r) / weight : 0.0f;
+			}
+		};
+
+		/** @brief Directed edges of a triangle list, grouped by their start vertex */
+		struct EdgeAdjacency {
+			std::vector<uint32_t> offsets;
+			std::vector<uint32_t> targets;
+
+			/** @param remap Optional table applied to the indices first, e.g. to connect vertices that share a position */
+			void build(const uint32_t* indices, size_t indexCount, size_t vertexCount, const uint32_t* remap = nullptr)
+			{
+				auto vertex = [indices, remap](size_t i) {
+					return remap ? remap[indices[i]] : indices[i];
+				};
+				offsets.assign(vertexCount + 1, 0);
+				for (size_t i = 0; i < indexCount; i++) {
+					offsets[vertex(i) + 1]++;
+				}
+				for (size_t v = 0; v < vertexCount; v++) {
+					offsets[v + 1] += offsets[v];
+				}
+				targets.resize(indexCount);
+				std::vector<uint32_t> cursor(offsets.begin(), offsets.end() - 1);
+				for (size_t i = 0; i < indexCount; i++) {
+					const size_t next = (i % 3 == 2) ? i - 2 : i + 1;
+					targets[cursor[vertex(i)]++] = vertex(next);
+				}
+			}
+
+			bool hasEdge(uint32_t from, uint32_t to) const
+			{
+				for (uint32_t e = offsets[from]; e < offsets[from + 1]; e++) {
+					if (targets[e] == to) {
+						return true;
+					}
+				}
+				return false;
+			}
+		};
+
+		/**
+		* Reduces the number of triangles with half edge collapses ordered by their quadric error (Garland and Heckbert,
+		* "Surface Simplification Using Quadric Error Metrics", 1997)
+		* A vertex is only collapsed onto one of its neighbours, so the result references a subset of the source vertices
+		* Vertices with the same position but different attributes form seams (e.g. UV or normal discontinuities), seam and border
+		* vertices may only slide along their seam or border and vertices where several of them meet are never moved
+		*
+		* @param destination Receives the simplified indices, needs room for indexCount indices, may be the same as indices
+		* @param positions Vertex positions (three floats), positionStride bytes apart
+		* @param targetIndexCount Simplification stops once the index count is at or below this
+		* @param targetError Simplification also stops before a collapse would exceed this error, in the units of the positions
+		* @param resultError Receives the largest error of the applied collapses, in the units of the positions
+		* @return Number of indices written to the destination
+		*/
+		inline size_t simplify(uint32_t* destination, const uint32_t* indices, size_t indexCount, const float* positions, size_t positionStride, size_t vertexCount, size_t targetIndexCount, float targetError = FLT_MAX, float* resultError = nullptr)
+		{
+			assert(indexCount % 3 == 0);
+			if (destination != indices) {
+				memcpy(destination, indices, indexCount * sizeof(uint32_t));
+			}
+			if (resultError) {
+				*resultError = 0.0f;
+			}
+			if ((indexCount <= targetIndexCount) || (vertexCount == 0)) {
+				return indexCount;
+			}
+
+			// Positions are normalized to the unit cube to keep the quadrics well conditioned
+			std::vector<glm::vec3> vertexPositions(vertexCount);
+			glm::vec3 boundsMin(FLT_MAX), boundsMax(-FLT_MAX);
+			for (size_t v = 0; v < vertexCount; v++) {
+				memcpy(&vertexPositions[v], reinterpret_cast<const unsigned char*>(positions) + v * positionStride, sizeof(glm::vec3));
+			}
+			for (size_t i = 0; i < indexCount; i++) {
+				boundsMin = glm::min(boundsMin, vertexPositions[indices[i]]);
+				boundsMax = glm::max(boundsMax, vertexPositions[indices[i]]);
+			}
+			const glm::vec3 extent = boundsMax - boundsMin;
+			float scale = std::max(extent.x, std::max(extent.y, extent.z));
+			if (scale <= 0.0f) {
+				scale = 1.0f;
+			}
+			for (glm::vec3& p : vertexPositions) {
+				p = (p - boundsMin) / scale;
+			}
+			const float maxError = (targetError < FLT_MAX) ? (targetError / scale) * (targetError / scale) : FLT_MAX;
+
+			// Vertices with bitwise identical positions are wedges of the same position, positionRemap maps them to the first one
+			// and wedges links them in a cycle
+			std::vector<uint32_t> positionRemap(vertexCount);
+			std::vector<uint32_t> wedges(vertexCount);
+			{
+				size_t tableSize = 1;
+				while (tableSize < vertexCount * 2) {
+					tableSize *= 2;
+				}
+				const size_t tableMask = tableSize - 1;
+				std::vector<uint32_t> table(tableSize, unusedVertex);
+				for (uint32_t v = 0; v < vertexCount; v++) {
+					size_t bucket = hashVertex(&vertexPositions[v], sizeof(glm::vec3)) & tableMask;
+					while ((table[bucket] != unusedVertex) && (memcmp(&vertexPositions[table[bucket]], &vertexPositions[v], sizeof(glm::vec3)) != 0)) {
+						bucket = (bucket + 1) & tableMask;
+					}
+					if (table[bucket] == unusedVertex) {
+						table[bucket] = v;
+						positionRemap[v] = v;
+						wedges[v] = v;
+					} else {
+						const uint32_t first = table[bucket];
+						positionRemap[v] = first;
+						wedges[v] = wedges[first];
+						wedges[first] = v;
+					}
+				}
+			}
+
+			EdgeAdjacency edges;
+			EdgeAdjacency positionEdges;
+			edges.build(destination, indexCount, vertexCount);
+
+			// Area weighted planes of the triangles, open edges add a perpendicular plane that keeps borders and seams in place
+			const float edgeWeight = 10.0f;
+			std::vector<Quadric> quadrics(vertexCount);
+			for (size_t i = 0; i < indexCount; i += 3) {
+				const glm::vec3 p0 = vertexPositions[destination[i]];
+				const glm::vec3 p1 = vertexPositions[destination[i + 1]];
+				const glm::vec3 p2 = vertexPositions[destination[i + 2]];
+				glm::vec3 normal = glm::cross(p1 - p0, p2 - p0);
+				const float area = glm::length(normal);
+				if (area == 0.0f) {
+					continue;
+				}
+				normal /= area;
+				const Quadric triangleQuadric = Quadric::plane(normal, -glm::dot(normal, p0), area * 0.5f);
+				for (uint32_t c = 0; c < 3; c++) {
+					quadrics[positionRemap[destination[i + c]]].add(triangleQuadric);
+				}
+				for (uint32_t c = 0; c < 3; c++) {
+					const uint32_t from = destination[i + c];
+					const uint32_t to = destination[i + (c + 1) % 3];
+					if (edges.hasEdge(to, from)) {
+						continue;
+					}
+					const glm::vec3 edge = vertexPositions[to] - vertexPositions[from];
+					const float edgeLength = glm::length(edge);
+					if (edgeLength == 0.0f) {
+						continue;
+					}
+					const glm::vec3 edgeNormal = glm::normalize(glm::cross(edge, normal));
+					const Quadric edgeQuadric = Quadric::plane(edgeNormal, -glm::dot(edgeNormal, vertexPositions[from]), edgeLength * edgeLength * edgeWeight);
+					quadrics[positionRemap[from]].add(edgeQuadric);
+					quadrics[positionRemap[to]].add(edgeQuadric);
+				}
+			}
+
+			enum VertexKind : uint8_t { Manifold, Border, Seam, Locked };
+			std::vector<uint8_t> kinds(vertexCount);
+			// Following and preceding vertex along the open edge of a border or seam vertex
+			std::vector<uint32_t> loop(vertexCount);
+			std::vector<uint32_t> loopBack(vertexCount);
+			std::vector<uint32_t> openOut(vertexCount);
+			std::vector<uint32_t> openIn(vertexCount);
+			std::vector<uint32_t> positionOpen(vertexCount);
+			std::vector<uint8_t> referenced(vertexCount);
+			std::vector<uint32_t> triangleOffsets(vertexCount + 1);
+			std::vector<uint32_t> triangleAdjacency;
+			std::vector<uint32_t> collapseRemap(vertexCount);
+			std::vector<uint8_t> collapseLocked(vertexCount);
+
+			struct Collapse {
+				uint32_t from;
+				uint32_t to;
+				float error;
+			};
+			std::vector<Collapse> collapses;
+
+			float resultMaxError = 0.0f;
+			size_t currentIndexCount = indexCount;
+			while (currentIndexCount > targetIndexCount) {
+				// Classify the vertices on the current topology, collapses change which vertices are on borders
+				edges.build(destination, currentIndexCount, vertexCount);
+				positionEdges.build(destination, currentIndexCount, vertexCount, positionRemap.data());
+				std::fill(loop.begin(), loop.end(), unusedVertex);
+				std::fill(loopBack.begin(), loopBack.end(), unusedVertex);
+				std::fill(openOut.begin(), openOut.end(), 0);
+				std::fill(openIn.begin(), openIn.end(), 0);
+				std::fill(positionOpen.begin(), positionOpen.end(), 0);
+				std::fill(referenced.begin(), referenced.end(), 0);
+				for (size_t i = 0; i < currentIndexCount; i++) {
+					referenced[destination[i]] = 1;
+				}
+				for (uint32_t v = 0; v < vertexCount; v++) {
+					for (uint32_t e = edges.offsets[v]; e < edges.offsets[v + 1]; e++) {
+						const uint32_t w = edges.targets[e];
+						if (!edges.hasEdge(w, v)) {
+							openOut[v]++;
+							openIn[w]++;
+							loop[v] = w;
+							loopBack[w] = v;
+						}
+					}
+					for (uint32_t e = positionEdges.offsets[v]; e < positionEdges.offsets[v + 1]; e++) {
+						const uint32_t w = positionEdges.targets[e];
+						if (!positionEdges.hasEdge(w, v)) {
+							positionOpen[v]++;
+							positionOpen[w]++;
+						}
+					}
+				}
+				for (uint32_t v = 0; v < vertexCount; v++) {
+					if (positionRemap[v] != v) {
+						continue;
+					}
+					uint32_t wedgeCount = 0;
+					uint32_t wedge[2] = { v, v };
+					uint32_t w = v;
+					do {
+						if (referenced[w]) {
+							if (wedgeCount < 2) {
+								wedge[wedgeCount] = w;
+							}
+							wedgeCount++;
+						}
+						w = wedges[w];
+					} while (w != v);
+					uint8_t kind = Locked;
+					auto simpleOpen = [&](uint32_t x) {
+						return (openOut[x] == 1) && (openIn[x] == 1);
+					};
+					if (wedgeCount == 1) {
+						if ((openOut[wedge[0]] == 0) && (openIn[wedge[0]] == 0)) {
+							kind = Manifold;
+						} else if (simpleOpen(wedge[0])) {
+							kind = Border;
+						}
+					} else if ((wedgeCount == 2) && (positionOpen[v] == 0) && simpleOpen(wedge[0]) && simpleOpen(wedge[1])) {
+						kind = Seam;
+					}
+					w = v;
+					do {
+						kinds[w] = kind;
+						w = wedges[w];
+					} while (w != v);
+				}
+
+				// A seam vertex moves together with its other wedge, which has to slide along the other side of the same seam
+				auto seamTarget = [&](uint32_t from, uint32_t to) {
+					uint32_t sibling = wedges[from];
+					while ((sibling != from) && !referenced[sibling]) {
+						sibling = wedges[sibling];
+					}
+					if ((loop[sibling] != unusedVertex) && (positionRemap[loop[sibling]] == positionRemap[to])) {
+						return loop[sibling];
+					}
+					if ((loopBack[sibling] != unusedVertex) && (positionRemap[loopBack[sibling]] == positionRemap[to])) {
+						return loopBack[sibling];
+					}
+					return unusedVertex;
+				};
+				auto canCollapse = [&](uint32_t from, uint32_t to) {
+					switch (kinds[from]) {
+					case Manifold:
+						return true;
+					case Border:
+						return ((kinds[to] == Border) || (kinds[to] == Locked)) && ((to == loop[from]) || (to == loopBack[from]));
+					case Seam:
+						return ((kinds[to] == Seam) || (kinds[to] == Locked)) && ((to == loop[from]) || (to == loopBack[from])) && (seamTarget(from, to) != unusedVertex);
+					default:
+						return false;
+					}
+				};
+
+				collapses.clear();
+				for (size_t i = 0; i < currentIndexCount; i++) {
+					const uint32_t a = destination[i];
+					const uint32_t b = destination[(i % 3 == 2) ? i - 2 : i + 1];
+					// Inner edges are visited from both of their triangles, only one of them adds the candidate
+					if ((positionRemap[a] == positionRemap[b]) || ((a > b) && edges.hasEdge(b, a))) {
+						continue;
+					}
+					Collapse collapse = { unusedVertex, unusedVertex, FLT_MAX };
+					if (canCollapse(a, b)) {
+						collapse = { a, b, quadrics[positionRemap[a]].error(vertexPositions[b]) };
+					}
+					if (canCollapse(b, a)) {
+						const float error = quadrics[positionRemap[b]].error(vertexPositions[a]);
+						if (error < collapse.error) {
+							collapse = { b, a, error };
+						}
+					}
+					if ((collapse.from != unusedVertex) && (collapse.error <= maxError)) {
+						collapses.push_back(collapse);
+					}
+				}
+				if (collapses.empty()) {
+					break;
+				}
+				std::sort(collapses.begin(), collapses.end(), [](const Collapse& a, const Collapse& b) { return a.error < b.error; });
+
+				// Triangles around each vertex, used to reject collapses that would flip a triangle
+				std::fill(triangleOffsets.begin(), triangleOffsets.end(), 0);
+				for (size_t i = 0; i < currentIndexCount; i++) {
+					triangleOffsets[destination[i] + 1]++;
+				}
+				for (size_t v = 0; v < vertexCount; v++) {
+					triangleOffsets[v + 1] += triangleOffsets[v];
+				}
+				triangleAdjacency.resize(currentIndexCount);
+				{
+					std::vector<uint32_t> cursor(triangleOffsets.begin(), triangleOffsets.end() - 1);
+					for (size_t i = 0; i < currentIndexCount; i++) {
+						triangleAdjacency[cursor[destination[i]]++] = static_cast<uint32_t>(i / 3);
+					}
+				}
+				auto flipsTriangles = [&](uint32_t from, uint32_t to) {
+					const glm::vec3 target = vertexPositions[to];
+					for (uint32_t a = triangleOffsets[from]; a < triangleOffsets[from + 1]; a++) {
+						const uint32_t* triangle = destination + triangleAdjacency[a] * 3;
+						const uint32_t corner = (triangle[0] == from) ? 0 : ((triangle[1] == from) ? 1 : 2);
+						const uint32_t v1 = triangle[(corner + 1) % 3];
+						const uint32_t v2 = triangle[(corner + 2) % 3];
+						// Triangles that contain the target are removed by the collapse
+						if ((positionRemap[v1] == positionRemap[to]) || (positionRemap[v2] == positionRemap[to])) {
+							continue;
+						}
+						const glm::vec3 p1 = vertexPositions[v1];
+						const glm::vec3 p2 = vertexPositions[v2];
+						const glm::vec3 before = glm::cross(p1 - vertexPositions[from], p2 - vertexPositions[from]);
+						const glm::vec3 after = glm::cross(p1 - target, p2 - target);
+						if (glm::dot(before, after) <= 0.0f) {
+							return true;
+						}
+					}
+					return false;
+				};
+
+				// The triangles around a collapsed vertex change shape, so none of their vertices may move again in the same pass,
+				// otherwise later flip tests would look at positions that are already outdated
+				auto lockTriangles = [&](uint32_t vertex) {
+					for (uint32_t a = triangleOffsets[vertex]; a < triangleOffsets[vertex + 1]; a++) {
+						const uint32_t* triangle = destination + triangleAdjacency[a] * 3;
+						for (uint32_t corner = 0; corner < 3; corner++) {
+							collapseLocked[positionRemap[triangle[corner]]] = 1;
+						}
+					}
+				};
+
+				// Apply the cheapest collapses until enough triangles are removed, each position is changed at most once per pass
+				for (uint32_t v = 0; v < vertexCount; v++) {
+					collapseRemap[v] = v;
+				}
+				std::fill(collapseLocked.begin(), collapseLocked.end(), 0);
+				const size_t triangleGoal = (currentIndexCount - targetIndexCount + 2) / 3;
+				size_t removedTriangles = 0;
+				for (const Collapse& collapse : collapses) {
+					const uint32_t fromPosition = positionRemap[collapse.from];
+					const uint32_t toPosition = positionRemap[collapse.to];
+					if (collapseLocked[fromPosition] || collapseLocked[toPosition]) {
+						continue;
+					}
+					uint32_t sibling = unusedVertex;
+					uint32_t siblingTarget = unusedVertex;
+					if (kinds[collapse.from] == Seam) {
+						siblingTarget = seamTarget(collapse.from, collapse.to);
+						sibling = wedges[collapse.from];
+						while (!referenced[sibling]) {
+							sibling = wedges[sibling];
+						}
+					}
+					if (flipsTriangles(collapse.from, collapse.to) || ((sibling != unusedVertex) && flipsTriangles(sibling, siblingTarget))) {
+						continue;
+					}
+					collapseRemap[collapse.from] = collapse.to;
+					if (sibling != unusedVertex) {
+						collapseRemap[sibling] = siblingTarget;
+					}
+					quadrics[toPosition].add(quadrics[fromPosition]);
+					collapseLocked[fromPosition] = 1;
+					collapseLocked[toPosition] = 1;
+					lockTriangles(collapse.from);
+					if (sibling != unusedVertex) {
+						lockTriangles(sibling);
+					}
+					resultMaxError = std::max(resultMaxError, collapse.error);
+					// Collapsing an inner edge removes two triangles, a border edge only has one
+					removedTriangles += (kinds[collapse.from] == Border) ? 1 : 2;
+					if (removedTriangles >= triangleGoal) {
+						break;
+					}
+				}
+
+				// Remove the triangles that became degenerate
+				size_t writeIndex = 0;
+				for (size_t i = 0; i < currentIndexCount; i += 3) {
+					const uint32_t a = collapseRemap[destination[i]];
+					const uint32_t b = collapseRemap[destination[i + 1]];
+					const uint32_t c = collapseRemap[destination[i + 2]];
+					if ((positionRemap[a] == positionRemap[b]) || (positionRemap[b] == positionRemap[c]) || (positionRemap[a] == positionRemap[c])) {
+						continue;
+					}
+					destination[writeIndex++] = a;
+					destination[writeIndex++] = b;
+					destination[writeIndex++] = c;
+				}
+				if (writeIndex == currentIndexCount) {
+					break;
+				}
+				currentIndexCount = writeIndex;
+			}
+
+			if (resultError) {
+				*resultError = sqrtf(resultMaxError) * scale;
+			}
+			return currentIndexCount;
+		}
+	}
+}
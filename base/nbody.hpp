@@ -0,0 +1,434 @@
+/*
+* Barnes-Hut N-body simulation on the CPU
+*
+* Particles are sorted along a Morton (Z-order) curve every step, which turns the octree build into splitting sorted
+* ranges where their codes start to differ. Nodes are stored depth first together with the index of the node following
+* their subtree, so the force evaluation walks the tree without a stack: a node that is far enough away for its center
+* of mass to stand in for all of its particles is skipped over, otherwise traversal continues with its first child. This
+* brings a step down from O(N^2) to O(N log N). The force law is the one of the computenbody compute shaders, and the all
+* pairs step is included as the reference the approximation is validated against.
+*
+* This code is licensed under the MIT license (MIT) (http://opensource.org/licenses/MIT)
+*/
+
+#pragma once
+
+#include <vector>
+#include <algorithm>
+#include <random>
+#include <atomic>
+#include <math.h>
+#include <float.h>
+#include <stdint.h>
+#include <glm/glm.hpp>
+
+#include "jobsystem.hpp"
+
+namespace vks
+{
+	namespace nbody
+	{
+		/** @brief Particle layout shared with the computenbody shaders */
+		struct Particle
+		{
+			/** @brief xyz = position, w = mass */
+			glm::vec4 pos;
+			/** @brief xyz = velocity, w = gradient texture position */
+			glm::vec4 vel;
+		};
+
+		/** @brief Force law parameters (the specialization constants of the compute shader) and accuracy of the approximation */
+		struct Settings
+		{
+			float gravity = 0.002f;
+			float power = 0.75f;
+			float soften = 0.05f;
+			/** @brief Opening angle, cells that appear smaller than this (size / distance) are replaced by their center of mass, 0 is exact */
+			float theta = 0.7f;
+			/** @brief Maximum number of particles in a leaf node */
+			uint32_t leafSize = 8;
+		};
+
+		/** @brief gravity * delta * mass / (|delta|^2 + soften)^power, as evaluated by particle_calculate.comp */
+		class ForceLaw
+		{
+		private:
+			float gravity;
+			float power;
+			float soften;
+			bool threeQuarterPower;
+		public:
+			explicit ForceLaw(const Settings& settings) : gravity(settings.gravity), power(settings.power), soften(settings.soften), threeQuarterPower(settings.power == 0.75f) {}
+
+			inline glm::vec3 operator()(const glm::vec3& delta, float mass) const
+			{
+				const float d = glm::dot(delta, delta) + soften;
+				// Two square roots are a lot cheaper than pow for the default exponent
+				const float scale = threeQuarterPower ? 1.0f / (sqrtf(d) * sqrtf(sqrtf(d))) : powf(d, -power);
+				return delta * (gravity * mass * scale);
+			}
+		};
+
+		/**
+		* Creates a rotating cloud of particles around each attractor, the first particle of each group is a heavy center of gravity
+		* The gradient position is the same for all particles of a group, so groups are colored differently
+		*/
+		inline std::vector<Particle> createAttractorSystem(const std::vector<glm::vec3>& attractors, uint32_t particlesPerAttractor, uint32_t seed)
+		{
+			std::vector<Particle> particles(attractors.size() * particlesPerAttractor);
+			std::default_random_engine rndEngine(seed);
+			std::normal_distribution<float> rndDist(0.0f, 1.0f);
+			for (uint32_t i = 0; i < static_cast<uint32_t>(attractors.size()); i++) {
+				for (uint32_t j = 0; j < particlesPerAttractor; j++) {
+					Particle& particle = particles[i * particlesPerAttractor + j];
+					if (j == 0) {
+						particle.pos = glm::vec4(attractors[i] * 1.5f, 90000.0f);
+						particle.vel = glm::vec4(0.0f);
+					} else {
+						glm::vec3 position(attractors[i] + glm::vec3(rndDist(rndEngine), rndDist(rndEngine), rndDist(rndEngine)) * 0.75f);
+						float len = glm::length(glm::normalize(position - attractors[i]));
+						position.y *= 2.0f - (len * len);
+						glm::vec3 angular = glm::vec3(0.5f, 1.5f, 0.5f) * (((i % 2) == 0) ? 1.0f : -1.0f);
+						glm::vec3 velocity = glm::cross((position - attractors[i]), angular) + glm::vec3(rndDist(rndEngine), rndDist(rndEngine), rndDist(rndEngine) * 0.025f);
+						float mass = (rndDist(rndEngine) * 0.5f + 0.5f) * 75.0f;
+						particle.pos = glm::vec4(position, mass);
+						particle.vel = glm::vec4(velocity, 0.0f);
+					}
+					particle.vel.w = (float)i * 1.0f / static_cast<uint32_t>(attractors.size());
+				}
+			}
+			return particles;
+		}
+
+		/** @brief Exact acceleration at a position, summed over all particles */
+		inline glm::vec3 directAcceleration(const std::vector<Particle>& particles, const glm::vec3& position, const Settings& settings)
+		{
+			const ForceLaw forceLaw(settings);
+			glm::vec3 acceleration(0.0f);
+			for (auto& particle : particles) {
+				acceleration += forceLaw(glm::vec3(particle.pos) - position, particle.pos.w);
+			}
+			return acceleration;
+		}
+
+		/** @brief First pass of a step: applies the acceleration and advances the gradient position (particle_calculate.comp) */
+		inline void accelerate(Particle& particle, const glm::vec3& acceleration, float deltaT)
+		{
+			particle.vel += glm::vec4(deltaT * acceleration, 0.0f);
+			particle.vel.w += 0.1f * deltaT;
+			if (particle.vel.w > 1.0f) {
+				particle.vel.w -= 1.0f;
+			}
+		}
+
+		/** @brief Second pass of a step: moves all particles by their velocity (particle_integrate.comp, which advances all four components) */
+		inline void integrate(std::vector<Particle>& particles, float deltaT, vks::JobSystem* jobSystem = nullptr)
+		{
+			auto integrateRange = [&](uint32_t begin, uint32_t end) {
+				for (uint32_t i = begin; i < end; i++) {
+					particles[i].pos += deltaT * particles[i].vel;
+				}
+			};
+			if (jobSystem) {
+				jobSystem->parallelFor(static_cast<uint32_t>(particles.size()), 16384, integrateRange);
+			} else {
+				integrateRange(0, static_cast<uint32_t>(particles.size()));
+			}
+		}
+
+		/** @brief All pairs reference step with O(N^2) force evaluations, the same computation as the compute shaders */
+		inline void stepDirect(std::vector<Particle>& particles, float deltaT, const Settings& settings, vks::JobSystem* jobSystem = nullptr)
+		{
+			// Velocities are updated in place, positions stay unchanged until all accelerations are known
+			auto accelerateRange = [&](uint32_t begin, uint32_t end) {
+				for (uint32_t i = begin; i < end; i++) {
+					accelerate(particles[i], directAcceleration(particles, glm::vec3(particles[i].pos), settings), deltaT);
+				}
+			};
+			if (jobSystem) {
+				jobSystem->parallelFor(static_cast<uint32_t>(particles.size()), 64, accelerateRange);
+			} else {
+				accelerateRange(0, static_cast<uint32_t>(particles.size()));
+			}
+			integrate(particles, deltaT, jobSystem);
+		}
+
+		/** @brief Octree node, nodes are stored depth first */
+		struct Node
+		{
+			/** @brief xyz = center of mass, w = total mass */
+			glm::vec4 centerOfMass;
+			/** @brief The node has to be opened for positions closer to its center of mass than this (squared) */
+			float openingDistanceSquared;
+			/** @brief Index of the first node after this node's subtree, nodes without children (leaves) have next == index + 1 */
+			uint32_t next;
+			/** @brief Range of the (sorted) particles inside of the node */
+			uint32_t firstParticle;
+			uint32_t particleCount;
+		};
+
+		class BarnesHut
+		{
+		private:
+			// Bits per axis of the Morton codes, also the maximum depth of the tree
+			static const uint32_t maxLevel = 21;
+
+			Settings settings;
+			std::vector<Node> nodes;
+			std::vector<uint64_t> codes;
+			std::vector<uint32_t> order;
+			// Sort and reorder scratch memory, kept between steps
+			std::vector<uint64_t> codesScratch;
+			std::vector<uint32_t> orderScratch;
+			std::vector<Particle> particlesScratch;
+			glm::vec3 boundsMin;
+			float rootSize = 0.0f;
+			uint64_t interactionCount = 0;
+
+			// Spreads the lower 21 bits of a value out to every third bit
+			static uint64_t expandBits(uint64_t v)
+			{
+				v &= 0x1fffff;
+				v = (v | (v << 32)) & 0x1f00000000ffffull;
+				v = (v | (v << 16)) & 0x1f0000ff0000ffull;
+				v = (v | (v << 8)) & 0x100f00f00f00f00full;
+				v = (v | (v << 4)) & 0x10c30c30c30c30c3ull;
+				v = (v | (v << 2)) & 0x1249249249249249ull;
+				return v;
+			}
+
+			// Inverse of expandBits
+			static uint32_t compactBits(uint64_t v)
+			{
+				v &= 0x1249249249249249ull;
+				v = (v ^ (v >> 2)) & 0x10c30c30c30c30c3ull;
+				v = (v ^ (v >> 4)) & 0x100f00f00f00f00full;
+				v = (v ^ (v >> 8)) & 0x1f0000ff0000ffull;
+				v = (v ^ (v >> 16)) & 0x1f00000000ffffull;
+				v = (v ^ (v >> 32)) & 0x1fffffull;
+				return static_cast<uint32_t>(v);
+			}
+
+			// Least significant digit radix sort of the codes (eight bits per pass), order receives the sorted particle indices
+			// Passes in which all codes have the same digit are skipped, which is the case for most of the upper bits
+			void sortCodes()
+			{
+				const uint32_t count = static_cast<uint32_t>(codes.size());
+				order.resize(count);
+				for (uint32_t i = 0; i < count; i++) {
+					order[i] = i;
+				}
+				codesScratch.resize(count);
+				orderScratch.resize(count);
+				for (uint32_t shift = 0; shift < 64; shift += 8) {
+					uint32_t offsets[256] = {};
+					for (uint32_t i = 0; i < count; i++) {
+						offsets[(codes[i] >> shift) & 0xFF]++;
+					}
+					if (offsets[(codes[0] >> shift) & 0xFF] == count) {
+						continue;
+					}
+					uint32_t offset = 0;
+					for (uint32_t digit = 0; digit < 256; digit++) {
+						const uint32_t digitCount = offsets[digit];
+						offsets[digit] = offset;
+						offset += digitCount;
+					}
+					for (uint32_t i = 0; i < count; i++) {
+						const uint32_t target = offsets[(codes[i] >> shift) & 0xFF]++;
+						codesScratch[target] = codes[i];
+						orderScratch[target] = order[i];
+					}
+					codes.swap(codesScratch);
+					order.swap(orderScratch);
+				}
+			}
+
+			void buildNode(const std::vector<Particle>& particles, uint32_t begin, uint32_t end, uint32_t level)
+			{
+				// Descend while all particles fall into the same child cell, so there are no chains of nodes with a single child
+				while ((level < maxLevel) && (((codes[begin] ^ codes[end - 1]) >> (3 * (maxLevel - 1 - level))) == 0)) {
+					level++;
+				}
+
+				const uint32_t index = static_cast<uint32_t>(nodes.size());
+				nodes.push_back(Node());
+				glm::vec3 weightedPosition(0.0f);
+				float mass = 0.0f;
+				if ((end - begin <= settings.leafSize) || (level == maxLevel)) {
+					for (uint32_t i = begin; i < end; i++) {
+						weightedPosition += glm::vec3(particles[i].pos) * particles[i].pos.w;
+						mass += particles[i].pos.w;
+					}
+				} else {
+					// The particles of each child cell are a contiguous range of the sorted codes
+					const uint32_t shift = 3 * (maxLevel - 1 - level);
+					uint32_t childBegin = begin;
+					while (childBegin < end) {
+						const uint64_t lastCodeOfCell = (((codes[childBegin] >> shift) + 1) << shift) - 1;
+						const uint32_t childEnd = static_cast<uint32_t>(std::upper_bound(codes.begin() + childBegin, codes.begin() + end, lastCodeOfCell) - codes.begin());
+						const uint32_t child = static_cast<uint32_t>(nodes.size());
+						buildNode(particles, childBegin, childEnd, level + 1);
+						weightedPosition += glm::vec3(nodes[child].centerOfMass) * nodes[child].centerOfMass.w;
+						mass += nodes[child].centerOfMass.w;
+						childBegin = childEnd;
+					}
+				}
+
+				// The corner of the cell is given by the code bits above the cell's level
+				const uint32_t cellBits = 3 * (maxLevel - level);
+				const uint64_t cellCode = (codes[begin] >> cellBits) << cellBits;
+				const float quantum = rootSize / (float)(1u << maxLevel);
+				const float cellSize = rootSize / (float)(1u << level);
+				const glm::vec3 cellCenter = boundsMin + glm::vec3((float)compactBits(cellCode >> 2), (float)compactBits(cellCode >> 1), (float)compactBits(cellCode)) * quantum + glm::vec3(cellSize * 0.5f);
+
+				Node& node = nodes[index];
+				node.centerOfMass = glm::vec4((mass > 0.0f) ? weightedPosition / mass : cellCenter, mass);
+				node.next = static_cast<uint32_t>(nodes.size());
+				node.firstParticle = begin;
+				node.particleCount = end - begin;
+				// Opening criterion of Barnes and Hut, extended by the offset of the center of mass from the cell's center, so a
+				// position inside of the cell always opens it, even if the center of mass is off to one side
+				if (settings.theta > 0.0f) {
+					const float openingDistance = cellSize / settings.theta + glm::length(glm::vec3(node.centerOfMass) - cellCenter);
+					node.openingDistanceSquared = openingDistance * openingDistance;
+				} else {
+					node.openingDistanceSquared = FLT_MAX;
+				}
+			}
+
+		public:
+			explicit BarnesHut(const Settings& settings = Settings()) : settings(settings) {}
+
+			void setSettings(const Settings& settings)
+			{
+				this->settings = settings;
+			}
+
+			const Settings& getSettings() const
+			{
+				return settings;
+			}
+
+			/**
+			* Sorts the particles along a Morton curve and builds the octree for their current positions
+			* Particles are reordered, which also keeps particles that are close in space close in memory for the force evaluation
+			*
+			* @param particles Particles to build the tree for
+			* @param jobSystem (Optional) Job system used to compute the Morton codes in parallel
+			*/
+			void build(std::vector<Particle>& particles, vks::JobSystem* jobSystem = nullptr)
+			{
+				nodes.clear();
+				const uint32_t count = static_cast<uint32_t>(particles.size());
+				if (count == 0) {
+					return;
+				}
+
+				// The root cell is a cube around all particles
+				glm::vec3 boundsMax(-FLT_MAX);
+				boundsMin = glm::vec3(FLT_MAX);
+				for (auto& particle : particles) {
+					boundsMin = glm::min(boundsMin, glm::vec3(particle.pos));
+					boundsMax = glm::max(boundsMax, glm::vec3(particle.pos));
+				}
+				const glm::vec3 extent = boundsMax - boundsMin;
+				rootSize = std::max(std::max(std::max(extent.x, extent.y), extent.z), 1e-6f) * 1.0001f;
+
+				codes.resize(count);
+				const float scale = (float)(1u << maxLevel) / rootSize;
+				auto computeCodes = [&](uint32_t begin, uint32_t end) {
+					for (uint32_t i = begin; i < end; i++) {
+						const glm::vec3 cell = (glm::vec3(particles[i].pos) - boundsMin) * scale;
+						const uint64_t x = std::min((uint64_t)cell.x, (uint64_t)(1u << maxLevel) - 1);
+						const uint64_t y = std::min((uint64_t)cell.y, (uint64_t)(1u << maxLevel) - 1);
+						const uint64_t z = std::min((uint64_t)cell.z, (uint64_t)(1u << maxLevel) - 1);
+						codes[i] = (expandBits(x) << 2) | (expandBits(y) << 1) | expandBits(z);
+					}
+				};
+				if (jobSystem) {
+					jobSystem->parallelFor(count, 16384, computeCodes);
+				} else {
+					computeCodes(0, count);
+				}
+
+				sortCodes();
+				particlesScratch.resize(count);
+				for (uint32_t i = 0; i < count; i++) {
+					particlesScratch[i] = particles[order[i]];
+				}
+				particles.swap(particlesScratch);
+
+				buildNode(particles, 0, count, 0);
+			}
+
+			/** @brief Approximated acceleration at a position, the tree has to be built for the given particles */
+			glm::vec3 acceleration(const std::vector<Particle>& particles, const glm::vec3& position, uint64_t& interactions) const
+			{
+				const ForceLaw forceLaw(settings);
+				const uint32_t nodeCount = static_cast<uint32_t>(nodes.size());
+				glm::vec3 acceleration(0.0f);
+				uint32_t index = 0;
+				while (index < nodeCount) {
+					const Node& node = nodes[index];
+					const glm::vec3 delta = glm::vec3(node.centerOfMass) - position;
+					if (glm::dot(delta, delta) > node.openingDistanceSquared) {
+						// Far enough away, the whole subtree is replaced by its center of mass
+						acceleration += forceLaw(delta, node.centerOfMass.w);
+						interactions++;
+						index = node.next;
+					} else if (node.next == index + 1) {
+						// Leaves that are too close are summed up particle by particle
+						for (uint32_t i = node.firstParticle; i < node.firstParticle + node.particleCount; i++) {
+							acceleration += forceLaw(glm::vec3(particles[i].pos) - position, particles[i].pos.w);
+						}
+						interactions += node.particleCount;
+						index = node.next;
+					} else {
+						index++;
+					}
+				}
+				return acceleration;
+			}
+
+			/** @brief First pass of a step for all particles, the tree has to be built for the given particles */
+			void accelerate(std::vector<Particle>& particles, float deltaT, vks::JobSystem* jobSystem = nullptr)
+			{
+				std::atomic<uint64_t> interactions{ 0 };
+				// Positions are only read, so the velocities can be updated in place
+				auto accelerateRange = [&](uint32_t begin, uint32_t end) {
+					uint64_t rangeInteractions = 0;
+					for (uint32_t i = begin; i < end; i++) {
+						vks::nbody::accelerate(particles[i], acceleration(particles, glm::vec3(particles[i].pos), rangeInteractions), deltaT);
+					}
+					interactions.fetch_add(rangeInteractions, std::memory_order_relaxed);
+				};
+				if (jobSystem) {
+					jobSystem->parallelFor(static_cast<uint32_t>(particles.size()), 512, accelerateRange);
+				} else {
+					accelerateRange(0, static_cast<uint32_t>(particles.size()));
+				}
+				interactionCount = interactions.load();
+			}
+
+			/** @brief Advances the simulation by one step, reorders the particles */
+			void step(std::vector<Particle>& particles, float deltaT, vks::JobSystem* jobSystem = nullptr)
+			{
+				build(particles, jobSystem);
+				accelerate(particles, deltaT, jobSystem);
+				integrate(particles, deltaT, jobSystem);
+			}
+
+			const std::vector<Node>& getNodes() const
+			{
+				return nodes;
+			}
+
+			/** @brief Number of node and particle interactions evaluated by the last call to accelerate */
+			uint64_t getInteractionCount() const
+			{
+				return interactionCount;
+			}
+		};
+	}
+}
@@ -0,0 +1,333 @@
+/*
+* Procedural 3D noise (Ken Perlin's improved noise and fractal sums of it)
+*
+* The volume generator evaluates rows of voxels along the x axis. Along such a row the y and z coordinates are constant,
+* so the trilinear blend of the eight gradient corners of a lattice cell collapses into two linear functions of the x
+* offset inside of the cell. These four coefficients are computed once per cell the row passes through, the remaining
+* per voxel work (fade curve and blend) is done four voxels at a time with SSE2 or NEON (with a scalar fallback). Slices are
+* independent, so whole volumes can be split across the job system.
+*
+* This code is licensed under the MIT license (MIT) (http://opensource.org/licenses/MIT)
+*/
+
+#pragma once
+
+#include <vector>
+#include <algorithm>
+#include <numeric>
+#include <random>
+#include <math.h>
+#include <stdint.h>
+
+#include "jobsystem.hpp"
+
+#include "simd.hpp"
+
+namespace vks
+{
+	namespace noise
+	{
+		/** @brief Translation of Ken Perlin's JAVA implementation (http://mrl.nyu.edu/~perlin/noise/) with a seeded permutation table */
+		class PerlinNoise
+		{
+		private:
+			uint32_t permutations[512];
+			// The twelve gradient directions (and four repeats) selected by the low four bits of a hash
+			float gradientX[16], gradientY[16], gradientZ[16];
+
+			static float fade(float t)
+			{
+				return t * t * t * (t * (t * 6.0f - 15.0f) + 10.0f);
+			}
+
+			static float lerp(float t, float a, float b)
+			{
+				return a + t * (b - a);
+			}
+
+			static float grad(uint32_t hash, float x, float y, float z)
+			{
+				// Convert LO 4 bits of hash code into 12 gradient directions
+				uint32_t h = hash & 15;
+				float u = h < 8 ? x : y;
+				float v = h < 4 ? y : h == 12 || h == 14 ? x : z;
+				return ((h & 1) == 0 ? u : -u) + ((h & 2) == 0 ? v : -v);
+			}
+
+			friend class VolumeGenerator;
+
+		public:
+			explicit PerlinNoise(uint32_t seed)
+			{
+				// Generate random lookup for permutations containing all numbers from 0..255
+				std::vector<uint8_t> plookup(256);
+				std::iota(plookup.begin(), plookup.end(), 0);
+				std::default_random_engine rndEngine(seed);
+				std::shuffle(plookup.begin(), plookup.end(), rndEngine);
+				for (uint32_t i = 0; i < 256; i++) {
+					permutations[i] = permutations[256 + i] = plookup[i];
+				}
+				// The gradient function is linear in x, y and z, so its coefficients can be read back per hash
+				for (uint32_t h = 0; h < 16; h++) {
+					gradientX[h] = grad(h, 1.0f, 0.0f, 0.0f);
+					gradientY[h] = grad(h, 0.0f, 1.0f, 0.0f);
+					gradientZ[h] = grad(h, 0.0f, 0.0f, 1.0f);
+				}
+			}
+
+			/** @brief Evaluates the noise at a single point, returns a value in about [-1, 1] */
+			float noise(float x, float y, float z) const
+			{
+				// Find unit cube that contains point
+				const uint32_t X = (uint32_t)(int32_t)floorf(x) & 255;
+				const uint32_t Y = (uint32_t)(int32_t)floorf(y) & 255;
+				const uint32_t Z = (uint32_t)(int32_t)floorf(z) & 255;
+				// Find relative x,y,z of point in cube
+				x -= floorf(x);
+				y -= floorf(y);
+				z -= floorf(z);
+				// Compute fade curves for each of x,y,z
+				const float u = fade(x);
+				const float v = fade(y);
+				const float w = fade(z);
+				// Hash coordinates of the 8 cube corners
+				const uint32_t A = permutations[X] + Y;
+				const uint32_t AA = permutations[A] + Z;
+				const uint32_t AB = permutations[A + 1] + Z;
+				const uint32_t B = permutations[X + 1] + Y;
+				const uint32_t BA = permutations[B] + Z;
+				const uint32_t BB = permutations[B + 1] + Z;
+				// And add blended results for 8 corners of the cube
+				return lerp(w, lerp(v,
+					lerp(u, grad(permutations[AA], x, y, z), grad(permutations[BA], x - 1, y, z)), lerp(u, grad(permutations[AB], x, y - 1, z), grad(permutations[BB], x - 1, y - 1, z))),
+					lerp(v, lerp(u, grad(permutations[AA + 1], x, y, z - 1), grad(permutations[BA + 1], x - 1, y, z - 1)), lerp(u, grad(permutations[AB + 1], x, y - 1, z - 1), grad(permutations[BB + 1], x - 1, y - 1, z - 1))));
+			}
+
+			/** @brief Sum of octaves with doubling frequency and decreasing amplitude, remapped to about [0, 1] */
+			float fractalNoise(float x, float y, float z, uint32_t octaves = 6, float persistence = 0.5f) const
+			{
+				float sum = 0.0f;
+				float frequency = 1.0f;
+				float amplitude = 1.0f;
+				float max = 0.0f;
+				for (uint32_t i = 0; i < octaves; i++) {
+					sum += noise(x * frequency, y * frequency, z * frequency) * amplitude;
+					max += amplitude;
+					amplitude *= persistence;
+					frequency *= 2.0f;
+				}
+				sum = sum / max;
+				return (sum + 1.0f) / 2.0f;
+			}
+		};
+
+		/** @brief Parameters of a noise volume */
+		struct VolumeSettings
+		{
+			uint32_t width = 128;
+			uint32_t height = 128;
+			uint32_t depth = 128;
+			/** @brief Number of lattice cells across the volume for the first octave */
+			float scale = 8.0f;
+			uint32_t octaves = 6;
+			float persistence = 0.5f;
+		};
+
+		/**
+		* Fills 8 bit volumes with fractal noise
+		* Voxel (x, y, z) gets the fractional part of the fractal noise at (x / width, y / height, z / depth) * scale, the
+		* same values (up to rounding) as evaluating PerlinNoise::fractalNoise for every voxel
+		*/
+		class VolumeGenerator
+		{
+		private:
+			PerlinNoise perlin;
+			VolumeSettings settings;
+			// Row length rounded up to the SIMD width
+			uint32_t rowStride;
+
+			// Per row and octave tables of the gradient terms of the four corners of a cell's y/z face, already weighted with
+			// their share of the blend along y and z. Indexed by corner (y0z0, y1z0, y0z1, y1z1) and the hash of the corner.
+			struct RowOctave
+			{
+				uint32_t Y, Z;
+				float gradientX[4][16];
+				float gradientYZ[4][16];
+			};
+
+			void setupRowOctave(float py, float pz, RowOctave& row) const
+			{
+				const float fy = floorf(py);
+				const float fz = floorf(pz);
+				row.Y = (uint32_t)(int32_t)fy & 255;
+				row.Z = (uint32_t)(int32_t)fz & 255;
+				const float y = py - fy;
+				const float z = pz - fz;
+				const float v = PerlinNoise::fade(y);
+				const float w = PerlinNoise::fade(z);
+				for (uint32_t corner = 0; corner < 4; corner++) {
+					const uint32_t dy = corner & 1;
+					const uint32_t dz = corner >> 1;
+					const float weight = (dy ? v : 1.0f - v) * (dz ? w : 1.0f - w);
+					const float cy = y - (float)dy;
+					const float cz = z - (float)dz;
+					for (uint32_t h = 0; h < 16; h++) {
+						row.gradientX[corner][h] = weight * perlin.gradientX[h];
+						row.gradientYZ[corner][h] = weight * (perlin.gradientY[h] * cy + perlin.gradientZ[h] * cz);
+					}
+				}
+			}
+
+			// Noise inside of the cell along the row is lerp(fade(t), aL * t + bL, aR * (t - 1) + bR) for the offset t in [0, 1)
+			void cellCoefficients(uint32_t cell, const RowOctave& row, float* coefficients) const
+			{
+				const uint32_t* p = perlin.permutations;
+				const uint32_t X = cell & 255;
+				const uint32_t A = p[X] + row.Y;
+				const uint32_t AA = p[A] + row.Z;
+				const uint32_t AB = p[A + 1] + row.Z;
+				const uint32_t B = p[X + 1] + row.Y;
+				const uint32_t BA = p[B] + row.Z;
+				const uint32_t BB = p[B + 1] + row.Z;
+				const uint32_t left[4] = { p[AA] & 15, p[AB] & 15, p[AA + 1] & 15, p[AB + 1] & 15 };
+				const uint32_t right[4] = { p[BA] & 15, p[BB] & 15, p[BA + 1] & 15, p[BB + 1] & 15 };
+				float aL = 0.0f, bL = 0.0f, aR = 0.0f, bR = 0.0f;
+				for (uint32_t corner = 0; corner < 4; corner++) {
+					aL += row.gradientX[corner][left[corner]];
+					bL += row.gradientYZ[corner][left[corner]];
+					aR += row.gradientX[corner][right[corner]];
+					bR += row.gradientYZ[corner][right[corner]];
+				}
+				coefficients[0] = aL;
+				coefficients[1] = bL;
+				coefficients[2] = aR;
+				coefficients[3] = bR;
+			}
+
+			// Scratch memory of one thread: sum, offset in cell and the four coefficients per voxel of a row
+			struct Scratch
+			{
+				std::vector<float> nx;
+				std::vector<float> sum;
+				std::vector<float> t;
+				std::vector<float> aL, bL, aR, bR;
+			};
+
+			void generateRow(uint32_t y, uint32_t z, Scratch& scratch, uint8_t* destination) const
+			{
+				const float ny = (float)y / (float)settings.height;
+				const float nz = (float)z / (float)settings.depth;
+				float* sum = scratch.sum.data();
+				std::fill(scratch.sum.begin(), scratch.sum.end(), 0.0f);
+				float frequency = 1.0f;
+				float amplitude = 1.0f;
+				float max = 0.0f;
+				RowOctave row;
+				for (uint32_t octave = 0; octave < settings.octaves; octave++) {
+					setupRowOctave(ny * settings.scale * frequency, nz * settings.scale * frequency, row);
+					// Offsets and coefficients per voxel, coefficients only change when the row enters the next cell
+					uint32_t lastCell = UINT32_MAX;
+					float coefficients[4] = {};
+					for (uint32_t x = 0; x < settings.width; x++) {
+						// Coordinates are never negative, so truncation gives the cell
+						const float px = scratch.nx[x] * settings.scale * frequency;
+						const uint32_t cell = (uint32_t)px;
+						if (cell != lastCell) {
+							cellCoefficients(cell, row, coefficients);
+							lastCell = cell;
+						}
+						scratch.t[x] = px - (float)cell;
+						scratch.aL[x] = coefficients[0];
+						scratch.bL[x] = coefficients[1];
+						scratch.aR[x] = coefficients[2];
+						scratch.bR[x] = coefficients[3];
+					}
+					// Blend, the padding at the end of the row is evaluated too but never written to the destination
+					using namespace simd;
+					const float4 one = set(1.0f);
+					const float4 six = set(6.0f);
+					const float4 fifteen = set(15.0f);
+					const float4 ten = set(10.0f);
+					const float4 amplitude4 = set(amplitude);
+					for (uint32_t x = 0; x < rowStride; x += 4) {
+						const float4 t = load(&scratch.t[x]);
+						const float4 u = mul(mul(mul(t, t), t), add(mul(t, sub(mul(t, six), fifteen)), ten));
+						const float4 left = add(mul(load(&scratch.aL[x]), t), load(&scratch.bL[x]));
+						const float4 right = add(mul(load(&scratch.aR[x]), sub(t, one)), load(&scratch.bR[x]));
+						const float4 n = add(left, mul(u, sub(right, left)));
+						store(&sum[x], add(load(&sum[x]), mul(n, amplitude4)));
+					}
+					max += amplitude;
+					amplitude *= settings.persistence;
+					frequency *= 2.0f;
+				}
+				// Fractional part of the remapped sum, quantized to 8 bits
+				for (uint32_t x = 0; x < settings.width; x++) {
+					float n = (sum[x] / max + 1.0f) / 2.0f;
+					n = n - floorf(n);
+					destination[x] = static_cast<uint8_t>(n * 255.0f);
+				}
+			}
+
+		public:
+			VolumeGenerator(const PerlinNoise& perlin, const VolumeSettings& settings) : perlin(perlin), settings(settings)
+			{
+				rowStride = (settings.width + 3) & ~3u;
+			}
+
+			const VolumeSettings& getSettings() const
+			{
+				return settings;
+			}
+
+			/** @brief Size of a single slice in bytes */
+			size_t getSliceSize() const
+			{
+				return (size_t)settings.width * settings.height;
+			}
+
+			/**
+			* Generates a range of slices
+			* Can be called concurrently for different ranges
+			*
+			* @param firstSlice First slice (z) to generate
+			* @param sliceCount Number of slices to generate
+			* @param volume Start of the whole volume, slices are tightly packed with rows of width bytes
+			*/
+			void generateSlices(uint32_t firstSlice, uint32_t sliceCount, uint8_t* volume) const
+			{
+				Scratch scratch;
+				scratch.nx.resize(rowStride);
+				for (uint32_t x = 0; x < settings.width; x++) {
+					scratch.nx[x] = (float)x / (float)settings.width;
+				}
+				for (std::vector<float>* array : { &scratch.sum, &scratch.t, &scratch.aL, &scratch.bL, &scratch.aR, &scratch.bR }) {
+					array->resize(rowStride, 0.0f);
+				}
+				for (uint32_t z = firstSlice; z < firstSlice + sliceCount; z++) {
+					uint8_t* slice = volume + z * getSliceSize();
+					for (uint32_t y = 0; y < settings.height; y++) {
+						generateRow(y, z, scratch, slice + y * settings.width);
+					}
+				}
+			}
+
+			/**
+			* Generates the whole volume
+			*
+			* @param volume Destination with room for width * height * depth bytes
+			* @param jobSystem (Optional) Job system used to generate the slices in parallel
+			*/
+			void generate(uint8_t* volume, vks::JobSystem* jobSystem = nullptr) const
+			{
+				if (jobSystem) {
+					jobSystem->parallelFor(settings.depth, 1, [&](uint32_t begin, uint32_t end) {
+						generateSlices(begin, end - begin, volume);
+					});
+				} else {
+					generateSlices(0, settings.depth, volume);
+				}
+			}
+		};
+	}
+}
@@ -0,0 +1,442 @@
+/*
+* Structure of arrays CPU particle simulation
+*
+* Flame and smoke particles are kept in separate streams, each attribute in its own tightly packed array, so the update
+* runs without per particle branches on eight particles at once (AVX if enabled at compile time, two SSE2 or NEON
+* registers otherwise, with a scalar fallback, see simd.hpp). Streams are split into fixed size chunks that are updated
+* in parallel with the job system, particles that change their type or expire are collected per chunk and moved between
+* the streams in a short serial pass afterwards. Only live particles are written to the vertex buffer, so the draw count shrinks and grows with
+* the simulation instead of drawing a fixed number of (partially dead) particles.
+*
+* This code is licensed under the MIT license (MIT) (http://opensource.org/licenses/MIT)
+*/
+
+#pragma once
+
+#include <vector>
+#include <algorithm>
+#include <math.h>
+#include <string.h>
+#include <stdint.h>
+#include <glm/glm.hpp>
+
+#include "jobsystem.hpp"
+
+#include "simd.hpp"
+
+namespace vks
+{
+	namespace particles
+	{
+		enum class ParticleType : int32_t { Flame = 0, Smoke = 1 };
+
+		/** @brief Vertex layout of a particle as consumed by the point sprite shaders */
+		struct ParticleVertex
+		{
+			glm::vec3 pos;
+			/** @brief RGBA8 color */
+			uint32_t color;
+			float alpha;
+			float size;
+			float rotation;
+			int32_t type;
+		};
+
+		/** @brief Small and fast random number generator (xorshift), each chunk update uses its own instance */
+		struct Random
+		{
+			uint32_t state;
+
+			explicit Random(uint32_t seed)
+			{
+				// Scramble the seed, consecutive seeds would otherwise give correlated first values
+				seed ^= seed >> 16;
+				seed *= 0x7feb352du;
+				seed ^= seed >> 15;
+				seed *= 0x846ca68bu;
+				seed ^= seed >> 16;
+				state = seed ? seed : 0x9e3779b9u;
+			}
+
+			/** @brief Returns a uniformly distributed value in [0, range) */
+			float next(float range)
+			{
+				state ^= state << 13;
+				state ^= state >> 17;
+				state ^= state << 5;
+				return (float)(state >> 8) * (range / 16777216.0f);
+			}
+		};
+
+		/** @brief All particles of one type, one array per attribute with the length padded to a multiple of the SIMD width */
+		struct ParticleStream
+		{
+			ParticleType type;
+			uint32_t count = 0;
+			std::vector<float> posX, posY, posZ;
+			/** @brief Flames only move upwards, the horizontal velocity and the color are only stored for smoke */
+			std::vector<float> velX, velY, velZ;
+			std::vector<float> alpha;
+			std::vector<float> size;
+			std::vector<float> rotation;
+			std::vector<float> rotationSpeed;
+			std::vector<float> color;
+
+			explicit ParticleStream(ParticleType type) : type(type) {}
+
+			/** @brief Makes sure the arrays can hold at least the given number of particles */
+			void reserve(uint32_t particleCount)
+			{
+				const size_t length = (particleCount + 7) & ~7u;
+				if (posX.size() >= length) {
+					return;
+				}
+				for (std::vector<float>* array : { &posX, &posY, &posZ, &velY, &alpha, &size, &rotation, &rotationSpeed }) {
+					array->resize(length);
+				}
+				if (type == ParticleType::Smoke) {
+					for (std::vector<float>* array : { &velX, &velZ, &color }) {
+						array->resize(length);
+					}
+				}
+			}
+
+			/** @brief Appends a particle with undefined attributes and returns its index */
+			uint32_t add()
+			{
+				reserve(count + 1);
+				return count++;
+			}
+
+			/** @brief Removes a particle by moving the last one into its place */
+			void remove(uint32_t index)
+			{
+				const uint32_t last = --count;
+				posX[index] = posX[last];
+				posY[index] = posY[last];
+				posZ[index] = posZ[last];
+				velY[index] = velY[last];
+				alpha[index] = alpha[last];
+				size[index] = size[last];
+				rotation[index] = rotation[last];
+				rotationSpeed[index] = rotationSpeed[last];
+				if (type == ParticleType::Smoke) {
+					velX[index] = velX[last];
+					velZ[index] = velZ[last];
+					color[index] = color[last];
+				}
+			}
+
+			void clear()
+			{
+				count = 0;
+			}
+		};
+
+		/**
+		* Fire and smoke simulation
+		* Flames spawn in a sphere around the emitter, rise and fade out. Once faded out, a flame either turns into a smoke
+		* particle or respawns at the emitter. Smoke drifts away and is replaced by a new flame once it has faded out.
+		*/
+		class FireSimulation
+		{
+		private:
+			static constexpr float pi = 3.14159265358979f;
+
+		public:
+			/** @brief Number of particles per job, a multiple of the SIMD width */
+			static const uint32_t chunkSize = 4096;
+
+			glm::vec3 emitterPos = glm::vec3(0.0f, -6.0f, 0.0f);
+			glm::vec3 minVel = glm::vec3(-3.0f, 0.5f, -3.0f);
+			glm::vec3 maxVel = glm::vec3(3.0f, 7.0f, 3.0f);
+			float flameRadius = 8.0f;
+			/** @brief Probability of a faded out flame to turn into smoke */
+			float smokeChance = 0.05f;
+
+		private:
+			ParticleStream flames{ ParticleType::Flame };
+			ParticleStream smoke{ ParticleType::Smoke };
+			uint32_t particleCount = 0;
+			uint32_t frameIndex = 0;
+
+			// Particles leaving their stream, collected per chunk so the chunks can be updated without synchronization
+			// Indices are in ascending order within a chunk
+			struct ChunkEvents
+			{
+				std::vector<uint32_t> removedFlames;
+				std::vector<uint32_t> smokingFlames;
+				std::vector<uint32_t> removedSmoke;
+			};
+			std::vector<ChunkEvents> chunkEvents;
+
+			static uint32_t getChunkCount(uint32_t count)
+			{
+				return (count + chunkSize - 1) / chunkSize;
+			}
+
+			void spawnFlame(uint32_t index, Random& random)
+			{
+				flames.velY[index] = minVel.y + random.next(maxVel.y - minVel.y);
+				flames.alpha[index] = random.next(0.75f);
+				flames.size[index] = 1.0f + random.next(0.5f);
+				flames.rotation[index] = random.next(2.0f * pi);
+				flames.rotationSpeed[index] = random.next(2.0f) - random.next(2.0f);
+				// Random point inside of a sphere around the emitter
+				const float theta = random.next(2.0f * pi);
+				const float phi = random.next(pi) - pi / 2.0f;
+				const float r = random.next(flameRadius);
+				flames.posX[index] = emitterPos.x + r * cosf(theta) * cosf(phi);
+				flames.posY[index] = emitterPos.y + r * sinf(phi);
+				flames.posZ[index] = emitterPos.z + r * sinf(theta) * cosf(phi);
+			}
+
+			void spawnSmoke(uint32_t flame, Random& random)
+			{
+				const uint32_t index = smoke.add();
+				smoke.posX[index] = flames.posX[flame] * 0.5f;
+				smoke.posY[index] = flames.posY[flame];
+				smoke.posZ[index] = flames.posZ[flame] * 0.5f;
+				smoke.velX[index] = random.next(1.0f) - random.next(1.0f);
+				smoke.velY[index] = (minVel.y * 2.0f) + random.next(maxVel.y - minVel.y);
+				smoke.velZ[index] = random.next(1.0f) - random.next(1.0f);
+				smoke.alpha[index] = 0.0f;
+				smoke.size[index] = 1.0f + random.next(0.5f);
+				smoke.rotation[index] = flames.rotation[flame];
+				smoke.rotationSpeed[index] = random.next(1.0f) - random.next(1.0f);
+				smoke.color[index] = 0.25f + random.next(0.25f);
+			}
+
+			void updateFlames(uint32_t chunk, float particleTimer)
+			{
+				ChunkEvents& events = chunkEvents[chunk];
+				Random random(frameIndex * 0x10001u + chunk * 2);
+				const simd::float8 riseSpeed = simd::set8(-particleTimer * 3.5f);
+				const simd::float8 fadeSpeed = simd::set8(particleTimer * 2.5f);
+				const simd::float8 shrinkSpeed = simd::set8(particleTimer * 0.5f);
+				const simd::float8 timer = simd::set8(particleTimer);
+				const simd::float8 maxAlpha = simd::set8(2.0f);
+				const uint32_t begin = chunk * chunkSize;
+				const uint32_t end = std::min(begin + chunkSize, flames.count);
+				for (uint32_t i = begin; i < end; i += 8) {
+					simd::store(&flames.posY[i], simd::madd(simd::load8(&flames.velY[i]), riseSpeed, simd::load8(&flames.posY[i])));
+					simd::store(&flames.size[i], simd::sub(simd::load8(&flames.size[i]), shrinkSpeed));
+					simd::store(&flames.rotation[i], simd::madd(simd::load8(&flames.rotationSpeed[i]), timer, simd::load8(&flames.rotation[i])));
+					const simd::float8 alpha = simd::add(simd::load8(&flames.alpha[i]), fadeSpeed);
+					simd::store(&flames.alpha[i], alpha);
+					// Lanes past the end of the stream are padding and must not be processed
+					uint32_t faded = simd::greater(alpha, maxAlpha);
+					if (end - i < 8) {
+						faded &= (1u << (end - i)) - 1u;
+					}
+					for (uint32_t lane = 0; faded != 0; lane++, faded >>= 1) {
+						if (faded & 1u) {
+							const uint32_t index = i + lane;
+							if (random.next(1.0f) < smokeChance) {
+								events.smokingFlames.push_back(index);
+								events.removedFlames.push_back(index);
+							} else {
+								spawnFlame(index, random);
+							}
+						}
+					}
+				}
+			}
+
+			void updateSmoke(uint32_t chunk, float particleTimer, float frameTimer)
+			{
+				ChunkEvents& events = chunkEvents[chunk];
+				const simd::float8 moveSpeed = simd::set8(-frameTimer);
+				const simd::float8 fadeSpeed = simd::set8(particleTimer * 1.25f);
+				const simd::float8 growSpeed = simd::set8(particleTimer * 0.125f);
+				const simd::float8 darkenSpeed = simd::set8(particleTimer * 0.05f);
+				const simd::float8 timer = simd::set8(particleTimer);
+				const simd::float8 maxAlpha = simd::set8(2.0f);
+				const uint32_t begin = chunk * chunkSize;
+				const uint32_t end = std::min(begin + chunkSize, smoke.count);
+				for (uint32_t i = begin; i < end; i += 8) {
+					simd::store(&smoke.posX[i], simd::madd(simd::load8(&smoke.velX[i]), moveSpeed, simd::load8(&smoke.posX[i])));
+					simd::store(&smoke.posY[i], simd::madd(simd::load8(&smoke.velY[i]), moveSpeed, simd::load8(&smoke.posY[i])));
+					simd::store(&smoke.posZ[i], simd::madd(simd::load8(&smoke.velZ[i]), moveSpeed, simd::load8(&smoke.posZ[i])));
+					simd::store(&smoke.size[i], simd::add(simd::load8(&smoke.size[i]), growSpeed));
+					simd::store(&smoke.color[i], simd::sub(simd::load8(&smoke.color[i]), darkenSpeed));
+					simd::store(&smoke.rotation[i], simd::madd(simd::load8(&smoke.rotationSpeed[i]), timer, simd::load8(&smoke.rotation[i])));
+					const simd::float8 alpha = simd::add(simd::load8(&smoke.alpha[i]), fadeSpeed);
+					simd::store(&smoke.alpha[i], alpha);
+					uint32_t faded = simd::greater(alpha, maxAlpha);
+					if (end - i < 8) {
+						faded &= (1u << (end - i)) - 1u;
+					}
+					for (uint32_t lane = 0; faded != 0; lane++, faded >>= 1) {
+						if (faded & 1u) {
+							events.removedSmoke.push_back(i + lane);
+						}
+					}
+				}
+			}
+
+			// Serial pass that moves the particles collected by the chunk updates between the streams
+			void applyEvents(uint32_t flameChunks, uint32_t smokeChunks)
+			{
+				Random random(frameIndex * 0x10001u + 0xffffu);
+				// Smoke is created from the flame's data, so this has to happen before the flames are removed
+				for (uint32_t c = 0; c < flameChunks; c++) {
+					for (uint32_t index : chunkEvents[c].smokingFlames) {
+						spawnSmoke(index, random);
+					}
+				}
+				// Removing in descending order keeps the remaining collected indices valid, as only particles behind them are moved
+				for (uint32_t c = flameChunks; c-- > 0;) {
+					const std::vector<uint32_t>& removed = chunkEvents[c].removedFlames;
+					for (size_t i = removed.size(); i-- > 0;) {
+						flames.remove(removed[i]);
+					}
+				}
+				uint32_t respawnCount = 0;
+				for (uint32_t c = flameChunks + smokeChunks; c-- > flameChunks;) {
+					const std::vector<uint32_t>& removed = chunkEvents[c].removedSmoke;
+					for (size_t i = removed.size(); i-- > 0;) {
+						smoke.remove(removed[i]);
+					}
+					respawnCount += static_cast<uint32_t>(removed.size());
+				}
+				// Faded out smoke is replaced by a new flame
+				for (uint32_t i = 0; i < respawnCount; i++) {
+					spawnFlame(flames.add(), random);
+				}
+			}
+
+		public:
+			/**
+			* Sets the number of particles to simulate, the number of live particles never exceeds this
+			* Additional particles are spawned right away, lowering the count restarts the simulation
+			*/
+			void setParticleCount(uint32_t count, uint32_t seed = 0)
+			{
+				if (count < getLiveCount()) {
+					reset();
+				}
+				particleCount = count;
+				flames.reserve(count);
+				Random random(seed ^ 0x5bd1e995u);
+				while (getLiveCount() < particleCount) {
+					const uint32_t index = flames.add();
+					spawnFlame(index, random);
+					// Start with the flames at different stages of their life time depending on their height
+					flames.alpha[index] = 1.0f - (fabsf(flames.posY[index] - emitterPos.y) / (flameRadius * 2.0f));
+				}
+			}
+
+			/** @brief Removes all particles */
+			void reset()
+			{
+				flames.clear();
+				smoke.clear();
+			}
+
+			/**
+			* Advances the simulation
+			*
+			* @param frameTimer Time step in seconds
+			* @param jobSystem (Optional) Job system used to update the chunks in parallel, runs on the calling thread if null
+			*/
+			void update(float frameTimer, vks::JobSystem* jobSystem = nullptr)
+			{
+				const float particleTimer = frameTimer * 0.45f;
+				const uint32_t flameChunks = getChunkCount(flames.count);
+				const uint32_t smokeChunks = getChunkCount(smoke.count);
+				const uint32_t chunkCount = flameChunks + smokeChunks;
+				if (chunkEvents.size() < chunkCount) {
+					chunkEvents.resize(chunkCount);
+				}
+				for (uint32_t c = 0; c < chunkCount; c++) {
+					chunkEvents[c].removedFlames.clear();
+					chunkEvents[c].smokingFlames.clear();
+					chunkEvents[c].removedSmoke.clear();
+				}
+				frameIndex++;
+				auto updateChunks = [&](uint32_t begin, uint32_t end) {
+					for (uint32_t c = begin; c < end; c++) {
+						if (c < flameChunks) {
+							updateFlames(c, particleTimer);
+						} else {
+							updateSmoke(c - flameChunks, particleTimer, frameTimer);
+						}
+					}
+				};
+				if (jobSystem) {
+					jobSystem->parallelFor(chunkCount, 1, updateChunks);
+				} else {
+					updateChunks(0, chunkCount);
+				}
+				applyEvents(flameChunks, smokeChunks);
+			}
+
+			/**
+			* Writes the vertices of all live particles, smoke first so it's drawn behind the flames
+			*
+			* @param vertices Destination with room for at least getLiveCount() vertices (e.g. a mapped vertex buffer)
+			* @param jobSystem (Optional) Job system used to write the chunks in parallel
+			* @return Number of vertices written
+			*/
+			uint32_t writeVertices(ParticleVertex* vertices, vks::JobSystem* jobSystem = nullptr) const
+			{
+				const uint32_t smokeChunks = getChunkCount(smoke.count);
+				const uint32_t chunkCount = smokeChunks + getChunkCount(flames.count);
+				auto writeChunks = [&](uint32_t begin, uint32_t end) {
+					for (uint32_t c = begin; c < end; c++) {
+						const bool isSmoke = c < smokeChunks;
+						const ParticleStream& stream = isSmoke ? smoke : flames;
+						const uint32_t first = (isSmoke ? c : c - smokeChunks) * chunkSize;
+						const uint32_t last = std::min(first + chunkSize, stream.count);
+						ParticleVertex* dst = vertices + (isSmoke ? 0 : smoke.count) + first;
+						const int32_t type = static_cast<int32_t>(stream.type);
+						for (uint32_t i = first; i < last; i++, dst++) {
+							dst->pos = glm::vec3(stream.posX[i], stream.posY[i], stream.posZ[i]);
+							dst->color = 0xffffffffu;
+							dst->alpha = stream.alpha[i];
+							dst->size = stream.size[i];
+							dst->rotation = stream.rotation[i];
+							dst->type = type;
+						}
+						if (isSmoke) {
+							dst = vertices + first;
+							for (uint32_t i = first; i < last; i++, dst++) {
+								const uint32_t gray = static_cast<uint32_t>(std::min(std::max(stream.color[i], 0.0f), 1.0f) * 255.0f + 0.5f);
+								dst->color = gray | (gray << 8) | (gray << 16) | 0xff000000u;
+							}
+						}
+					}
+				};
+				if (jobSystem) {
+					jobSystem->parallelFor(chunkCount, 1, writeChunks);
+				} else {
+					writeChunks(0, chunkCount);
+				}
+				return getLiveCount();
+			}
+
+			/** @brief Number of particles that are currently alive, can temporarily differ from the requested count */
+			uint32_t getLiveCount() const
+			{
+				return flames.count + smoke.count;
+			}
+
+			uint32_t getFlameCount() const
+			{
+				return flames.count;
+			}
+
+			uint32_t getSmokeCount() const
+			{
+				return smoke.count;
+			}
+
+			/** @brief Requested number of particles, also the upper bound for the number of live particles */
+			uint32_t getParticleCount() const
+			{
+				return particleCount;
+			}
+		};
+	}
+}
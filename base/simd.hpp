@@ -0,0 +1,116 @@
+/*
+* Shared SIMD detection and float vector wrappers
+*
+* Defines VKS_SIMD_AVX, VKS_SIMD_SSE2 or VKS_SIMD_NEON for the instruction sets enabled at compile time (AVX implies
+* SSE2) and provides four and eight wide float vectors on top of them with a scalar fallback. Eight wide vectors are
+* a single AVX register if available, two four wide vectors otherwise
+*
+* This code is licensed under the MIT license (MIT) (http://opensource.org/licenses/MIT)
+*/
+
+#pragma once
+
+#include <math.h>
+#include <string.h>
+#include <stdint.h>
+
+#if defined(__SSE2__) || defined(_M_X64) || defined(_M_AMD64) || (defined(_M_IX86_FP) && (_M_IX86_FP >= 2))
+#define VKS_SIMD_SSE2
+#include <emmintrin.h>
+#if defined(__AVX__)
+#define VKS_SIMD_AVX
+#include <immintrin.h>
+#endif
+#elif defined(__ARM_NEON) || defined(__ARM_NEON__)
+#define VKS_SIMD_NEON
+#include <arm_neon.h>
+#endif
+
+namespace vks
+{
+	namespace simd
+	{
+#if defined(VKS_SIMD_NEON)
+		// Collects the lane masks into four bits like _mm_movemask_ps
+		inline uint32_t movemask(uint32x4_t mask)
+		{
+			static const uint32_t bitValues[4] = { 1, 2, 4, 8 };
+			const uint32x4_t bits = vandq_u32(mask, vld1q_u32(bitValues));
+			uint32x2_t sum = vadd_u32(vget_low_u32(bits), vget_high_u32(bits));
+			sum = vpadd_u32(sum, sum);
+			return vget_lane_u32(sum, 0);
+		}
+#endif
+
+		/*
+			Four wide float vector
+		*/
+#if defined(VKS_SIMD_SSE2)
+		typedef __m128 float4;
+		inline float4 load(const float* p) { return _mm_loadu_ps(p); }
+		inline void store(float* p, float4 v) { _mm_storeu_ps(p, v); }
+		inline float4 set(float v) { return _mm_set1_ps(v); }
+		inline float4 add(float4 a, float4 b) { return _mm_add_ps(a, b); }
+		inline float4 sub(float4 a, float4 b) { return _mm_sub_ps(a, b); }
+		inline float4 mul(float4 a, float4 b) { return _mm_mul_ps(a, b); }
+		inline float4 abs(float4 a) { return _mm_andnot_ps(_mm_set1_ps(-0.0f), a); }
+		inline float4 rsqrt(float4 a) { return _mm_div_ps(_mm_set1_ps(1.0f), _mm_sqrt_ps(a)); }
+		// Returns b with the sign of a applied
+		inline float4 mulSign(float4 a, float4 b) { return _mm_xor_ps(b, _mm_and_ps(a, _mm_set1_ps(-0.0f))); }
+		// Return one bit per lane that is set if the comparison is true
+		inline uint32_t less(float4 a, float4 b) { return (uint32_t)_mm_movemask_ps(_mm_cmplt_ps(a, b)); }
+		inline uint32_t greater(float4 a, float4 b) { return (uint32_t)_mm_movemask_ps(_mm_cmpgt_ps(a, b)); }
+#elif defined(VKS_SIMD_NEON)
+		typedef float32x4_t float4;
+		inline float4 load(const float* p) { return vld1q_f32(p); }
+		inline void store(float* p, float4 v) { vst1q_f32(p, v); }
+		inline float4 set(float v) { return vdupq_n_f32(v); }
+		inline float4 add(float4 a, float4 b) { return vaddq_f32(a, b); }
+		inline float4 sub(float4 a, float4 b) { return vsubq_f32(a, b); }
+		inline float4 mul(float4 a, float4 b) { return vmulq_f32(a, b); }
+		inline float4 abs(float4 a) { return vabsq_f32(a); }
+		inline float4 rsqrt(float4 a) { float r[4]; vst1q_f32(r, a); for (int i = 0; i < 4; i++) { r[i] = 1.0f / sqrtf(r[i]); } return vld1q_f32(r); }
+		inline float4 mulSign(float4 a, float4 b) { return vreinterpretq_f32_u32(veorq_u32(vreinterpretq_u32_f32(b), vandq_u32(vreinterpretq_u32_f32(a), vdupq_n_u32(0x80000000u)))); }
+		inline uint32_t less(float4 a, float4 b) { return movemask(vcltq_f32(a, b)); }
+		inline uint32_t greater(float4 a, float4 b) { return movemask(vcgtq_f32(a, b)); }
+#else
+		struct float4 { float v[4]; };
+		inline float4 load(const float* p) { float4 r; memcpy(r.v, p, sizeof(r.v)); return r; }
+		inline void store(float* p, float4 v) { memcpy(p, v.v, sizeof(v.v)); }
+		inline float4 set(float v) { float4 r = { { v, v, v, v } }; return r; }
+		inline float4 add(float4 a, float4 b) { for (int i = 0; i < 4; i++) { a.v[i] += b.v[i]; } return a; }
+		inline float4 sub(float4 a, float4 b) { for (int i = 0; i < 4; i++) { a.v[i] -= b.v[i]; } return a; }
+		inline float4 mul(float4 a, float4 b) { for (int i = 0; i < 4; i++) { a.v[i] *= b.v[i]; } return a; }
+		inline float4 abs(float4 a) { for (int i = 0; i < 4; i++) { a.v[i] = fabsf(a.v[i]); } return a; }
+		inline float4 rsqrt(float4 a) { for (int i = 0; i < 4; i++) { a.v[i] = 1.0f / sqrtf(a.v[i]); } return a; }
+		inline float4 mulSign(float4 a, float4 b) { for (int i = 0; i < 4; i++) { b.v[i] = (a.v[i] < 0.0f) ? -b.v[i] : b.v[i]; } return b; }
+		inline uint32_t less(float4 a, float4 b) { uint32_t r = 0; for (int i = 0; i < 4; i++) { r |= (a.v[i] < b.v[i]) ? (1u << i) : 0u; } return r; }
+		inline uint32_t greater(float4 a, float4 b) { uint32_t r = 0; for (int i = 0; i < 4; i++) { r |= (a.v[i] > b.v[i]) ? (1u << i) : 0u; } return r; }
+#endif
+		inline float4 madd(float4 a, float4 b, float4 c) { return add(mul(a, b), c); }
+
+		/*
+			Eight wide float vector
+		*/
+#if defined(VKS_SIMD_AVX)
+		typedef __m256 float8;
+		inline float8 load8(const float* p) { return _mm256_loadu_ps(p); }
+		inline void store(float* p, float8 v) { _mm256_storeu_ps(p, v); }
+		inline float8 set8(float v) { return _mm256_set1_ps(v); }
+		inline float8 add(float8 a, float8 b) { return _mm256_add_ps(a, b); }
+		inline float8 sub(float8 a, float8 b) { return _mm256_sub_ps(a, b); }
+		inline float8 mul(float8 a, float8 b) { return _mm256_mul_ps(a, b); }
+		inline uint32_t greater(float8 a, float8 b) { return (uint32_t)_mm256_movemask_ps(_mm256_cmp_ps(a, b, _CMP_GT_OQ)); }
+#else
+		struct float8 { float4 lo, hi; };
+		inline float8 load8(const float* p) { float8 r = { load(p), load(p + 4) }; return r; }
+		inline void store(float* p, float8 v) { store(p, v.lo); store(p + 4, v.hi); }
+		inline float8 set8(float v) { float8 r = { set(v), set(v) }; return r; }
+		inline float8 add(float8 a, float8 b) { float8 r = { add(a.lo, b.lo), add(a.hi, b.hi) }; return r; }
+		inline float8 sub(float8 a, float8 b) { float8 r = { sub(a.lo, b.lo), sub(a.hi, b.hi) }; return r; }
+		inline float8 mul(float8 a, float8 b) { float8 r = { mul(a.lo, b.lo), mul(a.hi, b.hi) }; return r; }
+		inline uint32_t greater(float8 a, float8 b) { return greater(a.lo, b.lo) | (greater(a.hi, b.hi) << 4); }
+#endif
+		inline float8 madd(float8 a, float8 b, float8 c) { return add(mul(a, b), c); }
+	}
+}
@@ -0,0 +1,872 @@
+/*
+* Tiled heightmap terrain with streaming and quadtree level of detail
+*
+* Heights are stored on disk as a pyramid of square tiles: level 0 is a single tile covering the whole terrain and each
+* further level splits every tile into four. All levels point sample the same finest grid, so a vertex shared by tiles of
+* different levels has exactly the same height in all of them
+* A loader thread reads the tiles that are requested and turns them into vertices, the main thread copies a limited number
+* of finished tiles per frame into the slots of one vertex buffer and reuses the least recently used slots
+* The tiles to draw are selected on the CPU by their projected geometric error. Edges towards a coarser neighbour are
+* stitched by snapping their vertices to the coarser grid in the index data, so the vertex data never depends on neighbours
+*
+* This code is licensed under the MIT license (MIT) (http://opensource.org/licenses/MIT)
+*/
+
+#pragma once
+
+#include <vector>
+#include <string>
+#include <fstream>
+#include <functional>
+#include <unordered_map>
+#include <unordered_set>
+#include <algorithm>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <assert.h>
+#include <float.h>
+#include <math.h>
+#include <string.h>
+#include <stdint.h>
+#include <glm/glm.hpp>
+
+#include "frustum.hpp"
+
+namespace vks
+{
+	namespace terrain
+	{
+		/** @brief Packs a tile's position in the pyramid into a single value for lookups */
+		inline uint64_t tileKey(uint32_t level, uint32_t x, uint32_t y)
+		{
+			return (static_cast<uint64_t>(level) << 58) | (static_cast<uint64_t>(x) << 29) | static_cast<uint64_t>(y);
+		}
+
+		static const uint64_t invalidTileKey = ~0ull;
+
+		struct FileHeader
+		{
+			char magic[4];
+			uint32_t version;
+			/** @brief Number of quads along the edge of a tile, a power of two */
+			uint32_t tileSize;
+			uint32_t levelCount;
+		};
+
+		struct TileInfo
+		{
+			/** @brief Position of the tile's samples in the file */
+			uint64_t offset;
+			/** @brief Height range of the tile and its finer levels */
+			uint16_t minHeight;
+			uint16_t maxHeight;
+			/** @brief Largest height difference to the finest level in normalized units (1.0 = full height range) */
+			float error;
+		};
+
+		/**
+		* Tile pyramid file
+		*
+		* Every tile stores (tileSize + 3)² samples: the (tileSize + 1)² samples of its vertices and a one sample border that
+		* is only used for normals, so lighting matches across tiles of the same level
+		* The tile table (16 bytes per tile) is kept in memory, the samples are read on demand
+		*/
+		class TiledHeightMap
+		{
+		private:
+			std::ifstream file;
+			FileHeader header = {};
+			std::vector<TileInfo> tiles;
+			std::vector<uint32_t> levelOffsets;
+
+			void setupLevels(uint32_t levelCount)
+			{
+				levelOffsets.resize(levelCount);
+				uint32_t tileCount = 0;
+				for (uint32_t level = 0; level < levelCount; level++) {
+					levelOffsets[level] = tileCount;
+					tileCount += 1u << (level * 2);
+				}
+				tiles.resize(tileCount);
+			}
+
+		public:
+			static const uint32_t version = 1;
+			/** @brief Samples stored around the edges of each tile */
+			static const uint32_t border = 1;
+
+			/**
+			* Writes a height field as a tile pyramid, only one tile is kept in memory at a time
+			*
+			* @param filename File to write
+			* @param tileSize Quads along the edge of a tile, a power of two up to 128 (vertex indices within a tile are 16 bit)
+			* @param levelCount Number of levels, the finest level has (tileSize << (levelCount - 1)) + 1 samples per side
+			* @param sample Returns the height at a position of the finest grid, called once per stored sample
+			*
+			* @return True if the file was written
+			*/
+			static bool write(const std::string& filename, uint32_t tileSize, uint32_t levelCount, const std::function<uint16_t(uint32_t x, uint32_t y)>& sample)
+			{
+				assert((tileSize >= 4) && (tileSize <= 128) && ((tileSize & (tileSize - 1)) == 0));
+				// Stitching snaps edges to a neighbour's grid, which only works while that grid has a vertex at every tile corner
+				assert((levelCount > 0) && ((1u << (levelCount - 1)) <= tileSize));
+				std::ofstream out(filename, std::ios::binary | std::ios::out | std::ios::trunc);
+				if (!out.is_open()) {
+					return false;
+				}
+				TiledHeightMap pyramid;
+				pyramid.setupLevels(levelCount);
+				FileHeader fileHeader = { { 'V', 'K', 'T', 'H' }, version, tileSize, levelCount };
+				out.write(reinterpret_cast<const char*>(&fileHeader), sizeof(fileHeader));
+				// The table is written again once the bounds and errors are known
+				out.write(reinterpret_cast<const char*>(pyramid.tiles.data()), pyramid.tiles.size() * sizeof(TileInfo));
+
+				const int64_t gridMax = static_cast<int64_t>(tileSize) << (levelCount - 1);
+				auto clampedSample = [&](int64_t x, int64_t y) {
+					return sample(static_cast<uint32_t>(std::min(std::max(x, int64_t(0)), gridMax)), static_cast<uint32_t>(std::min(std::max(y, int64_t(0)), gridMax)));
+				};
+
+				const uint32_t rowLength = tileSize + 1 + 2 * border;
+				std::vector<uint16_t> samples(rowLength * rowLength);
+				const uint32_t detailLength = tileSize * 2 + 1;
+				std::vector<uint16_t> detail(detailLength * detailLength);
+				uint64_t offset = sizeof(FileHeader) + pyramid.tiles.size() * sizeof(TileInfo);
+
+				// Finest level first, the error of a tile includes the errors of its children
+				for (uint32_t level = levelCount; level-- > 0;) {
+					const int64_t stride = int64_t(1) << (levelCount - 1 - level);
+					const uint32_t levelSize = 1u << level;
+					for (uint32_t ty = 0; ty < levelSize; ty++) {
+						for (uint32_t tx = 0; tx < levelSize; tx++) {
+							const int64_t x0 = tx * tileSize * stride;
+							const int64_t y0 = ty * tileSize * stride;
+							for (uint32_t sy = 0; sy < rowLength; sy++) {
+								for (uint32_t sx = 0; sx < rowLength; sx++) {
+									samples[sy * rowLength + sx] = clampedSample(x0 + (int64_t(sx) - border) * stride, y0 + (int64_t(sy) - border) * stride);
+								}
+							}
+							TileInfo& info = pyramid.tiles[pyramid.levelOffsets[level] + ty * levelSize + tx];
+							info.offset = offset;
+							out.write(reinterpret_cast<const char*>(samples.data()), samples.size() * sizeof(uint16_t));
+							offset += samples.size() * sizeof(uint16_t);
+
+							uint16_t minHeight = 0xFFFF, maxHeight = 0;
+							if (level == levelCount - 1) {
+								for (uint32_t sy = border; sy <= tileSize + border; sy++) {
+									for (uint32_t sx = border; sx <= tileSize + border; sx++) {
+										minHeight = std::min(minHeight, samples[sy * rowLength + sx]);
+										maxHeight = std::max(maxHeight, samples[sy * rowLength + sx]);
+									}
+								}
+								info.error = 0.0f;
+							} else {
+								// Compare against the next finer level, bilinear interpolation approximates the quads of this tile
+								const int64_t half = stride / 2;
+								for (uint32_t dy = 0; dy < detailLength; dy++) {
+									for (uint32_t dx = 0; dx < detailLength; dx++) {
+										detail[dy * detailLength + dx] = clampedSample(x0 + dx * half, y0 + dy * half);
+									}
+								}
+								float maxDifference = 0.0f;
+								for (uint32_t dy = 0; dy < detailLength; dy++) {
+									for (uint32_t dx = 0; dx < detailLength; dx++) {
+										const uint16_t value = detail[dy * detailLength + dx];
+										if (((dx | dy) & 1) == 0) {
+											continue;
+										}
+										const uint32_t cx0 = dx & ~1u, cy0 = dy & ~1u;
+										const uint32_t cx1 = std::min(cx0 + 2, detailLength - 1), cy1 = std::min(cy0 + 2, detailLength - 1);
+										const float fx = (dx & 1) ? 0.5f : 0.0f;
+										const float fy = (dy & 1) ? 0.5f : 0.0f;
+										const float top = detail[cy0 * detailLength + cx0] * (1.0f - fx) + detail[cy0 * detailLength + cx1] * fx;
+										const float bottom = detail[cy1 * detailLength + cx0] * (1.0f - fx) + detail[cy1 * detailLength + cx1] * fx;
+										maxDifference = std::max(maxDifference, fabsf(top * (1.0f - fy) + bottom * fy - value));
+									}
+								}
+								// The children cover the same area, so their bounds include all finer levels
+								float childError = 0.0f;
+								for (uint32_t c = 0; c < 4; c++) {
+									const TileInfo& child = pyramid.getTileInfo(level + 1, tx * 2 + (c & 1), ty * 2 + (c >> 1));
+									childError = std::max(childError, child.error);
+									minHeight = std::min(minHeight, child.minHeight);
+									maxHeight = std::max(maxHeight, child.maxHeight);
+								}
+								info.error = maxDifference / 65535.0f + childError;
+							}
+							info.minHeight = minHeight;
+							info.maxHeight = maxHeight;
+						}
+					}
+				}
+				out.seekp(sizeof(FileHeader));
+				out.write(reinterpret_cast<const char*>(pyramid.tiles.data()), pyramid.tiles.size() * sizeof(TileInfo));
+				return out.good();
+			}
+
+			/**
+			* Opens a tile pyramid and reads its tile table
+			*
+			* @return True if the file exists and is a tile pyramid of the current version
+			*/
+			bool open(const std::string& filename)
+			{
+				close();
+				file.open(filename, std::ios::binary | std::ios::in);
+				if (!file.is_open()) {
+					return false;
+				}
+				file.read(reinterpret_cast<char*>(&header), sizeof(header));
+				if (!file.good() || (memcmp(header.magic, "VKTH", 4) != 0) || (header.version != version) || (header.levelCount == 0) || (header.levelCount > 28)) {
+					close();
+					return false;
+				}
+				setupLevels(header.levelCount);
+				file.read(reinterpret_cast<char*>(tiles.data()), tiles.size() * sizeof(TileInfo));
+				if (!file.good()) {
+					close();
+					return false;
+				}
+				return true;
+			}
+
+			void close()
+			{
+				if (file.is_open()) {
+					file.close();
+				}
+				file.clear();
+				header = {};
+				tiles.clear();
+				levelOffsets.clear();
+			}
+
+			/** @brief Reads getTileSampleCount() samples of a tile, not thread safe */
+			bool readTile(uint32_t level, uint32_t x, uint32_t y, uint16_t* samples)
+			{
+				file.seekg(static_cast<std::streamoff>(getTileInfo(level, x, y).offset));
+				file.read(reinterpret_cast<char*>(samples), getTileSampleCount() * sizeof(uint16_t));
+				return file.good();
+			}
+
+			const TileInfo& getTileInfo(uint32_t level, uint32_t x, uint32_t y) const
+			{
+				return tiles[levelOffsets[level] + (y << level) + x];
+			}
+
+			bool isOpen() const
+			{
+				return !tiles.empty();
+			}
+
+			uint32_t getTileSize() const
+			{
+				return header.tileSize;
+			}
+
+			uint32_t getLevelCount() const
+			{
+				return header.levelCount;
+			}
+
+			/** @brief Number of quads along the edge of the finest grid */
+			uint64_t getGridSize() const
+			{
+				return static_cast<uint64_t>(header.tileSize) << (header.levelCount - 1);
+			}
+
+			/** @brief Samples stored per tile, including the border */
+			uint32_t getTileSampleCount() const
+			{
+				return (header.tileSize + 1 + 2 * border) * (header.tileSize + 1 + 2 * border);
+			}
+		};
+
+		/** @brief Vertex layout of the terrain tiles, matches the position, normal and uv inputs of the tessellation shaders */
+		struct Vertex
+		{
+			glm::vec3 pos;
+			glm::vec3 normal;
+			glm::vec2 uv;
+		};
+
+		struct TerrainSettings
+		{
+			/** @brief Distance between two samples of the finest level in world units, the terrain is centered at the origin */
+			float sampleSpacing = 1.0f;
+			/** @brief World space height of the largest sample value, heights grow along negative y like in the tessellation shaders */
+			float heightScale = 1.0f;
+			/** @brief Texture coordinates go from 0 to uvScale across the terrain */
+			float uvScale = 1.0f;
+			/** @brief Largest projected geometric error of a drawn tile in pixels */
+			float maxPixelError = 2.0f;
+			/** @brief Number of tiles that fit into the vertex buffer */
+			uint32_t cacheSize = 128;
+			/** @brief Maximum number of tiles copied into the vertex buffer per frame */
+			uint32_t uploadBudget = 8;
+			/** @brief Number of frames the GPU may still be reading the vertex buffer for, slots used by these are not overwritten */
+			uint32_t framesInFlight = 1;
+		};
+
+		struct TileRequest
+		{
+			uint32_t level, x, y;
+			/** @brief Projected error of the parent, tiles that reduce the largest errors are loaded first */
+			float priority;
+		};
+
+		struct LoadedTile
+		{
+			uint32_t level, x, y;
+			std::vector<Vertex> vertices;
+		};
+
+		/**
+		* Loads requested tiles on a separate thread and converts them to vertices
+		* The request list is replaced every frame, so tiles that are no longer needed are dropped before they are read
+		*/
+		class TileLoader
+		{
+		private:
+			TiledHeightMap* heightMap = nullptr;
+			TerrainSettings settings;
+			uint32_t maxCompleted = 0;
+
+			std::thread thread;
+			std::mutex mutex;
+			std::condition_variable condition;
+			bool stopRequested = false;
+			// Sorted so the most important request is at the back
+			std::vector<TileRequest> queue;
+			std::vector<LoadedTile> completed;
+			uint64_t busyKey = invalidTileKey;
+
+			void buildVertices(const uint16_t* samples, uint32_t level, uint32_t tileX, uint32_t tileY, Vertex* vertices) const
+			{
+				const uint32_t tileSize = heightMap->getTileSize();
+				const uint32_t rowLength = tileSize + 1 + 2 * TiledHeightMap::border;
+				const uint64_t gridSize = heightMap->getGridSize();
+				const uint64_t stride = 1ull << (heightMap->getLevelCount() - 1 - level);
+				const float origin = -0.5f * gridSize * settings.sampleSpacing;
+				const float uvFactor = settings.uvScale / gridSize;
+				// Scales central differences of the normalized heights to world space slopes
+				const float slopeFactor = settings.heightScale / (2.0f * stride * settings.sampleSpacing);
+				// Coordinates go from -1 to tileSize + 1 to include the border
+				auto height = [&](int32_t x, int32_t y) {
+					return samples[(y + TiledHeightMap::border) * rowLength + x + TiledHeightMap::border] / 65535.0f;
+				};
+				for (int32_t y = 0; y <= static_cast<int32_t>(tileSize); y++) {
+					const uint64_t gridY = (static_cast<uint64_t>(tileY) * tileSize + y) * stride;
+					for (int32_t x = 0; x <= static_cast<int32_t>(tileSize); x++) {
+						const uint64_t gridX = (static_cast<uint64_t>(tileX) * tileSize + x) * stride;
+						Vertex& vertex = vertices[y * (tileSize + 1) + x];
+						vertex.pos = glm::vec3(origin + gridX * settings.sampleSpacing, -height(x, y) * settings.heightScale, origin + gridY * settings.sampleSpacing);
+						vertex.uv = glm::vec2(gridX * uvFactor, gridY * uvFactor);
+						// Same orientation and bump strength as the Sobel filtered normals of the tessellated terrain, but
+						// based on world space slopes so all levels are lit alike
+						glm::vec3 normal;
+						normal.x = -0.5f * (height(x + 1, y) - height(x - 1, y)) * slopeFactor;
+						normal.z = -0.5f * (height(x, y + 1) - height(x, y - 1)) * slopeFactor;
+						normal.y = 0.25f * sqrtf(std::max(0.0f, 1.0f - normal.x * normal.x - normal.z * normal.z));
+						vertex.normal = glm::normalize(normal * glm::vec3(2.0f, 1.0f, 2.0f));
+					}
+				}
+			}
+
+			void loaderLoop()
+			{
+				std::vector<uint16_t> samples(heightMap->getTileSampleCount());
+				const uint32_t tileSize = heightMap->getTileSize();
+				while (true) {
+					TileRequest request;
+					{
+						std::unique_lock<std::mutex> lock(mutex);
+						condition.wait(lock, [this] { return stopRequested || (!queue.empty() && (completed.size() < maxCompleted)); });
+						if (stopRequested) {
+							return;
+						}
+						request = queue.back();
+						queue.pop_back();
+						busyKey = tileKey(request.level, request.x, request.y);
+					}
+					LoadedTile tile = { request.level, request.x, request.y };
+					if (heightMap->readTile(request.level, request.x, request.y, samples.data())) {
+						tile.vertices.resize((tileSize + 1) * (tileSize + 1));
+						buildVertices(samples.data(), request.level, request.x, request.y, tile.vertices.data());
+					}
+					std::lock_guard<std::mutex> lock(mutex);
+					// Tiles that failed to load are handed back without vertices, so they aren't requested forever
+					completed.push_back(std::move(tile));
+					busyKey = invalidTileKey;
+				}
+			}
+
+		public:
+			~TileLoader()
+			{
+				stop();
+			}
+
+			/**
+			* Starts the loader thread, the height map is only accessed by that thread until stop is called
+			*
+			* @param maxCompleted Number of finished tiles waiting to be fetched after which the loader pauses
+			*/
+			void start(TiledHeightMap* heightMap, const TerrainSettings& settings, uint32_t maxCompleted)
+			{
+				stop();
+				this->heightMap = heightMap;
+				this->settings = settings;
+				this->maxCompleted = maxCompleted;
+				stopRequested = false;
+				thread = std::thread(&TileLoader::loaderLoop, this);
+			}
+
+			void stop()
+			{
+				if (!thread.joinable()) {
+					return;
+				}
+				{
+					std::lock_guard<std::mutex> lock(mutex);
+					stopRequested = true;
+				}
+				condition.notify_all();
+				thread.join();
+				queue.clear();
+				completed.clear();
+				busyKey = invalidTileKey;
+			}
+
+			/** @brief Replaces all pending requests, tiles that are being loaded or waiting to be fetched are skipped */
+			void setRequests(const std::vector<TileRequest>& requests)
+			{
+				{
+					std::lock_guard<std::mutex> lock(mutex);
+					queue.clear();
+					for (const TileRequest& request : requests) {
+						const uint64_t key = tileKey(request.level, request.x, request.y);
+						if (key == busyKey) {
+							continue;
+						}
+						bool done = false;
+						for (const LoadedTile& tile : completed) {
+							done |= (tileKey(tile.level, tile.x, tile.y) == key);
+						}
+						if (!done) {
+							queue.push_back(request);
+						}
+					}
+					// Coarse levels first, they are needed before their children can be used
+					std::sort(queue.begin(), queue.end(), [](const TileRequest& a, const TileRequest& b) {
+						return (a.level != b.level) ? (a.level > b.level) : (a.priority < b.priority);
+					});
+				}
+				condition.notify_one();
+			}
+
+			/** @brief Moves up to maxCount finished tiles to tiles */
+			void fetch(uint32_t maxCount, std::vector<LoadedTile>& tiles)
+			{
+				{
+					std::lock_guard<std::mutex> lock(mutex);
+					const uint32_t count = std::min(maxCount, static_cast<uint32_t>(completed.size()));
+					for (uint32_t i = 0; i < count; i++) {
+						tiles.push_back(std::move(completed[i]));
+					}
+					completed.erase(completed.begin(), completed.begin() + count);
+				}
+				condition.notify_one();
+			}
+
+			/** @brief Number of requests that have not been fetched yet */
+			uint32_t getPendingCount()
+			{
+				std::lock_guard<std::mutex> lock(mutex);
+				return static_cast<uint32_t>(queue.size() + completed.size()) + ((busyKey != invalidTileKey) ? 1 : 0);
+			}
+		};
+
+		/**
+		* Streams a tile pyramid into a bounded cache and selects the tiles to draw
+		*
+		* The vertex buffer is owned by the caller and holds getCacheSize() slots of getTileVertexCount() vertices. Every tile
+		* is drawn with the shared interior indices and its own ring of edge indices, both offset by slot * getTileVertexCount()
+		* The indices describe quad patches (four indices per quad) in the same order as the tessellated terrain
+		*/
+		class ChunkedTerrain
+		{
+		public:
+			struct TileUpload
+			{
+				/** @brief Slot in the vertex buffer that receives the tile */
+				uint32_t slot;
+				/** @brief Index of the tile's vertices in the staging memory passed to update */
+				uint32_t stagingIndex;
+			};
+
+			struct Statistics
+			{
+				uint32_t residentTiles = 0;
+				uint32_t drawnTiles = 0;
+				uint32_t uploadedTiles = 0;
+				uint32_t pendingTiles = 0;
+				uint32_t finestDrawnLevel = 0;
+				uint64_t totalUploads = 0;
+				uint64_t totalEvictions = 0;
+			};
+
+		private:
+			struct Slot
+			{
+				uint64_t key = invalidTileKey;
+				uint64_t lastUsed = 0;
+			};
+
+			struct SelectedTile
+			{
+				uint32_t level, x, y;
+				uint32_t slot;
+				float distance;
+			};
+
+			TiledHeightMap heightMap;
+			TileLoader loader;
+			TerrainSettings settings;
+
+			std::vector<Slot> slots;
+			std::unordered_map<uint64_t, uint32_t> residentSlots;
+			std::vector<uint16_t> interiorIndices;
+			// Ring indices are built on first use for each combination of level differences to the four neighbours
+			std::unordered_map<uint32_t, std::vector<uint16_t>> ringVariants;
+
+			std::vector<SelectedTile> selected;
+			std::unordered_set<uint64_t> selectedKeys;
+			std::vector<TileRequest> requests;
+			std::vector<LoadedTile> loadedTiles;
+			uint64_t frameIndex = 0;
+			Statistics statistics;
+
+			// View of the current update
+			Frustum frustum;
+			glm::vec3 cameraPos;
+			float pixelsPerUnit = 1.0f;
+
+			void getTileBounds(uint32_t level, uint32_t x, uint32_t y, glm::vec3& min, glm::vec3& max) const
+			{
+				const TileInfo& info = heightMap.getTileInfo(level, x, y);
+				const float tileExtent = static_cast<float>(heightMap.getTileSize() << (heightMap.getLevelCount() - 1 - level)) * settings.sampleSpacing;
+				const float origin = -0.5f * heightMap.getGridSize() * settings.sampleSpacing;
+				min = glm::vec3(origin + x * tileExtent, -(info.maxHeight / 65535.0f) * settings.heightScale, origin + y * tileExtent);
+				max = glm::vec3(min.x + tileExtent, -(info.minHeight / 65535.0f) * settings.heightScale, min.z + tileExtent);
+			}
+
+			// Projected error of the tile in pixels and distance of the camera to its bounds
+			float getPixelError(uint32_t level, uint32_t x, uint32_t y, float& distance) const
+			{
+				glm::vec3 min, max;
+				getTileBounds(level, x, y, min, max);
+				distance = glm::length(glm::clamp(cameraPos, min, max) - cameraPos);
+				const float error = heightMap.getTileInfo(level, x, y).error * settings.heightScale;
+				return (distance > 0.0f) ? error * pixelsPerUnit / distance : FLT_MAX;
+			}
+
+			bool isVisible(uint32_t level, uint32_t x, uint32_t y) const
+			{
+				glm::vec3 min, max;
+				getTileBounds(level, x, y, min, max);
+				return frustum.checkBox(min, max);
+			}
+
+			// Refines a visible, resident tile while its error is too large and the visible children are resident
+			void selectTile(uint32_t level, uint32_t x, uint32_t y, uint32_t slot)
+			{
+				// Tiles on the path to drawn tiles count as used, so coarser fallbacks stay resident
+				slots[slot].lastUsed = frameIndex;
+				float distance;
+				const float pixelError = getPixelError(level, x, y, distance);
+				if ((level + 1 < heightMap.getLevelCount()) && (pixelError > settings.maxPixelError)) {
+					int32_t childSlots[4];
+					bool complete = true;
+					for (uint32_t c = 0; c < 4; c++) {
+						const uint32_t cx = x * 2 + (c & 1), cy = y * 2 + (c >> 1);
+						childSlots[c] = -1;
+						if (!isVisible(level + 1, cx, cy)) {
+							continue;
+						}
+						auto it = residentSlots.find(tileKey(level + 1, cx, cy));
+						if (it != residentSlots.end()) {
+							childSlots[c] = static_cast<int32_t>(it->second);
+						} else {
+							requests.push_back({ level + 1, cx, cy, pixelError });
+							complete = false;
+						}
+					}
+					if (complete) {
+						for (uint32_t c = 0; c < 4; c++) {
+							if (childSlots[c] >= 0) {
+								selectTile(level + 1, x * 2 + (c & 1), y * 2 + (c >> 1), static_cast<uint32_t>(childSlots[c]));
+							}
+						}
+						return;
+					}
+				}
+				selected.push_back({ level, x, y, slot, distance });
+				selectedKeys.insert(tileKey(level, x, y));
+			}
+
+			// Number of levels the drawn tile across the given edge is coarser by, zero if it is finer, equal or not drawn
+			uint32_t getCoarserNeighbourDelta(uint32_t level, uint32_t x, uint32_t y, int32_t dx, int32_t dy) const
+			{
+				const int64_t nx = static_cast<int64_t>(x) + dx, ny = static_cast<int64_t>(y) + dy;
+				if ((nx < 0) || (ny < 0) || (nx >= (int64_t(1) << level)) || (ny >= (int64_t(1) << level))) {
+					return 0;
+				}
+				for (uint32_t coarser = level; coarser-- > 0;) {
+					const uint32_t shift = level - coarser;
+					if (selectedKeys.count(tileKey(coarser, static_cast<uint32_t>(nx >> shift), static_cast<uint32_t>(ny >> shift)))) {
+						return shift;
+					}
+				}
+				return 0;
+			}
+
+			/**
+			* Returns the edge quads of a tile with the vertices of each edge snapped down to a grid 2^delta times coarser
+			* Snapping turns the quads along a coarse edge segment into a fan of triangles (quads with two equal corners)
+			* plus one trapezoid, so the edge only has vertices that the coarser neighbour has as well
+			*
+			* @param variant Level differences to the neighbours at -x, +x, -z and +z in four bits each
+			*/
+			const std::vector<uint16_t>& getRingIndices(uint32_t variant)
+			{
+				auto it = ringVariants.find(variant);
+				if (it != ringVariants.end()) {
+					return it->second;
+				}
+				const uint32_t tileSize = heightMap.getTileSize();
+				const uint32_t delta[4] = { variant & 0xF, (variant >> 4) & 0xF, (variant >> 8) & 0xF, (variant >> 12) & 0xF };
+				auto index = [&](uint32_t x, uint32_t y) {
+					if (x == 0) {
+						y = (y >> delta[0]) << delta[0];
+					} else if (x == tileSize) {
+						y = (y >> delta[1]) << delta[1];
+					} else if (y == 0) {
+						x = (x >> delta[2]) << delta[2];
+					} else if (y == tileSize) {
+						x = (x >> delta[3]) << delta[3];
+					}
+					return static_cast<uint16_t>(y * (tileSize + 1) + x);
+				};
+				std::vector<uint16_t>& indices = ringVariants[variant];
+				indices.reserve(getRingIndexCount());
+				for (uint32_t y = 0; y < tileSize; y++) {
+					for (uint32_t x = 0; x < tileSize; x++) {
+						if ((x != 0) && (y != 0) && (x != tileSize - 1) && (y != tileSize - 1)) {
+							continue;
+						}
+						indices.push_back(index(x, y));
+						indices.push_back(index(x, y + 1));
+						indices.push_back(index(x + 1, y + 1));
+						indices.push_back(index(x + 1, y));
+					}
+				}
+				return indices;
+			}
+
+			// Returns a slot that no frame in flight reads from, preferring empty slots and then the least recently used one
+			int32_t findFreeSlot() const
+			{
+				int32_t best = -1;
+				for (uint32_t i = 0; i < slots.size(); i++) {
+					if (slots[i].key == invalidTileKey) {
+						return static_cast<int32_t>(i);
+					}
+					if ((slots[i].lastUsed + settings.framesInFlight <= frameIndex) && ((best < 0) || (slots[i].lastUsed < slots[best].lastUsed))) {
+						best = static_cast<int32_t>(i);
+					}
+				}
+				return best;
+			}
+
+		public:
+			~ChunkedTerrain()
+			{
+				close();
+			}
+
+			/**
+			* Opens a tile pyramid and starts streaming, no tile is resident until the first updates have uploaded them
+			*
+			* @return False if the file can't be read, in which case nothing is drawn
+			*/
+			bool open(const std::string& filename, const TerrainSettings& settings)
+			{
+				close();
+				assert((settings.cacheSize >= 1) && (settings.uploadBudget >= 1) && (settings.framesInFlight >= 1));
+				if (!heightMap.open(filename)) {
+					return false;
+				}
+				this->settings = settings;
+				slots.assign(settings.cacheSize, Slot());
+				const uint32_t tileSize = heightMap.getTileSize();
+				interiorIndices.clear();
+				for (uint32_t y = 1; y < tileSize - 1; y++) {
+					for (uint32_t x = 1; x < tileSize - 1; x++) {
+						interiorIndices.push_back(static_cast<uint16_t>(y * (tileSize + 1) + x));
+						interiorIndices.push_back(static_cast<uint16_t>((y + 1) * (tileSize + 1) + x));
+						interiorIndices.push_back(static_cast<uint16_t>((y + 1) * (tileSize + 1) + x + 1));
+						interiorIndices.push_back(static_cast<uint16_t>(y * (tileSize + 1) + x + 1));
+					}
+				}
+				frameIndex = settings.framesInFlight;
+				statistics = Statistics();
+				loader.start(&heightMap, settings, settings.uploadBudget * 2);
+				return true;
+			}
+
+			void close()
+			{
+				loader.stop();
+				heightMap.close();
+				slots.clear();
+				residentSlots.clear();
+				ringVariants.clear();
+				interiorIndices.clear();
+			}
+
+			/**
+			* Selects the tiles to draw for a view, requests missing tiles and hands out finished tiles within the upload budget
+			* Must be called once per frame, after the GPU has finished the frame that last used the same staging memory
+			*
+			* @param projection, view Camera matrices
+			* @param viewportHeight Height of the viewport in pixels, used to project the tile errors
+			* @param staging Host visible memory for uploadBudget tiles of getTileVertexCount() vertices
+			* @param uploads Receives the copies from staging into vertex buffer slots to record before drawing
+			* @param ringIndices Host visible memory for cacheSize rings of getRingIndexCount() indices
+			* @param drawSlots Receives the slot of each tile to draw, the ring indices of drawSlots[i] start at i * getRingIndexCount()
+			*/
+			void update(const glm::mat4& projection, const glm::mat4& view, float viewportHeight, Vertex* staging, std::vector<TileUpload>& uploads, uint16_t* ringIndices, std::vector<uint32_t>& drawSlots)
+			{
+				uploads.clear();
+				drawSlots.clear();
+				if (!heightMap.isOpen()) {
+					return;
+				}
+				frameIndex++;
+				frustum.update(projection * view);
+				cameraPos = glm::vec3(glm::inverse(view)[3]);
+				// projection[1][1] is the cotangent of half the vertical field of view
+				pixelsPerUnit = fabsf(projection[1][1]) * viewportHeight * 0.5f;
+
+				selected.clear();
+				selectedKeys.clear();
+				requests.clear();
+				auto root = residentSlots.find(tileKey(0, 0, 0));
+				if (root != residentSlots.end()) {
+					if (isVisible(0, 0, 0)) {
+						selectTile(0, 0, 0, root->second);
+					} else {
+						slots[root->second].lastUsed = frameIndex;
+					}
+				} else {
+					requests.push_back({ 0, 0, 0, FLT_MAX });
+				}
+
+				// Front to back for early depth rejection
+				std::sort(selected.begin(), selected.end(), [](const SelectedTile& a, const SelectedTile& b) {
+					return a.distance < b.distance;
+				});
+				const uint32_t ringIndexCount = getRingIndexCount();
+				statistics.finestDrawnLevel = 0;
+				for (const SelectedTile& tile : selected) {
+					const uint32_t variant =
+						getCoarserNeighbourDelta(tile.level, tile.x, tile.y, -1, 0) |
+						(getCoarserNeighbourDelta(tile.level, tile.x, tile.y, 1, 0) << 4) |
+						(getCoarserNeighbourDelta(tile.level, tile.x, tile.y, 0, -1) << 8) |
+						(getCoarserNeighbourDelta(tile.level, tile.x, tile.y, 0, 1) << 12);
+					memcpy(ringIndices + drawSlots.size() * ringIndexCount, getRingIndices(variant).data(), ringIndexCount * sizeof(uint16_t));
+					drawSlots.push_back(tile.slot);
+					statistics.finestDrawnLevel = std::max(statistics.finestDrawnLevel, tile.level);
+				}
+
+				// Uploads go into slots that neither this nor any frame in flight draws from
+				loadedTiles.clear();
+				loader.fetch(settings.uploadBudget, loadedTiles);
+				const uint32_t tileVertexCount = getTileVertexCount();
+				for (LoadedTile& tile : loadedTiles) {
+					const uint64_t key = tileKey(tile.level, tile.x, tile.y);
+					if (tile.vertices.empty() || residentSlots.count(key)) {
+						continue;
+					}
+					const int32_t slot = findFreeSlot();
+					if (slot < 0) {
+						// Everything is in use, the tile will be requested again
+						continue;
+					}
+					if (slots[slot].key != invalidTileKey) {
+						residentSlots.erase(slots[slot].key);
+						statistics.totalEvictions++;
+					}
+					slots[slot].key = key;
+					slots[slot].lastUsed = frameIndex;
+					residentSlots[key] = static_cast<uint32_t>(slot);
+					memcpy(staging + uploads.size() * tileVertexCount, tile.vertices.data(), tileVertexCount * sizeof(Vertex));
+					uploads.push_back({ static_cast<uint32_t>(slot), static_cast<uint32_t>(uploads.size()) });
+				}
+
+				requests.erase(std::remove_if(requests.begin(), requests.end(), [this](const TileRequest& request) {
+					return residentSlots.count(tileKey(request.level, request.x, request.y)) > 0;
+				}), requests.end());
+				loader.setRequests(requests);
+
+				statistics.residentTiles = static_cast<uint32_t>(residentSlots.size());
+				statistics.drawnTiles = static_cast<uint32_t>(drawSlots.size());
+				statistics.uploadedTiles = static_cast<uint32_t>(uploads.size());
+				statistics.pendingTiles = loader.getPendingCount();
+				statistics.totalUploads += uploads.size();
+			}
+
+			/** @brief Changes the error threshold used by the next updates */
+			void setMaxPixelError(float maxPixelError)
+			{
+				settings.maxPixelError = maxPixelError;
+			}
+
+			const std::vector<uint16_t>& getInteriorIndices() const
+			{
+				return interiorIndices;
+			}
+
+			uint32_t getRingIndexCount() const
+			{
+				return (heightMap.getTileSize() * 4 - 4) * 4;
+			}
+
+			uint32_t getTileVertexCount() const
+			{
+				return (heightMap.getTileSize() + 1) * (heightMap.getTileSize() + 1);
+			}
+
+			uint32_t getCacheSize() const
+			{
+				return settings.cacheSize;
+			}
+
+			uint32_t getUploadBudget() const
+			{
+				return settings.uploadBudget;
+			}
+
+			const TiledHeightMap& getHeightMap() const
+			{
+				return heightMap;
+			}
+
+			const Statistics& getStatistics() const
+			{
+				return statistics;
+			}
+		};
+	}
+}
@@ -7,6 +7,7 @@
 */
 
 #include "vulkanexamplebase.h"
+#include "VulkanglTFModel.h"
 
 #if (defined(VK_USE_PLATFORM_MACOS_MVK) && defined(VK_EXAMPLE_XCODE_GENERATED))
 #include <Cocoa/Cocoa.h>
@@ -31,28 +32,31 @@ VkResult VulkanExampleBase::createInstance(bool enableValidation)
 	appInfo.pEngineName = name.c_str();
 	appInfo.apiVersion = apiVersion;
 
+	// VK_KHR_surface is also needed in offscreen mode, as the device still enables VK_KHR_swapchain (which depends on it)
 	std::vector<const char*> instanceExtensions = { VK_KHR_SURFACE_EXTENSION_NAME };
 
-	// Enable surface extensions depending on os
+	// Enable surface extensions depending on os, offscreen mode doesn't create a surface so the platform's surface extension is not needed
+	if (!settings.offscreen) {
 #if defined(_WIN32)
-	instanceExtensions.push_back(VK_KHR_WIN32_SURFACE_EXTENSION_NAME);
+		instanceExtensions.push_back(VK_KHR_WIN32_SURFACE_EXTENSION_NAME);
 #elif defined(VK_USE_PLATFORM_ANDROID_KHR)
-	instanceExtensions.push_back(VK_KHR_ANDROID_SURFACE_EXTENSION_NAME);
+		instanceExtensions.push_back(VK_KHR_ANDROID_SURFACE_EXTENSION_NAME);
 #elif defined(_DIRECT2DISPLAY)
-	instanceExtensions.push_back(VK_KHR_DISPLAY_EXTENSION_NAME);
+		instanceExtensions.push_back(VK_KHR_DISPLAY_EXTENSION_NAME);
 #elif defined(VK_USE_PLATFORM_DIRECTFB_EXT)
-	instanceExtensions.push_back(VK_EXT_DIRECTFB_SURFACE_EXTENSION_NAME);
+		instanceExtensions.push_back(VK_EXT_DIRECTFB_SURFACE_EXTENSION_NAME);
 #elif defined(VK_USE_PLATFORM_WAYLAND_KHR)
-	instanceExtensions.push_back(VK_KHR_WAYLAND_SURFACE_EXTENSION_NAME);
+		instanceExtensions.push_back(VK_KHR_WAYLAND_SURFACE_EXTENSION_NAME);
 #elif defined(VK_USE_PLATFORM_XCB_KHR)
-	instanceExtensions.push_back(VK_KHR_XCB_SURFACE_EXTENSION_NAME);
+		instanceExtensions.push_back(VK_KHR_XCB_SURFACE_EXTENSION_NAME);
 #elif defined(VK_USE_PLATFORM_IOS_MVK)
-	instanceExtensions.push_back(VK_MVK_IOS_SURFACE_EXTENSION_NAME);
+		instanceExtensions.push_back(VK_MVK_IOS_SURFACE_EXTENSION_NAME);
 #elif defined(VK_USE_PLATFORM_MACOS_MVK)
-	instanceExtensions.push_back(VK_MVK_MACOS_SURFACE_EXTENSION_NAME);
+		instanceExtensions.push_back(VK_MVK_MACOS_SURFACE_EXTENSION_NAME);
 #elif defined(VK_USE_PLATFORM_HEADLESS_EXT)
-	instanceExtensions.push_back(VK_EXT_HEADLESS_SURFACE_EXTENSION_NAME);
+		instanceExtensions.push_back(VK_EXT_HEADLESS_SURFACE_EXTENSION_NAME);
 #endif
+	}
 	
 	// Get extensions supported by the instance and store for later use
 	uint32_t extCount = 0;
@@ -175,11 +179,23 @@ void VulkanExampleBase::createCommandBuffers()
 			static_cast<uint32_t>(drawCmdBuffers.size()));
 
 	VK_CHECK_RESULT(vkAllocateCommandBuffers(device, &cmdBufAllocateInfo, drawCmdBuffers.data()));
+
+	// Create one command buffer for each frame in flight for examples that record their commands every frame
+	cmdBufAllocateInfo.commandBufferCount = 1;
+	for (auto& frame : frames) {
+		VK_CHECK_RESULT(vkAllocateCommandBuffers(device, &cmdBufAllocateInfo, &frame.commandBuffer));
+	}
 }
 
 void VulkanExampleBase::destroyCommandBuffers()
 {
 	vkFreeCommandBuffers(device, cmdPool, static_cast<uint32_t>(drawCmdBuffers.size()), drawCmdBuffers.data());
+	for (auto& frame : frames) {
+		if (frame.commandBuffer != VK_NULL_HANDLE) {
+			vkFreeCommandBuffers(device, cmdPool, 1, &frame.commandBuffer);
+			frame.commandBuffer = VK_NULL_HANDLE;
+		}
+	}
 }
 
 std::string VulkanExampleBase::getShadersPath() const
@@ -192,11 +208,177 @@ std::string VulkanExampleBase::getHomeworkShadersPath() const
 	return getAssetPath() + "homework/shaders/" + shaderDir + "/";
 }
 
+// Header stored in front of the pipeline cache data in the cache file
+// The driver version is not part of the Vulkan pipeline cache header, so it's stored here to discard caches written by other drivers
+struct PipelineCacheFileHeader
+{
+	uint32_t magic;
+	uint32_t version;
+	uint32_t vendorID;
+	uint32_t deviceID;
+	uint32_t driverVersion;
+	uint8_t pipelineCacheUUID[VK_UUID_SIZE];
+	uint64_t dataSize;
+	uint32_t dataHash;
+};
+
+static const uint32_t pipelineCacheFileMagic = 0x43505356;
+static const uint32_t pipelineCacheFileVersion = 1;
+
+// FNV-1a hash used to detect truncated or corrupted cache files
+static uint32_t pipelineCacheDataHash(const std::vector<char>& data)
+{
+	uint32_t hash = 2166136261u;
+	for (char c : data) {
+		hash ^= (uint8_t)c;
+		hash *= 16777619u;
+	}
+	return hash;
+}
+
+// Returns the pipeline cache data stored in the given file, or an empty vector if the file doesn't exist or doesn't match the device
+static std::vector<char> loadPipelineCacheData(const std::string& filename, const VkPhysicalDeviceProperties& deviceProperties)
+{
+	std::vector<char> data;
+	std::ifstream is(filename, std::ios::binary | std::ios::in);
+	if (!is.is_open()) {
+		return data;
+	}
+	PipelineCacheFileHeader header{};
+	if (!is.read(reinterpret_cast<char*>(&header), sizeof(header))) {
+		std::cerr << "Pipeline cache file \"" << filename << "\" is too small, ignoring it\n";
+		return data;
+	}
+	if ((header.magic != pipelineCacheFileMagic) || (header.version != pipelineCacheFileVersion)) {
+		std::cerr << "Pipeline cache file \"" << filename << "\" has an unknown format, ignoring it\n";
+		return data;
+	}
+	if ((header.vendorID != deviceProperties.vendorID) || (header.deviceID != deviceProperties.deviceID) || (header.driverVersion != deviceProperties.driverVersion) || (memcmp(header.pipelineCacheUUID, deviceProperties.pipelineCacheUUID, VK_UUID_SIZE) != 0)) {
+		std::cout << "Pipeline cache file \"" << filename << "\" was created for a different device or driver, ignoring it\n";
+		return data;
+	}
+	data.resize((size_t)header.dataSize);
+	if (!is.read(data.data(), data.size()) || (pipelineCacheDataHash(data) != header.dataHash)) {
+		std::cerr << "Pipeline cache file \"" << filename << "\" is corrupted, ignoring it\n";
+		data.clear();
+		return data;
+	}
+	// Also validate the header written by the driver (see "Pipeline Cache Header" in the spec)
+	uint32_t vkHeader[4];
+	if (data.size() < sizeof(vkHeader) + VK_UUID_SIZE) {
+		data.clear();
+		return data;
+	}
+	memcpy(vkHeader, data.data(), sizeof(vkHeader));
+	if ((vkHeader[0] < sizeof(vkHeader) + VK_UUID_SIZE) || (vkHeader[1] != VK_PIPELINE_CACHE_HEADER_VERSION_ONE) || (vkHeader[2] != deviceProperties.vendorID) || (vkHeader[3] != deviceProperties.deviceID) || (memcmp(data.data() + sizeof(vkHeader), deviceProperties.pipelineCacheUUID, VK_UUID_SIZE) != 0)) {
+		std::cerr << "Pipeline cache file \"" << filename << "\" contains an incompatible pipeline cache, ignoring it\n";
+		data.clear();
+	}
+	return data;
+}
+
 void VulkanExampleBase::createPipelineCache()
 {
+	std::vector<char> cacheData;
+	if (pipelineCacheFile != "") {
+		cacheData = loadPipelineCacheData(pipelineCacheFile, deviceProperties);
+	}
+	pipelineCacheWarm = !cacheData.empty();
+
 	VkPipelineCacheCreateInfo pipelineCacheCreateInfo = {};
 	pipelineCacheCreateInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_CACHE_CREATE_INFO;
-	VK_CHECK_RESULT(vkCreatePipelineCache(device, &pipelineCacheCreateInfo, nullptr, &pipelineCache));
+	pipelineCacheCreateInfo.initialDataSize = cacheData.size();
+	pipelineCacheCreateInfo.pInitialData = cacheData.empty() ? nullptr : cacheData.data();
+	VkResult result = vkCreatePipelineCache(device, &pipelineCacheCreateInfo, nullptr, &pipelineCache);
+	if ((result != VK_SUCCESS) && pipelineCacheWarm) {
+		// Fall back to an empty cache if the driver still rejects the data
+		std::cerr << "Could not create pipeline cache from \"" << pipelineCacheFile << "\" (" << vks::tools::errorString(result) << "), starting with an empty cache\n";
+		pipelineCacheWarm = false;
+		pipelineCacheCreateInfo.initialDataSize = 0;
+		pipelineCacheCreateInfo.pInitialData = nullptr;
+		result = vkCreatePipelineCache(device, &pipelineCacheCreateInfo, nullptr, &pipelineCache);
+	}
+	VK_CHECK_RESULT(result);
+}
+
+VkPipelineCache VulkanExampleBase::createThreadPipelineCache()
+{
+	// Seed the new cache with the current contents of the main cache so worker threads also benefit from a warm cache
+	size_t dataSize = 0;
+	VK_CHECK_RESULT(vkGetPipelineCacheData(device, pipelineCache, &dataSize, nullptr));
+	std::vector<char> data(dataSize);
+	if (dataSize > 0) {
+		VK_CHECK_RESULT(vkGetPipelineCacheData(device, pipelineCache, &dataSize, data.data()));
+	}
+	VkPipelineCacheCreateInfo pipelineCacheCreateInfo = {};
+	pipelineCacheCreateInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_CACHE_CREATE_INFO;
+	pipelineCacheCreateInfo.initialDataSize = dataSize;
+	pipelineCacheCreateInfo.pInitialData = (dataSize > 0) ? data.data() : nullptr;
+	VkPipelineCache threadPipelineCache;
+	VK_CHECK_RESULT(vkCreatePipelineCache(device, &pipelineCacheCreateInfo, nullptr, &threadPipelineCache));
+	threadPipelineCaches.push_back(threadPipelineCache);
+	return threadPipelineCache;
+}
+
+void VulkanExampleBase::savePipelineCache()
+{
+	// Merge pipelines created on other threads into the main cache
+	if (!threadPipelineCaches.empty()) {
+		VK_CHECK_RESULT(vkMergePipelineCaches(device, pipelineCache, static_cast<uint32_t>(threadPipelineCaches.size()), threadPipelineCaches.data()));
+		for (auto& threadPipelineCache : threadPipelineCaches) {
+			vkDestroyPipelineCache(device, threadPipelineCache, nullptr);
+		}
+		threadPipelineCaches.clear();
+	}
+
+	if (pipelineCacheFile == "") {
+		return;
+	}
+
+	size_t dataSize = 0;
+	VK_CHECK_RESULT(vkGetPipelineCacheData(device, pipelineCache, &dataSize, nullptr));
+	std::vector<char> data(dataSize);
+	if (dataSize > 0) {
+		VK_CHECK_RESULT(vkGetPipelineCacheData(device, pipelineCache, &dataSize, data.data()));
+	}
+	data.resize(dataSize);
+
+	PipelineCacheFileHeader header{};
+	header.magic = pipelineCacheFileMagic;
+	header.version = pipelineCacheFileVersion;
+	header.vendorID = deviceProperties.vendorID;
+	header.deviceID = deviceProperties.deviceID;
+	header.driverVersion = deviceProperties.driverVersion;
+	memcpy(header.pipelineCacheUUID, deviceProperties.pipelineCacheUUID, VK_UUID_SIZE);
+	header.dataSize = dataSize;
+	header.dataHash = pipelineCacheDataHash(data);
+
+	// Write to a temporary file first and then replace the old cache file in one step, so an interrupted write never leaves a broken cache behind
+	const std::string tempFile = pipelineCacheFile + ".tmp";
+	{
+		std::ofstream os(tempFile, std::ios::binary | std::ios::out | std::ios::trunc);
+		if (!os.is_open()) {
+			std::cerr << "Could not write pipeline cache file \"" << tempFile << "\"\n";
+			return;
+		}
+		os.write(reinterpret_cast<const char*>(&header), sizeof(header));
+		os.write(data.data(), data.size());
+		if (!os.good()) {
+			std::cerr << "Could not write pipeline cache file \"" << tempFile << "\"\n";
+			os.close();
+			std::remove(tempFile.c_str());
+			return;
+		}
+	}
+#if defined(_WIN32)
+	bool replaced = MoveFileExA(tempFile.c_str(), pipelineCacheFile.c_str(), MOVEFILE_REPLACE_EXISTING | MOVEFILE_WRITE_THROUGH) != 0;
+#else
+	bool replaced = std::rename(tempFile.c_str(), pipelineCacheFile.c_str()) == 0;
+#endif
+	if (!replaced) {
+		std::cerr << "Could not replace pipeline cache file \"" << pipelineCacheFile << "\"\n";
+		std::remove(tempFile.c_str());
+	}
 }
 
 void VulkanExampleBase::prepare()
@@ -213,10 +395,15 @@ void VulkanExampleBase::prepare()
 	setupRenderPass();
 	createPipelineCache();
 	setupFrameBuffer();
+	gpuProfiler.prepare(vulkanDevice, vulkanDevice->queueFamilyIndices.graphics);
+	if (capturePrefix != "") {
+		prepareFrameCapture();
+	}
 	settings.overlay = settings.overlay && (!benchmark.active);
 	if (settings.overlay) {
 		UIOverlay.device = vulkanDevice;
 		UIOverlay.queue = queue;
+		UIOverlay.geometry.resize(frames.size());
 		UIOverlay.shaders = {
 			loadShader(getShadersPath() + "base/uioverlay.vert.spv", VK_SHADER_STAGE_VERTEX_BIT),
 			loadShader(getShadersPath() + "base/uioverlay.frag.spv", VK_SHADER_STAGE_FRAGMENT_BIT),
@@ -296,12 +483,24 @@ void VulkanExampleBase::nextFrame()
 
 void VulkanExampleBase::renderLoop()
 {
+	if (pipelineCacheFile != "") {
+		// Time from application start to the first frame, compare runs with a cold and a warm pipeline cache to see how much it saves
+		auto tDiff = std::chrono::duration<double, std::milli>(std::chrono::high_resolution_clock::now() - tStartup).count();
+		std::cout << "Startup time: " << tDiff << " ms (" << (pipelineCacheWarm ? "warm" : "cold") << " pipeline cache)\n";
+	}
+
 // SRS - for non-apple plaforms, handle benchmarking here within VulkanExampleBase::renderLoop()
 //     - for macOS, handle benchmarking within NSApp rendering loop via displayLinkOutputCb()
 #if !(defined(VK_USE_PLATFORM_IOS_MVK) || defined(VK_USE_PLATFORM_MACOS_MVK))
 	if (benchmark.active) {
+		benchmark.prepareGpuTimer(device, queue, vulkanDevice->queueFamilyIndices.graphics, vulkanDevice->queueFamilyProperties[vulkanDevice->queueFamilyIndices.graphics].timestampValidBits, vulkanDevice->properties.limits.timestampPeriod);
+		benchmark.warmupFinished = [this] { gpuProfiler.resetStatistics(); };
 		benchmark.run([=] { render(); }, vulkanDevice->properties);
 		vkDeviceWaitIdle(device);
+		benchmark.destroyGpuTimer();
+		for (auto& scope : gpuProfiler.getScopes()) {
+			benchmark.addPassTiming(scope.name, scope.total, scope.min, scope.max, scope.count);
+		}
 		if (benchmark.filename != "") {
 			benchmark.saveResults();
 		}
@@ -313,6 +512,10 @@ void VulkanExampleBase::renderLoop()
 	destHeight = height;
 	lastTimestamp = std::chrono::high_resolution_clock::now();
 	tPrevEnd = lastTimestamp;
+	if (settings.offscreen) {
+		renderOffscreenFrames();
+		return;
+	}
 #if defined(_WIN32)
 	MSG msg;
 	bool quitMessageReceived = false;
@@ -664,6 +867,33 @@ void VulkanExampleBase::renderLoop()
 	}
 }
 
+void VulkanExampleBase::renderOffscreenFrames()
+{
+	// There are no window events to process, render the requested number of frames and quit
+	std::cout << "Rendering " << offscreen.frameCount << " frames offscreen at " << width << "x" << height << "\n";
+	for (uint32_t i = 0; i < offscreen.frameCount; i++) {
+		if (prepared) {
+			nextFrame();
+		}
+	}
+	vkDeviceWaitIdle(device);
+}
+
+void VulkanExampleBase::prepareFrameCapture()
+{
+	if (!vks::FrameCapture::formatSupported(swapChain.colorFormat)) {
+		std::cerr << "Frame capture is not supported for the swap chain's color format\n";
+		return;
+	}
+	// Swap chain images can only be copied from if the surface supports it
+	if (!(swapChain.imageUsage & VK_IMAGE_USAGE_TRANSFER_SRC_BIT)) {
+		std::cerr << "Frame capture is not supported, the surface doesn't allow copying from swap chain images\n";
+		return;
+	}
+	// Enough slots to cover the frames in flight plus the frames waiting for a worker
+	frameCapture.prepare(vulkanDevice, vulkanDevice->queueFamilyIndices.graphics, capturePrefix, captureFormat, static_cast<uint32_t>(frames.size()) + 3);
+}
+
 void VulkanExampleBase::updateOverlay()
 {
 	if (!settings.overlay)
@@ -688,12 +918,15 @@ void VulkanExampleBase::updateOverlay()
 	ImGui::TextUnformatted(title.c_str());
 	ImGui::TextUnformatted(deviceProperties.deviceName);
 	ImGui::Text("%.2f ms/frame (%.1d fps)", (1000.0f / lastFPS), lastFPS);
+	const vks::MemoryAllocator::Statistics memoryStatistics = vulkanDevice->memoryAllocator.getStatistics();
+	ImGui::Text("%.1f / %.1f MiB in %u device allocations", memoryStatistics.usedBytes / (1024.0f * 1024.0f), memoryStatistics.reservedBytes / (1024.0f * 1024.0f), memoryStatistics.deviceMemoryCount());
 
 #if defined(VK_USE_PLATFORM_ANDROID_KHR)
 	ImGui::PushStyleVar(ImGuiStyleVar_ItemSpacing, ImVec2(0.0f, 5.0f * UIOverlay.scale));
 #endif
 	ImGui::PushItemWidth(110.0f * UIOverlay.scale);
 	OnUpdateUIOverlay(&UIOverlay);
+	gpuProfiler.drawUI(&UIOverlay);
 	ImGui::PopItemWidth();
 #if defined(VK_USE_PLATFORM_ANDROID_KHR)
 	ImGui::PopStyleVar();
@@ -703,6 +936,11 @@ void VulkanExampleBase::updateOverlay()
 	ImGui::PopStyleVar();
 	ImGui::Render();
 
+	if (frames.size() > 1) {
+		// The geometry is drawn by the next frame, wait until the GPU no longer reads that frame's buffers
+		VK_CHECK_RESULT(vkWaitForFences(device, 1, &frames[currentFrame].fence, VK_TRUE, UINT64_MAX));
+		UIOverlay.currentGeometry = currentFrame;
+	}
 	if (UIOverlay.update() || UIOverlay.updated) {
 		buildCommandBuffers();
 		UIOverlay.updated = false;
@@ -729,24 +967,61 @@ void VulkanExampleBase::drawUI(const VkCommandBuffer commandBuffer)
 
 void VulkanExampleBase::prepareFrame()
 {
+	FrameResources& frame = frames[currentFrame];
+	if (frames.size() > 1) {
+		// Wait until the GPU has finished the last frame that used this frame's resources
+		// The fence is signaled again at the end of submitFrame, even if the swap chain has to be recreated
+		VK_CHECK_RESULT(vkWaitForFences(device, 1, &frame.fence, VK_TRUE, UINT64_MAX));
+		VK_CHECK_RESULT(vkResetFences(device, 1, &frame.fence));
+	}
+	// Examples refer to these in their submissions
+	semaphores.presentComplete = frame.presentComplete;
 	// Acquire the next image from the swap chain
 	VkResult result = swapChain.acquireNextImage(semaphores.presentComplete, &currentBuffer);
 	// Recreate the swapchain if it's no longer compatible with the surface (OUT_OF_DATE)
 	// SRS - If no longer optimal (VK_SUBOPTIMAL_KHR), wait until submitFrame() in case number of swapchain images will change on resize
-	if ((result == VK_ERROR_OUT_OF_DATE_KHR) || (result == VK_SUBOPTIMAL_KHR)) {
-		if (result == VK_ERROR_OUT_OF_DATE_KHR) {
-			windowResize();
-		}
+	if (result == VK_ERROR_OUT_OF_DATE_KHR) {
+		windowResize();
 		return;
 	}
-	else {
+	else if (result != VK_SUBOPTIMAL_KHR) {
 		VK_CHECK_RESULT(result);
 	}
+	// The present of the last frame that rendered to this image has been queued before the image could be acquired again
+	semaphores.renderComplete = renderCompleteSemaphores[currentBuffer];
+	if (frames.size() == 1) {
+		// The last submission of the current command buffer has finished, so its GPU timings can be read without waiting
+		gpuProfiler.resolve(currentBuffer);
+		return;
+	}
+	// The acquired image (and the command buffer recorded for it) may still be used by a frame other than the one that owned this frame index before
+	if ((imageFences[currentBuffer] != VK_NULL_HANDLE) && (imageFences[currentBuffer] != frame.fence)) {
+		VK_CHECK_RESULT(vkWaitForFences(device, 1, &imageFences[currentBuffer], VK_TRUE, UINT64_MAX));
+	}
+	imageFences[currentBuffer] = frame.fence;
+	// Examples that record every frame use the frame index as the profiler slot
+	gpuProfiler.resolve(currentFrame);
 }
 
 void VulkanExampleBase::submitFrame()
 {
-	VkResult result = swapChain.queuePresent(queue, currentBuffer, semaphores.renderComplete);
+	if (benchmark.active) {
+		benchmark.markFrameSubmitted();
+	}
+	VkSemaphore presentWaitSemaphore = semaphores.renderComplete;
+	if (frameCapture.active()) {
+		// The copy waits for rendering to finish, presentation then waits for the copy
+		presentWaitSemaphore = frameCapture.capture(queue, swapChain.images[currentBuffer], swapChain.colorFormat, width, height, semaphores.renderComplete);
+	}
+	const bool framesInFlight = frames.size() > 1;
+	// The example has submitted the command buffer of the slot resolved in prepareFrame
+	gpuProfiler.markSubmitted(framesInFlight ? currentFrame : currentBuffer);
+	if (framesInFlight) {
+		// An empty submission signals the fence once everything the example submitted for this frame has finished
+		VK_CHECK_RESULT(vkQueueSubmit(queue, 0, nullptr, frames[currentFrame].fence));
+		currentFrame = (currentFrame + 1) % static_cast<uint32_t>(frames.size());
+	}
+	VkResult result = swapChain.queuePresent(queue, currentBuffer, presentWaitSemaphore);
 	// Recreate the swapchain if it's no longer compatible with the surface (OUT_OF_DATE) or no longer optimal for presentation (SUBOPTIMAL)
 	if ((result == VK_ERROR_OUT_OF_DATE_KHR) || (result == VK_SUBOPTIMAL_KHR)) {
 		windowResize();
@@ -757,11 +1032,15 @@ void VulkanExampleBase::submitFrame()
 	else {
 		VK_CHECK_RESULT(result);
 	}
-	VK_CHECK_RESULT(vkQueueWaitIdle(queue));
+	if (!framesInFlight) {
+		VK_CHECK_RESULT(vkQueueWaitIdle(queue));
+	}
 }
 
 VulkanExampleBase::VulkanExampleBase(bool enableValidation)
 {
+	tStartup = std::chrono::high_resolution_clock::now();
+
 #if !defined(VK_USE_PLATFORM_ANDROID_KHR)
 	// Check for a valid asset path
 	struct stat info;
@@ -793,8 +1072,14 @@ VulkanExampleBase::VulkanExampleBase(bool enableValidation)
 	commandLineParser.add("benchmarkwarmup", { "-bw", "--benchwarmup" }, 1, "Set warmup time for benchmark mode in seconds");
 	commandLineParser.add("benchmarkruntime", { "-br", "--benchruntime" }, 1, "Set duration time for benchmark mode in seconds");
 	commandLineParser.add("benchmarkresultfile", { "-bf", "--benchfilename" }, 1, "Set file name for benchmark results");
-	commandLineParser.add("benchmarkresultframes", { "-bt", "--benchframetimes" }, 0, "Save frame times to benchmark results file");
+	commandLineParser.add("benchmarkresultframes", { "-bt", "--benchframetimes" }, 0, "Save frame times to benchmark results file (statistics are always saved)");
 	commandLineParser.add("benchmarkframes", { "-bfs", "--benchmarkframes" }, 1, "Only render the given number of frames");
+	commandLineParser.add("framesinflight", { "-fif", "--framesinflight" }, 1, "Set the number of frames prepared ahead of the GPU (1-3, only for examples that support it)");
+	commandLineParser.add("offscreen", { "-os", "--offscreen" }, 0, "Render to offscreen images without a window, then exit");
+	commandLineParser.add("offscreenframes", { "-osf", "--offscreenframes" }, 1, "Set the number of frames rendered in offscreen mode");
+	commandLineParser.add("capture", { "-cap", "--capture" }, 1, "Save every rendered frame to files starting with the given prefix");
+	commandLineParser.add("captureformat", { "-capf", "--captureformat" }, 1, "Select file format for captured frames (png, qoi or raw)");
+	commandLineParser.add("pipelinecache", { "-pc", "--pipelinecache" }, 1, "Load the pipeline cache from the given file at startup and store it there on exit");
 
 	commandLineParser.parse(args);
 	if (commandLineParser.isSet("help")) {
@@ -848,6 +1133,31 @@ VulkanExampleBase::VulkanExampleBase(bool enableValidation)
 	if (commandLineParser.isSet("benchmarkframes")) {
 		benchmark.outputFrames = commandLineParser.getValueAsInt("benchmarkframes", benchmark.outputFrames);
 	}
+	if (commandLineParser.isSet("framesinflight")) {
+		settings.framesInFlight = std::min(std::max(commandLineParser.getValueAsInt("framesinflight", settings.framesInFlight), 1), 3);
+	}
+	if (commandLineParser.isSet("pipelinecache")) {
+		pipelineCacheFile = commandLineParser.getValueAsString("pipelinecache", "");
+	}
+	if (commandLineParser.isSet("offscreen")) {
+#if defined(VK_USE_PLATFORM_ANDROID_KHR) || defined(VK_USE_PLATFORM_IOS_MVK) || defined(VK_USE_PLATFORM_MACOS_MVK)
+		std::cerr << "Offscreen mode is not supported on this platform\n";
+#else
+		settings.offscreen = true;
+#endif
+	}
+	if (commandLineParser.isSet("offscreenframes")) {
+		offscreen.frameCount = std::max(commandLineParser.getValueAsInt("offscreenframes", offscreen.frameCount), 1);
+	}
+	if (commandLineParser.isSet("capture")) {
+		capturePrefix = commandLineParser.getValueAsString("capture", "");
+	}
+	if (commandLineParser.isSet("captureformat")) {
+		const std::string formatName = commandLineParser.getValueAsString("captureformat", "png");
+		if (!vks::FrameCapture::parseFormat(formatName, captureFormat)) {
+			std::cerr << "Unknown capture format \"" << formatName << "\", using png\n";
+		}
+	}
 
 #if defined(VK_USE_PLATFORM_ANDROID_KHR)
 	// Vulkan library is loaded dynamically on Android
@@ -856,9 +1166,13 @@ VulkanExampleBase::VulkanExampleBase(bool enableValidation)
 #elif defined(_DIRECT2DISPLAY)
 
 #elif defined(VK_USE_PLATFORM_WAYLAND_KHR)
-	initWaylandConnection();
+	if (!settings.offscreen) {
+		initWaylandConnection();
+	}
 #elif defined(VK_USE_PLATFORM_XCB_KHR)
-	initxcbConnection();
+	if (!settings.offscreen) {
+		initxcbConnection();
+	}
 #endif
 
 #if defined(_WIN32)
@@ -869,10 +1183,17 @@ VulkanExampleBase::VulkanExampleBase(bool enableValidation)
 	}
 	setupDPIAwareness();
 #endif
+
+	// Models created by the example decode their images with this job system instead of starting their own
+	jobSystem.start();
+	vkglTF::loadingJobSystem = &jobSystem;
 }
 
 VulkanExampleBase::~VulkanExampleBase()
 {
+	if (vkglTF::loadingJobSystem == &jobSystem) {
+		vkglTF::loadingJobSystem = nullptr;
+	}
 	// Clean up Vulkan resources
 	swapChain.cleanup();
 	if (descriptorPool != VK_NULL_HANDLE)
@@ -897,20 +1218,30 @@ VulkanExampleBase::~VulkanExampleBase()
 	vkDestroyImage(device, depthStencil.image, nullptr);
 	vkFreeMemory(device, depthStencil.mem, nullptr);
 
+	savePipelineCache();
 	vkDestroyPipelineCache(device, pipelineCache, nullptr);
 
 	vkDestroyCommandPool(device, cmdPool, nullptr);
 
-	vkDestroySemaphore(device, semaphores.presentComplete, nullptr);
-	vkDestroySemaphore(device, semaphores.renderComplete, nullptr);
+	destroyFrameResources();
 	for (auto& fence : waitFences) {
 		vkDestroyFence(device, fence, nullptr);
 	}
+	for (auto& semaphore : renderCompleteSemaphores) {
+		vkDestroySemaphore(device, semaphore, nullptr);
+	}
 
 	if (settings.overlay) {
 		UIOverlay.freeResources();
 	}
 
+	gpuProfiler.destroy();
+
+	if (frameCapture.active()) {
+		frameCapture.destroy();
+		frameCapture.printSummary();
+	}
+
 	delete vulkanDevice;
 
 	if (settings.validation)
@@ -934,24 +1265,28 @@ VulkanExampleBase::~VulkanExampleBase()
 	if (dfb)
 		dfb->Release(dfb);
 #elif defined(VK_USE_PLATFORM_WAYLAND_KHR)
-	xdg_toplevel_destroy(xdg_toplevel);
-	xdg_surface_destroy(xdg_surface);
-	wl_surface_destroy(surface);
-	if (keyboard)
-		wl_keyboard_destroy(keyboard);
-	if (pointer)
-		wl_pointer_destroy(pointer);
-	if (seat)
-		wl_seat_destroy(seat);
-	xdg_wm_base_destroy(shell);
-	wl_compositor_destroy(compositor);
-	wl_registry_destroy(registry);
-	wl_display_disconnect(display);
+	if (!settings.offscreen) {
+		xdg_toplevel_destroy(xdg_toplevel);
+		xdg_surface_destroy(xdg_surface);
+		wl_surface_destroy(surface);
+		if (keyboard)
+			wl_keyboard_destroy(keyboard);
+		if (pointer)
+			wl_pointer_destroy(pointer);
+		if (seat)
+			wl_seat_destroy(seat);
+		xdg_wm_base_destroy(shell);
+		wl_compositor_destroy(compositor);
+		wl_registry_destroy(registry);
+		wl_display_disconnect(display);
+	}
 #elif defined(VK_USE_PLATFORM_ANDROID_KHR)
 	// todo : android cleanup (if required)
 #elif defined(VK_USE_PLATFORM_XCB_KHR)
-	xcb_destroy_window(connection, window);
-	xcb_disconnect(connection);
+	if (!settings.offscreen) {
+		xcb_destroy_window(connection, window);
+		xcb_disconnect(connection);
+	}
 #endif
 }
 
@@ -1038,6 +1373,8 @@ bool VulkanExampleBase::initVulkan()
 	// Derived examples can enable extensions based on the list of supported extensions read from the physical device
 	getEnabledExtensions();
 
+	// VK_KHR_swapchain is required in offscreen mode too: the render passes of the base class and the examples use VK_IMAGE_LAYOUT_PRESENT_SRC_KHR
+	// as the final layout of their color attachments, which is only valid with that extension enabled
 	VkResult res = vulkanDevice->createLogicalDevice(enabledFeatures, enabledDeviceExtensions, deviceCreatepNextChain);
 	if (res != VK_SUCCESS) {
 		vks::tools::exitFatal("Could not create Vulkan device: \n" + vks::tools::errorString(res), res);
@@ -1054,17 +1391,11 @@ bool VulkanExampleBase::initVulkan()
 
 	swapChain.connect(instance, physicalDevice, device);
 
-	// Create synchronization objects
-	VkSemaphoreCreateInfo semaphoreCreateInfo = vks::initializers::semaphoreCreateInfo();
-	// Create a semaphore used to synchronize image presentation
-	// Ensures that the image is displayed before we start submitting new commands to the queue
-	VK_CHECK_RESULT(vkCreateSemaphore(device, &semaphoreCreateInfo, nullptr, &semaphores.presentComplete));
-	// Create a semaphore used to synchronize command submission
-	// Ensures that the image is not presented until all commands have been submitted and executed
-	VK_CHECK_RESULT(vkCreateSemaphore(device, &semaphoreCreateInfo, nullptr, &semaphores.renderComplete));
+	// Create synchronization objects for each frame in flight
+	createFrameResources();
 
 	// Set up submit info structure
-	// Semaphores will stay the same during application lifetime
+	// The semaphores pointed to are switched to the ones of the current frame by prepareFrame
 	// Command buffer submission info is set by each example
 	submitInfo = vks::initializers::submitInfo();
 	submitInfo.pWaitDstStageMask = &submitPipelineStages;
@@ -1111,6 +1442,9 @@ void VulkanExampleBase::setupDPIAwareness()
 HWND VulkanExampleBase::setupWindow(HINSTANCE hinstance, WNDPROC wndproc)
 {
 	this->windowInstance = hinstance;
+	if (settings.offscreen) {
+		return nullptr;
+	}
 
 	WNDCLASSEX wndClass;
 
@@ -1871,7 +2205,14 @@ void VulkanExampleBase::displayLinkOutputCb()
 {
 #if defined(VK_EXAMPLE_XCODE_GENERATED)
 	if (benchmark.active) {
+		benchmark.prepareGpuTimer(device, queue, vulkanDevice->queueFamilyIndices.graphics, vulkanDevice->queueFamilyProperties[vulkanDevice->queueFamilyIndices.graphics].timestampValidBits, vulkanDevice->properties.limits.timestampPeriod);
+		benchmark.warmupFinished = [this] { gpuProfiler.resetStatistics(); };
 		benchmark.run([=] { render(); }, vulkanDevice->properties);
+		vkDeviceWaitIdle(device);
+		benchmark.destroyGpuTimer();
+		for (auto& scope : gpuProfiler.getScopes()) {
+			benchmark.addPassTiming(scope.name, scope.total, scope.min, scope.max, scope.count);
+		}
 		if (benchmark.filename != "") {
 			benchmark.saveResults();
 		}
@@ -2412,6 +2753,9 @@ static const struct xdg_toplevel_listener xdg_toplevel_listener = {
 
 struct xdg_surface *VulkanExampleBase::setupWindow()
 {
+	if (settings.offscreen) {
+		return nullptr;
+	}
 	surface = wl_compositor_create_surface(compositor);
 	xdg_surface = xdg_wm_base_get_xdg_surface(shell, surface);
 
@@ -2436,6 +2780,10 @@ static inline xcb_intern_atom_reply_t* intern_atom_helper(xcb_connection_t *conn
 // Set up a window using XCB and request event types
 xcb_window_t VulkanExampleBase::setupWindow()
 {
+	if (settings.offscreen) {
+		return 0;
+	}
+
 	uint32_t value_mask, value_list[32];
 
 	window = xcb_generate_id(connection);
@@ -2669,6 +3017,40 @@ void VulkanExampleBase::createSynchronizationPrimitives()
 	for (auto& fence : waitFences) {
 		VK_CHECK_RESULT(vkCreateFence(device, &fenceCreateInfo, nullptr, &fence));
 	}
+	// No image has been rendered to by any frame yet
+	imageFences.assign(swapChain.imageCount, VK_NULL_HANDLE);
+	// Ensures that an image is not presented until all commands have been submitted and executed
+	VkSemaphoreCreateInfo semaphoreCreateInfo = vks::initializers::semaphoreCreateInfo();
+	renderCompleteSemaphores.resize(swapChain.imageCount);
+	for (auto& semaphore : renderCompleteSemaphores) {
+		VK_CHECK_RESULT(vkCreateSemaphore(device, &semaphoreCreateInfo, nullptr, &semaphore));
+	}
+	semaphores.renderComplete = renderCompleteSemaphores[0];
+}
+
+void VulkanExampleBase::createFrameResources()
+{
+	const uint32_t frameCount = std::max(std::min(settings.framesInFlight, maxFramesInFlight), 1u);
+	frames.resize(frameCount);
+	VkSemaphoreCreateInfo semaphoreCreateInfo = vks::initializers::semaphoreCreateInfo();
+	// Created signaled so waiting in the first prepareFrame of each frame returns immediately
+	VkFenceCreateInfo fenceCreateInfo = vks::initializers::fenceCreateInfo(VK_FENCE_CREATE_SIGNALED_BIT);
+	for (auto& frame : frames) {
+		// Ensures that the image is displayed before we start submitting new commands to the queue
+		VK_CHECK_RESULT(vkCreateSemaphore(device, &semaphoreCreateInfo, nullptr, &frame.presentComplete));
+		VK_CHECK_RESULT(vkCreateFence(device, &fenceCreateInfo, nullptr, &frame.fence));
+	}
+	currentFrame = 0;
+	semaphores.presentComplete = frames[0].presentComplete;
+}
+
+void VulkanExampleBase::destroyFrameResources()
+{
+	for (auto& frame : frames) {
+		vkDestroySemaphore(device, frame.presentComplete, nullptr);
+		vkDestroyFence(device, frame.fence, nullptr);
+	}
+	frames.clear();
 }
 
 void VulkanExampleBase::createCommandPool()
@@ -2862,10 +3244,13 @@ void VulkanExampleBase::windowResize()
 	createCommandBuffers();
 	buildCommandBuffers();
 	
-	// SRS - Recreate fences in case number of swapchain images has changed on resize
+	// SRS - Recreate fences (and the per image semaphores) in case number of swapchain images has changed on resize
 	for (auto& fence : waitFences) {
 		vkDestroyFence(device, fence, nullptr);
 	}
+	for (auto& semaphore : renderCompleteSemaphores) {
+		vkDestroySemaphore(device, semaphore, nullptr);
+	}
 	createSynchronizationPrimitives();
 
 	vkDeviceWaitIdle(device);
@@ -2918,6 +3303,12 @@ void VulkanExampleBase::windowResized() {}
 
 void VulkanExampleBase::initSwapchain()
 {
+	if (settings.offscreen) {
+		// No surface, the images are created by setupSwapChain
+		// The command pool is created before that and uses the swap chain's queue family, so it has to be known here already
+		swapChain.queueNodeIndex = vulkanDevice->queueFamilyIndices.graphics;
+		return;
+	}
 #if defined(_WIN32)
 	swapChain.initSurface(windowInstance, window);
 #elif defined(VK_USE_PLATFORM_ANDROID_KHR)
@@ -2937,6 +3328,10 @@ void VulkanExampleBase::initSwapchain()
 
 void VulkanExampleBase::setupSwapChain()
 {
+	if (settings.offscreen) {
+		swapChain.createOffscreen(width, height, queue, vulkanDevice->queueFamilyIndices.graphics);
+		return;
+	}
 	swapChain.create(&width, &height, settings.vsync, settings.fullscreen);
 }
 
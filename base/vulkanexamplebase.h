@@ -72,6 +72,9 @@
 #include "VulkanInitializers.hpp"
 #include "camera.hpp"
 #include "benchmark.hpp"
+#include "gpuprofiler.hpp"
+#include "framecapture.hpp"
+#include "jobsystem.hpp"
 
 class VulkanExampleBase
 {
@@ -85,13 +88,38 @@ private:
 	void nextFrame();
 	void updateOverlay();
 	void createPipelineCache();
+	void savePipelineCache();
 	void createCommandPool();
 	void createSynchronizationPrimitives();
+	void createFrameResources();
+	void destroyFrameResources();
+	// Fence of the frame that last rendered to each swap chain image, frames may finish in a different order than images are acquired
+	std::vector<VkFence> imageFences;
+	// Signaled when rendering to a swap chain image has finished and waited on by its presentation, one per image as a
+	// present may still be pending when the frame that signaled the semaphore comes around again
+	std::vector<VkSemaphore> renderCompleteSemaphores;
 	void initSwapchain();
 	void setupSwapChain();
 	void createCommandBuffers();
 	void destroyCommandBuffers();
 	std::string shaderDir = "glsl";
+	// Optional file the pipeline cache is loaded from at startup and written back to at shutdown
+	std::string pipelineCacheFile = "";
+	// Set if the pipeline cache could be initialized from a valid file
+	bool pipelineCacheWarm = false;
+	// Additional pipeline caches (e.g. used by worker threads) that are merged into the main cache before it's saved
+	std::vector<VkPipelineCache> threadPipelineCaches;
+	std::chrono::time_point<std::chrono::high_resolution_clock> tStartup;
+	// Offscreen mode: number of frames to render
+	struct {
+		uint32_t frameCount = 100;
+	} offscreen;
+	void renderOffscreenFrames();
+	// Frame capture: file name prefix and format, capturing is enabled if the prefix is set
+	std::string capturePrefix = "";
+	vks::FrameCapture::Format captureFormat = vks::FrameCapture::Format::Png;
+	vks::FrameCapture frameCapture;
+	void prepareFrameCapture();
 protected:
 	// Returns the path to the root of the glsl or hlsl shader directory.
 	std::string getShadersPath() const;
@@ -145,9 +173,11 @@ protected:
 	std::vector<VkShaderModule> shaderModules;
 	// Pipeline cache object
 	VkPipelineCache pipelineCache;
+	/** @brief Creates a separate pipeline cache for pipeline creation on other threads, it's merged into the main pipeline cache at shutdown */
+	VkPipelineCache createThreadPipelineCache();
 	// Wraps the swap chain to present images (framebuffers) to the windowing system
 	VulkanSwapChain swapChain;
-	// Synchronization semaphores
+	// Synchronization semaphores of the current frame and the acquired swap chain image (set by prepareFrame)
 	struct {
 		// Swap chain image presentation
 		VkSemaphore presentComplete;
@@ -155,6 +185,27 @@ protected:
 		VkSemaphore renderComplete;
 	} semaphores;
 	std::vector<VkFence> waitFences;
+	/** @brief Synchronization objects and command buffer owned by one frame in flight */
+	struct FrameResources {
+		VkSemaphore presentComplete = VK_NULL_HANDLE;
+		/** @brief Signaled once all work submitted for the frame has finished on the GPU */
+		VkFence fence = VK_NULL_HANDLE;
+		/** @brief Primary command buffer for examples that record their commands every frame */
+		VkCommandBuffer commandBuffer = VK_NULL_HANDLE;
+	};
+	/** @brief One entry per frame the CPU may prepare while the GPU is still working on earlier frames */
+	std::vector<FrameResources> frames;
+	/**
+	* @brief Index into frames for the frame that is currently prepared
+	* After prepareFrame has returned, the GPU is done with all resources that were last used by this frame index and with drawCmdBuffers[currentBuffer]
+	*/
+	uint32_t currentFrame = 0;
+	/**
+	* @brief Highest number of frames in flight the example supports (can be set in the derived constructor)
+	* Defaults to one, which waits for the queue to become idle at the end of every frame. Examples that raise this must
+	* keep a copy per frame of everything they update from the CPU (uniform buffers, command buffers, etc.) and select it using currentFrame
+	*/
+	uint32_t maxFramesInFlight = 1;
 public:
 	bool prepared = false;
 	bool resized = false;
@@ -170,6 +221,12 @@ public:
 
 	vks::Benchmark benchmark;
 
+	/** @brief GPU timings of named scopes recorded by the example, shown in the UI overlay and written to the benchmark results */
+	vks::GpuProfiler gpuProfiler;
+
+	/** @brief Job system shared by the example and the glTF loader, started with all hardware threads by the calling thread of the constructor */
+	vks::JobSystem jobSystem;
+
 	/** @brief Encapsulated physical and logical vulkan device */
 	vks::VulkanDevice *vulkanDevice;
 
@@ -183,6 +240,10 @@ public:
 		bool vsync = false;
 		/** @brief Enable UI overlay */
 		bool overlay = true;
+		/** @brief Render to an internal ring of images instead of a window, for running without a display (set via command line) */
+		bool offscreen = false;
+		/** @brief Number of frames the CPU may prepare ahead of the GPU, limited to what the example supports (maxFramesInFlight) */
+		uint32_t framesInFlight = 2;
 	} settings;
 
 	VkClearColorValue defaultClearColor = { { 0.025f, 0.025f, 0.025f, 1.0f } };
@@ -383,9 +444,9 @@ public:
 	/** @brief Adds the drawing commands for the ImGui overlay to the given command buffer */
 	void drawUI(const VkCommandBuffer commandBuffer);
 
-	/** Prepare the next frame for workload submission by acquiring the next swap chain image */
+	/** Prepare the next frame for workload submission by acquiring the next swap chain image (waits for the frame that last used currentFrame's resources to finish) */
 	void prepareFrame();
-	/** @brief Presents the current image to the swap chain */
+	/** @brief Presents the current image to the swap chain, with only one frame in flight this also waits for the queue to become idle */
 	void submitFrame();
 	/** @brief (Virtual) Default image acquire + submission and command buffer submission function */
 	virtual void renderFrame();
@@ -7,6 +7,8 @@ import sys
 parser = argparse.ArgumentParser(description='Compile all GLSL shaders')
 parser.add_argument('--glslang', type=str, help='path to glslangvalidator executable')
 parser.add_argument('--g', action='store_true', help='compile with debug symbols')
+parser.add_argument('--validate', action='store_true', help='run spirv-val on every compiled shader')
+parser.add_argument('--spirv-val', type=str, help='path to spirv-val executable')
 args = parser.parse_args()
 
 def findGlslang():
@@ -27,7 +29,26 @@ def findGlslang():
 
     sys.exit("Could not find DXC executable on PATH, and was not specified with --dxc")
 
+def findSpirvVal():
+    def isExe(path):
+        return os.path.isfile(path) and os.access(path, os.X_OK)
+
+    if args.spirv_val != None and isExe(args.spirv_val):
+        return args.spirv_val
+
+    exe_name = "spirv-val"
+    if os.name == "nt":
+        exe_name += ".exe"
+
+    for exe_dir in os.environ["PATH"].split(os.pathsep):
+        full_path = os.path.join(exe_dir, exe_name)
+        if isExe(full_path):
+            return full_path
+
+    sys.exit("Could not find spirv-val executable on PATH, and was not specified with --spirv-val")
+
 glslang_path = findGlslang()
+spirv_val_path = findSpirvVal() if args.validate else None
 dir_path = os.path.dirname(os.path.realpath(__file__))
 dir_path = dir_path.replace('\\', '/')
 for root, dirs, files in os.walk(dir_path):
@@ -40,10 +61,17 @@ for root, dirs, files in os.walk(dir_path):
             if args.g:
                 add_params = "-g"
 
+            target_env = "vulkan1.0"
             if file.endswith(".rgen") or file.endswith(".rchit") or file.endswith(".rmiss"):
                add_params = add_params + " --target-env vulkan1.2"
+               target_env = "vulkan1.2"
 
             res = subprocess.call("%s -V %s -o %s %s" % (glslang_path, input_file, output_file, add_params), shell=True)
             # res = subprocess.call([glslang_path, '-V', input_file, '-o', output_file, add_params], shell=True)
             if res != 0:
-                sys.exit()
\ No newline at end of file
+                sys.exit()
+
+            if spirv_val_path != None:
+                res = subprocess.call([spirv_val_path, '--target-env', target_env, output_file])
+                if res != 0:
+                    sys.exit("Validation of %s failed" % output_file)
\ No newline at end of file
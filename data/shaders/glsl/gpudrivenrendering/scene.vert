@@ -0,0 +1,77 @@
+#version 450
+
+// Packed vertex format, see vkglTF::VertexFormat
+layout (location = 0) in vec3 inPos;
+layout (location = 1) in vec2 inNormal;
+layout (location = 2) in vec2 inUV;
+layout (location = 3) in vec3 inColor;
+layout (location = 4) in vec2 inTangent;
+
+layout (set = 0, binding = 0) uniform UBOScene 
+{
+	mat4 projection;
+	mat4 view;
+	mat4 vertexDequantization;
+	vec4 lightPos;
+	vec4 viewPos;
+} uboScene;
+
+struct LOD
+{
+	uint firstIndex;
+	uint indexCount;
+	float distance;
+	float _pad0;
+};
+
+struct Object
+{
+	mat4 matrix;
+	vec4 boundsMin;
+	vec4 boundsMax;
+	uint materialIndex;
+	uint lodCount;
+	uint _pad0;
+	uint _pad1;
+	LOD lods[4];
+};
+
+layout (set = 1, binding = 0, std430) readonly buffer Objects
+{
+	Object objects[];
+};
+
+layout (location = 0) out vec3 outNormal;
+layout (location = 1) out vec3 outColor;
+layout (location = 2) out vec2 outUV;
+layout (location = 3) out vec3 outViewVec;
+layout (location = 4) out vec3 outLightVec;
+layout (location = 5) out vec4 outTangent;
+layout (location = 6) flat out uint outMaterialIndex;
+
+vec3 octDecode(vec2 e)
+{
+	vec3 v = vec3(e.xy, 1.0 - abs(e.x) - abs(e.y));
+	if (v.z < 0.0) {
+		v.xy = (1.0 - abs(v.yx)) * vec2(v.x >= 0.0 ? 1.0 : -1.0, v.y >= 0.0 ? 1.0 : -1.0);
+	}
+	return normalize(v);
+}
+
+void main() 
+{
+	// The culling pass stores the object index in the first instance of each draw
+	mat4 model = objects[gl_InstanceIndex].matrix;
+	outMaterialIndex = objects[gl_InstanceIndex].materialIndex;
+	outColor = inColor;
+	outUV = inUV;
+	// The handedness of the tangent is stored in the sign of its second component
+	float handedness = inTangent.y < 0.0 ? -1.0 : 1.0;
+	vec3 tangent = octDecode(vec2(inTangent.x, abs(inTangent.y) * 2.0 - 1.0));
+	outTangent = vec4(mat3(model) * tangent, handedness);
+	outNormal = mat3(model) * octDecode(inNormal);
+	vec4 pos = model * uboScene.vertexDequantization * vec4(inPos, 1.0);
+	gl_Position = uboScene.projection * uboScene.view * pos;
+	outLightVec = uboScene.lightPos.xyz - pos.xyz;
+	outViewVec = uboScene.viewPos.xyz - pos.xyz;
+}
@@ -8,6 +8,8 @@ import sys
 
 parser = argparse.ArgumentParser(description='Compile all .hlsl shaders')
 parser.add_argument('--dxc', type=str, help='path to DXC executable')
+parser.add_argument('--validate', action='store_true', help='run spirv-val on every compiled shader')
+parser.add_argument('--spirv-val', type=str, help='path to spirv-val executable')
 args = parser.parse_args()
 
 def findDXC():
@@ -28,7 +30,26 @@ def findDXC():
 
     sys.exit("Could not find DXC executable on PATH, and was not specified with --dxc")
 
+def findSpirvVal():
+    def isExe(path):
+        return os.path.isfile(path) and os.access(path, os.X_OK)
+
+    if args.spirv_val != None and isExe(args.spirv_val):
+        return args.spirv_val
+
+    exe_name = "spirv-val"
+    if os.name == "nt":
+        exe_name += ".exe"
+
+    for exe_dir in os.environ["PATH"].split(os.pathsep):
+        full_path = os.path.join(exe_dir, exe_name)
+        if isExe(full_path):
+            return full_path
+
+    sys.exit("Could not find spirv-val executable on PATH, and was not specified with --spirv-val")
+
 dxc_path = findDXC()
+spirv_val_path = findSpirvVal() if args.validate else None
 dir_path = os.path.dirname(os.path.realpath(__file__))
 dir_path = dir_path.replace('\\', '/')
 for root, dirs, files in os.walk(dir_path):
@@ -70,3 +91,7 @@ for root, dirs, files in os.walk(dir_path):
                 target,
                 hlsl_file,
                 '-Fo', spv_out])
+
+            if spirv_val_path != None:
+                target_env = 'vulkan1.2' if target != '' else 'vulkan1.0'
+                subprocess.check_output([spirv_val_path, '--target-env', target_env, spv_out])
@@ -0,0 +1,81 @@
+// Packed vertex format, see vkglTF::VertexFormat
+struct VSInput
+{
+[[vk::location(0)]] float3 Pos : POSITION0;
+[[vk::location(1)]] float2 Normal : NORMAL0;
+[[vk::location(2)]] float2 UV : TEXCOORD0;
+[[vk::location(3)]] float3 Color : COLOR0;
+[[vk::location(4)]] float2 Tangent : TEXCOORD1;
+};
+
+struct UBO
+{
+	float4x4 projection;
+	float4x4 view;
+	float4x4 vertexDequantization;
+	float4 lightPos;
+	float4 viewPos;
+};
+cbuffer ubo : register(b0) { UBO ubo; };
+
+struct LOD
+{
+	uint firstIndex;
+	uint indexCount;
+	float distance;
+	float _pad0;
+};
+
+struct Object
+{
+	float4x4 matrix;
+	float4 boundsMin;
+	float4 boundsMax;
+	uint materialIndex;
+	uint lodCount;
+	uint _pad0;
+	uint _pad1;
+	LOD lods[4];
+};
+StructuredBuffer<Object> objects : register(t0, space1);
+
+struct VSOutput
+{
+	float4 Pos : SV_POSITION;
+[[vk::location(0)]] float3 Normal : NORMAL0;
+[[vk::location(1)]] float3 Color : COLOR0;
+[[vk::location(2)]] float2 UV : TEXCOORD0;
+[[vk::location(3)]] float3 ViewVec : TEXCOORD1;
+[[vk::location(4)]] float3 LightVec : TEXCOORD2;
+[[vk::location(5)]] float4 Tangent : TEXCOORD3;
+[[vk::location(6)]] nointerpolation uint MaterialIndex : TEXCOORD4;
+};
+
+float3 octDecode(float2 e)
+{
+	float3 v = float3(e.xy, 1.0 - abs(e.x) - abs(e.y));
+	if (v.z < 0.0) {
+		v.xy = (1.0 - abs(v.yx)) * float2(v.x >= 0.0 ? 1.0 : -1.0, v.y >= 0.0 ? 1.0 : -1.0);
+	}
+	return normalize(v);
+}
+
+VSOutput main(VSInput input, uint InstanceIndex : SV_InstanceID)
+{
+	VSOutput output = (VSOutput)0;
+	// The culling pass stores the object index in the first instance of each draw
+	float4x4 model = objects[InstanceIndex].matrix;
+	output.MaterialIndex = objects[InstanceIndex].materialIndex;
+	output.Color = input.Color;
+	output.UV = input.UV;
+	// The handedness of the tangent is stored in the sign of its second component
+	float handedness = input.Tangent.y < 0.0 ? -1.0 : 1.0;
+	float3 tangent = octDecode(float2(input.Tangent.x, abs(input.Tangent.y) * 2.0 - 1.0));
+	output.Tangent = float4(mul((float3x3)model, tangent), handedness);
+	output.Normal = mul((float3x3)model, octDecode(input.Normal));
+	float4 pos = mul(model, mul(ubo.vertexDequantization, float4(input.Pos, 1.0)));
+	output.Pos = mul(ubo.projection, mul(ubo.view, pos));
+	output.LightVec = ubo.lightPos.xyz - pos.xyz;
+	output.ViewVec = ubo.viewPos.xyz - pos.xyz;
+	return output;
+}
@@ -145,6 +145,14 @@ public:
 		cubemap.destroy();
 	}
 
+	virtual void getEnabledFeatures()
+	{
+		// Pipeline statistics are shown by the GPU profiler if supported
+		if (deviceFeatures.pipelineStatisticsQuery) {
+			enabledFeatures.pipelineStatisticsQuery = VK_TRUE;
+		}
+	}
+
 	// Setup the offscreen framebuffer for rendering the mirrored scene
 	// The color attachment of this framebuffer will then be sampled from
 	void prepareOffscreenFramebuffer(FrameBuffer *frameBuf, VkFormat colorFormat, VkFormat depthFormat)
@@ -344,6 +352,7 @@ public:
 		for (int32_t i = 0; i < drawCmdBuffers.size(); ++i)
 		{
 			VK_CHECK_RESULT(vkBeginCommandBuffer(drawCmdBuffers[i], &cmdBufInfo));
+			gpuProfiler.beginFrame(drawCmdBuffers[i], i);
 
 			if (bloom) {
 				clearValues[0].color = { { 0.0f, 0.0f, 0.0f, 1.0f } };
@@ -367,6 +376,7 @@ public:
 					First render pass: Render glow parts of the model (separate mesh) to an offscreen frame buffer
 				*/
 
+				gpuProfiler.beginScope(drawCmdBuffers[i], "Glow pass");
 				vkCmdBeginRenderPass(drawCmdBuffers[i], &renderPassBeginInfo, VK_SUBPASS_CONTENTS_INLINE);
 
 				vkCmdBindDescriptorSets(drawCmdBuffers[i], VK_PIPELINE_BIND_POINT_GRAPHICS, pipelineLayouts.scene, 0, 1, &descriptorSets.scene, 0, NULL);
@@ -375,6 +385,7 @@ public:
 				models.ufoGlow.draw(drawCmdBuffers[i]);
 
 				vkCmdEndRenderPass(drawCmdBuffers[i]);
+				gpuProfiler.endScope(drawCmdBuffers[i]);
 
 				/*
 					Second render pass: Vertical blur
@@ -385,6 +396,7 @@ public:
 
 				renderPassBeginInfo.framebuffer = offscreenPass.framebuffers[1].framebuffer;
 
+				gpuProfiler.beginScope(drawCmdBuffers[i], "Vertical blur");
 				vkCmdBeginRenderPass(drawCmdBuffers[i], &renderPassBeginInfo, VK_SUBPASS_CONTENTS_INLINE);
 
 				vkCmdBindDescriptorSets(drawCmdBuffers[i], VK_PIPELINE_BIND_POINT_GRAPHICS, pipelineLayouts.blur, 0, 1, &descriptorSets.blurVert, 0, NULL);
@@ -392,6 +404,7 @@ public:
 				vkCmdDraw(drawCmdBuffers[i], 3, 1, 0, 0);
 
 				vkCmdEndRenderPass(drawCmdBuffers[i]);
+				gpuProfiler.endScope(drawCmdBuffers[i]);
 			}
 
 			/*
@@ -416,6 +429,7 @@ public:
 				renderPassBeginInfo.clearValueCount = 2;
 				renderPassBeginInfo.pClearValues = clearValues;
 
+				gpuProfiler.beginScope(drawCmdBuffers[i], "Scene");
 				vkCmdBeginRenderPass(drawCmdBuffers[i], &renderPassBeginInfo, VK_SUBPASS_CONTENTS_INLINE);
 
 				VkViewport viewport = vks::initializers::viewport((float)width, (float)height, 0.0f, 1.0f);
@@ -436,14 +450,17 @@ public:
 
 				if (bloom)
 				{
+					gpuProfiler.beginScope(drawCmdBuffers[i], "Horizontal blur");
 					vkCmdBindDescriptorSets(drawCmdBuffers[i], VK_PIPELINE_BIND_POINT_GRAPHICS, pipelineLayouts.blur, 0, 1, &descriptorSets.blurHorz, 0, NULL);
 					vkCmdBindPipeline(drawCmdBuffers[i], VK_PIPELINE_BIND_POINT_GRAPHICS, pipelines.blurHorz);
 					vkCmdDraw(drawCmdBuffers[i], 3, 1, 0, 0);
+					gpuProfiler.endScope(drawCmdBuffers[i]);
 				}
 
 				drawUI(drawCmdBuffers[i]);
 
 				vkCmdEndRenderPass(drawCmdBuffers[i]);
+				gpuProfiler.endScope(drawCmdBuffers[i]);
 
 			}
 
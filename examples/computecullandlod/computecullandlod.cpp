@@ -22,6 +22,7 @@
 #define OBJECT_COUNT 64
 #endif
 
+// Upper limit for the number of generated detail levels
 #define MAX_LOD_LEVEL 5
 
 class VulkanExample : public VulkanExampleBase
@@ -29,8 +30,13 @@ class VulkanExample : public VulkanExampleBase
 public:
 	bool fixedFrustum = false;
 
-	// The model contains multiple versions of a single object with different levels of detail
+	// The levels of detail of the model's mesh are generated at load time by simplifying it
 	vkglTF::Model lodModel;
+	// Number of detail levels that could be generated for the mesh
+	uint32_t lodLevelCount = 0;
+	// Detail levels are switched once their error covers less than this many pixels
+	float lodPixelError = 1.0f;
+	const float instanceScale = 2.0f;
 
 	// Per-instance data block
 	struct InstanceData {
@@ -242,8 +248,9 @@ public:
 
 	void loadAssets()
 	{
-		const uint32_t glTFLoadingFlags = vkglTF::FileLoadingFlags::PreTransformVertices | vkglTF::FileLoadingFlags::PreMultiplyVertexColors | vkglTF::FileLoadingFlags::FlipY;
-		lodModel.loadFromFile(getAssetPath() + "models/suzanne_lods.gltf", vulkanDevice, queue, glTFLoadingFlags);
+		const uint32_t glTFLoadingFlags = vkglTF::FileLoadingFlags::PreTransformVertices | vkglTF::FileLoadingFlags::PreMultiplyVertexColors | vkglTF::FileLoadingFlags::FlipY | vkglTF::FileLoadingFlags::GenerateLods;
+		lodModel.lodLevelCount = MAX_LOD_LEVEL + 1;
+		lodModel.loadFromFile(getAssetPath() + "models/suzanne.gltf", vulkanDevice, queue, glTFLoadingFlags);
 	}
 
 	void buildComputeCommandBuffer()
@@ -494,7 +501,7 @@ public:
 				{
 					uint32_t index = x + y * OBJECT_COUNT + z * OBJECT_COUNT * OBJECT_COUNT;
 					instanceData[index].pos = glm::vec3((float)x, (float)y, (float)z) - glm::vec3((float)OBJECT_COUNT / 2.0f);
-					instanceData[index].scale = 2.0f;
+					instanceData[index].scale = instanceScale;
 				}
 			}
 		}
@@ -556,14 +563,25 @@ public:
 			float _pad0;
 		};
 		std::vector<LOD> LODLevels;
-		uint32_t n = 0;
-		for (auto node : lodModel.nodes)
+		const vkglTF::Primitive* primitive = nullptr;
+		for (auto node : lodModel.linearNodes)
+		{
+			if (node->mesh && !node->mesh->primitives.empty())
+			{
+				primitive = node->mesh->primitives[0];
+				break;
+			}
+		}
+		assert(primitive);
+		// A level is used until the error of the next one, scaled like the instances, covers less than lodPixelError pixels
+		const float distanceScale = vkglTF::IndirectRenderer::getLodDistanceScale(camera.matrices.perspective, (float)height, lodPixelError) * instanceScale;
+		lodLevelCount = static_cast<uint32_t>(primitive->lods.size());
+		for (uint32_t i = 0; i < lodLevelCount; i++)
 		{
 			LOD lod;
-			lod.firstIndex = node->mesh->primitives[0]->firstIndex;	// First index for this LOD
-			lod.indexCount = node->mesh->primitives[0]->indexCount;	// Index count for this LOD
-			lod.distance = 5.0f + n * 5.0f;							// Starting distance (to viewer) for this LOD
-			n++;
+			lod.firstIndex = primitive->lods[i].firstIndex;	// First index for this LOD
+			lod.indexCount = primitive->lods[i].indexCount;	// Index count for this LOD
+			lod.distance = (i + 1 < lodLevelCount) ? primitive->lods[i + 1].error * distanceScale : FLT_MAX;	// Maximum distance (to viewer) for this LOD
 			LODLevels.push_back(lod);
 		}
 
@@ -694,13 +712,13 @@ public:
 		VkComputePipelineCreateInfo computePipelineCreateInfo = vks::initializers::computePipelineCreateInfo(compute.pipelineLayout, 0);
 		computePipelineCreateInfo.stage = loadShader(getShadersPath() + "computecullandlod/cull.comp.spv", VK_SHADER_STAGE_COMPUTE_BIT);
 
-		// Use specialization constants to pass max. level of detail (determined by no. of meshes)
+		// Use specialization constants to pass max. level of detail (determined by the number of generated levels)
 		VkSpecializationMapEntry specializationEntry{};
 		specializationEntry.constantID = 0;
 		specializationEntry.offset = 0;
 		specializationEntry.size = sizeof(uint32_t);
 
-		uint32_t specializationData = static_cast<uint32_t>(lodModel.nodes.size()) - 1;
+		uint32_t specializationData = lodLevelCount - 1;
 
 		VkSpecializationInfo specializationInfo;
 		specializationInfo.mapEntryCount = 1;
@@ -843,7 +861,7 @@ public:
 		}
 		if (overlay->header("Statistics")) {
 			overlay->text("Visible objects: %d", indirectStats.drawCount);
-			for (uint32_t i = 0; i < MAX_LOD_LEVEL + 1; i++) {
+			for (uint32_t i = 0; i < lodLevelCount; i++) {
 				overlay->text("LOD %d: %d", i, indirectStats.lodCount[i]);
 			}
 		}
@@ -1,26 +1,88 @@
 /*
 * Vulkan Example - Compute shader N-body simulation using two passes and shared compute shader memory
 *
+* Alternatively simulates the particles on the GPU with a hierarchical uniform grid, or on the CPU with a Barnes-Hut octree
+* (both O(N log N) instead of all pairs), which scale to a million and more particles
+*
 * Copyright (C) by Sascha Willems - www.saschawillems.de
 *
 * This code is licensed under the MIT license (MIT) (http://opensource.org/licenses/MIT)
 */
 
 #include "vulkanexamplebase.h"
+#include "nbody.hpp"
 
 #define VERTEX_BUFFER_BIND_ID 0
 #define ENABLE_VALIDATION false
+// Default particle count, can be changed at runtime
 #if defined(__ANDROID__)
 // Lower particle count on Android for performance reasons
 #define PARTICLES_PER_ATTRACTOR 3 * 1024
 #else
 #define PARTICLES_PER_ATTRACTOR 4 * 1024
 #endif
+// Work group size of the compute shaders, the shaders don't check for the end of the particle buffer, so each attractor gets a multiple of this
+#define WORK_GROUP_SIZE 256
+// Upper particle counts per attractor, the all pairs GPU simulation is quadratic and would run into device timeouts far earlier than the CPU octree
+#define MAX_GPU_PARTICLES_PER_ATTRACTOR 16384
+#define MAX_PARTICLES_PER_ATTRACTOR 262144
+// Range of the cells per axis of the finest level of the GPU grid, the coarsest level always has 4x4x4 cells
+#define GRID_MIN_RESOLUTION 16
+#define GRID_MAX_RESOLUTION 64
 
 class VulkanExample : public VulkanExampleBase
 {
 public:
 	uint32_t numParticles;
+	uint32_t particlesPerAttractor = PARTICLES_PER_ATTRACTOR;
+	std::vector<glm::vec3> attractors;
+	std::vector<uint32_t> particleCountOptions = { 1024, 4096, 16384, 65536, 262144 };
+	int32_t particleCountIndex = 0;
+
+	enum SimulationMode { SimulationModeGPU = 0, SimulationModeGPUGrid = 1, SimulationModeBarnesHut = 2 };
+	int32_t simulationMode = SimulationModeGPU;
+	// Force law shared by the compute shaders (as specialization constants) and the CPU simulation
+	vks::nbody::Settings simulationSettings;
+
+	// Barnes-Hut simulation on the CPU, the particles are copied to the storage buffer with the compute queue every frame
+	struct {
+		vks::nbody::BarnesHut barnesHut;
+		std::vector<vks::nbody::Particle> particles;
+		vks::Buffer uploadBuffer;					// Host visible copy of the particles the storage buffer is updated from
+		float stepTime = 0.0f;
+	} cpuSimulation;
+
+	// Hierarchical uniform grid simulation on the GPU
+	// The particles are binned into the cells of the finest level (count, prefix sum and scatter passes) and each coarser level
+	// sums up eight cells of the previous one. The force pass sums up the particles of the neighbouring cells exactly, and on
+	// each level the cells that are not neighbours but whose parents are through their center of mass
+	struct {
+		uint32_t resolution = 0;					// Cells per axis of the finest level
+		uint32_t levelCount = 0;					// Number of levels down to 4x4x4 cells
+		uint32_t cellCount = 0;						// Number of cells of all levels
+		vks::Buffer bounds;							// Bounds of the particles as ordered bits, reset every step
+		vks::Buffer cellCounts;						// Particles per cell of the finest level, reset every step
+		vks::Buffer cellStarts;						// Index of the first sorted particle per cell of the finest level
+		vks::Buffer particleCells;					// Cell and position within the cell per particle
+		vks::Buffer sortedIndices;					// Particle indices sorted by cell
+		vks::Buffer sortedParticles;				// Positions and masses sorted by cell
+		vks::Buffer cellMasses;						// Center of mass and total mass per cell of all levels
+		VkDescriptorSetLayout descriptorSetLayout;
+		VkDescriptorSet descriptorSet;
+		VkPipelineLayout pipelineLayout;
+		VkPipeline pipelineBounds = VK_NULL_HANDLE;
+		VkPipeline pipelineCount = VK_NULL_HANDLE;
+		VkPipeline pipelineScan = VK_NULL_HANDLE;
+		VkPipeline pipelineScatter = VK_NULL_HANDLE;
+		VkPipeline pipelineReduce = VK_NULL_HANDLE;
+		VkPipeline pipelineForce = VK_NULL_HANDLE;
+		bool available = true;						// False if the grid shaders have not been compiled, the mode can't be selected then
+		struct PushConstants {
+			uint32_t resolution;
+			uint32_t levelCount;
+			uint32_t level;
+		} pushConstants;
+	} gpuGrid;
 
 	struct {
 		vks::Texture2D particle;
@@ -73,11 +135,8 @@ public:
 		} ubo;
 	} compute;
 
-	// SSBO particle declaration
-	struct Particle {
-		glm::vec4 pos;								// xyz = position, w = mass
-		glm::vec4 vel;								// xyz = velocity, w = gradient texture position
-	};
+	// SSBO particle declaration (xyz = position, w = mass, xyz = velocity, w = gradient texture position)
+	typedef vks::nbody::Particle Particle;
 
 	VulkanExample() : VulkanExampleBase(ENABLE_VALIDATION)
 	{
@@ -87,6 +146,39 @@ public:
 		camera.setRotation(glm::vec3(-26.0f, 75.0f, 0.0f));
 		camera.setTranslation(glm::vec3(0.0f, 0.0f, -14.0f));
 		camera.movementSpeed = 2.5f;
+#if 0
+		attractors = {
+			glm::vec3(2.5f, 1.5f, 0.0f),
+			glm::vec3(-2.5f, -1.5f, 0.0f),
+		};
+#else
+		attractors = {
+			glm::vec3(5.0f, 0.0f, 0.0f),
+			glm::vec3(-5.0f, 0.0f, 0.0f),
+			glm::vec3(0.0f, 0.0f, 5.0f),
+			glm::vec3(0.0f, 0.0f, -5.0f),
+			glm::vec3(0.0f, 4.0f, 0.0f),
+			glm::vec3(0.0f, -8.0f, 0.0f),
+		};
+#endif
+		// Sample specific command line arguments
+		commandLineParser.add("particles", { "-n", "--particles" }, 1, "Set the total number of particles (clamped to the limit of the simulation mode)");
+		commandLineParser.add("grid", { "-grid", "--grid" }, 0, "Start with the uniform grid GPU simulation");
+		commandLineParser.add("barneshut", { "-bh", "--barneshut" }, 0, "Start with the Barnes-Hut CPU simulation");
+		commandLineParser.parse(args);
+		if (commandLineParser.isSet("particles")) {
+			const uint32_t particleCount = std::max(commandLineParser.getValueAsInt("particles", 0), 1);
+			const uint32_t perAttractor = (particleCount + static_cast<uint32_t>(attractors.size()) - 1) / static_cast<uint32_t>(attractors.size());
+			particlesPerAttractor = (perAttractor + WORK_GROUP_SIZE - 1) / WORK_GROUP_SIZE * WORK_GROUP_SIZE;
+		}
+		if (commandLineParser.isSet("grid")) {
+			simulationMode = SimulationModeGPUGrid;
+		}
+		if (commandLineParser.isSet("barneshut")) {
+			simulationMode = SimulationModeBarnesHut;
+		}
+		clampParticleCount();
+		cpuSimulation.barnesHut.setSettings(simulationSettings);
 	}
 
 	~VulkanExample()
@@ -101,12 +193,22 @@ public:
 		// Compute
 		compute.storageBuffer.destroy();
 		compute.uniformBuffer.destroy();
+		cpuSimulation.uploadBuffer.destroy();
 		vkDestroyPipelineLayout(device, compute.pipelineLayout, nullptr);
 		vkDestroyDescriptorSetLayout(device, compute.descriptorSetLayout, nullptr);
 		vkDestroyPipeline(device, compute.pipelineCalculate, nullptr);
 		vkDestroyPipeline(device, compute.pipelineIntegrate, nullptr);
 		vkDestroySemaphore(device, compute.semaphore, nullptr);
 		vkDestroyCommandPool(device, compute.commandPool, nullptr);
+		destroyGridBuffers();
+		vkDestroyPipeline(device, gpuGrid.pipelineBounds, nullptr);
+		vkDestroyPipeline(device, gpuGrid.pipelineCount, nullptr);
+		vkDestroyPipeline(device, gpuGrid.pipelineScan, nullptr);
+		vkDestroyPipeline(device, gpuGrid.pipelineScatter, nullptr);
+		vkDestroyPipeline(device, gpuGrid.pipelineReduce, nullptr);
+		vkDestroyPipeline(device, gpuGrid.pipelineForce, nullptr);
+		vkDestroyPipelineLayout(device, gpuGrid.pipelineLayout, nullptr);
+		vkDestroyDescriptorSetLayout(device, gpuGrid.descriptorSetLayout, nullptr);
 
 		textures.particle.destroy();
 		textures.gradient.destroy();
@@ -225,6 +327,11 @@ public:
 
 		VK_CHECK_RESULT(vkBeginCommandBuffer(compute.commandBuffer, &cmdBufInfo));
 
+		// With the CPU simulation, the storage buffer is written by a copy instead of the compute shaders
+		const bool copyParticles = (simulationMode == SimulationModeBarnesHut);
+		const VkAccessFlags writeAccessMask = copyParticles ? VK_ACCESS_TRANSFER_WRITE_BIT : VK_ACCESS_SHADER_WRITE_BIT;
+		const VkPipelineStageFlags writeStageMask = copyParticles ? VK_PIPELINE_STAGE_TRANSFER_BIT : VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT;
+
 		// Acquire barrier
 		if (graphics.queueFamilyIndex != compute.queueFamilyIndex)
 		{
@@ -233,7 +340,7 @@ public:
 				VK_STRUCTURE_TYPE_BUFFER_MEMORY_BARRIER,
 				nullptr,
 				0,
-				VK_ACCESS_SHADER_WRITE_BIT,
+				writeAccessMask,
 				graphics.queueFamilyIndex,
 				compute.queueFamilyIndex,
 				compute.storageBuffer.buffer,
@@ -244,18 +351,66 @@ public:
 			vkCmdPipelineBarrier(
 				compute.commandBuffer,
 				VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT,
-				VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,
+				writeStageMask,
 				0,
 				0, nullptr,
 				1, &buffer_barrier,
 				0, nullptr);
 		}
 
+		if (copyParticles)
+		{
+			// The particles have been simulated on the CPU, copy them from the host visible upload buffer
+			VkBufferCopy copyRegion = {};
+			copyRegion.size = compute.storageBuffer.size;
+			vkCmdCopyBuffer(compute.commandBuffer, cpuSimulation.uploadBuffer.buffer, compute.storageBuffer.buffer, 1, &copyRegion);
+		}
+		else if (simulationMode == SimulationModeGPUGrid)
+		{
+			recordGridDispatches();
+		}
+		else
+		{
+			recordComputeDispatches();
+		}
+
+		// Release barrier
+		if (graphics.queueFamilyIndex != compute.queueFamilyIndex)
+		{
+			VkBufferMemoryBarrier buffer_barrier =
+			{
+				VK_STRUCTURE_TYPE_BUFFER_MEMORY_BARRIER,
+				nullptr,
+				writeAccessMask,
+				0,
+				compute.queueFamilyIndex,
+				graphics.queueFamilyIndex,
+				compute.storageBuffer.buffer,
+				0,
+				compute.storageBuffer.size
+			};
+
+			vkCmdPipelineBarrier(
+				compute.commandBuffer,
+				writeStageMask,
+				VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT,
+				0,
+				0, nullptr,
+				1, &buffer_barrier,
+				0, nullptr);
+		}
+
+		vkEndCommandBuffer(compute.commandBuffer);
+	}
+
+	// Records the two passes of the all pairs simulation on the GPU
+	void recordComputeDispatches()
+	{
 		// First pass: Calculate particle movement
 		// -------------------------------------------------------------------------------------------------------
 		vkCmdBindPipeline(compute.commandBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, compute.pipelineCalculate);
 		vkCmdBindDescriptorSets(compute.commandBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, compute.pipelineLayout, 0, 1, &compute.descriptorSet, 0, 0);
-		vkCmdDispatch(compute.commandBuffer, numParticles / 256, 1, 1);
+		vkCmdDispatch(compute.commandBuffer, numParticles / WORK_GROUP_SIZE, 1, 1);
 
 		// Add memory barrier to ensure that the computer shader has finished writing to the buffer
 		VkBufferMemoryBarrier bufferBarrier = vks::initializers::bufferMemoryBarrier();
@@ -279,97 +434,90 @@ public:
 		// Second pass: Integrate particles
 		// -------------------------------------------------------------------------------------------------------
 		vkCmdBindPipeline(compute.commandBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, compute.pipelineIntegrate);
-		vkCmdDispatch(compute.commandBuffer, numParticles / 256, 1, 1);
-
-		// Release barrier
-		if (graphics.queueFamilyIndex != compute.queueFamilyIndex)
-		{
-			VkBufferMemoryBarrier buffer_barrier =
-			{
-				VK_STRUCTURE_TYPE_BUFFER_MEMORY_BARRIER,
-				nullptr,
-				VK_ACCESS_SHADER_WRITE_BIT,
-				0,
-				compute.queueFamilyIndex,
-				graphics.queueFamilyIndex,
-				compute.storageBuffer.buffer,
-				0,
-				compute.storageBuffer.size
-			};
-
-			vkCmdPipelineBarrier(
-				compute.commandBuffer,
-				VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,
-				VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT,
-				0,
-				0, nullptr,
-				1, &buffer_barrier,
-				0, nullptr);
-		}
+		vkCmdDispatch(compute.commandBuffer, numParticles / WORK_GROUP_SIZE, 1, 1);
+	}
 
-		vkEndCommandBuffer(compute.commandBuffer);
+	// Makes the results of a grid pass visible to the following one
+	void addGridPassBarrier()
+	{
+		VkMemoryBarrier memoryBarrier = vks::initializers::memoryBarrier();
+		memoryBarrier.srcAccessMask = VK_ACCESS_SHADER_WRITE_BIT;
+		memoryBarrier.dstAccessMask = VK_ACCESS_SHADER_READ_BIT | VK_ACCESS_SHADER_WRITE_BIT;
+		vkCmdPipelineBarrier(compute.commandBuffer, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_FLAGS_NONE, 1, &memoryBarrier, 0, nullptr, 0, nullptr);
 	}
 
-	// Setup and fill the compute shader storage buffers containing the particles
-	void prepareStorageBuffers()
+	// Records the grid build, the force pass and the integration of the uniform grid simulation on the GPU
+	void recordGridDispatches()
 	{
-#if 0
-		std::vector<glm::vec3> attractors = {
-			glm::vec3(2.5f, 1.5f, 0.0f),
-			glm::vec3(-2.5f, -1.5f, 0.0f),
-		};
-#else
-		std::vector<glm::vec3> attractors = {
-			glm::vec3(5.0f, 0.0f, 0.0f),
-			glm::vec3(-5.0f, 0.0f, 0.0f),
-			glm::vec3(0.0f, 0.0f, 5.0f),
-			glm::vec3(0.0f, 0.0f, -5.0f),
-			glm::vec3(0.0f, 4.0f, 0.0f),
-			glm::vec3(0.0f, -8.0f, 0.0f),
-		};
-#endif
+		const uint32_t particleGroupCount = (numParticles + WORK_GROUP_SIZE - 1) / WORK_GROUP_SIZE;
 
-		numParticles = static_cast<uint32_t>(attractors.size()) * PARTICLES_PER_ATTRACTOR;
+		// The previous step's passes have to be done with the cell counts before they are reset
+		vkCmdPipelineBarrier(compute.commandBuffer, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_FLAGS_NONE, 0, nullptr, 0, nullptr, 0, nullptr);
 
-		// Initial particle positions
-		std::vector<Particle> particleBuffer(numParticles);
+		// Reset the bounds (the minimum to the largest and the maximum to the smallest ordered value) and the cell counts
+		vkCmdFillBuffer(compute.commandBuffer, gpuGrid.bounds.buffer, 0, 3 * sizeof(uint32_t), 0xFFFFFFFF);
+		vkCmdFillBuffer(compute.commandBuffer, gpuGrid.bounds.buffer, 3 * sizeof(uint32_t), 3 * sizeof(uint32_t), 0);
+		vkCmdFillBuffer(compute.commandBuffer, gpuGrid.cellCounts.buffer, 0, VK_WHOLE_SIZE, 0);
+		VkMemoryBarrier memoryBarrier = vks::initializers::memoryBarrier();
+		memoryBarrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+		memoryBarrier.dstAccessMask = VK_ACCESS_SHADER_READ_BIT | VK_ACCESS_SHADER_WRITE_BIT;
+		vkCmdPipelineBarrier(compute.commandBuffer, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_FLAGS_NONE, 1, &memoryBarrier, 0, nullptr, 0, nullptr);
 
-		std::default_random_engine rndEngine(benchmark.active ? 0 : (unsigned)time(nullptr));
-		std::normal_distribution<float> rndDist(0.0f, 1.0f);
+		vkCmdBindDescriptorSets(compute.commandBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, gpuGrid.pipelineLayout, 0, 1, &gpuGrid.descriptorSet, 0, nullptr);
+		gpuGrid.pushConstants = { gpuGrid.resolution, gpuGrid.levelCount, 0 };
+		vkCmdPushConstants(compute.commandBuffer, gpuGrid.pipelineLayout, VK_SHADER_STAGE_COMPUTE_BIT, 0, sizeof(gpuGrid.pushConstants), &gpuGrid.pushConstants);
 
-		for (uint32_t i = 0; i < static_cast<uint32_t>(attractors.size()); i++)
-		{
-			for (uint32_t j = 0; j < PARTICLES_PER_ATTRACTOR; j++)
-			{
-				Particle &particle = particleBuffer[i * PARTICLES_PER_ATTRACTOR + j];
+		// Grid build: bounds, particles per cell, first particle per cell and particles sorted by cell
+		// -------------------------------------------------------------------------------------------------------
+		vkCmdBindPipeline(compute.commandBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, gpuGrid.pipelineBounds);
+		vkCmdDispatch(compute.commandBuffer, particleGroupCount, 1, 1);
+		addGridPassBarrier();
 
-				// First particle in group as heavy center of gravity
-				if (j == 0)
-				{
-					particle.pos = glm::vec4(attractors[i] * 1.5f, 90000.0f);
-					particle.vel = glm::vec4(glm::vec4(0.0f));
-				}
-				else
-				{
-					// Position
-					glm::vec3 position(attractors[i] + glm::vec3(rndDist(rndEngine), rndDist(rndEngine), rndDist(rndEngine)) * 0.75f);
-					float len = glm::length(glm::normalize(position - attractors[i]));
-					position.y *= 2.0f - (len * len);
-
-					// Velocity
-					glm::vec3 angular = glm::vec3(0.5f, 1.5f, 0.5f) * (((i % 2) == 0) ? 1.0f : -1.0f);
-					glm::vec3 velocity = glm::cross((position - attractors[i]), angular) + glm::vec3(rndDist(rndEngine), rndDist(rndEngine), rndDist(rndEngine) * 0.025f);
-
-					float mass = (rndDist(rndEngine) * 0.5f + 0.5f) * 75.0f;
-					particle.pos = glm::vec4(position, mass);
-					particle.vel = glm::vec4(velocity, 0.0f);
-				}
+		vkCmdBindPipeline(compute.commandBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, gpuGrid.pipelineCount);
+		vkCmdDispatch(compute.commandBuffer, particleGroupCount, 1, 1);
+		addGridPassBarrier();
 
-				// Color gradient offset
-				particle.vel.w = (float)i * 1.0f / static_cast<uint32_t>(attractors.size());
-			}
+		// The prefix sum over the cells of the finest level runs in a single work group
+		vkCmdBindPipeline(compute.commandBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, gpuGrid.pipelineScan);
+		vkCmdDispatch(compute.commandBuffer, 1, 1, 1);
+		addGridPassBarrier();
+
+		vkCmdBindPipeline(compute.commandBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, gpuGrid.pipelineScatter);
+		vkCmdDispatch(compute.commandBuffer, particleGroupCount, 1, 1);
+		addGridPassBarrier();
+
+		// Centers of mass, from the finest to the coarsest level
+		// -------------------------------------------------------------------------------------------------------
+		vkCmdBindPipeline(compute.commandBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, gpuGrid.pipelineReduce);
+		for (uint32_t level = 0; level < gpuGrid.levelCount; level++) {
+			const uint32_t levelResolution = gpuGrid.resolution >> level;
+			gpuGrid.pushConstants.level = level;
+			vkCmdPushConstants(compute.commandBuffer, gpuGrid.pipelineLayout, VK_SHADER_STAGE_COMPUTE_BIT, 0, sizeof(gpuGrid.pushConstants), &gpuGrid.pushConstants);
+			vkCmdDispatch(compute.commandBuffer, (levelResolution * levelResolution * levelResolution + WORK_GROUP_SIZE - 1) / WORK_GROUP_SIZE, 1, 1);
+			addGridPassBarrier();
 		}
 
+		// First pass: Calculate particle movement from the grid
+		// -------------------------------------------------------------------------------------------------------
+		vkCmdBindPipeline(compute.commandBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, gpuGrid.pipelineForce);
+		vkCmdDispatch(compute.commandBuffer, particleGroupCount, 1, 1);
+		addGridPassBarrier();
+
+		// Second pass: Integrate particles
+		// -------------------------------------------------------------------------------------------------------
+		vkCmdBindPipeline(compute.commandBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, compute.pipelineIntegrate);
+		vkCmdBindDescriptorSets(compute.commandBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, compute.pipelineLayout, 0, 1, &compute.descriptorSet, 0, 0);
+		vkCmdDispatch(compute.commandBuffer, numParticles / WORK_GROUP_SIZE, 1, 1);
+	}
+
+	// Setup and fill the compute shader storage buffers containing the particles
+	void prepareStorageBuffers()
+	{
+		numParticles = static_cast<uint32_t>(attractors.size()) * particlesPerAttractor;
+
+		// Initial particle positions
+		std::vector<Particle> particleBuffer = vks::nbody::createAttractorSystem(attractors, particlesPerAttractor, benchmark.active ? 0 : (unsigned)time(nullptr));
+
 		compute.ubo.particleCount = numParticles;
 
 		VkDeviceSize storageBufferSize = particleBuffer.size() * sizeof(Particle);
@@ -427,6 +575,79 @@ public:
 
 		stagingBuffer.destroy();
 
+		if (simulationMode == SimulationModeBarnesHut)
+		{
+			// The CPU simulation works on its own copy of the particles, which is written to a persistently mapped buffer after each step
+			VK_CHECK_RESULT(vulkanDevice->createBuffer(
+				VK_BUFFER_USAGE_TRANSFER_SRC_BIT,
+				VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
+				&cpuSimulation.uploadBuffer,
+				storageBufferSize,
+				particleBuffer.data()));
+			VK_CHECK_RESULT(cpuSimulation.uploadBuffer.map());
+			cpuSimulation.particles.swap(particleBuffer);
+		}
+
+		if (simulationMode == SimulationModeGPUGrid)
+		{
+			prepareGridBuffers();
+		}
+	}
+
+	// Creates the buffers of the GPU grid, which only live on the device, the finest level gets about one cell per particle
+	void prepareGridBuffers()
+	{
+		gpuGrid.resolution = GRID_MIN_RESOLUTION;
+		while ((gpuGrid.resolution < GRID_MAX_RESOLUTION) && (gpuGrid.resolution * gpuGrid.resolution * gpuGrid.resolution < numParticles)) {
+			gpuGrid.resolution *= 2;
+		}
+		gpuGrid.levelCount = 0;
+		gpuGrid.cellCount = 0;
+		for (uint32_t levelResolution = gpuGrid.resolution; levelResolution >= 4; levelResolution /= 2) {
+			gpuGrid.levelCount++;
+			gpuGrid.cellCount += levelResolution * levelResolution * levelResolution;
+		}
+		const VkDeviceSize finestCellCount = gpuGrid.resolution * gpuGrid.resolution * gpuGrid.resolution;
+
+		const VkBufferUsageFlags usage = VK_BUFFER_USAGE_STORAGE_BUFFER_BIT;
+		const VkMemoryPropertyFlags memoryProperties = VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT;
+		// The bounds and the cell counts are reset with vkCmdFillBuffer at the start of each step
+		VK_CHECK_RESULT(vulkanDevice->createBuffer(usage | VK_BUFFER_USAGE_TRANSFER_DST_BIT, memoryProperties, &gpuGrid.bounds, 6 * sizeof(uint32_t)));
+		VK_CHECK_RESULT(vulkanDevice->createBuffer(usage | VK_BUFFER_USAGE_TRANSFER_DST_BIT, memoryProperties, &gpuGrid.cellCounts, finestCellCount * sizeof(uint32_t)));
+		VK_CHECK_RESULT(vulkanDevice->createBuffer(usage, memoryProperties, &gpuGrid.cellStarts, finestCellCount * sizeof(uint32_t)));
+		VK_CHECK_RESULT(vulkanDevice->createBuffer(usage, memoryProperties, &gpuGrid.particleCells, numParticles * 2 * sizeof(uint32_t)));
+		VK_CHECK_RESULT(vulkanDevice->createBuffer(usage, memoryProperties, &gpuGrid.sortedIndices, numParticles * sizeof(uint32_t)));
+		VK_CHECK_RESULT(vulkanDevice->createBuffer(usage, memoryProperties, &gpuGrid.sortedParticles, numParticles * sizeof(glm::vec4)));
+		VK_CHECK_RESULT(vulkanDevice->createBuffer(usage, memoryProperties, &gpuGrid.cellMasses, gpuGrid.cellCount * sizeof(glm::vec4)));
+	}
+
+	void destroyGridBuffers()
+	{
+		for (vks::Buffer *buffer : { &gpuGrid.bounds, &gpuGrid.cellCounts, &gpuGrid.cellStarts, &gpuGrid.particleCells, &gpuGrid.sortedIndices, &gpuGrid.sortedParticles, &gpuGrid.cellMasses }) {
+			buffer->destroy();
+			*buffer = vks::Buffer();
+		}
+	}
+
+	// Points the grid descriptor set to the current particle and grid buffers
+	void updateGridDescriptorSet()
+	{
+		std::vector<VkWriteDescriptorSet> writeDescriptorSets = {
+			vks::initializers::writeDescriptorSet(gpuGrid.descriptorSet, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, 0, &compute.storageBuffer.descriptor),
+			vks::initializers::writeDescriptorSet(gpuGrid.descriptorSet, VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER, 1, &compute.uniformBuffer.descriptor),
+			vks::initializers::writeDescriptorSet(gpuGrid.descriptorSet, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, 2, &gpuGrid.bounds.descriptor),
+			vks::initializers::writeDescriptorSet(gpuGrid.descriptorSet, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, 3, &gpuGrid.cellCounts.descriptor),
+			vks::initializers::writeDescriptorSet(gpuGrid.descriptorSet, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, 4, &gpuGrid.cellStarts.descriptor),
+			vks::initializers::writeDescriptorSet(gpuGrid.descriptorSet, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, 5, &gpuGrid.particleCells.descriptor),
+			vks::initializers::writeDescriptorSet(gpuGrid.descriptorSet, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, 6, &gpuGrid.sortedIndices.descriptor),
+			vks::initializers::writeDescriptorSet(gpuGrid.descriptorSet, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, 7, &gpuGrid.sortedParticles.descriptor),
+			vks::initializers::writeDescriptorSet(gpuGrid.descriptorSet, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, 8, &gpuGrid.cellMasses.descriptor),
+		};
+		vkUpdateDescriptorSets(device, static_cast<uint32_t>(writeDescriptorSets.size()), writeDescriptorSets.data(), 0, nullptr);
+	}
+
+	void setupVertexDescriptions()
+	{
 		// Binding description
 		vertices.bindingDescriptions.resize(1);
 		vertices.bindingDescriptions[0] =
@@ -465,8 +686,8 @@ public:
 	{
 		std::vector<VkDescriptorPoolSize> poolSizes =
 		{
-			vks::initializers::descriptorPoolSize(VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER, 2),
-			vks::initializers::descriptorPoolSize(VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, 1),
+			vks::initializers::descriptorPoolSize(VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER, 3),
+			vks::initializers::descriptorPoolSize(VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, 9),
 			vks::initializers::descriptorPoolSize(VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, 2)
 		};
 
@@ -474,7 +695,7 @@ public:
 			vks::initializers::descriptorPoolCreateInfo(
 				static_cast<uint32_t>(poolSizes.size()),
 				poolSizes.data(),
-				2);
+				3);
 
 		VK_CHECK_RESULT(vkCreateDescriptorPool(device, &descriptorPoolInfo, nullptr, &descriptorPool));
 	}
@@ -612,6 +833,7 @@ public:
 	void prepareGraphics()
 	{
 		prepareStorageBuffers();
+		setupVertexDescriptions();
 		prepareUniformBuffers();
 		setupDescriptorSetLayout();
 		preparePipelines();
@@ -713,11 +935,13 @@ public:
 		specializationMapEntries.push_back(vks::initializers::specializationMapEntry(2, offsetof(SpecializationData, power), sizeof(float)));
 		specializationMapEntries.push_back(vks::initializers::specializationMapEntry(3, offsetof(SpecializationData, soften), sizeof(float)));
 
-		specializationData.sharedDataSize = std::min((uint32_t)1024, (uint32_t)(vulkanDevice->properties.limits.maxComputeSharedMemorySize / sizeof(glm::vec4)));
+		// The shader advances through the particles by the shared data size, but each invocation only loads one particle into shared memory,
+		// so this has to match the work group size for all particles to be taken into account
+		specializationData.sharedDataSize = WORK_GROUP_SIZE;
 
-		specializationData.gravity = 0.002f;
-		specializationData.power = 0.75f;
-		specializationData.soften = 0.05f;
+		specializationData.gravity = simulationSettings.gravity;
+		specializationData.power = simulationSettings.power;
+		specializationData.soften = simulationSettings.soften;
 
 		VkSpecializationInfo specializationInfo =
 			vks::initializers::specializationInfo(static_cast<uint32_t>(specializationMapEntries.size()), specializationMapEntries.data(), sizeof(specializationData), &specializationData);
@@ -729,6 +953,48 @@ public:
 		computePipelineCreateInfo.stage = loadShader(getShadersPath() + "computenbody/particle_integrate.comp.spv", VK_SHADER_STAGE_COMPUTE_BIT);
 		VK_CHECK_RESULT(vkCreateComputePipelines(device, pipelineCache, 1, &computePipelineCreateInfo, nullptr, &compute.pipelineIntegrate));
 
+		// Uniform grid passes, these share a layout with the particles and the uniform buffer at the same bindings as above
+		setLayoutBindings = {
+			vks::initializers::descriptorSetLayoutBinding(VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, VK_SHADER_STAGE_COMPUTE_BIT, 0),
+			vks::initializers::descriptorSetLayoutBinding(VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER, VK_SHADER_STAGE_COMPUTE_BIT, 1),
+		};
+		for (uint32_t binding = 2; binding <= 8; binding++) {
+			setLayoutBindings.push_back(vks::initializers::descriptorSetLayoutBinding(VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, VK_SHADER_STAGE_COMPUTE_BIT, binding));
+		}
+		descriptorLayout = vks::initializers::descriptorSetLayoutCreateInfo(setLayoutBindings.data(), static_cast<uint32_t>(setLayoutBindings.size()));
+		VK_CHECK_RESULT(vkCreateDescriptorSetLayout(device, &descriptorLayout, nullptr, &gpuGrid.descriptorSetLayout));
+
+		// The grid resolution, the number of levels and the level reduced by the current dispatch are passed as push constants
+		VkPushConstantRange pushConstantRange = vks::initializers::pushConstantRange(VK_SHADER_STAGE_COMPUTE_BIT, sizeof(gpuGrid.pushConstants), 0);
+		pPipelineLayoutCreateInfo = vks::initializers::pipelineLayoutCreateInfo(&gpuGrid.descriptorSetLayout, 1);
+		pPipelineLayoutCreateInfo.pushConstantRangeCount = 1;
+		pPipelineLayoutCreateInfo.pPushConstantRanges = &pushConstantRange;
+		VK_CHECK_RESULT(vkCreatePipelineLayout(device, &pPipelineLayoutCreateInfo, nullptr, &gpuGrid.pipelineLayout));
+
+		allocInfo = vks::initializers::descriptorSetAllocateInfo(descriptorPool, &gpuGrid.descriptorSetLayout, 1);
+		VK_CHECK_RESULT(vkAllocateDescriptorSets(device, &allocInfo, &gpuGrid.descriptorSet));
+		if (simulationMode == SimulationModeGPUGrid) {
+			updateGridDescriptorSet();
+		}
+
+		computePipelineCreateInfo = vks::initializers::computePipelineCreateInfo(gpuGrid.pipelineLayout, 0);
+		const std::vector<std::pair<std::string, VkPipeline*>> gridPipelines = {
+			{ "particle_grid_bounds", &gpuGrid.pipelineBounds },
+			{ "particle_grid_count", &gpuGrid.pipelineCount },
+			{ "particle_grid_scan", &gpuGrid.pipelineScan },
+			{ "particle_grid_scatter", &gpuGrid.pipelineScatter },
+			{ "particle_grid_reduce", &gpuGrid.pipelineReduce },
+			{ "particle_grid_force", &gpuGrid.pipelineForce },
+		};
+		for (auto& gridPipeline : gridPipelines) {
+			if (gpuGrid.available) {
+				computePipelineCreateInfo.stage = loadShader(getShadersPath() + "computenbody/" + gridPipeline.first + ".comp.spv", VK_SHADER_STAGE_COMPUTE_BIT);
+				// Only the force pass uses the force law constants
+				computePipelineCreateInfo.stage.pSpecializationInfo = (gridPipeline.second == &gpuGrid.pipelineForce) ? &specializationInfo : nullptr;
+				VK_CHECK_RESULT(vkCreateComputePipelines(device, pipelineCache, 1, &computePipelineCreateInfo, nullptr, gridPipeline.second));
+			}
+		}
+
 		// Separate command pool as queue family for compute may be different than graphics
 		VkCommandPoolCreateInfo cmdPoolInfo = {};
 		cmdPoolInfo.sType = VK_STRUCTURE_TYPE_COMMAND_POOL_CREATE_INFO;
@@ -842,6 +1108,38 @@ public:
 		memcpy(graphics.uniformBuffer.mapped, &graphics.ubo, sizeof(graphics.ubo));
 	}
 
+	// Recreates the particle buffers for the current particle count and simulation mode, which restarts the simulation
+	void resetSimulation()
+	{
+		vkDeviceWaitIdle(device);
+		compute.storageBuffer.destroy();
+		cpuSimulation.uploadBuffer.destroy();
+		cpuSimulation.uploadBuffer = vks::Buffer();
+		cpuSimulation.particles.clear();
+		destroyGridBuffers();
+		prepareStorageBuffers();
+		VkWriteDescriptorSet writeDescriptorSet = vks::initializers::writeDescriptorSet(compute.descriptorSet, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, 0, &compute.storageBuffer.descriptor);
+		vkUpdateDescriptorSets(device, 1, &writeDescriptorSet, 0, nullptr);
+		if (simulationMode == SimulationModeGPUGrid) {
+			updateGridDescriptorSet();
+		}
+		buildComputeCommandBuffer();
+		buildCommandBuffers();
+	}
+
+	// Advances the CPU simulation and writes the particles to the upload buffer the compute command buffer copies from
+	// The copy of the previous frame has finished at this point, as the base class waits for the graphics queue (which waits for the compute queue) after each frame
+	void updateCpuSimulation()
+	{
+		if (paused) {
+			return;
+		}
+		auto tStart = std::chrono::high_resolution_clock::now();
+		cpuSimulation.barnesHut.step(cpuSimulation.particles, frameTimer * 0.05f, &jobSystem);
+		cpuSimulation.stepTime = std::chrono::duration<float, std::milli>(std::chrono::high_resolution_clock::now() - tStart).count();
+		memcpy(cpuSimulation.uploadBuffer.mapped, cpuSimulation.particles.data(), cpuSimulation.particles.size() * sizeof(Particle));
+	}
+
 	void draw()
 	{
 		// Wait for rendering finished
@@ -877,6 +1175,39 @@ public:
 		VulkanExampleBase::submitFrame();
 	}
 
+	// The uniform grid mode is only offered if all of its compute shaders have been compiled
+	bool gridShadersAvailable()
+	{
+		for (const char* name : { "bounds", "count", "scan", "scatter", "reduce", "force" }) {
+			const std::string fileName = getShadersPath() + "computenbody/particle_grid_" + name + ".comp.spv";
+#if defined(VK_USE_PLATFORM_ANDROID_KHR)
+			AAsset* asset = AAssetManager_open(androidApp->activity->assetManager, fileName.c_str(), AASSET_MODE_UNKNOWN);
+			const bool exists = (asset != nullptr);
+			if (asset) {
+				AAsset_close(asset);
+			}
+#else
+			const bool exists = vks::tools::fileExists(fileName);
+#endif
+			if (!exists) {
+				std::cerr << "Uniform grid simulation disabled, shader \"" << fileName << "\" is missing\n";
+				return false;
+			}
+		}
+		return true;
+	}
+
+	// Clamps the particle count to the limit of the current simulation mode and selects it in the UI
+	void clampParticleCount()
+	{
+		particlesPerAttractor = std::min(particlesPerAttractor, maxParticlesPerAttractor());
+		if (std::find(particleCountOptions.begin(), particleCountOptions.end(), particlesPerAttractor) == particleCountOptions.end()) {
+			particleCountOptions.push_back(particlesPerAttractor);
+			std::sort(particleCountOptions.begin(), particleCountOptions.end());
+		}
+		particleCountIndex = static_cast<int32_t>(std::find(particleCountOptions.begin(), particleCountOptions.end(), particlesPerAttractor) - particleCountOptions.begin());
+	}
+
 	void prepare()
 	{
 		VulkanExampleBase::prepare();
@@ -884,6 +1215,12 @@ public:
 		// If that's the case, we need additional barriers for acquiring and releasing resources
 		graphics.queueFamilyIndex = vulkanDevice->queueFamilyIndices.graphics;
 		compute.queueFamilyIndex = vulkanDevice->queueFamilyIndices.compute;
+		// Checked here as the Android asset manager isn't available in the constructor
+		gpuGrid.available = gridShadersAvailable();
+		if (!gpuGrid.available && (simulationMode == SimulationModeGPUGrid)) {
+			simulationMode = SimulationModeGPU;
+			clampParticleCount();
+		}
 		loadAssets();
 		setupDescriptorPool();
 		prepareGraphics();
@@ -896,6 +1233,9 @@ public:
 	{
 		if (!prepared)
 			return;
+		if (simulationMode == SimulationModeBarnesHut) {
+			updateCpuSimulation();
+		}
 		draw();
 		updateComputeUniformBuffers();
 		if (camera.updated) {
@@ -907,6 +1247,57 @@ public:
 	{
 		updateGraphicsUniformBuffers();
 	}
+
+	uint32_t maxParticlesPerAttractor() const
+	{
+		return (simulationMode == SimulationModeGPU) ? MAX_GPU_PARTICLES_PER_ATTRACTOR : MAX_PARTICLES_PER_ATTRACTOR;
+	}
+
+	virtual void OnUpdateUIOverlay(vks::UIOverlay *overlay)
+	{
+		if (overlay->header("Settings")) {
+			const int32_t previousMode = simulationMode;
+			if (overlay->comboBox("Simulation", &simulationMode, { "GPU all pairs", "GPU uniform grid", "CPU Barnes-Hut" })) {
+				if ((simulationMode == SimulationModeGPUGrid) && !gpuGrid.available) {
+					simulationMode = previousMode;
+				}
+				if (particlesPerAttractor > maxParticlesPerAttractor()) {
+					particlesPerAttractor = maxParticlesPerAttractor();
+					particleCountIndex = static_cast<int32_t>(std::find(particleCountOptions.begin(), particleCountOptions.end(), particlesPerAttractor) - particleCountOptions.begin());
+				}
+				resetSimulation();
+			}
+			if (!gpuGrid.available) {
+				overlay->text("Uniform grid unavailable, shaders not compiled");
+			}
+			// Only offer the counts the current simulation mode can handle (the options are sorted)
+			std::vector<std::string> particleCountNames;
+			for (auto count : particleCountOptions) {
+				if (count > maxParticlesPerAttractor()) {
+					break;
+				}
+				particleCountNames.push_back(std::to_string(count * static_cast<uint32_t>(attractors.size())) + " particles");
+			}
+			if (overlay->comboBox("Particle count", &particleCountIndex, particleCountNames)) {
+				particlesPerAttractor = particleCountOptions[particleCountIndex];
+				resetSimulation();
+			}
+			if (simulationMode == SimulationModeBarnesHut) {
+				if (overlay->sliderFloat("Opening angle", &simulationSettings.theta, 0.0f, 1.5f)) {
+					cpuSimulation.barnesHut.setSettings(simulationSettings);
+				}
+			}
+		}
+		if ((simulationMode == SimulationModeGPUGrid) && overlay->header("Uniform grid")) {
+			overlay->text("Finest level: %u^3 cells", gpuGrid.resolution);
+			overlay->text("Grid: %u cells, %u levels", gpuGrid.cellCount, gpuGrid.levelCount);
+		}
+		if ((simulationMode == SimulationModeBarnesHut) && overlay->header("Barnes-Hut")) {
+			overlay->text("Step: %.2f ms (%u threads)", cpuSimulation.stepTime, jobSystem.threadCount());
+			overlay->text("Octree nodes: %u", static_cast<uint32_t>(cpuSimulation.barnesHut.getNodes().size()));
+			overlay->text("Interactions per particle: %.0f", (double)cpuSimulation.barnesHut.getInteractionCount() / (double)std::max(numParticles, 1u));
+		}
+	}
 };
 
 VULKAN_EXAMPLE_MAIN()
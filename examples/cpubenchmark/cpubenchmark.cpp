@@ -0,0 +1,1011 @@
+/*
+* Vulkan Example - CPU side micro benchmarks for the framework's helper classes
+*
+* Runs without a window or Vulkan device and measures the CPU cost of framework code paths (e.g. job scheduling, animation)
+*
+* This code is licensed under the MIT license (MIT) (http://opensource.org/licenses/MIT)
+*/
+
+#if defined(_WIN32)
+#pragma comment(linker, "/subsystem:console")
+#endif
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <assert.h>
+#include <math.h>
+#include <vector>
+#include <string>
+#include <iostream>
+#include <algorithm>
+#include <chrono>
+#include <functional>
+#include <atomic>
+#include <random>
+
+#include "CommandLineParser.hpp"
+#include "VulkanTools.h"
+#include "threadpool.hpp"
+#include "jobsystem.hpp"
+#include "animationclip.hpp"
+#include "bvh.hpp"
+#include "meshoptimizer.hpp"
+#include "particlesystem.hpp"
+#include "noise.hpp"
+#include "nbody.hpp"
+#include "VulkanglTFModel.h"
+
+#include <glm/gtc/type_ptr.hpp>
+#include <glm/gtc/matrix_transform.hpp>
+
+#define LOG(...) printf(__VA_ARGS__)
+
+CommandLineParser commandLineParser;
+
+struct BenchmarkSettings {
+	uint32_t iterations = 20;
+	uint32_t threadCount = 0;
+	// Shared by all benchmarks, started with threadCount threads
+	vks::JobSystem* jobSystem = nullptr;
+};
+
+struct BenchmarkCase {
+	std::string name;
+	std::string description;
+	std::function<void(const BenchmarkSettings&)> run;
+};
+
+// Runs the function for the requested number of iterations (after one warm up run), prints timing statistics and returns the average time in ms
+double measure(const std::string& name, uint32_t iterations, const std::function<void()>& function)
+{
+	function();
+	std::vector<double> times(iterations);
+	for (uint32_t i = 0; i < iterations; i++) {
+		auto tStart = std::chrono::high_resolution_clock::now();
+		function();
+		auto tEnd = std::chrono::high_resolution_clock::now();
+		times[i] = std::chrono::duration<double, std::milli>(tEnd - tStart).count();
+	}
+	std::sort(times.begin(), times.end());
+	double avg = 0.0;
+	for (auto time : times) {
+		avg += time;
+	}
+	avg /= (double)iterations;
+	LOG("  %-40s avg %9.3f ms  min %9.3f ms  median %9.3f ms  max %9.3f ms\n", name.c_str(), avg, times.front(), times[times.size() / 2], times.back());
+	return avg;
+}
+
+// One of the implementations compared by a benchmark
+struct Variant {
+	std::string name;
+	std::function<void()> run;
+	// Number of timed iterations, zero uses the iteration count of the settings
+	uint32_t iterations;
+	// Called after the timed runs, e.g. to validate the results
+	std::function<void()> check;
+	Variant(const std::string& name, std::function<void()> run, uint32_t iterations = 0, std::function<void()> check = nullptr) : name(name), run(run), iterations(iterations), check(check) {}
+};
+
+// Number of items a benchmark processes per run, printed as items per second below each variant's timings
+struct Throughput {
+	double items;
+	// Items per second are divided by this, e.g. 1000000 for M items/s
+	double divisor;
+	const char* unit;
+	Throughput(double items = 0.0, double divisor = 1.0, const char* unit = "") : items(items), divisor(divisor), unit(unit) {}
+};
+
+// Measures all variants in turn
+void measureVariants(const BenchmarkSettings& settings, const std::vector<Variant>& variants, const Throughput& throughput = Throughput())
+{
+	for (const Variant& variant : variants) {
+		const double time = measure(variant.name, (variant.iterations > 0) ? variant.iterations : settings.iterations, variant.run);
+		if (throughput.items > 0.0) {
+			LOG("  %-40s %9.1f %s\n", "", throughput.items * 1000.0 / (time * throughput.divisor), throughput.unit);
+		}
+		if (variant.check) {
+			variant.check();
+		}
+	}
+}
+
+// Simulated per element work with a controllable cost
+inline float busyWork(uint32_t index, uint32_t amount)
+{
+	float value = (float)index;
+	for (uint32_t i = 0; i < amount; i++) {
+		value = sqrtf(value * 1.0001f + 1.0f);
+	}
+	return value;
+}
+
+/*
+	Job system
+	Compares the work stealing job system against the per-thread queues of the thread pool previously used by the samples
+*/
+
+void benchmarkJobScheduling(const BenchmarkSettings& settings)
+{
+	const uint32_t jobCount = 100000;
+	const uint32_t threadCount = settings.threadCount;
+	// Every job increments its own element, so jobs that got lost or ran more than once show up when validating
+	std::vector<uint32_t> runCounts(jobCount);
+
+	LOG("Scheduling %d empty jobs\n", jobCount);
+
+	// measure runs the function once more for warming up
+	auto validate = [&runCounts, &settings](const char* name) {
+		uint32_t wrongCount = 0;
+		for (auto& runCount : runCounts) {
+			if (runCount != settings.iterations + 1) {
+				wrongCount++;
+			}
+			runCount = 0;
+		}
+		if (wrongCount > 0) {
+			LOG("  %s: %d jobs did not run exactly once per iteration\n", name, wrongCount);
+		}
+	};
+
+	vks::ThreadPool threadPool;
+	threadPool.setThreadCount(threadCount);
+	vks::JobSystem& jobSystem = *settings.jobSystem;
+	measureVariants(settings, {
+		Variant("ThreadPool (round robin)", [&] {
+			for (uint32_t i = 0; i < jobCount; i++) {
+				uint32_t* runCount = &runCounts[i];
+				threadPool.threads[i % threadCount]->addJob([runCount] { (*runCount)++; });
+			}
+			threadPool.wait();
+		}, 0, [&] { validate("ThreadPool"); }),
+		Variant("JobSystem", [&] {
+			vks::JobCounter jobCounter;
+			for (uint32_t i = 0; i < jobCount; i++) {
+				uint32_t* runCount = &runCounts[i];
+				jobSystem.run([runCount] { (*runCount)++; }, &jobCounter);
+			}
+			jobSystem.wait(jobCounter);
+		}, 0, [&] { validate("JobSystem"); }),
+		// Far more ranges than fit into a worker's job pool at once
+		Variant("JobSystem parallelFor (grain size 1)", [&] {
+			jobSystem.parallelFor(jobCount, 1, [&runCounts](uint32_t begin, uint32_t end) {
+				for (uint32_t i = begin; i < end; i++) {
+					runCounts[i]++;
+				}
+			});
+		}, 0, [&] { validate("JobSystem parallelFor"); }),
+		// A single job that schedules and waits for far more jobs than a worker's job pool holds, the pool slot of the outer job
+		// stays busy for the whole time, so allocation must not wait for it to become free
+		Variant("JobSystem nested run + wait", [&] {
+			vks::JobCounter outerCounter;
+			jobSystem.run([&jobSystem, &runCounts, jobCount] {
+				for (uint32_t i = 0; i < jobCount; i++) {
+					vks::JobCounter jobCounter;
+					uint32_t* runCount = &runCounts[i];
+					jobSystem.run([runCount] { (*runCount)++; }, &jobCounter);
+					jobSystem.wait(jobCounter);
+				}
+			}, &outerCounter);
+			jobSystem.wait(outerCounter);
+		}, 0, [&] { validate("JobSystem nested run + wait"); }),
+	});
+}
+
+void benchmarkParallelFor(const BenchmarkSettings& settings, const char* title, bool unbalanced)
+{
+	const uint32_t elementCount = 1 << 20;
+	const uint32_t grainSize = 1024;
+	const uint32_t threadCount = settings.threadCount;
+	std::vector<float> output(elementCount);
+
+	// In the unbalanced case the cost per element grows along the range, so a static split leaves most threads idle
+	auto processRange = [&output, unbalanced, elementCount](uint32_t begin, uint32_t end) {
+		for (uint32_t i = begin; i < end; i++) {
+			output[i] = busyWork(i, unbalanced ? (i * 32 / elementCount) : 8);
+		}
+	};
+
+	LOG("%s (%d elements, grain size %d)\n", title, elementCount, grainSize);
+
+	vks::ThreadPool threadPool;
+	threadPool.setThreadCount(threadCount);
+	measureVariants(settings, {
+		Variant("Single thread", [&] {
+			processRange(0, elementCount);
+		}),
+		// The thread pool has no range splitting, so split the range into one equally sized block per thread like the samples did
+		Variant("ThreadPool (static split)", [&] {
+			const uint32_t blockSize = (elementCount + threadCount - 1) / threadCount;
+			for (uint32_t t = 0; t < threadCount; t++) {
+				const uint32_t begin = t * blockSize;
+				const uint32_t end = std::min(begin + blockSize, elementCount);
+				threadPool.threads[t]->addJob([&processRange, begin, end] { processRange(begin, end); });
+			}
+			threadPool.wait();
+		}),
+		Variant("JobSystem parallelFor", [&] {
+			settings.jobSystem->parallelFor(elementCount, grainSize, processRange);
+		}),
+	});
+}
+
+/*
+	Animation
+	Evaluates the poses of many instances of the same animation, once with one scalar update pass per instance (like
+	using one model copy per instance) and once with the shared clip and the batched instance poses
+*/
+
+// Reads the first animation of a glTF file into a clip, without loading any geometry or images
+bool loadAnimationClip(const std::string& filename, vks::animation::Clip& clip)
+{
+	tinygltf::TinyGLTF gltfContext;
+	gltfContext.SetImageLoader([](tinygltf::Image*, const int, std::string*, std::string*, int, int, const unsigned char*, int, void*) { return true; }, nullptr);
+	tinygltf::Model gltfModel;
+	std::string error, warning;
+	if (!gltfContext.LoadASCIIFromFile(&gltfModel, &error, &warning, filename) || gltfModel.animations.empty()) {
+		return false;
+	}
+	// Flatten the node hierarchy so that parents are stored before their children
+	std::vector<int32_t> hierarchyIndices(gltfModel.nodes.size(), -1);
+	const tinygltf::Scene& scene = gltfModel.scenes[gltfModel.defaultScene > -1 ? gltfModel.defaultScene : 0];
+	std::vector<std::pair<int, int32_t>> stack;
+	for (auto it = scene.nodes.rbegin(); it != scene.nodes.rend(); ++it) {
+		stack.push_back({ *it, -1 });
+	}
+	while (!stack.empty()) {
+		const int nodeIndex = stack.back().first;
+		const int32_t parent = stack.back().second;
+		stack.pop_back();
+		const tinygltf::Node& node = gltfModel.nodes[nodeIndex];
+		hierarchyIndices[nodeIndex] = static_cast<int32_t>(clip.nodeCount());
+		clip.parents.push_back(parent);
+		clip.translations.push_back((node.translation.size() == 3) ? glm::vec3(glm::make_vec3(node.translation.data())) : glm::vec3(0.0f));
+		clip.rotations.push_back((node.rotation.size() == 4) ? glm::quat(glm::make_quat(node.rotation.data())) : glm::quat());
+		clip.scales.push_back((node.scale.size() == 3) ? glm::vec3(glm::make_vec3(node.scale.data())) : glm::vec3(1.0f));
+		clip.matrices.push_back((node.matrix.size() == 16) ? glm::mat4(glm::make_mat4x4(node.matrix.data())) : glm::mat4(1.0f));
+		for (auto it = node.children.rbegin(); it != node.children.rend(); ++it) {
+			stack.push_back({ *it, hierarchyIndices[nodeIndex] });
+		}
+	}
+
+	const tinygltf::Animation& animation = gltfModel.animations[0];
+	clip.start = std::numeric_limits<float>::max();
+	clip.end = std::numeric_limits<float>::lowest();
+	for (const tinygltf::AnimationSampler& source : animation.samplers) {
+		vks::animation::Clip::Sampler sampler;
+		if (source.interpolation == "STEP") {
+			sampler.interpolation = vks::animation::Interpolation::Step;
+		} else if (source.interpolation == "CUBICSPLINE") {
+			sampler.interpolation = vks::animation::Interpolation::CubicSpline;
+		}
+		vkglTF::readAccessor(gltfModel, gltfModel.accessors[source.input], sampler.inputs);
+		clip.start = std::min(clip.start, sampler.inputs.front());
+		clip.end = std::max(clip.end, sampler.inputs.back());
+		const tinygltf::Accessor& output = gltfModel.accessors[source.output];
+		std::vector<float> outputs;
+		vkglTF::readAccessor(gltfModel, output, outputs);
+		const uint32_t components = (output.type == TINYGLTF_TYPE_VEC4) ? 4 : 3;
+		for (size_t i = 0; i < output.count; i++) {
+			const float* value = &outputs[i * components];
+			sampler.outputs.push_back(glm::vec4(value[0], value[1], value[2], (components == 4) ? value[3] : 0.0f));
+		}
+		clip.samplers.push_back(sampler);
+	}
+	for (const tinygltf::AnimationChannel& source : animation.channels) {
+		vks::animation::Clip::Channel channel;
+		if (source.target_path == "translation") {
+			channel.path = vks::animation::Path::Translation;
+		} else if (source.target_path == "rotation") {
+			channel.path = vks::animation::Path::Rotation;
+		} else if (source.target_path == "scale") {
+			channel.path = vks::animation::Path::Scale;
+		} else {
+			continue;
+		}
+		if (hierarchyIndices[source.target_node] < 0) {
+			continue;
+		}
+		channel.node = static_cast<uint32_t>(hierarchyIndices[source.target_node]);
+		channel.sampler = static_cast<uint32_t>(source.sampler);
+		clip.channels.push_back(channel);
+	}
+	return true;
+}
+
+// Pose of a single instance stored in its own arrays and updated with scalar math
+struct ScalarPose {
+	std::vector<glm::vec3> translations;
+	std::vector<glm::quat> rotations;
+	std::vector<glm::vec3> scales;
+	std::vector<glm::mat4> worldMatrices;
+	std::vector<size_t> cursors;
+};
+
+void evaluateScalarPose(const vks::animation::Clip& clip, ScalarPose& pose, float time)
+{
+	for (const vks::animation::Clip::Channel& channel : clip.channels) {
+		const vks::animation::Clip::Sampler& sampler = clip.samplers[channel.sampler];
+		const vks::animation::KeyFrame keyFrame = vks::animation::findKeyFrame(sampler.inputs, time, pose.cursors[channel.sampler]);
+		if (channel.path == vks::animation::Path::Rotation) {
+			pose.rotations[channel.node] = vks::animation::slerp(sampler.outputs, keyFrame);
+		} else if (channel.path == vks::animation::Path::Translation) {
+			pose.translations[channel.node] = glm::vec3(vks::animation::linear(sampler.outputs, keyFrame));
+		} else {
+			pose.scales[channel.node] = glm::vec3(vks::animation::linear(sampler.outputs, keyFrame));
+		}
+	}
+	for (uint32_t node = 0; node < clip.nodeCount(); node++) {
+		const glm::mat4 localMatrix = glm::translate(glm::mat4(1.0f), pose.translations[node]) * glm::mat4(pose.rotations[node]) * glm::scale(glm::mat4(1.0f), pose.scales[node]) * clip.matrices[node];
+		const int32_t parent = clip.parents[node];
+		pose.worldMatrices[node] = (parent > -1) ? pose.worldMatrices[parent] * localMatrix : localMatrix;
+	}
+}
+
+void benchmarkAnimationInstances(const BenchmarkSettings& settings)
+{
+	const uint32_t instanceCount = 10000;
+	const std::string filename = getAssetPath() + "buster_drone/busterDrone.gltf";
+
+	vks::animation::Clip clip;
+	if (!loadAnimationClip(filename, clip)) {
+		LOG("Could not load an animation from \"%s\", skipping\n", filename.c_str());
+		return;
+	}
+
+	// Every instance plays the clip with a different time offset
+	std::vector<float> times(instanceCount);
+	for (uint32_t i = 0; i < instanceCount; i++) {
+		times[i] = clip.start + fmodf(i * 0.0137f, clip.end - clip.start);
+	}
+
+	LOG("Evaluating %d instances of a clip with %d nodes and %d channels\n", instanceCount, clip.nodeCount(), (uint32_t)clip.channels.size());
+
+	std::vector<ScalarPose> scalarPoses(instanceCount);
+	for (auto& pose : scalarPoses) {
+		pose.translations = clip.translations;
+		pose.rotations = clip.rotations;
+		pose.scales = clip.scales;
+		pose.worldMatrices.resize(clip.nodeCount());
+		pose.cursors.resize(clip.samplers.size());
+	}
+	vks::animation::InstancePoses poses;
+	poses.create(clip, instanceCount);
+	measureVariants(settings, {
+		Variant("Scalar (one update pass per instance)", [&] {
+			for (uint32_t i = 0; i < instanceCount; i++) {
+				evaluateScalarPose(clip, scalarPoses[i], times[i]);
+			}
+		}),
+		Variant("InstancePoses", [&] {
+			poses.evaluate(times.data());
+		}),
+		Variant("InstancePoses (JobSystem parallelFor)", [&] {
+			settings.jobSystem->parallelFor(poses.getBlockCount(), 16, [&](uint32_t begin, uint32_t end) {
+				poses.evaluate(times.data(), begin, end);
+			});
+		}),
+	});
+
+	// The batched evaluation uses an approximated slerp, so results differ slightly from the reference
+	float maxError = 0.0f;
+	for (uint32_t i = 0; i < instanceCount; i++) {
+		for (uint32_t node = 0; node < clip.nodeCount(); node++) {
+			const glm::mat4 matrix = poses.getWorldMatrix(i, node);
+			for (uint32_t col = 0; col < 4; col++) {
+				for (uint32_t row = 0; row < 4; row++) {
+					maxError = std::max(maxError, fabsf(matrix[col][row] - scalarPoses[i].worldMatrices[node][col][row]));
+				}
+			}
+		}
+	}
+	LOG("  Max. difference to scalar reference: %f\n", maxError);
+}
+
+/*
+	Frustum culling
+	Culls a large number of boxes one at a time, four at a time with SIMD and with the bounding volume hierarchy
+*/
+
+void benchmarkFrustumCulling(const BenchmarkSettings& settings)
+{
+	const uint32_t boxCount = 1 << 20;
+
+	// Boxes of different sizes scattered through a volume that's larger than the camera's view
+	std::mt19937 generator(42);
+	std::uniform_real_distribution<float> positionDistribution(-512.0f, 512.0f);
+	std::uniform_real_distribution<float> sizeDistribution(0.25f, 4.0f);
+	std::vector<glm::vec3> boxMin(boxCount), boxMax(boxCount);
+	for (uint32_t i = 0; i < boxCount; i++) {
+		const glm::vec3 center(positionDistribution(generator), positionDistribution(generator), positionDistribution(generator));
+		const glm::vec3 extent(sizeDistribution(generator), sizeDistribution(generator), sizeDistribution(generator));
+		boxMin[i] = center - extent;
+		boxMax[i] = center + extent;
+	}
+	// Structure of arrays copy for the four wide tests
+	std::vector<float> minX(boxCount), minY(boxCount), minZ(boxCount), maxX(boxCount), maxY(boxCount), maxZ(boxCount);
+	for (uint32_t i = 0; i < boxCount; i++) {
+		minX[i] = boxMin[i].x; minY[i] = boxMin[i].y; minZ[i] = boxMin[i].z;
+		maxX[i] = boxMax[i].x; maxY[i] = boxMax[i].y; maxZ[i] = boxMax[i].z;
+	}
+
+	vks::Frustum frustum;
+	const glm::mat4 projection = glm::perspective(glm::radians(60.0f), 16.0f / 9.0f, 0.1f, 384.0f);
+	const glm::mat4 view = glm::lookAt(glm::vec3(-256.0f, 32.0f, -256.0f), glm::vec3(0.0f), glm::vec3(0.0f, 1.0f, 0.0f));
+	frustum.update(projection * view);
+
+	LOG("Culling %d boxes\n", boxCount);
+
+	std::vector<uint8_t> visibleScalar(boxCount);
+	uint32_t visibleCount = 0;
+	std::vector<uint8_t> visibleSimd(boxCount);
+	vks::Bvh bvh;
+	std::vector<uint32_t> visibleItems;
+	measureVariants(settings, {
+		Variant("Frustum::checkBox", [&] {
+			visibleCount = 0;
+			for (uint32_t i = 0; i < boxCount; i++) {
+				visibleScalar[i] = frustum.checkBox(boxMin[i], boxMax[i]);
+				visibleCount += visibleScalar[i];
+			}
+		}),
+		Variant("Frustum::checkBoxes4", [&] {
+			for (uint32_t i = 0; i < boxCount; i += 4) {
+				const uint32_t mask = frustum.checkBoxes4(&minX[i], &minY[i], &minZ[i], &maxX[i], &maxY[i], &maxZ[i]);
+				for (uint32_t j = 0; j < 4; j++) {
+					visibleSimd[i + j] = (mask >> j) & 1;
+				}
+			}
+		}),
+		Variant("checkBoxes4 (JobSystem parallelFor)", [&] {
+			settings.jobSystem->parallelFor(boxCount / 4, 1024, [&](uint32_t begin, uint32_t end) {
+				for (uint32_t i = begin * 4; i < end * 4; i += 4) {
+					const uint32_t mask = frustum.checkBoxes4(&minX[i], &minY[i], &minZ[i], &maxX[i], &maxY[i], &maxZ[i]);
+					for (uint32_t j = 0; j < 4; j++) {
+						visibleSimd[i + j] = (mask >> j) & 1;
+					}
+				}
+			});
+		}),
+		// Building sorts a million items, so it's only run a few times
+		Variant("Bvh::build", [&] {
+			bvh.build(boxMin, boxMax);
+		}, std::min(settings.iterations, 3u)),
+		Variant("Bvh::refit", [&] {
+			bvh.refit();
+		}),
+		Variant("Bvh::cull", [&] {
+			bvh.cull(frustum, visibleItems);
+		}),
+	});
+
+	uint32_t simdMismatches = 0;
+	uint32_t bvhMismatches = 0;
+	std::vector<uint8_t> visibleBvh(boxCount);
+	for (uint32_t item : visibleItems) {
+		visibleBvh[item] = 1;
+	}
+	for (uint32_t i = 0; i < boxCount; i++) {
+		simdMismatches += (visibleSimd[i] != visibleScalar[i]) ? 1 : 0;
+		bvhMismatches += (visibleBvh[i] != visibleScalar[i]) ? 1 : 0;
+	}
+	LOG("  %d visible boxes, %d BVH nodes\n", visibleCount, bvh.getNodeCount());
+	LOG("  Differences to scalar reference: checkBoxes4 %d, Bvh::cull %d\n", simdMismatches, bvhMismatches);
+}
+
+/*
+	Mesh optimization
+	Runs the load time mesh optimization stages on all triangle lists of a glTF model and compares the simulated vertex
+	cache efficiency before and after
+*/
+
+struct MeshVertex {
+	glm::vec3 pos;
+	glm::vec3 normal;
+	glm::vec2 uv;
+};
+
+struct TriangleMesh {
+	std::vector<MeshVertex> vertices;
+	std::vector<uint32_t> indices;
+};
+
+// Reads the positions, normals, texture coordinates and indices of all indexed triangle lists of a glTF file
+bool loadTriangleMeshes(const std::string& filename, std::vector<TriangleMesh>& meshes)
+{
+	tinygltf::TinyGLTF gltfContext;
+	gltfContext.SetImageLoader([](tinygltf::Image*, const int, std::string*, std::string*, int, int, const unsigned char*, int, void*) { return true; }, nullptr);
+	tinygltf::Model gltfModel;
+	std::string error, warning;
+	if (!gltfContext.LoadASCIIFromFile(&gltfModel, &error, &warning, filename)) {
+		return false;
+	}
+	auto accessorElement = [&gltfModel](int index, size_t element, size_t elementSize) {
+		const tinygltf::Accessor& accessor = gltfModel.accessors[index];
+		const tinygltf::BufferView& bufferView = gltfModel.bufferViews[accessor.bufferView];
+		const size_t stride = (bufferView.byteStride > 0) ? bufferView.byteStride : elementSize;
+		return &gltfModel.buffers[bufferView.buffer].data[accessor.byteOffset + bufferView.byteOffset + element * stride];
+	};
+	for (const tinygltf::Mesh& gltfMesh : gltfModel.meshes) {
+		for (const tinygltf::Primitive& primitive : gltfMesh.primitives) {
+			auto position = primitive.attributes.find("POSITION");
+			if ((primitive.mode != TINYGLTF_MODE_TRIANGLES) || (primitive.indices < 0) || (position == primitive.attributes.end())) {
+				continue;
+			}
+			auto normal = primitive.attributes.find("NORMAL");
+			auto uv = primitive.attributes.find("TEXCOORD_0");
+			TriangleMesh mesh;
+			mesh.vertices.resize(gltfModel.accessors[position->second].count);
+			for (size_t v = 0; v < mesh.vertices.size(); v++) {
+				MeshVertex& vertex = mesh.vertices[v];
+				memcpy(&vertex.pos, accessorElement(position->second, v, sizeof(glm::vec3)), sizeof(glm::vec3));
+				vertex.normal = glm::vec3(0.0f);
+				vertex.uv = glm::vec2(0.0f);
+				if (normal != primitive.attributes.end()) {
+					memcpy(&vertex.normal, accessorElement(normal->second, v, sizeof(glm::vec3)), sizeof(glm::vec3));
+				}
+				if (uv != primitive.attributes.end()) {
+					memcpy(&vertex.uv, accessorElement(uv->second, v, sizeof(glm::vec2)), sizeof(glm::vec2));
+				}
+			}
+			const tinygltf::Accessor& indexAccessor = gltfModel.accessors[primitive.indices];
+			mesh.indices.resize(indexAccessor.count);
+			for (size_t i = 0; i < mesh.indices.size(); i++) {
+				switch (indexAccessor.componentType) {
+				case TINYGLTF_PARAMETER_TYPE_UNSIGNED_INT:
+					memcpy(&mesh.indices[i], accessorElement(primitive.indices, i, sizeof(uint32_t)), sizeof(uint32_t));
+					break;
+				case TINYGLTF_PARAMETER_TYPE_UNSIGNED_SHORT: {
+					uint16_t index;
+					memcpy(&index, accessorElement(primitive.indices, i, sizeof(uint16_t)), sizeof(uint16_t));
+					mesh.indices[i] = index;
+					break;
+				}
+				default:
+					mesh.indices[i] = *accessorElement(primitive.indices, i, sizeof(uint8_t));
+				}
+			}
+			meshes.push_back(std::move(mesh));
+		}
+	}
+	return !meshes.empty();
+}
+
+void benchmarkMeshOptimization(const BenchmarkSettings& settings)
+{
+	const std::string filename = getAssetPath() + "buster_drone/busterDrone.gltf";
+
+	std::vector<TriangleMesh> sourceMeshes;
+	if (!loadTriangleMeshes(filename, sourceMeshes)) {
+		LOG("Could not load triangle meshes from \"%s\", skipping\n", filename.c_str());
+		return;
+	}
+	vks::meshoptimizer::VertexCacheStatistics before;
+	for (const TriangleMesh& mesh : sourceMeshes) {
+		before.add(vks::meshoptimizer::analyzeVertexCache(mesh.indices.data(), mesh.indices.size(), mesh.vertices.size()));
+	}
+
+	LOG("Optimizing %d meshes with %d triangles\n", (uint32_t)sourceMeshes.size(), before.triangleCount);
+
+	// Every stage starts from the output of the previous one, the copy of its input is part of the measurement
+	std::vector<TriangleMesh> weldedMeshes, cacheMeshes, overdrawMeshes, fetchMeshes;
+	measureVariants(settings, {
+		Variant("Weld (generateVertexRemap)", [&] {
+			weldedMeshes = sourceMeshes;
+			for (size_t m = 0; m < sourceMeshes.size(); m++) {
+				const TriangleMesh& source = sourceMeshes[m];
+				TriangleMesh& mesh = weldedMeshes[m];
+				std::vector<uint32_t> remap(source.vertices.size());
+				const size_t uniqueCount = vks::meshoptimizer::generateVertexRemap(remap.data(), source.indices.data(), source.indices.size(), source.vertices.data(), source.vertices.size());
+				vks::meshoptimizer::remapIndexBuffer(mesh.indices.data(), mesh.indices.size(), remap.data());
+				vks::meshoptimizer::remapVertexBuffer(mesh.vertices.data(), source.vertices.data(), source.vertices.size(), remap.data());
+				mesh.vertices.resize(uniqueCount);
+			}
+		}),
+		Variant("optimizeVertexCache", [&] {
+			cacheMeshes = weldedMeshes;
+			for (TriangleMesh& mesh : cacheMeshes) {
+				vks::meshoptimizer::optimizeVertexCache(mesh.indices.data(), mesh.indices.data(), mesh.indices.size(), mesh.vertices.size());
+			}
+		}),
+		Variant("optimizeOverdraw", [&] {
+			overdrawMeshes = cacheMeshes;
+			for (TriangleMesh& mesh : overdrawMeshes) {
+				vks::meshoptimizer::optimizeOverdraw(mesh.indices.data(), mesh.indices.data(), mesh.indices.size(), &mesh.vertices[0].pos.x, sizeof(MeshVertex), mesh.vertices.size());
+			}
+		}),
+		Variant("optimizeVertexFetch", [&] {
+			fetchMeshes = overdrawMeshes;
+			for (size_t m = 0; m < fetchMeshes.size(); m++) {
+				TriangleMesh& mesh = fetchMeshes[m];
+				const size_t usedCount = vks::meshoptimizer::optimizeVertexFetch(mesh.vertices.data(), mesh.indices.data(), mesh.indices.size(), overdrawMeshes[m].vertices.data(), overdrawMeshes[m].vertices.size());
+				mesh.vertices.resize(usedCount);
+			}
+		}),
+	});
+
+	vks::meshoptimizer::VertexCacheStatistics welded, cacheOptimized, after;
+	for (size_t m = 0; m < sourceMeshes.size(); m++) {
+		welded.add(vks::meshoptimizer::analyzeVertexCache(weldedMeshes[m].indices.data(), weldedMeshes[m].indices.size(), weldedMeshes[m].vertices.size()));
+		cacheOptimized.add(vks::meshoptimizer::analyzeVertexCache(cacheMeshes[m].indices.data(), cacheMeshes[m].indices.size(), cacheMeshes[m].vertices.size()));
+		after.add(vks::meshoptimizer::analyzeVertexCache(fetchMeshes[m].indices.data(), fetchMeshes[m].indices.size(), fetchMeshes[m].vertices.size()));
+	}
+	LOG("  Vertices: %d source, %d welded\n", before.vertexCount, welded.vertexCount);
+	LOG("  ACMR: %.3f source, %.3f welded, %.3f cache optimized, %.3f final\n", before.acmr(), welded.acmr(), cacheOptimized.acmr(), after.acmr());
+	LOG("  ATVR: %.3f source, %.3f welded, %.3f cache optimized, %.3f final\n", before.atvr(), welded.atvr(), cacheOptimized.atvr(), after.atvr());
+}
+
+void benchmarkLodGeneration(const BenchmarkSettings& settings)
+{
+	const std::string filename = getAssetPath() + "buster_drone/busterDrone.gltf";
+	const uint32_t levelCount = 4;
+
+	std::vector<TriangleMesh> meshes;
+	if (!loadTriangleMeshes(filename, meshes)) {
+		LOG("Could not load triangle meshes from \"%s\", skipping\n", filename.c_str());
+		return;
+	}
+	// Welded like the glTF loader does before simplifying
+	for (TriangleMesh& mesh : meshes) {
+		std::vector<uint32_t> remap(mesh.vertices.size());
+		std::vector<MeshVertex> weldedVertices(mesh.vertices.size());
+		const size_t uniqueCount = vks::meshoptimizer::generateVertexRemap(remap.data(), mesh.indices.data(), mesh.indices.size(), mesh.vertices.data(), mesh.vertices.size());
+		vks::meshoptimizer::remapIndexBuffer(mesh.indices.data(), mesh.indices.size(), remap.data());
+		vks::meshoptimizer::remapVertexBuffer(weldedVertices.data(), mesh.vertices.data(), mesh.vertices.size(), remap.data());
+		weldedVertices.resize(uniqueCount);
+		mesh.vertices.swap(weldedVertices);
+	}
+
+	// Each level is simplified to half of the previous one, the errors of the steps add up
+	std::vector<uint32_t> triangleCounts(levelCount);
+	std::vector<float> maxErrors(levelCount);
+	measureVariants(settings, {
+		Variant("simplify", [&] {
+			std::fill(triangleCounts.begin(), triangleCounts.end(), 0);
+			std::fill(maxErrors.begin(), maxErrors.end(), 0.0f);
+			for (const TriangleMesh& mesh : meshes) {
+				std::vector<uint32_t> indices = mesh.indices;
+				std::vector<uint32_t> lodIndices(indices.size());
+				triangleCounts[0] += static_cast<uint32_t>(indices.size() / 3);
+				float error = 0.0f;
+				for (uint32_t level = 1; level < levelCount; level++) {
+					float levelError = 0.0f;
+					const size_t lodIndexCount = vks::meshoptimizer::simplify(lodIndices.data(), indices.data(), indices.size(), &mesh.vertices[0].pos.x, sizeof(MeshVertex), mesh.vertices.size(), indices.size() / 6 * 3, FLT_MAX, &levelError);
+					error += levelError;
+					indices.assign(lodIndices.begin(), lodIndices.begin() + lodIndexCount);
+					triangleCounts[level] += static_cast<uint32_t>(lodIndexCount / 3);
+					maxErrors[level] = std::max(maxErrors[level], error);
+				}
+			}
+		}),
+	});
+	for (uint32_t level = 0; level < levelCount; level++) {
+		LOG("  Level %d: %d triangles, max. error %f\n", level, triangleCounts[level], maxErrors[level]);
+	}
+}
+
+/*
+	Particles
+	Compares the array of structures fire simulation the particle sample used before (one branch per particle, the whole
+	buffer copied to the GPU) against the structure of arrays simulation, single threaded and split over the job system
+*/
+
+struct FireParticle
+{
+	glm::vec4 pos;
+	glm::vec4 color;
+	float alpha;
+	float size;
+	float rotation;
+	uint32_t type;
+	glm::vec4 vel;
+	float rotationSpeed;
+};
+
+class FireParticlesReference
+{
+public:
+	std::vector<FireParticle> particles;
+	std::default_random_engine rndEngine{ 0 };
+	glm::vec3 emitterPos = glm::vec3(0.0f, -6.0f, 0.0f);
+	glm::vec3 minVel = glm::vec3(-3.0f, 0.5f, -3.0f);
+	glm::vec3 maxVel = glm::vec3(3.0f, 7.0f, 3.0f);
+	const float flameRadius = 8.0f;
+
+	float rnd(float range)
+	{
+		std::uniform_real_distribution<float> rndDist(0.0f, range);
+		return rndDist(rndEngine);
+	}
+
+	void init(FireParticle& particle)
+	{
+		particle.vel = glm::vec4(0.0f, minVel.y + rnd(maxVel.y - minVel.y), 0.0f, 0.0f);
+		particle.alpha = rnd(0.75f);
+		particle.size = 1.0f + rnd(0.5f);
+		particle.color = glm::vec4(1.0f);
+		particle.type = 0;
+		particle.rotation = rnd(2.0f * float(M_PI));
+		particle.rotationSpeed = rnd(2.0f) - rnd(2.0f);
+		const float theta = rnd(2.0f * float(M_PI));
+		const float phi = rnd(float(M_PI)) - float(M_PI) / 2.0f;
+		const float r = rnd(flameRadius);
+		particle.pos = glm::vec4(emitterPos + glm::vec3(r * cos(theta) * cos(phi), r * sin(phi), r * sin(theta) * cos(phi)), 0.0f);
+	}
+
+	void update(float frameTimer)
+	{
+		const float particleTimer = frameTimer * 0.45f;
+		for (auto& particle : particles) {
+			if (particle.type == 0) {
+				particle.pos.y -= particle.vel.y * particleTimer * 3.5f;
+				particle.alpha += particleTimer * 2.5f;
+				particle.size -= particleTimer * 0.5f;
+			} else {
+				particle.pos -= particle.vel * frameTimer * 1.0f;
+				particle.alpha += particleTimer * 1.25f;
+				particle.size += particleTimer * 0.125f;
+				particle.color -= particleTimer * 0.05f;
+			}
+			particle.rotation += particleTimer * particle.rotationSpeed;
+			if (particle.alpha > 2.0f) {
+				if ((particle.type == 0) && (rnd(1.0f) < 0.05f)) {
+					particle.alpha = 0.0f;
+					particle.color = glm::vec4(0.25f + rnd(0.25f));
+					particle.pos.x *= 0.5f;
+					particle.pos.z *= 0.5f;
+					particle.vel = glm::vec4(rnd(1.0f) - rnd(1.0f), (minVel.y * 2) + rnd(maxVel.y - minVel.y), rnd(1.0f) - rnd(1.0f), 0.0f);
+					particle.size = 1.0f + rnd(0.5f);
+					particle.rotationSpeed = rnd(1.0f) - rnd(1.0f);
+					particle.type = 1;
+				} else {
+					init(particle);
+				}
+			}
+		}
+	}
+};
+
+void benchmarkParticles(const BenchmarkSettings& settings)
+{
+	const uint32_t particleCount = 1024 * 1024;
+	const float frameTimer = 1.0f / 60.0f;
+	// Long enough for the first smoke particles to fade out, so the ratio of flames and smoke has settled
+	const uint32_t warmUpFrames = 240;
+
+	vks::JobSystem* jobSystem = settings.jobSystem;
+	const Throughput throughput(particleCount, 1000000.0, "M particles/s");
+
+	LOG("Simulating %d fire particles, %.0f ms time step\n", particleCount, frameTimer * 1000.0f);
+
+	{
+		FireParticlesReference reference;
+		reference.particles.resize(particleCount);
+		for (auto& particle : reference.particles) {
+			reference.init(particle);
+			particle.alpha = 1.0f - (fabsf(particle.pos.y - reference.emitterPos.y) / (reference.flameRadius * 2.0f));
+		}
+		for (uint32_t i = 0; i < warmUpFrames; i++) {
+			reference.update(frameTimer);
+		}
+		std::vector<FireParticle> vertexBuffer(particleCount);
+		measureVariants(settings, {
+			Variant("array of structures", [&] {
+				reference.update(frameTimer);
+				memcpy(vertexBuffer.data(), reference.particles.data(), reference.particles.size() * sizeof(FireParticle));
+			}),
+		}, throughput);
+	}
+
+	vks::particles::FireSimulation simulation;
+	simulation.setParticleCount(particleCount);
+	for (uint32_t i = 0; i < warmUpFrames; i++) {
+		simulation.update(frameTimer, jobSystem);
+	}
+	LOG("  %d flames, %d smoke\n", simulation.getFlameCount(), simulation.getSmokeCount());
+	std::vector<vks::particles::ParticleVertex> vertices(particleCount);
+	measureVariants(settings, {
+		Variant("structure of arrays, update", [&] {
+			simulation.update(frameTimer);
+		}),
+		Variant("structure of arrays, update + write", [&] {
+			simulation.update(frameTimer);
+			simulation.writeVertices(vertices.data());
+		}),
+		Variant("structure of arrays, jobs, update", [&] {
+			simulation.update(frameTimer, jobSystem);
+		}),
+		Variant("structure of arrays, jobs, update + write", [&] {
+			simulation.update(frameTimer, jobSystem);
+			simulation.writeVertices(vertices.data(), jobSystem);
+		}),
+	}, throughput);
+#if defined(VKS_SIMD_AVX)
+	LOG("  SIMD: AVX\n");
+#elif defined(VKS_SIMD_SSE2)
+	LOG("  SIMD: SSE2\n");
+#elif defined(VKS_SIMD_NEON)
+	LOG("  SIMD: NEON\n");
+#else
+	LOG("  SIMD: scalar fallback\n");
+#endif
+}
+
+/*
+	Noise
+	Compares evaluating the fractal noise per voxel (as the 3D texture sample did before) against the row based volume
+	generator, single threaded and with the slices split over the job system
+*/
+
+void benchmarkNoiseVolume(const BenchmarkSettings& settings)
+{
+	vks::noise::VolumeSettings volumeSettings;
+	volumeSettings.width = volumeSettings.height = volumeSettings.depth = 128;
+	volumeSettings.scale = 8.0f;
+	const uint32_t voxelCount = volumeSettings.width * volumeSettings.height * volumeSettings.depth;
+
+	const vks::noise::PerlinNoise perlinNoise(1234);
+	const vks::noise::VolumeGenerator generator(perlinNoise, volumeSettings);
+
+	LOG("Generating a %d x %d x %d volume with %d octaves\n", volumeSettings.width, volumeSettings.height, volumeSettings.depth, volumeSettings.octaves);
+
+	std::vector<uint8_t> reference(voxelCount);
+	std::vector<uint8_t> volume(voxelCount);
+	measureVariants(settings, {
+		Variant("per voxel", [&] {
+			for (uint32_t z = 0; z < volumeSettings.depth; z++) {
+				for (uint32_t y = 0; y < volumeSettings.height; y++) {
+					for (uint32_t x = 0; x < volumeSettings.width; x++) {
+						const float nx = (float)x / (float)volumeSettings.width;
+						const float ny = (float)y / (float)volumeSettings.height;
+						const float nz = (float)z / (float)volumeSettings.depth;
+						float n = perlinNoise.fractalNoise(nx * volumeSettings.scale, ny * volumeSettings.scale, nz * volumeSettings.scale, volumeSettings.octaves, volumeSettings.persistence);
+						n = n - floorf(n);
+						reference[x + (y + z * volumeSettings.height) * volumeSettings.width] = static_cast<uint8_t>(n * 255.0f);
+					}
+				}
+			}
+		}, std::max(settings.iterations / 10, 1u)),
+		Variant("row based", [&] {
+			generator.generate(volume.data());
+		}),
+		Variant("row based, job system", [&] {
+			generator.generate(volume.data(), settings.jobSystem);
+		}),
+	}, Throughput(voxelCount, 1000000.0, "M voxels/s"));
+
+	// Rounding differs slightly, which may flip a voxel close to a quantization step (or wrap around at the fractional part)
+	uint32_t differentVoxels = 0;
+	for (uint32_t i = 0; i < voxelCount; i++) {
+		const int difference = abs((int)volume[i] - (int)reference[i]);
+		if (std::min(difference, 256 - difference) > 1) {
+			differentVoxels++;
+		}
+	}
+	LOG("  %d voxels differ by more than one step from the per voxel evaluation\n", differentVoxels);
+}
+
+/*
+	N-body
+	Compares the all pairs simulation of the computenbody sample against the Barnes-Hut octree, and reports the error of the
+	approximated accelerations relative to the exact ones
+*/
+
+void benchmarkNBody(const BenchmarkSettings& settings)
+{
+	// Same initial conditions as the computenbody sample
+	const std::vector<glm::vec3> attractors = {
+		glm::vec3(5.0f, 0.0f, 0.0f),
+		glm::vec3(-5.0f, 0.0f, 0.0f),
+		glm::vec3(0.0f, 0.0f, 5.0f),
+		glm::vec3(0.0f, 0.0f, -5.0f),
+		glm::vec3(0.0f, 4.0f, 0.0f),
+		glm::vec3(0.0f, -8.0f, 0.0f),
+	};
+	const float deltaT = 0.05f / 60.0f;
+	// The all pairs step grows quadratically, so it is only measured for the smaller systems
+	const uint32_t maxDirectParticleCount = 8192;
+	const uint32_t sampleCount = 1024;
+	const vks::nbody::Settings simulationSettings;
+	vks::JobSystem* jobSystem = settings.jobSystem;
+
+	LOG("Opening angle %.2f, %d particles per leaf\n", simulationSettings.theta, simulationSettings.leafSize);
+
+	for (uint32_t particlesPerAttractor : { 1024, 4096, 16384 }) {
+		const std::vector<vks::nbody::Particle> initialParticles = vks::nbody::createAttractorSystem(attractors, particlesPerAttractor, 1234);
+		const uint32_t particleCount = static_cast<uint32_t>(initialParticles.size());
+		const uint32_t iterations = std::max(settings.iterations / 4, 1u);
+
+		LOG("%d particles\n", particleCount);
+
+		std::vector<vks::nbody::Particle> particles = initialParticles;
+		vks::nbody::BarnesHut barnesHut(simulationSettings);
+		std::vector<Variant> variants;
+		if (particleCount <= maxDirectParticleCount) {
+			variants.push_back(Variant("all pairs, job system", [&] {
+				vks::nbody::stepDirect(particles, deltaT, simulationSettings, jobSystem);
+			}, std::max(iterations / 4, 1u), [&] { particles = initialParticles; }));
+		}
+		variants.push_back(Variant("barnes-hut, build", [&] {
+			barnesHut.build(particles, jobSystem);
+		}, iterations));
+		variants.push_back(Variant("barnes-hut, job system, step", [&] {
+			barnesHut.step(particles, deltaT, jobSystem);
+		}, iterations));
+		measureVariants(settings, variants, Throughput(particleCount, 1000.0, "K particles/s"));
+
+		// Compare against the exact accelerations on an evenly spaced subset of the particles
+		barnesHut.build(particles, jobSystem);
+		double errorSquared = 0.0;
+		double maxError = 0.0;
+		uint64_t interactions = 0;
+		const uint32_t stride = std::max(particleCount / sampleCount, 1u);
+		for (uint32_t i = 0; i < particleCount; i += stride) {
+			const glm::vec3 position(particles[i].pos);
+			const glm::vec3 exact = vks::nbody::directAcceleration(particles, position, simulationSettings);
+			const glm::vec3 approximated = barnesHut.acceleration(particles, position, interactions);
+			const double error = (double)glm::length(approximated - exact) / std::max((double)glm::length(exact), 1e-12);
+			errorSquared += error * error;
+			maxError = std::max(maxError, error);
+		}
+		const uint32_t sampled = (particleCount + stride - 1) / stride;
+		LOG("  %d nodes, %.0f interactions per particle (all pairs: %d)\n", static_cast<uint32_t>(barnesHut.getNodes().size()), (double)interactions / (double)sampled, particleCount);
+		LOG("  relative error: rms %.4f%%, max %.4f%%\n", sqrt(errorSquared / (double)sampled) * 100.0, maxError * 100.0);
+	}
+}
+
+int main(int argc, char* argv[])
+{
+	commandLineParser.add("help", { "--help" }, 0, "Show help");
+	commandLineParser.add("benchmark", { "-b", "--benchmark" }, 1, "Only run benchmarks whose name contains the given string");
+	commandLineParser.add("iterations", { "-i", "--iterations" }, 1, "Number of timed iterations per benchmark");
+	commandLineParser.add("threads", { "-t", "--threads" }, 1, "Number of threads for multi threaded benchmarks (defaults to all hardware threads)");
+	commandLineParser.add("list", { "-l", "--list" }, 0, "List available benchmarks");
+	commandLineParser.parse(argc, argv);
+	if (commandLineParser.isSet("help")) {
+		commandLineParser.printHelp();
+		std::cin.get();
+		return 0;
+	}
+
+	BenchmarkSettings settings;
+	settings.iterations = commandLineParser.getValueAsInt("iterations", settings.iterations);
+	settings.threadCount = commandLineParser.getValueAsInt("threads", std::max(std::thread::hardware_concurrency(), 1u));
+
+	std::vector<BenchmarkCase> benchmarks = {
+		{ "jobscheduling", "Overhead of scheduling many small jobs", benchmarkJobScheduling },
+		{ "parallelfor", "Evenly distributed work split over all threads", [](const BenchmarkSettings& s) { benchmarkParallelFor(s, "Balanced parallel for", false); } },
+		{ "parallelfor_unbalanced", "Unevenly distributed work split over all threads", [](const BenchmarkSettings& s) { benchmarkParallelFor(s, "Unbalanced parallel for", true); } },
+		{ "animation_instances", "Pose evaluation for many instances of the same animation", benchmarkAnimationInstances },
+		{ "frustum_culling", "Frustum culling of a million boxes with scalar, SIMD and hierarchical tests", benchmarkFrustumCulling },
+		{ "mesh_optimization", "Vertex welding and vertex cache, overdraw and vertex fetch reordering of a glTF model", benchmarkMeshOptimization },
+		{ "lod_generation", "Quadric error simplification of a glTF model into levels of detail", benchmarkLodGeneration },
+		{ "noise_volume", "Fractal noise volume generation per voxel and with the row based SIMD generator", benchmarkNoiseVolume },
+		{ "particles", "Fire particle simulation of a million particles with array of structures and SIMD structure of arrays updates", benchmarkParticles },
+		{ "nbody", "Gravitational N-body step with all pairs and with the Barnes-Hut octree, and the error of the approximation", benchmarkNBody },
+	};
+
+	if (commandLineParser.isSet("list")) {
+		for (auto& benchmark : benchmarks) {
+			LOG("%-32s %s\n", benchmark.name.c_str(), benchmark.description.c_str());
+		}
+		return 0;
+	}
+
+	vks::JobSystem jobSystem;
+	jobSystem.start(settings.threadCount);
+	settings.jobSystem = &jobSystem;
+
+	const std::string filter = commandLineParser.getValueAsString("benchmark", "");
+	LOG("Running with %d threads, %d iterations\n", settings.threadCount, settings.iterations);
+	for (auto& benchmark : benchmarks) {
+		if (!filter.empty() && (benchmark.name.find(filter) == std::string::npos)) {
+			continue;
+		}
+		LOG("\n[%s]\n", benchmark.name.c_str());
+		benchmark.run(settings);
+	}
+
+	return 0;
+}
@@ -170,6 +170,10 @@ public:
 		if (deviceFeatures.samplerAnisotropy) {
 			enabledFeatures.samplerAnisotropy = VK_TRUE;
 		}
+		// Pipeline statistics are shown by the GPU profiler if supported
+		if (deviceFeatures.pipelineStatisticsQuery) {
+			enabledFeatures.pipelineStatisticsQuery = VK_TRUE;
+		}
 	};
 
 	// Create a frame buffer attachment
@@ -378,6 +382,11 @@ public:
 		VK_CHECK_RESULT(vkCreateSampler(device, &sampler, nullptr, &colorSampler));
 	}
 
+	uint32_t offscreenProfilerSlot()
+	{
+		return static_cast<uint32_t>(drawCmdBuffers.size());
+	}
+
 	// Build command buffer for rendering the scene to the offscreen frame buffer attachments
 	void buildDeferredCommandBuffer()
 	{
@@ -408,7 +417,10 @@ public:
 		renderPassBeginInfo.pClearValues = clearValues.data();
 
 		VK_CHECK_RESULT(vkBeginCommandBuffer(offScreenCmdBuffer, &cmdBufInfo));
+		// The offscreen command buffer uses the profiler slot after those of the per-swapchain image command buffers
+		gpuProfiler.beginFrame(offScreenCmdBuffer, offscreenProfilerSlot());
 
+		gpuProfiler.beginScope(offScreenCmdBuffer, "G-Buffer");
 		vkCmdBeginRenderPass(offScreenCmdBuffer, &renderPassBeginInfo, VK_SUBPASS_CONTENTS_INLINE);
 
 		VkViewport viewport = vks::initializers::viewport((float)offScreenFrameBuf.width, (float)offScreenFrameBuf.height, 0.0f, 1.0f);
@@ -429,6 +441,7 @@ public:
 		vkCmdDrawIndexed(offScreenCmdBuffer, models.model.indices.count, 3, 0, 0, 0);
 
 		vkCmdEndRenderPass(offScreenCmdBuffer);
+		gpuProfiler.endScope(offScreenCmdBuffer);
 
 		VK_CHECK_RESULT(vkEndCommandBuffer(offScreenCmdBuffer));
 	}
@@ -466,7 +479,9 @@ public:
 			renderPassBeginInfo.framebuffer = frameBuffers[i];
 
 			VK_CHECK_RESULT(vkBeginCommandBuffer(drawCmdBuffers[i], &cmdBufInfo));
+			gpuProfiler.beginFrame(drawCmdBuffers[i], i);
 
+			gpuProfiler.beginScope(drawCmdBuffers[i], "Composition");
 			vkCmdBeginRenderPass(drawCmdBuffers[i], &renderPassBeginInfo, VK_SUBPASS_CONTENTS_INLINE);
 
 			VkViewport viewport = vks::initializers::viewport((float)width, (float)height, 0.0f, 1.0f);
@@ -485,6 +500,7 @@ public:
 			drawUI(drawCmdBuffers[i]);
 
 			vkCmdEndRenderPass(drawCmdBuffers[i]);
+			gpuProfiler.endScope(drawCmdBuffers[i]);
 
 			VK_CHECK_RESULT(vkEndCommandBuffer(drawCmdBuffers[i]));
 		}
@@ -763,9 +779,11 @@ public:
 		submitInfo.pSignalSemaphores = &offscreenSemaphore;
 
 		// Submit work
+		gpuProfiler.resolve(offscreenProfilerSlot());
 		submitInfo.commandBufferCount = 1;
 		submitInfo.pCommandBuffers = &offScreenCmdBuffer;
 		VK_CHECK_RESULT(vkQueueSubmit(queue, 1, &submitInfo, VK_NULL_HANDLE));
+		gpuProfiler.markSubmitted(offscreenProfilerSlot());
 
 		// Scene rendering
 
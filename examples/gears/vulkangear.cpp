@@ -228,10 +228,9 @@ void VulkanGear::generate(GearInfo *gearinfo, VkQueue queue)
 
 		vulkanDevice->flushCommandBuffer(copyCmd, queue, true);
 
-		vkDestroyBuffer(vulkanDevice->logicalDevice, vertexStaging.buffer, nullptr);
-		vkFreeMemory(vulkanDevice->logicalDevice, vertexStaging.memory, nullptr);
-		vkDestroyBuffer(vulkanDevice->logicalDevice, indexStaging.buffer, nullptr);
-		vkFreeMemory(vulkanDevice->logicalDevice, indexStaging.memory, nullptr);
+		// The staging memory is sub-allocated, so it has to be released through the buffers
+		vertexStaging.destroy();
+		indexStaging.destroy();
 	}
 	else
 	{
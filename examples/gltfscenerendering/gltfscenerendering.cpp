@@ -28,11 +28,9 @@ VulkanglTFScene::~VulkanglTFScene()
 	vkFreeMemory(vulkanDevice->logicalDevice, vertices.memory, nullptr);
 	vkDestroyBuffer(vulkanDevice->logicalDevice, indices.buffer, nullptr);
 	vkFreeMemory(vulkanDevice->logicalDevice, indices.memory, nullptr);
-	for (Image image : images) {
-		vkDestroyImageView(vulkanDevice->logicalDevice, image.texture.view, nullptr);
-		vkDestroyImage(vulkanDevice->logicalDevice, image.texture.image, nullptr);
-		vkDestroySampler(vulkanDevice->logicalDevice, image.texture.sampler, nullptr);
-		vkFreeMemory(vulkanDevice->logicalDevice, image.texture.deviceMemory, nullptr);
+	for (Image& image : images) {
+		// The texture's memory is sub-allocated from a block shared with other resources, so it has to be released through the texture
+		image.texture.destroy();
 	}
 	for (Material material : materials) {
 		vkDestroyPipeline(vulkanDevice->logicalDevice, material.pipeline, nullptr);
@@ -44,12 +44,10 @@ VulkanglTFModel::~VulkanglTFModel()
 	vkFreeMemory(vulkanDevice->logicalDevice, vertices.memory, nullptr);
 	vkDestroyBuffer(vulkanDevice->logicalDevice, indices.buffer, nullptr);
 	vkFreeMemory(vulkanDevice->logicalDevice, indices.memory, nullptr);
-	for (Image image : images)
+	for (Image& image : images)
 	{
-		vkDestroyImageView(vulkanDevice->logicalDevice, image.texture.view, nullptr);
-		vkDestroyImage(vulkanDevice->logicalDevice, image.texture.image, nullptr);
-		vkDestroySampler(vulkanDevice->logicalDevice, image.texture.sampler, nullptr);
-		vkFreeMemory(vulkanDevice->logicalDevice, image.texture.deviceMemory, nullptr);
+		// The texture's memory is sub-allocated from a block shared with other resources, so it has to be released through the texture
+		image.texture.destroy();
 	}
 	for (Skin skin : skins)
 	{
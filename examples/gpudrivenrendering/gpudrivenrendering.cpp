@@ -0,0 +1,296 @@
+/*
+* Vulkan Example - GPU driven rendering
+*
+* Culls all primitives of a glTF scene in a compute shader and draws the visible ones with a single indirect draw per alpha mode
+* Transforms and materials are fetched from storage buffers and textures from a descriptor indexed array, so no per primitive
+* state is bound and the command buffers don't have to be rebuilt when the camera moves
+* Only opaque and alpha masked primitives are drawn: blended primitives would need to be sorted and skinned primitives need their
+* joint matrices, both are skipped by the indirect renderer, so scenes using them will be missing those primitives
+*
+* Relevant code parts are marked with [POI]
+*
+* This code is licensed under the MIT license (MIT) (http://opensource.org/licenses/MIT)
+*/
+
+#include "vulkanexamplebase.h"
+#include "VulkanglTFModel.h"
+#include "frustum.hpp"
+
+#define ENABLE_VALIDATION false
+
+class VulkanExample : public VulkanExampleBase
+{
+public:
+	vkglTF::Model scene;
+	vkglTF::IndirectRenderer renderer;
+	// Statistics of the last finished culling pass
+	vkglTF::IndirectRenderer::Statistics cullStatistics{};
+	vks::Frustum frustum;
+	// Detail levels are switched once their error covers less than this many pixels
+	float lodPixelError = 1.0f;
+
+	// [POI] Vertices are stored in the packed format with only the components the shaders read
+	const std::vector<vkglTF::VertexComponent> vertexComponents = { vkglTF::VertexComponent::Position, vkglTF::VertexComponent::Normal, vkglTF::VertexComponent::UV, vkglTF::VertexComponent::Color, vkglTF::VertexComponent::Tangent };
+
+	struct UniformData {
+		glm::mat4 projection;
+		glm::mat4 view;
+		glm::mat4 vertexDequantization;
+		glm::vec4 lightPos = glm::vec4(0.0f, 2.5f, 0.0f, 1.0f);
+		glm::vec4 viewPos;
+	} uniformData;
+	vks::Buffer uniformBuffer;
+
+	struct {
+		VkPipeline opaque;
+		VkPipeline masked;
+	} pipelines;
+
+	VkPipelineLayout pipelineLayout;
+	VkDescriptorSet descriptorSet;
+	VkDescriptorSetLayout descriptorSetLayout;
+
+	VkPhysicalDeviceVulkan12Features enabledFeatures12{};
+
+	VulkanExample() : VulkanExampleBase(ENABLE_VALIDATION)
+	{
+		title = "GPU driven rendering";
+		apiVersion = VK_API_VERSION_1_2;
+		camera.type = Camera::CameraType::firstperson;
+		camera.flipY = true;
+		camera.setPosition(glm::vec3(0.0f, 1.0f, 0.0f));
+		camera.setRotation(glm::vec3(0.0f, -90.0f, 0.0f));
+		camera.setPerspective(60.0f, (float)width / (float)height, 0.1f, 256.0f);
+		camera.setRotationSpeed(0.25f);
+
+		// [POI] Draw counts are sourced from a buffer and textures are indexed with per object material indices
+		enabledFeatures12.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_VULKAN_1_2_FEATURES;
+		enabledFeatures12.drawIndirectCount = VK_TRUE;
+		enabledFeatures12.runtimeDescriptorArray = VK_TRUE;
+		enabledFeatures12.shaderSampledImageArrayNonUniformIndexing = VK_TRUE;
+		deviceCreatepNextChain = &enabledFeatures12;
+	}
+
+	~VulkanExample()
+	{
+		vkDestroyPipeline(device, pipelines.opaque, nullptr);
+		vkDestroyPipeline(device, pipelines.masked, nullptr);
+		vkDestroyPipelineLayout(device, pipelineLayout, nullptr);
+		vkDestroyDescriptorSetLayout(device, descriptorSetLayout, nullptr);
+		uniformBuffer.destroy();
+		renderer.destroy();
+	}
+
+	virtual void getEnabledFeatures()
+	{
+		enabledFeatures.samplerAnisotropy = deviceFeatures.samplerAnisotropy;
+		// [POI] All visible objects are drawn with one multi draw, the instance index selects the object's data
+		if (!deviceFeatures.multiDrawIndirect || !deviceFeatures.drawIndirectFirstInstance) {
+			vks::tools::exitFatal("Selected GPU does not support multi draw indirect with a first instance!", VK_ERROR_FEATURE_NOT_PRESENT);
+		}
+		enabledFeatures.multiDrawIndirect = VK_TRUE;
+		enabledFeatures.drawIndirectFirstInstance = VK_TRUE;
+	}
+
+	void buildCommandBuffers()
+	{
+		VkCommandBufferBeginInfo cmdBufInfo = vks::initializers::commandBufferBeginInfo();
+
+		VkClearValue clearValues[2];
+		clearValues[0].color = { { 0.25f, 0.25f, 0.25f, 1.0f } };
+		clearValues[1].depthStencil = { 1.0f, 0 };
+
+		VkRenderPassBeginInfo renderPassBeginInfo = vks::initializers::renderPassBeginInfo();
+		renderPassBeginInfo.renderPass = renderPass;
+		renderPassBeginInfo.renderArea.offset.x = 0;
+		renderPassBeginInfo.renderArea.offset.y = 0;
+		renderPassBeginInfo.renderArea.extent.width = width;
+		renderPassBeginInfo.renderArea.extent.height = height;
+		renderPassBeginInfo.clearValueCount = 2;
+		renderPassBeginInfo.pClearValues = clearValues;
+
+		for (int32_t i = 0; i < drawCmdBuffers.size(); ++i)
+		{
+			renderPassBeginInfo.framebuffer = frameBuffers[i];
+			VK_CHECK_RESULT(vkBeginCommandBuffer(drawCmdBuffers[i], &cmdBufInfo));
+
+			// [POI] Cull all objects and write the draw commands of the visible ones
+			renderer.cull(drawCmdBuffers[i], i);
+
+			vkCmdBeginRenderPass(drawCmdBuffers[i], &renderPassBeginInfo, VK_SUBPASS_CONTENTS_INLINE);
+			VkViewport viewport = vks::initializers::viewport((float)width, (float)height, 0.0f, 1.0f);
+			vkCmdSetViewport(drawCmdBuffers[i], 0, 1, &viewport);
+			VkRect2D scissor = vks::initializers::rect2D(width, height, 0, 0);
+			vkCmdSetScissor(drawCmdBuffers[i], 0, 1, &scissor);
+			vkCmdBindDescriptorSets(drawCmdBuffers[i], VK_PIPELINE_BIND_POINT_GRAPHICS, pipelineLayout, 0, 1, &descriptorSet, 0, nullptr);
+
+			// [POI] One indirect draw per alpha mode, the number of draws is read from the count buffer written by the culling pass
+			vkCmdBindPipeline(drawCmdBuffers[i], VK_PIPELINE_BIND_POINT_GRAPHICS, pipelines.opaque);
+			renderer.draw(drawCmdBuffers[i], vkglTF::RenderFlags::RenderOpaqueNodes, pipelineLayout, 1);
+			vkCmdBindPipeline(drawCmdBuffers[i], VK_PIPELINE_BIND_POINT_GRAPHICS, pipelines.masked);
+			renderer.draw(drawCmdBuffers[i], vkglTF::RenderFlags::RenderAlphaMaskedNodes, pipelineLayout, 1);
+
+			drawUI(drawCmdBuffers[i]);
+
+			vkCmdEndRenderPass(drawCmdBuffers[i]);
+			VK_CHECK_RESULT(vkEndCommandBuffer(drawCmdBuffers[i]));
+		}
+	}
+
+	void loadAssets()
+	{
+		// Vertices are welded, reordered for the vertex cache and packed once at load time
+		// Packed, the components take 24 bytes per vertex (8 for the position, 4 each for normal, uv, color and tangent) instead of 96
+		// [POI] Detail levels are generated by simplifying each primitive, they share its vertices and only add indices
+		scene.packedVertexComponents = vertexComponents;
+		scene.lodLevelCount = vkglTF::IndirectRenderer::maxLodCount;
+		scene.loadFromFile(getAssetPath() + "models/sponza/sponza.gltf", vulkanDevice, queue, vkglTF::FileLoadingFlags::PreTransformVertices | vkglTF::FileLoadingFlags::OptimizeMeshes | vkglTF::FileLoadingFlags::PackVertices | vkglTF::FileLoadingFlags::GenerateLods);
+		// [POI] Upload the scene's objects and materials to the buffers the culling and drawing shaders read from
+		// Every command buffer copies its culling statistics to a buffer of its own
+		renderer.prepare(&scene, vulkanDevice, queue, loadShader(getShadersPath() + "base/gltfcull.comp.spv", VK_SHADER_STAGE_COMPUTE_BIT), static_cast<uint32_t>(drawCmdBuffers.size()));
+	}
+
+	void setupDescriptors()
+	{
+		std::vector<VkDescriptorPoolSize> poolSizes = {
+			vks::initializers::descriptorPoolSize(VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER, 1),
+		};
+		VkDescriptorPoolCreateInfo descriptorPoolCI = vks::initializers::descriptorPoolCreateInfo(poolSizes, 1);
+		VK_CHECK_RESULT(vkCreateDescriptorPool(device, &descriptorPoolCI, nullptr, &descriptorPool));
+
+		std::vector<VkDescriptorSetLayoutBinding> setLayoutBindings = {
+			vks::initializers::descriptorSetLayoutBinding(VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER, VK_SHADER_STAGE_VERTEX_BIT, 0),
+		};
+		VkDescriptorSetLayoutCreateInfo descriptorSetLayoutCI = vks::initializers::descriptorSetLayoutCreateInfo(setLayoutBindings);
+		VK_CHECK_RESULT(vkCreateDescriptorSetLayout(device, &descriptorSetLayoutCI, nullptr, &descriptorSetLayout));
+
+		VkDescriptorSetAllocateInfo allocInfo = vks::initializers::descriptorSetAllocateInfo(descriptorPool, &descriptorSetLayout, 1);
+		VK_CHECK_RESULT(vkAllocateDescriptorSets(device, &allocInfo, &descriptorSet));
+		VkWriteDescriptorSet writeDescriptorSet = vks::initializers::writeDescriptorSet(descriptorSet, VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER, 0, &uniformBuffer.descriptor);
+		vkUpdateDescriptorSets(device, 1, &writeDescriptorSet, 0, nullptr);
+	}
+
+	void preparePipelines()
+	{
+		// Set 0 holds the scene matrices, set 1 the renderer's objects, materials and textures
+		const std::array<VkDescriptorSetLayout, 2> setLayouts = { descriptorSetLayout, renderer.descriptorSetLayout };
+		VkPipelineLayoutCreateInfo pipelineLayoutCI = vks::initializers::pipelineLayoutCreateInfo(setLayouts.data(), static_cast<uint32_t>(setLayouts.size()));
+		VK_CHECK_RESULT(vkCreatePipelineLayout(device, &pipelineLayoutCI, nullptr, &pipelineLayout));
+
+		VkPipelineInputAssemblyStateCreateInfo inputAssemblyStateCI = vks::initializers::pipelineInputAssemblyStateCreateInfo(VK_PRIMITIVE_TOPOLOGY_TRIANGLE_LIST, 0, VK_FALSE);
+		VkPipelineRasterizationStateCreateInfo rasterizationStateCI = vks::initializers::pipelineRasterizationStateCreateInfo(VK_POLYGON_MODE_FILL, VK_CULL_MODE_BACK_BIT, VK_FRONT_FACE_COUNTER_CLOCKWISE, 0);
+		VkPipelineColorBlendAttachmentState blendAttachmentStateCI = vks::initializers::pipelineColorBlendAttachmentState(0xf, VK_FALSE);
+		VkPipelineColorBlendStateCreateInfo colorBlendStateCI = vks::initializers::pipelineColorBlendStateCreateInfo(1, &blendAttachmentStateCI);
+		VkPipelineDepthStencilStateCreateInfo depthStencilStateCI = vks::initializers::pipelineDepthStencilStateCreateInfo(VK_TRUE, VK_TRUE, VK_COMPARE_OP_LESS_OR_EQUAL);
+		VkPipelineViewportStateCreateInfo viewportStateCI = vks::initializers::pipelineViewportStateCreateInfo(1, 1, 0);
+		VkPipelineMultisampleStateCreateInfo multisampleStateCI = vks::initializers::pipelineMultisampleStateCreateInfo(VK_SAMPLE_COUNT_1_BIT, 0);
+		const std::vector<VkDynamicState> dynamicStateEnables = { VK_DYNAMIC_STATE_VIEWPORT, VK_DYNAMIC_STATE_SCISSOR };
+		VkPipelineDynamicStateCreateInfo dynamicStateCI = vks::initializers::pipelineDynamicStateCreateInfo(dynamicStateEnables.data(), static_cast<uint32_t>(dynamicStateEnables.size()), 0);
+		std::array<VkPipelineShaderStageCreateInfo, 2> shaderStages;
+
+		VkGraphicsPipelineCreateInfo pipelineCI = vks::initializers::pipelineCreateInfo(pipelineLayout, renderPass, 0);
+		pipelineCI.pInputAssemblyState = &inputAssemblyStateCI;
+		pipelineCI.pRasterizationState = &rasterizationStateCI;
+		pipelineCI.pColorBlendState = &colorBlendStateCI;
+		pipelineCI.pMultisampleState = &multisampleStateCI;
+		pipelineCI.pViewportState = &viewportStateCI;
+		pipelineCI.pDepthStencilState = &depthStencilStateCI;
+		pipelineCI.pDynamicState = &dynamicStateCI;
+		pipelineCI.stageCount = static_cast<uint32_t>(shaderStages.size());
+		pipelineCI.pStages = shaderStages.data();
+		// [POI] Normals and tangents are octahedral encoded and decoded in the vertex shader, the other components are converted by the vertex input
+		pipelineCI.pVertexInputState = vkglTF::Vertex::getPipelineVertexInputState(vertexComponents, vkglTF::VertexFormat::Packed);
+
+		shaderStages[0] = loadShader(getShadersPath() + "gpudrivenrendering/scene.vert.spv", VK_SHADER_STAGE_VERTEX_BIT);
+		shaderStages[1] = loadShader(getShadersPath() + "gpudrivenrendering/scene.frag.spv", VK_SHADER_STAGE_FRAGMENT_BIT);
+
+		// Alpha masking is selected per pipeline, the cutoff is read from the material buffer
+		VkBool32 alphaMask = VK_FALSE;
+		VkSpecializationMapEntry specializationMapEntry = vks::initializers::specializationMapEntry(0, 0, sizeof(VkBool32));
+		VkSpecializationInfo specializationInfo = vks::initializers::specializationInfo(1, &specializationMapEntry, sizeof(VkBool32), &alphaMask);
+		shaderStages[1].pSpecializationInfo = &specializationInfo;
+
+		VK_CHECK_RESULT(vkCreateGraphicsPipelines(device, pipelineCache, 1, &pipelineCI, nullptr, &pipelines.opaque));
+		alphaMask = VK_TRUE;
+		rasterizationStateCI.cullMode = VK_CULL_MODE_NONE;
+		VK_CHECK_RESULT(vkCreateGraphicsPipelines(device, pipelineCache, 1, &pipelineCI, nullptr, &pipelines.masked));
+	}
+
+	void prepareUniformBuffers()
+	{
+		VK_CHECK_RESULT(vulkanDevice->createBuffer(
+			VK_BUFFER_USAGE_UNIFORM_BUFFER_BIT,
+			VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
+			&uniformBuffer,
+			sizeof(uniformData)));
+		VK_CHECK_RESULT(uniformBuffer.map());
+		updateUniformBuffers();
+	}
+
+	void updateUniformBuffers()
+	{
+		uniformData.projection = camera.matrices.perspective;
+		uniformData.view = camera.matrices.view;
+		// Packed positions are normalized to the scene bounds
+		uniformData.vertexDequantization = scene.vertexDequantization;
+		uniformData.viewPos = camera.viewPos;
+		memcpy(uniformBuffer.mapped, &uniformData, sizeof(uniformData));
+		// [POI] Moving the camera only updates the culling parameters, the recorded command buffers stay valid
+		frustum.update(uniformData.projection * uniformData.view);
+		renderer.lodDistanceScale = vkglTF::IndirectRenderer::getLodDistanceScale(uniformData.projection, (float)height, lodPixelError);
+		renderer.updateCullParameters(frustum, glm::vec3(camera.viewPos));
+	}
+
+	void draw()
+	{
+		VulkanExampleBase::prepareFrame();
+		// The previous execution of this command buffer has finished, so its culling statistics can be read
+		cullStatistics = renderer.getStatistics(currentBuffer);
+		submitInfo.commandBufferCount = 1;
+		submitInfo.pCommandBuffers = &drawCmdBuffers[currentBuffer];
+		VK_CHECK_RESULT(vkQueueSubmit(queue, 1, &submitInfo, VK_NULL_HANDLE));
+		VulkanExampleBase::submitFrame();
+	}
+
+	void prepare()
+	{
+		VulkanExampleBase::prepare();
+		loadAssets();
+		prepareUniformBuffers();
+		setupDescriptors();
+		preparePipelines();
+		buildCommandBuffers();
+		prepared = true;
+	}
+
+	virtual void render()
+	{
+		if (!prepared)
+			return;
+		draw();
+		if (camera.updated) {
+			updateUniformBuffers();
+		}
+	}
+
+	virtual void OnUpdateUIOverlay(vks::UIOverlay *overlay)
+	{
+		if (overlay->header("Settings")) {
+			if (overlay->sliderFloat("LOD pixel error", &lodPixelError, 0.25f, 16.0f)) {
+				updateUniformBuffers();
+			}
+		}
+		if (overlay->header("Statistics")) {
+			const vkglTF::IndirectRenderer::Statistics& statistics = cullStatistics;
+			overlay->text("%u of %u objects visible", statistics.opaqueDraws + statistics.maskedDraws, renderer.getObjectCount());
+			overlay->text("Opaque draws: %u", statistics.opaqueDraws);
+			overlay->text("Masked draws: %u", statistics.maskedDraws);
+			for (uint32_t i = 0; i < vkglTF::IndirectRenderer::maxLodCount; i++) {
+				overlay->text("LOD %u: %u", i, statistics.lodDraws[i]);
+			}
+			overlay->text("Vertex buffer: %.2f MB (%u bytes per vertex)", (float)scene.vertices.count * scene.vertices.stride / (1024.0f * 1024.0f), scene.vertices.stride);
+		}
+	}
+};
+
+VULKAN_EXAMPLE_MAIN()
@@ -89,7 +89,6 @@ public:
 			vkDestroyPipeline(device, pipelineLibrary.fragmentOutputInterface, nullptr);
 			vkDestroyPipeline(device, pipelineLibrary.preRasterizationShaders, nullptr);
 			vkDestroyPipeline(device, pipelineLibrary.vertexInputInterface, nullptr);
-			vkDestroyPipelineCache(device, threadPipelineCache, nullptr);
 			vkDestroyPipelineLayout(device, pipelineLayout, nullptr);
 			vkDestroyDescriptorSetLayout(device, descriptorSetLayout, nullptr);
 			uniformBuffer.destroy();
@@ -494,9 +493,8 @@ public:
 		buildCommandBuffers();
 
 		// Create a separate pipeline cache for the pipeline creation thread
-		VkPipelineCacheCreateInfo pipelineCachCI = {};
-		pipelineCachCI.sType = VK_STRUCTURE_TYPE_PIPELINE_CACHE_CREATE_INFO;
-		vkCreatePipelineCache(device, &pipelineCachCI, nullptr, &threadPipelineCache);
+		// This is merged into the main pipeline cache by the base class at shutdown
+		threadPipelineCache = createThreadPipelineCache();
 
 		// Create first pipeline using a background thread
 		std::thread pipelineGenerationThread(&VulkanExample::threadFn, this);
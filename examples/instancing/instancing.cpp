@@ -55,9 +55,11 @@ public:
 		float globSpeed = 0.0f;
 	} uboVS;
 
-	struct {
+	// The uniform buffer is updated every frame, so each frame in flight uses its own copy
+	struct UniformBuffers {
 		vks::Buffer scene;
-	} uniformBuffers;
+	};
+	std::vector<UniformBuffers> uniformBuffers;
 
 	VkPipelineLayout pipelineLayout;
 	struct {
@@ -67,10 +69,12 @@ public:
 	} pipelines;
 
 	VkDescriptorSetLayout descriptorSetLayout;
-	struct {
+	struct DescriptorSets {
 		VkDescriptorSet instancedRocks;
 		VkDescriptorSet planet;
-	} descriptorSets;
+	};
+	// One set of descriptors per frame in flight, pointing to that frame's uniform buffer
+	std::vector<DescriptorSets> descriptorSets;
 
 	VulkanExample() : VulkanExampleBase(ENABLE_VALIDATION)
 	{
@@ -79,6 +83,8 @@ public:
 		camera.setPosition(glm::vec3(5.5f, -1.85f, -18.5f));
 		camera.setRotation(glm::vec3(-17.2f, -4.7f, 0.0f));
 		camera.setPerspective(60.0f, (float)width / (float)height, 1.0f, 256.0f);
+		// Uniform buffers and command buffers are per frame, so the CPU can prepare the next frames while the GPU is still busy
+		maxFramesInFlight = 3;
 	}
 
 	~VulkanExample()
@@ -92,7 +98,9 @@ public:
 		vkFreeMemory(device, instanceBuffer.memory, nullptr);
 		textures.rocks.destroy();
 		textures.planet.destroy();
-		uniformBuffers.scene.destroy();
+		for (auto& frameUniformBuffers : uniformBuffers) {
+			frameUniformBuffers.scene.destroy();
+		}
 	}
 
 	// Enable physical device features required for this example
@@ -104,7 +112,8 @@ public:
 		}
 	};
 
-	void buildCommandBuffers()
+	// Records the current frame's command buffer, as the uniform buffer bound depends on the frame
+	void buildCommandBuffer()
 	{
 		VkCommandBufferBeginInfo cmdBufInfo = vks::initializers::commandBufferBeginInfo();
 
@@ -119,52 +128,52 @@ public:
 		renderPassBeginInfo.clearValueCount = 2;
 		renderPassBeginInfo.pClearValues = clearValues;
 
-		for (int32_t i = 0; i < drawCmdBuffers.size(); ++i)
-		{
-			// Set target frame buffer
-			renderPassBeginInfo.framebuffer = frameBuffers[i];
+		// Set target frame buffer
+		renderPassBeginInfo.framebuffer = frameBuffers[currentBuffer];
 
-			VK_CHECK_RESULT(vkBeginCommandBuffer(drawCmdBuffers[i], &cmdBufInfo));
+		VkCommandBuffer commandBuffer = frames[currentFrame].commandBuffer;
+		const DescriptorSets& frameDescriptorSets = descriptorSets[currentFrame];
 
-			vkCmdBeginRenderPass(drawCmdBuffers[i], &renderPassBeginInfo, VK_SUBPASS_CONTENTS_INLINE);
+		VK_CHECK_RESULT(vkBeginCommandBuffer(commandBuffer, &cmdBufInfo));
 
-			VkViewport viewport = vks::initializers::viewport((float)width, (float)height, 0.0f, 1.0f);
-			vkCmdSetViewport(drawCmdBuffers[i], 0, 1, &viewport);
+		vkCmdBeginRenderPass(commandBuffer, &renderPassBeginInfo, VK_SUBPASS_CONTENTS_INLINE);
 
-			VkRect2D scissor = vks::initializers::rect2D(width, height, 0, 0);
-			vkCmdSetScissor(drawCmdBuffers[i], 0, 1, &scissor);
+		VkViewport viewport = vks::initializers::viewport((float)width, (float)height, 0.0f, 1.0f);
+		vkCmdSetViewport(commandBuffer, 0, 1, &viewport);
 
-			VkDeviceSize offsets[1] = { 0 };
+		VkRect2D scissor = vks::initializers::rect2D(width, height, 0, 0);
+		vkCmdSetScissor(commandBuffer, 0, 1, &scissor);
 
-			// Star field
-			vkCmdBindDescriptorSets(drawCmdBuffers[i], VK_PIPELINE_BIND_POINT_GRAPHICS, pipelineLayout, 0, 1, &descriptorSets.planet, 0, NULL);
-			vkCmdBindPipeline(drawCmdBuffers[i], VK_PIPELINE_BIND_POINT_GRAPHICS, pipelines.starfield);
-			vkCmdDraw(drawCmdBuffers[i], 3, 1, 0, 0);
+		VkDeviceSize offsets[1] = { 0 };
 
-			// Planet
-			vkCmdBindDescriptorSets(drawCmdBuffers[i], VK_PIPELINE_BIND_POINT_GRAPHICS, pipelineLayout, 0, 1, &descriptorSets.planet, 0, NULL);
-			vkCmdBindPipeline(drawCmdBuffers[i], VK_PIPELINE_BIND_POINT_GRAPHICS, pipelines.planet);
-			models.planet.draw(drawCmdBuffers[i]);
+		// Star field
+		vkCmdBindDescriptorSets(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, pipelineLayout, 0, 1, &frameDescriptorSets.planet, 0, NULL);
+		vkCmdBindPipeline(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, pipelines.starfield);
+		vkCmdDraw(commandBuffer, 3, 1, 0, 0);
 
-			// Instanced rocks
-			vkCmdBindDescriptorSets(drawCmdBuffers[i], VK_PIPELINE_BIND_POINT_GRAPHICS, pipelineLayout, 0, 1, &descriptorSets.instancedRocks, 0, NULL);
-			vkCmdBindPipeline(drawCmdBuffers[i], VK_PIPELINE_BIND_POINT_GRAPHICS, pipelines.instancedRocks);
-			// Binding point 0 : Mesh vertex buffer
-			vkCmdBindVertexBuffers(drawCmdBuffers[i], VERTEX_BUFFER_BIND_ID, 1, &models.rock.vertices.buffer, offsets);
-			// Binding point 1 : Instance data buffer
-			vkCmdBindVertexBuffers(drawCmdBuffers[i], INSTANCE_BUFFER_BIND_ID, 1, &instanceBuffer.buffer, offsets);
-			// Bind index buffer
-			vkCmdBindIndexBuffer(drawCmdBuffers[i], models.rock.indices.buffer, 0, VK_INDEX_TYPE_UINT32);
+		// Planet
+		vkCmdBindDescriptorSets(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, pipelineLayout, 0, 1, &frameDescriptorSets.planet, 0, NULL);
+		vkCmdBindPipeline(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, pipelines.planet);
+		models.planet.draw(commandBuffer);
+
+		// Instanced rocks
+		vkCmdBindDescriptorSets(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, pipelineLayout, 0, 1, &frameDescriptorSets.instancedRocks, 0, NULL);
+		vkCmdBindPipeline(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, pipelines.instancedRocks);
+		// Binding point 0 : Mesh vertex buffer
+		vkCmdBindVertexBuffers(commandBuffer, VERTEX_BUFFER_BIND_ID, 1, &models.rock.vertices.buffer, offsets);
+		// Binding point 1 : Instance data buffer
+		vkCmdBindVertexBuffers(commandBuffer, INSTANCE_BUFFER_BIND_ID, 1, &instanceBuffer.buffer, offsets);
+		// Bind index buffer
+		vkCmdBindIndexBuffer(commandBuffer, models.rock.indices.buffer, 0, VK_INDEX_TYPE_UINT32);
 
-			// Render instances
-			vkCmdDrawIndexed(drawCmdBuffers[i], models.rock.indices.count, INSTANCE_COUNT, 0, 0, 0);
+		// Render instances
+		vkCmdDrawIndexed(commandBuffer, models.rock.indices.count, INSTANCE_COUNT, 0, 0, 0);
 
-			drawUI(drawCmdBuffers[i]);
+		drawUI(commandBuffer);
 
-			vkCmdEndRenderPass(drawCmdBuffers[i]);
+		vkCmdEndRenderPass(commandBuffer);
 
-			VK_CHECK_RESULT(vkEndCommandBuffer(drawCmdBuffers[i]));
-		}
+		VK_CHECK_RESULT(vkEndCommandBuffer(commandBuffer));
 	}
 
 	void loadAssets()
@@ -182,15 +191,15 @@ public:
 		// Example uses one ubo
 		std::vector<VkDescriptorPoolSize> poolSizes =
 		{
-			vks::initializers::descriptorPoolSize(VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER, 2),
-			vks::initializers::descriptorPoolSize(VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, 2),
+			vks::initializers::descriptorPoolSize(VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER, 2 * frames.size()),
+			vks::initializers::descriptorPoolSize(VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, 2 * frames.size()),
 		};
 
 		VkDescriptorPoolCreateInfo descriptorPoolInfo =
 			vks::initializers::descriptorPoolCreateInfo(
 				poolSizes.size(),
 				poolSizes.data(),
-				2);
+				2 * frames.size());
 
 		VK_CHECK_RESULT(vkCreateDescriptorPool(device, &descriptorPoolInfo, nullptr, &descriptorPool));
 	}
@@ -218,22 +227,24 @@ public:
 
 		descripotrSetAllocInfo = vks::initializers::descriptorSetAllocateInfo(descriptorPool, &descriptorSetLayout, 1);;
 
-		// Instanced rocks
-		VK_CHECK_RESULT(vkAllocateDescriptorSets(device, &descripotrSetAllocInfo, &descriptorSets.instancedRocks));
-		writeDescriptorSets = {
-			vks::initializers::writeDescriptorSet(descriptorSets.instancedRocks, VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER,	0, &uniformBuffers.scene.descriptor),	// Binding 0 : Vertex shader uniform buffer
-			vks::initializers::writeDescriptorSet(descriptorSets.instancedRocks, VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, 1, &textures.rocks.descriptor)	// Binding 1 : Color map
-		};
-		vkUpdateDescriptorSets(device, writeDescriptorSets.size(), writeDescriptorSets.data(), 0, NULL);
-
-		// Planet
-		VK_CHECK_RESULT(vkAllocateDescriptorSets(device, &descripotrSetAllocInfo, &descriptorSets.planet));
-		writeDescriptorSets = {
-			vks::initializers::writeDescriptorSet(descriptorSets.planet, VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER,	0, &uniformBuffers.scene.descriptor),			// Binding 0 : Vertex shader uniform buffer
-			vks::initializers::writeDescriptorSet(descriptorSets.planet, VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, 1, &textures.planet.descriptor)			// Binding 1 : Color map
-		};
-		vkUpdateDescriptorSets(device, writeDescriptorSets.size(), writeDescriptorSets.data(), 0, NULL);
+		descriptorSets.resize(frames.size());
+		for (size_t i = 0; i < frames.size(); i++) {
+			// Instanced rocks
+			VK_CHECK_RESULT(vkAllocateDescriptorSets(device, &descripotrSetAllocInfo, &descriptorSets[i].instancedRocks));
+			writeDescriptorSets = {
+				vks::initializers::writeDescriptorSet(descriptorSets[i].instancedRocks, VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER,	0, &uniformBuffers[i].scene.descriptor),	// Binding 0 : Vertex shader uniform buffer
+				vks::initializers::writeDescriptorSet(descriptorSets[i].instancedRocks, VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, 1, &textures.rocks.descriptor)	// Binding 1 : Color map
+			};
+			vkUpdateDescriptorSets(device, writeDescriptorSets.size(), writeDescriptorSets.data(), 0, NULL);
 
+			// Planet
+			VK_CHECK_RESULT(vkAllocateDescriptorSets(device, &descripotrSetAllocInfo, &descriptorSets[i].planet));
+			writeDescriptorSets = {
+				vks::initializers::writeDescriptorSet(descriptorSets[i].planet, VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER,	0, &uniformBuffers[i].scene.descriptor),			// Binding 0 : Vertex shader uniform buffer
+				vks::initializers::writeDescriptorSet(descriptorSets[i].planet, VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, 1, &textures.planet.descriptor)			// Binding 1 : Color map
+			};
+			vkUpdateDescriptorSets(device, writeDescriptorSets.size(), writeDescriptorSets.data(), 0, NULL);
+		}
 	}
 
 	void preparePipelines()
@@ -412,25 +423,24 @@ public:
 
 	void prepareUniformBuffers()
 	{
-		VK_CHECK_RESULT(vulkanDevice->createBuffer(
-			VK_BUFFER_USAGE_UNIFORM_BUFFER_BIT,
-			VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
-			&uniformBuffers.scene,
-			sizeof(uboVS)));
-
-		// Map persistent
-		VK_CHECK_RESULT(uniformBuffers.scene.map());
-
-		updateUniformBuffer(true);
+		uniformBuffers.resize(frames.size());
+		for (auto& frameUniformBuffers : uniformBuffers) {
+			VK_CHECK_RESULT(vulkanDevice->createBuffer(
+				VK_BUFFER_USAGE_UNIFORM_BUFFER_BIT,
+				VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
+				&frameUniformBuffers.scene,
+				sizeof(uboVS)));
+
+			// Map persistent
+			VK_CHECK_RESULT(frameUniformBuffers.scene.map());
+		}
 	}
 
-	void updateUniformBuffer(bool viewChanged)
+	// Updates the current frame's uniform buffer, must be called after prepareFrame so the GPU is no longer reading it
+	void updateUniformBuffer()
 	{
-		if (viewChanged)
-		{
-			uboVS.projection = camera.matrices.perspective;
-			uboVS.view = camera.matrices.view;
-		}
+		uboVS.projection = camera.matrices.perspective;
+		uboVS.view = camera.matrices.view;
 
 		if (!paused)
 		{
@@ -438,16 +448,19 @@ public:
 			uboVS.globSpeed += frameTimer * 0.01f;
 		}
 
-		memcpy(uniformBuffers.scene.mapped, &uboVS, sizeof(uboVS));
+		memcpy(uniformBuffers[currentFrame].scene.mapped, &uboVS, sizeof(uboVS));
 	}
 
 	void draw()
 	{
 		VulkanExampleBase::prepareFrame();
 
+		updateUniformBuffer();
+		buildCommandBuffer();
+
 		// Command buffer to be sumitted to the queue
 		submitInfo.commandBufferCount = 1;
-		submitInfo.pCommandBuffers = &drawCmdBuffers[currentBuffer];
+		submitInfo.pCommandBuffers = &frames[currentFrame].commandBuffer;
 
 		// Submit to queue
 		VK_CHECK_RESULT(vkQueueSubmit(queue, 1, &submitInfo, VK_NULL_HANDLE));
@@ -465,7 +478,6 @@ public:
 		preparePipelines();
 		setupDescriptorPool();
 		setupDescriptorSet();
-		buildCommandBuffers();
 		prepared = true;
 	}
 
@@ -476,15 +488,6 @@ public:
 			return;
 		}
 		draw();
-		if ((!paused) || (camera.updated))
-		{			
-			updateUniformBuffer(camera.updated);
-		}
-	}
-
-	virtual void viewChanged()
-	{
-		updateUniformBuffer(true);
 	}
 
 	virtual void OnUpdateUIOverlay(vks::UIOverlay *overlay)
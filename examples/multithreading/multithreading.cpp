@@ -8,7 +8,7 @@
 
 #include "vulkanexamplebase.h"
 
-#include "threadpool.hpp"
+#include "jobsystem.hpp"
 #include "frustum.hpp"
 
 #include "VulkanglTFModel.h"
@@ -38,17 +38,20 @@ public:
 
 	VkPipelineLayout pipelineLayout;
 
-	VkCommandBuffer primaryCommandBuffer;
-
 	// Secondary scene command buffers used to store backdrop and user interface
 	struct SecondaryCommandBuffers {
 		VkCommandBuffer background;
 		VkCommandBuffer ui;
-	} secondaryCommandBuffers;
+	};
+	// One set per frame in flight, as the buffers of the previous frames may still be executed
+	std::vector<SecondaryCommandBuffers> secondaryCommandBuffers;
 
 	// Number of animated objects to be renderer
 	// by using threads and secondary command buffers
-	uint32_t numObjectsPerThread;
+	// The objects are split into many small groups that the job system balances across the threads
+	const uint32_t numObjects = 512;
+	const uint32_t numObjectsPerGroup = 16;
+	uint32_t numGroups;
 
 	// Multi threaded stuff
 	// Max. number of concurrent threads
@@ -73,22 +76,17 @@ public:
 		bool visible = true;
 	};
 
-	struct ThreadData {
+	// A group is recorded by a single job at a time, so it can own its command pool
+	struct ObjectGroup {
 		VkCommandPool commandPool;
-		// One command buffer per render object
+		// One command buffer per render object and frame in flight
 		std::vector<VkCommandBuffer> commandBuffer;
 		// One push constant block per render object
 		std::vector<ThreadPushConstantBlock> pushConstBlock;
 		// Per object information (position, rotation, etc.)
 		std::vector<ObjectData> objectData;
 	};
-	std::vector<ThreadData> threadData;
-
-	vks::ThreadPool threadPool;
-
-	// Fence to wait for all command buffers to finish before
-	// presenting to the swap chain
-	VkFence renderFence = {};
+	std::vector<ObjectGroup> objectGroups;
 
 	// View frustum for culling invisible objects
 	vks::Frustum frustum;
@@ -103,6 +101,8 @@ public:
 		camera.setRotation(glm::vec3(0.0f));
 		camera.setRotationSpeed(0.5f);
 		camera.setPerspective(60.0f, (float)width / (float)height, 0.1f, 256.0f);
+		// All per-frame data is either recorded into command buffers or passed as push constants, so the CPU can record the next frames while the GPU is still busy
+		maxFramesInFlight = 3;
 		// Get number of max. concurrent threads
 		numThreads = std::thread::hardware_concurrency();
 		assert(numThreads > 0);
@@ -111,8 +111,7 @@ public:
 #else
 		std::cout << "numThreads = " << numThreads << std::endl;
 #endif
-		threadPool.setThreadCount(numThreads);
-		numObjectsPerThread = 512 / numThreads;
+		numGroups = numObjects / numObjectsPerGroup;
 		rndEngine.seed(benchmark.active ? 0 : (unsigned)time(nullptr));
 	}
 
@@ -125,12 +124,10 @@ public:
 
 		vkDestroyPipelineLayout(device, pipelineLayout, nullptr);
 
-		for (auto& thread : threadData) {
-			vkFreeCommandBuffers(device, thread.commandPool, thread.commandBuffer.size(), thread.commandBuffer.data());
-			vkDestroyCommandPool(device, thread.commandPool, nullptr);
+		for (auto& group : objectGroups) {
+			vkFreeCommandBuffers(device, group.commandPool, group.commandBuffer.size(), group.commandBuffer.data());
+			vkDestroyCommandPool(device, group.commandPool, nullptr);
 		}
-
-		vkDestroyFence(device, renderFence, nullptr);
 	}
 
 	float rnd(float range)
@@ -144,69 +141,70 @@ public:
 	{
 		// Since this demo updates the command buffers on each frame
 		// we don't use the per-framebuffer command buffers from the
-		// base class, and create a single primary command buffer instead
+		// base class, but the primary command buffers of the frames in flight
+
+		// Create additional secondary CBs for background and ui
 		VkCommandBufferAllocateInfo cmdBufAllocateInfo =
 			vks::initializers::commandBufferAllocateInfo(
 				cmdPool,
-				VK_COMMAND_BUFFER_LEVEL_PRIMARY,
+				VK_COMMAND_BUFFER_LEVEL_SECONDARY,
 				1);
-		VK_CHECK_RESULT(vkAllocateCommandBuffers(device, &cmdBufAllocateInfo, &primaryCommandBuffer));
-
-		// Create additional secondary CBs for background and ui
-		cmdBufAllocateInfo.level = VK_COMMAND_BUFFER_LEVEL_SECONDARY;
-		VK_CHECK_RESULT(vkAllocateCommandBuffers(device, &cmdBufAllocateInfo, &secondaryCommandBuffers.background));
-		VK_CHECK_RESULT(vkAllocateCommandBuffers(device, &cmdBufAllocateInfo, &secondaryCommandBuffers.ui));
+		secondaryCommandBuffers.resize(frames.size());
+		for (auto& secondary : secondaryCommandBuffers) {
+			VK_CHECK_RESULT(vkAllocateCommandBuffers(device, &cmdBufAllocateInfo, &secondary.background));
+			VK_CHECK_RESULT(vkAllocateCommandBuffers(device, &cmdBufAllocateInfo, &secondary.ui));
+		}
 
-		threadData.resize(numThreads);
+		objectGroups.resize(numGroups);
 
-		float maxX = std::floor(std::sqrt(numThreads * numObjectsPerThread));
+		float maxX = std::floor(std::sqrt(numObjects));
 		uint32_t posX = 0;
 		uint32_t posZ = 0;
 
-		for (uint32_t i = 0; i < numThreads; i++) {
-			ThreadData *thread = &threadData[i];
+		for (uint32_t i = 0; i < numGroups; i++) {
+			ObjectGroup *group = &objectGroups[i];
 
-			// Create one command pool for each thread
+			// Create one command pool for each group
 			VkCommandPoolCreateInfo cmdPoolInfo = vks::initializers::commandPoolCreateInfo();
 			cmdPoolInfo.queueFamilyIndex = swapChain.queueNodeIndex;
 			cmdPoolInfo.flags = VK_COMMAND_POOL_CREATE_RESET_COMMAND_BUFFER_BIT;
-			VK_CHECK_RESULT(vkCreateCommandPool(device, &cmdPoolInfo, nullptr, &thread->commandPool));
+			VK_CHECK_RESULT(vkCreateCommandPool(device, &cmdPoolInfo, nullptr, &group->commandPool));
 
-			// One secondary command buffer per object that is updated by this thread
-			thread->commandBuffer.resize(numObjectsPerThread);
-			// Generate secondary command buffers for each thread
+			// One secondary command buffer per object of the group, for each frame in flight
+			group->commandBuffer.resize(numObjectsPerGroup * frames.size());
+			// Generate secondary command buffers for each group
 			VkCommandBufferAllocateInfo secondaryCmdBufAllocateInfo =
 				vks::initializers::commandBufferAllocateInfo(
-					thread->commandPool,
+					group->commandPool,
 					VK_COMMAND_BUFFER_LEVEL_SECONDARY,
-					thread->commandBuffer.size());
-			VK_CHECK_RESULT(vkAllocateCommandBuffers(device, &secondaryCmdBufAllocateInfo, thread->commandBuffer.data()));
+					group->commandBuffer.size());
+			VK_CHECK_RESULT(vkAllocateCommandBuffers(device, &secondaryCmdBufAllocateInfo, group->commandBuffer.data()));
 
-			thread->pushConstBlock.resize(numObjectsPerThread);
-			thread->objectData.resize(numObjectsPerThread);
+			group->pushConstBlock.resize(numObjectsPerGroup);
+			group->objectData.resize(numObjectsPerGroup);
 
-			for (uint32_t j = 0; j < numObjectsPerThread; j++) {
+			for (uint32_t j = 0; j < numObjectsPerGroup; j++) {
 				float theta = 2.0f * float(M_PI) * rnd(1.0f);
 				float phi = acos(1.0f - 2.0f * rnd(1.0f));
-				thread->objectData[j].pos = glm::vec3(sin(phi) * cos(theta), 0.0f, cos(phi)) * 35.0f;
+				group->objectData[j].pos = glm::vec3(sin(phi) * cos(theta), 0.0f, cos(phi)) * 35.0f;
 
-				thread->objectData[j].rotation = glm::vec3(0.0f, rnd(360.0f), 0.0f);
-				thread->objectData[j].deltaT = rnd(1.0f);
-				thread->objectData[j].rotationDir = (rnd(100.0f) < 50.0f) ? 1.0f : -1.0f;
-				thread->objectData[j].rotationSpeed = (2.0f + rnd(4.0f)) * thread->objectData[j].rotationDir;
-				thread->objectData[j].scale = 0.75f + rnd(0.5f);
+				group->objectData[j].rotation = glm::vec3(0.0f, rnd(360.0f), 0.0f);
+				group->objectData[j].deltaT = rnd(1.0f);
+				group->objectData[j].rotationDir = (rnd(100.0f) < 50.0f) ? 1.0f : -1.0f;
+				group->objectData[j].rotationSpeed = (2.0f + rnd(4.0f)) * group->objectData[j].rotationDir;
+				group->objectData[j].scale = 0.75f + rnd(0.5f);
 
-				thread->pushConstBlock[j].color = glm::vec3(rnd(1.0f), rnd(1.0f), rnd(1.0f));
+				group->pushConstBlock[j].color = glm::vec3(rnd(1.0f), rnd(1.0f), rnd(1.0f));
 			}
 		}
 
 	}
 
-	// Builds the secondary command buffer for each thread
-	void threadRenderCode(uint32_t threadIndex, uint32_t cmdBufferIndex, VkCommandBufferInheritanceInfo inheritanceInfo)
+	// Builds the secondary command buffer for an object of a group
+	void threadRenderCode(uint32_t groupIndex, uint32_t cmdBufferIndex, VkCommandBufferInheritanceInfo inheritanceInfo)
 	{
-		ThreadData *thread = &threadData[threadIndex];
-		ObjectData *objectData = &thread->objectData[cmdBufferIndex];
+		ObjectGroup *group = &objectGroups[groupIndex];
+		ObjectData *objectData = &group->objectData[cmdBufferIndex];
 
 		// Check visibility against view frustum using a simple sphere check based on the radius of the mesh
 		objectData->visible = frustum.checkSphere(objectData->pos, models.ufo.dimensions.radius * 0.5f);
@@ -220,7 +218,7 @@ public:
 		commandBufferBeginInfo.flags = VK_COMMAND_BUFFER_USAGE_RENDER_PASS_CONTINUE_BIT;
 		commandBufferBeginInfo.pInheritanceInfo = &inheritanceInfo;
 
-		VkCommandBuffer cmdBuffer = thread->commandBuffer[cmdBufferIndex];
+		VkCommandBuffer cmdBuffer = group->commandBuffer[currentFrame * numObjectsPerGroup + cmdBufferIndex];
 
 		VK_CHECK_RESULT(vkBeginCommandBuffer(cmdBuffer, &commandBufferBeginInfo));
 
@@ -250,7 +248,7 @@ public:
 		objectData->model = glm::rotate(objectData->model, glm::radians(objectData->deltaT * 360.0f), glm::vec3(0.0f, objectData->rotationDir, 0.0f));
 		objectData->model = glm::scale(objectData->model, glm::vec3(objectData->scale));
 
-		thread->pushConstBlock[cmdBufferIndex].mvp = matrices.projection * matrices.view * objectData->model;
+		group->pushConstBlock[cmdBufferIndex].mvp = matrices.projection * matrices.view * objectData->model;
 
 		// Update shader push constant block
 		// Contains model view matrix
@@ -260,7 +258,7 @@ public:
 			VK_SHADER_STAGE_VERTEX_BIT,
 			0,
 			sizeof(ThreadPushConstantBlock),
-			&thread->pushConstBlock[cmdBufferIndex]);
+			&group->pushConstBlock[cmdBufferIndex]);
 
 		VkDeviceSize offsets[1] = { 0 };
 		vkCmdBindVertexBuffers(cmdBuffer, 0, 1, &models.ufo.vertices.buffer, offsets);
@@ -272,6 +270,8 @@ public:
 
 	void updateSecondaryCommandBuffers(VkCommandBufferInheritanceInfo inheritanceInfo)
 	{
+		const SecondaryCommandBuffers& secondary = secondaryCommandBuffers[currentFrame];
+
 		// Secondary command buffer for the sky sphere
 		VkCommandBufferBeginInfo commandBufferBeginInfo = vks::initializers::commandBufferBeginInfo();
 		commandBufferBeginInfo.flags = VK_COMMAND_BUFFER_USAGE_RENDER_PASS_CONTINUE_BIT;
@@ -284,28 +284,28 @@ public:
 			Background
 		*/
 
-		VK_CHECK_RESULT(vkBeginCommandBuffer(secondaryCommandBuffers.background, &commandBufferBeginInfo));
+		VK_CHECK_RESULT(vkBeginCommandBuffer(secondary.background, &commandBufferBeginInfo));
 
-		vkCmdSetViewport(secondaryCommandBuffers.background, 0, 1, &viewport);
-		vkCmdSetScissor(secondaryCommandBuffers.background, 0, 1, &scissor);
+		vkCmdSetViewport(secondary.background, 0, 1, &viewport);
+		vkCmdSetScissor(secondary.background, 0, 1, &scissor);
 
-		vkCmdBindPipeline(secondaryCommandBuffers.background, VK_PIPELINE_BIND_POINT_GRAPHICS, pipelines.starsphere);
+		vkCmdBindPipeline(secondary.background, VK_PIPELINE_BIND_POINT_GRAPHICS, pipelines.starsphere);
 
 		glm::mat4 mvp = matrices.projection * matrices.view;
 		mvp[3] = glm::vec4(0.0f, 0.0f, 0.0f, 1.0f);
 		mvp = glm::scale(mvp, glm::vec3(2.0f));
 
 		vkCmdPushConstants(
-			secondaryCommandBuffers.background,
+			secondary.background,
 			pipelineLayout,
 			VK_SHADER_STAGE_VERTEX_BIT,
 			0,
 			sizeof(mvp),
 			&mvp);
 
-		models.starSphere.draw(secondaryCommandBuffers.background);
+		models.starSphere.draw(secondary.background);
 		
-		VK_CHECK_RESULT(vkEndCommandBuffer(secondaryCommandBuffers.background));
+		VK_CHECK_RESULT(vkEndCommandBuffer(secondary.background));
 
 		/*
 			User interface
@@ -314,19 +314,19 @@ public:
 			by secondary command buffers, which also applies to the UI overlay command buffer
 		*/
 
-		VK_CHECK_RESULT(vkBeginCommandBuffer(secondaryCommandBuffers.ui, &commandBufferBeginInfo));
+		VK_CHECK_RESULT(vkBeginCommandBuffer(secondary.ui, &commandBufferBeginInfo));
 
-		vkCmdSetViewport(secondaryCommandBuffers.ui, 0, 1, &viewport);
-		vkCmdSetScissor(secondaryCommandBuffers.ui, 0, 1, &scissor);
+		vkCmdSetViewport(secondary.ui, 0, 1, &viewport);
+		vkCmdSetScissor(secondary.ui, 0, 1, &scissor);
 
-		vkCmdBindPipeline(secondaryCommandBuffers.ui, VK_PIPELINE_BIND_POINT_GRAPHICS, pipelines.starsphere);
+		vkCmdBindPipeline(secondary.ui, VK_PIPELINE_BIND_POINT_GRAPHICS, pipelines.starsphere);
 
-		drawUI(secondaryCommandBuffers.ui);
+		drawUI(secondary.ui);
 
-		VK_CHECK_RESULT(vkEndCommandBuffer(secondaryCommandBuffers.ui));
+		VK_CHECK_RESULT(vkEndCommandBuffer(secondary.ui));
 	}
 
-	// Updates the secondary command buffers using a thread pool
+	// Updates the secondary command buffers using the job system
 	// and puts them into the primary command buffer that's
 	// lat submitted to the queue for rendering
 	void updateCommandBuffers(VkFramebuffer frameBuffer)
@@ -334,6 +334,8 @@ public:
 		// Contains the list of secondary command buffers to be submitted
 		std::vector<VkCommandBuffer> commandBuffers;
 
+		VkCommandBuffer primaryCommandBuffer = frames[currentFrame].commandBuffer;
+
 		VkCommandBufferBeginInfo cmdBufInfo = vks::initializers::commandBufferBeginInfo();
 
 		VkClearValue clearValues[2];
@@ -368,35 +370,36 @@ public:
 		updateSecondaryCommandBuffers(inheritanceInfo);
 
 		if (displayStarSphere) {
-			commandBuffers.push_back(secondaryCommandBuffers.background);
+			commandBuffers.push_back(secondaryCommandBuffers[currentFrame].background);
 		}
 
-		// Add a job to the thread's queue for each object to be rendered
-		for (uint32_t t = 0; t < numThreads; t++)
-		{
-			for (uint32_t i = 0; i < numObjectsPerThread; i++)
+		// Distribute the object groups across the job system, there are many more groups than threads so idle workers can steal groups from busy ones
+		// Each job records a whole group, as the group's command pool must not be used from two threads at the same time
+		jobSystem.parallelFor(numGroups, 1, [&](uint32_t begin, uint32_t end) {
+			for (uint32_t t = begin; t < end; t++)
 			{
-				threadPool.threads[t]->addJob([=] { threadRenderCode(t, i, inheritanceInfo); });
+				for (uint32_t i = 0; i < numObjectsPerGroup; i++)
+				{
+					threadRenderCode(t, i, inheritanceInfo);
+				}
 			}
-		}
-
-		threadPool.wait();
+		});
 
 		// Only submit if object is within the current view frustum
-		for (uint32_t t = 0; t < numThreads; t++)
+		for (uint32_t t = 0; t < numGroups; t++)
 		{
-			for (uint32_t i = 0; i < numObjectsPerThread; i++)
+			for (uint32_t i = 0; i < numObjectsPerGroup; i++)
 			{
-				if (threadData[t].objectData[i].visible)
+				if (objectGroups[t].objectData[i].visible)
 				{
-					commandBuffers.push_back(threadData[t].commandBuffer[i]);
+					commandBuffers.push_back(objectGroups[t].commandBuffer[currentFrame * numObjectsPerGroup + i]);
 				}
 			}
 		}
 
 		// Render ui last
 		if (UIOverlay.visible) {
-			commandBuffers.push_back(secondaryCommandBuffers.ui);
+			commandBuffers.push_back(secondaryCommandBuffers[currentFrame].ui);
 		}
 
 		// Execute render commands from the secondary command buffer
@@ -480,22 +483,15 @@ public:
 
 	void draw()
 	{
-		// Wait for fence to signal that all command buffers are ready
-		VkResult fenceRes;
-		do {
-			fenceRes = vkWaitForFences(device, 1, &renderFence, VK_TRUE, 100000000);
-		} while (fenceRes == VK_TIMEOUT);
-		VK_CHECK_RESULT(fenceRes);
-		vkResetFences(device, 1, &renderFence);
-
+		// Waits for the GPU to finish the last frame that used the current frame's command buffers
 		VulkanExampleBase::prepareFrame();
 
 		updateCommandBuffers(frameBuffers[currentBuffer]);
 
 		submitInfo.commandBufferCount = 1;
-		submitInfo.pCommandBuffers = &primaryCommandBuffer;
+		submitInfo.pCommandBuffers = &frames[currentFrame].commandBuffer;
 
-		VK_CHECK_RESULT(vkQueueSubmit(queue, 1, &submitInfo, renderFence));
+		VK_CHECK_RESULT(vkQueueSubmit(queue, 1, &submitInfo, VK_NULL_HANDLE));
 
 		VulkanExampleBase::submitFrame();
 	}
@@ -503,9 +499,6 @@ public:
 	void prepare()
 	{
 		VulkanExampleBase::prepare();
-		// Create a fence for synchronization
-		VkFenceCreateInfo fenceCreateInfo = vks::initializers::fenceCreateInfo(VK_FENCE_CREATE_SIGNALED_BIT);
-		vkCreateFence(device, &fenceCreateInfo, nullptr, &renderFence);
 		loadAssets();
 		setupPipelineLayout();
 		preparePipelines();
@@ -534,6 +527,7 @@ public:
 	{
 		if (overlay->header("Statistics")) {
 			overlay->text("Active threads: %d", numThreads);
+			overlay->text("Object groups: %d", numGroups);
 		}
 		if (overlay->header("Settings")) {
 			overlay->checkBox("Stars", &displayStarSphere);
@@ -151,7 +151,10 @@ public:
 private:
 	void loadAssets()
 	{
-		const uint32_t glTFLoadingFlags = vkglTF::FileLoadingFlags::PreTransformVertices | vkglTF::FileLoadingFlags::FlipY;
+		// The shaders only read positions, which are stored quantized to 16 bits (see vkglTF::VertexFormat)
+		const uint32_t glTFLoadingFlags = vkglTF::FileLoadingFlags::PreTransformVertices | vkglTF::FileLoadingFlags::FlipY | vkglTF::FileLoadingFlags::PackVertices;
+		models.sphere.packedVertexComponents = { vkglTF::VertexComponent::Position };
+		models.cube.packedVertexComponents = { vkglTF::VertexComponent::Position };
 		models.sphere.loadFromFile(getAssetPath() + "models/sphere.gltf", vulkanDevice, queue, glTFLoadingFlags);
 		models.cube.loadFromFile(getAssetPath() + "models/cube.gltf", vulkanDevice, queue, glTFLoadingFlags);
 	}
@@ -396,7 +399,7 @@ private:
 		pipelineCI.pDynamicState = &dynamicState;
 		pipelineCI.stageCount = static_cast<uint32_t>(shaderStages.size());
 		pipelineCI.pStages = shaderStages.data();
-		pipelineCI.pVertexInputState = vkglTF::Vertex::getPipelineVertexInputState({ vkglTF::VertexComponent::Position });
+		pipelineCI.pVertexInputState = vkglTF::Vertex::getPipelineVertexInputState({ vkglTF::VertexComponent::Position }, vkglTF::VertexFormat::Packed);
 
 		shaderStages[0] = loadShader(getShadersPath() + "oit/geometry.vert.spv", VK_SHADER_STAGE_VERTEX_BIT);
 		shaderStages[1] = loadShader(getShadersPath() + "oit/geometry.frag.spv", VK_SHADER_STAGE_FRAGMENT_BIT);
@@ -586,7 +589,8 @@ private:
 					{
 						glm::mat4 T = glm::translate(glm::mat4(1.0f), glm::vec3(x - 2, y - 2, z - 2));
 						glm::mat4 S = glm::scale(glm::mat4(1.0f), glm::vec3(0.3f));
-						objectData.model = T * S;
+						// The dequantization scales the packed positions back to the model's bounds
+						objectData.model = T * S * models.sphere.vertexDequantization;
 						vkCmdPushConstants(drawCmdBuffers[i], pipelineLayouts.geometry, VK_SHADER_STAGE_VERTEX_BIT | VK_SHADER_STAGE_FRAGMENT_BIT, 0, sizeof(ObjectData), &objectData);
 						models.sphere.draw(drawCmdBuffers[i]);
 					}
@@ -599,7 +603,7 @@ private:
 			{
 				glm::mat4 T = glm::translate(glm::mat4(1.0f), glm::vec3(3.0f * x - 1.5f, 0.0f, 0.0f));
 				glm::mat4 S = glm::scale(glm::mat4(1.0f), glm::vec3(0.2f));
-				objectData.model = T * S;
+				objectData.model = T * S * models.cube.vertexDequantization;
 				vkCmdPushConstants(drawCmdBuffers[i], pipelineLayouts.geometry, VK_SHADER_STAGE_VERTEX_BIT | VK_SHADER_STAGE_FRAGMENT_BIT, 0, sizeof(ObjectData), &objectData);
 				models.cube.draw(drawCmdBuffers[i]);
 			}
@@ -1,6 +1,11 @@
 /*
 * Vulkan Example - CPU based fire particle system
 *
+* The simulation keeps flame and smoke particles in separate structure of arrays streams that are updated with SIMD
+* instructions on all cores using the job system (see base/particlesystem.hpp)
+* Every frame in flight has its own persistently mapped vertex buffer that only the live particles are written to, so
+* the CPU can simulate the next frame while the GPU is still drawing the previous ones
+*
 * Copyright (C) 2016 by Sascha Willems - www.saschawillems.de
 *
 * This code is licensed under the MIT license (MIT) (http://opensource.org/licenses/MIT)
@@ -8,28 +13,14 @@
 
 #include "vulkanexamplebase.h"
 #include "VulkanglTFModel.h"
+#include "jobsystem.hpp"
+#include "particlesystem.hpp"
 
 #define ENABLE_VALIDATION false
-#define PARTICLE_COUNT 512
 #define PARTICLE_SIZE 10.0f
 
 #define FLAME_RADIUS 8.0f
 
-#define PARTICLE_TYPE_FLAME 0
-#define PARTICLE_TYPE_SMOKE 1
-
-struct Particle {
-	glm::vec4 pos;
-	glm::vec4 color;
-	float alpha;
-	float size;
-	float rotation;
-	uint32_t type;
-	// Attributes not used in shader
-	glm::vec4 vel;
-	float rotationSpeed;
-};
-
 class VulkanExample : public VulkanExampleBase
 {
 public:
@@ -48,23 +39,24 @@ public:
 
 	vkglTF::Model environment;
 
-	glm::vec3 emitterPos = glm::vec3(0.0f, -FLAME_RADIUS + 2.0f, 0.0f);
-	glm::vec3 minVel = glm::vec3(-3.0f, 0.5f, -3.0f);
-	glm::vec3 maxVel = glm::vec3(3.0f, 7.0f, 3.0f);
-
-	struct {
-		VkBuffer buffer;
-		VkDeviceMemory memory;
-		// Store the mapped address of the particle data for reuse
-		void *mappedMemory;
-		// Size of the particle buffer in bytes
-		size_t size;
-	} particles;
-
-	struct {
-		vks::Buffer fire;
-		vks::Buffer environment;
-	} uniformBuffers;
+	vks::particles::FireSimulation fire;
+
+	// Particle counts selectable in the UI
+	const std::vector<uint32_t> particleCounts = { 512, 16 * 1024, 256 * 1024, 1024 * 1024 };
+	int32_t particleCountIndex = 0;
+
+	// Per frame resources, the CPU writes to the current frame's copies while the GPU may still read the other frames' copies
+	struct FrameResources {
+		// Persistently mapped, sized for the requested number of particles
+		vks::Buffer particles;
+		// Number of particles written to the vertex buffer for this frame
+		uint32_t particleCount = 0;
+		vks::Buffer fireUniformBuffer;
+		vks::Buffer environmentUniformBuffer;
+		VkDescriptorSet particleDescriptorSet;
+		VkDescriptorSet environmentDescriptorSet;
+	};
+	std::vector<FrameResources> frameResources;
 
 	struct UBOVS {
 		glm::mat4 projection;
@@ -88,15 +80,6 @@ public:
 	VkPipelineLayout pipelineLayout;
 	VkDescriptorSetLayout descriptorSetLayout;
 
-	struct {
-		VkDescriptorSet particles;
-		VkDescriptorSet environment;
-	} descriptorSets;
-
-	std::vector<Particle> particleBuffer;
-
-	std::default_random_engine rndEngine;
-
 	VulkanExample() : VulkanExampleBase(ENABLE_VALIDATION)
 	{
 		title = "CPU based particle system";
@@ -105,7 +88,10 @@ public:
 		camera.setRotation(glm::vec3(-15.0f, 45.0f, 0.0f));
 		camera.setPerspective(60.0f, (float)width / (float)height, 1.0f, 256.0f);
 		timerSpeed *= 8.0f;
-		rndEngine.seed(benchmark.active ? 0 : (unsigned)time(nullptr));
+		// Particle and uniform buffers are per frame, so the CPU can prepare the next frames while the GPU is still busy
+		maxFramesInFlight = 3;
+		fire.emitterPos = glm::vec3(0.0f, -FLAME_RADIUS + 2.0f, 0.0f);
+		fire.flameRadius = FLAME_RADIUS;
 	}
 
 	~VulkanExample()
@@ -124,12 +110,11 @@ public:
 		vkDestroyPipelineLayout(device, pipelineLayout, nullptr);
 		vkDestroyDescriptorSetLayout(device, descriptorSetLayout, nullptr);
 
-		vkUnmapMemory(device, particles.memory);
-		vkDestroyBuffer(device, particles.buffer, nullptr);
-		vkFreeMemory(device, particles.memory, nullptr);
-
-		uniformBuffers.environment.destroy();
-		uniformBuffers.fire.destroy();
+		for (auto& frame : frameResources) {
+			frame.particles.destroy();
+			frame.fireUniformBuffer.destroy();
+			frame.environmentUniformBuffer.destroy();
+		}
 
 		vkDestroySampler(device, textures.particles.sampler, nullptr);
 	}
@@ -142,7 +127,8 @@ public:
 		};
 	}
 
-	void buildCommandBuffers()
+	// Records the current frame's command buffer, as the particle buffer and the number of particles drawn change every frame
+	void buildCommandBuffer()
 	{
 		VkCommandBufferBeginInfo cmdBufInfo = vks::initializers::commandBufferBeginInfo();
 
@@ -159,150 +145,77 @@ public:
 		renderPassBeginInfo.clearValueCount = 2;
 		renderPassBeginInfo.pClearValues = clearValues;
 
-		for (int32_t i = 0; i < drawCmdBuffers.size(); ++i)
-		{
-			// Set target frame buffer
-			renderPassBeginInfo.framebuffer = frameBuffers[i];
-
-			VK_CHECK_RESULT(vkBeginCommandBuffer(drawCmdBuffers[i], &cmdBufInfo));
-
-			vkCmdBeginRenderPass(drawCmdBuffers[i], &renderPassBeginInfo, VK_SUBPASS_CONTENTS_INLINE);
+		// Set target frame buffer
+		renderPassBeginInfo.framebuffer = frameBuffers[currentBuffer];
 
-			VkViewport viewport = vks::initializers::viewport((float)width, (float)height, 0.0f, 1.0f);
-			vkCmdSetViewport(drawCmdBuffers[i], 0, 1, &viewport);
+		VkCommandBuffer commandBuffer = frames[currentFrame].commandBuffer;
+		const FrameResources& frame = frameResources[currentFrame];
 
-			VkRect2D scissor = vks::initializers::rect2D(width, height, 0,0);
-			vkCmdSetScissor(drawCmdBuffers[i], 0, 1, &scissor);
+		VK_CHECK_RESULT(vkBeginCommandBuffer(commandBuffer, &cmdBufInfo));
 
-			VkDeviceSize offsets[1] = { 0 };
+		vkCmdBeginRenderPass(commandBuffer, &renderPassBeginInfo, VK_SUBPASS_CONTENTS_INLINE);
 
-			// Environment
-			vkCmdBindDescriptorSets(drawCmdBuffers[i], VK_PIPELINE_BIND_POINT_GRAPHICS, pipelineLayout, 0, 1, &descriptorSets.environment, 0, nullptr);
-			vkCmdBindPipeline(drawCmdBuffers[i], VK_PIPELINE_BIND_POINT_GRAPHICS, pipelines.environment);
-			environment.draw(drawCmdBuffers[i]);
-
-			// Particle system (no index buffer)
-			vkCmdBindDescriptorSets(drawCmdBuffers[i], VK_PIPELINE_BIND_POINT_GRAPHICS, pipelineLayout, 0, 1, &descriptorSets.particles, 0, nullptr);
-			vkCmdBindPipeline(drawCmdBuffers[i], VK_PIPELINE_BIND_POINT_GRAPHICS, pipelines.particles);
-			vkCmdBindVertexBuffers(drawCmdBuffers[i], 0, 1, &particles.buffer, offsets);
-			vkCmdDraw(drawCmdBuffers[i], PARTICLE_COUNT, 1, 0, 0);
+		VkViewport viewport = vks::initializers::viewport((float)width, (float)height, 0.0f, 1.0f);
+		vkCmdSetViewport(commandBuffer, 0, 1, &viewport);
 
-			drawUI(drawCmdBuffers[i]);
+		VkRect2D scissor = vks::initializers::rect2D(width, height, 0,0);
+		vkCmdSetScissor(commandBuffer, 0, 1, &scissor);
 
-			vkCmdEndRenderPass(drawCmdBuffers[i]);
+		VkDeviceSize offsets[1] = { 0 };
 
-			VK_CHECK_RESULT(vkEndCommandBuffer(drawCmdBuffers[i]));
+		// Environment
+		vkCmdBindDescriptorSets(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, pipelineLayout, 0, 1, &frame.environmentDescriptorSet, 0, nullptr);
+		vkCmdBindPipeline(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, pipelines.environment);
+		environment.draw(commandBuffer);
+
+		// Particle system (no index buffer), only the live particles have been written to the buffer
+		if (frame.particleCount > 0) {
+			vkCmdBindDescriptorSets(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, pipelineLayout, 0, 1, &frame.particleDescriptorSet, 0, nullptr);
+			vkCmdBindPipeline(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, pipelines.particles);
+			vkCmdBindVertexBuffers(commandBuffer, 0, 1, &frame.particles.buffer, offsets);
+			vkCmdDraw(commandBuffer, frame.particleCount, 1, 0, 0);
 		}
-	}
 
-	float rnd(float range)
-	{
-		std::uniform_real_distribution<float> rndDist(0.0f, range);
-		return rndDist(rndEngine);
-	}
+		drawUI(commandBuffer);
 
-	void initParticle(Particle *particle, glm::vec3 emitterPos)
-	{
-		particle->vel = glm::vec4(0.0f, minVel.y + rnd(maxVel.y - minVel.y), 0.0f, 0.0f);
-		particle->alpha = rnd(0.75f);
-		particle->size = 1.0f + rnd(0.5f);
-		particle->color = glm::vec4(1.0f);
-		particle->type = PARTICLE_TYPE_FLAME;
-		particle->rotation = rnd(2.0f * float(M_PI));
-		particle->rotationSpeed = rnd(2.0f) - rnd(2.0f);
-
-		// Get random sphere point
-		float theta = rnd(2.0f * float(M_PI));
-		float phi = rnd(float(M_PI)) - float(M_PI) / 2.0f;
-		float r = rnd(FLAME_RADIUS);
-
-		particle->pos.x = r * cos(theta) * cos(phi);
-		particle->pos.y = r * sin(phi);
-		particle->pos.z = r * sin(theta) * cos(phi);
-
-		particle->pos += glm::vec4(emitterPos, 0.0f);
+		vkCmdEndRenderPass(commandBuffer);
+
+		VK_CHECK_RESULT(vkEndCommandBuffer(commandBuffer));
 	}
 
-	void transitionParticle(Particle *particle)
+	// (Re)creates the per frame particle vertex buffers for the given number of particles and restarts the simulation if needed
+	void setParticleCount(uint32_t particleCount)
 	{
-		switch (particle->type)
-		{
-		case PARTICLE_TYPE_FLAME:
-			// Flame particles have a chance of turning into smoke
-			if (rnd(1.0f) < 0.05f)
-			{
-				particle->alpha = 0.0f;
-				particle->color = glm::vec4(0.25f + rnd(0.25f));
-				particle->pos.x *= 0.5f;
-				particle->pos.z *= 0.5f;
-				particle->vel = glm::vec4(rnd(1.0f) - rnd(1.0f), (minVel.y * 2) + rnd(maxVel.y - minVel.y), rnd(1.0f) - rnd(1.0f), 0.0f);
-				particle->size = 1.0f + rnd(0.5f);
-				particle->rotationSpeed = rnd(1.0f) - rnd(1.0f);
-				particle->type = PARTICLE_TYPE_SMOKE;
-			}
-			else
-			{
-				initParticle(particle, emitterPos);
-			}
-			break;
-		case PARTICLE_TYPE_SMOKE:
-			// Respawn at end of life
-			initParticle(particle, emitterPos);
-			break;
+		// The GPU may still read from the buffers of the frames in flight
+		vkDeviceWaitIdle(device);
+		fire.setParticleCount(particleCount, benchmark.active ? 0 : (uint32_t)time(nullptr));
+		for (auto& frame : frameResources) {
+			frame.particles.destroy();
+			VK_CHECK_RESULT(vulkanDevice->createBuffer(
+				VK_BUFFER_USAGE_VERTEX_BUFFER_BIT,
+				VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
+				&frame.particles,
+				particleCount * sizeof(vks::particles::ParticleVertex)));
+			// Map persistent
+			VK_CHECK_RESULT(frame.particles.map());
+			frame.particleCount = 0;
 		}
 	}
 
 	void prepareParticles()
 	{
-		particleBuffer.resize(PARTICLE_COUNT);
-		for (auto& particle : particleBuffer)
-		{
-			initParticle(&particle, emitterPos);
-			particle.alpha = 1.0f - (abs(particle.pos.y) / (FLAME_RADIUS * 2.0f));
-		}
-
-		particles.size = particleBuffer.size() * sizeof(Particle);
-
-		VK_CHECK_RESULT(vulkanDevice->createBuffer(
-			VK_BUFFER_USAGE_VERTEX_BUFFER_BIT,
-			VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
-			particles.size,
-			&particles.buffer,
-			&particles.memory,
-			particleBuffer.data()));
-
-		// Map the memory and store the pointer for reuse
-		VK_CHECK_RESULT(vkMapMemory(device, particles.memory, 0, particles.size, 0, &particles.mappedMemory));
+		frameResources.resize(frames.size());
+		setParticleCount(particleCounts[particleCountIndex]);
 	}
 
+	// Advances the simulation and writes the live particles to the current frame's vertex buffer, must be called after prepareFrame
 	void updateParticles()
 	{
-		float particleTimer = frameTimer * 0.45f;
-		for (auto& particle : particleBuffer)
-		{
-			switch (particle.type)
-			{
-			case PARTICLE_TYPE_FLAME:
-				particle.pos.y -= particle.vel.y * particleTimer * 3.5f;
-				particle.alpha += particleTimer * 2.5f;
-				particle.size -= particleTimer * 0.5f;
-				break;
-			case PARTICLE_TYPE_SMOKE:
-				particle.pos -= particle.vel * frameTimer * 1.0f;
-				particle.alpha += particleTimer * 1.25f;
-				particle.size += particleTimer * 0.125f;
-				particle.color -= particleTimer * 0.05f;
-				break;
-			}
-			particle.rotation += particleTimer * particle.rotationSpeed;
-			// Transition particle state
-			if (particle.alpha > 2.0f)
-			{
-				transitionParticle(&particle);
-			}
+		if (!paused) {
+			fire.update(frameTimer, &jobSystem);
 		}
-		size_t size = particleBuffer.size() * sizeof(Particle);
-		memcpy(particles.mappedMemory, particleBuffer.data(), size);
+		FrameResources& frame = frameResources[currentFrame];
+		frame.particleCount = fire.writeVertices(static_cast<vks::particles::ParticleVertex*>(frame.particles.mapped), &jobSystem);
 	}
 
 	void loadAssets()
@@ -348,11 +261,12 @@ public:
 
 	void setupDescriptorPool()
 	{
+		const uint32_t frameCount = static_cast<uint32_t>(frameResources.size());
 		std::vector<VkDescriptorPoolSize> poolSizes = {
-			vks::initializers::descriptorPoolSize(VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER, 2),
-			vks::initializers::descriptorPoolSize(VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, 4)
+			vks::initializers::descriptorPoolSize(VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER, 2 * frameCount),
+			vks::initializers::descriptorPoolSize(VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, 4 * frameCount)
 		};
-		VkDescriptorPoolCreateInfo descriptorPoolInfo = vks::initializers::descriptorPoolCreateInfo(poolSizes, 2);
+		VkDescriptorPoolCreateInfo descriptorPoolInfo = vks::initializers::descriptorPoolCreateInfo(poolSizes, 2 * frameCount);
 		VK_CHECK_RESULT(vkCreateDescriptorPool(device, &descriptorPoolInfo, nullptr, &descriptorPool));
 	}
 
@@ -376,12 +290,8 @@ public:
 
 	void setupDescriptorSets()
 	{
-		std::vector<VkWriteDescriptorSet> writeDescriptorSets;
-
 		VkDescriptorSetAllocateInfo allocInfo = vks::initializers::descriptorSetAllocateInfo(descriptorPool, &descriptorSetLayout, 1);
 
-		VK_CHECK_RESULT(vkAllocateDescriptorSets(device, &allocInfo, &descriptorSets.particles));
-
 		// Image descriptor for the color map texture
 		VkDescriptorImageInfo texDescriptorSmoke =
 			vks::initializers::descriptorImageInfo(
@@ -394,28 +304,31 @@ public:
 				textures.particles.fire.view,
 				VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL);
 
-		writeDescriptorSets = {
-			// Binding 0: Vertex shader uniform buffer
-			vks::initializers::writeDescriptorSet(descriptorSets.particles, VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER, 0, &uniformBuffers.fire.descriptor),
-			// Binding 1: Smoke texture
-			vks::initializers::writeDescriptorSet(descriptorSets.particles, VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, 1, &texDescriptorSmoke),
-			// Binding 1: Fire texture array
-			vks::initializers::writeDescriptorSet(descriptorSets.particles, VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, 2, &texDescriptorFire)
-		};
-		vkUpdateDescriptorSets(device, writeDescriptorSets.size(), writeDescriptorSets.data(), 0, NULL);
+		// Each frame uses its own uniform buffers
+		for (auto& frame : frameResources) {
+			VK_CHECK_RESULT(vkAllocateDescriptorSets(device, &allocInfo, &frame.particleDescriptorSet));
+			std::vector<VkWriteDescriptorSet> writeDescriptorSets = {
+				// Binding 0: Vertex shader uniform buffer
+				vks::initializers::writeDescriptorSet(frame.particleDescriptorSet, VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER, 0, &frame.fireUniformBuffer.descriptor),
+				// Binding 1: Smoke texture
+				vks::initializers::writeDescriptorSet(frame.particleDescriptorSet, VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, 1, &texDescriptorSmoke),
+				// Binding 1: Fire texture array
+				vks::initializers::writeDescriptorSet(frame.particleDescriptorSet, VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, 2, &texDescriptorFire)
+			};
+			vkUpdateDescriptorSets(device, static_cast<uint32_t>(writeDescriptorSets.size()), writeDescriptorSets.data(), 0, NULL);
 
-		// Environment
-		VK_CHECK_RESULT(vkAllocateDescriptorSets(device, &allocInfo, &descriptorSets.environment));
-
-		writeDescriptorSets = {
-			// Binding 0: Vertex shader uniform buffer
-			vks::initializers::writeDescriptorSet(descriptorSets.environment, VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER, 0, &uniformBuffers.environment.descriptor),
-			// Binding 1: Color map
-			vks::initializers::writeDescriptorSet(descriptorSets.environment, VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, 1, &textures.floor.colorMap.descriptor),
-			// Binding 2: Normal map
-			vks::initializers::writeDescriptorSet(descriptorSets.environment, VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, 2, &textures.floor.normalMap.descriptor),
-		};
-		vkUpdateDescriptorSets(device, writeDescriptorSets.size(), writeDescriptorSets.data(), 0, NULL);
+			// Environment
+			VK_CHECK_RESULT(vkAllocateDescriptorSets(device, &allocInfo, &frame.environmentDescriptorSet));
+			writeDescriptorSets = {
+				// Binding 0: Vertex shader uniform buffer
+				vks::initializers::writeDescriptorSet(frame.environmentDescriptorSet, VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER, 0, &frame.environmentUniformBuffer.descriptor),
+				// Binding 1: Color map
+				vks::initializers::writeDescriptorSet(frame.environmentDescriptorSet, VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, 1, &textures.floor.colorMap.descriptor),
+				// Binding 2: Normal map
+				vks::initializers::writeDescriptorSet(frame.environmentDescriptorSet, VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, 2, &textures.floor.normalMap.descriptor),
+			};
+			vkUpdateDescriptorSets(device, static_cast<uint32_t>(writeDescriptorSets.size()), writeDescriptorSets.data(), 0, NULL);
+		}
 	}
 
 	void preparePipelines()
@@ -446,15 +359,16 @@ public:
 		{
 			// Vertex input state
 			VkVertexInputBindingDescription vertexInputBinding =
-				vks::initializers::vertexInputBindingDescription(0, sizeof(Particle), VK_VERTEX_INPUT_RATE_VERTEX);
+				vks::initializers::vertexInputBindingDescription(0, sizeof(vks::particles::ParticleVertex), VK_VERTEX_INPUT_RATE_VERTEX);
 
+			// The shader's vec4 inputs are filled up with w = 1 for the position and come from a normalized RGBA8 value for the color
 			std::vector<VkVertexInputAttributeDescription> vertexInputAttributes = {
-				vks::initializers::vertexInputAttributeDescription(0, 0, VK_FORMAT_R32G32B32A32_SFLOAT,	offsetof(Particle, pos)),	// Location 0: Position
-				vks::initializers::vertexInputAttributeDescription(0, 1, VK_FORMAT_R32G32B32A32_SFLOAT,	offsetof(Particle, color)),	// Location 1: Color
-				vks::initializers::vertexInputAttributeDescription(0, 2, VK_FORMAT_R32_SFLOAT, offsetof(Particle, alpha)),			// Location 2: Alpha
-				vks::initializers::vertexInputAttributeDescription(0, 3, VK_FORMAT_R32_SFLOAT, offsetof(Particle, size)),			// Location 3: Size
-				vks::initializers::vertexInputAttributeDescription(0, 4, VK_FORMAT_R32_SFLOAT, offsetof(Particle, rotation)),		// Location 4: Rotation
-				vks::initializers::vertexInputAttributeDescription(0, 5, VK_FORMAT_R32_SINT, offsetof(Particle, type)),				// Location 5: Particle type
+				vks::initializers::vertexInputAttributeDescription(0, 0, VK_FORMAT_R32G32B32_SFLOAT, offsetof(vks::particles::ParticleVertex, pos)),	// Location 0: Position
+				vks::initializers::vertexInputAttributeDescription(0, 1, VK_FORMAT_R8G8B8A8_UNORM, offsetof(vks::particles::ParticleVertex, color)),	// Location 1: Color
+				vks::initializers::vertexInputAttributeDescription(0, 2, VK_FORMAT_R32_SFLOAT, offsetof(vks::particles::ParticleVertex, alpha)),		// Location 2: Alpha
+				vks::initializers::vertexInputAttributeDescription(0, 3, VK_FORMAT_R32_SFLOAT, offsetof(vks::particles::ParticleVertex, size)),			// Location 3: Size
+				vks::initializers::vertexInputAttributeDescription(0, 4, VK_FORMAT_R32_SFLOAT, offsetof(vks::particles::ParticleVertex, rotation)),	// Location 4: Rotation
+				vks::initializers::vertexInputAttributeDescription(0, 5, VK_FORMAT_R32_SINT, offsetof(vks::particles::ParticleVertex, type)),			// Location 5: Particle type
 			};
 
 			VkPipelineVertexInputStateCreateInfo vertexInputState = vks::initializers::pipelineVertexInputStateCreateInfo();
@@ -501,58 +415,59 @@ public:
 	// Prepare and initialize uniform buffer containing shader uniforms
 	void prepareUniformBuffers()
 	{
-		// Vertex shader uniform buffer block
-		VK_CHECK_RESULT(vulkanDevice->createBuffer(
-			VK_BUFFER_USAGE_UNIFORM_BUFFER_BIT,
-			VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
-			&uniformBuffers.fire,
-			sizeof(uboVS)));
-
-		// Vertex shader uniform buffer block
-		VK_CHECK_RESULT(vulkanDevice->createBuffer(
-			VK_BUFFER_USAGE_UNIFORM_BUFFER_BIT,
-			VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
-			&uniformBuffers.environment,
-			sizeof(uboEnv)));
-
-		// Map persistent
-		VK_CHECK_RESULT(uniformBuffers.fire.map());
-		VK_CHECK_RESULT(uniformBuffers.environment.map());
-
-		updateUniformBuffers();
-	}
-
-	void updateUniformBufferLight()
-	{
-		// Environment
-		uboEnv.lightPos.x = sin(timer * 2.0f * float(M_PI)) * 1.5f;
-		uboEnv.lightPos.y = 0.0f;
-		uboEnv.lightPos.z = cos(timer * 2.0f * float(M_PI)) * 1.5f;
-		memcpy(uniformBuffers.environment.mapped, &uboEnv, sizeof(uboEnv));
+		for (auto& frame : frameResources) {
+			// Vertex shader uniform buffer block
+			VK_CHECK_RESULT(vulkanDevice->createBuffer(
+				VK_BUFFER_USAGE_UNIFORM_BUFFER_BIT,
+				VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
+				&frame.fireUniformBuffer,
+				sizeof(uboVS)));
+
+			// Vertex shader uniform buffer block
+			VK_CHECK_RESULT(vulkanDevice->createBuffer(
+				VK_BUFFER_USAGE_UNIFORM_BUFFER_BIT,
+				VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
+				&frame.environmentUniformBuffer,
+				sizeof(uboEnv)));
+
+			// Map persistent
+			VK_CHECK_RESULT(frame.fireUniformBuffer.map());
+			VK_CHECK_RESULT(frame.environmentUniformBuffer.map());
+		}
 	}
 
+	// Updates the current frame's uniform buffers, must be called after prepareFrame so the GPU is no longer reading them
 	void updateUniformBuffers()
 	{
 		// Particle system fire
 		uboVS.projection = camera.matrices.perspective;
 		uboVS.modelView = camera.matrices.view;
 		uboVS.viewportDim = glm::vec2((float)width, (float)height);
-		memcpy(uniformBuffers.fire.mapped, &uboVS, sizeof(uboVS));
+		memcpy(frameResources[currentFrame].fireUniformBuffer.mapped, &uboVS, sizeof(uboVS));
 
 		// Environment
 		uboEnv.projection = camera.matrices.perspective;
 		uboEnv.modelView = camera.matrices.view;
 		uboEnv.normal = glm::inverseTranspose(uboEnv.modelView);
-		memcpy(uniformBuffers.environment.mapped, &uboEnv, sizeof(uboEnv));
+		if (!paused) {
+			uboEnv.lightPos.x = sin(timer * 2.0f * float(M_PI)) * 1.5f;
+			uboEnv.lightPos.y = 0.0f;
+			uboEnv.lightPos.z = cos(timer * 2.0f * float(M_PI)) * 1.5f;
+		}
+		memcpy(frameResources[currentFrame].environmentUniformBuffer.mapped, &uboEnv, sizeof(uboEnv));
 	}
 
 	void draw()
 	{
 		VulkanExampleBase::prepareFrame();
 
+		updateUniformBuffers();
+		updateParticles();
+		buildCommandBuffer();
+
 		// Command buffer to be submitted to the queue
 		submitInfo.commandBufferCount = 1;
-		submitInfo.pCommandBuffers = &drawCmdBuffers[currentBuffer];
+		submitInfo.pCommandBuffers = &frames[currentFrame].commandBuffer;
 
 		// Submit to queue
 		VK_CHECK_RESULT(vkQueueSubmit(queue, 1, &submitInfo, VK_NULL_HANDLE));
@@ -570,7 +485,6 @@ public:
 		preparePipelines();
 		setupDescriptorPool();
 		setupDescriptorSets();
-		buildCommandBuffers();
 		prepared = true;
 	}
 
@@ -579,20 +493,24 @@ public:
 		if (!prepared)
 			return;
 		draw();
-		if (!paused)
-		{
-			updateUniformBufferLight();
-			updateParticles();
-		}
-		if (camera.updated)
-		{
-			updateUniformBuffers();
-		}
 	}
 
-	virtual void viewChanged()
+	virtual void OnUpdateUIOverlay(vks::UIOverlay *overlay)
 	{
-		updateUniformBuffers();
+		if (overlay->header("Settings")) {
+			std::vector<std::string> items;
+			for (uint32_t count : particleCounts) {
+				items.push_back(std::to_string(count));
+			}
+			if (overlay->comboBox("Particles", &particleCountIndex, items)) {
+				setParticleCount(particleCounts[particleCountIndex]);
+			}
+		}
+		if (overlay->header("Statistics")) {
+			overlay->text("Flames: %d", fire.getFlameCount());
+			overlay->text("Smoke: %d", fire.getSmokeCount());
+			overlay->text("Worker threads: %d", jobSystem.threadCount());
+		}
 	}
 };
 
@@ -2,6 +2,7 @@
 * Vulkan Example - Hardware accelerated ray tracing callable shaders example
 *
 * Dynamically calls different shaders based on the geometry id in the closest hit shader
+* The instance sways by refitting the top level acceleration structure every frame
 *
 * Relevant code parts are marked with [POI]
 *
@@ -17,6 +18,10 @@ class VulkanExample : public VulkanRaytracingSample
 public:
 	AccelerationStructure bottomLevelAS;
 	AccelerationStructure topLevelAS;
+	// The top level acceleration structure is refitted to the animated instance transform every frame, so its build input is kept
+	// Each command buffer refits from its own instance buffer, so the transform for the next frame can be written while other command buffers are still executing
+	std::vector<AccelerationStructureBuild> topLevelASBuilds;
+	std::vector<vks::Buffer> instancesBuffers;
 
 	std::vector<VkRayTracingShaderGroupCreateInfoKHR> shaderGroups{};
 	struct ShaderBindingTables {
@@ -64,6 +69,9 @@ public:
 			deleteStorageImage();
 			deleteAccelerationStructure(bottomLevelAS);
 			deleteAccelerationStructure(topLevelAS);
+			for (auto& instancesBuffer : instancesBuffers) {
+				instancesBuffer.destroy();
+			}
 			shaderBindingTables.raygen.destroy();
 			shaderBindingTables.miss.destroy();
 			shaderBindingTables.hit.destroy();
@@ -139,7 +147,6 @@ public:
 		uint32_t numTriangles = 1;
 
 		// Our scene will consist of three different triangles, that'll be distinguished in the shader via gl_GeometryIndexEXT, so we add three geometries to the bottom level AS
-		std::vector<uint32_t> geometryCounts;
 		std::vector<VkAccelerationStructureGeometryKHR> accelerationStructureGeometries;
 		for (uint32_t i = 0; i < objectCount; i++) {
 			VkAccelerationStructureGeometryKHR accelerationStructureGeometry = vks::initializers::accelerationStructureGeometryKHR();
@@ -154,38 +161,8 @@ public:
 			accelerationStructureGeometry.geometry.triangles.indexData = indexBufferDeviceAddress;
 			accelerationStructureGeometry.geometry.triangles.transformData = transformBufferDeviceAddress;
 			accelerationStructureGeometries.push_back(accelerationStructureGeometry);
-			geometryCounts.push_back(1);
 		}
 
-		// Get size info
-		VkAccelerationStructureBuildGeometryInfoKHR accelerationStructureBuildGeometryInfo = vks::initializers::accelerationStructureBuildGeometryInfoKHR();
-		accelerationStructureBuildGeometryInfo.type = VK_ACCELERATION_STRUCTURE_TYPE_BOTTOM_LEVEL_KHR;
-		accelerationStructureBuildGeometryInfo.flags = VK_BUILD_ACCELERATION_STRUCTURE_PREFER_FAST_TRACE_BIT_KHR;
-		accelerationStructureBuildGeometryInfo.geometryCount = static_cast<uint32_t>(accelerationStructureGeometries.size());
-		accelerationStructureBuildGeometryInfo.pGeometries = accelerationStructureGeometries.data();
-
-		VkAccelerationStructureBuildSizesInfoKHR accelerationStructureBuildSizesInfo = vks::initializers::accelerationStructureBuildSizesInfoKHR();
-		vkGetAccelerationStructureBuildSizesKHR(
-			device,
-			VK_ACCELERATION_STRUCTURE_BUILD_TYPE_DEVICE_KHR,
-			&accelerationStructureBuildGeometryInfo,
-			geometryCounts.data(),
-			&accelerationStructureBuildSizesInfo);
-
-		createAccelerationStructure(bottomLevelAS, VK_ACCELERATION_STRUCTURE_TYPE_BOTTOM_LEVEL_KHR, accelerationStructureBuildSizesInfo);
-
-		// Create a small scratch buffer used during build of the bottom level acceleration structure
-		ScratchBuffer scratchBuffer = createScratchBuffer(accelerationStructureBuildSizesInfo.buildScratchSize);
-
-		VkAccelerationStructureBuildGeometryInfoKHR accelerationBuildGeometryInfo = vks::initializers::accelerationStructureBuildGeometryInfoKHR();
-		accelerationBuildGeometryInfo.type = VK_ACCELERATION_STRUCTURE_TYPE_BOTTOM_LEVEL_KHR;
-		accelerationBuildGeometryInfo.flags = VK_BUILD_ACCELERATION_STRUCTURE_PREFER_FAST_TRACE_BIT_KHR;
-		accelerationBuildGeometryInfo.mode = VK_BUILD_ACCELERATION_STRUCTURE_MODE_BUILD_KHR;
-		accelerationBuildGeometryInfo.dstAccelerationStructure = bottomLevelAS.handle;
-		accelerationBuildGeometryInfo.geometryCount = static_cast<uint32_t>(accelerationStructureGeometries.size());
-		accelerationBuildGeometryInfo.pGeometries = accelerationStructureGeometries.data();
-		accelerationBuildGeometryInfo.scratchData.deviceAddress = scratchBuffer.deviceAddress;
-
 		// [POI] The bottom level acceleration structure for this sample contains three separate triangle geometries, so we can use gl_GeometryIndexEXT in the closest hit shader to select different callable shaders
 		std::vector<VkAccelerationStructureBuildRangeInfoKHR> accelerationStructureBuildRangeInfos{};
 		for (uint32_t i = 0; i < objectCount; i++) {
@@ -196,19 +173,17 @@ public:
 			accelerationStructureBuildRangeInfo.transformOffset = i * sizeof(VkTransformMatrixKHR);
 			accelerationStructureBuildRangeInfos.push_back(accelerationStructureBuildRangeInfo);
 		}
-		std::vector<VkAccelerationStructureBuildRangeInfoKHR*> accelerationBuildStructureRangeInfos = { &accelerationStructureBuildRangeInfos[0], &accelerationStructureBuildRangeInfos[1], &accelerationStructureBuildRangeInfos[2] };
-
-		// Build the acceleration structure on the device via a one-time command buffer submission
-		// Some implementations may support acceleration structure building on the host (VkPhysicalDeviceAccelerationStructureFeaturesKHR->accelerationStructureHostCommands), but we prefer device builds
-		VkCommandBuffer commandBuffer = vulkanDevice->createCommandBuffer(VK_COMMAND_BUFFER_LEVEL_PRIMARY, true);
-		vkCmdBuildAccelerationStructuresKHR(
-			commandBuffer,
-			1,
-			&accelerationBuildGeometryInfo,
-			accelerationBuildStructureRangeInfos.data());
-		vulkanDevice->flushCommandBuffer(commandBuffer, queue);
-
-		deleteScratchBuffer(scratchBuffer);
+
+		AccelerationStructureBuild accelerationStructureBuild{};
+		accelerationStructureBuild.accelerationStructure = &bottomLevelAS;
+		accelerationStructureBuild.type = VK_ACCELERATION_STRUCTURE_TYPE_BOTTOM_LEVEL_KHR;
+		accelerationStructureBuild.geometries = accelerationStructureGeometries;
+		accelerationStructureBuild.buildRanges = accelerationStructureBuildRangeInfos;
+		std::vector<AccelerationStructureBuild> accelerationStructureBuilds = { accelerationStructureBuild };
+
+		// Build the acceleration structure on the device using the batched builder of the base class
+		// It shares pooled scratch memory between all builds and compacts the acceleration structure afterwards
+		buildAccelerationStructures(accelerationStructureBuilds, true);
 	}
 
 	/*
@@ -229,75 +204,65 @@ public:
 		instance.flags = VK_GEOMETRY_INSTANCE_TRIANGLE_FACING_CULL_DISABLE_BIT_KHR;
 		instance.accelerationStructureReference = bottomLevelAS.deviceAddress;
 
-		// Buffer for instance data
-		vks::Buffer instancesBuffer;
-		VK_CHECK_RESULT(vulkanDevice->createBuffer(
-			VK_BUFFER_USAGE_SHADER_DEVICE_ADDRESS_BIT | VK_BUFFER_USAGE_ACCELERATION_STRUCTURE_BUILD_INPUT_READ_ONLY_BIT_KHR,
-			VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
-			&instancesBuffer,
-			sizeof(VkAccelerationStructureInstanceKHR),
-			&instance));
-
-		VkDeviceOrHostAddressConstKHR instanceDataDeviceAddress{};
-		instanceDataDeviceAddress.deviceAddress = getBufferDeviceAddress(instancesBuffer.buffer);
-
-		VkAccelerationStructureGeometryKHR accelerationStructureGeometry = vks::initializers::accelerationStructureGeometryKHR();
-		accelerationStructureGeometry.geometryType = VK_GEOMETRY_TYPE_INSTANCES_KHR;
-		accelerationStructureGeometry.flags = VK_GEOMETRY_OPAQUE_BIT_KHR;
-		accelerationStructureGeometry.geometry.instances.sType = VK_STRUCTURE_TYPE_ACCELERATION_STRUCTURE_GEOMETRY_INSTANCES_DATA_KHR;
-		accelerationStructureGeometry.geometry.instances.arrayOfPointers = VK_FALSE;
-		accelerationStructureGeometry.geometry.instances.data = instanceDataDeviceAddress;
-
-		// Get size info
-		VkAccelerationStructureBuildGeometryInfoKHR accelerationStructureBuildGeometryInfo = vks::initializers::accelerationStructureBuildGeometryInfoKHR();
-		accelerationStructureBuildGeometryInfo.type = VK_ACCELERATION_STRUCTURE_TYPE_TOP_LEVEL_KHR;
-		accelerationStructureBuildGeometryInfo.flags = VK_BUILD_ACCELERATION_STRUCTURE_PREFER_FAST_TRACE_BIT_KHR;
-		accelerationStructureBuildGeometryInfo.geometryCount = 1;
-		accelerationStructureBuildGeometryInfo.pGeometries = &accelerationStructureGeometry;
-
-		uint32_t primitive_count = 1;
-
-		VkAccelerationStructureBuildSizesInfoKHR accelerationStructureBuildSizesInfo = vks::initializers::accelerationStructureBuildSizesInfoKHR();
-		vkGetAccelerationStructureBuildSizesKHR(
-			device,
-			VK_ACCELERATION_STRUCTURE_BUILD_TYPE_DEVICE_KHR,
-			&accelerationStructureBuildGeometryInfo,
-			&primitive_count,
-			&accelerationStructureBuildSizesInfo);
-
-		createAccelerationStructure(topLevelAS, VK_ACCELERATION_STRUCTURE_TYPE_TOP_LEVEL_KHR, accelerationStructureBuildSizesInfo);
-
-		// Create a small scratch buffer used during build of the top level acceleration structure
-		ScratchBuffer scratchBuffer = createScratchBuffer(accelerationStructureBuildSizesInfo.buildScratchSize);
-
-		VkAccelerationStructureBuildGeometryInfoKHR accelerationBuildGeometryInfo = vks::initializers::accelerationStructureBuildGeometryInfoKHR();
-		accelerationBuildGeometryInfo.type = VK_ACCELERATION_STRUCTURE_TYPE_TOP_LEVEL_KHR;
-		accelerationBuildGeometryInfo.flags = VK_BUILD_ACCELERATION_STRUCTURE_PREFER_FAST_TRACE_BIT_KHR;
-		accelerationBuildGeometryInfo.mode = VK_BUILD_ACCELERATION_STRUCTURE_MODE_BUILD_KHR;
-		accelerationBuildGeometryInfo.dstAccelerationStructure = topLevelAS.handle;
-		accelerationBuildGeometryInfo.geometryCount = 1;
-		accelerationBuildGeometryInfo.pGeometries = &accelerationStructureGeometry;
-		accelerationBuildGeometryInfo.scratchData.deviceAddress = scratchBuffer.deviceAddress;
-
-		VkAccelerationStructureBuildRangeInfoKHR accelerationStructureBuildRangeInfo{};
-		accelerationStructureBuildRangeInfo.primitiveCount = 1;
-		accelerationStructureBuildRangeInfo.primitiveOffset = 0;
-		accelerationStructureBuildRangeInfo.firstVertex = 0;
-		accelerationStructureBuildRangeInfo.transformOffset = 0;
-		std::vector<VkAccelerationStructureBuildRangeInfoKHR*> accelerationBuildStructureRangeInfos = { &accelerationStructureBuildRangeInfo };
-
-		// Build the acceleration structure on the device via a one-time command buffer submission
-		// Some implementations may support acceleration structure building on the host (VkPhysicalDeviceAccelerationStructureFeaturesKHR->accelerationStructureHostCommands), but we prefer device builds
-		VkCommandBuffer commandBuffer = vulkanDevice->createCommandBuffer(VK_COMMAND_BUFFER_LEVEL_PRIMARY, true);
-		vkCmdBuildAccelerationStructuresKHR(
-			commandBuffer,
-			1,
-			&accelerationBuildGeometryInfo,
-			accelerationBuildStructureRangeInfos.data());
-		vulkanDevice->flushCommandBuffer(commandBuffer, queue);
-
-		deleteScratchBuffer(scratchBuffer);
-		instancesBuffer.destroy();
+		// Buffers for instance data, one per command buffer, kept mapped to animate the instance transform
+		instancesBuffers.resize(drawCmdBuffers.size());
+		topLevelASBuilds.resize(drawCmdBuffers.size());
+		for (size_t i = 0; i < drawCmdBuffers.size(); i++) {
+			VK_CHECK_RESULT(vulkanDevice->createBuffer(
+				VK_BUFFER_USAGE_SHADER_DEVICE_ADDRESS_BIT | VK_BUFFER_USAGE_ACCELERATION_STRUCTURE_BUILD_INPUT_READ_ONLY_BIT_KHR,
+				VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
+				&instancesBuffers[i],
+				sizeof(VkAccelerationStructureInstanceKHR),
+				&instance));
+			VK_CHECK_RESULT(instancesBuffers[i].map());
+
+			VkDeviceOrHostAddressConstKHR instanceDataDeviceAddress{};
+			instanceDataDeviceAddress.deviceAddress = getBufferDeviceAddress(instancesBuffers[i].buffer);
+
+			VkAccelerationStructureGeometryKHR accelerationStructureGeometry = vks::initializers::accelerationStructureGeometryKHR();
+			accelerationStructureGeometry.geometryType = VK_GEOMETRY_TYPE_INSTANCES_KHR;
+			accelerationStructureGeometry.flags = VK_GEOMETRY_OPAQUE_BIT_KHR;
+			accelerationStructureGeometry.geometry.instances.sType = VK_STRUCTURE_TYPE_ACCELERATION_STRUCTURE_GEOMETRY_INSTANCES_DATA_KHR;
+			accelerationStructureGeometry.geometry.instances.arrayOfPointers = VK_FALSE;
+			accelerationStructureGeometry.geometry.instances.data = instanceDataDeviceAddress;
+
+			VkAccelerationStructureBuildRangeInfoKHR accelerationStructureBuildRangeInfo{};
+			accelerationStructureBuildRangeInfo.primitiveCount = 1;
+			accelerationStructureBuildRangeInfo.primitiveOffset = 0;
+			accelerationStructureBuildRangeInfo.firstVertex = 0;
+			accelerationStructureBuildRangeInfo.transformOffset = 0;
+
+			AccelerationStructureBuild& topLevelASBuild = topLevelASBuilds[i];
+			topLevelASBuild.accelerationStructure = &topLevelAS;
+			topLevelASBuild.type = VK_ACCELERATION_STRUCTURE_TYPE_TOP_LEVEL_KHR;
+			// [POI] Allow updates, so the structure can be refitted to the changed instance transform instead of being rebuilt
+			topLevelASBuild.flags = VK_BUILD_ACCELERATION_STRUCTURE_PREFER_FAST_TRACE_BIT_KHR | VK_BUILD_ACCELERATION_STRUCTURE_ALLOW_UPDATE_BIT_KHR;
+			topLevelASBuild.geometries = { accelerationStructureGeometry };
+			topLevelASBuild.buildRanges = { accelerationStructureBuildRangeInfo };
+		}
+
+		// The structure is built once from the first instance buffer, all of them hold the same initial transform
+		std::vector<AccelerationStructureBuild> accelerationStructureBuilds = { topLevelASBuilds[0] };
+
+		// Top level acceleration structures are small and may be rebuilt often, so they are not compacted
+		// This also keeps the handle the updates refit in place
+		buildAccelerationStructures(accelerationStructureBuilds, false);
+		for (auto& topLevelASBuild : topLevelASBuilds) {
+			topLevelASBuild.buildSizes = accelerationStructureBuilds[0].buildSizes;
+		}
+	}
+
+	// Sways the instance around the y axis, the new transform is picked up by the update recorded into the command buffer
+	// Must only be called once the command buffer's previous submission has finished (i.e. after prepareFrame)
+	void updateInstanceTransform(uint32_t commandBufferIndex)
+	{
+		const float angle = glm::radians(sin(glm::radians(timer * 360.0f)) * 30.0f);
+		VkTransformMatrixKHR transformMatrix = {
+			cos(angle), 0.0f, sin(angle), 0.0f,
+			0.0f, 1.0f, 0.0f, 0.0f,
+			-sin(angle), 0.0f, cos(angle), 0.0f };
+		VkAccelerationStructureInstanceKHR* instance = static_cast<VkAccelerationStructureInstanceKHR*>(instancesBuffers[commandBufferIndex].mapped);
+		instance->transform = transformMatrix;
 	}
 
 	/*
@@ -521,6 +486,13 @@ public:
 		{
 			VK_CHECK_RESULT(vkBeginCommandBuffer(drawCmdBuffers[i], &cmdBufInfo));
 
+			/*
+				[POI] Refit the top level acceleration structure to the current instance transform
+				The command buffers are only recorded once, the update reads the command buffer's instance buffer when it is executed
+			*/
+			std::vector<AccelerationStructureBuild> accelerationStructureUpdates = { topLevelASBuilds[i] };
+			updateAccelerationStructures(drawCmdBuffers[i], accelerationStructureUpdates);
+
 			/*
 				Dispatch the ray tracing commands
 			*/
@@ -631,6 +603,8 @@ public:
 	void draw()
 	{
 		VulkanExampleBase::prepareFrame();
+		// The previous submission of this command buffer has finished, so its instance buffer can be written
+		updateInstanceTransform(currentBuffer);
 		submitInfo.commandBufferCount = 1;
 		submitInfo.pCommandBuffers = &drawCmdBuffers[currentBuffer];
 		VK_CHECK_RESULT(vkQueueSubmit(queue, 1, &submitInfo, VK_NULL_HANDLE));
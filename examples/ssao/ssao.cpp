@@ -176,6 +176,8 @@ public:
 	void getEnabledFeatures()
 	{
 		enabledFeatures.samplerAnisotropy = deviceFeatures.samplerAnisotropy;
+		// Pipeline statistics are shown by the GPU profiler if supported
+		enabledFeatures.pipelineStatisticsQuery = deviceFeatures.pipelineStatisticsQuery;
 	}
 
 	// Create a frame buffer attachment
@@ -497,6 +499,7 @@ public:
 		for (int32_t i = 0; i < drawCmdBuffers.size(); ++i)
 		{
 			VK_CHECK_RESULT(vkBeginCommandBuffer(drawCmdBuffers[i], &cmdBufInfo));
+			gpuProfiler.beginFrame(drawCmdBuffers[i], i);
 
 			/*
 				Offscreen SSAO generation
@@ -521,6 +524,7 @@ public:
 					First pass: Fill G-Buffer components (positions+depth, normals, albedo) using MRT
 				*/
 
+				gpuProfiler.beginScope(drawCmdBuffers[i], "G-Buffer");
 				vkCmdBeginRenderPass(drawCmdBuffers[i], &renderPassBeginInfo, VK_SUBPASS_CONTENTS_INLINE);
 
 				VkViewport viewport = vks::initializers::viewport((float)frameBuffers.offscreen.width, (float)frameBuffers.offscreen.height, 0.0f, 1.0f);
@@ -535,6 +539,7 @@ public:
 				scene.draw(drawCmdBuffers[i], vkglTF::RenderFlags::BindImages, pipelineLayouts.gBuffer);
 
 				vkCmdEndRenderPass(drawCmdBuffers[i]);
+				gpuProfiler.endScope(drawCmdBuffers[i]);
 
 				/*
 					Second pass: SSAO generation
@@ -550,6 +555,7 @@ public:
 				renderPassBeginInfo.clearValueCount = 2;
 				renderPassBeginInfo.pClearValues = clearValues.data();
 
+				gpuProfiler.beginScope(drawCmdBuffers[i], "SSAO");
 				vkCmdBeginRenderPass(drawCmdBuffers[i], &renderPassBeginInfo, VK_SUBPASS_CONTENTS_INLINE);
 
 				viewport = vks::initializers::viewport((float)frameBuffers.ssao.width, (float)frameBuffers.ssao.height, 0.0f, 1.0f);
@@ -562,6 +568,7 @@ public:
 				vkCmdDraw(drawCmdBuffers[i], 3, 1, 0, 0);
 
 				vkCmdEndRenderPass(drawCmdBuffers[i]);
+				gpuProfiler.endScope(drawCmdBuffers[i]);
 
 				/*
 					Third pass: SSAO blur
@@ -572,6 +579,7 @@ public:
 				renderPassBeginInfo.renderArea.extent.width = frameBuffers.ssaoBlur.width;
 				renderPassBeginInfo.renderArea.extent.height = frameBuffers.ssaoBlur.height;
 
+				gpuProfiler.beginScope(drawCmdBuffers[i], "SSAO blur");
 				vkCmdBeginRenderPass(drawCmdBuffers[i], &renderPassBeginInfo, VK_SUBPASS_CONTENTS_INLINE);
 
 				viewport = vks::initializers::viewport((float)frameBuffers.ssaoBlur.width, (float)frameBuffers.ssaoBlur.height, 0.0f, 1.0f);
@@ -584,6 +592,7 @@ public:
 				vkCmdDraw(drawCmdBuffers[i], 3, 1, 0, 0);
 
 				vkCmdEndRenderPass(drawCmdBuffers[i]);
+				gpuProfiler.endScope(drawCmdBuffers[i]);
 			}
 
 			/*
@@ -606,6 +615,7 @@ public:
 				renderPassBeginInfo.clearValueCount = 2;
 				renderPassBeginInfo.pClearValues = clearValues.data();
 
+				gpuProfiler.beginScope(drawCmdBuffers[i], "Composition");
 				vkCmdBeginRenderPass(drawCmdBuffers[i], &renderPassBeginInfo, VK_SUBPASS_CONTENTS_INLINE);
 
 				VkViewport viewport = vks::initializers::viewport((float)width, (float)height, 0.0f, 1.0f);
@@ -623,6 +633,7 @@ public:
 				drawUI(drawCmdBuffers[i]);
 
 				vkCmdEndRenderPass(drawCmdBuffers[i]);
+				gpuProfiler.endScope(drawCmdBuffers[i]);
 			}
 
 			VK_CHECK_RESULT(vkEndCommandBuffer(drawCmdBuffers[i]));
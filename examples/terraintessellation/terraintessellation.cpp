@@ -9,6 +9,7 @@
 #include "vulkanexamplebase.h"
 #include "VulkanglTFModel.h"
 #include "frustum.hpp"
+#include "tiledterrain.hpp"
 #include <ktx.h>
 #include <ktxvulkan.h>
 
@@ -19,6 +20,10 @@ class VulkanExample : public VulkanExampleBase
 public:
 	bool wireframe = false;
 	bool tessellation = true;
+	// Draws the terrain from streamed tiles selected on the CPU instead of the tessellated patch grid
+	bool streaming = false;
+	bool streamingAvailable = false;
+	float maxPixelError = 2.0f;
 
 	// Holds the buffers for rendering the tessellated terrain
 	struct {
@@ -33,6 +38,26 @@ public:
 		} indices;
 	} terrain;
 
+	// Tile pyramid built from the height map, covering the same area as the tessellated terrain
+	const uint32_t tileSize = 64;
+	const uint32_t tileLevelCount = 6;
+	vks::terrain::ChunkedTerrain chunkedTerrain;
+
+	// Per frame memory the CPU writes to while streaming
+	struct ChunkFrame {
+		vks::Buffer staging;
+		vks::Buffer ringIndices;
+		std::vector<vks::terrain::ChunkedTerrain::TileUpload> uploads;
+		std::vector<uint32_t> drawSlots;
+	};
+
+	struct {
+		// One slot per cached tile
+		vks::Buffer vertices;
+		vks::Buffer interiorIndices;
+		std::vector<ChunkFrame> frames;
+	} chunks;
+
 	struct {
 		vks::Texture2D heightMap;
 		vks::Texture2D skySphere;
@@ -45,6 +70,7 @@ public:
 
 	struct {
 		vks::Buffer terrainTessellation;
+		vks::Buffer terrainChunks;
 		vks::Buffer skysphereVertex;
 	} uniformBuffers;
 
@@ -59,7 +85,7 @@ public:
 		glm::vec2 viewportDim;
 		// Desired size of tessellated quad patch edge
 		float tessellatedEdgeSize = 20.0f;
-	} uboTess;
+	} uboTess, uboChunks;
 
 	// Skysphere vertex shader stage
 	struct {
@@ -69,6 +95,8 @@ public:
 	struct Pipelines {
 		VkPipeline terrain;
 		VkPipeline wireframe = VK_NULL_HANDLE;
+		VkPipeline chunks;
+		VkPipeline chunksWireframe = VK_NULL_HANDLE;
 		VkPipeline skysphere;
 	} pipelines;
 
@@ -84,6 +112,7 @@ public:
 
 	struct {
 		VkDescriptorSet terrain;
+		VkDescriptorSet chunks;
 		VkDescriptorSet skysphere;
 	} descriptorSets;
 
@@ -116,6 +145,10 @@ public:
 		if (pipelines.wireframe != VK_NULL_HANDLE) {
 			vkDestroyPipeline(device, pipelines.wireframe, nullptr);
 		}
+		vkDestroyPipeline(device, pipelines.chunks, nullptr);
+		if (pipelines.chunksWireframe != VK_NULL_HANDLE) {
+			vkDestroyPipeline(device, pipelines.chunksWireframe, nullptr);
+		}
 		vkDestroyPipeline(device, pipelines.skysphere, nullptr);
 
 		vkDestroyPipelineLayout(device, pipelineLayouts.skysphere, nullptr);
@@ -126,6 +159,7 @@ public:
 
 		uniformBuffers.skysphereVertex.destroy();
 		uniformBuffers.terrainTessellation.destroy();
+		uniformBuffers.terrainChunks.destroy();
 
 		textures.heightMap.destroy();
 		textures.skySphere.destroy();
@@ -136,6 +170,14 @@ public:
 		vkDestroyBuffer(device, terrain.indices.buffer, nullptr);
 		vkFreeMemory(device, terrain.indices.memory, nullptr);
 
+		chunkedTerrain.close();
+		chunks.vertices.destroy();
+		chunks.interiorIndices.destroy();
+		for (auto& frame : chunks.frames) {
+			frame.staging.destroy();
+			frame.ringIndices.destroy();
+		}
+
 		if (queryPool != VK_NULL_HANDLE) {
 			vkDestroyQueryPool(device, queryPool, nullptr);
 			vkDestroyBuffer(device, queryResult.buffer, nullptr);
@@ -276,7 +318,8 @@ public:
 		textures.terrainArray.descriptor.sampler = textures.terrainArray.sampler;
 	}
 
-	void buildCommandBuffers()
+	// Records the current frame's command buffer, as the streamed tiles and their uploads change every frame
+	void buildCommandBuffer()
 	{
 		VkCommandBufferBeginInfo cmdBufInfo = vks::initializers::commandBufferBeginInfo();
 
@@ -292,55 +335,109 @@ public:
 		renderPassBeginInfo.renderArea.extent.height = height;
 		renderPassBeginInfo.clearValueCount = 2;
 		renderPassBeginInfo.pClearValues = clearValues;
+		renderPassBeginInfo.framebuffer = frameBuffers[currentBuffer];
 
-		for (int32_t i = 0; i < drawCmdBuffers.size(); ++i)
-		{
-			renderPassBeginInfo.framebuffer = frameBuffers[i];
+		VkCommandBuffer commandBuffer = frames[currentFrame].commandBuffer;
 
-			VK_CHECK_RESULT(vkBeginCommandBuffer(drawCmdBuffers[i], &cmdBufInfo));
+		VK_CHECK_RESULT(vkBeginCommandBuffer(commandBuffer, &cmdBufInfo));
 
-			if (deviceFeatures.pipelineStatisticsQuery) {
-				vkCmdResetQueryPool(drawCmdBuffers[i], queryPool, 0, 2);
-			}
+		if (streaming) {
+			recordTileUploads(commandBuffer);
+		}
 
-			vkCmdBeginRenderPass(drawCmdBuffers[i], &renderPassBeginInfo, VK_SUBPASS_CONTENTS_INLINE);
+		if (deviceFeatures.pipelineStatisticsQuery) {
+			vkCmdResetQueryPool(commandBuffer, queryPool, 0, 2);
+		}
 
-			VkViewport viewport = vks::initializers::viewport((float)width, (float)height, 0.0f, 1.0f);
-			vkCmdSetViewport(drawCmdBuffers[i], 0, 1, &viewport);
+		vkCmdBeginRenderPass(commandBuffer, &renderPassBeginInfo, VK_SUBPASS_CONTENTS_INLINE);
 
-			VkRect2D scissor = vks::initializers::rect2D(width, height, 0, 0);
-			vkCmdSetScissor(drawCmdBuffers[i], 0, 1, &scissor);
+		VkViewport viewport = vks::initializers::viewport((float)width, (float)height, 0.0f, 1.0f);
+		vkCmdSetViewport(commandBuffer, 0, 1, &viewport);
 
-			vkCmdSetLineWidth(drawCmdBuffers[i], 1.0f);
+		VkRect2D scissor = vks::initializers::rect2D(width, height, 0, 0);
+		vkCmdSetScissor(commandBuffer, 0, 1, &scissor);
 
-			VkDeviceSize offsets[1] = { 0 };
+		vkCmdSetLineWidth(commandBuffer, 1.0f);
 
-			// Skysphere
-			vkCmdBindPipeline(drawCmdBuffers[i], VK_PIPELINE_BIND_POINT_GRAPHICS, pipelines.skysphere);
-			vkCmdBindDescriptorSets(drawCmdBuffers[i], VK_PIPELINE_BIND_POINT_GRAPHICS, pipelineLayouts.skysphere, 0, 1, &descriptorSets.skysphere, 0, nullptr);
-			models.skysphere.draw(drawCmdBuffers[i]);
+		VkDeviceSize offsets[1] = { 0 };
 
-			// Tessellated terrain
-			if (deviceFeatures.pipelineStatisticsQuery) {
-				// Begin pipeline statistics query
-				vkCmdBeginQuery(drawCmdBuffers[i], queryPool, 0, 0);
-			}
-			// Render
-			vkCmdBindPipeline(drawCmdBuffers[i], VK_PIPELINE_BIND_POINT_GRAPHICS, wireframe ? pipelines.wireframe : pipelines.terrain);
-			vkCmdBindDescriptorSets(drawCmdBuffers[i], VK_PIPELINE_BIND_POINT_GRAPHICS, pipelineLayouts.terrain, 0, 1, &descriptorSets.terrain, 0, nullptr);
-			vkCmdBindVertexBuffers(drawCmdBuffers[i], 0, 1, &terrain.vertices.buffer, offsets);
-			vkCmdBindIndexBuffer(drawCmdBuffers[i], terrain.indices.buffer, 0, VK_INDEX_TYPE_UINT32);
-			vkCmdDrawIndexed(drawCmdBuffers[i], terrain.indices.count, 1, 0, 0, 0);
-			if (deviceFeatures.pipelineStatisticsQuery) {
-				// End pipeline statistics query
-				vkCmdEndQuery(drawCmdBuffers[i], queryPool, 0);
-			}
+		// Skysphere
+		vkCmdBindPipeline(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, pipelines.skysphere);
+		vkCmdBindDescriptorSets(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, pipelineLayouts.skysphere, 0, 1, &descriptorSets.skysphere, 0, nullptr);
+		models.skysphere.draw(commandBuffer);
+
+		// Tessellated terrain
+		if (deviceFeatures.pipelineStatisticsQuery) {
+			// Begin pipeline statistics query
+			vkCmdBeginQuery(commandBuffer, queryPool, 0, 0);
+		}
+		// Render
+		if (streaming) {
+			drawChunkedTerrain(commandBuffer);
+		} else {
+			vkCmdBindPipeline(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, wireframe ? pipelines.wireframe : pipelines.terrain);
+			vkCmdBindDescriptorSets(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, pipelineLayouts.terrain, 0, 1, &descriptorSets.terrain, 0, nullptr);
+			vkCmdBindVertexBuffers(commandBuffer, 0, 1, &terrain.vertices.buffer, offsets);
+			vkCmdBindIndexBuffer(commandBuffer, terrain.indices.buffer, 0, VK_INDEX_TYPE_UINT32);
+			vkCmdDrawIndexed(commandBuffer, terrain.indices.count, 1, 0, 0, 0);
+		}
+		if (deviceFeatures.pipelineStatisticsQuery) {
+			// End pipeline statistics query
+			vkCmdEndQuery(commandBuffer, queryPool, 0);
+		}
+
+		drawUI(commandBuffer);
+
+		vkCmdEndRenderPass(commandBuffer);
 
-			drawUI(drawCmdBuffers[i]);
+		VK_CHECK_RESULT(vkEndCommandBuffer(commandBuffer));
+	}
 
-			vkCmdEndRenderPass(drawCmdBuffers[i]);
+	// Copies the tiles that finished loading from the frame's staging buffer into their vertex buffer slots
+	void recordTileUploads(VkCommandBuffer commandBuffer)
+	{
+		const ChunkFrame& frame = chunks.frames[currentFrame];
+		if (frame.uploads.empty()) {
+			return;
+		}
+		const VkDeviceSize tileBytes = chunkedTerrain.getTileVertexCount() * sizeof(vks::terrain::Vertex);
+		std::vector<VkBufferCopy> copyRegions;
+		for (const auto& upload : frame.uploads) {
+			copyRegions.push_back({ upload.stagingIndex * tileBytes, upload.slot * tileBytes, tileBytes });
+		}
+		vkCmdCopyBuffer(commandBuffer, frame.staging.buffer, chunks.vertices.buffer, static_cast<uint32_t>(copyRegions.size()), copyRegions.data());
+		// Slots are only overwritten once no frame in flight reads them anymore, so only the copies need to be made visible
+		VkBufferMemoryBarrier bufferBarrier = vks::initializers::bufferMemoryBarrier();
+		bufferBarrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+		bufferBarrier.dstAccessMask = VK_ACCESS_VERTEX_ATTRIBUTE_READ_BIT;
+		bufferBarrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+		bufferBarrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+		bufferBarrier.buffer = chunks.vertices.buffer;
+		bufferBarrier.size = VK_WHOLE_SIZE;
+		vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_VERTEX_INPUT_BIT, 0, 0, nullptr, 1, &bufferBarrier, 0, nullptr);
+	}
 
-			VK_CHECK_RESULT(vkEndCommandBuffer(drawCmdBuffers[i]));
+	// Draws the selected tiles, all interiors share one index buffer while the stitched edge rings come from the frame's index buffer
+	void drawChunkedTerrain(VkCommandBuffer commandBuffer)
+	{
+		const ChunkFrame& frame = chunks.frames[currentFrame];
+		if (frame.drawSlots.empty()) {
+			return;
+		}
+		VkDeviceSize offsets[1] = { 0 };
+		const int32_t tileVertexCount = static_cast<int32_t>(chunkedTerrain.getTileVertexCount());
+		vkCmdBindPipeline(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, wireframe ? pipelines.chunksWireframe : pipelines.chunks);
+		vkCmdBindDescriptorSets(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, pipelineLayouts.terrain, 0, 1, &descriptorSets.chunks, 0, nullptr);
+		vkCmdBindVertexBuffers(commandBuffer, 0, 1, &chunks.vertices.buffer, offsets);
+		vkCmdBindIndexBuffer(commandBuffer, chunks.interiorIndices.buffer, 0, VK_INDEX_TYPE_UINT16);
+		const uint32_t interiorIndexCount = static_cast<uint32_t>(chunkedTerrain.getInteriorIndices().size());
+		for (uint32_t slot : frame.drawSlots) {
+			vkCmdDrawIndexed(commandBuffer, interiorIndexCount, 1, 0, static_cast<int32_t>(slot) * tileVertexCount, 0);
+		}
+		vkCmdBindIndexBuffer(commandBuffer, frame.ringIndices.buffer, 0, VK_INDEX_TYPE_UINT16);
+		const uint32_t ringIndexCount = chunkedTerrain.getRingIndexCount();
+		for (uint32_t i = 0; i < frame.drawSlots.size(); i++) {
+			vkCmdDrawIndexed(commandBuffer, ringIndexCount, 1, i * ringIndexCount, static_cast<int32_t>(frame.drawSlots[i]) * tileVertexCount, 0);
 		}
 	}
 
@@ -397,6 +494,19 @@ public:
 			rpos /= glm::ivec2(scale);
 			return *(heightdata + (rpos.x + rpos.y * dim) * scale) / 65535.0f;
 		}
+
+		// Bilinearly filtered height at normalized coordinates, matches the linear sampler used for displacement
+		uint16_t sample(float u, float v) const
+		{
+			const float x = std::max(0.0f, std::min(u * dim - 0.5f, (float)(dim - 1)));
+			const float y = std::max(0.0f, std::min(v * dim - 0.5f, (float)(dim - 1)));
+			const uint32_t x0 = (uint32_t)x, y0 = (uint32_t)y;
+			const uint32_t x1 = std::min(x0 + 1, dim - 1), y1 = std::min(y0 + 1, dim - 1);
+			const float fx = x - x0, fy = y - y0;
+			const float top = heightdata[x0 + y0 * dim] * (1.0f - fx) + heightdata[x1 + y0 * dim] * fx;
+			const float bottom = heightdata[x0 + y1 * dim] * (1.0f - fx) + heightdata[x1 + y1 * dim] * fx;
+			return (uint16_t)(top * (1.0f - fy) + bottom * fy + 0.5f);
+		}
 	};
 
 	// Generate a terrain quad patch for feeding to the tessellation control shader
@@ -547,19 +657,143 @@ public:
 		delete[] indices;
 	}
 
+	// Builds the tile pyramid from the height map if needed and creates the buffers the tiles are streamed into
+	void prepareChunkedTerrain()
+	{
+		// Possible locations of the tile pyramid, the first one it can be read from or written to is used
+		std::vector<std::string> filenames;
+#if defined(__ANDROID__)
+		filenames.push_back(std::string(androidApp->activity->internalDataPath) + "/terrain_heightmap.tiles");
+#else
+		// Next to the height map it's built from, with the temporary directory as a fallback for read-only asset directories
+		filenames.push_back(getAssetPath() + "textures/terrain_heightmap.tiles");
+		const char* tempDir = getenv("TMPDIR");
+		if (!tempDir) {
+			tempDir = getenv("TEMP");
+		}
+		filenames.push_back(std::string(tempDir ? tempDir : "/tmp") + "/terrain_heightmap.tiles");
+#endif
+		const uint32_t gridSize = tileSize << (tileLevelCount - 1);
+
+		// The pyramid only depends on the height map, so it's written once and reused by later runs
+		std::string filename;
+		bool valid = false;
+		for (const std::string& candidate : filenames) {
+			vks::terrain::TiledHeightMap existing;
+			valid = existing.open(candidate) && (existing.getTileSize() == tileSize) && (existing.getLevelCount() == tileLevelCount);
+			existing.close();
+			if (valid) {
+				filename = candidate;
+				break;
+			}
+		}
+		if (!valid) {
+			filename = filenames.front();
+			std::cout << "Building " << gridSize + 1 << " x " << gridSize + 1 << " tile pyramid \"" << filename << "\"..." << std::endl;
+			auto tStart = std::chrono::high_resolution_clock::now();
+#if defined(__ANDROID__)
+			HeightMap heightMap(getAssetPath() + "textures/terrain_heightmap_r16.ktx", 1, androidApp->activity->assetManager);
+#else
+			HeightMap heightMap(getAssetPath() + "textures/terrain_heightmap_r16.ktx", 1);
+#endif
+			for (const std::string& candidate : filenames) {
+				filename = candidate;
+				valid = vks::terrain::TiledHeightMap::write(filename, tileSize, tileLevelCount, [&](uint32_t x, uint32_t y) {
+					return heightMap.sample((float)x / gridSize, (float)y / gridSize);
+				});
+				if (valid) {
+					break;
+				}
+			}
+			auto tEnd = std::chrono::high_resolution_clock::now();
+			std::cout << "Done in " << std::chrono::duration<double, std::milli>(tEnd - tStart).count() << "ms" << std::endl;
+		}
+
+		// Same extent and height as the tessellated terrain
+		vks::terrain::TerrainSettings settings;
+		settings.sampleSpacing = (float)(PATCH_SIZE * 2) / gridSize;
+		settings.heightScale = uboTess.displacementFactor;
+		settings.maxPixelError = maxPixelError;
+		settings.cacheSize = 128;
+		settings.uploadBudget = 8;
+		settings.framesInFlight = static_cast<uint32_t>(frames.size());
+		streamingAvailable = valid && chunkedTerrain.open(filename, settings);
+		if (!streamingAvailable) {
+			std::cout << "Error: Could not create tile pyramid \"" << filename << "\", streaming is not available" << std::endl;
+			return;
+		}
+
+		const uint32_t tileVertexCount = chunkedTerrain.getTileVertexCount();
+		VK_CHECK_RESULT(vulkanDevice->createBuffer(
+			VK_BUFFER_USAGE_VERTEX_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT,
+			VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT,
+			&chunks.vertices,
+			settings.cacheSize * tileVertexCount * sizeof(vks::terrain::Vertex)));
+
+		// Interior quads are the same for every tile
+		const std::vector<uint16_t>& interiorIndices = chunkedTerrain.getInteriorIndices();
+		const VkDeviceSize interiorSize = interiorIndices.size() * sizeof(uint16_t);
+		vks::Buffer interiorStaging;
+		VK_CHECK_RESULT(vulkanDevice->createBuffer(
+			VK_BUFFER_USAGE_TRANSFER_SRC_BIT,
+			VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
+			&interiorStaging,
+			interiorSize,
+			(void*)interiorIndices.data()));
+		VK_CHECK_RESULT(vulkanDevice->createBuffer(
+			VK_BUFFER_USAGE_INDEX_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT,
+			VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT,
+			&chunks.interiorIndices,
+			interiorSize));
+		vulkanDevice->copyBuffer(&interiorStaging, &chunks.interiorIndices, queue);
+		interiorStaging.destroy();
+
+		// Staging memory for the per frame upload budget and the stitched edge rings of every tile that may be drawn
+		chunks.frames.resize(frames.size());
+		for (auto& frame : chunks.frames) {
+			VK_CHECK_RESULT(vulkanDevice->createBuffer(
+				VK_BUFFER_USAGE_TRANSFER_SRC_BIT,
+				VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
+				&frame.staging,
+				settings.uploadBudget * tileVertexCount * sizeof(vks::terrain::Vertex)));
+			VK_CHECK_RESULT(vulkanDevice->createBuffer(
+				VK_BUFFER_USAGE_INDEX_BUFFER_BIT,
+				VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
+				&frame.ringIndices,
+				settings.cacheSize * chunkedTerrain.getRingIndexCount() * sizeof(uint16_t)));
+			// Map persistent
+			VK_CHECK_RESULT(frame.staging.map());
+			VK_CHECK_RESULT(frame.ringIndices.map());
+		}
+	}
+
+	// Selects the tiles for the current view and writes the frame's uploads and edge rings, must be called after prepareFrame
+	void updateChunkedTerrain()
+	{
+		ChunkFrame& frame = chunks.frames[currentFrame];
+		chunkedTerrain.update(
+			camera.matrices.perspective,
+			camera.matrices.view,
+			(float)height,
+			static_cast<vks::terrain::Vertex*>(frame.staging.mapped),
+			frame.uploads,
+			static_cast<uint16_t*>(frame.ringIndices.mapped),
+			frame.drawSlots);
+	}
+
 	void setupDescriptorPool()
 	{
 		std::vector<VkDescriptorPoolSize> poolSizes =
 		{
 			vks::initializers::descriptorPoolSize(VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER, 3),
-			vks::initializers::descriptorPoolSize(VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, 3)
+			vks::initializers::descriptorPoolSize(VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, 5)
 		};
 
 		VkDescriptorPoolCreateInfo descriptorPoolInfo =
 			vks::initializers::descriptorPoolCreateInfo(
 				static_cast<uint32_t>(poolSizes.size()),
 				poolSizes.data(),
-				2);
+				3);
 
 		VK_CHECK_RESULT(vkCreateDescriptorPool(device, &descriptorPoolInfo, nullptr, &descriptorPool));
 	}
@@ -648,6 +882,15 @@ public:
 		};
 		vkUpdateDescriptorSets(device, static_cast<uint32_t>(writeDescriptorSets.size()), writeDescriptorSets.data(), 0, NULL);
 
+		// Streamed terrain tiles, same layout with their own uniform buffer
+		allocInfo = vks::initializers::descriptorSetAllocateInfo(descriptorPool, &descriptorSetLayouts.terrain, 1);
+		VK_CHECK_RESULT(vkAllocateDescriptorSets(device, &allocInfo, &descriptorSets.chunks));
+		writeDescriptorSets[0].dstSet = descriptorSets.chunks;
+		writeDescriptorSets[0].pBufferInfo = &uniformBuffers.terrainChunks.descriptor;
+		writeDescriptorSets[1].dstSet = descriptorSets.chunks;
+		writeDescriptorSets[2].dstSet = descriptorSets.chunks;
+		vkUpdateDescriptorSets(device, static_cast<uint32_t>(writeDescriptorSets.size()), writeDescriptorSets.data(), 0, NULL);
+
 		// Skysphere
 		allocInfo = vks::initializers::descriptorSetAllocateInfo(descriptorPool, &descriptorSetLayouts.skysphere, 1);
 		VK_CHECK_RESULT(vkAllocateDescriptorSets(device, &allocInfo, &descriptorSets.skysphere));
@@ -711,6 +954,24 @@ public:
 			VK_CHECK_RESULT(vkCreateGraphicsPipelines(device, pipelineCache, 1, &pipelineCI, nullptr, &pipelines.wireframe));
 		};
 
+		// Streamed terrain tiles use the same shaders with the compact tile vertex layout
+		rasterizationState.polygonMode = VK_POLYGON_MODE_FILL;
+		const std::vector<VkVertexInputBindingDescription> chunkVertexBindings = {
+			vks::initializers::vertexInputBindingDescription(0, sizeof(vks::terrain::Vertex), VK_VERTEX_INPUT_RATE_VERTEX),
+		};
+		const std::vector<VkVertexInputAttributeDescription> chunkVertexAttributes = {
+			vks::initializers::vertexInputAttributeDescription(0, 0, VK_FORMAT_R32G32B32_SFLOAT, offsetof(vks::terrain::Vertex, pos)),
+			vks::initializers::vertexInputAttributeDescription(0, 1, VK_FORMAT_R32G32B32_SFLOAT, offsetof(vks::terrain::Vertex, normal)),
+			vks::initializers::vertexInputAttributeDescription(0, 2, VK_FORMAT_R32G32_SFLOAT, offsetof(vks::terrain::Vertex, uv)),
+		};
+		VkPipelineVertexInputStateCreateInfo chunkVertexInputState = vks::initializers::pipelineVertexInputStateCreateInfo(chunkVertexBindings, chunkVertexAttributes);
+		pipelineCI.pVertexInputState = &chunkVertexInputState;
+		VK_CHECK_RESULT(vkCreateGraphicsPipelines(device, pipelineCache, 1, &pipelineCI, nullptr, &pipelines.chunks));
+		if (deviceFeatures.fillModeNonSolid) {
+			rasterizationState.polygonMode = VK_POLYGON_MODE_LINE;
+			VK_CHECK_RESULT(vkCreateGraphicsPipelines(device, pipelineCache, 1, &pipelineCI, nullptr, &pipelines.chunksWireframe));
+		}
+
 		// Skysphere pipeline
 		rasterizationState.cullMode = VK_CULL_MODE_FRONT_BIT;
 		rasterizationState.polygonMode = VK_POLYGON_MODE_FILL;
@@ -737,6 +998,13 @@ public:
 			&uniformBuffers.terrainTessellation,
 			sizeof(uboTess)));
 
+		// Uniform buffer for the streamed tiles
+		VK_CHECK_RESULT(vulkanDevice->createBuffer(
+			VK_BUFFER_USAGE_UNIFORM_BUFFER_BIT,
+			VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
+			&uniformBuffers.terrainChunks,
+			sizeof(uboChunks)));
+
 		// Skysphere vertex shader uniform buffer
 		VK_CHECK_RESULT(vulkanDevice->createBuffer(
 			VK_BUFFER_USAGE_UNIFORM_BUFFER_BIT,
@@ -746,6 +1014,7 @@ public:
 
 		// Map persistent
 		VK_CHECK_RESULT(uniformBuffers.terrainTessellation.map());
+		VK_CHECK_RESULT(uniformBuffers.terrainChunks.map());
 		VK_CHECK_RESULT(uniformBuffers.skysphereVertex.map());
 
 		updateUniformBuffers();
@@ -777,6 +1046,15 @@ public:
 			uboTess.tessellationFactor = savedFactor;
 		}
 
+		// Streamed tiles are already displaced and culled on the CPU, so the shaders only pass the patches through
+		uboChunks = uboTess;
+		uboChunks.displacementFactor = 0.0f;
+		uboChunks.tessellationFactor = 0.0f;
+		for (auto& plane : uboChunks.frustumPlanes) {
+			plane = glm::vec4(0.0f, 0.0f, 0.0f, 1.0f);
+		}
+		memcpy(uniformBuffers.terrainChunks.mapped, &uboChunks, sizeof(uboChunks));
+
 		// Skysphere vertex shader
 		uboVS.mvp = camera.matrices.perspective * glm::mat4(glm::mat3(camera.matrices.view));
 		memcpy(uniformBuffers.skysphereVertex.mapped, &uboVS, sizeof(uboVS));
@@ -786,9 +1064,14 @@ public:
 	{
 		VulkanExampleBase::prepareFrame();
 
+		if (streaming) {
+			updateChunkedTerrain();
+		}
+		buildCommandBuffer();
+
 		// Command buffer to be submitted to the queue
 		submitInfo.commandBufferCount = 1;
-		submitInfo.pCommandBuffers = &drawCmdBuffers[currentBuffer];
+		submitInfo.pCommandBuffers = &frames[currentFrame].commandBuffer;
 
 		// Submit to queue
 		VK_CHECK_RESULT(vkQueueSubmit(queue, 1, &submitInfo, VK_NULL_HANDLE));
@@ -806,6 +1089,7 @@ public:
 		VulkanExampleBase::prepare();
 		loadAssets();
 		generateTerrain();
+		prepareChunkedTerrain();
 		if (deviceFeatures.pipelineStatisticsQuery) {
 			setupQueryResultBuffer();
 		}
@@ -814,7 +1098,6 @@ public:
 		preparePipelines();
 		setupDescriptorPool();
 		setupDescriptorSets();
-		buildCommandBuffers();
 		prepared = true;
 	}
 
@@ -837,18 +1120,34 @@ public:
 	{
 		if (overlay->header("Settings")) {
 
-			if (overlay->checkBox("Tessellation", &tessellation)) {
-				updateUniformBuffers();
+			if (streamingAvailable) {
+				overlay->checkBox("Streamed tiles", &streaming);
 			}
-			if (overlay->inputFloat("Factor", &uboTess.tessellationFactor, 0.05f, 2)) {
-				updateUniformBuffers();
+			if (streaming) {
+				if (overlay->sliderFloat("Pixel error", &maxPixelError, 0.5f, 16.0f)) {
+					chunkedTerrain.setMaxPixelError(maxPixelError);
+				}
+			} else {
+				if (overlay->checkBox("Tessellation", &tessellation)) {
+					updateUniformBuffers();
+				}
+				if (overlay->inputFloat("Factor", &uboTess.tessellationFactor, 0.05f, 2)) {
+					updateUniformBuffers();
+				}
 			}
 			if (deviceFeatures.fillModeNonSolid) {
-				if (overlay->checkBox("Wireframe", &wireframe)) {
-					buildCommandBuffers();
-				}
+				overlay->checkBox("Wireframe", &wireframe);
 			}
 		}
+		if (streaming && overlay->header("Tile streaming")) {
+			const auto& stats = chunkedTerrain.getStatistics();
+			overlay->text("Drawn tiles: %d", stats.drawnTiles);
+			overlay->text("Resident tiles: %d / %d", stats.residentTiles, chunkedTerrain.getCacheSize());
+			overlay->text("Pending loads: %d", stats.pendingTiles);
+			overlay->text("Finest level: %d / %d", stats.finestDrawnLevel, tileLevelCount - 1);
+			overlay->text("Uploads: %d (%d total)", stats.uploadedTiles, (uint32_t)stats.totalUploads);
+			overlay->text("Evictions: %d", (uint32_t)stats.totalEvictions);
+		}
 		if (deviceFeatures.pipelineStatisticsQuery) {
 			if (overlay->header("Pipeline statistics")) {
 				overlay->text("VS invocations: %d", pipelineStats[0]);
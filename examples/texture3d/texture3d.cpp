@@ -1,12 +1,19 @@
 /*
 * Vulkan Example - 3D texture loading (and generation using perlin noise) example
 *
+* The noise volume is generated in slabs of slices on the job system (see base/noise.hpp), straight into a persistently
+* mapped staging buffer. Every frame uploads the slabs that have been finished since the last frame, so regenerating
+* the volume doesn't block rendering. Consecutive volumes alternate between two staging buffers, so a new volume can be
+* generated while the uploads of the previous one are still in flight.
+*
 * Copyright (C) 2016 by Sascha Willems - www.saschawillems.de
 *
 * This code is licensed under the MIT license (MIT) (http://opensource.org/licenses/MIT)
 */
 
 #include "vulkanexamplebase.h"
+#include "jobsystem.hpp"
+#include "noise.hpp"
 
 #define VERTEX_BUFFER_BIND_ID 0
 #define ENABLE_VALIDATION false
@@ -18,113 +25,6 @@ struct Vertex {
 	float normal[3];
 };
 
-// Translation of Ken Perlin's JAVA implementation (http://mrl.nyu.edu/~perlin/noise/)
-template <typename T>
-class PerlinNoise
-{
-private:
-	uint32_t permutations[512];
-	T fade(T t)
-	{
-		return t * t * t * (t * (t * (T)6 - (T)15) + (T)10);
-	}
-	T lerp(T t, T a, T b)
-	{
-		return a + t * (b - a);
-	}
-	T grad(int hash, T x, T y, T z)
-	{
-		// Convert LO 4 bits of hash code into 12 gradient directions
-		int h = hash & 15;
-		T u = h < 8 ? x : y;
-		T v = h < 4 ? y : h == 12 || h == 14 ? x : z;
-		return ((h & 1) == 0 ? u : -u) + ((h & 2) == 0 ? v : -v);
-	}
-public:
-	PerlinNoise()
-	{
-		// Generate random lookup for permutations containing all numbers from 0..255
-		std::vector<uint8_t> plookup;
-		plookup.resize(256);
-		std::iota(plookup.begin(), plookup.end(), 0);
-		std::default_random_engine rndEngine(std::random_device{}());
-		std::shuffle(plookup.begin(), plookup.end(), rndEngine);
-
-		for (uint32_t i = 0; i < 256; i++)
-		{
-			permutations[i] = permutations[256 + i] = plookup[i];
-		}
-	}
-	T noise(T x, T y, T z)
-	{
-		// Find unit cube that contains point
-		int32_t X = (int32_t)floor(x) & 255;
-		int32_t Y = (int32_t)floor(y) & 255;
-		int32_t Z = (int32_t)floor(z) & 255;
-		// Find relative x,y,z of point in cube
-		x -= floor(x);
-		y -= floor(y);
-		z -= floor(z);
-
-		// Compute fade curves for each of x,y,z
-		T u = fade(x);
-		T v = fade(y);
-		T w = fade(z);
-
-		// Hash coordinates of the 8 cube corners
-		uint32_t A = permutations[X] + Y;
-		uint32_t AA = permutations[A] + Z;
-		uint32_t AB = permutations[A + 1] + Z;
-		uint32_t B = permutations[X + 1] + Y;
-		uint32_t BA = permutations[B] + Z;
-		uint32_t BB = permutations[B + 1] + Z;
-
-		// And add blended results for 8 corners of the cube;
-		T res = lerp(w, lerp(v,
-			lerp(u, grad(permutations[AA], x, y, z), grad(permutations[BA], x - 1, y, z)), lerp(u, grad(permutations[AB], x, y - 1, z), grad(permutations[BB], x - 1, y - 1, z))),
-			lerp(v, lerp(u, grad(permutations[AA + 1], x, y, z - 1), grad(permutations[BA + 1], x - 1, y, z - 1)), lerp(u, grad(permutations[AB + 1], x, y - 1, z - 1), grad(permutations[BB + 1], x - 1, y - 1, z - 1))));
-		return res;
-	}
-};
-
-// Fractal noise generator based on perlin noise above
-template <typename T>
-class FractalNoise
-{
-private:
-	PerlinNoise<float> perlinNoise;
-	uint32_t octaves;
-	T frequency;
-	T amplitude;
-	T persistence;
-public:
-
-	FractalNoise(const PerlinNoise<T> &perlinNoise)
-	{
-		this->perlinNoise = perlinNoise;
-		octaves = 6;
-		persistence = (T)0.5;
-	}
-
-	T noise(T x, T y, T z)
-	{
-		T sum = 0;
-		T frequency = (T)1;
-		T amplitude = (T)1;
-		T max = (T)0;
-		for (uint32_t i = 0; i < octaves; i++)
-		{
-			sum += perlinNoise.noise(x * frequency, y * frequency, z * frequency) * amplitude;
-			max += amplitude;
-			amplitude *= persistence;
-			frequency *= (T)2;
-		}
-
-		sum = sum / max;
-		return (sum + (T)1.0) / (T)2.0;
-	}
-};
-
 class VulkanExample : public VulkanExampleBase
 {
 public:
@@ -168,6 +68,37 @@ public:
 	VkDescriptorSet descriptorSet;
 	VkDescriptorSetLayout descriptorSetLayout;
 
+	std::default_random_engine rndEngine;
+
+	// Number of slices generated by a single job and uploaded at once
+	const uint32_t slabSize = 4;
+
+	// State of the noise volume generation
+	struct {
+		std::unique_ptr<vks::noise::VolumeGenerator> generator;
+		// Persistently mapped, the generator jobs write their slabs directly to the one of the current volume
+		std::array<vks::Buffer, 2> staging;
+		// Signaled once the last upload from the staging buffer with the same index has finished
+		std::array<VkFence, 2> stagingFences{ { VK_NULL_HANDLE, VK_NULL_HANDLE } };
+		uint32_t stagingIndex = 0;
+		vks::JobCounter jobs;
+		// Set by the job that generated the slab
+		std::unique_ptr<std::atomic<bool>[]> slabsDone;
+		std::atomic<uint32_t> slabsGenerated{ 0 };
+		uint32_t slabCount = 0;
+		uint32_t slabsUploaded = 0;
+		bool active = false;
+		std::chrono::high_resolution_clock::time_point tStart;
+		// Time in ms from the start until the last slab has been generated, written by the job that finished last
+		double generationTime = 0.0;
+		double voxelsPerSecond = 0.0;
+		// One per frame, used to upload the slabs finished since the last frame
+		std::vector<VkCommandBuffer> uploadCmdBuffers;
+	} noiseGeneration;
+
+	const std::vector<uint32_t> textureSizes = { 64, 128, 256 };
+	int32_t textureSizeIndex = 1;
+
 	VulkanExample() : VulkanExampleBase(ENABLE_VALIDATION)
 	{
 		title = "3D textures";
@@ -175,7 +106,7 @@ public:
 		camera.setPosition(glm::vec3(0.0f, 0.0f, -2.5f));
 		camera.setRotation(glm::vec3(0.0f, 15.0f, 0.0f));
 		camera.setPerspective(60.0f, (float)width / (float)height, 0.1f, 256.0f);
-		srand((unsigned int)time(NULL));
+		rndEngine.seed(benchmark.active ? 0 : (unsigned)time(nullptr));
 	}
 
 	~VulkanExample()
@@ -183,6 +114,18 @@ public:
 		// Clean up used Vulkan resources
 		// Note : Inherited destructor cleans up resources stored in base class
 
+		// Generator jobs may still write to the staging buffer
+		jobSystem.wait(noiseGeneration.jobs);
+		for (uint32_t i = 0; i < 2; i++) {
+			noiseGeneration.staging[i].destroy();
+			if (noiseGeneration.stagingFences[i] != VK_NULL_HANDLE) {
+				vkDestroyFence(device, noiseGeneration.stagingFences[i], nullptr);
+			}
+		}
+		if (!noiseGeneration.uploadCmdBuffers.empty()) {
+			vkFreeCommandBuffers(device, cmdPool, static_cast<uint32_t>(noiseGeneration.uploadCmdBuffers.size()), noiseGeneration.uploadCmdBuffers.data());
+		}
+
 		destroyTextureImage(texture);
 
 		vkDestroyPipeline(device, pipelines.solid, nullptr);
@@ -284,82 +227,97 @@ public:
 		texture.descriptor.imageView = texture.view;
 		texture.descriptor.sampler = texture.sampler;
 
+		// The image has no content yet, the first upload transitions it from the undefined layout
+		texture.imageLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+
+		// Host visible staging buffers the noise is generated into
+		for (uint32_t i = 0; i < 2; i++) {
+			VK_CHECK_RESULT(vulkanDevice->createBuffer(
+				VK_BUFFER_USAGE_TRANSFER_SRC_BIT,
+				VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
+				&noiseGeneration.staging[i],
+				(VkDeviceSize)texture.width * texture.height * texture.depth));
+			VK_CHECK_RESULT(noiseGeneration.staging[i].map());
+		}
+
+		// The texture is sampled right away, so wait for the whole volume instead of streaming it in
 		updateNoiseTexture();
+		jobSystem.wait(noiseGeneration.jobs);
 	}
 
-	// Generate randomized noise and upload it to the 3D texture using staging
+	// Generates one slab of slices into the staging buffer, called from the job system
+	void generateSlab(uint32_t slab)
+	{
+		const uint32_t firstSlice = slab * slabSize;
+		const uint32_t sliceCount = std::min(slabSize, texture.depth - firstSlice);
+		noiseGeneration.generator->generateSlices(firstSlice, sliceCount, static_cast<uint8_t*>(noiseGeneration.staging[noiseGeneration.stagingIndex].mapped));
+		if (noiseGeneration.slabsGenerated.fetch_add(1) + 1 == noiseGeneration.slabCount) {
+			auto tEnd = std::chrono::high_resolution_clock::now();
+			noiseGeneration.generationTime = std::chrono::duration<double, std::milli>(tEnd - noiseGeneration.tStart).count();
+		}
+		// Publishes the slab (and the generation time) to the render thread
+		noiseGeneration.slabsDone[slab].store(true, std::memory_order_release);
+	}
+
+	// Starts generating randomized noise, the slabs are uploaded to the 3D texture by the following frames as they get done
 	void updateNoiseTexture()
 	{
-		const uint32_t texMemSize = texture.width * texture.height * texture.depth;
+		if (noiseGeneration.active) {
+			return;
+		}
 
-		uint8_t *data = new uint8_t[texMemSize];
-		memset(data, 0, texMemSize);
+		// Uploads of the previous volume may still read from its staging buffer, so switch to the other one
+		// That buffer was last used by the volume before the previous one, whose uploads have usually finished long ago
+		noiseGeneration.stagingIndex = (noiseGeneration.stagingIndex + 1) % 2;
+		VK_CHECK_RESULT(vkWaitForFences(device, 1, &noiseGeneration.stagingFences[noiseGeneration.stagingIndex], VK_TRUE, UINT64_MAX));
+
+		vks::noise::VolumeSettings settings;
+		settings.width = texture.width;
+		settings.height = texture.height;
+		settings.depth = texture.depth;
+		settings.scale = static_cast<float>(rndEngine() % 10) + 4.0f;
+		noiseGeneration.generator.reset(new vks::noise::VolumeGenerator(vks::noise::PerlinNoise((uint32_t)rndEngine()), settings));
+
+		noiseGeneration.slabCount = (texture.depth + slabSize - 1) / slabSize;
+		noiseGeneration.slabsDone.reset(new std::atomic<bool>[noiseGeneration.slabCount]);
+		for (uint32_t i = 0; i < noiseGeneration.slabCount; i++) {
+			noiseGeneration.slabsDone[i].store(false, std::memory_order_relaxed);
+		}
+		noiseGeneration.slabsGenerated = 0;
+		noiseGeneration.slabsUploaded = 0;
+		noiseGeneration.active = true;
 
-		// Generate perlin based noise
 		std::cout << "Generating " << texture.width << " x " << texture.height << " x " << texture.depth << " noise texture..." << std::endl;
 
-		auto tStart = std::chrono::high_resolution_clock::now();
-
-		PerlinNoise<float> perlinNoise;
-		FractalNoise<float> fractalNoise(perlinNoise);
-
-		const float noiseScale = static_cast<float>(rand() % 10) + 4.0f;
-
-#pragma omp parallel for
-		for (int32_t z = 0; z < texture.depth; z++)
-		{
-			for (int32_t y = 0; y < texture.height; y++)
-			{
-				for (int32_t x = 0; x < texture.width; x++)
-				{
-					float nx = (float)x / (float)texture.width;
-					float ny = (float)y / (float)texture.height;
-					float nz = (float)z / (float)texture.depth;
-#define FRACTAL
-#ifdef FRACTAL
-					float n = fractalNoise.noise(nx * noiseScale, ny * noiseScale, nz * noiseScale);
-#else
-					float n = 20.0 * perlinNoise.noise(nx, ny, nz);
-#endif
-					n = n - floor(n);
-
-					data[x + y * texture.width + z * texture.width * texture.height] = static_cast<uint8_t>(floor(n * 255));
-				}
-			}
+		noiseGeneration.tStart = std::chrono::high_resolution_clock::now();
+		for (uint32_t slab = 0; slab < noiseGeneration.slabCount; slab++) {
+			jobSystem.run([this, slab] { generateSlab(slab); }, &noiseGeneration.jobs);
 		}
+		// Without worker threads the jobs would only run once something waits for them
+		if (jobSystem.threadCount() < 2) {
+			jobSystem.wait(noiseGeneration.jobs);
+		}
+	}
 
-		auto tEnd = std::chrono::high_resolution_clock::now();
-		auto tDiff = std::chrono::duration<double, std::milli>(tEnd - tStart).count();
-
-		std::cout << "Done in " << tDiff << "ms" << std::endl;
-
-		// Create a host-visible staging buffer that contains the raw image data
-		VkBuffer stagingBuffer;
-		VkDeviceMemory stagingMemory;
-
-		// Buffer object
-		VkBufferCreateInfo bufferCreateInfo = vks::initializers::bufferCreateInfo();
-		bufferCreateInfo.size = texMemSize;
-		bufferCreateInfo.usage = VK_BUFFER_USAGE_TRANSFER_SRC_BIT;
-		bufferCreateInfo.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
-		VK_CHECK_RESULT(vkCreateBuffer(device, &bufferCreateInfo, nullptr, &stagingBuffer));
-
-		// Allocate host visible memory for data upload
-		VkMemoryAllocateInfo memAllocInfo = vks::initializers::memoryAllocateInfo();
-		VkMemoryRequirements memReqs = {};
-		vkGetBufferMemoryRequirements(device, stagingBuffer, &memReqs);
-		memAllocInfo.allocationSize = memReqs.size;
-		memAllocInfo.memoryTypeIndex = vulkanDevice->getMemoryType(memReqs.memoryTypeBits, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT);
-		VK_CHECK_RESULT(vkAllocateMemory(device, &memAllocInfo, nullptr, &stagingMemory));
-		VK_CHECK_RESULT(vkBindBufferMemory(device, stagingBuffer, stagingMemory, 0));
-
-		// Copy texture data into staging buffer
-		uint8_t *mapped;
-		VK_CHECK_RESULT(vkMapMemory(device, stagingMemory, 0, memReqs.size, 0, (void **)&mapped));
-		memcpy(mapped, data, texMemSize);
-		vkUnmapMemory(device, stagingMemory);
+	// Records the copy of all slabs finished since the last upload, returns false if there was nothing to upload
+	// For the last upload of a volume, fence is set to the staging buffer's fence, which needs to be signaled by the submission
+	bool recordNoiseUpload(VkCommandBuffer commandBuffer, VkFence& fence)
+	{
+		if (!noiseGeneration.active) {
+			return false;
+		}
+		// Slabs finish out of order, only upload the contiguous range following the last upload
+		const uint32_t firstSlab = noiseGeneration.slabsUploaded;
+		uint32_t endSlab = firstSlab;
+		while ((endSlab < noiseGeneration.slabCount) && noiseGeneration.slabsDone[endSlab].load(std::memory_order_acquire)) {
+			endSlab++;
+		}
+		if (endSlab == firstSlab) {
+			return false;
+		}
 
-		VkCommandBuffer copyCmd = vulkanDevice->createCommandBuffer(VK_COMMAND_BUFFER_LEVEL_PRIMARY, true);
+		VkCommandBufferBeginInfo cmdBufInfo = vks::initializers::commandBufferBeginInfo();
+		VK_CHECK_RESULT(vkBeginCommandBuffer(commandBuffer, &cmdBufInfo));
 
 		// The sub resource range describes the regions of the image we will be transitioned
 		VkImageSubresourceRange subresourceRange = {};
@@ -368,50 +326,77 @@ public:
 		subresourceRange.levelCount = 1;
 		subresourceRange.layerCount = 1;
 
-		// Optimal image will be used as destination for the copy, so we must transfer from our
-		// initial undefined image layout to the transfer destination layout
+		// Keeps the contents of the slices that are not part of this upload (unless the image has no content yet)
 		vks::tools::setImageLayout(
-			copyCmd,
+			commandBuffer,
 			texture.image,
-			VK_IMAGE_LAYOUT_UNDEFINED,
+			texture.imageLayout,
 			VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,
 			subresourceRange);
 
-		// Copy 3D noise data to texture
-
-		// Setup buffer copy regions
+		// Copy the finished slices to the texture
+		const uint32_t firstSlice = firstSlab * slabSize;
+		const uint32_t endSlice = std::min(endSlab * slabSize, texture.depth);
 		VkBufferImageCopy bufferCopyRegion{};
+		bufferCopyRegion.bufferOffset = (VkDeviceSize)firstSlice * texture.width * texture.height;
 		bufferCopyRegion.imageSubresource.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
 		bufferCopyRegion.imageSubresource.mipLevel = 0;
 		bufferCopyRegion.imageSubresource.baseArrayLayer = 0;
 		bufferCopyRegion.imageSubresource.layerCount = 1;
+		bufferCopyRegion.imageOffset.z = firstSlice;
 		bufferCopyRegion.imageExtent.width = texture.width;
 		bufferCopyRegion.imageExtent.height = texture.height;
-		bufferCopyRegion.imageExtent.depth = texture.depth;
+		bufferCopyRegion.imageExtent.depth = endSlice - firstSlice;
 
 		vkCmdCopyBufferToImage(
-			copyCmd,
-			stagingBuffer,
+			commandBuffer,
+			noiseGeneration.staging[noiseGeneration.stagingIndex].buffer,
 			texture.image,
 			VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,
 			1,
 			&bufferCopyRegion);
 
-		// Change texture image layout to shader read after all mip levels have been copied
+		// Change texture image layout to shader read for the draw that follows in the same submission
 		texture.imageLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
 		vks::tools::setImageLayout(
-			copyCmd,
+			commandBuffer,
 			texture.image,
 			VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,
 			texture.imageLayout,
 			subresourceRange);
 
-		vulkanDevice->flushCommandBuffer(copyCmd, queue, true);
+		VK_CHECK_RESULT(vkEndCommandBuffer(commandBuffer));
+
+		noiseGeneration.slabsUploaded = endSlab;
+		if (endSlab == noiseGeneration.slabCount) {
+			// The fence has been waited on when this volume was started, so it can be reset
+			fence = noiseGeneration.stagingFences[noiseGeneration.stagingIndex];
+			VK_CHECK_RESULT(vkResetFences(device, 1, &fence));
+			// All flags are set, so the jobs have done their work and only release the counter
+			jobSystem.wait(noiseGeneration.jobs);
+			noiseGeneration.active = false;
+			const double voxelCount = (double)texture.width * texture.height * texture.depth;
+			noiseGeneration.voxelsPerSecond = voxelCount / (noiseGeneration.generationTime / 1000.0);
+			std::cout << "Done in " << noiseGeneration.generationTime << "ms (" << noiseGeneration.voxelsPerSecond / 1.0e6 << " M voxels/s)" << std::endl;
+		}
+		return true;
+	}
 
-		// Clean up staging resources
-		delete[] data;
-		vkFreeMemory(device, stagingMemory, nullptr);
-		vkDestroyBuffer(device, stagingBuffer, nullptr);
+	// Recreates the texture (and its staging buffers) with a new size
+	void changeTextureSize(uint32_t size)
+	{
+		vkDeviceWaitIdle(device);
+		jobSystem.wait(noiseGeneration.jobs);
+		noiseGeneration.active = false;
+		noiseGeneration.staging[0].destroy();
+		noiseGeneration.staging[1].destroy();
+		destroyTextureImage(texture);
+		prepareNoiseTexture(size, size, size);
+		// Binding 1 : Fragment shader texture sampler
+		VkWriteDescriptorSet writeDescriptorSet = vks::initializers::writeDescriptorSet(descriptorSet, VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, 1, &texture.descriptor);
+		vkUpdateDescriptorSets(device, 1, &writeDescriptorSet, 0, nullptr);
+		// The command buffers reference the descriptor set that has just been updated
+		buildCommandBuffers();
 	}
 
 	// Free all Vulkan resources used a texture object
@@ -479,12 +464,19 @@ public:
 	{
 		VulkanExampleBase::prepareFrame();
 
-		// Command buffer to be submitted to the queue
-		submitInfo.commandBufferCount = 1;
-		submitInfo.pCommandBuffers = &drawCmdBuffers[currentBuffer];
+		// Command buffers to be submitted to the queue, noise uploads (if any) go before the draw
+		std::array<VkCommandBuffer, 2> commandBuffers;
+		uint32_t commandBufferCount = 0;
+		VkFence uploadFence = VK_NULL_HANDLE;
+		if (recordNoiseUpload(noiseGeneration.uploadCmdBuffers[currentFrame], uploadFence)) {
+			commandBuffers[commandBufferCount++] = noiseGeneration.uploadCmdBuffers[currentFrame];
+		}
+		commandBuffers[commandBufferCount++] = drawCmdBuffers[currentBuffer];
+		submitInfo.commandBufferCount = commandBufferCount;
+		submitInfo.pCommandBuffers = commandBuffers.data();
 
 		// Submit to queue
-		VK_CHECK_RESULT(vkQueueSubmit(queue, 1, &submitInfo, VK_NULL_HANDLE));
+		VK_CHECK_RESULT(vkQueueSubmit(queue, 1, &submitInfo, uploadFence));
 
 		VulkanExampleBase::submitFrame();
 	}
@@ -754,7 +746,15 @@ public:
 		generateQuad();
 		setupVertexDescriptions();
 		prepareUniformBuffers();
-		prepareNoiseTexture(128, 128, 128);
+		VkCommandBufferAllocateInfo cmdBufAllocateInfo = vks::initializers::commandBufferAllocateInfo(cmdPool, VK_COMMAND_BUFFER_LEVEL_PRIMARY, static_cast<uint32_t>(frames.size()));
+		noiseGeneration.uploadCmdBuffers.resize(frames.size());
+		VK_CHECK_RESULT(vkAllocateCommandBuffers(device, &cmdBufAllocateInfo, noiseGeneration.uploadCmdBuffers.data()));
+		// Created signaled, as the staging buffers haven't been used yet
+		VkFenceCreateInfo fenceCreateInfo = vks::initializers::fenceCreateInfo(VK_FENCE_CREATE_SIGNALED_BIT);
+		for (uint32_t i = 0; i < 2; i++) {
+			VK_CHECK_RESULT(vkCreateFence(device, &fenceCreateInfo, nullptr, &noiseGeneration.stagingFences[i]));
+		}
+		prepareNoiseTexture(textureSizes[textureSizeIndex], textureSizes[textureSizeIndex], textureSizes[textureSizeIndex]);
 		setupDescriptorSetLayout();
 		preparePipelines();
 		setupDescriptorPool();
@@ -780,10 +780,22 @@ public:
 	virtual void OnUpdateUIOverlay(vks::UIOverlay *overlay)
 	{
 		if (overlay->header("Settings")) {
+			if (overlay->comboBox("Size", &textureSizeIndex, { "64 x 64 x 64", "128 x 128 x 128", "256 x 256 x 256" })) {
+				changeTextureSize(textureSizes[textureSizeIndex]);
+			}
 			if (overlay->button("Generate new texture")) {
 				updateNoiseTexture();
 			}
 		}
+		if (overlay->header("Statistics")) {
+			if (noiseGeneration.active) {
+				overlay->text("Generating: %d / %d slices", std::min(noiseGeneration.slabsGenerated.load() * slabSize, texture.depth), texture.depth);
+			} else {
+				overlay->text("Generated in %.1f ms", noiseGeneration.generationTime);
+				overlay->text("%.1f M voxels/s", noiseGeneration.voxelsPerSecond / 1.0e6);
+			}
+			overlay->text("Worker threads: %d", jobSystem.threadCount());
+		}
 	}
 };
 
@@ -34,6 +34,8 @@ VulkanExample::~VulkanExample()
 	vkDestroyImage(device, shadingRateImage.image, nullptr);
 	vkFreeMemory(device, shadingRateImage.memory, nullptr);
 	shaderData.buffer.destroy();
+	drawRecorder.destroy();
+	vkFreeCommandBuffers(device, cmdPool, static_cast<uint32_t>(uiCommandBuffers.size()), uiCommandBuffers.data());
 }
 
 void VulkanExample::getEnabledFeatures()
@@ -57,9 +59,24 @@ void VulkanExample::handleResize()
 	vkFreeMemory(device, shadingRateImage.memory, nullptr);
 	// Recreate image
 	prepareShadingRateImage();
+	prepareDrawRecorder();
 	resized = false;
 }
 
+/*
+	The number of swap chain images may change on resize, each image's command buffer needs its own set of secondary command buffers
+*/
+void VulkanExample::prepareDrawRecorder()
+{
+	drawRecorder.prepare(vulkanDevice, &jobSystem, static_cast<uint32_t>(drawCmdBuffers.size()));
+	if (!uiCommandBuffers.empty()) {
+		vkFreeCommandBuffers(device, cmdPool, static_cast<uint32_t>(uiCommandBuffers.size()), uiCommandBuffers.data());
+	}
+	uiCommandBuffers.resize(drawCmdBuffers.size());
+	VkCommandBufferAllocateInfo cmdBufAllocateInfo = vks::initializers::commandBufferAllocateInfo(cmdPool, VK_COMMAND_BUFFER_LEVEL_SECONDARY, static_cast<uint32_t>(uiCommandBuffers.size()));
+	VK_CHECK_RESULT(vkAllocateCommandBuffers(device, &cmdBufAllocateInfo, uiCommandBuffers.data()));
+}
+
 void VulkanExample::buildCommandBuffers()
 {
 	if (resized)
@@ -86,10 +103,50 @@ void VulkanExample::buildCommandBuffers()
 	const VkViewport viewport = vks::initializers::viewport((float)width, (float)height, 0.0f, 1.0f);
 	const VkRect2D scissor = vks::initializers::rect2D(width, height, 0, 0);
 
+	Pipelines& pipelines = enableShadingRate ? shadingRatePipelines : basePipelines;
+
 	for (int32_t i = 0; i < drawCmdBuffers.size(); ++i)
 	{
 		renderPassBeginInfo.framebuffer = frameBuffers[i];
 		VK_CHECK_RESULT(vkBeginCommandBuffer(drawCmdBuffers[i], &cmdBufInfo));
+
+		if (multithreadedRecording) {
+			// The scene's draws are sorted by pipeline and material and recorded into secondary command buffers in parallel
+			vkCmdBeginRenderPass(drawCmdBuffers[i], &renderPassBeginInfo, VK_SUBPASS_CONTENTS_SECONDARY_COMMAND_BUFFERS);
+			vkglTF::ParallelDrawRecorder::DrawInfo drawInfo;
+			drawInfo.inheritanceInfo.renderPass = renderPass;
+			drawInfo.inheritanceInfo.framebuffer = frameBuffers[i];
+			drawInfo.renderFlags = vkglTF::RenderFlags::BindImages | vkglTF::RenderFlags::RenderOpaqueNodes | vkglTF::RenderFlags::RenderAlphaMaskedNodes;
+			drawInfo.pipelineLayout = pipelineLayout;
+			drawInfo.frustum = frustumCulling ? &frustum : nullptr;
+			drawInfo.getPipeline = [&pipelines](const vkglTF::Material& material) {
+				return (material.alphaMode == vkglTF::Material::ALPHAMODE_MASK) ? pipelines.masked : pipelines.opaque;
+			};
+			// Secondary command buffers don't inherit any state from the primary command buffer
+			drawInfo.beginCommandBuffer = [&](VkCommandBuffer commandBuffer) {
+				vkCmdSetViewport(commandBuffer, 0, 1, &viewport);
+				vkCmdSetScissor(commandBuffer, 0, 1, &scissor);
+				vkCmdBindDescriptorSets(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, pipelineLayout, 0, 1, &descriptorSet, 0, nullptr);
+				if (enableShadingRate) {
+					vkCmdBindShadingRateImageNV(commandBuffer, shadingRateImage.view, VK_IMAGE_LAYOUT_SHADING_RATE_OPTIMAL_NV);
+				}
+			};
+			std::vector<VkCommandBuffer> secondaryCommandBuffers = drawRecorder.record(scene, drawInfo, i);
+
+			VkCommandBufferBeginInfo uiCmdBufInfo = vks::initializers::commandBufferBeginInfo();
+			uiCmdBufInfo.flags = VK_COMMAND_BUFFER_USAGE_RENDER_PASS_CONTINUE_BIT;
+			uiCmdBufInfo.pInheritanceInfo = &drawInfo.inheritanceInfo;
+			VK_CHECK_RESULT(vkBeginCommandBuffer(uiCommandBuffers[i], &uiCmdBufInfo));
+			drawUI(uiCommandBuffers[i]);
+			VK_CHECK_RESULT(vkEndCommandBuffer(uiCommandBuffers[i]));
+			secondaryCommandBuffers.push_back(uiCommandBuffers[i]);
+
+			vkCmdExecuteCommands(drawCmdBuffers[i], static_cast<uint32_t>(secondaryCommandBuffers.size()), secondaryCommandBuffers.data());
+			vkCmdEndRenderPass(drawCmdBuffers[i]);
+			VK_CHECK_RESULT(vkEndCommandBuffer(drawCmdBuffers[i]));
+			continue;
+		}
+
 		vkCmdBeginRenderPass(drawCmdBuffers[i], &renderPassBeginInfo, VK_SUBPASS_CONTENTS_INLINE);
 		vkCmdSetViewport(drawCmdBuffers[i], 0, 1, &viewport);
 		vkCmdSetScissor(drawCmdBuffers[i], 0, 1, &scissor);
@@ -101,7 +158,6 @@ void VulkanExample::buildCommandBuffers()
 		};
 
 		// Render the scene
-		Pipelines& pipelines = enableShadingRate ? shadingRatePipelines : basePipelines;
 		vkCmdBindPipeline(drawCmdBuffers[i], VK_PIPELINE_BIND_POINT_GRAPHICS, pipelines.opaque);
 		scene.draw(drawCmdBuffers[i], vkglTF::RenderFlags::BindImages | vkglTF::RenderFlags::RenderOpaqueNodes, pipelineLayout);
 		vkCmdBindPipeline(drawCmdBuffers[i], VK_PIPELINE_BIND_POINT_GRAPHICS, pipelines.masked);
@@ -395,6 +451,7 @@ void VulkanExample::updateUniformBuffers()
 	shaderData.values.viewPos = camera.viewPos;
 	shaderData.values.colorShadingRate = colorShadingRate;
 	memcpy(shaderData.buffer.mapped, &shaderData.values, sizeof(shaderData.values));
+	frustum.update(shaderData.values.projection * shaderData.values.view * shaderData.values.model);
 }
 
 void VulkanExample::prepare()
@@ -414,6 +471,7 @@ void VulkanExample::prepare()
 	prepareUniformBuffers();
 	setupDescriptors();
 	preparePipelines();
+	prepareDrawRecorder();
 	buildCommandBuffers();
 	prepared = true;
 }
@@ -423,6 +481,9 @@ void VulkanExample::render()
 	renderFrame();
 	if (camera.updated) {
 		updateUniformBuffers();
+		if (multithreadedRecording && frustumCulling) {
+			buildCommandBuffers();
+		}
 	}
 }
 
@@ -434,6 +495,23 @@ void VulkanExample::OnUpdateUIOverlay(vks::UIOverlay* overlay)
 	if (overlay->checkBox("Color shading rates", &colorShadingRate)) {
 		updateUniformBuffers();
 	}
+	if (overlay->header("Command buffers")) {
+		if (overlay->checkBox("Multithreaded recording", &multithreadedRecording)) {
+			buildCommandBuffers();
+		}
+		if (multithreadedRecording) {
+			if (overlay->checkBox("Frustum culling", &frustumCulling)) {
+				buildCommandBuffers();
+			}
+			if (frustumCulling) {
+				overlay->text("%u primitives culled", drawRecorder.culledCount);
+			}
+			overlay->text("Recorded in %.2f ms", drawRecorder.recordTime);
+			for (const auto& range : drawRecorder.getStatistics()) {
+				overlay->text("Thread %u: %.2f ms, %u draws, %u binds", range.threadIndex, range.recordTime, range.drawCount, range.pipelineBinds + range.descriptorSetBinds);
+			}
+		}
+	}
 }
 
 VULKAN_EXAMPLE_MAIN()
@@ -8,6 +8,7 @@
 
 #include "vulkanexamplebase.h"
 #include "VulkanglTFModel.h"
+#include "jobsystem.hpp"
 
 #define ENABLE_VALIDATION false
 
@@ -24,6 +25,14 @@ public:
 
 	bool enableShadingRate = true;
 	bool colorShadingRate = false;
+	// Record the scene's draws into secondary command buffers on all cores
+	bool multithreadedRecording = true;
+	vkglTF::ParallelDrawRecorder drawRecorder;
+	// With secondary command buffer contents the UI also needs to be recorded into secondary command buffers
+	std::vector<VkCommandBuffer> uiCommandBuffers;
+	// Only record primitives inside of the camera's frustum, command buffers are recorded again whenever the camera moves
+	bool frustumCulling = true;
+	vks::Frustum frustum;
 
 	struct ShaderData {
 		vks::Buffer buffer;
@@ -57,6 +66,7 @@ public:
 	~VulkanExample();
 	virtual void getEnabledFeatures();
 	void handleResize();
+	void prepareDrawRecorder();
 	void buildCommandBuffers();
 	void loadglTFFile(std::string filename);
 	void loadAssets();
@@ -165,11 +165,9 @@ VulkanExample::~VulkanExample()
 	separateVertexBuffers.tangent.destroy();
 	separateVertexBuffers.uv.destroy();
 	interleavedVertexBuffer.destroy();
-	for (Image image : scene.images) {
-		vkDestroyImageView(vulkanDevice->logicalDevice, image.texture.view, nullptr);
-		vkDestroyImage(vulkanDevice->logicalDevice, image.texture.image, nullptr);
-		vkDestroySampler(vulkanDevice->logicalDevice, image.texture.sampler, nullptr);
-		vkFreeMemory(vulkanDevice->logicalDevice, image.texture.deviceMemory, nullptr);
+	for (Image& image : scene.images) {
+		// The texture's memory is sub-allocated from a block shared with other resources, so it has to be released through the texture
+		image.texture.destroy();
 	}
 }
 
@@ -28,6 +28,7 @@
 #include "tiny_gltf.h"
 
 #include "vulkanexamplebase.h"
+#include "animation.hpp"
 
 #define ENABLE_VALIDATION true
 
@@ -82,15 +83,18 @@ public:
 	};
 
 	struct AnimationChannel {
+		enum PathType { TRANSLATION, ROTATION, SCALE };
 		uint32_t samplerIndex;
-		std::string path;
+		PathType path;
 		Node* node;
 	};
 
 	struct AnimationSampler {
-		std::string interpolation;
+		enum InterpolationType { LINEAR, STEP, CUBICSPLINE };
+		InterpolationType interpolation;
 		std::vector<float> inputs;  //key frames
 		std::vector<glm::vec4> outputs;  //transformation data of corresponding key frames
+		size_t cursor = 0;  //key frame interval of the last lookup
 	};
 
 	struct Animation {
@@ -186,11 +190,9 @@ public:
 		vkFreeMemory(vulkanDevice->logicalDevice, vertices.memory, nullptr);
 		vkDestroyBuffer(vulkanDevice->logicalDevice, indices.buffer, nullptr);
 		vkFreeMemory(vulkanDevice->logicalDevice, indices.memory, nullptr);
-		for (Image image : images) {
-			vkDestroyImageView(vulkanDevice->logicalDevice, image.texture.view, nullptr);
-			vkDestroyImage(vulkanDevice->logicalDevice, image.texture.image, nullptr);
-			vkDestroySampler(vulkanDevice->logicalDevice, image.texture.sampler, nullptr);
-			vkFreeMemory(vulkanDevice->logicalDevice, image.texture.deviceMemory, nullptr);
+		for (Image& image : images) {
+			// The texture's memory is sub-allocated from a block shared with other resources, so it has to be released through the texture
+			image.texture.destroy();
 		}
 
 		skeleton.ssbo.destroy();
@@ -445,13 +447,28 @@ public:
 			
 
 			//Channels
-			dstAnimation.channels.resize(srcAnimation.channels.size());
 			for(int j = 0; j <srcAnimation.channels.size(); ++j){
 				tinygltf::AnimationChannel& srcChannel = srcAnimation.channels[j];
-				AnimationChannel& dstChannel = animations[i].channels[j];
-				dstChannel.path = srcChannel.target_path;
+				AnimationChannel dstChannel;
+				//resolve the path once here instead of comparing strings every frame
+				if (srcChannel.target_path == "translation") {
+					dstChannel.path = AnimationChannel::TRANSLATION;
+				}
+				else if (srcChannel.target_path == "rotation") {
+					dstChannel.path = AnimationChannel::ROTATION;
+				}
+				else if (srcChannel.target_path == "scale") {
+					dstChannel.path = AnimationChannel::SCALE;
+				}
+				else {
+					std::cout << "animation path " << srcChannel.target_path << " not supported, skipping channel" << std::endl;
+					continue;
+				}
 				dstChannel.samplerIndex = srcChannel.sampler;
 				dstChannel.node = nodeFromIndex(srcChannel.target_node); //find Node* from nodes tree by index
+				if (dstChannel.node) {
+					dstAnimation.channels.push_back(dstChannel);
+				}
 			}
 
 			//Samplers
@@ -459,7 +476,15 @@ public:
 			for (int j = 0; j < srcAnimation.samplers.size(); ++j) {
 				tinygltf::AnimationSampler& srcSampler = srcAnimation.samplers[j];
 				AnimationSampler& dstSampler = dstAnimation.samplers[j];
-				dstSampler.interpolation = srcSampler.interpolation;
+				if (srcSampler.interpolation == "STEP") {
+					dstSampler.interpolation = AnimationSampler::STEP;
+				}
+				else if (srcSampler.interpolation == "CUBICSPLINE") {
+					dstSampler.interpolation = AnimationSampler::CUBICSPLINE;
+				}
+				else {
+					dstSampler.interpolation = AnimationSampler::LINEAR;
+				}
 
 				// Read sampler keyframe input time values
 				{
@@ -565,42 +590,42 @@ public:
 		for (auto && channel: animation.channels) {
 			auto&& sampler = animation.samplers[channel.samplerIndex];
 
-			float alpha = 0.f;
-			int i = 0;
-			for (int n = sampler.inputs.size(); i < n - 1; ++i) {
-				if (animation.currentTime >= sampler.inputs[i] && animation.currentTime <= sampler.inputs[i + 1]) {
-					alpha = (animation.currentTime - sampler.inputs[i]) / (sampler.inputs[i + 1] - sampler.inputs[i]);
+			//continues from the last key frame interval instead of scanning all key frames
+			const vks::animation::KeyFrame keyFrame = vks::animation::findKeyFrame(sampler.inputs, animation.currentTime, sampler.cursor);
+
+			if (channel.path == AnimationChannel::ROTATION) {
+				switch (sampler.interpolation) {
+				case AnimationSampler::LINEAR:
+					channel.node->rotation = vks::animation::slerp(sampler.outputs, keyFrame);
+					break;
+				case AnimationSampler::STEP:
+					channel.node->rotation = vks::animation::toQuat(vks::animation::step(sampler.outputs, keyFrame));
+					break;
+				case AnimationSampler::CUBICSPLINE:
+					channel.node->rotation = glm::normalize(vks::animation::toQuat(vks::animation::cubicSpline(sampler.outputs, keyFrame)));
 					break;
 				}
+				continue;
 			}
 
-			if (sampler.interpolation == "LINEAR") {
-				if (channel.path == "translation") {
-					channel.node->translation = glm::mix(sampler.outputs[i], sampler.outputs[i + 1], alpha);
-				}
-				else if (channel.path == "rotation") {
-					glm::quat q1;
-					q1.x = sampler.outputs[i].x;
-					q1.y = sampler.outputs[i].y;
-					q1.z = sampler.outputs[i].z;
-					q1.w = sampler.outputs[i].w;
-
-					glm::quat q2;
-					q2.x = sampler.outputs[i + 1].x;
-					q2.y = sampler.outputs[i + 1].y;
-					q2.z = sampler.outputs[i + 1].z;
-					q2.w = sampler.outputs[i + 1].w;
-
-					channel.node->rotation = glm::normalize(glm::slerp(q1, q2, alpha));
-				}
-				else if (channel.path == "scale") {
-					channel.node->scale = glm::mix(sampler.outputs[i], sampler.outputs[i + 1], alpha);
-				}
+			glm::vec4 value;
+			switch (sampler.interpolation) {
+			case AnimationSampler::LINEAR:
+				value = vks::animation::linear(sampler.outputs, keyFrame);
+				break;
+			case AnimationSampler::STEP:
+				value = vks::animation::step(sampler.outputs, keyFrame);
+				break;
+			case AnimationSampler::CUBICSPLINE:
+				value = vks::animation::cubicSpline(sampler.outputs, keyFrame);
+				break;
+			}
+			if (channel.path == AnimationChannel::TRANSLATION) {
+				channel.node->translation = glm::vec3(value);
 			}
 			else {
-				throw std::runtime_error("interpolation not support");
+				channel.node->scale = glm::vec3(value);
 			}
-
 		}
 
 		updateSkeletonMatrices(nodes[0], glm::mat4(1.f));